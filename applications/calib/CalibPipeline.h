@@ -0,0 +1,279 @@
+#pragma once
+
+// Target detection shared by the calibgrid and calibbatch applications.
+
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+
+#include <sophus/se3.hpp>
+
+#include <calibu/cam/camera_models_crtp.h>
+#include <calibu/calib/Calibrator.h>
+#include <calibu/calib/MultiModelCalibrator.h>
+#include <calibu/image/ImageProcessing.h>
+#include <calibu/target/TargetGridDot.h>
+#include <calibu/target/DetectionCache.h>
+#include <calibu/pose/Pnp.h>
+#include <calibu/conics/ConicFinder.h>
+
+namespace calibu {
+
+/// Target correspondences and pose found in one camera image.
+struct CameraObservations
+{
+  CameraObservations() : tracking_good(false) {}
+
+  bool tracking_good;
+  Sophus::SE3d T_hw;
+  std::vector<Eigen::Vector3d,
+              Eigen::aligned_allocator<Eigen::Vector3d> > P_w;
+  std::vector<Eigen::Vector2d,
+              Eigen::aligned_allocator<Eigen::Vector2d> > p_c;
+
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW;
+};
+
+typedef std::vector<CameraObservations,
+                    Eigen::aligned_allocator<CameraObservations> >
+    RigObservations;
+
+/// Detection state owned by a single camera stream. Each stream keeps its
+/// own image buffers, conic finder and target matcher so that the streams
+/// of a rig can be processed concurrently, and so that buffers are reused
+/// from one frame to the next.
+struct CameraDetector
+{
+  CameraDetector(size_t max_width, size_t max_height, double grid_spacing,
+                 const Eigen::Vector2i& grid_size, uint32_t grid_seed)
+    : image_processing(max_width, max_height),
+      target(grid_spacing, grid_size, grid_seed),
+      grid_spacing(grid_spacing),
+      grid_size(grid_size)
+  {
+    conic_finder.Params() = DefaultConicParams();
+  }
+
+  /// Conic finder parameters suited to the printed calibration target.
+  static ParamsConicFinder DefaultConicParams()
+  {
+    ParamsConicFinder params;
+    params.conic_min_area = 4.0;
+    params.conic_min_density = 0.6;
+    params.conic_min_aspect = 0.2;
+    return params;
+  }
+
+  /// Find target in image, estimate pose of camera relative to it and
+  /// collect the resulting 2D / 3D correspondences in result. The target
+  /// as detected, before estimating its pose, is kept in detection.
+  void Detect(const unsigned char* image, size_t w, size_t h, size_t pitch,
+              const ParamsImageProcessing& params,
+              const std::shared_ptr<CameraInterface<double>> camera,
+              CameraObservations& result)
+  {
+    image_processing.Params() = params;
+    image_processing.Process(image, w, h, pitch);
+    conic_finder.Find(image_processing);
+
+    const ConicSet& conics =
+        conic_finder.Conics();
+
+    detection.tracking_good = target.FindTarget(image_processing, conics,
+                                                ellipse_target_map);
+    detection.centers.clear();
+    detection.target_map.assign(conics.size(), -1);
+    detection.grid.assign(conics.size(), Eigen::Vector2i::Zero());
+    for(size_t i = 0; i < conics.size(); ++i) {
+      detection.centers.push_back(conics.Center(i));
+      if(detection.tracking_good) {
+        detection.target_map[i] = ellipse_target_map[i];
+        detection.grid[i] = target.Map()[i].pg;
+      }
+    }
+
+    ObserveTarget(detection, camera, result);
+  }
+
+  /// Estimate pose of camera relative to a detected target and collect the
+  /// resulting 2D / 3D correspondences in result.
+  void ObserveTarget(const CachedCameraDetection& detection,
+                     const std::shared_ptr<CameraInterface<double>> camera,
+                     CameraObservations& result) const
+  {
+    result.tracking_good = detection.tracking_good;
+    result.P_w.clear();
+    result.p_c.clear();
+
+    if(!result.tracking_good) {
+      return;
+    }
+
+    // find camera pose given intrinsics
+    PosePnPRansac(camera, detection.centers, target.Circles3D(),
+                  detection.target_map, 0, 0, &result.T_hw);
+
+    for(size_t p = 0; p < detection.centers.size(); ++p) {
+      const Eigen::Vector2i& pg = detection.grid[p];
+      if(0 <= pg(0) && pg(0) < grid_size(0) && 0 <= pg(1) && pg(1) < grid_size(1)) {
+        result.P_w.push_back(grid_spacing * Eigen::Vector3d(pg(0), pg(1), 0));
+        result.p_c.push_back(detection.centers[p]);
+      }
+    }
+  }
+
+  ImageProcessing image_processing;
+  ConicFinder conic_finder;
+  TargetGridDot target;
+
+  double grid_spacing;
+  Eigen::Vector2i grid_size;
+
+  std::vector<int> ellipse_target_map;
+  CachedCameraDetection detection;
+
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW;
+};
+
+/// Starting camera of a generic model, "fov", "poly2", "poly3" (or "poly")
+/// or "kb4", for a w x h image. Returns nullptr for an unknown model.
+inline std::shared_ptr<CameraInterface<double>> NewStartingCamera(
+    const std::string& model, int w, int h)
+{
+  Eigen::Vector2i size_;
+  size_ << w, h;
+  if(model == "fov") {
+    Eigen::VectorXd params_(FovCamera<double>::NumParams);
+    params_ << 300, 300, w/2.0, h/2.0, 0.2;
+    return std::make_shared<FovCamera<double>>(params_, size_);
+  }else if(model == "poly2") {
+    Eigen::VectorXd params_(Poly2Camera<double>::NumParams);
+    params_ << 300, 300, w/2.0, h/2.0, 0.0, 0.0, 0.0;
+    return std::make_shared<Poly2Camera<double>>(params_, size_);
+  }else if(model == "poly3" || model == "poly") {
+    Eigen::VectorXd params_(Poly3Camera<double>::NumParams);
+    params_ << 300, 300, w/2.0, h/2.0, 0.0, 0.0, 0.0;
+    return std::make_shared<Poly3Camera<double>>(params_, size_);
+  }else if(model == "kb4") {
+    Eigen::VectorXd params_(KannalaBrandtCamera<double>::NumParams);
+    params_ << 300, 300, w/2.0, h/2.0, 0.0, 0.0, 0.0, 0.0;
+    return std::make_shared<KannalaBrandtCamera<double>>(params_, size_);
+  }
+  return nullptr;
+}
+
+/// Copies of the cameras of a calibrator's published snapshot, for one
+/// detection thread to estimate target poses with. The calibrator's own
+/// cameras are rewritten by its solver thread, and PosePnPRansac may write
+/// to the camera it is given, so detection threads never share them.
+inline std::vector<std::shared_ptr<CameraInterface<double>>> CopyCameras(
+    const CalibratorSnapshot& snapshot)
+{
+  std::vector<std::shared_ptr<CameraInterface<double>>> copies;
+  for(const std::shared_ptr<const CameraSnapshot<double>>& camera_snapshot :
+      snapshot.cameras) {
+    const CameraInterface<double>& camera = camera_snapshot->Camera();
+    std::shared_ptr<CameraInterface<double>> copy =
+        CreateCameraModel(camera.Type());
+    if(!copy) {
+      throw std::runtime_error("Unable to copy camera of type " + camera.Type());
+    }
+    copy->SetParams(camera.GetParams());
+    copy->SetImageDimensions(camera.Width(), camera.Height());
+    copy->SetRDF(camera.RDF());
+    copies.push_back(copy);
+  }
+  return copies;
+}
+
+/// Add a frame holding the correspondences found by each camera, unless no
+/// camera tracked the target or the calibrator's frame selection rejects it.
+/// This is done serially and in camera order, so results don't depend on
+/// thread timing. CalibratorT is Calibrator or MultiModelCalibrator.
+/// Returns the new frame, or -1 if none was added.
+template<typename CalibratorT>
+int AddDetections(const RigObservations& results, const int* calib_cams,
+                  CalibratorT& calibrator)
+{
+  // Initialize pose of frame for least squares optimisation from the first
+  // camera to track the target
+  const CameraObservations* first = nullptr;
+  std::vector<FramePoints> p_c(calibrator.NumCameras());
+  for(size_t iI = 0; iI < results.size(); ++iI) {
+    if(results[iI].tracking_good) {
+      if(!first) {
+        first = &results[iI];
+      }
+      p_c[calib_cams[iI]] = results[iI].p_c;
+    }
+  }
+
+  if(!first || !calibrator.SelectFrame(first->T_hw, p_c)) {
+    return -1;
+  }
+
+  const int calib_frame = calibrator.AddFrame(first->T_hw);
+  for(size_t iI = 0; iI < results.size(); ++iI) {
+    const CameraObservations& result = results[iI];
+    if(result.tracking_good) {
+      calibrator.AddObservations(calib_frame, calib_cams[iI],
+                                 result.P_w, result.p_c);
+    }
+  }
+  return calib_frame;
+}
+
+/// Fixed capacity queue connecting two pipeline stages. Push blocks while
+/// the queue is full and Pop blocks while it is empty. Once closed, Push
+/// fails and Pop drains the remaining items before failing.
+template<typename T>
+class BoundedQueue
+{
+ public:
+  BoundedQueue(size_t capacity) : capacity_(capacity), closed_(false) {}
+
+  bool Push(T item)
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    not_full_.wait(lock, [this]() { return closed_ || items_.size() < capacity_; });
+    if(closed_) {
+      return false;
+    }
+    items_.push_back(std::move(item));
+    not_empty_.notify_one();
+    return true;
+  }
+
+  bool Pop(T& item)
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    not_empty_.wait(lock, [this]() { return closed_ || !items_.empty(); });
+    if(items_.empty()) {
+      return false;
+    }
+    item = std::move(items_.front());
+    items_.pop_front();
+    not_full_.notify_one();
+    return true;
+  }
+
+  void Close()
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    closed_ = true;
+    not_full_.notify_all();
+    not_empty_.notify_all();
+  }
+
+ private:
+  const size_t capacity_;
+  bool closed_;
+  std::deque<T> items_;
+  std::mutex mutex_;
+  std::condition_variable not_full_;
+  std::condition_variable not_empty_;
+};
+
+}
@@ -0,0 +1,503 @@
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <thread>
+
+#include <opencv2/imgcodecs.hpp>
+
+#include <calibu/cam/camera_xml.h>
+#include <calibu/utils/Parallel.h>
+
+#include "GetPot"
+#include "CalibPipeline.h"
+
+using namespace calibu;
+
+const char* usage_message =
+    "Usage:"
+    "\tcalibbatch <options> manifest\n"
+    "Calibrates every dataset listed in the manifest without a gui. Each line\n"
+    "of the manifest names a dataset, the XML file to write its rig to and a\n"
+    "printf style image sequence for each of its cameras:\n"
+    "\tunit001 unit001.xml /data/unit001/left_%04d.png /data/unit001/right_%04d.png\n"
+    "Blank lines and lines starting with # are ignored. Sequences are read from\n"
+    "-first-index until an image of the first camera is missing.\n"
+    "Options:\n"
+    "\t-report,-r <file>      CSV file summarising each dataset (=calibbatch.csv).\n"
+    "\t-cameras,-c <file>     Starting model, fov, poly2, poly3 or kb4 (=fov), or\n"
+    "\t                       XML rig with starting intrinsics, for every dataset.\n"
+    "\t                       Several models, e.g. fov,poly3,kb4, are fitted at\n"
+    "\t                       once and the one with the lowest BIC is written.\n"
+    "\t-grid-spacing <value>  Distance between circles in grid\n"
+    "\t-grid-seed <value>     Random seed used when creating grid (=71)\n"
+    "\t-grid-rows <value>     Number of rows in the grid pattern.\n"
+    "\t-grid-cols <value>     Number of columns in the grid pattern.\n"
+    "\t-fix-intrinsics,-f     Fix camera intrinsics during optimisation.\n"
+    "\t-first-index <value>   Index of the first image of each sequence (=0).\n"
+    "\t-max-active <value>    Datasets detected and solved at once (=2).\n"
+    "\t-detect-threads <value> Threads detecting targets, shared by all datasets\n"
+    "\t                       (=0, one per core).\n"
+    "\t-max-opt-time <value>  Max time in seconds allowed to the optimiser (=120).\n"
+    "\t-warm-start-frames <value> Frames read before the optimiser starts (=10).\n"
+    "\t-max-frames <value>    Maximum number of frames used (=0, unlimited).\n"
+    "\t-solver-threads <value> Threads used by each dataset's optimiser (=4).\n"
+    "\t-linear-solver <type>  Ceres linear solver, e.g. SPARSE_SCHUR or ITERATIVE_SCHUR.\n"
+    "\t-max-solve-time <value> Max time in seconds for each solver run.\n"
+    "\t-threshold <method>    Adaptive threshold, gaussian or integral (=gaussian).\n"
+    "\t-pyramid-levels <value> Detect dots at 1/2^value resolution (=0).\n"
+    "\t-conics <method>       Conic detection, blobs or labels (=blobs).\n";
+
+/// Settings shared by every dataset of a batch.
+struct BatchOptions
+{
+  BatchOptions()
+    : grid_size(19, 10), grid_spacing(0.254 / 18), grid_seed(71),
+      starting_models(1, "fov"), fix_intrinsics(false), first_index(0),
+      max_opt_time(120), warm_start_frames(10), max_frames(0),
+      conic_method(CONIC_FINDER_BLOBS)
+  {
+  }
+
+  Eigen::Vector2i grid_size;
+  double grid_spacing;
+  uint32_t grid_seed;
+
+  // Candidate model names, or XML rig holding the starting cameras
+  std::vector<std::string> starting_models;
+  std::shared_ptr<Rig<double>> starting_rig;
+
+  bool fix_intrinsics;
+  int first_index;
+  int max_opt_time;
+  int warm_start_frames;
+  int max_frames;
+
+  CalibratorOptions calib_options;
+  ParamsImageProcessing proc_params;
+  ConicFinderMethod conic_method;
+
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW;
+};
+
+/// Expand printf style sequence 'pattern' for image 'index'.
+std::string SequenceFilename(const std::string& pattern, int index)
+{
+  std::vector<char> filename(pattern.size() + 32);
+  snprintf(filename.data(), filename.size(), pattern.c_str(), index);
+  return filename.data();
+}
+
+/// One line of the manifest, with its calibrator and detection progress.
+/// Detections arrive from the worker pool in any order, and are added to
+/// the calibrator in frame order. Every candidate model is fitted to the
+/// same detections, made with the first candidate's cameras.
+class Dataset
+{
+ public:
+  Dataset(const std::string& name, const std::string& output,
+          const std::vector<std::string>& sequences)
+    : name(name), output(output), sequences(sequences), num_frames(0),
+      frames_tracked(0), frames_added(0), mse(0),
+      bic(std::numeric_limits<double>::infinity()), converged(false),
+      detect_seconds(0), solve_seconds(0), next_frame_(0), num_detected_(0)
+  {
+  }
+
+  /// Count frames and set up the calibrator's cameras. Returns false, with
+  /// status set, if the dataset can't be calibrated.
+  bool Open(const BatchOptions& options)
+  {
+    while(std::ifstream(SequenceFilename(sequences[0],
+                                         options.first_index + num_frames))) {
+      ++num_frames;
+    }
+    if(num_frames == 0) {
+      status = "no_images";
+      return false;
+    }
+    if(options.starting_rig &&
+       options.starting_rig->NumCams() != sequences.size()) {
+      status = "camera_count";
+      return false;
+    }
+
+    calibrator.reset(new MultiModelCalibrator(options.calib_options));
+    calibrator->FixCameraIntrinsics(options.fix_intrinsics);
+    calibrator->SetMaxFrames(options.max_frames);
+    for(const std::string& model : options.starting_models) {
+      calibrator->AddModel(model);
+    }
+
+    for(size_t i = 0; i < sequences.size(); ++i) {
+      const cv::Mat image = cv::imread(
+          SequenceFilename(sequences[i], options.first_index),
+          cv::IMREAD_GRAYSCALE);
+      if(image.empty()) {
+        status = "unreadable";
+        return false;
+      }
+
+      for(size_t m = 0; m < calibrator->NumModels(); ++m) {
+        if(options.starting_rig) {
+          // Each dataset refines its own copy of the starting cameras
+          const std::shared_ptr<CameraInterface<double>>& cam =
+              options.starting_rig->cameras_[i];
+          std::shared_ptr<CameraInterface<double>> copy =
+              CreateCameraModel(cam->Type());
+          copy->SetParams(cam->GetParams());
+          copy->SetImageDimensions(cam->Width(), cam->Height());
+          copy->SetRDF(cam->RDF());
+          calibrator->AddCamera(m, copy, cam->Pose().inverse());
+        }else{
+          calibrator->AddCamera(m, NewStartingCamera(
+              calibrator->ModelName(m), image.cols, image.rows));
+        }
+      }
+      calib_cams.push_back(i);
+    }
+
+    start_time_ = std::chrono::steady_clock::now();
+    return true;
+  }
+
+  /// Add the detections of 'frame', and any held back frames that follow
+  /// it, to the calibrator. The optimiser starts once enough are in.
+  void Deliver(int frame, const RigObservations& detections,
+               const BatchOptions& options)
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    pending_[frame] = detections;
+
+    std::map<int, RigObservations>::iterator it;
+    while((it = pending_.find(next_frame_)) != pending_.end()) {
+      for(const CameraObservations& obs : it->second) {
+        if(obs.tracking_good) {
+          ++frames_tracked;
+          break;
+        }
+      }
+      if(AddDetections(it->second, calib_cams.data(), *calibrator) >= 0) {
+        ++frames_added;
+      }
+      pending_.erase(it);
+
+      if(++next_frame_ == options.warm_start_frames) {
+        calibrator->Start();
+      }
+    }
+
+    if(++num_detected_ == num_frames) {
+      all_detected_.notify_all();
+    }
+  }
+
+  /// Wait for every frame to be delivered, then optimise until convergence
+  /// or the time limit, and write the rig if it converged.
+  void Solve(const BatchOptions& options)
+  {
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      all_detected_.wait(lock, [this]() { return num_detected_ == num_frames; });
+    }
+
+    const std::chrono::steady_clock::time_point detected =
+        std::chrono::steady_clock::now();
+    detect_seconds = std::chrono::duration<double>(detected - start_time_).count();
+
+    // Restart so that convergence is judged on the full set of frames,
+    // continuing from the current estimate.
+    calibrator->Stop();
+    calibrator->Start();
+    calibrator->WaitForTolerance(options.max_opt_time);
+    calibrator->Stop();
+
+    solve_seconds = std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - detected).count();
+
+    // Keep the candidate that fits best
+    fits = calibrator->Fits();
+    const int best = SelectCameraModel(fits);
+    model = fits[best].model;
+    mse = fits[best].mse;
+    bic = fits[best].bic;
+    converged = fits[best].converged;
+
+    if(converged) {
+      calibrator->GetCalibrator(best).WriteCameraModels(output);
+      status = "converged";
+    }else{
+      status = "not_converged";
+    }
+  }
+
+  // Manifest entry
+  std::string name;
+  std::string output;
+  std::vector<std::string> sequences;
+
+  std::unique_ptr<MultiModelCalibrator> calibrator;
+  std::vector<int> calib_cams;
+  int num_frames;
+
+  // Results, written by Open and Solve
+  std::string status;
+  int frames_tracked;
+  int frames_added;
+  std::vector<CameraModelFit> fits;
+  std::string model;
+  double mse;
+  double bic;
+  bool converged;
+  double detect_seconds;
+  double solve_seconds;
+
+ private:
+  std::mutex mutex_;
+  std::condition_variable all_detected_;
+  std::map<int, RigObservations> pending_;
+  int next_frame_;
+  int num_detected_;
+  std::chrono::steady_clock::time_point start_time_;
+};
+
+/// Read the manifest, returning false if it can't be read or a line is
+/// malformed.
+bool ReadManifest(const std::string& filename,
+                  std::vector<std::unique_ptr<Dataset>>& datasets)
+{
+  std::ifstream file(filename);
+  if(!file) {
+    std::cerr << "Unable to read manifest '" << filename << "'" << std::endl;
+    return false;
+  }
+
+  std::string line;
+  for(int line_no = 1; std::getline(file, line); ++line_no) {
+    std::istringstream tokens(line);
+    std::string name, output, sequence;
+    if(!(tokens >> name) || name[0] == '#') {
+      continue;
+    }
+    std::vector<std::string> sequences;
+    tokens >> output;
+    while(tokens >> sequence) {
+      sequences.push_back(sequence);
+    }
+    if(sequences.empty()) {
+      std::cerr << filename << ":" << line_no
+                << ": expected name, output and image sequences" << std::endl;
+      return false;
+    }
+    datasets.push_back(make_unique<Dataset>(name, output, sequences));
+  }
+  return true;
+}
+
+/// Frame of a dataset waiting for detection.
+struct DetectTask
+{
+  Dataset* dataset;
+  int frame;
+};
+
+int main( int argc, char** argv)
+{
+  GetPot cl(argc,argv);
+
+  if(cl.search(3, "-help", "-h", "?") || argc < 2) {
+    std::cout << usage_message << std::endl;
+    return -1;
+  }
+
+  ////////////////////////////////////////////////////////////////////
+  // Parse command line
+
+  BatchOptions options;
+  options.grid_size(0) = cl.follow((int) options.grid_size(0), "-grid-rows");
+  options.grid_size(1) = cl.follow((int) options.grid_size(1), "-grid-cols");
+
+  // Default grid printed on US Letter
+  options.grid_spacing = cl.follow(0.254 / (options.grid_size(0) - 1), "-grid-spacing");
+  options.grid_seed = cl.follow((int) options.grid_seed, "-grid-seed");
+  std::istringstream models(cl.follow("fov", 2, "-cameras", "-c"));
+  options.starting_models.clear();
+  for(std::string model; std::getline(models, model, ',');) {
+    options.starting_models.push_back(model);
+  }
+  options.fix_intrinsics = cl.search(2, "-fix-intrinsics", "-f");
+  options.first_index = cl.follow(options.first_index, "-first-index");
+  options.max_opt_time = cl.follow(options.max_opt_time, "-max-opt-time");
+  options.warm_start_frames = cl.follow(options.warm_start_frames, "-warm-start-frames");
+  options.max_frames = cl.follow(options.max_frames, "-max-frames");
+
+  CalibratorOptions& calib_options = options.calib_options;
+  calib_options.num_threads = cl.follow(calib_options.num_threads, "-solver-threads");
+  calib_options.max_solver_time_in_seconds =
+      cl.follow(calib_options.max_solver_time_in_seconds, "-max-solve-time");
+  const std::string linear_solver = cl.follow("", "-linear-solver");
+  if(!linear_solver.empty() &&
+     !ceres::StringToLinearSolverType(linear_solver,
+                                      &calib_options.linear_solver_type)) {
+    std::cerr << "Unknown linear solver: " << linear_solver << std::endl;
+    return -1;
+  }
+
+  const std::string threshold_method = cl.follow("gaussian", "-threshold");
+  if(threshold_method != "gaussian" && threshold_method != "integral") {
+    std::cerr << "Unknown threshold method: " << threshold_method << std::endl;
+    return -1;
+  }
+  const std::string conic_method = cl.follow("blobs", "-conics");
+  if(conic_method != "blobs" && conic_method != "labels") {
+    std::cerr << "Unknown conic method: " << conic_method << std::endl;
+    return -1;
+  }
+  options.conic_method = conic_method == "labels" ?
+      CONIC_FINDER_LABELS : CONIC_FINDER_BLOBS;
+
+  ParamsImageProcessing& proc_params = options.proc_params;
+  proc_params.black_on_white = true;
+  proc_params.at_threshold = 0.9;
+  proc_params.at_window_ratio = 30.0;
+  proc_params.threshold_method = threshold_method == "integral" ?
+      THRESHOLD_INTEGRAL : THRESHOLD_GAUSSIAN;
+  proc_params.pyramid_levels = cl.follow(0, "-pyramid-levels");
+
+  const unsigned int num_workers =
+      NumWorkerThreads(cl.follow(0, "-detect-threads"));
+  const int max_active = std::max(1, cl.follow(2, "-max-active"));
+  const std::string report_filename =
+      cl.follow("calibbatch.csv", 2, "-report", "-r");
+
+  if(options.starting_models.size() == 1 &&
+     !NewStartingCamera(options.starting_models[0], 640, 480)) {
+    options.starting_rig = ReadXmlRig(options.starting_models[0]);
+    if(!options.starting_rig || options.starting_rig->NumCams() == 0) {
+      std::cerr << "Unable to read starting cameras '"
+                << options.starting_models[0] << "'" << std::endl;
+      return -1;
+    }
+  }
+  for(const std::string& model : options.starting_models) {
+    if(options.starting_models.size() > 1 && !NewStartingCamera(model, 640, 480)) {
+      std::cerr << "Unknown camera model '" << model << "'" << std::endl;
+      return -1;
+    }
+  }
+
+  // Last argument - manifest
+  std::vector<std::unique_ptr<Dataset>> datasets;
+  if(!ReadManifest(argv[argc-1], datasets)) {
+    return -1;
+  }
+
+  ////////////////////////////////////////////////////////////////////
+  // A shared pool of workers detects the target in frames of every active
+  // dataset. Each active dataset has a runner which queues its frames, then
+  // waits for its calibrator to converge, so that one dataset solves while
+  // the frames of the others are detected.
+
+  BoundedQueue<DetectTask> tasks(2 * num_workers);
+
+  std::vector<std::thread> workers;
+  for(unsigned int w = 0; w < num_workers; ++w) {
+    workers.emplace_back([&]() {
+      // Buffers are reused between frames, and grow to the largest image
+      std::vector<std::unique_ptr<CameraDetector>> detectors;
+      std::vector<cv::Mat> images;
+      DetectTask task;
+      while(tasks.Pop(task)) {
+        Dataset& dataset = *task.dataset;
+        const size_t num_cams = dataset.sequences.size();
+        while(detectors.size() < num_cams) {
+          detectors.push_back(make_unique<CameraDetector>(
+              640, 480, options.grid_spacing, options.grid_size,
+              options.grid_seed));
+          detectors.back()->conic_finder.Params().method = options.conic_method;
+        }
+
+        // Poses are estimated with copies of the cameras as last published,
+        // as the dataset's solver may be updating them
+        const std::vector<std::shared_ptr<CameraInterface<double>>> cameras =
+            CopyCameras(*dataset.calibrator->GetCalibrator(0).Snapshot());
+
+        RigObservations detections(num_cams);
+        images.resize(num_cams);
+        for(size_t i = 0; i < num_cams; ++i) {
+          images[i] = cv::imread(
+              SequenceFilename(dataset.sequences[i],
+                               options.first_index + task.frame),
+              cv::IMREAD_GRAYSCALE);
+          if(!images[i].empty()) {
+            detectors[i]->Detect(images[i].data, images[i].cols, images[i].rows,
+                                 images[i].step, options.proc_params,
+                                 cameras[i], detections[i]);
+          }
+        }
+        dataset.Deliver(task.frame, detections, options);
+      }
+    });
+  }
+
+  std::atomic<size_t> next_dataset(0);
+  std::vector<std::thread> runners;
+  for(int r = 0; r < max_active; ++r) {
+    runners.emplace_back([&]() {
+      for(size_t d = next_dataset++; d < datasets.size(); d = next_dataset++) {
+        Dataset& dataset = *datasets[d];
+        if(dataset.Open(options)) {
+          for(int frame = 0; frame < dataset.num_frames; ++frame) {
+            tasks.Push(DetectTask{&dataset, frame});
+          }
+          dataset.Solve(options);
+        }
+        std::cout << dataset.name << ": " << dataset.status << ", "
+                  << dataset.frames_added << " frames, " << dataset.model
+                  << " mse " << dataset.mse << std::endl;
+      }
+    });
+  }
+
+  for(std::thread& runner : runners) {
+    runner.join();
+  }
+  tasks.Close();
+  for(std::thread& worker : workers) {
+    worker.join();
+  }
+
+  ////////////////////////////////////////////////////////////////////
+  // Summarise the batch
+
+  std::ofstream report(report_filename);
+  report << "name,status,frames,frames_tracked,frames_added,model,mse,bic,"
+            "candidates,detect_seconds,solve_seconds,output\n";
+  int num_converged = 0;
+  for(const std::unique_ptr<Dataset>& dataset : datasets) {
+    report << dataset->name << "," << dataset->status << ","
+           << dataset->num_frames << "," << dataset->frames_tracked << ","
+           << dataset->frames_added << "," << dataset->model << ","
+           << dataset->mse << "," << dataset->bic << ",";
+    // Every candidate as model:mse:bic, separated by spaces
+    for(size_t m = 0; m < dataset->fits.size(); ++m) {
+      const CameraModelFit& fit = dataset->fits[m];
+      report << (m ? " " : "") << fit.model << ":" << fit.mse << ":" << fit.bic;
+    }
+    report << ","
+           << dataset->detect_seconds << "," << dataset->solve_seconds << ","
+           << (dataset->converged ? dataset->output : "") << "\n";
+    num_converged += dataset->converged;
+  }
+
+  std::cout << num_converged << " of " << datasets.size()
+            << " datasets converged, see " << report_filename << std::endl;
+  return num_converged == (int)datasets.size() ? 0 : 1;
+}
@@ -1,5 +1,11 @@
-#include <unistd.h>
+#include <sys/stat.h>
+#include <atomic>
+#include <cstdio>
+#include <limits>
+#include <map>
 #include <memory>
+#include <mutex>
+#include <sstream>
 
 #include <pangolin/pangolin.h>
 #include <pangolin/gldraw.h>
@@ -7,16 +13,20 @@
 #include <sophus/se3.hpp>
 
 #include <calibu/calib/Calibrator.h>
+#include <calibu/image/FramePrefilter.h>
 #include <calibu/image/ImageProcessing.h>
 #include <calibu/target/TargetGridDot.h>
 #include <calibu/target/RandomGrid.h>
 #include <calibu/gl/Drawing.h>
 #include <calibu/pose/Pnp.h>
 #include <calibu/conics/ConicFinder.h>
+#include <calibu/utils/Parallel.h>
+#include <calibu/utils/PipelineStats.h>
 
 #include <cvars/CVar.h>
 
 #include "GetPot"
+#include "CalibPipeline.h"
 
 using namespace calibu;
 
@@ -30,11 +40,48 @@ const char* usage_message =
     "\t-grid-spacing <value>  Distance between circles in grid\n"
     "\t-grid-seed <value>     Random seed used when creating grid (=71)\n"
     "\t-fix-intrinsics,-f     Fix camera intrinsics during optimisation.\n"
+    "\t-no-init-intrinsics    Start cameras without -cameras files from a generic\n"
+    "\t                       guess, rather than estimating their intrinsics in\n"
+    "\t                       closed form when the optimiser first starts.\n"
     "\t-paused,-p             Start video paused.\n"
     "\t-grid-rows <value>	  Number of rows in the grid pattern.\n"
     "\t-grid-cols <value>     Number of columns in the grid pattern.\n"
     "\t-no-gui                Run without gui.\n"
     "\t-max-opt-time <value>  Max time in seconds allowed to the optimiser.\n"
+    "\t-detect-threads <value> Threads used for target detection (=0, one per core).\n"
+    "\t-warm-start-frames <value> Frames read before the optimiser starts (=10).\n"
+    "\t-max-frames <value>    Maximum number of frames used (=0, unlimited).\n"
+    "\t-min-sharpness <value> Skip frames, before detecting the target, with an image\n"
+    "\t                       whose Laplacian variance is below this (=0, disabled).\n"
+    "\t-min-difference <value> Skip frames, before detecting the target, whose 1/8\n"
+    "\t                       scale images differ from the last frame kept by less\n"
+    "\t                       than this mean grey level (=0, disabled).\n"
+    "\t-keyframe-angle <deg>  Skip frames rotated less than this from an added frame,\n"
+    "\t-keyframe-distance <value> and moved less than this distance (=0, disabled).\n"
+    "\t-keyframe-cells <value> Keep frames covering this many new cells of an 8x6\n"
+    "\t                       image grid, even if they fail the keyframe tests above.\n"
+    "\t                       Used alone, every frame is kept once the grid is\n"
+    "\t                       covered (=0, disabled).\n"
+    "\t-obs-per-cell <value>  Keep at most this many observations in each cell of a\n"
+    "\t                       16x12 image grid, preferring sparse cells (=0, all).\n"
+    "\t-solver-threads <value> Threads used by the optimiser (=4).\n"
+    "\t-linear-solver <type>  Ceres linear solver, e.g. SPARSE_SCHUR or ITERATIVE_SCHUR.\n"
+    "\t-max-solve-time <value> Max time in seconds for each solver run.\n"
+    "\t-outlier-threshold <px> Drop observations reprojecting further than this once\n"
+    "\t                       the optimiser converges (=0, keep all).\n"
+    "\t-checkpoint <file>     Save the optimiser state to file every minute and on\n"
+    "\t                       stopping, see Calibrator::LoadCheckpoint.\n"
+    "\t-report <file>         Write reprojection residual statistics and image\n"
+    "\t                       coverage maps of each camera to a JSON file.\n"
+    "\t-threshold <method>    Adaptive threshold, gaussian or integral (=gaussian).\n"
+    "\t-pyramid-levels <value> Detect dots at 1/2^value resolution (=0).\n"
+    "\t-conics <method>       Conic detection, blobs or labels (=blobs).\n"
+    "\t-cuda                  Threshold and label images, and find conics from the\n"
+    "\t                       labels' moments, on the GPU. Needs a BUILD_CUDA build.\n"
+    "\t-detection-cache <dir> Directory of target detections kept between runs.\n"
+    "\t                       Without the gui, a video already detected with the\n"
+    "\t                       same parameters is calibrated from its detections\n"
+    "\t                       without being decoded again.\n"
     "e.g.:\n"
     "\tcalibgrid -c leftcam.xml -c rightcaml.xml video_uri\n\n"
     "Video URI's take the following form:\n"
@@ -73,6 +120,72 @@ const char* usage_message =
     "split - split a single stream video into a multi stream video based on memory offset\n"
     " e.g. \"split:[mem1=20480:640x480:640:GRAY8,mem2=573440:1280x720:1280:GRAY8]//files:///home/user/sequence/foo%03d.pgm\"\n\n";
 
+/// Run detection for every camera stream, using up to num_threads threads.
+void DetectAll(std::vector<std::unique_ptr<CameraDetector>>& detectors,
+               const std::vector<pangolin::Image<unsigned char> >& images,
+               const ParamsImageProcessing& params,
+               const std::vector<std::shared_ptr<CameraInterface<double>>>& cameras,
+               RigObservations& results, unsigned int num_threads)
+{
+  results.resize(detectors.size());
+  ParallelForBands((int)detectors.size(), num_threads,
+                   [&](int begin, int end) {
+    for(int i = begin; i < end; ++i) {
+      detectors[i]->Detect(images[i].ptr, images[i].w, images[i].h,
+                           images[i].pitch, params, cameras[i], results[i]);
+    }
+  });
+}
+
+/// Whether prefilter keeps the frame made of images, see FramePrefilter.
+bool PrefilterFrame(FramePrefilter& prefilter,
+                    const std::vector<pangolin::Image<unsigned char> >& images)
+{
+  std::vector<PrefilterImage> views;
+  for(const pangolin::Image<unsigned char>& image : images) {
+    views.push_back(PrefilterImage{image.ptr, image.w, image.h, image.pitch});
+  }
+  return prefilter.Accept(views.data(), views.size());
+}
+
+/// Synchronised images from all streams, owning their pixel buffer.
+struct GrabbedFrame
+{
+  GrabbedFrame(size_t size_bytes) : index(-1), buffer(size_bytes) {}
+
+  int index;
+  std::vector<unsigned char> buffer;
+  std::vector<pangolin::Image<unsigned char> > images;
+};
+
+/// Detections for every camera of one grabbed frame.
+struct FrameDetections
+{
+  int index;
+  RigObservations cameras;
+
+  // As detected, for the detection cache
+  CachedFrameDetection detected;
+};
+
+/// Identify the video at 'uri' for the detection cache, by the URI and
+/// the size and modification time of the file it names, if any.
+std::string VideoSourceId(const std::string& uri)
+{
+  // Files follow the scheme and its parameters, e.g. file:[realtime=1]///path
+  const size_t path = uri.find("//");
+  const std::string filename =
+      path == std::string::npos ? uri : uri.substr(path + 2);
+
+  std::ostringstream id;
+  id << uri;
+  struct stat st;
+  if(stat(filename.c_str(), &st) == 0) {
+    id << ":" << st.st_size << ":" << st.st_mtime;
+  }
+  return id.str();
+}
+
 int main( int argc, char** argv)
 {
   ////////////////////////////////////////////////////////////////////
@@ -116,30 +229,27 @@ int main( int argc, char** argv)
   // By default allow at most 120 sec to the optimizer (in cl mode).
   int max_opt_time = 120;
 
-  ////////////////////////////////////////////////////////////////////
-  // Setup Video Source
+  // By default detect in all camera streams at once.
+  int detect_threads = 0;
 
-  // Last argument - Video URI
-  std::string video_uri = argv[argc-1];
+  // Start optimising after this many frames (in cl mode).
+  int warm_start_frames = 10;
 
-  pangolin::VideoInput video(video_uri);
+  // By default use every frame the target is tracked in.
+  int max_frames = 0;
+  double keyframe_angle = 0;
+  double keyframe_distance = 0;
+  int keyframe_cells = 0;
+  int obs_per_cell = 0;
 
-  // Vector of images (that will point into buffer)
-  unsigned char image_buffer[video.SizeBytes()];
-  std::vector<pangolin::Image<unsigned char> > images;
+  // By default detect dots at full resolution.
+  int pyramid_levels = 0;
 
-  const size_t N = video.Streams().size();
-  size_t maxw = 0;
-  size_t maxh = 0;
+  // Solve with the calibrator's default settings unless asked otherwise.
+  CalibratorOptions calib_options;
 
-  // Check all channels are greyscale and find max width / height
-  for(size_t i=0; i<N; ++i) {
-    if( video.Streams()[i].PixFormat().channels != 1) {
-      throw pangolin::VideoException("Video channels must be GRAY8 format. Use Convert:[fmt=GRAY8]// video scheme.");
-    }
-    maxw = std::max(maxw, video.Streams()[i].Width() );
-    maxh = std::max(maxh, video.Streams()[i].Height() );
-  }
+  // Last argument - Video URI
+  std::string video_uri = argv[argc-1];
 
   ////////////////////////////////////////////////////////////////////
   // Parse command line
@@ -154,10 +264,137 @@ int main( int argc, char** argv)
   grid_spacing = cl.follow(grid_spacing, "-grid-spacing");
   grid_seed = cl.follow((int) grid_seed, "-grid-seed");
   fix_intrinsics = cl.search(2, "-fix-intrinsics", "-f");
+  const bool init_intrinsics = !cl.search(1, "-no-init-intrinsics");
   start_paused = cl.search(2, "-paused", "-p");
   output_filename = cl.follow(output_filename.c_str(), 2, "-output", "-o");
   gui = !cl.search(1, "-no-gui");
   max_opt_time = cl.follow((int) max_opt_time, "-max-opt_time");
+  detect_threads = cl.follow((int) detect_threads, "-detect-threads");
+  warm_start_frames = cl.follow((int) warm_start_frames, "-warm-start-frames");
+  max_frames = cl.follow((int) max_frames, "-max-frames");
+  ParamsFramePrefilter prefilter_params;
+  prefilter_params.min_sharpness = cl.follow(0.0, "-min-sharpness");
+  prefilter_params.min_difference = cl.follow(0.0, "-min-difference");
+  keyframe_angle = cl.follow(keyframe_angle, "-keyframe-angle");
+  keyframe_distance = cl.follow(keyframe_distance, "-keyframe-distance");
+  keyframe_cells = cl.follow((int) keyframe_cells, "-keyframe-cells");
+  obs_per_cell = cl.follow((int) obs_per_cell, "-obs-per-cell");
+  calib_options.num_threads = cl.follow(calib_options.num_threads, "-solver-threads");
+  calib_options.max_solver_time_in_seconds =
+      cl.follow(calib_options.max_solver_time_in_seconds, "-max-solve-time");
+  calib_options.outlier_threshold =
+      cl.follow(calib_options.outlier_threshold, "-outlier-threshold");
+  const std::string checkpoint_filename = cl.follow("", "-checkpoint");
+  const std::string report_filename = cl.follow("", "-report");
+  const std::string linear_solver = cl.follow("", "-linear-solver");
+  if(!linear_solver.empty() &&
+     !ceres::StringToLinearSolverType(linear_solver,
+                                      &calib_options.linear_solver_type)) {
+    std::cerr << "Unknown linear solver: " << linear_solver << std::endl;
+    return -1;
+  }
+  pyramid_levels = cl.follow((int) pyramid_levels, "-pyramid-levels");
+  const std::string threshold_method = cl.follow("gaussian", "-threshold");
+  if(threshold_method != "gaussian" && threshold_method != "integral") {
+    std::cerr << "Unknown threshold method: " << threshold_method << std::endl;
+    return -1;
+  }
+  const std::string conic_method = cl.follow("blobs", "-conics");
+  if(conic_method != "blobs" && conic_method != "labels") {
+    std::cerr << "Unknown conic method: " << conic_method << std::endl;
+    return -1;
+  }
+  const std::string detection_cache_dir = cl.follow("", "-detection-cache");
+
+  ////////////////////////////////////////////////////////////////////
+  // Setup image processing pipeline
+
+  ParamsImageProcessing proc_params;
+  proc_params.black_on_white = true;
+  proc_params.at_threshold = 0.9;
+  proc_params.at_window_ratio = 30.0;
+  proc_params.threshold_method = threshold_method == "integral" ?
+      THRESHOLD_INTEGRAL : THRESHOLD_GAUSSIAN;
+  proc_params.pyramid_levels = pyramid_levels;
+  proc_params.use_cuda = cl.search(1, "-cuda");
+#ifndef HAVE_CUDA
+  if(proc_params.use_cuda) {
+    std::cerr << "Calibu was built without CUDA, ignoring -cuda" << std::endl;
+    proc_params.use_cuda = false;
+  }
+#endif
+
+  CVarUtils::AttachCVar("proc.adaptive.threshold", &proc_params.at_threshold);
+  CVarUtils::AttachCVar("proc.adaptive.window_ratio", &proc_params.at_window_ratio);
+  CVarUtils::AttachCVar("proc.black_on_white", &proc_params.black_on_white);
+
+  ParamsConicFinder conic_params = CameraDetector::DefaultConicParams();
+  conic_params.method = conic_method == "labels" ?
+      CONIC_FINDER_LABELS : CONIC_FINDER_BLOBS;
+
+  ////////////////////////////////////////////////////////////////////
+  // Read detections cached by an earlier run on the same video with the
+  // same detection parameters, which then needn't be decoded (in cl mode).
+
+  DetectionCache detection_cache;
+  std::string detection_cache_filename;
+  bool have_cached_detections = false;
+
+  if(!detection_cache_dir.empty()) {
+    // The prefilter changes which frames are detected
+    std::ostringstream source;
+    source << VideoSourceId(video_uri);
+    if(prefilter_params.min_sharpness > 0 || prefilter_params.min_difference > 0) {
+      source << ":prefilter:" << prefilter_params.min_sharpness << ":"
+             << prefilter_params.min_difference << ":"
+             << prefilter_params.thumbnail_scale;
+    }
+    const uint64_t key = DetectionCacheHash(
+        source.str(), proc_params, conic_params, ParamsGridDot(),
+        grid_spacing, grid_size, grid_seed);
+    char name[32];
+    snprintf(name, sizeof(name), "%016llx.detections", (unsigned long long) key);
+    detection_cache_filename = detection_cache_dir + "/" + name;
+
+    have_cached_detections = !gui &&
+        detection_cache.Load(detection_cache_filename, key);
+    if(have_cached_detections) {
+      std::cout << "Read detections of " << detection_cache.frames.size()
+                << " frames from " << detection_cache_filename << std::endl;
+    }
+    detection_cache.key = key;
+  }
+
+  ////////////////////////////////////////////////////////////////////
+  // Setup Video Source
+
+  std::unique_ptr<pangolin::VideoInput> video;
+  std::vector<Eigen::Vector2i> image_sizes;
+
+  if(have_cached_detections) {
+    image_sizes = detection_cache.image_sizes;
+  }else{
+    video.reset(new pangolin::VideoInput(video_uri));
+
+    // Check all channels are greyscale
+    for(size_t i=0; i<video->Streams().size(); ++i) {
+      if( video->Streams()[i].PixFormat().channels != 1) {
+        throw pangolin::VideoException("Video channels must be GRAY8 format. Use Convert:[fmt=GRAY8]// video scheme.");
+      }
+      image_sizes.push_back(Eigen::Vector2i(video->Streams()[i].Width(),
+                                            video->Streams()[i].Height()));
+    }
+    detection_cache.image_sizes = image_sizes;
+  }
+
+  // Find max width / height
+  const size_t N = image_sizes.size();
+  size_t maxw = 0;
+  size_t maxh = 0;
+  for(size_t i=0; i<N; ++i) {
+    maxw = std::max(maxw, (size_t)image_sizes[i][0] );
+    maxh = std::max(maxh, (size_t)image_sizes[i][1] );
+  }
 
   // Load camera hints from command line
   cl.disable_loop();
@@ -166,36 +403,12 @@ int main( int argc, char** argv)
       !filename.empty(); filename = cl.follow("",2,"-cameras","-c") ) {
     const size_t i = input_cameras.size();
     if(i < N) {
-      const int w_i = video.Streams()[i].Width();
-      const int h_i = video.Streams()[i].Height();
-
-      if(filename == "fov") {
-        Eigen::Vector2i size_;
-        Eigen::VectorXd params_(FovCamera<double>::NumParams);
-        size_ << w_i, h_i;
-        params_ << 300, 300, w_i/2.0, h_i/2.0, 0.2;
-        std::shared_ptr<CameraInterface<double>> starting_cam(new FovCamera<double>(params_, size_));
-        input_cameras.push_back( CameraAndPose(starting_cam, Sophus::SE3d() ) );
-      }else if(filename == "poly2") {
-        Eigen::Vector2i size_;
-        Eigen::VectorXd params_(Poly2Camera<double>::NumParams);
-        size_ << w_i, h_i;
-        params_ << 300, 300, w_i/2.0, h_i/2.0, 0.0, 0.0, 0.0;
-        std::shared_ptr<CameraInterface<double>> starting_cam(new Poly2Camera<double>(params_, size_));
-        input_cameras.push_back( CameraAndPose(starting_cam, Sophus::SE3d() ) );
-      }else if(filename == "poly3" || filename =="poly") {
-        Eigen::Vector2i size_;
-        Eigen::VectorXd params_(Poly3Camera<double>::NumParams);
-        size_ << w_i, h_i;
-        params_ << 300, 300, w_i/2.0, h_i/2.0, 0.0, 0.0, 0.0;
-        std::shared_ptr<CameraInterface<double>> starting_cam(new Poly3Camera<double>(params_, size_));
-        input_cameras.push_back( CameraAndPose(starting_cam, Sophus::SE3d() ) );
-      }else if(filename == "kb4") {
-        Eigen::Vector2i size_;
-        Eigen::VectorXd params_(KannalaBrandtCamera<double>::NumParams);
-        size_ << w_i, h_i;
-        params_ << 300, 300, w_i/2.0, h_i/2.0, 0.0, 0.0, 0.0, 0.0;
-        std::shared_ptr<CameraInterface<double>> starting_cam(new KannalaBrandtCamera<double>(params_, size_));
+      const int w_i = image_sizes[i][0];
+      const int h_i = image_sizes[i][1];
+
+      const std::shared_ptr<CameraInterface<double>> starting_cam =
+          NewStartingCamera(filename, w_i, h_i);
+      if(starting_cam) {
         input_cameras.push_back( CameraAndPose(starting_cam, Sophus::SE3d() ) );
       }else{
         const std::shared_ptr<Rig<double>> rig = ReadXmlRig(filename);
@@ -214,28 +427,22 @@ int main( int argc, char** argv)
     return -1;
   }
 
-  ////////////////////////////////////////////////////////////////////
-  // Setup image processing pipeline
-
-  ImageProcessing image_processing(maxw, maxh);
-  image_processing.Params().black_on_white = true;
-  image_processing.Params().at_threshold = 0.9;
-  image_processing.Params().at_window_ratio = 30.0;
-
-  CVarUtils::AttachCVar("proc.adaptive.threshold", &image_processing.Params().at_threshold);
-  CVarUtils::AttachCVar("proc.adaptive.window_ratio", &image_processing.Params().at_window_ratio);
-  CVarUtils::AttachCVar("proc.black_on_white", &image_processing.Params().black_on_white);
-
   ////////////////////////////////////////////////////////////////////
   // Setup Grid pattern
 
-  ConicFinder conic_finder;
-  conic_finder.Params().conic_min_area = 4.0;
-  conic_finder.Params().conic_min_density = 0.6;
-  conic_finder.Params().conic_min_aspect = 0.2;
-
   TargetGridDot target( grid_spacing, grid_size, grid_seed );
 
+  // One detection context per camera stream
+  auto make_detectors = [&]() {
+    std::vector<std::unique_ptr<CameraDetector>> detectors;
+    for(size_t i=0; i<N; ++i) {
+      detectors.push_back( make_unique<CameraDetector>(
+          maxw, maxh, grid_spacing, grid_size, grid_seed) );
+      detectors.back()->conic_finder.Params() = conic_params;
+    }
+    return detectors;
+  };
+
   double rad0 = 0.003; // cm
   double rad1 = 0.005; // cm
   double pts_per_unit = 2834.64567;
@@ -245,40 +452,74 @@ int main( int argc, char** argv)
   ////////////////////////////////////////////////////////////////////
   // Initialize Calibration object and tracking params
 
-  Calibrator calibrator;
+  Calibrator calibrator(calib_options);
   calibrator.FixCameraIntrinsics(fix_intrinsics);
 
   int calib_cams[N];
-  bool tracking_good[N];
-  std::vector<Sophus::SE3d> T_hw;
-  T_hw.resize(N);
 
   for(size_t i=0; i<N; ++i) {
-    const int w_i = video.Streams()[i].Width();
-    const int h_i = video.Streams()[i].Height();
+    const int w_i = image_sizes[i][0];
+    const int h_i = image_sizes[i][1];
     if(i < input_cameras.size() ) {
       calib_cams[i] = calibrator.AddCamera(
           input_cameras[i].camera, input_cameras[i].T_ck
                                            );
     }else{
       // Generic starting set of parameters.
-      Eigen::Vector2i size_;
-      Eigen::VectorXd params_(FovCamera<double>::NumParams);
-      size_ << w_i, h_i;
-      params_ << 300, 300, w_i/2.0, h_i/2.0, 0.2;
-      std::shared_ptr<FovCamera<double>>
-          starting_cam(new FovCamera<double>(params_, size_));
-
-      calib_cams[i] = calibrator.AddCamera( starting_cam, Sophus::SE3d() );
+      calib_cams[i] = calibrator.AddCamera( NewStartingCamera("fov", w_i, h_i),
+                                            Sophus::SE3d() );
     }
   }
 
+  // Cameras without a starting file are initialised from the frames added
+  // so far, once, before the optimiser first starts.
+  std::vector<bool> uninitialized(N, false);
+  for(size_t i=input_cameras.size(); i<N; ++i) {
+    uninitialized[i] = init_intrinsics && !fix_intrinsics;
+  }
+  const int* cam_ids = calib_cams;
+  auto start_calibrator = [&]() {
+    for(size_t i=0; i<N; ++i) {
+      if(uninitialized[i] && calibrator.InitializeIntrinsics(cam_ids[i])) {
+        uninitialized[i] = false;
+      }
+    }
+    std::cout<<"Optimization started"<<std::endl;
+    calibrator.Start();
+  };
+
+  // Reject frames which add little to those already selected
+  std::vector<std::shared_ptr<FrameSelector>> selectors;
+  if(keyframe_angle > 0 || keyframe_distance > 0) {
+    // An unset threshold places no constraint on the other
+    const double inf = std::numeric_limits<double>::infinity();
+    selectors.push_back(std::make_shared<MotionFrameSelector>(
+        keyframe_angle > 0 ? keyframe_angle * M_PI / 180.0 : inf,
+        keyframe_distance > 0 ? keyframe_distance : inf));
+  }
+  if(keyframe_cells > 0) {
+    // Alone, it would reject every frame once the grid is covered
+    selectors.push_back(std::make_shared<CoverageFrameSelector>(
+        image_sizes, 8, 6, keyframe_cells, selectors.empty()));
+  }
+  if(!selectors.empty()) {
+    calibrator.SetFrameSelector(std::make_shared<AnyFrameSelector>(selectors));
+  }
+  calibrator.SetMaxFrames(max_frames);
+  calibrator.SetCheckpointFile(checkpoint_filename);
+
+  // Balance observations over the image, rather than the centre
+  if(obs_per_cell > 0) {
+    calibrator.SetObservationSelector(
+          std::make_shared<BinnedObservationSelector>(image_sizes, obs_per_cell));
+  }
+
   if (gui) {
     ////////////////////////////////////////////////////////////////////
     // Setup GUI
 
     const int PANEL_WIDTH = 150;
-    pangolin::CreateWindowAndBind("Main",(N+1)*video.Streams()[0].Width()/2.0+PANEL_WIDTH,video.Streams()[0].Height()/2.0);
+    pangolin::CreateWindowAndBind("Main",(N+1)*image_sizes[0][0]/2.0+PANEL_WIDTH,image_sizes[0][1]/2.0);
 
     // Make things look prettier...
     glEnable(GL_LINE_SMOOTH);
@@ -299,7 +540,7 @@ int main( int argc, char** argv)
         .SetLayout(pangolin::LayoutEqual);
 
     // Add view for each camera stream
-    const float aspect = (float)video.Streams()[0].Width() / (float)video.Streams()[0].Height();
+    const float aspect = (float)image_sizes[0][0] / (float)image_sizes[0][1];
     for(size_t c=0; c < N; ++c) {
       container.AddDisplay( pangolin::CreateDisplay().SetAspect(aspect) );
     }
@@ -324,9 +565,16 @@ int main( int argc, char** argv)
     tex.resize(N);
 #endif
     for(unsigned int i=0; i<N; ++i) {
-      tex[i].Reinitialise(video.Streams()[i].Width(),video.Streams()[i].Height(),GL_LUMINANCE8);
+      tex[i].Reinitialise(image_sizes[i][0],image_sizes[i][1],GL_LUMINANCE8);
     }
 
+    std::vector<std::unique_ptr<CameraDetector>> detectors = make_detectors();
+    RigObservations results;
+
+    // Vector of images (that will point into buffer)
+    std::vector<unsigned char> image_buffer(video->SizeBytes());
+    std::vector<pangolin::Image<unsigned char> > images;
+
     ////////////////////////////////////////////////////////////////////
     // Display Variables
 
@@ -351,7 +599,7 @@ int main( int argc, char** argv)
       pangolin::RegisterKeyPressCallback('1'+i, [&container,i](){container[i].ToggleShow();} );
     }
 
-    pangolin::RegisterKeyPressCallback('[', [&](){calibrator.Start();} );
+    pangolin::RegisterKeyPressCallback('[', [&](){start_calibrator();} );
     pangolin::RegisterKeyPressCallback(']', [&](){calibrator.Stop();} );
 
     bool step = false;
@@ -366,13 +614,11 @@ int main( int argc, char** argv)
     for(int frame=0; !pangolin::ShouldQuit();){
       const bool go = (frame==0) || run || pangolin::Pushed(step);
 
-      int calib_frame = -1;
+      bool add_frame = false;
 
       if( go ) {
-        if( video.Grab(image_buffer, images, true, true) ) {
-          if(add) {
-            calib_frame = calibrator.AddFrame(Sophus::SE3d(Sophus::SO3d(), Eigen::Vector3d(0,0,1000)) );
-          }
+        if( video->Grab(image_buffer.data(), images, true, true) ) {
+          add_frame = add;
           ++frame;
         }else{
           run = false;
@@ -381,54 +627,25 @@ int main( int argc, char** argv)
 
       glClear(GL_DEPTH_BUFFER_BIT | GL_COLOR_BUFFER_BIT);
 
-      for(size_t iI = 0; iI < N; ++iI)
-      {
-        image_processing.Process( images[iI].ptr, images[iI].w, images[iI].h, images[iI].pitch );
-        conic_finder.Find( image_processing );
-
-        const std::vector<Conic, Eigen::aligned_allocator<Conic> >& conics =
-            conic_finder.Conics();
-        std::vector<int> ellipse_target_map;
-
-        tracking_good[iI] = target.FindTarget(
-            image_processing, conic_finder.Conics(),
-            ellipse_target_map
-                                              );
-
-        if(tracking_good[iI]) {
-          // Generate map and point structures
-          std::vector<Eigen::Vector2d,
-                      Eigen::aligned_allocator<Eigen::Vector2d> > ellipses;
-          for( size_t i=0; i < conics.size(); ++i ) {
-            ellipses.push_back(conics[i].center);
-          }
+      // Detect target in all camera streams concurrently, estimating poses
+      // with copies of the cameras as the running optimiser last published
+      DetectAll(detectors, images, proc_params,
+                CopyCameras(*calibrator.Snapshot()), results, detect_threads);
 
-          // find camera pose given intrinsics
-          PosePnPRansac(
-              calibrator.GetCamera(iI).camera, ellipses, target.Circles3D(),
-              ellipse_target_map,
-              0, 0, &T_hw[iI]
-                        );
-
-          if(calib_frame >= 0) {
-            if(iI==0 || !tracking_good[0]) {
-              // Initialize pose of frame for least squares optimisation
-              calibrator.GetFrame(calib_frame) = T_hw[iI];
-            }
+      if(add_frame) {
+        AddDetections(results, calib_cams, calibrator);
+      }
 
-            for(size_t p=0; p < ellipses.size(); ++p) {
-              const Eigen::Vector2d pc = ellipses[p];
-              const Eigen::Vector2i pg = target.Map()[p].pg;
+      for(size_t iI = 0; iI < N; ++iI)
+      {
+        const CameraDetector& detector = *detectors[iI];
+        const ImageProcessing& image_processing = detector.image_processing;
+        const TargetGridDot& target = detector.target;
+        const bool tracking_good = results[iI].tracking_good;
+        const Sophus::SE3d& T_hw = results[iI].T_hw;
 
-              if( 0<= pg(0) && pg(0) < grid_size(0) &&  0<= pg(1) && pg(1) < grid_size(1) ) {
-                const Eigen::Vector3d pg3d = grid_spacing * Eigen::Vector3d(pg(0), pg(1), 0);
-                // TODO: Add these correspondences in bulk to avoid
-                //       hitting mutex each time.
-                calibrator.AddObservation( calib_frame, calib_cams[iI], pg3d, pc );
-              }
-            }
-          }
-        }
+        const ConicSet& conics =
+            detector.conic_finder.Conics();
 
         if(container[iI].IsShown()) {
           container[iI].ActivateScissorAndClear();
@@ -436,7 +653,10 @@ int main( int argc, char** argv)
 
           // Display camera image
           if(!disp_thresh) {
+            // Input image is read in place, rows may be padded
+            glPixelStorei(GL_UNPACK_ROW_LENGTH, image_processing.ImgPitch());
             tex[iI].Upload(image_processing.Img(),GL_LUMINANCE,GL_UNSIGNED_BYTE);
+            glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
             tex[iI].RenderToViewportFlipY();
           }else{
             tex[iI].Upload(image_processing.ImgThresh(),GL_LUMINANCE,GL_UNSIGNED_BYTE);
@@ -455,25 +675,27 @@ int main( int argc, char** argv)
               glBegin(GL_LINE_STRIP);
               for(std::list<size_t>::const_iterator el = i->ops.begin(); el != i->ops.end(); ++el)
               {
-                const Eigen::Vector2d p = conics[*el].center;
+                const Eigen::Vector2d p = conics.Center(*el);
                 glVertex2d(p(0), p(1));
               }
               glEnd();
             }
           }
 
-          if( tracking_good[iI] && disp_barcode ) {
+          if( tracking_good && disp_barcode ) {
             const std::vector<Eigen::Vector3d,
                               Eigen::aligned_allocator<Eigen::Vector3d> >&
                 codepts = target.Code3D();
-            const calibu::CameraAndPose cap= calibrator.GetCamera(iI);
+            // The optimiser may be running, so project with its published camera
+            const std::shared_ptr<const CameraSnapshot<double>> camera =
+                calibrator.Snapshot()->cameras[iI];
             const unsigned char* im = image_processing.ImgThresh();
             unsigned char id = 0;
             bool found = true;
             for( size_t c = 0; c < codepts.size(); c++ ){
               const Eigen::Vector3d& xwp = codepts[c];
               Eigen::Vector2d pt;
-              pt = cap.camera->Project( T_hw[iI]*xwp );
+              pt = camera->Project( T_hw*xwp );
               if( pt[0] < 10 || pt[0] >= images[iI].w-10 ||
                   pt[1] < 10 || pt[1] >= images[iI].h-10 ) {
                 found = false;
@@ -495,18 +717,18 @@ int main( int argc, char** argv)
 
           if(disp_cross) {
             for( size_t i=0; i < conics.size(); ++i ) {
-              const Eigen::Vector2d pc = conics[i].center;
+              const Eigen::Vector2d pc = conics.Center(i);
               pangolin::glColorBin( target.Map()[i].value, 2);
-              pangolin::glDrawCross(pc, conics[i].bbox.Width()*0.75 );
+              pangolin::glDrawCross(pc, conics.BBox(i).Width()*0.75 );
             }
           }
 
           if(disp_bbox) {
             for( size_t i=0; i < conics.size(); ++i ) {
-              const Eigen::Vector2i pg = tracking_good[iI] ? target.Map()[i].pg : Eigen::Vector2i(0,0);
+              const Eigen::Vector2i pg = tracking_good ? target.Map()[i].pg : Eigen::Vector2i(0,0);
               if( 0<= pg(0) && pg(0) < grid_size(0) &&  0<= pg(1) && pg(1) < grid_size(1) ) {
                 pangolin::glColorBin(pg(1)*grid_size(0)+pg(0), grid_size(0)*grid_size(1));
-                glDrawRectPerimeter(conics[i].bbox);
+                glDrawRectPerimeter(conics.BBox(i));
               }
             }
           }
@@ -527,25 +749,27 @@ int main( int argc, char** argv)
           }
         }
 
-        for(size_t c=0; c< calibrator.NumCameras(); ++c) {
-          const int w_i = video.Streams()[c].Width();
-          const int h_i = video.Streams()[c].Height();
+        // The optimiser may be running, so draw its published state
+        const std::shared_ptr<const CalibratorSnapshot> snapshot =
+            calibrator.Snapshot();
 
-          const Eigen::Matrix3d Kinv = calibrator.GetCamera(c).camera->K().inverse();
+        for(size_t c=0; c< snapshot->T_ck.size(); ++c) {
+          const int w_i = image_sizes[c][0];
+          const int h_i = image_sizes[c][1];
 
-          const CameraAndPose cap = calibrator.GetCamera(c);
-          const Sophus::SE3d T_ck = cap.T_ck;
+          const Eigen::Matrix3d Kinv = snapshot->K[c].inverse();
+          const Sophus::SE3d& T_ck = snapshot->T_ck[c];
 
           // Draw keyframes
           pangolin::glColorBin(c, 2, 0.2);
-          for(size_t k=0; k< calibrator.NumFrames(); ++k) {
-            pangolin::glDrawAxis((T_ck * calibrator.GetFrame(k)).inverse().matrix(), 0.01);
+          for(const Sophus::SE3d& T_kw : snapshot->T_kw) {
+            pangolin::glDrawAxis((T_ck * T_kw).inverse().matrix(), 0.01);
           }
 
           // Draw current camera
-          if(tracking_good[c]) {
+          if(results[c].tracking_good) {
             pangolin::glColorBin(c, 2, 0.5);
-            pangolin::glDrawFrustrum(Kinv,w_i,h_i,T_hw[c].inverse().matrix(),0.05);
+            pangolin::glDrawFrustrum(Kinv,w_i,h_i,results[c].T_hw.inverse().matrix(),0.05);
           }
         }
       }
@@ -557,82 +781,167 @@ int main( int argc, char** argv)
       pangolin::FinishFrame();
     }
 
-  } else {
+  } else if(have_cached_detections) {
 
     ////////////////////////////////////////////////////////////////////
-    // Main event loop
-
-    bool valid_frame = video.Grab(image_buffer, images, true, true);
+    // Replay cached detections, estimating target poses with the starting
+    // cameras of this run.
+
+    std::vector<std::unique_ptr<CameraDetector>> detectors = make_detectors();
+    RigObservations results(N);
+
+    for(size_t f = 0; f < detection_cache.frames.size(); ++f) {
+      const std::vector<std::shared_ptr<CameraInterface<double>>> cameras =
+          CopyCameras(*calibrator.Snapshot());
+      for(size_t i = 0; i < N; ++i) {
+        detectors[i]->ObserveTarget(detection_cache.frames[f][i], cameras[i],
+                                    results[i]);
+      }
+      AddDetections(results, calib_cams, calibrator);
 
-    while (valid_frame) {
+      if((int)f + 1 == warm_start_frames) {
+        start_calibrator();
+      }
+    }
 
-      int calib_frame = calibrator.AddFrame(Sophus::SE3d(Sophus::SO3d(),
-                                                         Eigen::Vector3d(0, 0, 1000)));
+    calibrator.Stop();
+    start_calibrator();
 
-      for (size_t iI = 0; iI < N; ++iI) {
-        image_processing.Process(images[iI].ptr, images[iI].w,
-                                 images[iI].h, images[iI].pitch);
-        conic_finder.Find(image_processing);
+    calibrator.WaitForTolerance(max_opt_time);
 
-        const std::vector<Conic, Eigen::aligned_allocator<Conic> >& conics =
-            conic_finder.Conics();
-        std::vector<int> ellipse_target_map;
+  } else {
 
-        tracking_good[iI] = target.FindTarget(image_processing,
-                                              conic_finder.Conics(), ellipse_target_map);
+    ////////////////////////////////////////////////////////////////////
+    // Frame pipeline: a decode thread grabs frames, skipping those the
+    // prefilter finds blurred or already seen, a pool of workers detects
+    // the target in them and this thread feeds the results to the
+    // calibrator in frame order. The optimiser is started once enough
+    // frames are in, and keeps running while the rest are added.
+
+    const unsigned int num_workers = NumWorkerThreads(detect_threads);
+    const size_t queue_size = 2 * num_workers;
+
+    // Grabbed frames are recycled, which bounds memory use.
+    BoundedQueue<std::unique_ptr<GrabbedFrame>> free_frames(queue_size);
+    BoundedQueue<std::unique_ptr<GrabbedFrame>> grabbed_frames(queue_size);
+    BoundedQueue<std::unique_ptr<FrameDetections>> detected_frames(queue_size);
+
+    for(size_t i = 0; i < queue_size; ++i) {
+      free_frames.Push( make_unique<GrabbedFrame>(video->SizeBytes()) );
+    }
 
-        if (tracking_good[iI]) {
-          // Generate map and point structures
-          std::vector<Eigen::Vector2d,
-                      Eigen::aligned_allocator<Eigen::Vector2d> > ellipses;
-          for (size_t i = 0; i < conics.size(); ++i) {
-            ellipses.push_back(conics[i].center);
+    FramePrefilter prefilter;
+    prefilter.Params() = prefilter_params;
+
+    std::thread decoder([&]() {
+      std::unique_ptr<GrabbedFrame> grabbed;
+      for(int index = 0; free_frames.Pop(grabbed); ++index) {
+        // Skipped frames are grabbed over into the same buffer
+        bool more;
+        while((more = video->Grab(grabbed->buffer.data(), grabbed->images,
+                                  true, true)) &&
+              !PrefilterFrame(prefilter, grabbed->images)) {
+        }
+        if(!more) {
+          break;
+        }
+        grabbed->index = index;
+        grabbed_frames.Push(std::move(grabbed));
+      }
+      grabbed_frames.Close();
+    });
+
+    std::atomic<unsigned int> active_workers(num_workers);
+    std::vector<std::thread> workers;
+    for(unsigned int w = 0; w < num_workers; ++w) {
+      workers.emplace_back([&]() {
+        std::vector<std::unique_ptr<CameraDetector>> detectors = make_detectors();
+        std::unique_ptr<GrabbedFrame> grabbed;
+        while(grabbed_frames.Pop(grabbed)) {
+          std::unique_ptr<FrameDetections> detections(new FrameDetections);
+          detections->index = grabbed->index;
+          // The solver may be updating the calibrator's cameras, so poses
+          // are estimated with copies of them as last published
+          DetectAll(detectors, grabbed->images, proc_params,
+                    CopyCameras(*calibrator.Snapshot()),
+                    detections->cameras, 1);
+          for(const std::unique_ptr<CameraDetector>& detector : detectors) {
+            detections->detected.push_back(detector->detection);
           }
+          free_frames.Push(std::move(grabbed));
+          detected_frames.Push(std::move(detections));
+        }
+        if(--active_workers == 0) {
+          detected_frames.Close();
+        }
+      });
+    }
 
-          // find camera pose given intrinsics
-          PosePnPRansac(calibrator.GetCamera(iI).camera, ellipses,
-                        target.Circles3D(), ellipse_target_map, 0, 0,
-                        &T_hw[iI]);
+    // Workers finish out of order, so hold results until their turn.
+    std::map<int, std::unique_ptr<FrameDetections>> pending;
+    std::unique_ptr<FrameDetections> detections;
+    int next_frame = 0;
 
-          if (calib_frame >= 0) {
-            if (iI == 0 || !tracking_good[0]) {
-              // Initialize pose of frame for least squares optimisation
-              calibrator.GetFrame(calib_frame) = T_hw[iI];
-            }
+    while(detected_frames.Pop(detections)) {
+      const int index = detections->index;
+      pending[index] = std::move(detections);
 
-            for (size_t p = 0; p < ellipses.size(); ++p) {
-              const Eigen::Vector2d pc = ellipses[p];
-              const Eigen::Vector2i pg = target.Map()[p].pg;
-
-              if (0 <= pg(0) && pg(0) < grid_size(0) && 0 <= pg(1)
-                  && pg(1) < grid_size(1)) {
-                const Eigen::Vector3d pg3d = grid_spacing
-                    * Eigen::Vector3d(pg(0), pg(1), 0);
-                // TODO: Add these correspondences in bulk to avoid
-                //       hitting mutex each time.
-                calibrator.AddObservation(calib_frame,
-                                          calib_cams[iI], pg3d, pc);
-              }
-            }
-          }
+      std::map<int, std::unique_ptr<FrameDetections>>::iterator it;
+      while((it = pending.find(next_frame)) != pending.end()) {
+        AddDetections(it->second->cameras, calib_cams, calibrator);
+        if(!detection_cache_filename.empty()) {
+          detection_cache.frames.push_back(std::move(it->second->detected));
+        }
+        pending.erase(it);
+
+        if(++next_frame == warm_start_frames) {
+          start_calibrator();
         }
       }
-      valid_frame = video.Grab(image_buffer, images, true, true);
     }
 
-    std::cout<<"Optimization started"<<std::endl;
-    calibrator.Start();
+    free_frames.Close();
+    decoder.join();
+    for(std::thread& worker : workers) {
+      worker.join();
+    }
 
-    int t = 0;
-    while(!calibrator.ReachedTolerance() && (t < max_opt_time)){
-      sleep(1);
-      t++;
+    if(prefilter.NumBlurred() > 0 || prefilter.NumDuplicates() > 0) {
+      std::cout << "Prefilter kept " << prefilter.NumAccepted()
+                << " frames, skipped " << prefilter.NumBlurred()
+                << " blurred and " << prefilter.NumDuplicates()
+                << " near duplicates" << std::endl;
     }
+
+    if(!detection_cache_filename.empty()) {
+      if(detection_cache.Save(detection_cache_filename)) {
+        std::cout << "Wrote detections to " << detection_cache_filename << std::endl;
+      }else{
+        std::cerr << "Unable to write detections to " << detection_cache_filename << std::endl;
+      }
+    }
+
+    // Restart so that convergence is judged on the full set of frames,
+    // continuing from the current estimate.
+    calibrator.Stop();
+    start_calibrator();
+
+    calibrator.WaitForTolerance(max_opt_time);
   }
 
   calibrator.Stop();
   calibrator.PrintResults();
 
+  if(!report_filename.empty()) {
+    CalibrationReport report;
+    if(!calibrator.Report(report) || !report.SaveJson(report_filename)) {
+      std::cerr << "Failed to write report " << report_filename << std::endl;
+    }
+  }
+#ifdef CALIBU_PIPELINE_STATS
+  GetPipelineStats().Print(std::cout);
+#endif
+
   if(gui || calibrator.ReachedTolerance()) {
     calibrator.WriteCameraModels(output_filename);
   }
@@ -6,6 +6,7 @@
 #include <signal.h>
 #include <fstream>
 #include <deque>
+#include <cstdlib>
 
 #include <calibu/target/RandomGrid.h>
 
@@ -18,15 +19,19 @@ void UserQuit(int)
     should_run = false;
 }
 
-int main( int, char** )
+// Usage: grid-gen [rows cols [max_seconds]]
+int main( int argc, char** argv )
 {
     signal(SIGABRT,UserQuit);
     signal(SIGTERM,UserQuit);
 
-    const int PR = 10;
-    const int PC = 19;
+    const int PR = argc > 2 ? atoi(argv[1]) : 10;
+    const int PC = argc > 2 ? atoi(argv[2]) : 19;
 
-    uint32_t seed = FindBestSeed(PR, PC, should_run); // 14
+    SeedSearchOptions options;
+    options.max_seconds = argc > 3 ? atof(argv[3]) : 0;
+
+    uint32_t seed = FindBestSeed(PR, PC, should_run, options); // 14 for 10x19
     const std::array<Eigen::MatrixXi,4> PG = MakePatternGroup(PR, PC, seed);
 
     std::cout << PG[0] << std::endl;
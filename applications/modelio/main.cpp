@@ -1,8 +1,27 @@
 /*
    Example demonstrating camera model reading and writing.
+
+   modelio -tobinary rig.xml rig.bin   converts an XML rig to a binary rig
+   modelio -toxml rig.bin rig.xml      converts a binary rig to an XML rig
+   modelio -validate rig [max_error]   checks Unproject / Project round trips
+                                       of every camera, see Validate
+   modelio -distill rig type out [step] fits cameras of model type to those
+                                       of rig and writes them to out, see
+                                       Distill
+   modelio                             runs the examples on cameras_in.xml
 */
 
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <limits>
+#include <vector>
+
 #include <calibu/Calibu.h>
+#include <calibu/cam/camera_distill.h>
+#include <calibu/utils/Parallel.h>
 #include <glog/logging.h>
 
 using namespace calibu;
@@ -47,8 +66,240 @@ void Test2()
   }
 }
 
+int Convert( const std::string& mode, const std::string& in,
+             const std::string& out )
+{
+  std::shared_ptr<Rig<double>> rig;
+  bool written = false;
+  if( mode == "-tobinary" ) {
+    rig = ReadXmlRig( in );
+    written = rig && WriteBinaryRig( out, rig );
+  } else if( mode == "-toxml" ) {
+    rig = ReadBinaryRig( in );
+    if( rig ) {
+      WriteXmlRig( out, rig );
+      written = true;
+    }
+  } else {
+    std::cerr << "Unknown mode " << mode << std::endl;
+    return 1;
+  }
+
+  if( !written ) {
+    std::cerr << "Unable to convert '" << in << "' to '" << out << "'"
+              << std::endl;
+    return 1;
+  }
+  std::cout << "Converted " << rig->NumCams() << " cameras" << std::endl;
+  return 0;
+}
+
+// Pixel spacing of the validation grid and the depths, along each ray,
+// of the points projected back.
+static const int kGridStep = 2;
+static const double kDepths[] = { 0.1, 0.3, 1, 3, 10, 30, 100 };
+
+/// Round trip error and throughput of one camera.
+struct RoundTrip
+{
+  size_t num_pixels = 0;
+  size_t num_points = 0;
+  size_t num_invalid = 0;
+  double max_error = 0;
+  double mean_error = 0;
+  double unproject_seconds = 0;
+  double project_seconds = 0;
+};
+
+/// Unproject a dense grid of pixels over the whole image of 'cam', place a
+/// point at each of kDepths along every ray and project it back, using the
+/// batch APIs over row bands on every core. Points that don't come back to
+/// a finite pixel are counted as invalid.
+RoundTrip ValidateCamera( const CameraInterface<double>& cam )
+{
+  typedef std::chrono::steady_clock Clock;
+  const int num_depths = sizeof(kDepths) / sizeof(kDepths[0]);
+
+  std::vector<double> u, v;
+  for( int y = 0; y < cam.Height(); y += kGridStep ) {
+    for( int x = 0; x < cam.Width(); x += kGridStep ) {
+      u.push_back( x );
+      v.push_back( y );
+    }
+  }
+  const int n = u.size();
+
+  RoundTrip result;
+  result.num_pixels = n;
+  result.num_points = (size_t)n * num_depths;
+
+  std::vector<double> x(n), y(n), z(n);
+  Clock::time_point start = Clock::now();
+  ParallelForBands( n, 0, [&]( int begin, int end ) {
+    cam.UnprojectN( &u[begin], &v[begin], &x[begin], &y[begin], &z[begin],
+                    end - begin );
+  } );
+  result.unproject_seconds =
+      std::chrono::duration<double>( Clock::now() - start ).count();
+
+  // Unit rays, so that the points lie at each depth along them
+  for( int i = 0; i < n; ++i ) {
+    const double norm = std::sqrt( x[i]*x[i] + y[i]*y[i] + z[i]*z[i] );
+    x[i] /= norm;
+    y[i] /= norm;
+    z[i] /= norm;
+  }
+
+  std::vector<double> X(n), Y(n), Z(n), pu(n), pv(n);
+  for( int d = 0; d < num_depths; ++d ) {
+    for( int i = 0; i < n; ++i ) {
+      X[i] = kDepths[d] * x[i];
+      Y[i] = kDepths[d] * y[i];
+      Z[i] = kDepths[d] * z[i];
+    }
+
+    start = Clock::now();
+    ParallelForBands( n, 0, [&]( int begin, int end ) {
+      cam.ProjectN( &X[begin], &Y[begin], &Z[begin], &pu[begin], &pv[begin],
+                    end - begin );
+    } );
+    result.project_seconds +=
+        std::chrono::duration<double>( Clock::now() - start ).count();
+
+    for( int i = 0; i < n; ++i ) {
+      const double error = std::hypot( pu[i] - u[i], pv[i] - v[i] );
+      if( std::isfinite( error ) ) {
+        result.max_error = std::max( result.max_error, error );
+        result.mean_error += error;
+      } else {
+        ++result.num_invalid;
+      }
+    }
+  }
+
+  const size_t num_valid = result.num_points - result.num_invalid;
+  if( num_valid > 0 ) {
+    result.mean_error /= num_valid;
+  }
+  return result;
+}
+
+/// Check the round trip of every camera of the rig in 'filename', XML or
+/// binary, and print error and throughput per camera. Returns non-zero if
+/// the rig can't be read, or a camera has invalid points or a round trip
+/// error above max_error pixels.
+int Validate( const std::string& filename, double max_error )
+{
+  std::shared_ptr<Rig<double>> rig = ReadBinaryRig( filename );
+  if( !rig ) {
+    rig = ReadXmlRig( filename );
+  }
+  if( !rig || rig->cameras_.empty() ) {
+    std::cerr << "Unable to read cameras from '" << filename << "'"
+              << std::endl;
+    return 1;
+  }
+
+  int failed = 0;
+  for( size_t ii = 0; ii < rig->cameras_.size(); ++ii ) {
+    const CameraInterface<double>& cam = *rig->cameras_[ii];
+    const RoundTrip result = ValidateCamera( cam );
+    const bool ok = result.num_invalid == 0 && result.max_error <= max_error;
+    failed += ok ? 0 : 1;
+
+    std::cout << "Camera " << ii << " (" << cam.Type() << ", "
+              << cam.Width() << "x" << cam.Height() << "): "
+              << ( ok ? "OK" : "FAILED" ) << "\n"
+              << "    points       = " << result.num_pixels << " pixels x "
+              << result.num_points / std::max<size_t>(1, result.num_pixels)
+              << " depths, " << result.num_invalid << " invalid\n"
+              << std::scientific << std::setprecision(3)
+              << "    max error    = " << result.max_error << " px\n"
+              << "    mean error   = " << result.mean_error << " px\n"
+              << std::fixed << std::setprecision(2)
+              << "    unproject    = "
+              << result.num_pixels / result.unproject_seconds / 1e6
+              << " Mpixels/s\n"
+              << "    project      = "
+              << result.num_points / result.project_seconds / 1e6
+              << " Mpoints/s" << std::defaultfloat << std::endl;
+  }
+  return failed == 0 ? 0 : 1;
+}
+
+/// Fit a camera of model 'type' to every camera of the rig in 'filename',
+/// XML or binary, sampled every step pixels, see DistillCamera, and write
+/// the fits as an XML rig to 'out'. Prints the error of each fit and the
+/// unproject throughput of source and fit. Returns non-zero if the rig
+/// can't be read or a camera can't be fitted.
+int Distill( const std::string& filename, const std::string& type,
+             const std::string& out, int step )
+{
+  std::shared_ptr<Rig<double>> rig = ReadBinaryRig( filename );
+  if( !rig ) {
+    rig = ReadXmlRig( filename );
+  }
+  if( !rig || rig->cameras_.empty() ) {
+    std::cerr << "Unable to read cameras from '" << filename << "'"
+              << std::endl;
+    return 1;
+  }
+
+  ParamsCameraDistill params;
+  params.pixel_step = step;
+  std::shared_ptr<Rig<double>> distilled( new Rig<double>() );
+  for( size_t ii = 0; ii < rig->cameras_.size(); ++ii ) {
+    const CameraInterface<double>& cam = *rig->cameras_[ii];
+    CameraDistillation result;
+    std::shared_ptr<CameraInterface<double>> fit =
+        DistillCamera( cam, type, result, params );
+    if( !fit ) {
+      std::cerr << "Unable to fit a " << type << " camera to camera " << ii
+                << std::endl;
+      return 1;
+    }
+    distilled->AddCamera( fit );
+
+    const RoundTrip source_trip = ValidateCamera( cam );
+    const RoundTrip fit_trip = ValidateCamera( *fit );
+    std::cout << "Camera " << ii << " (" << cam.Type() << " -> " << type
+              << ", " << cam.Width() << "x" << cam.Height() << "):\n"
+              << "    samples      = " << result.num_samples << ", "
+              << result.num_dropped << " dropped, " << result.iterations
+              << " iterations\n"
+              << std::scientific << std::setprecision(3)
+              << "    rms error    = " << result.rms_error << " px\n"
+              << "    max error    = " << result.max_error << " px\n"
+              << "    unproject    = " << result.max_unproject_error
+              << " px max\n"
+              << std::fixed << std::setprecision(2)
+              << "    source       = "
+              << source_trip.num_pixels / source_trip.unproject_seconds / 1e6
+              << " Mpixels/s unproject\n"
+              << "    fit          = "
+              << fit_trip.num_pixels / fit_trip.unproject_seconds / 1e6
+              << " Mpixels/s unproject" << std::defaultfloat << std::endl;
+  }
+
+  WriteXmlRig( out, distilled );
+  return 0;
+}
+
 int main( int argc, char* argv[] )
 {
+  if( (argc == 3 || argc == 4) && std::string( argv[1] ) == "-validate" ) {
+    return Validate( argv[2], argc == 4 ? std::atof( argv[3] ) : 1e-3 );
+  }
+
+  if( (argc == 5 || argc == 6) && std::string( argv[1] ) == "-distill" ) {
+    return Distill( argv[2], argv[3], argv[4],
+                    argc == 6 ? std::atoi( argv[5] ) : 4 );
+  }
+
+  if( argc == 4 ) {
+    return Convert( argv[1], argv[2], argv[3] );
+  }
+
   std::cout << "Running Test1(). \n" << std::endl;
   Test1();
   std::cout << "Running Test2(). \n" << std::endl;
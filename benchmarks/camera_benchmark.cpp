@@ -0,0 +1,243 @@
+#include <benchmark/benchmark.h>
+#include <calibu/cam/camera_models_crtp.h>
+
+namespace calibu
+{
+namespace benchmarks
+{
+
+// Parameters of a typical 640x480 camera for each model
+template <typename Camera>
+Eigen::VectorXd CameraParams();
+
+template <>
+Eigen::VectorXd CameraParams<LinearCamera<double>>()
+{
+  Eigen::VectorXd params(4);
+  params << 300, 310, 320, 240;
+  return params;
+}
+
+template <>
+Eigen::VectorXd CameraParams<FovCamera<double>>()
+{
+  Eigen::VectorXd params(5);
+  params << 300, 310, 320, 240, 0.9;
+  return params;
+}
+
+template <>
+Eigen::VectorXd CameraParams<Poly2Camera<double>>()
+{
+  Eigen::VectorXd params(6);
+  params << 300, 310, 320, 240, 0.1, -0.05;
+  return params;
+}
+
+template <>
+Eigen::VectorXd CameraParams<Poly3Camera<double>>()
+{
+  Eigen::VectorXd params(7);
+  params << 300, 310, 320, 240, 0.1, -0.05, 0.01;
+  return params;
+}
+
+template <>
+Eigen::VectorXd CameraParams<KannalaBrandtCamera<double>>()
+{
+  Eigen::VectorXd params(8);
+  params << 300, 310, 320, 240, 0.01, -0.02, 0.003, -0.001;
+  return params;
+}
+
+template <>
+Eigen::VectorXd CameraParams<Rational6Camera<double>>()
+{
+  Eigen::VectorXd params(10);
+  params << 300, 310, 320, 240, 0.1, -0.05, 0.01, 0.05, 0.02, -0.01;
+  return params;
+}
+
+static const int kNumPoints = 1024;
+
+template <typename Camera>
+std::shared_ptr<CameraInterface<double>> CreateCamera()
+{
+  Eigen::Vector2i size(640, 480);
+  return std::make_shared<Camera>(CameraParams<Camera>(), size);
+}
+
+// Pixels spread over the image, and the rays through them
+Eigen::Matrix2Xd CreatePixels()
+{
+  Eigen::Matrix2Xd pix(2, kNumPoints);
+  for (int i = 0; i < kNumPoints; ++i)
+  {
+    pix.col(i) << 10 + (i * 37) % 620, 10 + (i * 23) % 460;
+  }
+  return pix;
+}
+
+Eigen::Matrix3Xd CreateRays(const CameraInterface<double>& camera)
+{
+  Eigen::Matrix3Xd rays;
+  camera.UnprojectN(CreatePixels(), rays);
+  return rays;
+}
+
+template <typename Camera>
+void BM_Project(benchmark::State& state)
+{
+  const std::shared_ptr<CameraInterface<double>> camera = CreateCamera<Camera>();
+  const Eigen::Matrix3Xd rays = CreateRays(*camera);
+
+  for (auto _ : state)
+  {
+    for (int i = 0; i < kNumPoints; ++i)
+    {
+      benchmark::DoNotOptimize(camera->Project(rays.col(i)));
+    }
+  }
+
+  state.SetItemsProcessed(state.iterations() * kNumPoints);
+}
+
+template <typename Camera>
+void BM_ProjectN(benchmark::State& state)
+{
+  const std::shared_ptr<CameraInterface<double>> camera = CreateCamera<Camera>();
+  const Eigen::Matrix3Xd rays = CreateRays(*camera);
+  Eigen::Matrix2Xd pix;
+
+  for (auto _ : state)
+  {
+    camera->ProjectN(rays, pix);
+    benchmark::DoNotOptimize(pix.data());
+  }
+
+  state.SetItemsProcessed(state.iterations() * kNumPoints);
+}
+
+template <typename Camera>
+void BM_Unproject(benchmark::State& state)
+{
+  const std::shared_ptr<CameraInterface<double>> camera = CreateCamera<Camera>();
+  const Eigen::Matrix2Xd pix = CreatePixels();
+
+  for (auto _ : state)
+  {
+    for (int i = 0; i < kNumPoints; ++i)
+    {
+      benchmark::DoNotOptimize(camera->Unproject(pix.col(i)));
+    }
+  }
+
+  state.SetItemsProcessed(state.iterations() * kNumPoints);
+}
+
+template <typename Camera>
+void BM_UnprojectN(benchmark::State& state)
+{
+  const std::shared_ptr<CameraInterface<double>> camera = CreateCamera<Camera>();
+  const Eigen::Matrix2Xd pix = CreatePixels();
+  Eigen::Matrix3Xd rays;
+
+  for (auto _ : state)
+  {
+    camera->UnprojectN(pix, rays);
+    benchmark::DoNotOptimize(rays.data());
+  }
+
+  state.SetItemsProcessed(state.iterations() * kNumPoints);
+}
+
+template <typename Camera>
+void BM_dProject_dray(benchmark::State& state)
+{
+  const std::shared_ptr<CameraInterface<double>> camera = CreateCamera<Camera>();
+  const Eigen::Matrix3Xd rays = CreateRays(*camera);
+
+  for (auto _ : state)
+  {
+    for (int i = 0; i < kNumPoints; ++i)
+    {
+      benchmark::DoNotOptimize(camera->dProject_dray(rays.col(i)));
+    }
+  }
+
+  state.SetItemsProcessed(state.iterations() * kNumPoints);
+}
+
+template <typename Camera>
+void BM_dProject_dparams(benchmark::State& state)
+{
+  const std::shared_ptr<CameraInterface<double>> camera = CreateCamera<Camera>();
+  const Eigen::Matrix3Xd rays = CreateRays(*camera);
+
+  for (auto _ : state)
+  {
+    for (int i = 0; i < kNumPoints; ++i)
+    {
+      benchmark::DoNotOptimize(camera->dProject_dparams(rays.col(i)));
+    }
+  }
+
+  state.SetItemsProcessed(state.iterations() * kNumPoints);
+}
+
+template <typename Camera>
+void BM_dProject_dparamsInto(benchmark::State& state)
+{
+  const std::shared_ptr<CameraInterface<double>> camera = CreateCamera<Camera>();
+  const Eigen::Matrix3Xd rays = CreateRays(*camera);
+  Eigen::Matrix<double, 2, Camera::kParamSize> j;
+
+  for (auto _ : state)
+  {
+    for (int i = 0; i < kNumPoints; ++i)
+    {
+      camera->dProject_dparams(rays.col(i), j.data());
+      benchmark::DoNotOptimize(j);
+    }
+  }
+
+  state.SetItemsProcessed(state.iterations() * kNumPoints);
+}
+
+template <typename Camera>
+void BM_dUnproject_dparams(benchmark::State& state)
+{
+  const std::shared_ptr<CameraInterface<double>> camera = CreateCamera<Camera>();
+  const Eigen::Matrix2Xd pix = CreatePixels();
+
+  for (auto _ : state)
+  {
+    for (int i = 0; i < kNumPoints; ++i)
+    {
+      benchmark::DoNotOptimize(camera->dUnproject_dparams(pix.col(i)));
+    }
+  }
+
+  state.SetItemsProcessed(state.iterations() * kNumPoints);
+}
+
+#define CALIBU_BENCHMARK_CAMERA(Camera)                   \
+  BENCHMARK_TEMPLATE(BM_Project, Camera);                 \
+  BENCHMARK_TEMPLATE(BM_ProjectN, Camera);                \
+  BENCHMARK_TEMPLATE(BM_Unproject, Camera);               \
+  BENCHMARK_TEMPLATE(BM_UnprojectN, Camera);              \
+  BENCHMARK_TEMPLATE(BM_dProject_dray, Camera);           \
+  BENCHMARK_TEMPLATE(BM_dProject_dparams, Camera);        \
+  BENCHMARK_TEMPLATE(BM_dProject_dparamsInto, Camera);    \
+  BENCHMARK_TEMPLATE(BM_dUnproject_dparams, Camera)
+
+CALIBU_BENCHMARK_CAMERA(LinearCamera<double>);
+CALIBU_BENCHMARK_CAMERA(FovCamera<double>);
+CALIBU_BENCHMARK_CAMERA(Poly2Camera<double>);
+CALIBU_BENCHMARK_CAMERA(Poly3Camera<double>);
+CALIBU_BENCHMARK_CAMERA(KannalaBrandtCamera<double>);
+CALIBU_BENCHMARK_CAMERA(Rational6Camera<double>);
+
+} // namespace benchmarks
+
+} // namespace calibu
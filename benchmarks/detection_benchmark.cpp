@@ -0,0 +1,103 @@
+#include <benchmark/benchmark.h>
+#include <calibu/cam/camera_models_crtp.h>
+#include <calibu/conics/ConicFinder.h>
+#include <calibu/image/ImageProcessing.h>
+#include <calibu/target/TargetGridDot.h>
+#include <calibu/target/TargetRenderer.h>
+
+#include <vector>
+
+namespace calibu
+{
+namespace benchmarks
+{
+
+static const int kFrameWidth = 640;
+static const int kFrameHeight = 480;
+
+// Slightly blurred and noisy view of the "small" dot target
+std::vector<unsigned char> CreateTargetFrame(const TargetGridDot& target)
+{
+  Eigen::VectorXd params(5);
+  params << 400, 400, 320, 240, 0.9;
+  Eigen::Vector2i size(kFrameWidth, kFrameHeight);
+  const std::shared_ptr<CameraInterface<double>> cam =
+      std::make_shared<FovCamera<double>>(params, size);
+
+  const Eigen::Vector2i& grid = target.GridSize();
+  const Eigen::Vector3d middle = 0.5 * target.GridSpacing() *
+      Eigen::Vector3d(grid[0] - 1, grid[1] - 1, 0);
+  const Sophus::SE3d T_cw =
+      Sophus::SE3d(Sophus::SO3d::exp(Eigen::Vector3d(0.2, -0.15, 0.05)),
+                   Eigen::Vector3d(0, 0, 0.3)) *
+      Sophus::SE3d(Eigen::Matrix3d::Identity(), -middle);
+
+  TargetRenderer renderer(target);
+  renderer.Params().blur_sigma = 0.7;
+  renderer.Params().noise_sigma = 2;
+
+  std::vector<unsigned char> image;
+  std::vector<RenderedDot> dots;
+  renderer.Render(cam, T_cw, image, dots);
+  return image;
+}
+
+void BM_ImageProcessing_Process(benchmark::State& state)
+{
+  const TargetGridDot target("small");
+  const std::vector<unsigned char> frame = CreateTargetFrame(target);
+  ImageProcessing images(kFrameWidth, kFrameHeight);
+
+  for (auto _ : state)
+  {
+    images.Process(frame.data(), kFrameWidth, kFrameHeight, kFrameWidth);
+  }
+
+  state.SetBytesProcessed(state.iterations() * frame.size());
+}
+
+void BM_ConicFinder_Find(benchmark::State& state)
+{
+  const TargetGridDot target("small");
+  const std::vector<unsigned char> frame = CreateTargetFrame(target);
+  ImageProcessing images(kFrameWidth, kFrameHeight);
+  images.Process(frame.data(), kFrameWidth, kFrameHeight, kFrameWidth);
+  ConicFinder finder;
+
+  for (auto _ : state)
+  {
+    finder.Find(images);
+    benchmark::DoNotOptimize(finder.Conics().CentersData().data());
+  }
+
+  state.counters["conics"] = finder.Conics().size();
+}
+
+void BM_TargetGridDot_FindTarget(benchmark::State& state)
+{
+  TargetGridDot target("small");
+  const std::vector<unsigned char> frame = CreateTargetFrame(target);
+  ImageProcessing images(kFrameWidth, kFrameHeight);
+  images.Process(frame.data(), kFrameWidth, kFrameHeight, kFrameWidth);
+  ConicFinder finder;
+  finder.Find(images);
+
+  std::vector<int> ellipse_target_map;
+  bool found = false;
+
+  for (auto _ : state)
+  {
+    found = target.FindTarget(images, finder.Conics(), ellipse_target_map);
+    benchmark::DoNotOptimize(ellipse_target_map.data());
+  }
+
+  state.counters["found"] = found;
+}
+
+BENCHMARK(BM_ImageProcessing_Process);
+BENCHMARK(BM_ConicFinder_Find);
+BENCHMARK(BM_TargetGridDot_FindTarget);
+
+} // namespace benchmarks
+
+} // namespace calibu
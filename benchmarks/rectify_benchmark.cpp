@@ -0,0 +1,112 @@
+#include <benchmark/benchmark.h>
+#include <calibu/cam/camera_models_crtp.h>
+#include <calibu/cam/rectify_crtp.h>
+
+#include <vector>
+
+namespace calibu
+{
+namespace benchmarks
+{
+
+// FOV camera of state.range(0) x state.range(1) pixels
+std::shared_ptr<CameraInterface<double>> CreateRectifyCamera(
+    const benchmark::State& state)
+{
+  const int w = state.range(0);
+  const int h = state.range(1);
+  Eigen::VectorXd params(5);
+  params << 0.47 * w, 0.47 * w, 0.5 * w, 0.5 * h, 0.9;
+  Eigen::Vector2i size(w, h);
+  return std::make_shared<FovCamera<double>>(params, size);
+}
+
+std::vector<unsigned char> CreateRectifyImage(int w, int h)
+{
+  std::vector<unsigned char> image(w * h);
+  for (int i = 0; i < w * h; ++i)
+  {
+    image[i] = (unsigned char)(i * 31 + i / w * 7);
+  }
+  return image;
+}
+
+void BM_CreateLookupTable(benchmark::State& state)
+{
+  const std::shared_ptr<CameraInterface<double>> camera =
+      CreateRectifyCamera(state);
+  LookupTable lut(camera->Width(), camera->Height());
+
+  for (auto _ : state)
+  {
+    CreateLookupTable(camera, lut, 0, 0, state.range(2));
+    benchmark::DoNotOptimize(lut.m_vLutPixels.data());
+  }
+
+  state.SetItemsProcessed(state.iterations() * camera->Width() *
+                          camera->Height());
+}
+
+void BM_Rectify(benchmark::State& state)
+{
+  const std::shared_ptr<CameraInterface<double>> camera =
+      CreateRectifyCamera(state);
+  const int w = camera->Width();
+  const int h = camera->Height();
+  LookupTable lut(w, h);
+  CreateLookupTable(camera, lut);
+
+  const std::vector<unsigned char> image = CreateRectifyImage(w, h);
+  std::vector<unsigned char> output(w * h);
+
+  for (auto _ : state)
+  {
+    Rectify(lut, image.data(), output.data(), w, h, 1, state.range(2));
+    benchmark::DoNotOptimize(output.data());
+  }
+
+  state.SetBytesProcessed(state.iterations() * w * h);
+}
+
+void BM_RectifyFixedPoint(benchmark::State& state)
+{
+  const std::shared_ptr<CameraInterface<double>> camera =
+      CreateRectifyCamera(state);
+  const int w = camera->Width();
+  const int h = camera->Height();
+  LookupTable lut(w, h);
+  CreateLookupTable(camera, lut);
+  const FixedPointLookupTable fixed(lut);
+
+  const std::vector<unsigned char> image = CreateRectifyImage(w, h);
+  std::vector<unsigned char> output(w * h);
+
+  for (auto _ : state)
+  {
+    Rectify(fixed, image.data(), output.data(), w, h, RECTIFY_KERNEL_AUTO,
+            state.range(2));
+    benchmark::DoNotOptimize(output.data());
+  }
+
+  state.SetBytesProcessed(state.iterations() * w * h);
+}
+
+// VGA, 720p and 1080p, on one thread and one per core
+static void RectifyArgs(benchmark::internal::Benchmark* b)
+{
+  b->ArgNames({ "w", "h", "threads" });
+  for (int threads : { 1, 0 })
+  {
+    b->Args({ 640, 480, threads });
+    b->Args({ 1280, 720, threads });
+    b->Args({ 1920, 1080, threads });
+  }
+}
+
+BENCHMARK(BM_CreateLookupTable)->Apply(RectifyArgs)->UseRealTime();
+BENCHMARK(BM_Rectify)->Apply(RectifyArgs)->UseRealTime();
+BENCHMARK(BM_RectifyFixedPoint)->Apply(RectifyArgs)->UseRealTime();
+
+} // namespace benchmarks
+
+} // namespace calibu
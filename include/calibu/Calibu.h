@@ -26,6 +26,7 @@
 
 #include <calibu/Platform.h>
 
+#include <calibu/cam/camera_binary.h>
 #include <calibu/cam/camera_xml.h>
 #include <calibu/cam/rectify_crtp.h>
 
@@ -0,0 +1,79 @@
+/*
+   This file is part of the Calibu Project.
+   https://github.com/gwu-robotics/Calibu
+
+   Copyright (C) 2014 George Washington University,
+                      Steven Lovegrove
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+   http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#pragma once
+
+#include <initializer_list>
+
+#include <calibu/Platform.h>
+
+namespace calibu {
+
+/// Instruction set extensions vectorized kernels may need, as bits.
+enum CpuFeature {
+    CPU_FEATURE_SSE2     = 1 << 0,
+    CPU_FEATURE_SSE4_1   = 1 << 1,
+    CPU_FEATURE_AVX      = 1 << 2,
+    CPU_FEATURE_AVX2     = 1 << 3,
+    CPU_FEATURE_FMA      = 1 << 4,
+    CPU_FEATURE_AVX512F  = 1 << 5,
+    CPU_FEATURE_AVX512BW = 1 << 6,
+    CPU_FEATURE_NEON     = 1 << 7
+};
+
+/// Features of the running CPU, also enabled by the operating system, as
+/// CpuFeature bits. Detected with CPUID on x86 and the auxiliary vector's
+/// HWCAP on ARM the first time it's called.
+CALIBU_EXPORT unsigned int CpuFeatures();
+
+/// True if the running CPU has every feature in the CpuFeature bits.
+inline bool CpuSupports( unsigned int features )
+{
+    return (CpuFeatures() & features) == features;
+}
+
+/// An implementation of a kernel, and the CpuFeature bits it needs.
+template<typename Function>
+struct KernelVariant
+{
+    unsigned int features;
+    Function function;
+};
+
+/// The first of variants the running CPU supports, so variants go from the
+/// most to the least demanding, ending with one needing no features. Keep
+/// the result in a static to select a kernel once, e.g.
+///
+///   static const RowFunction row = SelectKernel<RowFunction>( {
+///       { CPU_FEATURE_AVX2, RowAvx2 }, { 0, RowScalar } } );
+template<typename Function>
+Function SelectKernel( std::initializer_list<KernelVariant<Function> > variants )
+{
+    Function selected = nullptr;
+    for( const KernelVariant<Function>& variant : variants ) {
+        selected = variant.function;
+        if( CpuSupports( variant.features ) ) {
+            break;
+        }
+    }
+    return selected;
+}
+
+}
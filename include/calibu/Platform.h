@@ -27,3 +27,10 @@
 #else
 #  define CALIBU_EXPORT
 #endif // _MSVC_
+
+// Camera model kernels are also device functions when compiled by nvcc
+#ifdef __CUDACC__
+#  define CALIBU_HOST_DEVICE __host__ __device__
+#else
+#  define CALIBU_HOST_DEVICE
+#endif
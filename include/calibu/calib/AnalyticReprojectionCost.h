@@ -0,0 +1,287 @@
+/*
+   This file is part of the Calibu Project.
+   https://github.com/arpg/Calibu
+
+   Copyright (C) 2013 George Washington University,
+                      Steven Lovegrove,
+                      Gabe Sibley
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+   http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#pragma once
+
+#include <cmath>
+#include <vector>
+
+#include <Eigen/Eigen>
+#include <Eigen/StdVector>
+#include <sophus/se3.hpp>
+
+#include <ceres/ceres.h>
+
+#include <calibu/cam/camera_crtp.h>
+
+namespace calibu
+{
+
+// Derivative of the rotation q * P w.r.t. the quaternion coefficients
+// (x, y, z, w) as stored by Sophus. This differentiates the formula used to
+// rotate by a unit quaternion, P + 2w (u x P) + 2u x (u x P) with u = (x,y,z).
+// It agrees with automatic differentiation of Sophus::SE3Group along the
+// unit sphere, which is all ParameterizationSe3 makes use of.
+inline Eigen::Matrix<double,3,4> dRotate_dquaternion(
+        const double* q, const Eigen::Vector3d& P)
+{
+    const Eigen::Map<const Eigen::Vector3d> u(q);
+    const double w = q[3];
+    const Eigen::Vector3d a = u.cross(P);
+
+    Eigen::Matrix<double,3,4> j;
+    j.leftCols<3>() = -2.0 * ( w * Sophus::SO3d::hat(P) +
+                               Sophus::SO3d::hat(u) * Sophus::SO3d::hat(P) +
+                               Sophus::SO3d::hat(a) );
+    j.col(3) = 2.0 * a;
+    return j;
+}
+
+// Reprojection error of Pw, observed at pc, and its analytic derivatives
+// w.r.t. parameter blocks T_kw, T_ck and camera params. Derivatives are
+// stored row major, as expected by ceres. Composes the camera model's
+// derivatives, from a single ProjectWithJacobians pass, with the SE3 chain
+// rule. Any of the Jacobian pointers may be null.
+//
+// With 'tangent' set, pose derivatives are instead w.r.t. the right
+// perturbation T * exp(delta) of TangentParameterizationSe3, in the first
+// six columns of the pose blocks, the last being zero. This skips the
+// quaternion terms, and the parameterization's Jacobian is trivial.
+template<typename CameraModel>
+inline void ReprojectionJacobians(
+        const double* pT_kw, const double* pT_ck, const double* camparam,
+        const Eigen::Vector3d& Pw, const Eigen::Vector2d& pc,
+        double* residuals, double* J_kw, double* J_ck, double* J_params,
+        bool tangent = false)
+{
+    typedef Eigen::Matrix<double,2,Sophus::SE3d::num_parameters,Eigen::RowMajor> PoseJacobian;
+    typedef Eigen::Matrix<double,2,CameraModel::NumParams,Eigen::RowMajor> ParamsJacobian;
+
+    const Eigen::Map<const Sophus::SE3d> T_kw(pT_kw);
+    const Eigen::Map<const Sophus::SE3d> T_ck(pT_ck);
+
+    const Eigen::Vector3d Pk = T_kw * Pw;
+    const Eigen::Vector3d Pc = T_ck * Pk;
+
+    Eigen::Map<Eigen::Vector2d> r(residuals);
+    if(!J_kw && !J_ck && !J_params) {
+        CameraModel::Project(Pc.data(), camparam, r.data());
+        r -= pc;
+        return;
+    }
+
+    Eigen::Matrix<double,2,3> dp_dPc;
+    Eigen::Matrix<double,2,CameraModel::NumParams> dp_dparams;
+    CameraModel::ProjectWithJacobians(
+            Pc.data(), camparam, r.data(), dp_dPc.data(),
+            J_params ? dp_dparams.data() : nullptr);
+    r -= pc;
+
+    // In the tangent space, d (T * exp(delta) * P) / d delta = R [I, -hat(P)]
+    if(J_ck) {
+        Eigen::Map<PoseJacobian> J(J_ck);
+        if(tangent) {
+            const Eigen::Matrix<double,2,3> dp_dPck = dp_dPc * T_ck.rotationMatrix();
+            J.leftCols<3>() = dp_dPck;
+            J.middleCols<3>(3) = -dp_dPck * Sophus::SO3d::hat(Pk);
+            J.col(6).setZero();
+        }else{
+            J.leftCols<4>() = dp_dPc * dRotate_dquaternion(pT_ck, Pk);
+            J.rightCols<3>() = dp_dPc;
+        }
+    }
+
+    if(J_kw) {
+        const Eigen::Matrix<double,2,3> dp_dPk = dp_dPc * T_ck.rotationMatrix();
+        Eigen::Map<PoseJacobian> J(J_kw);
+        if(tangent) {
+            const Eigen::Matrix<double,2,3> dp_dPkw = dp_dPk * T_kw.rotationMatrix();
+            J.leftCols<3>() = dp_dPkw;
+            J.middleCols<3>(3) = -dp_dPkw * Sophus::SO3d::hat(Pw);
+            J.col(6).setZero();
+        }else{
+            J.leftCols<4>() = dp_dPk * dRotate_dquaternion(pT_kw, Pw);
+            J.rightCols<3>() = dp_dPk;
+        }
+    }
+
+    if(J_params) {
+        Eigen::Map<ParamsJacobian> J(J_params);
+        J = dp_dparams;
+    }
+}
+
+// Analytic counterpart of ReprojectionCostFunctor, with pose Jacobians in
+// the tangent space if 'tangent' is set, see ReprojectionJacobians.
+// Parameter block 0: T_kw // keyframe
+// Parameter block 1: T_ck // keyframe to cam
+// Parameter block 2: camera params
+template<typename CameraModel>
+class ReprojectionCostFunction
+    : public ceres::SizedCostFunction<2, Sophus::SE3d::num_parameters,
+                                      Sophus::SE3d::num_parameters,
+                                      CameraModel::NumParams>
+{
+public:
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW;
+    ReprojectionCostFunction(const Eigen::Vector3d& Pw,
+                             const Eigen::Vector2d& pc,
+                             bool tangent = false)
+        : m_Pw(Pw), m_pc(pc), m_tangent(tangent)
+    {
+    }
+
+    virtual bool Evaluate(double const* const* parameters,
+                          double* residuals,
+                          double** jacobians) const
+    {
+        ReprojectionJacobians<CameraModel>(
+                parameters[0], parameters[1], parameters[2], m_Pw, m_pc,
+                residuals,
+                jacobians ? jacobians[0] : nullptr,
+                jacobians ? jacobians[1] : nullptr,
+                jacobians ? jacobians[2] : nullptr,
+                m_tangent );
+        return true;
+    }
+
+    Eigen::Vector3d m_Pw;
+    Eigen::Vector2d m_pc;
+    bool m_tangent;
+};
+
+// Analytic counterpart of ReprojectionsCostFunctor: all points seen by one
+// camera in one keyframe in a single block, each robustified with a soft L1
+// loss of the given scale (none if <= 0). Parameter blocks and 'tangent'
+// are as for ReprojectionCostFunction.
+template<typename CameraModel>
+class ReprojectionsCostFunction : public ceres::CostFunction
+{
+public:
+    ReprojectionsCostFunction(
+            const std::vector<Eigen::Vector3d,
+                              Eigen::aligned_allocator<Eigen::Vector3d> >& Pw,
+            const std::vector<Eigen::Vector2d,
+                              Eigen::aligned_allocator<Eigen::Vector2d> >& pc,
+            double loss_scale = 0.0, bool tangent = false)
+        : m_Pw(Pw), m_pc(pc), m_Pw_ref(nullptr), m_pc_ref(nullptr),
+          m_size(Pw.size()),
+          m_inv_loss_scale2(loss_scale > 0 ? 1.0 / (loss_scale * loss_scale) : 0.0),
+          m_tangent(tangent)
+    {
+        SetBlockSizes();
+    }
+
+    // Refer to the n points Pw[i] / pc[i] in place, see
+    // ReprojectionsCostFunctor.
+    ReprojectionsCostFunction(
+            const Eigen::Vector3d* Pw, const Eigen::Vector2d* pc, size_t n,
+            double loss_scale = 0.0, bool tangent = false)
+        : m_Pw_ref(Pw), m_pc_ref(pc), m_size(n),
+          m_inv_loss_scale2(loss_scale > 0 ? 1.0 / (loss_scale * loss_scale) : 0.0),
+          m_tangent(tangent)
+    {
+        SetBlockSizes();
+    }
+
+    virtual bool Evaluate(double const* const* parameters,
+                          double* residuals,
+                          double** jacobians) const
+    {
+        const int pose_size = Sophus::SE3d::num_parameters;
+        const int params_size = CameraModel::NumParams;
+
+        const Eigen::Vector3d* Pw = m_Pw_ref ? m_Pw_ref : m_Pw.data();
+        const Eigen::Vector2d* pc = m_pc_ref ? m_pc_ref : m_pc.data();
+
+        for(size_t i = 0; i < m_size; ++i) {
+            // Row 2i of each row major Jacobian block
+            double* J_kw = (jacobians && jacobians[0]) ? jacobians[0] + 2 * i * pose_size : nullptr;
+            double* J_ck = (jacobians && jacobians[1]) ? jacobians[1] + 2 * i * pose_size : nullptr;
+            double* J_params = (jacobians && jacobians[2]) ? jacobians[2] + 2 * i * params_size : nullptr;
+
+            double* r = residuals + 2 * i;
+            ReprojectionJacobians<CameraModel>(
+                    parameters[0], parameters[1], parameters[2], Pw[i], pc[i],
+                    r, J_kw, J_ck, J_params, m_tangent );
+
+            if(m_inv_loss_scale2 > 0) {
+                Robustify(r, J_kw, pose_size);
+                Robustify(r, J_ck, pose_size);
+                Robustify(r, J_params, params_size);
+
+                // r' = w(s) r with w = sqrt(rho(s) / s), see ReprojectionsCostFunctor
+                Eigen::Map<Eigen::Vector2d> rv(r);
+                rv *= Weight(rv.squaredNorm(), nullptr);
+            }
+        }
+        return true;
+    }
+
+protected:
+
+    void SetBlockSizes()
+    {
+        const int pose_size = Sophus::SE3d::num_parameters;
+        const int params_size = CameraModel::NumParams;
+        set_num_residuals(2 * m_size);
+        mutable_parameter_block_sizes()->push_back(pose_size);
+        mutable_parameter_block_sizes()->push_back(pose_size);
+        mutable_parameter_block_sizes()->push_back(params_size);
+    }
+
+    // Weight w(s) and, if requested, its derivative w.r.t. s.
+    double Weight(double s, double* dw_ds) const
+    {
+        const double q = std::sqrt(1.0 + s * m_inv_loss_scale2);
+        const double w = std::sqrt(2.0 / (q + 1.0));
+        if(dw_ds) {
+            *dw_ds = -w * m_inv_loss_scale2 / (4.0 * q * (q + 1.0));
+        }
+        return w;
+    }
+
+    // Apply d(w(s) r)/dr = w I + 2 w'(s) r r^T to a 2 x n row major block.
+    void Robustify(const double* r, double* J, int n) const
+    {
+        if(!J) {
+            return;
+        }
+        const Eigen::Map<const Eigen::Vector2d> rv(r);
+        double dw_ds;
+        const double w = Weight(rv.squaredNorm(), &dw_ds);
+        const Eigen::Matrix2d W = w * Eigen::Matrix2d::Identity() +
+                2.0 * dw_ds * rv * rv.transpose();
+
+        Eigen::Map<Eigen::Matrix<double,2,Eigen::Dynamic,Eigen::RowMajor> > Jm(J, 2, n);
+        Jm = (W * Jm).eval();
+    }
+
+    std::vector<Eigen::Vector3d, Eigen::aligned_allocator<Eigen::Vector3d> > m_Pw;
+    std::vector<Eigen::Vector2d, Eigen::aligned_allocator<Eigen::Vector2d> > m_pc;
+    const Eigen::Vector3d* m_Pw_ref;
+    const Eigen::Vector2d* m_pc_ref;
+    size_t m_size;
+    double m_inv_loss_scale2;
+    bool m_tangent;
+};
+
+}
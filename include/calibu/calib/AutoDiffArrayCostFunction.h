@@ -21,6 +21,9 @@
 #pragma once
 
 #include <type_traits>
+#include <vector>
+
+#include <Eigen/StdVector>
 
 #include <ceres/ceres.h>
 
@@ -86,13 +89,16 @@ struct Take1stOrderPart<JetT,T,Start,FirstBlock,Blocks...>
 };
 
 
-template <typename CostBase, typename Derived, unsigned int NumResiduals, unsigned int... Blocks>
+// Automatic differentiation of Derived::Evaluate<T>(parameters, residuals)
+// w.r.t. all parameter blocks at once. NumResiduals may be DYNAMIC, in which
+// case the number of residuals is given at construction.
+template <typename CostBase, typename Derived, int NumResiduals, unsigned int... Blocks>
 class AutoDiffArrayCostFunction :
         public CostBase
 { 
 public:    
     
-    static const unsigned int num_residuals = NumResiduals;
+    static const int num_residuals = NumResiduals;
     static const unsigned int num_blocks = sizeof...(Blocks);
     static const unsigned int num_params = SumParams<Blocks...>::value;
     const unsigned int num_params_in_block[num_blocks] = {Blocks...};
@@ -100,10 +106,14 @@ public:
     typedef double T;
     typedef Jet<T, num_params> JetT;
     
-    AutoDiffArrayCostFunction()
+    AutoDiffArrayCostFunction(int dynamic_residuals = NumResiduals)
     {
+        static_assert(NumResiduals == DYNAMIC || NumResiduals > 0,
+                      "Invalid number of residuals");
+        
         // Set up residuals / params in base class
-        CostBase::set_num_residuals(num_residuals);
+        CostBase::set_num_residuals(
+                    NumResiduals == DYNAMIC ? dynamic_residuals : NumResiduals );
         
         for(unsigned int p=0; p < num_blocks; p++) {
             CostBase::mutable_parameter_block_sizes()->push_back( num_params_in_block[p] );            
@@ -123,7 +133,14 @@ public:
         if (!jacobians) {
             return derived().template Evaluate<T>(parameters, residuals);
         }else{
-            JetT jet_residuals[num_residuals];
+            const int M = CostBase::num_residuals();
+            
+            // Only dynamically sized costs allocate
+            JetT fixed_residuals[NumResiduals == DYNAMIC ? 1 : NumResiduals];
+            std::vector<JetT, Eigen::aligned_allocator<JetT> > dynamic_residuals(
+                        NumResiduals == DYNAMIC ? M : 0 );
+            JetT* jet_residuals = (NumResiduals == DYNAMIC) ?
+                        dynamic_residuals.data() : fixed_residuals;
             
             JetT x[num_params];
             int jet_start[num_blocks];
@@ -141,9 +158,9 @@ public:
                 return false;
             }
             
-            internal::Take0thOrderPart(num_residuals, jet_residuals, residuals);
+            internal::Take0thOrderPart(M, jet_residuals, residuals);
             
-            Take1stOrderPart<JetT, T, 0, Blocks...>::go(num_residuals, jet_residuals, jacobians);
+            Take1stOrderPart<JetT, T, 0, Blocks...>::go(M, jet_residuals, jacobians);
             
             return true;
         }
@@ -0,0 +1,144 @@
+/*
+   This file is part of the Calibu Project.
+   https://github.com/arpg/Calibu
+
+   Copyright (C) 2013 George Washington University,
+                      Steven Lovegrove,
+                      Gabe Sibley
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+   http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <iosfwd>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <Eigen/Eigen>
+#include <Eigen/StdVector>
+#include <sophus/se3.hpp>
+
+#include <calibu/Platform.h>
+#include <calibu/cam/camera_crtp.h>
+
+namespace calibu
+{
+
+/// Observations p_c[i] of target points P_w[i] by 'camera' in 'frame',
+/// read in place, e.g. from Calibrator's ObservationTable.
+struct ReportObservations
+{
+    uint32_t frame;
+    uint32_t camera;
+    const Eigen::Vector3d* P_w;
+    const Eigen::Vector2d* p_c;
+    size_t size;
+};
+
+struct ParamsCalibrationReport
+{
+    ParamsCalibrationReport()
+        : grid_cols(16), grid_rows(12), num_threads(0)
+    {
+    }
+
+    /// Cells each image is divided into for the residual and coverage maps.
+    int grid_cols;
+    int grid_rows;
+
+    /// Threads to project observations with, 0 for one per core.
+    unsigned int num_threads;
+};
+
+/// Reprojection residuals of one camera, r = Project(T_ck T_kw P_w) - p_c.
+struct CameraReport
+{
+    CameraReport()
+        : width(0), height(0), num_observations(0), num_failed(0),
+          rms(0), mean(0), median(0), p90(0), max(0),
+          bias(Eigen::Vector2d::Zero()), grid_cols(0), grid_rows(0),
+          coverage(0)
+    {
+    }
+
+    std::string type;
+    int width;
+    int height;
+
+    /// Observations of the camera, and those of them whose point was
+    /// behind it or couldn't be projected, which the statistics leave out.
+    size_t num_observations;
+    size_t num_failed;
+
+    /// Statistics of the residual norm, in pixels, and mean residual.
+    double rms;
+    double mean;
+    double median;
+    double p90;
+    double max;
+    Eigen::Vector2d bias;
+
+    /// Maps of grid_cols x grid_rows cells, row major, binned by where the
+    /// points were observed: observation count, rms residual norm and mean
+    /// residual of each cell. Empty cells are 0.
+    int grid_cols;
+    int grid_rows;
+    std::vector<uint32_t> cell_count;
+    std::vector<float> cell_rms;
+    std::vector<float> cell_bias_u;
+    std::vector<float> cell_bias_v;
+
+    /// Fraction of cells holding at least one observation.
+    double coverage;
+
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+};
+
+/// Reprojection quality of a calibration, per camera, see
+/// ComputeCalibrationReport.
+struct CALIBU_EXPORT CalibrationReport
+{
+    CalibrationReport() : num_observations(0), num_failed(0), rms(0) {}
+
+    /// Write the report as a JSON object.
+    void WriteJson(std::ostream& os) const;
+
+    /// Write the report to 'filename' as JSON. Returns false on failure.
+    bool SaveJson(const std::string& filename) const;
+
+    std::vector<CameraReport, Eigen::aligned_allocator<CameraReport> > cameras;
+
+    /// Totals over all cameras.
+    size_t num_observations;
+    size_t num_failed;
+    double rms;
+};
+
+/// Evaluate the residual of every observation through its camera's
+/// projection, given extrinsics T_ck of each camera and poses T_kw of each
+/// frame, and summarise them into 'report'. Observations are split between
+/// threads in batches, and projected through the cameras' SoA ProjectN, so
+/// cameras are snapshots and are only read.
+CALIBU_EXPORT void ComputeCalibrationReport(
+        const std::vector<std::shared_ptr<const CameraSnapshot<double> > >& cameras,
+        const std::vector<Sophus::SE3d, Eigen::aligned_allocator<Sophus::SE3d> >& T_ck,
+        const std::vector<Sophus::SE3d, Eigen::aligned_allocator<Sophus::SE3d> >& T_kw,
+        const std::vector<ReportObservations>& observations,
+        CalibrationReport& report,
+        const ParamsCalibrationReport& params = ParamsCalibrationReport()
+        );
+
+}
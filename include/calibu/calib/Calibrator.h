@@ -21,9 +21,12 @@
 
 #pragma once
 
-// Compile against new ceres covarience interface.
+// Report parameter variances from Calibrator::PrintResults.
 //#define CALIBU_CERES_COVAR
 
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <thread>
 #include <mutex>
 #include <memory>
@@ -34,18 +37,22 @@
 #include <calibu/Platform.h>
 #include <calibu/cam/camera_crtp.h>
 #include <calibu/cam/camera_xml.h>
+#include <calibu/calib/CalibrationReport.h>
+#include <calibu/calib/CalibratorCheckpoint.h>
 #include <calibu/calib/CostFunctionAndParams.h>
+#include <calibu/calib/FrameSelector.h>
+#include <calibu/calib/IntrinsicInitializer.h>
+#include <calibu/calib/ObservationSelector.h>
+#include <calibu/calib/ObservationTable.h>
+#include <calibu/pose/Pnp.h>
+#include <calibu/utils/PipelineStats.h>
 
 #include <ceres/ceres.h>
-
-#ifdef CALIBU_CERES_COVAR
 #include <ceres/covariance.h>
-#endif // CALIBU_CERES_COVAR
 
 #include <calibu/calib/LocalParamSe3.h>
 
-#include <calibu/calib/ReprojectionCostFunctor.h>
-#include <calibu/calib/CostFunctionAndParams.h>
+#include <calibu/calib/ReprojectionCostFactory.h>
 
 
 namespace calibu {
@@ -68,30 +75,241 @@ struct CameraAndPose
     Sophus::SE3d T_ck;
 };
 
+/// Cost of the observations in 'rows' of Calibrator's ObservationTable, all
+/// of one camera in one frame. Its parameters are found from the frame and
+/// camera of the rows when it is added to a problem.
+struct ObservationCost
+{
+    ObservationCost(const ObservationTable::Range& rows, bool single)
+        : cost(nullptr), loss(nullptr), rows(rows), single(single),
+          residual_block(nullptr)
+    {
+    }
+
+    /// Owned by Calibrator, as problems don't take ownership of costs.
+    ceres::CostFunction* cost;
+    ceres::LossFunction* loss;
+
+    ObservationTable::Range rows;
+
+    /// Whether this is the cost of a single observation, robustified by its
+    /// residual block's loss rather than per point, see AddObservation.
+    bool single;
+
+    /// Residual block of the cost in Calibrator's persistent problem, if
+    /// added.
+    ceres::ResidualBlockId residual_block;
+};
+
+/// Options controlling how Calibrator solves for its parameters.
+struct CalibratorOptions
+{
+    CalibratorOptions()
+        : num_threads(4),
+          linear_solver_type(ceres::Solver::Options().linear_solver_type),
+          preconditioner_type(ceres::Solver::Options().preconditioner_type),
+          max_num_iterations(10),
+          max_solver_time_in_seconds(ceres::Solver::Options().max_solver_time_in_seconds),
+          eliminate_frames_first(true),
+          analytic_jacobians(false),
+          tangent_jacobians(false),
+          outlier_threshold(0)
+    {
+    }
+
+    /// Threads used to evaluate costs and Jacobians.
+    int num_threads;
+
+    /// Linear solver used on each iteration. The Schur type solvers,
+    /// SPARSE_SCHUR and ITERATIVE_SCHUR, suit problems with many frames.
+    ceres::LinearSolverType linear_solver_type;
+
+    /// Preconditioner for ITERATIVE_SCHUR and CGNR.
+    ceres::PreconditionerType preconditioner_type;
+
+    /// Iterations per solve. The optimisation thread solves repeatedly
+    /// while running.
+    int max_num_iterations;
+
+    /// Time budget for each solve, in seconds.
+    double max_solver_time_in_seconds;
+
+    /// With a Schur type linear solver, eliminate frame poses, leaving
+    /// camera extrinsics and intrinsics in the reduced system. Otherwise
+    /// ceres chooses an elimination ordering itself.
+    bool eliminate_frames_first;
+
+    /// Use analytic rather than automatic derivatives for costs added, see
+    /// Calibrator::UseAnalyticJacobians.
+    bool analytic_jacobians;
+
+    /// Use analytic derivatives w.r.t. the tangent space of poses, which
+    /// saves the quaternion chain rule per residual. Takes precedence over
+    /// analytic_jacobians. Poses and costs must agree, so this is fixed when
+    /// the Calibrator is constructed.
+    bool tangent_jacobians;
+
+    /// Reprojection error in pixels above which observations are dropped,
+    /// or 0 to keep all of them. Outliers are looked for whenever a solve
+    /// converges, and the problem is solved again without them.
+    double outlier_threshold;
+};
+
+/// Copy of the calibration state, published by Calibrator while it
+/// optimises so that it can be read without waiting on the solver.
+struct CalibratorSnapshot
+{
+    CalibratorSnapshot()
+        : mse(0), num_residuals(0), num_outliers(0),
+          termination_type(ceres::NO_CONVERGENCE)
+    {
+    }
+
+    /// Pose of each frame, as for Calibrator::GetFrame.
+    std::vector<Sophus::SE3d, Eigen::aligned_allocator<Sophus::SE3d> > T_kw;
+
+    /// Extrinsics T_ck of each camera.
+    std::vector<Sophus::SE3d, Eigen::aligned_allocator<Sophus::SE3d> > T_ck;
+
+    /// Intrinsic parameters and calibration matrix of each camera.
+    std::vector<Eigen::VectorXd> params;
+    std::vector<Eigen::Matrix3d> K;
+
+    /// Immutable copy of each camera, to project through without locking.
+    std::vector<std::shared_ptr<const CameraSnapshot<double> > > cameras;
+
+    /// Mean square reprojection error, see Calibrator::MeanSquareError, and
+    /// the number of residuals it is averaged over.
+    double mse;
+    int num_residuals;
+
+    /// Number of observations dropped as outliers, see
+    /// CalibratorOptions::outlier_threshold.
+    size_t num_outliers;
+
+    /// Termination type of the last completed solve.
+    ceres::TerminationType termination_type;
+};
+
+/// Progress of one solver iteration, see CalibratorMetricsCallback.
+struct CalibratorIterationMetrics
+{
+    /// Solve the iteration belongs to, counting from zero for each Start(),
+    /// and iteration number within it.
+    int solve;
+    int iteration;
+
+    /// Objective value, its decrease on this iteration, and whether the
+    /// step was accepted.
+    double cost;
+    double cost_change;
+    bool step_is_successful;
+
+    /// Wall time of the iteration, and of solving its linear system.
+    double iteration_time_in_seconds;
+    double linear_solver_time_in_seconds;
+
+    /// Wall time since the start of the solve.
+    double cumulative_time_in_seconds;
+
+    int num_residuals;
+};
+
+/// Throughput of one solve, see CalibratorMetricsCallback.
+struct CalibratorSolveMetrics
+{
+    int solve;
+    int num_iterations;
+    ceres::TerminationType termination_type;
+
+    double initial_cost;
+    double final_cost;
+
+    /// Wall time of the solve, and the parts of it ceres spent evaluating
+    /// residuals, evaluating Jacobians and solving linear systems.
+    double total_time_in_seconds;
+    double residual_evaluation_time_in_seconds;
+    double jacobian_evaluation_time_in_seconds;
+    double linear_solver_time_in_seconds;
+
+    /// Size of the problem solved.
+    int num_frames;
+    int num_residuals;
+
+    /// Frames added to the problem per second of wall time, since the
+    /// previous solve or Start().
+    double frames_per_second;
+
+    /// Time all threads spent waiting to lock the calibrator's state since
+    /// the previous solve or Start(), summed over threads. High values mean
+    /// observations are added faster than the solver releases its lock.
+    double lock_wait_in_seconds;
+};
+
+/// Receives metrics from the optimisation thread, see
+/// Calibrator::SetMetricsCallback. Called without Calibrator's lock held.
+class CalibratorMetricsCallback
+{
+public:
+    virtual ~CalibratorMetricsCallback() {}
+
+    /// Called after every solver iteration.
+    virtual void OnIteration(const CalibratorIterationMetrics& /*metrics*/) {}
+
+    /// Called when a solve completes.
+    virtual void OnSolve(const CalibratorSolveMetrics& /*metrics*/) {}
+};
+
+/// Marginal covariances of one camera's calibration, see
+/// Calibrator::ComputeCovariance.
+struct CameraCovariance
+{
+    /// Covariance of the intrinsic parameters, zero if they are fixed.
+    Eigen::MatrixXd intrinsics;
+
+    /// Covariance of the extrinsic parameters T_ck, in the order Sophus
+    /// stores them (quaternion x, y, z, w then translation). Camera 0
+    /// defines the rig frame, so its covariance is zero.
+    Eigen::Matrix<double,7,7> extrinsics;
+};
+
 CALIBU_EXPORT
 class Calibrator
 {
 public:
     
     /// Construct empty calibration object.
-    Calibrator() :
+    Calibrator(const CalibratorOptions& options = CalibratorOptions()) :
         m_running(false),
         m_fix_intrinsics(false),
-        m_LossFunction( new ceres::SoftLOneLoss(0.5), ceres::TAKE_OWNERSHIP )
+        m_options(options),
+        m_tangent_jacobians(options.tangent_jacobians),
+        m_max_frames(0),
+        m_termination_type(ceres::NO_CONVERGENCE),
+        m_checkpoint_interval(60),
+        m_lock_wait_ns(0),
+        m_default_loss_scale(0.5),
+        m_num_outliers(0)
     {
         m_prob_options.cost_function_ownership = ceres::DO_NOT_TAKE_OWNERSHIP;
+#ifdef CALIBU_CERES_HAS_LOCAL_PARAMETERIZATION
         m_prob_options.local_parameterization_ownership = ceres::DO_NOT_TAKE_OWNERSHIP;
+#endif
+#ifdef CALIBU_CERES_HAS_MANIFOLD
+        m_prob_options.manifold_ownership = ceres::DO_NOT_TAKE_OWNERSHIP;
+#endif
         m_prob_options.loss_function_ownership = ceres::DO_NOT_TAKE_OWNERSHIP;
-        
-        m_solver_options.num_threads = 4;
-        m_solver_options.update_state_every_iteration = true;
-        m_solver_options.max_num_iterations = 10;
+        // Outliers are removed from the problem one block at a time
+        m_prob_options.enable_fast_removal = true;
         
         Clear();
     }
     
     ~Calibrator()
     {
+        Stop();
+        m_problem.reset();
+        ClearCosts();
     }
 
     /// Write XML file containing configuration of camera rig.
@@ -112,17 +330,41 @@ public:
     void Clear()
     {
         Stop();
+        m_problem.reset();
         m_T_kw.clear();
         m_camera.clear();
-        m_costs.clear();
+        m_cost_factories.clear();
+        m_loss_scale.clear();
+        m_loss_scale_pending.clear();
+        m_loss_functions.clear();
+        ClearCosts();
+        if(m_frame_selector) {
+            m_frame_selector->Clear();
+        }
+        if(m_observation_selector) {
+            m_observation_selector->Clear();
+        }
         m_mse = 0;
+        m_num_residuals = 0;
+        m_num_outliers = 0;
+        m_termination_type = ceres::NO_CONVERGENCE;
+
+        std::lock_guard<std::mutex> lock(m_update_mutex);
+        PublishSnapshot();
     }
     
     /// Start optimisation thread to modify intrinsic / extrinsic parameters
     void Start()
     {
         if(!m_running) {
+            // Don't report convergence of a previous run.
+            {
+                std::lock_guard<std::mutex> lock(m_update_mutex);
+                m_termination_type = ceres::NO_CONVERGENCE;
+                PublishSnapshot();
+            }
             m_should_run = true;
+            m_running = true;
             m_thread = std::thread(std::bind( &Calibrator::SolveThread, this )) ;
         }else{
             std::cerr << "Already Running." << std::endl;
@@ -143,16 +385,61 @@ public:
     }
  
     /// Add camera to sensor rig. The returned ID should be used when adding
-    /// measurements for this camera
+    /// measurements for this camera. Costs for the camera are created by
+    /// cost_factory, which by default is found from CalibratorCameraModels.
     int AddCamera(const std::shared_ptr<CameraInterface<double>> cam,
-                  const Sophus::SE3d& T_ck = Sophus::SE3d() )
+                  const Sophus::SE3d& T_ck = Sophus::SE3d(),
+                  std::shared_ptr<ReprojectionCostFactory> cost_factory = nullptr )
     {
+        if(!cost_factory) {
+            cost_factory = CalibratorCameraModels::NewCostFactory(cam.get());
+        }
+        if(!cost_factory) {
+            throw std::runtime_error("Don't know how to optimize Camera.");
+        }
+
         int id = m_camera.size();
+        m_cost_factories.push_back(cost_factory);
+        m_loss_scale.push_back(m_default_loss_scale);
+        m_loss_scale_pending.push_back(false);
+        m_loss_functions.push_back(make_unique<ceres::LossFunctionWrapper>(
+                new ceres::SoftLOneLoss(m_default_loss_scale), ceres::TAKE_OWNERSHIP));
         m_camera.push_back( make_unique<CameraAndPose>(cam,T_ck) );
         m_camera.back()->camera->SetIndex(id);
+
+        std::lock_guard<std::mutex> lock(m_update_mutex);
+        if(!m_running) {
+            PublishSnapshot();
+        }
         return id;
     }
     
+    /// Set scale in pixels of the soft L1 loss robustifying observations of
+    /// 'camera', or <= 0 for plain least squares. Observations added with
+    /// AddObservation follow the change, from the next solve if the
+    /// optimiser is running; those added with AddObservations keep the scale
+    /// they were added with, so this is best set before observations are
+    /// added.
+    void SetLossScale(size_t camera, double scale)
+    {
+        std::unique_lock<std::mutex> lock = LockUpdate();
+        if( NumCameras() <= camera ) { throw std::runtime_error("Bad camera index."); }
+        if(m_running) {
+            // The running solve may be evaluating the current loss, so it is
+            // replaced between solves, see ExtendProblem
+            m_loss_scale[camera] = scale;
+            m_loss_scale_pending[camera] = true;
+        }else{
+            ResetLossScale(camera, scale);
+        }
+    }
+
+    /// Return scale of the loss robustifying observations of 'camera'.
+    double LossScale(size_t camera) const
+    {
+        return m_loss_scale[camera];
+    }
+
     /// Set whether intrinsics should be 'fixed' and left unchanged by the
     /// minimization.
     void FixCameraIntrinsics(bool v = true)
@@ -160,16 +447,96 @@ public:
         m_fix_intrinsics = v;
     }
  
+    /// Set whether costs should use analytic Jacobians, composed from the
+    /// camera model derivatives, rather than automatic differentiation.
+    /// Applies to observations added afterwards.
+    void UseAnalyticJacobians(bool v = true)
+    {
+        std::lock_guard<std::mutex> lock(m_update_mutex);
+        m_options.analytic_jacobians = v;
+    }
+
+    /// Set solver options. Solver settings take effect from the next solve.
+    void SetOptions(const CalibratorOptions& options)
+    {
+        std::lock_guard<std::mutex> lock(m_update_mutex);
+        m_options = options;
+    }
+
+    /// Return current solver options.
+    CalibratorOptions Options()
+    {
+        std::lock_guard<std::mutex> lock(m_update_mutex);
+        return m_options;
+    }
+
+    /// Set selector used by SelectFrame to reject redundant frames, or
+    /// nullptr to accept all frames.
+    void SetFrameSelector(const std::shared_ptr<FrameSelector>& selector)
+    {
+        std::lock_guard<std::mutex> lock(m_update_mutex);
+        m_frame_selector = selector;
+    }
+
+    /// Set selector used by AddObservation and AddObservations to thin out
+    /// observations in densely covered parts of the images, or nullptr to
+    /// add all observations.
+    void SetObservationSelector(const std::shared_ptr<ObservationSelector>& selector)
+    {
+        std::lock_guard<std::mutex> lock(m_update_mutex);
+        m_observation_selector = selector;
+    }
+
+    /// Set callback receiving solver progress and throughput from the
+    /// optimisation thread, or nullptr for none. Takes effect from the next
+    /// solve.
+    void SetMetricsCallback(const std::shared_ptr<CalibratorMetricsCallback>& callback)
+    {
+        std::lock_guard<std::mutex> lock(m_update_mutex);
+        m_metrics_callback = callback;
+    }
+
+    /// Set maximum number of frames SelectFrame will accept, bounding the
+    /// size of the problem. 0 for no limit.
+    void SetMaxFrames(size_t max_frames)
+    {
+        m_max_frames = max_frames;
+    }
+
+    /// Return true if a frame with initial pose T_kw, in which camera c
+    /// observed the points p_c[c], should be added to the calibration, and
+    /// record it with the frame selector. Frames are rejected once the frame
+    /// budget is spent, or if the frame selector finds them redundant.
+    bool SelectFrame(const Sophus::SE3d& T_kw, const std::vector<FramePoints>& p_c)
+    {
+        std::unique_lock<std::mutex> lock = LockUpdate();
+
+        if(m_max_frames > 0 && NumFrames() >= m_max_frames) {
+            return false;
+        }
+
+        if(m_frame_selector) {
+            if(!m_frame_selector->IsInformative(T_kw, p_c)) {
+                return false;
+            }
+            m_frame_selector->Add(T_kw, p_c);
+        }
+        return true;
+    }
+
     /// Add frame to optimiser. The returned ID should be used when adding
     /// target measurements for a given moment in time. Measurements given
     /// for any camera for a given frame are assumed to be simultaneous, with
     /// camera extrinsics equal between all cameras for each frame.
     int AddFrame(Sophus::SE3d T_kw = Sophus::SE3d())
     {
-        m_update_mutex.lock();
+        std::unique_lock<std::mutex> lock = LockUpdate();
         int id = m_T_kw.size();
         m_T_kw.push_back( make_unique<Sophus::SE3d>(T_kw) );
-        m_update_mutex.unlock();
+        if(!m_running) {
+            // Otherwise the solver will publish it shortly
+            PublishSnapshot();
+        }
         
         return id;
     }
@@ -182,55 +549,120 @@ public:
             const Eigen::Vector3d& P_w,
             const Eigen::Vector2d& p_c
             ) {
-        m_update_mutex.lock();
+        CALIBU_PIPELINE_TIMER(timer, STAGE_ADD_OBSERVATION);
+        std::unique_lock<std::mutex> lock = LockUpdate();
  
         // Ensure index is valid
-        while( NumFrames() < frame) { AddFrame(); }
-        if( NumCameras() < camera ) { throw std::runtime_error("Bad camera index. Add all cameras first."); }
-        
-        // new camera pose to bundle adjust
-        
-        CameraAndPose& cp = *m_camera[camera];
-        Sophus::SE3d& T_kw = *m_T_kw[frame];
-        
-        // Create cost function
-        CostFunctionAndParams* cost = new CostFunctionAndParams();
-
-        std::shared_ptr<CameraInterface<double>> interface = cp.camera;
-
-        if( dynamic_cast<FovCamera<double>* >(interface.get()) ) {
-            cost->Cost() =  new ceres::AutoDiffCostFunction<ReprojectionCostFunctor<FovCamera<double>>,
-                    2, Sophus::SE3d::num_parameters, Sophus::SE3d::num_parameters,
-                    calibu::FovCamera<double>::NumParams>( new ReprojectionCostFunctor<FovCamera<double>>(P_w, p_c) );
-        } else if( dynamic_cast<Poly2Camera<double>* >(interface.get()) ) {
-            cost->Cost() =  new ceres::AutoDiffCostFunction<ReprojectionCostFunctor<Poly2Camera<double>>,
-                    2, Sophus::SE3d::num_parameters, Sophus::SE3d::num_parameters,
-                    calibu::Poly2Camera<double>::NumParams>( new ReprojectionCostFunctor<Poly2Camera<double>>(P_w, p_c) );
-        } else if( dynamic_cast<LinearCamera<double>* >(interface.get()) ) {
-            cost->Cost() =  new ceres::AutoDiffCostFunction<ReprojectionCostFunctor<LinearCamera<double>>,
-                    2, Sophus::SE3d::num_parameters, Sophus::SE3d::num_parameters,
-                    calibu::LinearCamera<double>::NumParams>( new ReprojectionCostFunctor<LinearCamera<double>>(P_w, p_c) );
-        } else if( dynamic_cast<Poly3Camera<double>* >(interface.get()) ) {
-            cost->Cost() =  new ceres::AutoDiffCostFunction<ReprojectionCostFunctor<Poly3Camera<double>>,
-                    2, Sophus::SE3d::num_parameters, Sophus::SE3d::num_parameters,
-                    calibu::Poly3Camera<double>::NumParams>( new ReprojectionCostFunctor<Poly3Camera<double>>(P_w, p_c) );
-        } else if( dynamic_cast<KannalaBrandtCamera<double>* >(interface.get()) ) {
-            cost->Cost() =  new ceres::AutoDiffCostFunction<ReprojectionCostFunctor<KannalaBrandtCamera<double>>,
-                    2, Sophus::SE3d::num_parameters, Sophus::SE3d::num_parameters,
-                    calibu::KannalaBrandtCamera<double>::NumParams>( new ReprojectionCostFunctor<KannalaBrandtCamera<double>>(P_w, p_c) );
-        } else {
-            throw std::runtime_error("Don't know how to optimize Camera.");
-        }
+        while( NumFrames() <= frame) { m_T_kw.push_back( make_unique<Sophus::SE3d>() ); }
+        if( NumCameras() <= camera ) { throw std::runtime_error("Bad camera index. Add all cameras first."); }
 
-        cost->Params() = std::vector<double*>{
-                T_kw.data(), cp.T_ck.data(), cp.camera->GetParams().data()
-        };
-        cost->Loss() = &m_LossFunction;
-        m_costs.push_back(std::unique_ptr<CostFunctionAndParams>(cost));
+        if(m_observation_selector) {
+            std::vector<size_t> selected;
+            m_observation_selector->Select(camera, FramePoints(1, p_c), selected);
+            if(selected.empty()) {
+                return;
+            }
+        }
         
-        m_update_mutex.unlock();
+        m_costs.push_back(NewObservationCost(frame, camera, P_w, p_c));
     }
     
+    /// Add observations p_c[i] of 3D features P_w[i] from 'camera' for
+    /// 'frame', as a single residual block. Equivalent to calling
+    /// AddObservation for every point, but takes the update lock only once.
+    void AddObservations(
+            size_t frame, size_t camera,
+            const std::vector<Eigen::Vector3d,
+                              Eigen::aligned_allocator<Eigen::Vector3d> >& P_w,
+            const std::vector<Eigen::Vector2d,
+                              Eigen::aligned_allocator<Eigen::Vector2d> >& p_c
+            ) {
+        if( P_w.size() != p_c.size() ) { throw std::runtime_error("Mismatched observation count."); }
+        if( P_w.empty() ) { return; }
+
+        CALIBU_PIPELINE_TIMER(timer, STAGE_ADD_OBSERVATION);
+        std::unique_lock<std::mutex> lock = LockUpdate();
+
+        // Ensure index is valid
+        while( NumFrames() <= frame) { m_T_kw.push_back( make_unique<Sophus::SE3d>() ); }
+        if( NumCameras() <= camera ) { throw std::runtime_error("Bad camera index. Add all cameras first."); }
+
+        // Keep only the observations the selector chooses
+        if(m_observation_selector) {
+            std::vector<size_t> selected;
+            m_observation_selector->Select(camera, p_c, selected);
+            if(selected.empty()) {
+                return;
+            }
+            std::vector<Eigen::Vector3d,
+                        Eigen::aligned_allocator<Eigen::Vector3d> > sel_P_w;
+            FramePoints sel_p_c;
+            for(size_t i : selected) {
+                sel_P_w.push_back(P_w[i]);
+                sel_p_c.push_back(p_c[i]);
+            }
+            m_costs.push_back(NewObservationsCost(frame, camera, sel_P_w, sel_p_c));
+        }else{
+            m_costs.push_back(NewObservationsCost(frame, camera, P_w, p_c));
+        }
+    }
+
+    /// Replace the intrinsics of 'camera' with a closed form estimate from
+    /// the observations added so far, see calibu::InitializeIntrinsics, so
+    /// that optimisation starts near the solution rather than from a
+    /// generic guess. Frames first observed by 'camera' (none of a lower
+    /// index observes them) are re-posed with PnP through the new
+    /// intrinsics. Returns false, leaving the calibration unchanged, if the
+    /// optimiser is running or there are too few observations.
+    bool InitializeIntrinsics(
+            size_t camera,
+            const IntrinsicInitializerOptions& options = IntrinsicInitializerOptions())
+    {
+        if(m_running) {
+            return false;
+        }
+
+        std::unique_lock<std::mutex> lock = LockUpdate();
+        if( NumCameras() <= camera ) { throw std::runtime_error("Bad camera index."); }
+
+        // Observations of 'camera' and the lowest camera observing each frame
+        std::vector<std::vector<Eigen::Vector3d,
+                    Eigen::aligned_allocator<Eigen::Vector3d> > > P_w(NumFrames());
+        std::vector<FramePoints> p_c(NumFrames());
+        std::vector<size_t> first_camera(NumFrames(), NumCameras());
+        for(const ObservationCost& cost : m_costs) {
+            const size_t f = m_observations.Frame(cost.rows);
+            const size_t c = m_observations.Camera(cost.rows);
+            first_camera[f] = std::min(first_camera[f], c);
+            if(c == camera) {
+                const Eigen::Vector3d* cost_P_w = m_observations.P_w(cost.rows);
+                const Eigen::Vector2d* cost_p_c = m_observations.p_c(cost.rows);
+                P_w[f].insert(P_w[f].end(), cost_P_w, cost_P_w + cost.rows.size);
+                p_c[f].insert(p_c[f].end(), cost_p_c, cost_p_c + cost.rows.size);
+            }
+        }
+
+        CameraAndPose& cap = *m_camera[camera];
+        if(!calibu::InitializeIntrinsics(*cap.camera, P_w, p_c, options)) {
+            return false;
+        }
+
+        for(size_t f = 0; f < NumFrames(); ++f) {
+            if(first_camera[f] == camera && P_w[f].size() >= 4) {
+                std::vector<int> map(P_w[f].size());
+                for(size_t i = 0; i < map.size(); ++i) {
+                    map[i] = i;
+                }
+                Sophus::SE3d T_cw = cap.T_ck * *m_T_kw[f];
+                PosePnPRansac(cap.camera, p_c[f], P_w[f], map, 0, 0, &T_cw);
+                *m_T_kw[f] = cap.T_ck.inverse() * T_cw;
+            }
+        }
+
+        PublishSnapshot();
+        return true;
+    }
+
     /// Return number of synchronised camera rig frames
     size_t NumFrames() const
     {
@@ -259,164 +691,828 @@ public:
     /// being minimised by optimisation.
     double MeanSquareError() const
     {
-        return m_mse;
+        return Snapshot()->mse;
     }
 
     /// Return true if one of the tolerance criteria is reached.
-    bool ReachedTolerance()
+    bool ReachedTolerance() const
+    {
+      return ((Snapshot()->termination_type == ceres::CONVERGENCE));
+    }
+
+    /// Block until one of the tolerance criteria is reached, the optimiser
+    /// is stopped, or timeout_seconds pass. Returns ReachedTolerance().
+    bool WaitForTolerance(double timeout_seconds)
+    {
+        std::unique_lock<std::mutex> lock(m_update_mutex);
+        m_solve_done.wait_for(lock, std::chrono::duration<double>(timeout_seconds), [this]() {
+            return m_termination_type == ceres::CONVERGENCE || !m_running;
+        });
+        return m_termination_type == ceres::CONVERGENCE;
+    }
+
+    /// Return the most recently published calibration state. This never
+    /// blocks, and is safe to call while the optimiser is running, unlike
+    /// GetFrame and GetCamera. The state is republished after every solver
+    /// iteration, and when frames or cameras are added while stopped.
+    std::shared_ptr<const CalibratorSnapshot> Snapshot() const
     {
-      return ((m_termination_type == ceres::CONVERGENCE));
+        return std::atomic_load(&m_snapshot);
     }
 
 
-#ifdef CALIBU_CERES_COVAR    
-    /// Print summary of calibration
-    void PrintResults()
+    /// Compute marginal covariances of every camera's intrinsics and
+    /// extrinsics at the current estimate, using sparse QR factorisation
+    /// of the problem's Jacobian with CalibratorOptions::num_threads threads.
+    /// Returns false if the optimiser is running, or if the covariance could
+    /// not be computed (e.g. too few observations for a full rank Jacobian).
+    bool ComputeCovariance(std::vector<CameraCovariance>& covariances)
     {
-        if(m_costs.size() < 10)
-            return;
-        
-        ceres::Problem problem(m_prob_options);
-        SetupProblem(problem);
-        
+        if(m_running) {
+            return false;
+        }
+
+        // Reuse the problem kept between solves
+        if(!m_problem) {
+            m_problem.reset(new ceres::Problem(m_prob_options));
+            m_problem_cameras = m_problem_frames = m_problem_costs = 0;
+        }
+        ExtendProblem(*m_problem, m_problem_cameras, m_problem_frames, m_problem_costs);
+
         ceres::Covariance::Options cov_options;
+        cov_options.algorithm_type = ceres::SPARSE_QR;
+        cov_options.num_threads = Options().num_threads;
         ceres::Covariance covariance(cov_options);
-        
-        std::vector<std::pair<const double*, const double*> > cov_blocks;
 
-        const int cam_block_size = CameraModelT<ProjModel>::NUM_PARAMS;
-        const int pose_block_size = Sophus::SE3d::num_parameters;
-        
-        // Setup which blocks of covarience to request.
+        // Blocks held constant have zero covariance, so aren't requested
+        std::vector<std::pair<const double*, const double*> > cov_blocks;
+        covariances.resize(m_camera.size());
         for(size_t c=0; c < m_camera.size(); ++c) {
-            const double* cam_block = m_camera[c]->camera.data();
-            cov_blocks.push_back(std::make_pair(cam_block,cam_block) );
-            
+            const double* cam_block = m_camera[c]->camera->GetParams().data();
+            const int cam_block_size = m_camera[c]->camera->NumParams();
+            covariances[c].intrinsics.setZero(cam_block_size, cam_block_size);
+            covariances[c].extrinsics.setZero();
+
+            if(!m_fix_intrinsics) {
+                cov_blocks.push_back( std::make_pair(cam_block, cam_block) );
+            }
             if(c > 0) {
                 const double* pose_block = m_camera[c]->T_ck.data();
                 cov_blocks.push_back( std::make_pair(pose_block, pose_block) );
             }
-            
         }
-        
-        // Compute sparse covarience
-        if(covariance.Compute(cov_blocks, &problem)) {
-            std::cout << "------------------------------------------" << std::endl;        
-            
-            // Retrieve covariences for parameters
-            for(size_t c=0; c < m_camera.size(); ++c) {                
-                std::cout << "Camera: " << c << std::endl;
-
-                const double* cam_block = m_camera[c]->camera.data();
-                Eigen::Matrix<double,cam_block_size,cam_block_size> cam_cov;
-                covariance.GetCovarianceBlock(cam_block,cam_block, cam_cov.data());
-                std::cout << m_camera[c]->camera.Params().transpose() << std::endl;
-                std::cout << "Variance: " << cam_cov.diagonal() << std::endl;            
-                
-                if(c > 0) {
-                    const double* poseblock = m_camera[c]->T_ck.data();
-                    Eigen::Matrix<double,pose_block_size,pose_block_size> pose_cov;
-                    covariance.GetCovarianceBlock(poseblock,poseblock, pose_cov.data());
-                    std::cout << m_camera[c]->T_ck.matrix3x4() << std::endl << std::endl;
-                    std::cout << "Variance: " << pose_cov.diagonal() << std::endl;
-                }
-                
-            }        
+
+        if(cov_blocks.empty()) {
+            return true;
+        }
+
+        if(!covariance.Compute(cov_blocks, m_problem.get())) {
+            return false;
         }
+
+        // Covariance blocks are returned row major
+        for(size_t c=0; c < m_camera.size(); ++c) {
+            if(!m_fix_intrinsics) {
+                const double* cam_block = m_camera[c]->camera->GetParams().data();
+                Eigen::Matrix<double,Eigen::Dynamic,Eigen::Dynamic,Eigen::RowMajor>
+                        cam_cov(covariances[c].intrinsics.rows(), covariances[c].intrinsics.cols());
+                covariance.GetCovarianceBlock(cam_block, cam_block, cam_cov.data());
+                covariances[c].intrinsics = cam_cov;
+            }
+            if(c > 0) {
+                const double* pose_block = m_camera[c]->T_ck.data();
+                Eigen::Matrix<double,7,7,Eigen::RowMajor> pose_cov;
+                covariance.GetCovarianceBlock(pose_block, pose_block, pose_cov.data());
+                covariances[c].extrinsics = pose_cov;
+            }
+        }
+        return true;
+    }
+
+    /// Write frames, camera parameters, observations and solver state to
+    /// 'filename', see CalibratorCheckpoint. Returns false if the optimiser
+    /// is running, as it modifies the parameters, or if writing fails. Use
+    /// SetCheckpointFile to checkpoint while optimising.
+    bool SaveCheckpoint(const std::string& filename)
+    {
+        if(m_running) {
+            return false;
+        }
+        CalibratorCheckpoint checkpoint;
+        {
+            std::unique_lock<std::mutex> lock = LockUpdate();
+            MakeCheckpoint(checkpoint);
+        }
+        return checkpoint.Save(filename);
+    }
+
+    /// Restore state written by SaveCheckpoint or the optimisation thread,
+    /// replacing all frames and observations, so that optimisation continues
+    /// from there on Start(). The same cameras must have been added first,
+    /// in the same order. Frame and observation selectors that are set are
+    /// primed with the restored observations. Returns false, leaving the
+    /// calibration unchanged, if the optimiser is running, or if the file
+    /// can't be read or doesn't match the cameras.
+    bool LoadCheckpoint(const std::string& filename)
+    {
+        if(m_running) {
+            return false;
+        }
+
+        CalibratorCheckpoint checkpoint;
+        if(!checkpoint.Load(filename)) {
+            return false;
+        }
+
+        std::unique_lock<std::mutex> lock = LockUpdate();
+        if(checkpoint.cameras.size() != m_camera.size()) {
+            return false;
+        }
+        for(size_t c=0; c<m_camera.size(); ++c) {
+            const CameraInterface<double>& cam = *m_camera[c]->camera;
+            if(checkpoint.cameras[c].type != cam.Type() ||
+               checkpoint.cameras[c].params.size() != cam.NumParams()) {
+                return false;
+            }
+        }
+
+        RestoreCheckpoint(checkpoint);
+        PublishSnapshot();
+        return true;
+    }
+
+    /// Have the optimisation thread write a checkpoint to 'filename' after
+    /// a solve, at most once every interval_seconds, and when it stops.
+    /// An empty filename disables checkpointing.
+    void SetCheckpointFile(const std::string& filename, double interval_seconds = 60)
+    {
+        std::lock_guard<std::mutex> lock(m_update_mutex);
+        m_checkpoint_file = filename;
+        m_checkpoint_interval = interval_seconds;
     }
-    
-#else  // CALIBU_CERES_COVAR
 
     /// Print summary of calibration
     void PrintResults()
     {
         std::cout << "------------------------------------------" << std::endl;        
+
+        // Uncertainties are costlier, so they are only computed and reported
+        // when built with CALIBU_CERES_COVAR defined
+        std::vector<CameraCovariance> covariances;
+#ifdef CALIBU_CERES_COVAR
+        const bool have_covariance = ComputeCovariance(covariances);
+#else
+        const bool have_covariance = false;
+#endif // CALIBU_CERES_COVAR
         
-        for(size_t c=0; c < m_camera.size(); ++c) {
+        for(size_t c=0; c<m_camera.size(); ++c) {
             std::cout << "Camera: " << c << std::endl;
             std::cout << m_camera[c]->camera->GetParams().transpose() << std::endl;
+            if(have_covariance) {
+                std::cout << "Variance: " << covariances[c].intrinsics.diagonal().transpose() << std::endl;
+            }
             
             if(c > 0) {
                 std::cout << m_camera[c]->T_ck.matrix3x4() << std::endl;
+                if(have_covariance) {
+                    std::cout << "Variance: " << covariances[c].extrinsics.diagonal().transpose() << std::endl;
+                }
             }
             std::cout << std::endl;
         }        
     }
-#endif // CALIBU_CERES_COVAR
+
+    /// Evaluate every observation in use at the current estimate, and
+    /// summarise their reprojection residuals per camera, see
+    /// ComputeCalibrationReport. Returns false if the optimiser is running.
+    bool Report(CalibrationReport& report,
+                const ParamsCalibrationReport& params = ParamsCalibrationReport())
+    {
+        if(m_running) {
+            return false;
+        }
+        std::unique_lock<std::mutex> lock = LockUpdate();
+
+        std::vector<std::shared_ptr<const CameraSnapshot<double> > > cameras;
+        std::vector<Sophus::SE3d, Eigen::aligned_allocator<Sophus::SE3d> > T_ck;
+        for(size_t c=0; c<m_camera.size(); ++c) {
+            cameras.push_back(m_camera[c]->camera->Snapshot());
+            T_ck.push_back(m_camera[c]->T_ck);
+        }
+        std::vector<Sophus::SE3d, Eigen::aligned_allocator<Sophus::SE3d> > T_kw;
+        for(const std::unique_ptr<Sophus::SE3d>& T : m_T_kw) {
+            T_kw.push_back(*T);
+        }
+
+        std::vector<ReportObservations> observations;
+        observations.reserve(m_costs.size());
+        for(const ObservationCost& cost : m_costs) {
+            ReportObservations obs;
+            obs.frame = m_observations.Frame(cost.rows);
+            obs.camera = m_observations.Camera(cost.rows);
+            obs.P_w = m_observations.P_w(cost.rows);
+            obs.p_c = m_observations.p_c(cost.rows);
+            obs.size = cost.rows.size;
+            observations.push_back(obs);
+        }
+
+        ComputeCalibrationReport(cameras, T_ck, T_kw, observations, report, params);
+        return true;
+    }
     
 protected:
-    
+
+    /// Return how new costs should compute their Jacobians.
+    CostJacobians CostJacobianType() const
+    {
+        if(m_tangent_jacobians) {
+            return COST_JACOBIANS_ANALYTIC_TANGENT;
+        }
+        return m_options.analytic_jacobians ?
+                    COST_JACOBIANS_ANALYTIC : COST_JACOBIANS_AUTODIFF;
+    }
+
+    /// Return cost for the single observation p_c of P_w from 'camera' in
+    /// 'frame', robustified by the camera's loss function.
+    ObservationCost NewObservationCost(
+            size_t frame, size_t camera,
+            const Eigen::Vector3d& P_w, const Eigen::Vector2d& p_c)
+    {
+        ObservationCost cost(m_observations.Add(frame, camera, &P_w, &p_c, 1), true);
+        cost.cost = m_cost_factories[camera]->NewCost(P_w, p_c, CostJacobianType());
+        cost.loss = m_loss_functions[camera].get();
+        return cost;
+    }
+
+    /// Return single residual block cost for observations p_c[i] of P_w[i]
+    /// from 'camera' in 'frame', robustified per point by the functor itself.
+    ObservationCost NewObservationsCost(
+            size_t frame, size_t camera,
+            const std::vector<Eigen::Vector3d,
+                              Eigen::aligned_allocator<Eigen::Vector3d> >& P_w,
+            const FramePoints& p_c)
+    {
+        return NewRowsCost(m_observations.Add(
+                               frame, camera, P_w.data(), p_c.data(), P_w.size()));
+    }
+
+    /// Return single residual block cost for the observations in 'rows',
+    /// which it reads from m_observations in place.
+    ObservationCost NewRowsCost(const ObservationTable::Range& rows)
+    {
+        const size_t camera = m_observations.Camera(rows);
+        ObservationCost cost(rows, false);
+        cost.cost = m_cost_factories[camera]->NewCosts(
+                    m_observations.P_w(rows), m_observations.p_c(rows), rows.size,
+                    m_loss_scale[camera], CostJacobianType());
+        return cost;
+    }
+
+    /// Add cost's residual block to problem.
+    ceres::ResidualBlockId AddCost(ceres::Problem& problem, const ObservationCost& cost)
+    {
+        CameraAndPose& cp = *m_camera[m_observations.Camera(cost.rows)];
+        Sophus::SE3d& T_kw = *m_T_kw[m_observations.Frame(cost.rows)];
+        return problem.AddResidualBlock(
+                    cost.cost, cost.loss,
+                    T_kw.data(), cp.T_ck.data(), cp.camera->GetParams().data());
+    }
+
+    /// Delete all costs and the observations they refer to. Called while no
+    /// problem refers to them.
+    void ClearCosts()
+    {
+        for(ObservationCost& cost : m_costs) {
+            delete cost.cost;
+        }
+        m_costs.clear();
+        m_observations.Clear();
+    }
+
+    /// Set loss scale of 'camera', see SetLossScale. Called with
+    /// m_update_mutex held, while no solve is using the loss.
+    void ResetLossScale(size_t camera, double scale)
+    {
+        m_loss_scale[camera] = scale;
+        m_loss_scale_pending[camera] = false;
+        m_loss_functions[camera]->Reset(
+                    scale > 0 ? new ceres::SoftLOneLoss(scale) : nullptr,
+                    ceres::TAKE_OWNERSHIP);
+    }
+
+    /// Apply loss scales set while a solve was running. Called with
+    /// m_update_mutex held, between solves.
+    void ApplyPendingLossScales()
+    {
+        for(size_t c=0; c<m_loss_scale_pending.size(); ++c) {
+            if(m_loss_scale_pending[c]) {
+                ResetLossScale(c, m_loss_scale[c]);
+            }
+        }
+    }
+
+    /// Copy state into 'checkpoint'. Called with m_update_mutex held, while
+    /// parameters aren't being modified.
+    void MakeCheckpoint(CalibratorCheckpoint& checkpoint)
+    {
+        for(const std::unique_ptr<Sophus::SE3d>& T_kw : m_T_kw) {
+            checkpoint.T_kw.push_back(*T_kw);
+        }
+        for(size_t c=0; c<m_camera.size(); ++c) {
+            CalibratorCheckpoint::Camera cam;
+            cam.type = m_camera[c]->camera->Type();
+            cam.params = m_camera[c]->camera->GetParams();
+            cam.T_ck = m_camera[c]->T_ck;
+            cam.loss_scale = m_loss_scale[c];
+            checkpoint.cameras.push_back(cam);
+        }
+        for(const ObservationCost& cost : m_costs) {
+            CalibratorCheckpoint::Observations obs;
+            obs.frame = m_observations.Frame(cost.rows);
+            obs.camera = m_observations.Camera(cost.rows);
+            obs.single = cost.single;
+            obs.P_w.assign(m_observations.P_w(cost.rows),
+                           m_observations.P_w(cost.rows) + cost.rows.size);
+            obs.p_c.assign(m_observations.p_c(cost.rows),
+                           m_observations.p_c(cost.rows) + cost.rows.size);
+            checkpoint.observations.push_back(obs);
+        }
+        checkpoint.mse = m_mse;
+        checkpoint.num_residuals = m_num_residuals;
+        checkpoint.num_outliers = m_num_outliers;
+    }
+
+    /// Replace frames, camera parameters and costs with those of
+    /// 'checkpoint', which must match the cameras. Called with
+    /// m_update_mutex held, while the optimiser isn't running.
+    void RestoreCheckpoint(const CalibratorCheckpoint& checkpoint)
+    {
+        // The problem refers to the costs and frames being replaced
+        m_problem.reset();
+        ClearCosts();
+
+        m_T_kw.clear();
+        for(const Sophus::SE3d& T_kw : checkpoint.T_kw) {
+            m_T_kw.push_back( make_unique<Sophus::SE3d>(T_kw) );
+        }
+
+        for(size_t c=0; c<m_camera.size(); ++c) {
+            m_camera[c]->camera->GetParams() = checkpoint.cameras[c].params;
+            m_camera[c]->T_ck = checkpoint.cameras[c].T_ck;
+            ResetLossScale(c, checkpoint.cameras[c].loss_scale);
+        }
+
+        if(m_observation_selector) {
+            m_observation_selector->Clear();
+        }
+        std::vector<std::vector<FramePoints> > frame_points(
+                    m_T_kw.size(), std::vector<FramePoints>(m_camera.size()));
+
+        for(const CalibratorCheckpoint::Observations& obs : checkpoint.observations) {
+            if(obs.P_w.empty()) {
+                continue;
+            }
+            if(m_observation_selector) {
+                // Only records them, they were selected when first added
+                std::vector<size_t> selected;
+                m_observation_selector->Select(obs.camera, obs.p_c, selected);
+            }
+            FramePoints& points = frame_points[obs.frame][obs.camera];
+            points.insert(points.end(), obs.p_c.begin(), obs.p_c.end());
+
+            if(obs.single && obs.P_w.size() == 1) {
+                m_costs.push_back(NewObservationCost(obs.frame, obs.camera, obs.P_w[0], obs.p_c[0]));
+            }else{
+                m_costs.push_back(NewObservationsCost(obs.frame, obs.camera, obs.P_w, obs.p_c));
+            }
+        }
+
+        if(m_frame_selector) {
+            m_frame_selector->Clear();
+            for(size_t f=0; f<m_T_kw.size(); ++f) {
+                m_frame_selector->Add(*m_T_kw[f], frame_points[f]);
+            }
+        }
+
+        m_mse = checkpoint.mse;
+        m_num_residuals = checkpoint.num_residuals;
+        m_num_outliers = checkpoint.num_outliers;
+        m_termination_type = ceres::NO_CONVERGENCE;
+    }
+
+    /// Write a checkpoint to m_checkpoint_file, if set. Called from the
+    /// optimisation thread between solves.
+    void WriteCheckpoint()
+    {
+        std::string filename;
+        CalibratorCheckpoint checkpoint;
+        {
+            std::unique_lock<std::mutex> lock = LockUpdate();
+            if(m_checkpoint_file.empty()) {
+                return;
+            }
+            filename = m_checkpoint_file;
+            MakeCheckpoint(checkpoint);
+        }
+        if(!checkpoint.Save(filename)) {
+            std::cerr << "Failed to write checkpoint " << filename << std::endl;
+        }
+    }
+
+    /// Drop observations whose reprojection error exceeds
+    /// CalibratorOptions::outlier_threshold from the costs already in
+    /// problem. The inliers of a cost are moved to the front of its rows,
+    /// the rest marked inactive, and the cost replaced by a smaller one over
+    /// them, so later solves evaluate fewer residuals. Called with
+    /// m_update_mutex held, while the problem isn't being solved. Returns
+    /// the number of observations dropped.
+    size_t RejectOutliers(ceres::Problem& problem, size_t& num_costs)
+    {
+        const double threshold2 = m_options.outlier_threshold * m_options.outlier_threshold;
+        size_t num_rejected = 0;
+
+        // Costs are compacted in place, keeping their order
+        size_t num_kept = 0;
+        std::vector<size_t> inliers;
+        for(size_t c=0; c<num_costs; ++c) {
+            ObservationCost cost = m_costs[c];
+            const CameraAndPose& cp = *m_camera[m_observations.Camera(cost.rows)];
+            const Sophus::SE3d T_cw = cp.T_ck * *m_T_kw[m_observations.Frame(cost.rows)];
+            const Eigen::Vector3d* P_w = m_observations.P_w(cost.rows);
+            const Eigen::Vector2d* p_c = m_observations.p_c(cost.rows);
+
+            inliers.clear();
+            for(size_t i=0; i<cost.rows.size; ++i) {
+                const Eigen::Vector2d r = cp.camera->Project(T_cw * P_w[i]) - p_c[i];
+                if(r.allFinite() && r.squaredNorm() <= threshold2) {
+                    inliers.push_back(i);
+                }
+            }
+
+            if(inliers.size() == cost.rows.size) {
+                m_costs[num_kept++] = cost;
+                continue;
+            }
+
+            num_rejected += cost.rows.size - inliers.size();
+            problem.RemoveResidualBlock(cost.residual_block);
+            delete cost.cost;
+
+            const ObservationTable::Range rows = m_observations.Retain(cost.rows, inliers);
+            if(rows.size > 0) {
+                ObservationCost kept = NewRowsCost(rows);
+                kept.residual_block = AddCost(problem, kept);
+                m_costs[num_kept++] = kept;
+            }
+        }
+
+        // Costs not yet in the problem follow
+        m_costs.erase(m_costs.begin() + num_kept, m_costs.begin() + num_costs);
+        num_costs = num_kept;
+        m_num_outliers += num_rejected;
+        return num_rejected;
+    }
+
+    /// Add pose parameter block to problem, parameterized to match the
+    /// costs' Jacobians.
+    void AddPoseBlock(ceres::Problem& problem, double* pose)
+    {
+        if(m_tangent_jacobians) {
+            problem.AddParameterBlock(pose, 7, &m_TangentParamSe3);
+        }else{
+            problem.AddParameterBlock(pose, 7, &m_ParamSe3);
+        }
+    }
+
+    /// Add all cameras, frames and costs to problem.
     void SetupProblem(ceres::Problem& problem)
     {
-        m_update_mutex.lock();
+        size_t num_cameras = 0, num_frames = 0, num_costs = 0;
+        ExtendProblem(problem, num_cameras, num_frames, num_costs);
+    }
+
+    /// Add cameras, frames and costs from the given indices onwards to
+    /// problem, and advance the indices past what has been added. This lets
+    /// a problem persist between solves, growing with the observations.
+    void ExtendProblem(ceres::Problem& problem, size_t& num_cameras,
+                       size_t& num_frames, size_t& num_costs)
+    {
+        std::unique_lock<std::mutex> lock = LockUpdate();
 
-        
         // Add parameters
-        for(size_t c=0; c<m_camera.size(); ++c) {
-            problem.AddParameterBlock(m_camera[c]->T_ck.data(), 7, &m_LocalParamSe3 );
+        for(size_t c=num_cameras; c<m_camera.size(); ++c) {
+            AddPoseBlock(problem, m_camera[c]->T_ck.data());
             if(c==0) {
                 problem.SetParameterBlockConstant(m_camera[c]->T_ck.data());
             }
+            problem.AddParameterBlock(m_camera[c]->camera->GetParams().data(), m_camera[c]->camera->NumParams() );
+        }
+        num_cameras = m_camera.size();
+
+        // Losses rescaled during the last solve are replaced now it is done
+        ApplyPendingLossScales();
+
+        // Intrinsics may be fixed or released at any time
+        for(size_t c=0; c<m_camera.size(); ++c) {
+            double* params = m_camera[c]->camera->GetParams().data();
             if(m_fix_intrinsics) {
-                problem.AddParameterBlock(m_camera[c]->camera->GetParams().data(), m_camera[c]->camera->NumParams() );
-                problem.SetParameterBlockConstant(m_camera[c]->camera->GetParams().data());
+                problem.SetParameterBlockConstant(params);
+            }else{
+                problem.SetParameterBlockVariable(params);
             }
         }
-        
-        for(size_t p=0; p<m_T_kw.size(); ++p) {
-            problem.AddParameterBlock(m_T_kw[p]->data(), 7, &m_LocalParamSe3 );
+
+        for(size_t p=num_frames; p<m_T_kw.size(); ++p) {
+            AddPoseBlock(problem, m_T_kw[p]->data());
         }
+        num_frames = m_T_kw.size();
 
         // Add costs
-        for(size_t c=0; c<m_costs.size(); ++c) {
-            CostFunctionAndParams& cost = *m_costs[c];
-            problem.AddResidualBlock(cost.Cost(), cost.Loss(), cost.Params());
+        for(size_t c=num_costs; c<m_costs.size(); ++c) {
+            ObservationCost& cost = m_costs[c];
+            ceres::ResidualBlockId id = AddCost(problem, cost);
+            if(&problem == m_problem.get()) {
+                cost.residual_block = id;
+            }
         }
-        
-        m_update_mutex.unlock();        
+        num_costs = m_costs.size();
     }
-    
+
+    /// Return ceres options for the next solve of m_problem.
+    ceres::Solver::Options SolverOptions()
+    {
+        std::lock_guard<std::mutex> lock(m_update_mutex);
+
+        ceres::Solver::Options options;
+        options.num_threads = m_options.num_threads;
+        options.linear_solver_type = m_options.linear_solver_type;
+        options.preconditioner_type = m_options.preconditioner_type;
+        options.max_num_iterations = m_options.max_num_iterations;
+        options.max_solver_time_in_seconds = m_options.max_solver_time_in_seconds;
+        options.update_state_every_iteration = true;
+
+        if(m_options.eliminate_frames_first &&
+           ceres::IsSchurType(m_options.linear_solver_type)) {
+            // Frames only share parameters through the cameras, so they
+            // form an independent set. The solver may modify the ordering,
+            // so a new one is made for each solve.
+            ceres::ParameterBlockOrdering* ordering = new ceres::ParameterBlockOrdering;
+            for(size_t p=0; p<m_problem_frames; ++p) {
+                ordering->AddElementToGroup(m_T_kw[p]->data(), 0);
+            }
+            for(size_t c=0; c<m_problem_cameras; ++c) {
+                ordering->AddElementToGroup(m_camera[c]->T_ck.data(), 1);
+                ordering->AddElementToGroup(m_camera[c]->camera->GetParams().data(), 1);
+            }
+            options.linear_solver_ordering.reset(ordering);
+        }
+        return options;
+    }
+
+    /// Lock m_update_mutex, adding the time spent waiting for it to
+    /// m_lock_wait_ns.
+    std::unique_lock<std::mutex> LockUpdate()
+    {
+        std::unique_lock<std::mutex> lock(m_update_mutex, std::try_to_lock);
+        if(!lock.owns_lock()) {
+            const std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+            lock.lock();
+            m_lock_wait_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(
+                        std::chrono::steady_clock::now() - t0).count();
+        }
+        return lock;
+    }
+
+    /// Record a copy of the current state for Snapshot(). Called with
+    /// m_update_mutex held, from the solver thread or while it isn't running,
+    /// so that parameters aren't being modified.
+    void PublishSnapshot()
+    {
+        std::shared_ptr<CalibratorSnapshot> snapshot = std::make_shared<CalibratorSnapshot>();
+        for(const std::unique_ptr<Sophus::SE3d>& T_kw : m_T_kw) {
+            snapshot->T_kw.push_back(*T_kw);
+        }
+        for(const std::unique_ptr<CameraAndPose>& cp : m_camera) {
+            snapshot->T_ck.push_back(cp->T_ck);
+            snapshot->params.push_back(cp->camera->GetParams());
+            snapshot->K.push_back(cp->camera->K());
+            snapshot->cameras.push_back(cp->camera->Snapshot());
+        }
+        snapshot->mse = m_mse;
+        snapshot->num_residuals = m_num_residuals;
+        snapshot->num_outliers = m_num_outliers;
+        snapshot->termination_type = m_termination_type;
+        std::atomic_store(&m_snapshot, std::shared_ptr<const CalibratorSnapshot>(snapshot));
+    }
+
+    /// Publishes a snapshot after each iteration. Ceres has updated the
+    /// parameters by then, as update_state_every_iteration is set. Also
+    /// reports the iteration to the metrics callback, if there is one.
+    class SnapshotCallback : public ceres::IterationCallback
+    {
+    public:
+        SnapshotCallback(Calibrator& calibrator, int num_residuals, int solve,
+                         const std::shared_ptr<CalibratorMetricsCallback>& metrics)
+            : m_calibrator(calibrator), m_num_residuals(num_residuals),
+              m_solve(solve), m_metrics(metrics)
+        {
+        }
+
+        ceres::CallbackReturnType operator()(const ceres::IterationSummary& summary)
+        {
+            {
+                std::unique_lock<std::mutex> lock = m_calibrator.LockUpdate();
+                m_calibrator.m_mse = summary.cost / m_num_residuals;
+                m_calibrator.m_num_residuals = m_num_residuals;
+                m_calibrator.PublishSnapshot();
+            }
+
+            if(m_metrics) {
+                CalibratorIterationMetrics metrics;
+                metrics.solve = m_solve;
+                metrics.iteration = summary.iteration;
+                metrics.cost = summary.cost;
+                metrics.cost_change = summary.cost_change;
+                metrics.step_is_successful = summary.step_is_successful;
+                metrics.iteration_time_in_seconds = summary.iteration_time_in_seconds;
+                metrics.linear_solver_time_in_seconds = summary.step_solver_time_in_seconds;
+                metrics.cumulative_time_in_seconds = summary.cumulative_time_in_seconds;
+                metrics.num_residuals = m_num_residuals;
+                m_metrics->OnIteration(metrics);
+            }
+            return ceres::SOLVER_CONTINUE;
+        }
+
+    protected:
+        Calibrator& m_calibrator;
+        int m_num_residuals;
+        int m_solve;
+        std::shared_ptr<CalibratorMetricsCallback> m_metrics;
+    };
+
     void SolveThread()
     {
         m_running = true;
+
+        // The problem is kept between runs, and only new frames and
+        // observations are added to it before each solve. Parameters are
+        // optimised in place, so each solve starts from the last solution.
+        if(!m_problem) {
+            m_problem.reset(new ceres::Problem(m_prob_options));
+            m_problem_cameras = m_problem_frames = m_problem_costs = 0;
+        }
+        ceres::Problem& problem = *m_problem;
+
+        // Throughput is measured from one solve to the next
+        int solve = 0;
+        size_t last_frames = m_problem_frames;
+        std::chrono::steady_clock::time_point last_time = std::chrono::steady_clock::now();
+        std::chrono::steady_clock::time_point last_checkpoint = last_time;
+        m_lock_wait_ns = 0;
+
         while( m_should_run ){
-            ceres::Problem problem(m_prob_options);
-            SetupProblem(problem);            
-            
+            ExtendProblem(problem, m_problem_cameras, m_problem_frames, m_problem_costs);
+
             // Crank optimisation
             if(problem.NumResiduals() > 0) {
                 try {
+                    std::shared_ptr<CalibratorMetricsCallback> metrics_callback;
+                    {
+                        std::lock_guard<std::mutex> lock(m_update_mutex);
+                        metrics_callback = m_metrics_callback;
+                    }
+
+                    SnapshotCallback callback(*this, problem.NumResiduals(),
+                                              solve, metrics_callback);
+                    ceres::Solver::Options options = SolverOptions();
+                    options.callbacks.push_back(&callback);
+
                     ceres::Solver::Summary summary;
-                    ceres::Solve(m_solver_options, &problem, &summary);
+                    ceres::Solve(options, &problem, &summary);
                     std::cout << summary.BriefReport() << std::endl;
-                    m_termination_type = summary.termination_type;
-                    m_mse = summary.final_cost / summary.num_residuals;
-                    std::cout << "Frames: " << m_T_kw.size() << "; Observations: " << summary.num_residuals << "; mse: " << m_mse << std::endl;
+
+                    {
+                        std::unique_lock<std::mutex> lock = LockUpdate();
+                        m_termination_type = summary.termination_type;
+                        m_mse = summary.final_cost / summary.num_residuals;
+                        m_num_residuals = summary.num_residuals;
+                        std::cout << "Frames: " << m_problem_frames << "; Observations: " << summary.num_residuals << "; mse: " << m_mse << std::endl;
+
+                        // Once converged, drop outliers and solve again
+                        // without them before reporting convergence
+                        if(m_options.outlier_threshold > 0 &&
+                           summary.termination_type == ceres::CONVERGENCE) {
+                            const size_t num_rejected = RejectOutliers(problem, m_problem_costs);
+                            if(num_rejected > 0) {
+                                m_termination_type = ceres::NO_CONVERGENCE;
+                                std::cout << "Rejected " << num_rejected << " outliers; " << m_num_outliers << " in total" << std::endl;
+                            }
+                        }
+                        PublishSnapshot();
+                    }
+                    m_solve_done.notify_all();
+
+                    const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+                    const double elapsed = std::chrono::duration<double>(now - last_time).count();
+                    const uint64_t lock_wait_ns = m_lock_wait_ns.exchange(0);
+
+                    if(metrics_callback) {
+                        CalibratorSolveMetrics metrics;
+                        metrics.solve = solve;
+                        metrics.num_iterations = summary.iterations.size();
+                        metrics.termination_type = summary.termination_type;
+                        metrics.initial_cost = summary.initial_cost;
+                        metrics.final_cost = summary.final_cost;
+                        metrics.total_time_in_seconds = summary.total_time_in_seconds;
+                        metrics.residual_evaluation_time_in_seconds = summary.residual_evaluation_time_in_seconds;
+                        metrics.jacobian_evaluation_time_in_seconds = summary.jacobian_evaluation_time_in_seconds;
+                        metrics.linear_solver_time_in_seconds = summary.linear_solver_time_in_seconds;
+                        metrics.num_frames = m_problem_frames;
+                        metrics.num_residuals = summary.num_residuals;
+                        metrics.frames_per_second = elapsed > 0 ? (m_problem_frames - last_frames) / elapsed : 0;
+                        metrics.lock_wait_in_seconds = 1e-9 * lock_wait_ns;
+                        metrics_callback->OnSolve(metrics);
+                    }
+                    last_frames = m_problem_frames;
+                    last_time = now;
+                    ++solve;
+
+                    double checkpoint_interval;
+                    {
+                        std::lock_guard<std::mutex> lock(m_update_mutex);
+                        checkpoint_interval = m_checkpoint_interval;
+                    }
+                    if(std::chrono::duration<double>(now - last_checkpoint).count() >= checkpoint_interval) {
+                        WriteCheckpoint();
+                        last_checkpoint = now;
+                    }
                 }catch(std::exception e) {
                     std::cerr << e.what() << std::endl;
                 }
             }
         }
-        m_running = false;
+
+        // Keep the final state of this run
+        WriteCheckpoint();
+
+        {
+            std::lock_guard<std::mutex> lock(m_update_mutex);
+            ApplyPendingLossScales();
+            m_running = false;
+        }
+        m_solve_done.notify_all();
     }
  
     std::mutex m_update_mutex;
+    std::condition_variable m_solve_done;
     std::thread m_thread;
-    bool m_should_run;
-    bool m_running;
+    std::atomic<bool> m_should_run;
+    std::atomic<bool> m_running;
     bool m_fix_intrinsics;
+    CalibratorOptions m_options;
+    bool m_tangent_jacobians;
+    std::shared_ptr<FrameSelector> m_frame_selector;
+    std::shared_ptr<ObservationSelector> m_observation_selector;
+    size_t m_max_frames;
     ceres::TerminationType m_termination_type;
+    std::shared_ptr<CalibratorMetricsCallback> m_metrics_callback;
+
+    // Written by the optimisation thread, see SetCheckpointFile
+    std::string m_checkpoint_file;
+    double m_checkpoint_interval;
+
+    // Time spent waiting in LockUpdate, since the last solve metrics
+    std::atomic<uint64_t> m_lock_wait_ns;
     
     std::vector< std::unique_ptr<Sophus::SE3d> > m_T_kw;
     std::vector< std::unique_ptr<CameraAndPose> > m_camera;
-    std::vector< std::unique_ptr<CostFunctionAndParams > > m_costs;
+    std::vector< std::shared_ptr<ReprojectionCostFactory> > m_cost_factories;
+
+    // Observations, and the costs over them in the order they were added
+    ObservationTable m_observations;
+    std::vector<ObservationCost> m_costs;
+
+    // Problem persisting between solves, and how much of the above it holds
+    std::unique_ptr<ceres::Problem> m_problem;
+    size_t m_problem_cameras;
+    size_t m_problem_frames;
+    size_t m_problem_costs;
  
+    // Loss of each camera's observations
+    double m_default_loss_scale;
+    std::vector<double> m_loss_scale;
+    std::vector<bool> m_loss_scale_pending;
+    std::vector< std::unique_ptr<ceres::LossFunctionWrapper> > m_loss_functions;
     ceres::Problem::Options m_prob_options;
-    ceres::Solver::Options  m_solver_options;
-    ceres::LossFunctionWrapper m_LossFunction;
-    LocalParameterizationSe3  m_LocalParamSe3; 
+    ParameterizationSe3 m_ParamSe3;
+    TangentParameterizationSe3 m_TangentParamSe3;
 
     double m_mse;
+    int m_num_residuals;
+    size_t m_num_outliers;
+
+    // Published with std::atomic_store, read with std::atomic_load
+    std::shared_ptr<const CalibratorSnapshot> m_snapshot;
 };
 
 }
@@ -0,0 +1,283 @@
+/*
+   This file is part of the Calibu Project.
+   https://github.com/arpg/Calibu
+
+   Copyright (C) 2013 George Washington University,
+                      Steven Lovegrove,
+                      Gabe Sibley
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+   http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <Eigen/Eigen>
+#include <Eigen/StdVector>
+#include <sophus/se3.hpp>
+
+namespace calibu
+{
+
+static const uint32_t kCalibratorCheckpointVersion = 1;
+
+/// State of a Calibrator, so that an optimisation that was stopped or died
+/// can continue from where it was, see Calibrator::SaveCheckpoint. Cameras
+/// themselves aren't stored, only their parameters, so the same cameras
+/// must be added before the checkpoint is restored. The file stores values
+/// in the byte order of the machine that wrote it.
+struct CalibratorCheckpoint
+{
+    struct Camera
+    {
+        EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+        Camera() : loss_scale(0) {}
+
+        /// Camera model type, as CameraInterface::Type, to check against.
+        std::string type;
+        Eigen::VectorXd params;
+        Sophus::SE3d T_ck;
+        double loss_scale;
+    };
+
+    /// Observations of one camera in one frame, added as a single residual
+    /// block unless 'single' (see Calibrator::AddObservation).
+    struct Observations
+    {
+        Observations() : frame(0), camera(0), single(false) {}
+
+        uint32_t frame;
+        uint32_t camera;
+        bool single;
+        std::vector<Eigen::Vector3d,
+                    Eigen::aligned_allocator<Eigen::Vector3d> > P_w;
+        std::vector<Eigen::Vector2d,
+                    Eigen::aligned_allocator<Eigen::Vector2d> > p_c;
+    };
+
+    CalibratorCheckpoint() : mse(0), num_residuals(0), num_outliers(0) {}
+
+    /// Write the checkpoint to 'filename', next to its destination and then
+    /// renamed into place, so that a partial file is never read.
+    bool Save(const std::string& filename) const
+    {
+        const std::string tmp_filename = filename + ".tmp";
+        {
+            std::ofstream file(tmp_filename, std::ios::binary | std::ios::trunc);
+            if(!file) {
+                return false;
+            }
+
+            file.write(Magic(), 8);
+            Write(file, kCalibratorCheckpointVersion);
+            Write(file, (uint32_t)cameras.size());
+            Write(file, (uint64_t)T_kw.size());
+            Write(file, (uint64_t)observations.size());
+            Write(file, mse);
+            Write(file, (int32_t)num_residuals);
+            Write(file, num_outliers);
+
+            for(const Camera& cam : cameras) {
+                Write(file, (uint32_t)cam.type.size());
+                file.write(cam.type.data(), cam.type.size());
+                Write(file, (uint32_t)cam.params.size());
+                file.write(reinterpret_cast<const char*>(cam.params.data()),
+                           sizeof(double) * cam.params.size());
+                WritePose(file, cam.T_ck);
+                Write(file, cam.loss_scale);
+            }
+
+            for(const Sophus::SE3d& T : T_kw) {
+                WritePose(file, T);
+            }
+
+            for(const Observations& obs : observations) {
+                if(obs.P_w.size() != obs.p_c.size()) {
+                    file.close();
+                    std::remove(tmp_filename.c_str());
+                    return false;
+                }
+                Write(file, obs.frame);
+                Write(file, obs.camera);
+                Write(file, (uint8_t)obs.single);
+                Write(file, (uint32_t)obs.P_w.size());
+                for(size_t i = 0; i < obs.P_w.size(); ++i) {
+                    file.write(reinterpret_cast<const char*>(obs.P_w[i].data()), 3 * sizeof(double));
+                    file.write(reinterpret_cast<const char*>(obs.p_c[i].data()), 2 * sizeof(double));
+                }
+            }
+
+            if(!file) {
+                file.close();
+                std::remove(tmp_filename.c_str());
+                return false;
+            }
+        }
+
+        if(std::rename(tmp_filename.c_str(), filename.c_str()) != 0) {
+            std::remove(tmp_filename.c_str());
+            return false;
+        }
+        return true;
+    }
+
+    /// Read 'filename'. Returns false if it is missing or corrupt, leaving
+    /// the checkpoint empty.
+    bool Load(const std::string& filename)
+    {
+        *this = CalibratorCheckpoint();
+        if(!ReadFile(filename)) {
+            *this = CalibratorCheckpoint();
+            return false;
+        }
+        return true;
+    }
+
+    std::vector<Camera, Eigen::aligned_allocator<Camera> > cameras;
+    std::vector<Sophus::SE3d, Eigen::aligned_allocator<Sophus::SE3d> > T_kw;
+    std::vector<Observations> observations;
+
+    /// Solver state, as in CalibratorSnapshot.
+    double mse;
+    int num_residuals;
+    uint64_t num_outliers;
+
+protected:
+    static const char* Magic()
+    {
+        return "CALIBUCK";
+    }
+
+    template<typename T>
+    static void Write(std::ostream& os, const T& value)
+    {
+        os.write(reinterpret_cast<const char*>(&value), sizeof(T));
+    }
+
+    template<typename T>
+    static bool Read(std::istream& is, T& value)
+    {
+        return (bool)is.read(reinterpret_cast<char*>(&value), sizeof(T));
+    }
+
+    static bool ReadDoubles(std::istream& is, double* values, size_t n)
+    {
+        return (bool)is.read(reinterpret_cast<char*>(values), sizeof(double) * n);
+    }
+
+    // Poses are stored as quaternion x, y, z, w then translation
+    static void WritePose(std::ostream& os, const Sophus::SE3d& T)
+    {
+        const Eigen::Quaterniond& q = T.unit_quaternion();
+        const double pose[7] = {
+            q.x(), q.y(), q.z(), q.w(),
+            T.translation()[0], T.translation()[1], T.translation()[2]
+        };
+        os.write(reinterpret_cast<const char*>(pose), sizeof(pose));
+    }
+
+    static bool ReadPose(std::istream& is, Sophus::SE3d& T)
+    {
+        double pose[7];
+        if(!ReadDoubles(is, pose, 7)) {
+            return false;
+        }
+        Eigen::Quaterniond q(pose[3], pose[0], pose[1], pose[2]);
+        if(!(std::abs(q.squaredNorm() - 1.0) < 1e-6)) {
+            return false;
+        }
+        q.normalize();
+        T = Sophus::SE3d(q, Eigen::Vector3d(pose[4], pose[5], pose[6]));
+        return true;
+    }
+
+    bool ReadFile(const std::string& filename)
+    {
+        std::ifstream file(filename, std::ios::binary);
+        char magic[8];
+        uint32_t version, num_cameras;
+        uint64_t num_frames, num_observations;
+        int32_t residuals;
+        if(!file.read(magic, sizeof(magic)) || memcmp(magic, Magic(), sizeof(magic)) ||
+           !Read(file, version) || version != kCalibratorCheckpointVersion ||
+           !Read(file, num_cameras) || !Read(file, num_frames) ||
+           !Read(file, num_observations) || !Read(file, mse) ||
+           !Read(file, residuals) || !Read(file, num_outliers)) {
+            return false;
+        }
+        num_residuals = residuals;
+
+        // Grow element by element, so a corrupt count fails on reading
+        // rather than allocating.
+        for(uint32_t c = 0; c < num_cameras; ++c) {
+            Camera cam;
+            uint32_t type_size, num_params;
+            if(!Read(file, type_size) || type_size > 256) {
+                return false;
+            }
+            cam.type.resize(type_size);
+            if(!file.read(&cam.type[0], type_size) ||
+               !Read(file, num_params) || num_params > 4096) {
+                return false;
+            }
+            cam.params.resize(num_params);
+            if(!ReadDoubles(file, cam.params.data(), num_params) ||
+               !ReadPose(file, cam.T_ck) || !Read(file, cam.loss_scale)) {
+                return false;
+            }
+            cameras.push_back(cam);
+        }
+
+        for(uint64_t f = 0; f < num_frames; ++f) {
+            Sophus::SE3d T;
+            if(!ReadPose(file, T)) {
+                return false;
+            }
+            T_kw.push_back(T);
+        }
+
+        for(uint64_t o = 0; o < num_observations; ++o) {
+            observations.push_back(Observations());
+            Observations& obs = observations.back();
+            uint8_t single;
+            uint32_t n;
+            if(!Read(file, obs.frame) || !Read(file, obs.camera) ||
+               !Read(file, single) || !Read(file, n) ||
+               obs.frame >= num_frames || obs.camera >= num_cameras) {
+                return false;
+            }
+            obs.single = single != 0;
+            for(uint32_t i = 0; i < n; ++i) {
+                double p[5];
+                if(!ReadDoubles(file, p, 5)) {
+                    return false;
+                }
+                obs.P_w.push_back(Eigen::Vector3d(p[0], p[1], p[2]));
+                obs.p_c.push_back(Eigen::Vector2d(p[3], p[4]));
+            }
+        }
+
+        // Nothing may follow the last observation
+        return file.peek() == std::char_traits<char>::eof();
+    }
+};
+
+}
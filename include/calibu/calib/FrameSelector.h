@@ -0,0 +1,228 @@
+/*
+   This file is part of the Calibu Project.
+   https://github.com/arpg/Calibu
+
+   Copyright (C) 2013 George Washington University,
+                      Steven Lovegrove,
+                      Gabe Sibley
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+   http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <vector>
+
+#include <Eigen/Eigen>
+#include <Eigen/StdVector>
+#include <sophus/se3.hpp>
+
+namespace calibu
+{
+
+/// Image observations made by one camera in one frame.
+typedef std::vector<Eigen::Vector2d, Eigen::aligned_allocator<Eigen::Vector2d> > FramePoints;
+
+/// Decides whether a candidate frame is worth adding to a calibration, given
+/// the frames accepted so far. Frames are described by their initial pose
+/// T_kw and the points p_c[c] observed by each camera c of the rig (empty if
+/// camera c did not see the target).
+class FrameSelector
+{
+public:
+    virtual ~FrameSelector() {}
+
+    /// Return true if the frame is not redundant with those already added.
+    virtual bool IsInformative(const Sophus::SE3d& T_kw,
+                               const std::vector<FramePoints>& p_c) const = 0;
+
+    /// Record frame as accepted.
+    virtual void Add(const Sophus::SE3d& T_kw,
+                     const std::vector<FramePoints>& p_c) = 0;
+
+    /// Forget all accepted frames.
+    virtual void Clear() = 0;
+};
+
+/// Accepts frames whose pose differs from every accepted frame by at least
+/// min_rotation radians or min_translation (in target units).
+class MotionFrameSelector : public FrameSelector
+{
+public:
+    MotionFrameSelector(double min_rotation, double min_translation)
+        : m_min_rotation(min_rotation), m_min_translation(min_translation)
+    {
+    }
+
+    bool IsInformative(const Sophus::SE3d& T_kw,
+                       const std::vector<FramePoints>& /*p_c*/) const
+    {
+        const Sophus::SE3d T_wk = T_kw.inverse();
+        for(const Sophus::SE3d& T_wa : m_T_wk) {
+            const double rotation = (T_wa.so3().inverse() * T_wk.so3()).log().norm();
+            const double translation = (T_wa.translation() - T_wk.translation()).norm();
+            if(rotation < m_min_rotation && translation < m_min_translation) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void Add(const Sophus::SE3d& T_kw, const std::vector<FramePoints>& /*p_c*/)
+    {
+        m_T_wk.push_back(T_kw.inverse());
+    }
+
+    void Clear()
+    {
+        m_T_wk.clear();
+    }
+
+protected:
+    double m_min_rotation;
+    double m_min_translation;
+    std::vector<Sophus::SE3d, Eigen::aligned_allocator<Sophus::SE3d> > m_T_wk;
+};
+
+/// Divides each camera image into a grid of cells and accepts frames with
+/// observations in at least min_new_cells cells no accepted frame has
+/// covered yet, so that the whole field of view gets constrained. Once fewer
+/// than min_new_cells cells remain uncovered no frame can qualify, so set
+/// accept_when_covered to accept every frame from then on when this
+/// selector is used on its own.
+class CoverageFrameSelector : public FrameSelector
+{
+public:
+    /// image_size[c] is the size of camera c's images, in pixels.
+    CoverageFrameSelector(const std::vector<Eigen::Vector2i>& image_size,
+                          int cells_x = 8, int cells_y = 6,
+                          int min_new_cells = 1,
+                          bool accept_when_covered = false)
+        : m_image_size(image_size), m_cells_x(cells_x), m_cells_y(cells_y),
+          m_min_new_cells(min_new_cells),
+          m_accept_when_covered(accept_when_covered)
+    {
+        Clear();
+    }
+
+    bool IsInformative(const Sophus::SE3d& /*T_kw*/,
+                       const std::vector<FramePoints>& p_c) const
+    {
+        if(m_accept_when_covered && IsCovered()) {
+            return true;
+        }
+
+        int new_cells = 0;
+        for(size_t c = 0; c < p_c.size() && c < m_covered.size(); ++c) {
+            std::vector<bool> covered = m_covered[c];
+            for(const Eigen::Vector2d& p : p_c[c]) {
+                const int cell = Cell(c, p);
+                if(cell >= 0 && !covered[cell]) {
+                    covered[cell] = true;
+                    ++new_cells;
+                }
+            }
+        }
+        return new_cells >= m_min_new_cells;
+    }
+
+    void Add(const Sophus::SE3d& /*T_kw*/, const std::vector<FramePoints>& p_c)
+    {
+        for(size_t c = 0; c < p_c.size() && c < m_covered.size(); ++c) {
+            for(const Eigen::Vector2d& p : p_c[c]) {
+                const int cell = Cell(c, p);
+                if(cell >= 0) {
+                    m_covered[c][cell] = true;
+                }
+            }
+        }
+    }
+
+    void Clear()
+    {
+        m_covered.assign(m_image_size.size(),
+                         std::vector<bool>(m_cells_x * m_cells_y, false));
+    }
+
+    /// Return true if too few cells remain uncovered for any frame to add
+    /// min_new_cells.
+    bool IsCovered() const
+    {
+        int uncovered = 0;
+        for(const std::vector<bool>& covered : m_covered) {
+            uncovered += (int)std::count(covered.begin(), covered.end(), false);
+        }
+        return uncovered < m_min_new_cells;
+    }
+
+protected:
+    /// Return grid cell of point p in camera c, or -1 if outside the image.
+    int Cell(size_t c, const Eigen::Vector2d& p) const
+    {
+        const int x = (int)std::floor(p[0] * m_cells_x / m_image_size[c][0]);
+        const int y = (int)std::floor(p[1] * m_cells_y / m_image_size[c][1]);
+        if(x < 0 || x >= m_cells_x || y < 0 || y >= m_cells_y) {
+            return -1;
+        }
+        return y * m_cells_x + x;
+    }
+
+    std::vector<Eigen::Vector2i> m_image_size;
+    int m_cells_x;
+    int m_cells_y;
+    int m_min_new_cells;
+    bool m_accept_when_covered;
+    std::vector<std::vector<bool> > m_covered;
+};
+
+/// Accepts frames that any of its selectors judges informative, and records
+/// accepted frames with all of them.
+class AnyFrameSelector : public FrameSelector
+{
+public:
+    AnyFrameSelector(const std::vector<std::shared_ptr<FrameSelector> >& selectors)
+        : m_selectors(selectors)
+    {
+    }
+
+    bool IsInformative(const Sophus::SE3d& T_kw,
+                       const std::vector<FramePoints>& p_c) const
+    {
+        return std::any_of(m_selectors.begin(), m_selectors.end(),
+                           [&](const std::shared_ptr<FrameSelector>& s) {
+            return s->IsInformative(T_kw, p_c);
+        });
+    }
+
+    void Add(const Sophus::SE3d& T_kw, const std::vector<FramePoints>& p_c)
+    {
+        for(const std::shared_ptr<FrameSelector>& s : m_selectors) {
+            s->Add(T_kw, p_c);
+        }
+    }
+
+    void Clear()
+    {
+        for(const std::shared_ptr<FrameSelector>& s : m_selectors) {
+            s->Clear();
+        }
+    }
+
+protected:
+    std::vector<std::shared_ptr<FrameSelector> > m_selectors;
+};
+
+}
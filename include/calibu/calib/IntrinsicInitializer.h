@@ -0,0 +1,365 @@
+/*
+   This file is part of the Calibu Project.
+   https://github.com/arpg/Calibu
+
+   Copyright (C) 2013 George Washington University,
+                      Steven Lovegrove,
+                      Gabe Sibley
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+   http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include <Eigen/Eigen>
+#include <Eigen/StdVector>
+
+#include <calibu/cam/camera_crtp.h>
+#include <calibu/cam/camera_models_crtp.h>
+#include <calibu/utils/Parallel.h>
+#include <calibu/utils/Utils.h>
+
+namespace calibu
+{
+
+struct IntrinsicInitializerOptions
+{
+    IntrinsicInitializerOptions()
+        : num_threads(1), min_points(8), num_iterations(2)
+    {
+    }
+
+    /// Threads across which frames are split, 0 for one per core.
+    unsigned int num_threads;
+
+    /// Frames with fewer observations than this are ignored.
+    size_t min_points;
+
+    /// Times K and distortion are estimated. Each time after the first,
+    /// homographies are fit to observations undistorted by the previous
+    /// estimate, which removes most of the bias distortion puts on K.
+    int num_iterations;
+};
+
+/// Pinhole K of a camera with zero skew, in closed form from homographies
+/// H_ba mapping a planar target (b = H_ba a) into w x h images (Zhang,
+/// "A flexible new technique for camera calibration", 2000). With fewer
+/// than three views, or views that don't constrain it, the principal point
+/// is assumed to be at the image centre. Returns false if no K fits.
+inline bool EstimateKFromHomographies(
+        const std::vector<Eigen::Matrix3d>& H_ba, int w, int h,
+        Eigen::Matrix3d& K)
+{
+    // Work in image coordinates centred and scaled to about [-1, 1], so
+    // that the terms of the constraints are of similar magnitude.
+    const double s = 2.0 / (w + h);
+    Eigen::Matrix3d N;
+    N << s, 0, -s * w / 2.0,
+         0, s, -s * h / 2.0,
+         0, 0, 1;
+
+    // Each homography gives h1' B h2 = 0 and h1' B h1 = h2' B h2, linear in
+    // the entries b = (B11, B22, B13, B23, B33) of B = K^-T K^-1.
+    Eigen::Matrix<double, 5, 5> AtA_l = Eigen::Matrix<double, 5, 5>::Zero();
+    for(const Eigen::Matrix3d& H : H_ba) {
+        // Unit scale, so that each view is weighted alike. The rows aren't
+        // normalised themselves, as a row can vanish, e.g. h1' B h2 for a
+        // fronto-parallel view, and would then be all noise.
+        Eigen::Matrix3d Hn = N * H;
+        Hn /= Hn.norm();
+        const auto v = [&Hn](int i, int j) {
+            Eigen::Matrix<double, 5, 1> vij;
+            vij << Hn(0,i) * Hn(0,j),
+                   Hn(1,i) * Hn(1,j),
+                   Hn(2,i) * Hn(0,j) + Hn(0,i) * Hn(2,j),
+                   Hn(2,i) * Hn(1,j) + Hn(1,i) * Hn(2,j),
+                   Hn(2,i) * Hn(2,j);
+            return vij;
+        };
+        const Eigen::Matrix<double, 5, 1> rows[2] = { v(0, 1), v(0, 0) - v(1, 1) };
+        for(const Eigen::Matrix<double, 5, 1>& row : rows) {
+            AtA_l.selfadjointView<Eigen::Lower>().rankUpdate(row);
+        }
+    }
+    const Eigen::Matrix<double, 5, 5> AtA = AtA_l.selfadjointView<Eigen::Lower>();
+
+    double fx, fy, cx, cy;
+    bool found = false;
+
+    if(H_ba.size() >= 3) {
+        const Eigen::SelfAdjointEigenSolver<Eigen::Matrix<double, 5, 5> > eig(AtA);
+        const Eigen::Matrix<double, 5, 1> b = eig.eigenvectors().col(0);
+        const double lambda = b[4] - b[2] * b[2] / b[0] - b[3] * b[3] / b[1];
+        if(lambda / b[0] > 0 && lambda / b[1] > 0) {
+            fx = std::sqrt(lambda / b[0]);
+            fy = std::sqrt(lambda / b[1]);
+            cx = -b[2] / b[0];
+            cy = -b[3] / b[1];
+            found = true;
+        }
+    }
+
+    if(!found && !H_ba.empty()) {
+        // Principal point at the centre, B13 = B23 = 0
+        Eigen::Matrix3d AtA_c;
+        AtA_c << AtA(0,0), AtA(0,1), AtA(0,4),
+                 AtA(1,0), AtA(1,1), AtA(1,4),
+                 AtA(4,0), AtA(4,1), AtA(4,4);
+        const Eigen::SelfAdjointEigenSolver<Eigen::Matrix3d> eig(AtA_c);
+        const Eigen::Vector3d b = eig.eigenvectors().col(0);
+        if(b[2] / b[0] > 0 && b[2] / b[1] > 0) {
+            fx = std::sqrt(b[2] / b[0]);
+            fy = std::sqrt(b[2] / b[1]);
+            cx = 0;
+            cy = 0;
+            found = true;
+        }
+    }
+
+    if(!found || !std::isfinite(fx) || !std::isfinite(fy)) {
+        return false;
+    }
+
+    // Back to pixels, K = N^-1 K_n
+    K << fx / s, 0, cx / s + w / 2.0,
+         0, fy / s, cy / s + h / 2.0,
+         0, 0, 1;
+    return true;
+}
+
+/// Pose T_ab of plane a, as R = [r1 r2 r1 x r2] and t, seen through
+/// pinhole K with homography H_ba. The target is placed in front of the
+/// camera.
+inline void PoseFromHomography(const Eigen::Matrix3d& K,
+                               const Eigen::Matrix3d& H_ba,
+                               Eigen::Matrix3d& R, Eigen::Vector3d& t)
+{
+    const Eigen::Matrix3d M = K.inverse() * H_ba;
+    double lambda = 2.0 / (M.col(0).norm() + M.col(1).norm());
+    if(M(2,2) * lambda < 0) {
+        lambda = -lambda;
+    }
+
+    Eigen::Matrix3d R0;
+    R0.col(0) = lambda * M.col(0);
+    R0.col(1) = lambda * M.col(1);
+    R0.col(2) = R0.col(0).cross(R0.col(1));
+    t = lambda * M.col(2);
+
+    // Closest rotation
+    const Eigen::JacobiSVD<Eigen::Matrix3d> svd(
+                R0, Eigen::ComputeFullU | Eigen::ComputeFullV);
+    R = svd.matrixU() * svd.matrixV().transpose();
+}
+
+/// Set the intrinsics of 'camera' from observations p_c[f] of planar
+/// target points P_w[f] (with z = 0) in each frame f. K comes from the
+/// homographies of the frames in closed form (EstimateKFromHomographies),
+/// then, with the target pose of each frame from its homography,
+/// distortion is fit linearly for Poly2Camera, Poly3Camera,
+/// Rational6Camera and KannalaBrandtCamera, and by a search over w for
+/// FovCamera. Frames are split across options.num_threads.
+///
+/// Distortion is fit to poses that ignore it, so the result is a starting
+/// point for Calibrator rather than a calibration. Returns false, leaving
+/// 'camera' as it was, if there are too few frames to estimate K.
+inline bool InitializeIntrinsics(
+        CameraInterface<double>& camera,
+        const std::vector<std::vector<Eigen::Vector3d,
+                          Eigen::aligned_allocator<Eigen::Vector3d> > >& P_w,
+        const std::vector<std::vector<Eigen::Vector2d,
+                          Eigen::aligned_allocator<Eigen::Vector2d> > >& p_c,
+        const IntrinsicInitializerOptions& options = IntrinsicInitializerOptions())
+{
+    typedef std::vector<Eigen::Vector2d,
+                        Eigen::aligned_allocator<Eigen::Vector2d> > Points;
+
+    // Target plane coordinates of usable frames
+    std::vector<Points> a;
+    std::vector<const Points*> b;
+    for(size_t f = 0; f < P_w.size() && f < p_c.size(); ++f) {
+        if(P_w[f].size() == p_c[f].size() && p_c[f].size() >= std::max<size_t>(4, options.min_points)) {
+            a.push_back(Points());
+            for(const Eigen::Vector3d& P : P_w[f]) {
+                a.back().push_back(P.head<2>());
+            }
+            b.push_back(&p_c[f]);
+        }
+    }
+    const int num_frames = (int)a.size();
+    if(num_frames == 0) {
+        return false;
+    }
+
+    const int w = camera.Width();
+    const int h = camera.Height();
+    Eigen::VectorXd params = camera.GetParams();
+
+    const bool fov = dynamic_cast<FovCamera<double>*>(&camera) != nullptr;
+    const bool kb4 = dynamic_cast<KannalaBrandtCamera<double>*>(&camera) != nullptr;
+    const bool rational = dynamic_cast<Rational6Camera<double>*>(&camera) != nullptr;
+    const bool poly = dynamic_cast<Poly2Camera<double>*>(&camera) != nullptr ||
+                      dynamic_cast<Poly3Camera<double>*>(&camera) != nullptr;
+
+    // Linear distortion parameters, from index 4 of params
+    const int num_dist = (kb4 || rational || poly) ? params.size() - 4 : 0;
+
+    // Candidates for w of FovCamera
+    std::vector<double> fov_w;
+    if(fov) {
+        for(int i = 1; i <= 150; ++i) {
+            fov_w.push_back(0.02 * i);
+        }
+    }
+
+    bool initialized = false;
+    std::vector<Points> undistorted;
+    const int num_iterations = std::max(1, options.num_iterations);
+
+    for(int it = 0; it < num_iterations; ++it) {
+        std::vector<Points> image(num_frames);
+        for(int f = 0; f < num_frames; ++f) {
+            image[f] = undistorted.empty() ? *b[f] : undistorted[f];
+        }
+
+        const std::vector<Eigen::Matrix3d> H =
+                EstimateH_baBatch(a, image, options.num_threads);
+        Eigen::Matrix3d K;
+        if(!EstimateKFromHomographies(H, w, h, K)) {
+            break;
+        }
+        const double fx = K(0,0), fy = K(1,1), cx = K(0,2), cy = K(1,2);
+
+        // Normal equations of the distortion fit, or costs of each fov w,
+        // accumulated for each frame.
+        std::vector<Eigen::MatrixXd> JtJ(num_frames, Eigen::MatrixXd::Zero(num_dist, num_dist));
+        std::vector<Eigen::VectorXd> Jtr(num_frames, Eigen::VectorXd::Zero(num_dist));
+        std::vector<Eigen::VectorXd> fov_cost(num_frames, Eigen::VectorXd::Zero(fov_w.size()));
+
+        ParallelForBands(num_frames, options.num_threads, [&](int begin, int end) {
+            Eigen::MatrixXd J(2, num_dist);
+            Eigen::Vector2d r;
+            for(int f = begin; f < end; ++f) {
+                Eigen::Matrix3d R;
+                Eigen::Vector3d t;
+                PoseFromHomography(K, H[f], R, t);
+
+                for(size_t i = 0; i < a[f].size(); ++i) {
+                    const Eigen::Vector3d X = R.leftCols<2>() * a[f][i] + t;
+                    if(X[2] <= 0) {
+                        continue;
+                    }
+                    // Ideal and observed normalised image coordinates
+                    const Eigen::Vector2d u = X.head<2>() / X[2];
+                    const Eigen::Vector2d d(((*b[f])[i][0] - cx) / fx,
+                                            ((*b[f])[i][1] - cy) / fy);
+                    const double r2 = u.squaredNorm();
+
+                    if(poly) {
+                        // d = u (1 + k1 r^2 + k2 r^4 [+ k3 r^6])
+                        double rk = r2;
+                        for(int k = 0; k < num_dist; ++k, rk *= r2) {
+                            J.col(k) = u * rk;
+                        }
+                        r = d - u;
+                    }else if(rational) {
+                        // d (1 + b.r) = u (1 + a.r), in r^2, r^4, r^6
+                        double rk = r2;
+                        for(int k = 0; k < 3; ++k, rk *= r2) {
+                            J.col(k) = u * rk;
+                            J.col(3 + k) = -d * rk;
+                        }
+                        r = d - u;
+                    }else if(kb4) {
+                        // |d| = theta (1 + k0 theta^2 + ... + k3 theta^8)
+                        const double theta = std::atan2(std::sqrt(X[0] * X[0] + X[1] * X[1]), X[2]);
+                        const double theta2 = theta * theta;
+                        double thk = theta * theta2;
+                        J.setZero();
+                        for(int k = 0; k < num_dist; ++k, thk *= theta2) {
+                            J(0, k) = thk;
+                        }
+                        r << d.norm() - theta, 0;
+                    }else if(fov) {
+                        const double ru = std::sqrt(r2);
+                        if(ru < 1e-9) {
+                            continue;
+                        }
+                        for(size_t k = 0; k < fov_w.size(); ++k) {
+                            const double rd = std::atan(2.0 * ru * std::tan(fov_w[k] / 2.0)) / fov_w[k];
+                            fov_cost[f][k] += (d - u * (rd / ru)).squaredNorm();
+                        }
+                        continue;
+                    }else{
+                        continue;
+                    }
+                    JtJ[f] += J.transpose() * J;
+                    Jtr[f] += J.transpose() * r;
+                }
+            }
+        });
+
+        params[0] = fx;
+        params[1] = fy;
+        params[2] = cx;
+        params[3] = cy;
+
+        if(num_dist > 0) {
+            Eigen::MatrixXd A = Eigen::MatrixXd::Zero(num_dist, num_dist);
+            Eigen::VectorXd y = Eigen::VectorXd::Zero(num_dist);
+            for(int f = 0; f < num_frames; ++f) {
+                A += JtJ[f];
+                y += Jtr[f];
+            }
+            // Slight damping in case the high order terms aren't observed
+            A.diagonal().array() += 1e-9 * A.trace() / num_dist + 1e-12;
+            const Eigen::VectorXd k = A.ldlt().solve(y);
+            if(is_finite(k)) {
+                params.segment(4, num_dist) = k;
+            }
+        }else if(fov) {
+            Eigen::VectorXd cost = Eigen::VectorXd::Zero(fov_w.size());
+            for(int f = 0; f < num_frames; ++f) {
+                cost += fov_cost[f];
+            }
+            Eigen::VectorXd::Index best;
+            cost.minCoeff(&best);
+            params[4] = fov_w[best];
+        }
+
+        camera.SetParams(params);
+        initialized = true;
+
+        if(it + 1 < num_iterations) {
+            // Observations as a pinhole camera with this K would see them
+            undistorted.resize(num_frames);
+            for(int f = 0; f < num_frames; ++f) {
+                undistorted[f].clear();
+                for(const Eigen::Vector2d& p : *b[f]) {
+                    const Eigen::Vector3d ray = camera.Unproject(p);
+                    undistorted[f].push_back(ray[2] > 1e-6 ?
+                            Eigen::Vector2d(fx * ray[0] / ray[2] + cx,
+                                            fy * ray[1] / ray[2] + cy) : p);
+                }
+            }
+        }
+    }
+
+    return initialized;
+}
+
+}
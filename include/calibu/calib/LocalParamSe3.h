@@ -23,78 +23,205 @@
 
 #include <calibu/Platform.h>
 #include <ceres/ceres.h>
+#include <sophus/se3.hpp>
+
+// ceres 2.1 introduced manifolds, and 2.2 removed local parameterizations
+#if CERES_VERSION_MAJOR > 2 || (CERES_VERSION_MAJOR == 2 && CERES_VERSION_MINOR >= 1)
+#  define CALIBU_CERES_HAS_MANIFOLD 1
+#endif
+#if CERES_VERSION_MAJOR < 2 || (CERES_VERSION_MAJOR == 2 && CERES_VERSION_MINOR < 2)
+#  define CALIBU_CERES_HAS_LOCAL_PARAMETERIZATION 1
+#endif
 
 namespace calibu
 {
 
+// Update T' = T * exp(delta) of an SE3 stored as by Sophus, with delta the
+// translation then rotation of a right perturbation.
+inline void Se3Plus(const double* x, const double* delta, double* x_plus_delta)
+{
+    const Eigen::Map<const Sophus::SE3d> T(x);
+    const Eigen::Map<const Eigen::Matrix<double,6,1> > dx(delta);
+    Eigen::Map<Sophus::SE3d> Tdx(x_plus_delta);
+    Tdx = T * Sophus::SE3d::exp(dx);
+}
+
+// Inverse of Se3Plus, delta = log(X^-1 * Y).
+inline void Se3Minus(const double* y, const double* x, double* y_minus_x)
+{
+    const Eigen::Map<const Sophus::SE3d> X(x);
+    const Eigen::Map<const Sophus::SE3d> Y(y);
+    Eigen::Map<Eigen::Matrix<double,6,1> > dx(y_minus_x);
+    dx = (X.inverse() * Y).log();
+}
+
+// Row major 7x6 derivative of Se3Plus w.r.t. delta at delta = 0.
+inline void Se3PlusJacobian(const double* x, double* jacobian)
+{
+    // Elements of quaternion
+    const double q1	= x[0];
+    const double q2	= x[1];
+    const double q3	= x[2];
+    const double q0	= x[3];
+
+    // Common terms
+    const double half_q0 = 0.5*q0;
+    const double half_q1 = 0.5*q1;
+    const double half_q2 = 0.5*q2;
+    const double half_q3 = 0.5*q3;
+
+    const double q1_sq = q1*q1;
+    const double q2_sq = q2*q2;
+    const double q3_sq = q3*q3;
+
+    // d output_quaternion / d update, independent of the translation
+    jacobian[0]  = 0;  jacobian[1]  = 0;  jacobian[2]  = 0;
+    jacobian[3]  =  half_q0;
+    jacobian[4]  = -half_q3;
+    jacobian[5]  =  half_q2;
+
+    jacobian[6]  = 0;  jacobian[7]  = 0;  jacobian[8]  = 0;
+    jacobian[9]  =  half_q3;
+    jacobian[10] =  half_q0;
+    jacobian[11] = -half_q1;
+
+    jacobian[12] = 0;  jacobian[13] = 0;  jacobian[14] = 0;
+    jacobian[15] = -half_q2;
+    jacobian[16] =  half_q1;
+    jacobian[17] =  half_q0;
+
+    jacobian[18] = 0;  jacobian[19] = 0;  jacobian[20] = 0;
+    jacobian[21] = -half_q1;
+    jacobian[22] = -half_q2;
+    jacobian[23] = -half_q3;
+
+    // d output_translation / d update, independent of the rotation
+    jacobian[24] = 1.0 - 2.0 * (q2_sq + q3_sq);
+    jacobian[25] = 2.0 * (q1*q2 - q0*q3);
+    jacobian[26] = 2.0 * (q1*q3 + q0*q2);
+    jacobian[27] = 0;  jacobian[28] = 0;  jacobian[29] = 0;
+
+    jacobian[30] = 2.0 * (q1*q2 + q0*q3);
+    jacobian[31] = 1.0 - 2.0 * (q1_sq + q3_sq);
+    jacobian[32] = 2.0 * (q2*q3 - q0*q1);
+    jacobian[33] = 0;  jacobian[34] = 0;  jacobian[35] = 0;
+
+    jacobian[36] = 2.0 * (q1*q3 - q0*q2);
+    jacobian[37] = 2.0 * (q2*q3 + q0*q1);
+    jacobian[38] = 1.0 - 2.0 * (q1_sq + q2_sq);
+    jacobian[39] = 0;  jacobian[40] = 0;  jacobian[41] = 0;
+}
+
+// Row major 6x7 derivative of Se3Minus w.r.t. y at y = x, the pseudo
+// inverse of Se3PlusJacobian for a unit quaternion.
+inline void Se3MinusJacobian(const double* x, double* jacobian)
+{
+    Eigen::Map<Eigen::Matrix<double,6,7,Eigen::RowMajor> > J(jacobian);
+    Eigen::Matrix<double,7,6,Eigen::RowMajor> plus;
+    Se3PlusJacobian(x, plus.data());
+    J.setZero();
+    J.block<3,3>(0,4) = plus.block<3,3>(4,0).transpose();
+    J.block<3,4>(3,0) = 4.0 * plus.block<4,3>(0,3).transpose();
+}
+
+// Lifted Jacobian [I 0]^T of a parameterization whose costs differentiate
+// w.r.t. the tangent space directly, in the first six of the seven columns
+// of a pose block. Row major 7x6.
+inline void Se3LiftedJacobian(double* jacobian)
+{
+    Eigen::Map<Eigen::Matrix<double,7,6,Eigen::RowMajor> > J(jacobian);
+    J.setIdentity();
+}
+
+#ifdef CALIBU_CERES_HAS_LOCAL_PARAMETERIZATION
 class LocalParameterizationSe3 : public ceres::LocalParameterization {
 public:
     virtual ~LocalParameterizationSe3() {}
     virtual bool Plus(const double* x, const double* delta, double* x_plus_delta) const
     {
-        const Eigen::Map<const Sophus::SE3d> T(x);
-        const Eigen::Map<const Eigen::Matrix<double,6,1> > dx(delta);
-        Eigen::Map<Sophus::SE3d> Tdx(x_plus_delta);
-        Tdx = T * Sophus::SE3d::exp(dx);
+        Se3Plus(x, delta, x_plus_delta);
         return true;
     }
-    
+
     virtual bool ComputeJacobian(const double* x, double* jacobian) const
     {
-        // Largely zeroes.
-        memset(jacobian,0, sizeof(double)*7*6);
-        
-        // Elements of quaternion
-        const double q1	= x[0];
-        const double q2	= x[1];
-        const double q3	= x[2];
-        const double q0	= x[3];
-        
-        // Common terms
-        const double half_q0 = 0.5*q0;
-        const double half_q1 = 0.5*q1;
-        const double half_q2 = 0.5*q2;
-        const double half_q3 = 0.5*q3;
-        
-        const double q1_sq = q1*q1;
-        const double q2_sq = q2*q2;
-        const double q3_sq = q3*q3;
-        
-        // d output_quaternion / d update
-        jacobian[3]  =  half_q0;
-        jacobian[4]  = -half_q3;
-        jacobian[5]  =  half_q2;
-        
-        jacobian[9]  =  half_q3;
-        jacobian[10] =  half_q0;
-        jacobian[11] = -half_q1;
-        
-        jacobian[15] = -half_q2;
-        jacobian[16] =  half_q1;
-        jacobian[17] =  half_q0;
-        
-        jacobian[21] = -half_q1;
-        jacobian[22] = -half_q2;
-        jacobian[23] = -half_q3;    
-        
-        // d output_translation / d update
-        jacobian[24]  = 1.0 - 2.0 * (q2_sq + q3_sq);
-        jacobian[25]  = 2.0 * (q1*q2 - q0*q3);
-        jacobian[26]  = 2.0 * (q1*q3 + q0*q2);
-        
-        jacobian[30]  = 2.0 * (q1*q2 + q0*q3);
-        jacobian[31]  = 1.0 - 2.0 * (q1_sq + q3_sq);
-        jacobian[32]  = 2.0 * (q2*q3 - q0*q1);
-        
-        jacobian[36] = 2.0 * (q1*q3 - q0*q2);
-        jacobian[37] = 2.0 * (q2*q3 + q0*q1);
-        jacobian[38] = 1.0 - 2.0 * (q1_sq + q2_sq);
-        
+        Se3PlusJacobian(x, jacobian);
         return true;
     }
-    
+
     virtual int GlobalSize() const { return 7; }
     virtual int LocalSize() const { return 6; }
 };
 
+// As LocalParameterizationSe3, for costs whose pose Jacobians are w.r.t. the
+// right perturbation delta, see COST_JACOBIANS_ANALYTIC_TANGENT.
+class TangentLocalParameterizationSe3 : public LocalParameterizationSe3 {
+public:
+    virtual bool ComputeJacobian(const double* /*x*/, double* jacobian) const
+    {
+        Se3LiftedJacobian(jacobian);
+        return true;
+    }
+};
+#endif // CALIBU_CERES_HAS_LOCAL_PARAMETERIZATION
+
+#ifdef CALIBU_CERES_HAS_MANIFOLD
+// SE3 manifold of a Sophus pose, updated by right perturbations.
+class ManifoldSe3 : public ceres::Manifold {
+public:
+    virtual ~ManifoldSe3() {}
+    virtual int AmbientSize() const { return 7; }
+    virtual int TangentSize() const { return 6; }
+
+    virtual bool Plus(const double* x, const double* delta, double* x_plus_delta) const
+    {
+        Se3Plus(x, delta, x_plus_delta);
+        return true;
+    }
+
+    virtual bool PlusJacobian(const double* x, double* jacobian) const
+    {
+        Se3PlusJacobian(x, jacobian);
+        return true;
+    }
+
+    virtual bool Minus(const double* y, const double* x, double* y_minus_x) const
+    {
+        Se3Minus(y, x, y_minus_x);
+        return true;
+    }
+
+    virtual bool MinusJacobian(const double* x, double* jacobian) const
+    {
+        Se3MinusJacobian(x, jacobian);
+        return true;
+    }
+};
+
+// As ManifoldSe3, for costs whose pose Jacobians are w.r.t. the right
+// perturbation delta, see COST_JACOBIANS_ANALYTIC_TANGENT.
+class TangentManifoldSe3 : public ManifoldSe3 {
+public:
+    virtual bool PlusJacobian(const double* /*x*/, double* jacobian) const
+    {
+        Se3LiftedJacobian(jacobian);
+        return true;
+    }
+
+    virtual bool MinusJacobian(const double* /*x*/, double* jacobian) const
+    {
+        Eigen::Map<Eigen::Matrix<double,6,7,Eigen::RowMajor> > J(jacobian);
+        J.setIdentity();
+        return true;
+    }
+};
+
+// Parameterization of poses in a ceres problem
+typedef ManifoldSe3 ParameterizationSe3;
+typedef TangentManifoldSe3 TangentParameterizationSe3;
+#else
+typedef LocalParameterizationSe3 ParameterizationSe3;
+typedef TangentLocalParameterizationSe3 TangentParameterizationSe3;
+#endif // CALIBU_CERES_HAS_MANIFOLD
+
 }
@@ -0,0 +1,93 @@
+/*
+   This file is part of the Calibu Project.
+   https://github.com/arpg/Calibu
+
+   Copyright (C) 2013 George Washington University,
+                      Steven Lovegrove,
+                      Gabe Sibley
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+   http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#pragma once
+
+#include <cmath>
+#include <limits>
+#include <string>
+#include <vector>
+
+namespace calibu
+{
+
+/// How well one candidate camera model fits a set of observations.
+struct CameraModelFit
+{
+    CameraModelFit()
+        : mse(0), num_residuals(0), num_params(0), converged(false),
+          aic(std::numeric_limits<double>::infinity()),
+          bic(std::numeric_limits<double>::infinity())
+    {
+    }
+
+    /// Model name, e.g. "fov" or "kb4".
+    std::string model;
+
+    /// Mean square reprojection error, as Calibrator::MeanSquareError.
+    double mse;
+
+    /// Number of residuals, two per observation, and of free parameters.
+    int num_residuals;
+    int num_params;
+
+    /// Whether the optimiser converged for this model.
+    bool converged;
+
+    /// Akaike and Bayesian information criteria, lower is better, see
+    /// ComputeInformationCriteria.
+    double aic;
+    double bic;
+};
+
+/// Fill in the information criteria of 'fit' from its error and size,
+/// treating residuals as independent Gaussian with variance 2 * mse (the
+/// calibrator's cost is half the sum of squares). Both reward a lower error
+/// and penalise parameters, the BIC more so as observations grow. Criteria
+/// are infinite without residuals.
+inline void ComputeInformationCriteria(CameraModelFit& fit)
+{
+    if(fit.num_residuals <= 0 || fit.mse <= 0) {
+        fit.aic = fit.bic = std::numeric_limits<double>::infinity();
+        return;
+    }
+    const double n = fit.num_residuals;
+    const double log_likelihood_term = n * std::log(2 * fit.mse);
+    fit.aic = log_likelihood_term + 2.0 * fit.num_params;
+    fit.bic = log_likelihood_term + fit.num_params * std::log(n);
+}
+
+/// Return the index of the fit with the lowest BIC, preferring converged
+/// fits, or -1 if 'fits' is empty.
+inline int SelectCameraModel(const std::vector<CameraModelFit>& fits)
+{
+    int best = -1;
+    for(size_t m = 0; m < fits.size(); ++m) {
+        if(best < 0 || (fits[m].converged && !fits[best].converged) ||
+           (fits[m].converged == fits[best].converged &&
+            fits[m].bic < fits[best].bic)) {
+            best = m;
+        }
+    }
+    return best;
+}
+
+}
@@ -0,0 +1,267 @@
+/*
+   This file is part of the Calibu Project.
+   https://github.com/arpg/Calibu
+
+   Copyright (C) 2013 George Washington University,
+                      Steven Lovegrove,
+                      Gabe Sibley
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+   http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <calibu/calib/Calibrator.h>
+#include <calibu/calib/ModelSelection.h>
+
+namespace calibu
+{
+
+/// Fits several candidate camera models to the same observations at once,
+/// one Calibrator per candidate, each optimising on its own thread. Frames
+/// are selected once for all candidates, so every model sees the same
+/// frames, starting poses and observations. Once the optimisers are
+/// stopped, Fits() compares the candidates and BestModel() picks one.
+///
+/// Frames, cameras and observations are added through the same calls as
+/// for Calibrator, which forward to every candidate.
+class MultiModelCalibrator
+{
+public:
+    MultiModelCalibrator(const CalibratorOptions& options = CalibratorOptions())
+        : m_options(options), m_fix_intrinsics(false), m_max_frames(0),
+          m_num_frames(0)
+    {
+    }
+
+    ~MultiModelCalibrator()
+    {
+        Stop();
+    }
+
+    /// Add candidate 'model', named for reporting. Cameras are added to it
+    /// with AddCamera. Returns the candidate's index.
+    size_t AddModel(const std::string& model)
+    {
+        m_models.push_back(model);
+        m_calibrators.push_back(make_unique<Calibrator>(m_options));
+        m_calibrators.back()->FixCameraIntrinsics(m_fix_intrinsics);
+        return m_calibrators.size() - 1;
+    }
+
+    /// Return number of candidate models.
+    size_t NumModels() const
+    {
+        return m_calibrators.size();
+    }
+
+    /// Return name of candidate m.
+    const std::string& ModelName(size_t m) const
+    {
+        return m_models[m];
+    }
+
+    /// Return calibrator of candidate m.
+    Calibrator& GetCalibrator(size_t m)
+    {
+        return *m_calibrators[m];
+    }
+
+    /// Add camera 'cam', modelled as candidate m, to that candidate's rig.
+    /// Cameras must be added in the same order to every candidate, so that
+    /// IDs agree between them.
+    int AddCamera(size_t m, const std::shared_ptr<CameraInterface<double>> cam,
+                  const Sophus::SE3d& T_ck = Sophus::SE3d())
+    {
+        return m_calibrators[m]->AddCamera(cam, T_ck);
+    }
+
+    /// Return number of cameras in each candidate's rig.
+    size_t NumCameras() const
+    {
+        return m_calibrators.empty() ? 0 : m_calibrators[0]->NumCameras();
+    }
+
+    /// Set whether intrinsics of every candidate should be held fixed.
+    void FixCameraIntrinsics(bool v = true)
+    {
+        m_fix_intrinsics = v;
+        for(const std::unique_ptr<Calibrator>& calibrator : m_calibrators) {
+            calibrator->FixCameraIntrinsics(v);
+        }
+    }
+
+    /// Set selector used by SelectFrame, as Calibrator::SetFrameSelector.
+    void SetFrameSelector(const std::shared_ptr<FrameSelector>& selector)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_frame_selector = selector;
+    }
+
+    /// Set maximum number of frames SelectFrame will accept, 0 for no limit.
+    void SetMaxFrames(size_t max_frames)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_max_frames = max_frames;
+    }
+
+    /// Return true if a frame should be added to the calibration, as
+    /// Calibrator::SelectFrame, deciding for all candidates together.
+    bool SelectFrame(const Sophus::SE3d& T_kw, const std::vector<FramePoints>& p_c)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if(m_max_frames > 0 && m_num_frames >= m_max_frames) {
+            return false;
+        }
+        if(m_frame_selector) {
+            if(!m_frame_selector->IsInformative(T_kw, p_c)) {
+                return false;
+            }
+            m_frame_selector->Add(T_kw, p_c);
+        }
+        ++m_num_frames;
+        return true;
+    }
+
+    /// Add frame with starting pose T_kw to every candidate. Returns its ID.
+    int AddFrame(Sophus::SE3d T_kw = Sophus::SE3d())
+    {
+        int id = -1;
+        for(const std::unique_ptr<Calibrator>& calibrator : m_calibrators) {
+            id = calibrator->AddFrame(T_kw);
+        }
+        return id;
+    }
+
+    /// Add observations of a frame to every candidate, as
+    /// Calibrator::AddObservations.
+    void AddObservations(
+            size_t frame, size_t camera,
+            const std::vector<Eigen::Vector3d,
+                              Eigen::aligned_allocator<Eigen::Vector3d> >& P_w,
+            const std::vector<Eigen::Vector2d,
+                              Eigen::aligned_allocator<Eigen::Vector2d> >& p_c)
+    {
+        for(const std::unique_ptr<Calibrator>& calibrator : m_calibrators) {
+            calibrator->AddObservations(frame, camera, P_w, p_c);
+        }
+    }
+
+    /// Start the optimisation thread of every candidate.
+    void Start()
+    {
+        for(const std::unique_ptr<Calibrator>& calibrator : m_calibrators) {
+            calibrator->Start();
+        }
+    }
+
+    /// Stop the optimisation thread of every candidate.
+    void Stop()
+    {
+        for(const std::unique_ptr<Calibrator>& calibrator : m_calibrators) {
+            calibrator->Stop();
+        }
+    }
+
+    /// Block until every candidate reaches tolerance or stops, or until
+    /// timeout_seconds pass. Returns true if all of them reached tolerance.
+    bool WaitForTolerance(double timeout_seconds)
+    {
+        const std::chrono::steady_clock::time_point deadline =
+                std::chrono::steady_clock::now() +
+                std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                    std::chrono::duration<double>(timeout_seconds));
+
+        bool all = true;
+        for(const std::unique_ptr<Calibrator>& calibrator : m_calibrators) {
+            const double remaining = std::chrono::duration<double>(
+                        deadline - std::chrono::steady_clock::now()).count();
+            all = calibrator->WaitForTolerance(std::max(0.0, remaining)) && all;
+        }
+        return all;
+    }
+
+    /// Return how well each candidate fits, from its latest solve. Counts
+    /// every free intrinsic, extrinsic and frame parameter, so that the
+    /// information criteria are comparable between candidates.
+    std::vector<CameraModelFit> Fits() const
+    {
+        std::vector<CameraModelFit> fits(m_calibrators.size());
+        for(size_t m = 0; m < m_calibrators.size(); ++m) {
+            const std::shared_ptr<const CalibratorSnapshot> snapshot =
+                    m_calibrators[m]->Snapshot();
+            CameraModelFit& fit = fits[m];
+            fit.model = m_models[m];
+            fit.mse = snapshot->mse;
+            fit.num_residuals = snapshot->num_residuals;
+            fit.converged = snapshot->termination_type == ceres::CONVERGENCE;
+
+            // Camera 0 defines the rig frame, and its extrinsics are fixed
+            fit.num_params = 6 * snapshot->T_kw.size();
+            for(size_t c = 0; c < snapshot->params.size(); ++c) {
+                if(!m_fix_intrinsics) {
+                    fit.num_params += snapshot->params[c].size();
+                }
+                if(c > 0) {
+                    fit.num_params += 6;
+                }
+            }
+            ComputeInformationCriteria(fit);
+        }
+        return fits;
+    }
+
+    /// Return index of the candidate that best fits, see SelectCameraModel,
+    /// or -1 if there are none.
+    int BestModel() const
+    {
+        return SelectCameraModel(Fits());
+    }
+
+    /// Print how well each candidate fits, marking the best.
+    void PrintFits() const
+    {
+        const std::vector<CameraModelFit> fits = Fits();
+        const int best = SelectCameraModel(fits);
+        std::cout << "------------------------------------------" << std::endl;
+        for(size_t m = 0; m < fits.size(); ++m) {
+            std::cout << ((int)m == best ? "* " : "  ");
+            std::cout << fits[m].model << ": mse " << fits[m].mse
+                      << ", params " << fits[m].num_params
+                      << ", aic " << fits[m].aic << ", bic " << fits[m].bic
+                      << (fits[m].converged ? "" : " (not converged)")
+                      << std::endl;
+        }
+    }
+
+protected:
+    std::mutex m_mutex;
+    CalibratorOptions m_options;
+    bool m_fix_intrinsics;
+    std::shared_ptr<FrameSelector> m_frame_selector;
+    size_t m_max_frames;
+    size_t m_num_frames;
+
+    std::vector<std::string> m_models;
+    std::vector<std::unique_ptr<Calibrator> > m_calibrators;
+};
+
+}
@@ -0,0 +1,150 @@
+/*
+   This file is part of the Calibu Project.
+   https://github.com/arpg/Calibu
+
+   Copyright (C) 2013 George Washington University,
+                      Steven Lovegrove,
+                      Gabe Sibley
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+   http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include <calibu/calib/FrameSelector.h>
+
+namespace calibu
+{
+
+/// Decides which observations of a frame are worth adding to a calibration,
+/// given the observations accepted so far, see
+/// Calibrator::SetObservationSelector.
+class ObservationSelector
+{
+public:
+    virtual ~ObservationSelector() {}
+
+    /// Choose among the points p_c observed by 'camera' in one frame, and
+    /// record them as accepted. 'selected' receives the indices of the
+    /// chosen points in p_c, in increasing order.
+    virtual void Select(size_t camera, const FramePoints& p_c,
+                        std::vector<size_t>& selected) = 0;
+
+    /// Forget all accepted observations.
+    virtual void Clear() = 0;
+};
+
+/// Divides each camera image into a grid of cells and accepts at most
+/// max_per_cell observations in each cell over the whole calibration, and
+/// at most max_per_frame (0 for no limit) from each frame. Within a frame,
+/// each observation is taken from the least populated cell, so that
+/// sparsely covered parts of the image are preferred over the centre, where
+/// the target is usually seen.
+class BinnedObservationSelector : public ObservationSelector
+{
+public:
+    /// image_size[c] is the size of camera c's images, in pixels.
+    BinnedObservationSelector(const std::vector<Eigen::Vector2i>& image_size,
+                              int max_per_cell, int cells_x = 16,
+                              int cells_y = 12, int max_per_frame = 0)
+        : m_image_size(image_size), m_cells_x(cells_x), m_cells_y(cells_y),
+          m_max_per_cell(max_per_cell), m_max_per_frame(max_per_frame)
+    {
+        Clear();
+    }
+
+    void Select(size_t camera, const FramePoints& p_c,
+                std::vector<size_t>& selected)
+    {
+        selected.clear();
+        if(camera >= m_count.size()) {
+            // Unknown camera, nothing to balance against
+            for(size_t i = 0; i < p_c.size(); ++i) {
+                selected.push_back(i);
+            }
+            return;
+        }
+
+        // Candidates of each cell, which still has room
+        std::vector<int>& count = m_count[camera];
+        std::vector<std::vector<size_t> > candidates(count.size());
+        std::vector<int> cells;
+        for(size_t i = 0; i < p_c.size(); ++i) {
+            const int cell = Cell(camera, p_c[i]);
+            if(cell >= 0 && count[cell] < m_max_per_cell) {
+                if(candidates[cell].empty()) {
+                    cells.push_back(cell);
+                }
+                candidates[cell].push_back(i);
+            }
+        }
+
+        const size_t budget = m_max_per_frame > 0 ?
+                    (size_t)m_max_per_frame : p_c.size();
+        std::vector<size_t> next(count.size(), 0);
+
+        while(selected.size() < budget && !cells.empty()) {
+            // Serve the least populated cell, the first seen on a tie
+            std::vector<int>::iterator it = std::min_element(
+                        cells.begin(), cells.end(), [&](int a, int b) {
+                return count[a] < count[b];
+            });
+            const int cell = *it;
+            selected.push_back(candidates[cell][next[cell]++]);
+            if(++count[cell] == m_max_per_cell ||
+                    next[cell] == candidates[cell].size()) {
+                cells.erase(it);
+            }
+        }
+
+        std::sort(selected.begin(), selected.end());
+    }
+
+    void Clear()
+    {
+        m_count.assign(m_image_size.size(),
+                       std::vector<int>(m_cells_x * m_cells_y, 0));
+    }
+
+    /// Return number of observations accepted in each cell of 'camera', in
+    /// row-major order.
+    const std::vector<int>& CellCounts(size_t camera) const
+    {
+        return m_count[camera];
+    }
+
+protected:
+    /// Return grid cell of point p in camera c, or -1 if outside the image.
+    int Cell(size_t c, const Eigen::Vector2d& p) const
+    {
+        const int x = (int)std::floor(p[0] * m_cells_x / m_image_size[c][0]);
+        const int y = (int)std::floor(p[1] * m_cells_y / m_image_size[c][1]);
+        if(x < 0 || x >= m_cells_x || y < 0 || y >= m_cells_y) {
+            return -1;
+        }
+        return y * m_cells_x + x;
+    }
+
+    std::vector<Eigen::Vector2i> m_image_size;
+    int m_cells_x;
+    int m_cells_y;
+    int m_max_per_cell;
+    int m_max_per_frame;
+    std::vector<std::vector<int> > m_count;
+};
+
+}
@@ -0,0 +1,181 @@
+/*
+   This file is part of the Calibu Project.
+   https://github.com/arpg/Calibu
+
+   Copyright (C) 2013 George Washington University,
+                      Steven Lovegrove,
+                      Gabe Sibley
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+   http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include <Eigen/Eigen>
+#include <Eigen/StdVector>
+
+namespace calibu
+{
+
+/// Table of the observations a calibration is made from: target point P_w,
+/// its image p_c, the frame and camera observing it, and whether it is
+/// still in use. Each column is contiguous within blocks of rows which
+/// never move once allocated, and the rows added together are never split
+/// between blocks, so costs can read their points from the table in place
+/// rather than keeping copies of them.
+class ObservationTable
+{
+public:
+    /// Rows [begin, begin + size) of block 'block'.
+    struct Range
+    {
+        Range() : block(0), begin(0), size(0) {}
+
+        uint32_t block;
+        uint32_t begin;
+        uint32_t size;
+    };
+
+    /// block_rows is the number of rows allocated at a time. Ranges larger
+    /// than it are given a block of their own.
+    explicit ObservationTable(size_t block_rows = 4096)
+        : m_block_rows(std::max<size_t>(block_rows, 1)), m_num_active(0)
+    {
+    }
+
+    /// Append n observations P_w[i] / p_c[i] of 'camera' in 'frame', and
+    /// return the rows holding them.
+    Range Add(size_t frame, size_t camera, const Eigen::Vector3d* P_w,
+              const Eigen::Vector2d* p_c, size_t n)
+    {
+        if(m_blocks.empty() || m_blocks.back()->Free() < n) {
+            m_blocks.push_back(std::unique_ptr<Block>(
+                                   new Block(std::max(m_block_rows, n))));
+        }
+        Block& block = *m_blocks.back();
+
+        Range rows;
+        rows.block = m_blocks.size() - 1;
+        rows.begin = block.used;
+        rows.size = n;
+        for(size_t i = 0; i < n; ++i) {
+            const size_t r = block.used + i;
+            block.P_w[r] = P_w[i];
+            block.p_c[r] = p_c[i];
+            block.frame[r] = frame;
+            block.camera[r] = camera;
+            block.active[r] = 1;
+        }
+        block.used += n;
+        m_num_active += n;
+        return rows;
+    }
+
+    /// Keep rows[keep[j]] for each j, which must be increasing, moving them
+    /// to the front of rows, and mark the others inactive. Returns the rows
+    /// now holding the kept observations. Costs reading the original rows
+    /// are invalidated.
+    Range Retain(const Range& rows, const std::vector<size_t>& keep)
+    {
+        Block& block = *m_blocks[rows.block];
+        for(size_t j = 0; j < keep.size(); ++j) {
+            const size_t from = rows.begin + keep[j];
+            const size_t to = rows.begin + j;
+            block.P_w[to] = block.P_w[from];
+            block.p_c[to] = block.p_c[from];
+        }
+        for(size_t r = rows.begin + keep.size(); r < rows.begin + rows.size; ++r) {
+            block.active[r] = 0;
+        }
+        m_num_active -= rows.size - keep.size();
+
+        Range kept = rows;
+        kept.size = keep.size();
+        return kept;
+    }
+
+    /// Remove all rows.
+    void Clear()
+    {
+        m_blocks.clear();
+        m_num_active = 0;
+    }
+
+    /// Number of rows still in use.
+    size_t NumActive() const
+    {
+        return m_num_active;
+    }
+
+    const Eigen::Vector3d* P_w(const Range& rows) const
+    {
+        return m_blocks[rows.block]->P_w.data() + rows.begin;
+    }
+
+    const Eigen::Vector2d* p_c(const Range& rows) const
+    {
+        return m_blocks[rows.block]->p_c.data() + rows.begin;
+    }
+
+    /// Frame and camera of the observations in rows, which are all of the
+    /// same frame and camera if added together.
+    size_t Frame(const Range& rows) const
+    {
+        return m_blocks[rows.block]->frame[rows.begin];
+    }
+
+    size_t Camera(const Range& rows) const
+    {
+        return m_blocks[rows.block]->camera[rows.begin];
+    }
+
+    bool Active(const Range& rows, size_t i) const
+    {
+        return m_blocks[rows.block]->active[rows.begin + i] != 0;
+    }
+
+protected:
+    /// Columns of a block of rows, allocated in full up front so that
+    /// pointers into them stay valid as rows are added.
+    struct Block
+    {
+        Block(size_t rows)
+            : P_w(rows), p_c(rows), frame(rows), camera(rows), active(rows, 0),
+              used(0)
+        {
+        }
+
+        size_t Free() const
+        {
+            return P_w.size() - used;
+        }
+
+        std::vector<Eigen::Vector3d, Eigen::aligned_allocator<Eigen::Vector3d> > P_w;
+        std::vector<Eigen::Vector2d, Eigen::aligned_allocator<Eigen::Vector2d> > p_c;
+        std::vector<uint32_t> frame;
+        std::vector<uint32_t> camera;
+        std::vector<uint8_t> active;
+        size_t used;
+    };
+
+    size_t m_block_rows;
+    size_t m_num_active;
+    std::vector< std::unique_ptr<Block> > m_blocks;
+};
+
+}
@@ -0,0 +1,421 @@
+/*
+   This file is part of the Calibu Project.
+   https://github.com/arpg/Calibu
+
+   Copyright (C) 2013 George Washington University,
+                      Steven Lovegrove,
+                      Gabe Sibley
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+   http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+#include <Eigen/Eigen>
+#include <Eigen/StdVector>
+#include <sophus/se3.hpp>
+
+#include <calibu/Platform.h>
+#include <calibu/cam/camera_crtp.h>
+#include <calibu/pose/Tracker.h>
+
+#include <ceres/ceres.h>
+
+#include <calibu/calib/LocalParamSe3.h>
+#include <calibu/calib/ReprojectionCostFactory.h>
+
+namespace calibu
+{
+
+/// Options controlling how OnlineCalibrator refines intrinsics.
+struct OnlineCalibratorOptions
+{
+    OnlineCalibratorOptions()
+        : window_size(10),
+          max_num_iterations(5),
+          num_threads(1),
+          loss_scale(0.5),
+          prior_decay(1.0),
+          min_observations(10),
+          publish_interval_in_seconds(1.0)
+    {
+    }
+
+    /// Frames optimised together. Older frames are marginalised into the
+    /// prior on intrinsics, which bounds the cost of each frame.
+    size_t window_size;
+
+    /// Solver iterations per added frame, each solve starting from the last.
+    int max_num_iterations;
+
+    /// Threads used to evaluate costs and Jacobians.
+    int num_threads;
+
+    /// Scale in pixels of the soft L1 loss robustifying each observation,
+    /// or <= 0 for plain least squares.
+    double loss_scale;
+
+    /// Factor the prior's information is scaled by whenever a frame is
+    /// marginalised. Below 1, old frames are gradually forgotten, so that
+    /// the estimate can follow intrinsics drifting e.g. with temperature.
+    double prior_decay;
+
+    /// Frames with fewer observations than this are ignored.
+    size_t min_observations;
+
+    /// Time between updates of the camera's parameters, in seconds. The
+    /// estimate is published from AddFrame once this has passed.
+    double publish_interval_in_seconds;
+};
+
+/// Refines the intrinsics of one camera from a stream of target detections,
+/// such as those of a Tracker, e.g. to follow thermal drift in the field.
+/// Unlike Calibrator, only the last OnlineCalibratorOptions::window_size
+/// frames are optimised, together with a Gaussian prior on the intrinsics
+/// formed by marginalising the frames that left the window. Each frame
+/// therefore costs the same to add, however long the stream.
+///
+/// Intrinsics are optimised in a copy, and written to the camera at a fixed
+/// rate, so that a tracker using it sees changes no faster than that. Not
+/// thread safe; frames are added and the camera updated on the caller's
+/// thread.
+class OnlineCalibrator
+{
+public:
+    /// Refine intrinsics of 'camera', starting from its current parameters.
+    /// Costs for the camera are created by cost_factory, which by default is
+    /// found from CalibratorCameraModels.
+    OnlineCalibrator(const std::shared_ptr<CameraInterface<double>>& camera,
+                     const OnlineCalibratorOptions& options = OnlineCalibratorOptions(),
+                     std::shared_ptr<ReprojectionCostFactory> cost_factory = nullptr)
+        : m_camera(camera), m_options(options), m_cost_factory(cost_factory),
+          m_num_marginalized(0), m_num_published(0), m_mse(0)
+    {
+        if(!m_cost_factory) {
+            m_cost_factory = CalibratorCameraModels::NewCostFactory(camera.get());
+        }
+        if(!m_cost_factory) {
+            throw std::runtime_error("Don't know how to optimize Camera.");
+        }
+        Reset();
+    }
+
+    /// Forget all frames and the prior, restarting from the camera's
+    /// current parameters.
+    void Reset()
+    {
+        m_frames.clear();
+        m_params = m_camera->GetParams();
+        m_prior_information.setZero(m_params.size(), m_params.size());
+        m_prior_eta.setZero(m_params.size());
+        m_prior.reset();
+        m_num_marginalized = 0;
+        m_mse = 0;
+        m_last_publish = std::chrono::steady_clock::now();
+    }
+
+    /// Add observations p_c[i] of target points P_w[i] in a new frame, seen
+    /// from approximately T_cw, and refine the intrinsics over the window.
+    /// Returns false if the frame has too few observations to be used.
+    bool AddFrame(
+            const Sophus::SE3d& T_cw,
+            const std::vector<Eigen::Vector3d,
+                              Eigen::aligned_allocator<Eigen::Vector3d> >& P_w,
+            const std::vector<Eigen::Vector2d,
+                              Eigen::aligned_allocator<Eigen::Vector2d> >& p_c)
+    {
+        if( P_w.size() != p_c.size() ) { throw std::runtime_error("Mismatched observation count."); }
+        if( P_w.size() < m_options.min_observations ) {
+            return false;
+        }
+
+        m_frames.push_back(std::unique_ptr<Frame>(new Frame));
+        Frame& frame = *m_frames.back();
+        frame.T_cw = T_cw;
+        frame.cost.reset(m_cost_factory->NewCosts(
+                             P_w, p_c, m_options.loss_scale, COST_JACOBIANS_ANALYTIC));
+
+        // Bound the window before solving, so each solve is the same size
+        while(m_frames.size() > std::max<size_t>(m_options.window_size, 1)) {
+            Marginalize(*m_frames.front());
+            m_frames.pop_front();
+        }
+
+        Solve();
+
+        const double elapsed = std::chrono::duration<double>(
+                    std::chrono::steady_clock::now() - m_last_publish).count();
+        if(elapsed >= m_options.publish_interval_in_seconds) {
+            Publish();
+        }
+        return true;
+    }
+
+    /// Add the target found by 'tracker' in its last processed frame, for
+    /// which ProcessFrame must have succeeded.
+    bool AddFrame(const Tracker& tracker)
+    {
+        const ConicSet& conics =
+                tracker.GetConicFinder().Conics();
+        const std::vector<int>& target_map = tracker.ConicsTargetMap();
+        const std::vector<Eigen::Vector3d, Eigen::aligned_allocator<Eigen::Vector3d> >& circles =
+                tracker.Target().Circles3D();
+
+        std::vector<Eigen::Vector3d, Eigen::aligned_allocator<Eigen::Vector3d> > P_w;
+        std::vector<Eigen::Vector2d, Eigen::aligned_allocator<Eigen::Vector2d> > p_c;
+        for(size_t i=0; i < conics.size() && i < target_map.size(); ++i) {
+            if(target_map[i] >= 0) {
+                P_w.push_back(circles[target_map[i]]);
+                p_c.push_back(conics.Center(i));
+            }
+        }
+        return AddFrame(tracker.PoseT_gw(), P_w, p_c);
+    }
+
+    /// Write the current estimate to the camera now, and notify the publish
+    /// callback, if there is one.
+    void Publish()
+    {
+        m_camera->SetParams(m_params);
+        m_last_publish = std::chrono::steady_clock::now();
+        ++m_num_published;
+        if(m_publish_callback) {
+            m_publish_callback(m_params);
+        }
+    }
+
+    /// Set function called with the intrinsics whenever they are published.
+    void SetPublishCallback(const std::function<void(const Eigen::VectorXd&)>& callback)
+    {
+        m_publish_callback = callback;
+    }
+
+    /// Return current estimate of the intrinsics, which may not have been
+    /// published yet.
+    const Eigen::VectorXd& Params() const
+    {
+        return m_params;
+    }
+
+    /// Return information matrix of the prior on intrinsics, from the
+    /// frames marginalised so far.
+    const Eigen::MatrixXd& PriorInformation() const
+    {
+        return m_prior_information;
+    }
+
+    /// Return number of frames in the window.
+    size_t NumFrames() const
+    {
+        return m_frames.size();
+    }
+
+    /// Return number of frames marginalised into the prior.
+    size_t NumMarginalized() const
+    {
+        return m_num_marginalized;
+    }
+
+    /// Return number of times the intrinsics have been published.
+    size_t NumPublished() const
+    {
+        return m_num_published;
+    }
+
+    /// Return mean square error over the window's residuals after the last
+    /// solve.
+    double MeanSquareError() const
+    {
+        return m_mse;
+    }
+
+protected:
+    /// Frame in the window, with its cost over all of its observations.
+    struct Frame
+    {
+        EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+        Sophus::SE3d T_cw;
+        std::unique_ptr<ceres::CostFunction> cost;
+    };
+
+    /// Gaussian prior 0.5 |L (x - mu)|^2 on the intrinsics x.
+    class PriorCost : public ceres::CostFunction
+    {
+    public:
+        PriorCost(const Eigen::MatrixXd& L, const Eigen::VectorXd& mu)
+            : m_L(L), m_r0(L * mu)
+        {
+            set_num_residuals(L.rows());
+            mutable_parameter_block_sizes()->push_back(L.cols());
+        }
+
+        bool Evaluate(double const* const* parameters, double* residuals,
+                      double** jacobians) const
+        {
+            const Eigen::Map<const Eigen::VectorXd> x(parameters[0], m_L.cols());
+            Eigen::Map<Eigen::VectorXd>(residuals, m_L.rows()) = m_L * x - m_r0;
+            if(jacobians && jacobians[0]) {
+                Eigen::Map<Eigen::Matrix<double,Eigen::Dynamic,Eigen::Dynamic,Eigen::RowMajor> >(
+                            jacobians[0], m_L.rows(), m_L.cols()) = m_L;
+            }
+            return true;
+        }
+
+    protected:
+        Eigen::MatrixXd m_L;
+        Eigen::VectorXd m_r0;
+    };
+
+    /// Refine the intrinsics and poses of the window.
+    void Solve()
+    {
+        ceres::Problem::Options prob_options;
+        prob_options.cost_function_ownership = ceres::DO_NOT_TAKE_OWNERSHIP;
+#ifdef CALIBU_CERES_HAS_LOCAL_PARAMETERIZATION
+        prob_options.local_parameterization_ownership = ceres::DO_NOT_TAKE_OWNERSHIP;
+#endif
+#ifdef CALIBU_CERES_HAS_MANIFOLD
+        prob_options.manifold_ownership = ceres::DO_NOT_TAKE_OWNERSHIP;
+#endif
+        ceres::Problem problem(prob_options);
+
+        // A single camera defines the rig frame
+        problem.AddParameterBlock(m_T_ck.data(), 7, &m_ParamSe3);
+        problem.SetParameterBlockConstant(m_T_ck.data());
+        problem.AddParameterBlock(m_params.data(), m_params.size());
+
+        for(const std::unique_ptr<Frame>& frame : m_frames) {
+            problem.AddParameterBlock(frame->T_cw.data(), 7, &m_ParamSe3);
+            problem.AddResidualBlock(frame->cost.get(), nullptr,
+                                     frame->T_cw.data(), m_T_ck.data(), m_params.data());
+        }
+        if(m_prior) {
+            problem.AddResidualBlock(m_prior.get(), nullptr, m_params.data());
+        }
+
+        // Poses only share the intrinsics, so are eliminated first
+        ceres::Solver::Options options;
+        options.linear_solver_type = ceres::DENSE_SCHUR;
+        options.max_num_iterations = m_options.max_num_iterations;
+        options.num_threads = m_options.num_threads;
+        options.logging_type = ceres::SILENT;
+
+        ceres::Solver::Summary summary;
+        ceres::Solve(options, &problem, &summary);
+        m_mse = summary.num_residuals > 0 ? summary.final_cost / summary.num_residuals : 0;
+    }
+
+    /// Fold the information 'frame' carries about the intrinsics into the
+    /// prior, linearised at the current estimate. Frames are only linked to
+    /// each other through the intrinsics, so eliminating the frame's pose
+    /// from its own cost is the exact (linearised) marginal.
+    void Marginalize(Frame& frame)
+    {
+        typedef Eigen::Matrix<double,Eigen::Dynamic,Eigen::Dynamic,Eigen::RowMajor> RowMatrix;
+
+        const int n = m_params.size();
+        const int num_residuals = frame.cost->num_residuals();
+        Eigen::VectorXd r(num_residuals);
+        RowMatrix J_cw(num_residuals, 7);
+        RowMatrix J_params(num_residuals, n);
+
+        const double* parameters[3] = { frame.T_cw.data(), m_T_ck.data(), m_params.data() };
+        double* jacobians[3] = { J_cw.data(), nullptr, J_params.data() };
+        if(!frame.cost->Evaluate(parameters, r.data(), jacobians)) {
+            return;
+        }
+
+        // Pose Jacobian w.r.t. its tangent space
+        Eigen::Matrix<double,7,6,Eigen::RowMajor> J_plus;
+        Se3PlusJacobian(frame.T_cw.data(), J_plus.data());
+        const Eigen::MatrixXd J_pose = J_cw * J_plus;
+
+        // Schur complement of the pose block
+        const Eigen::Matrix<double,6,6> H_pp = J_pose.transpose() * J_pose;
+        const Eigen::MatrixXd H_px = J_pose.transpose() * J_params;
+        const Eigen::LDLT<Eigen::Matrix<double,6,6> > H_pp_ldlt(H_pp);
+        const Eigen::MatrixXd H = J_params.transpose() * J_params -
+                H_px.transpose() * H_pp_ldlt.solve(H_px);
+        const Eigen::VectorXd b = J_params.transpose() * r -
+                H_px.transpose() * H_pp_ldlt.solve(J_pose.transpose() * r);
+
+        // The marginal 0.5 dx^T H dx + b^T dx about the current estimate x0
+        // is, up to a constant, 0.5 x^T H x - (H x0 - b)^T x.
+        m_prior_information *= m_options.prior_decay;
+        m_prior_eta *= m_options.prior_decay;
+        m_prior_information += H;
+        m_prior_eta += H * m_params - b;
+        ++m_num_marginalized;
+
+        UpdatePrior();
+    }
+
+    /// Form prior cost from m_prior_information and m_prior_eta, leaving
+    /// directions without information unconstrained.
+    void UpdatePrior()
+    {
+        const Eigen::SelfAdjointEigenSolver<Eigen::MatrixXd> eig(
+                    0.5 * (m_prior_information + m_prior_information.transpose()));
+        const Eigen::VectorXd& lambda = eig.eigenvalues();
+        const double eps = 1e-12 * std::max(lambda.maxCoeff(), 0.0);
+
+        Eigen::VectorXd sqrt_lambda = Eigen::VectorXd::Zero(lambda.size());
+        Eigen::VectorXd inv_lambda = Eigen::VectorXd::Zero(lambda.size());
+        for(int i=0; i<lambda.size(); ++i) {
+            if(lambda[i] > eps) {
+                sqrt_lambda[i] = std::sqrt(lambda[i]);
+                inv_lambda[i] = 1.0 / lambda[i];
+            }
+        }
+
+        const Eigen::MatrixXd& V = eig.eigenvectors();
+        const Eigen::MatrixXd L = sqrt_lambda.asDiagonal() * V.transpose();
+        const Eigen::VectorXd mu = V * inv_lambda.asDiagonal() * V.transpose() * m_prior_eta;
+        m_prior.reset(new PriorCost(L, mu));
+    }
+
+    std::shared_ptr<CameraInterface<double>> m_camera;
+    OnlineCalibratorOptions m_options;
+    std::shared_ptr<ReprojectionCostFactory> m_cost_factory;
+
+    // Intrinsics being refined, and the identity extrinsics of the camera
+    Eigen::VectorXd m_params;
+    Sophus::SE3d m_T_ck;
+    ParameterizationSe3 m_ParamSe3;
+
+    std::deque< std::unique_ptr<Frame> > m_frames;
+
+    // Prior 0.5 x^T H x - eta^T x from marginalised frames, and its cost
+    Eigen::MatrixXd m_prior_information;
+    Eigen::VectorXd m_prior_eta;
+    std::unique_ptr<PriorCost> m_prior;
+    size_t m_num_marginalized;
+
+    std::chrono::steady_clock::time_point m_last_publish;
+    std::function<void(const Eigen::VectorXd&)> m_publish_callback;
+    size_t m_num_published;
+
+    double m_mse;
+};
+
+}
@@ -0,0 +1,608 @@
+/*
+   This file is part of the Calibu Project.
+   https://github.com/arpg/Calibu
+
+   Copyright (C) 2013 George Washington University,
+                      Steven Lovegrove,
+                      Gabe Sibley
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+   http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+#include <calibu/Platform.h>
+#include <calibu/pcalib/pcalib.h>
+#include <calibu/pcalib/vignetting_dense.h>
+#include <calibu/calib/PhotometricCost.h>
+
+#include <ceres/ceres.h>
+
+namespace calibu {
+
+/// Options controlling how PhotoCalibrator samples images and solves for
+/// its parameters.
+struct PhotoCalibratorOptions
+{
+    PhotoCalibratorOptions()
+        : num_threads(4),
+          linear_solver_type(ceres::DENSE_SCHUR),
+          max_num_iterations(50),
+          max_samples(2000),
+          max_gradient(0.01),
+          min_intensity(0.02),
+          max_intensity(0.98),
+          min_observations(3),
+          loss_scale(0.01),
+          fix_exposures(true)
+    {
+    }
+
+    /// Threads used to evaluate costs and Jacobians.
+    int num_threads;
+
+    /// Linear solver used on each iteration. With a Schur type solver the
+    /// irradiance of every scene point is eliminated, leaving the response,
+    /// vignetting and exposures in the reduced system. That system is small,
+    /// so DENSE_SCHUR suits most problems.
+    ceres::LinearSolverType linear_solver_type;
+
+    /// Iterations per solve.
+    int max_num_iterations;
+
+    /// Number of pixels sampled from each batch of images. Images are divided
+    /// into as many cells, and the smoothest pixel of each cell is used.
+    int max_samples;
+
+    /// Largest intensity gradient of a sampled pixel, as a fraction of the
+    /// response range. Pixels on edges are sensitive to blur and to small
+    /// motion between images, so are left out.
+    double max_gradient;
+
+    /// Intensities outside [min_intensity, max_intensity], as fractions of
+    /// the response range, are treated as under or over-exposed and ignored.
+    double min_intensity;
+    double max_intensity;
+
+    /// Fewest well exposed observations of a sampled pixel.
+    int min_observations;
+
+    /// Scale of the Huber loss on each observation, as a fraction of the
+    /// response range.
+    double loss_scale;
+
+    /// Hold the exposures given with the images constant. Otherwise only the
+    /// first exposure of each batch is held, fixing the scale of the others.
+    bool fix_exposures;
+};
+
+/// Estimates the inverse-response and vignetting of cameras from images of
+/// static scenes taken at varying exposures. An observation of pixel x in
+/// an image of exposure t is modelled as
+///   R^-1(I(x)) = t V(x) B(x)
+/// where the irradiance B(x) of each sampled pixel is unknown and estimated
+/// alongside the models. The response is scaled to map the top of its range
+/// to itself, and the vignetting to be one at the image center. With a
+/// static camera, attenuation and irradiance are only told apart in flat
+/// field images, see AddImages.
+CALIBU_EXPORT
+class PhotoCalibrator
+{
+public:
+
+    /// Construct empty calibration object.
+    PhotoCalibrator(const PhotoCalibratorOptions& options = PhotoCalibratorOptions()) :
+        m_options(options),
+        m_termination_type(ceres::NO_CONVERGENCE),
+        m_mse(0)
+    {
+        m_prob_options.loss_function_ownership = ceres::DO_NOT_TAKE_OWNERSHIP;
+    }
+
+    /// Clear all cameras and images.
+    void Clear()
+    {
+        m_cameras.clear();
+        m_exposures.clear();
+        m_reference.clear();
+        m_irradiance.clear();
+        m_samples.clear();
+        m_observations.clear();
+        m_termination_type = ceres::NO_CONVERGENCE;
+        m_mse = 0;
+    }
+
+    /// Add camera to calibrate, whose first response and vignetting models
+    /// are estimated in place, starting from their current parameters. The
+    /// returned ID should be used when adding images from this camera.
+    /// Dense vignetting is estimated through a grid model, then resampled.
+    int AddCamera(const std::shared_ptr<PhotoCamerad>& camera)
+    {
+        if(camera->responses.empty() || camera->vignettings.empty()) {
+            throw std::runtime_error("Camera needs response and vignetting models.");
+        }
+
+        std::unique_ptr<CameraState> state(new CameraState);
+        state->camera = camera;
+        state->response = camera->responses[0];
+        state->vignetting = camera->vignettings[0];
+
+        if(const DenseVignetting<double>* dense =
+           dynamic_cast<const DenseVignetting<double>*>(state->vignetting.get())) {
+            std::shared_ptr<GridVignetting<double>> grid =
+                    std::make_shared<GridVignetting<double>>(dense->Width(), dense->Height());
+            grid->SetParams(SampleGrid(*dense, *grid));
+            state->vignetting = grid;
+        }
+
+        state->response_linearizer =
+                PhotoCalibratorResponseModels::NewLinearizer(state->response.get());
+        state->vignetting_linearizer =
+                PhotoCalibratorVignettingModels::NewLinearizer(state->vignetting.get());
+
+        if(!state->response_linearizer || !state->vignetting_linearizer) {
+            throw std::runtime_error("Don't know how to optimize photometric models.");
+        }
+
+        const int id = m_cameras.size();
+        m_cameras.push_back(std::move(state));
+        return id;
+    }
+
+    /// Add a batch of images of one static scene, taken by 'camera' with the
+    /// given exposures. Images are single channel, row major and of the size
+    /// of the camera's vignetting model. Pixels are sampled sparsely, by
+    /// gradient and saturation, and only the samples are kept. Set flat_field
+    /// if every pixel sees the same irradiance, as when imaging a uniformly
+    /// lit diffuser; the vignetting is otherwise absorbed by the irradiance
+    /// of each pixel. Returns the ID of the first image, the others
+    /// following in order.
+    template<typename T>
+    int AddImages(size_t camera, const std::vector<const T*>& images,
+                  const std::vector<double>& exposures, bool flat_field = false)
+    {
+        if( NumCameras() <= camera ) { throw std::runtime_error("Bad camera index. Add all cameras first."); }
+        if( images.size() != exposures.size() ) { throw std::runtime_error("Mismatched exposure count."); }
+
+        const CameraState& state = *m_cameras[camera];
+        const int w = state.vignetting->Width();
+        const int h = state.vignetting->Height();
+        const Eigen::Vector2d range = state.response->GetRange();
+        const double span = range[1] - range[0];
+        const double min_intensity = range[0] + m_options.min_intensity * span;
+        const double max_intensity = range[0] + m_options.max_intensity * span;
+        const double max_gradient = m_options.max_gradient * span;
+
+        const int first_image = m_exposures.size();
+        for(size_t k=0; k < exposures.size(); ++k) {
+            m_exposures.push_back(exposures[k]);
+            m_reference.push_back(k == 0);
+        }
+
+        const size_t flat_point = m_irradiance.size();
+        if(flat_field) {
+            m_irradiance.push_back(0);
+        }
+
+        // Pick the smoothest well exposed pixel of each cell, its gradient
+        // being the largest among the images in which it is well exposed.
+        const int cell = std::max(1, int(std::sqrt(double(w) * h /
+                                                   std::max(1, m_options.max_samples))));
+
+        for(int cy=1; cy < h-1; cy += cell) {
+            for(int cx=1; cx < w-1; cx += cell) {
+                double best_gradient = max_gradient;
+                int best_x = -1, best_y = -1;
+
+                for(int y=cy; y < std::min(cy + cell, h-1); ++y) {
+                    for(int x=cx; x < std::min(cx + cell, w-1); ++x) {
+                        double gradient = 0;
+                        int count = 0;
+                        for(size_t k=0; k < images.size(); ++k) {
+                            const T* p = images[k] + size_t(y) * w + x;
+                            const double value = p[0];
+                            if(value < min_intensity || value > max_intensity) {
+                                continue;
+                            }
+                            const double gx = 0.5 * (double(p[1]) - double(p[-1]));
+                            const double gy = 0.5 * (double(p[w]) - double(p[-w]));
+                            gradient = std::max(gradient, std::abs(gx) + std::abs(gy));
+                            ++count;
+                        }
+                        if(count >= m_options.min_observations &&
+                           gradient <= best_gradient) {
+                            best_gradient = gradient;
+                            best_x = x;
+                            best_y = y;
+                        }
+                    }
+                }
+
+                if(best_x < 0) {
+                    continue;
+                }
+
+                Sample sample;
+                sample.camera = camera;
+                sample.u = best_x + 0.5;
+                sample.v = best_y + 0.5;
+                sample.point = flat_field ? flat_point : m_irradiance.size();
+                if(!flat_field) {
+                    m_irradiance.push_back(0);
+                }
+
+                for(size_t k=0; k < images.size(); ++k) {
+                    const double value = images[k][size_t(best_y) * w + best_x];
+                    if(value >= min_intensity && value <= max_intensity) {
+                        Observation obs;
+                        obs.sample = m_samples.size();
+                        obs.image = first_image + k;
+                        obs.intensity = value;
+                        m_observations.push_back(obs);
+                    }
+                }
+                m_samples.push_back(sample);
+            }
+        }
+        return first_image;
+    }
+
+    /// Set solver options, which take effect from the next solve.
+    void SetOptions(const PhotoCalibratorOptions& options)
+    {
+        m_options = options;
+    }
+
+    /// Return current solver options.
+    PhotoCalibratorOptions Options() const
+    {
+        return m_options;
+    }
+
+    /// Return number of cameras being calibrated
+    size_t NumCameras() const
+    {
+        return m_cameras.size();
+    }
+
+    /// Return number of images added, over all cameras
+    size_t NumImages() const
+    {
+        return m_exposures.size();
+    }
+
+    /// Return number of pixels sampled, over all images
+    size_t NumSamples() const
+    {
+        return m_samples.size();
+    }
+
+    /// Return number of well exposed observations of the sampled pixels
+    size_t NumObservations() const
+    {
+        return m_observations.size();
+    }
+
+    /// Return exposure of image i, as estimated by the last solve
+    double GetExposure(size_t i) const
+    {
+        return m_exposures[i];
+    }
+
+    /// Return current Mean Square photometric Error - the objective function
+    /// minimised by Solve.
+    double MeanSquareError() const
+    {
+        return m_mse;
+    }
+
+    /// Return true if one of the tolerance criteria was reached.
+    bool ReachedTolerance() const
+    {
+        return m_termination_type == ceres::CONVERGENCE;
+    }
+
+    /// Estimate irradiance, exposures and the models of every camera from
+    /// the images added so far, and update the models. Returns false if the
+    /// solver failed to find a usable solution, leaving the models unchanged.
+    /// The solver's summary is written to 'summary' if given.
+    bool Solve(ceres::Solver::Summary* summary = nullptr)
+    {
+        if(m_observations.empty()) {
+            return false;
+        }
+
+        // Copy parameters to be optimised in place.
+        for(std::unique_ptr<CameraState>& state : m_cameras) {
+            state->response_params = state->response->GetParams();
+            state->vignetting_params = state->vignetting->GetParams();
+        }
+
+        std::vector<PhotoLinearForm> attenuation(m_samples.size());
+        for(size_t s=0; s < m_samples.size(); ++s) {
+            const CameraState& state = *m_cameras[m_samples[s].camera];
+            state.vignetting_linearizer->Linearize(state.vignetting_params.data(),
+                    m_samples[s].u, m_samples[s].v, attenuation[s]);
+        }
+
+        std::vector<PhotoLinearForm> response(m_observations.size());
+        for(size_t o=0; o < m_observations.size(); ++o) {
+            const CameraState& state = *m_cameras[m_samples[m_observations[o].sample].camera];
+            state.response_linearizer->Linearize(state.response_params.data(),
+                    state.response_params.size(), m_observations[o].intensity, response[o]);
+        }
+
+        InitializeIrradiance(attenuation, response);
+
+        // Add observations, robustified in units of each camera's range.
+        std::vector<std::unique_ptr<ceres::LossFunction>> losses;
+        for(const std::unique_ptr<CameraState>& state : m_cameras) {
+            const Eigen::Vector2d range = state->response->GetRange();
+            losses.emplace_back(new ceres::HuberLoss(m_options.loss_scale * (range[1] - range[0])));
+        }
+
+        ceres::Problem problem(m_prob_options);
+
+        for(size_t o=0; o < m_observations.size(); ++o) {
+            const Observation& obs = m_observations[o];
+            Sample& sample = m_samples[obs.sample];
+            CameraState& state = *m_cameras[sample.camera];
+            const int num_response_params = state.response_params.size();
+
+            std::vector<double*> params;
+            if(num_response_params > 0) {
+                params.push_back(state.response_params.data());
+            }
+            params.push_back(&m_exposures[obs.image]);
+            params.push_back(&m_irradiance[sample.point]);
+            for(int i : attenuation[obs.sample].indices) {
+                params.push_back(&state.vignetting_params[i]);
+            }
+
+            problem.AddResidualBlock(
+                    new PhotometricCostFunction(num_response_params, response[o],
+                                                attenuation[obs.sample]),
+                    losses[sample.camera].get(), params);
+
+            if(m_options.fix_exposures || m_reference[obs.image]) {
+                problem.SetParameterBlockConstant(&m_exposures[obs.image]);
+            }
+        }
+
+        AddPriors(problem);
+
+        ceres::Solver::Options options = SolverOptions(problem);
+        ceres::Solver::Summary local_summary;
+        if(!summary) {
+            summary = &local_summary;
+        }
+        ceres::Solve(options, &problem, summary);
+
+        m_termination_type = summary->termination_type;
+        m_mse = summary->final_cost / summary->num_residuals;
+
+        if(!summary->IsSolutionUsable()) {
+            return false;
+        }
+
+        for(std::unique_ptr<CameraState>& state : m_cameras) {
+            UpdateModels(*state);
+        }
+        return true;
+    }
+
+    /// Return photometric rig of the cameras added, holding their models as
+    /// updated by the last solve, in the order the cameras were added.
+    std::shared_ptr<PhotoRigd> GetPhotoRig() const
+    {
+        std::shared_ptr<PhotoRigd> rig = std::make_shared<PhotoRigd>();
+        for(const std::unique_ptr<CameraState>& state : m_cameras) {
+            rig->cameras.push_back(state->camera);
+        }
+        return rig;
+    }
+
+protected:
+
+    struct CameraState
+    {
+        std::shared_ptr<PhotoCamerad> camera;
+
+        /// Models being estimated, the vignetting possibly standing in for
+        /// the camera's own.
+        std::shared_ptr<Response<double>> response;
+        std::shared_ptr<Vignetting<double>> vignetting;
+
+        std::shared_ptr<PhotoResponseLinearizer> response_linearizer;
+        std::shared_ptr<PhotoVignettingLinearizer> vignetting_linearizer;
+
+        /// Parameters optimised in place by Solve. Each vignetting parameter
+        /// is a parameter block of its own, as an attenuation only depends on
+        /// a few parameters of a grid model.
+        Eigen::VectorXd response_params;
+        Eigen::VectorXd vignetting_params;
+    };
+
+    struct Sample
+    {
+        size_t camera;
+        double u, v;
+
+        /// Index of the scene point's irradiance, shared by all samples of
+        /// a flat field.
+        size_t point;
+    };
+
+    struct Observation
+    {
+        size_t sample;
+        size_t image;
+        double intensity;
+    };
+
+    /// Return parameters of grid sampling dense vignetting at its nodes.
+    static Eigen::VectorXd SampleGrid(const Vignetting<double>& dense,
+                                      const GridVignetting<double>& grid)
+    {
+        const int gw = grid.GridWidth();
+        const int gh = grid.GridHeight();
+        Eigen::VectorXd params(gw * gh);
+        for(int j=0; j < gh; ++j) {
+            for(int i=0; i < gw; ++i) {
+                params[j * gw + i] = dense(double(i) * grid.Width() / (gw - 1),
+                                           double(j) * grid.Height() / (gh - 1));
+            }
+        }
+        return params;
+    }
+
+    /// Set the irradiance of each scene point to its least squares estimate
+    /// given the current models and exposures.
+    void InitializeIrradiance(const std::vector<PhotoLinearForm>& attenuation,
+                              const std::vector<PhotoLinearForm>& response)
+    {
+        std::vector<double> num(m_irradiance.size(), 0.0);
+        std::vector<double> den(m_irradiance.size(), 0.0);
+
+        for(size_t o=0; o < m_observations.size(); ++o) {
+            const Observation& obs = m_observations[o];
+            const CameraState& state = *m_cameras[m_samples[obs.sample].camera];
+            const double R = response[o].Evaluate(state.response_params.data());
+            const double tV = m_exposures[obs.image] *
+                    attenuation[obs.sample].Evaluate(state.vignetting_params.data());
+            const size_t point = m_samples[obs.sample].point;
+            num[point] += tV * R;
+            den[point] += tV * tV;
+        }
+
+        for(size_t p=0; p < m_irradiance.size(); ++p) {
+            m_irradiance[p] = den[p] > 0 ? num[p] / den[p] : 0.0;
+        }
+    }
+
+    /// Fix the scale of each camera's models: the response and irradiance
+    /// may otherwise scale together, as may the vignetting and irradiance.
+    void AddPriors(ceres::Problem& problem)
+    {
+        for(const std::unique_ptr<CameraState>& state : m_cameras) {
+            const Eigen::Vector2d range = state->response->GetRange();
+            PhotoLinearForm form;
+
+            if(state->response_params.size() > 0) {
+                state->response_linearizer->Linearize(state->response_params.data(),
+                        state->response_params.size(), range[1], form);
+                problem.AddResidualBlock(
+                        new PhotoPriorCostFunction(state->response_params.size(),
+                                                   form, range[1], 1.0),
+                        nullptr, state->response_params.data());
+            }
+
+            // Polynomial models are one at the center by construction
+            state->vignetting_linearizer->Linearize(state->vignetting_params.data(),
+                    0.5 * state->vignetting->Width(),
+                    0.5 * state->vignetting->Height(), form);
+
+            std::vector<double*> params;
+            for(int i : form.indices) {
+                params.push_back(&state->vignetting_params[i]);
+            }
+            if(!params.empty()) {
+                problem.AddResidualBlock(
+                        new PhotoPriorCostFunction(0, form, 1.0, range[1] - range[0]),
+                        nullptr, params);
+            }
+        }
+    }
+
+    /// Return ceres options for solving problem.
+    ceres::Solver::Options SolverOptions(ceres::Problem& problem)
+    {
+        ceres::Solver::Options options;
+        options.num_threads = m_options.num_threads;
+        options.linear_solver_type = m_options.linear_solver_type;
+        options.max_num_iterations = m_options.max_num_iterations;
+
+        if(ceres::IsSchurType(m_options.linear_solver_type)) {
+            // Scene points only share parameters through the models and
+            // exposures, so their irradiance forms an independent set.
+            ceres::ParameterBlockOrdering* ordering = new ceres::ParameterBlockOrdering;
+            for(double& irradiance : m_irradiance) {
+                if(problem.HasParameterBlock(&irradiance)) {
+                    ordering->AddElementToGroup(&irradiance, 0);
+                }
+            }
+            for(double& exposure : m_exposures) {
+                if(problem.HasParameterBlock(&exposure)) {
+                    ordering->AddElementToGroup(&exposure, 1);
+                }
+            }
+            for(std::unique_ptr<CameraState>& state : m_cameras) {
+                if(state->response_params.size() > 0 &&
+                   problem.HasParameterBlock(state->response_params.data())) {
+                    ordering->AddElementToGroup(state->response_params.data(), 1);
+                }
+                for(int i=0; i < state->vignetting_params.size(); ++i) {
+                    if(problem.HasParameterBlock(&state->vignetting_params[i])) {
+                        ordering->AddElementToGroup(&state->vignetting_params[i], 1);
+                    }
+                }
+            }
+            options.linear_solver_ordering.reset(ordering);
+        }
+        return options;
+    }
+
+    /// Write the optimised parameters back to the camera's models.
+    void UpdateModels(CameraState& state)
+    {
+        if(state.response_params.size() > 0) {
+            state.response->SetParams(state.response_params);
+        }
+
+        if(state.vignetting_params.size() > 0) {
+            state.vignetting->SetParams(state.vignetting_params);
+
+            const std::shared_ptr<Vignetting<double>>& own = state.camera->vignettings[0];
+            if(own != state.vignetting) {
+                const std::shared_ptr<const std::vector<float>> image =
+                        state.vignetting->GetAttenuationImage();
+                own->SetParams(Eigen::Map<const Eigen::VectorXf>(
+                        image->data(), image->size()).cast<double>());
+            }
+        }
+    }
+
+    PhotoCalibratorOptions m_options;
+    ceres::Problem::Options m_prob_options;
+    ceres::TerminationType m_termination_type;
+    double m_mse;
+
+    std::vector< std::unique_ptr<CameraState> > m_cameras;
+
+    /// Exposure of each image, and whether it is the first of its batch
+    std::vector<double> m_exposures;
+    std::vector<bool> m_reference;
+
+    /// Irradiance of each scene point, and the samples observing them
+    std::vector<double> m_irradiance;
+    std::vector<Sample> m_samples;
+    std::vector<Observation> m_observations;
+};
+
+}
@@ -0,0 +1,394 @@
+/*
+   This file is part of the Calibu Project.
+   https://github.com/arpg/Calibu
+
+   Copyright (C) 2013 George Washington University,
+                      Steven Lovegrove,
+                      Gabe Sibley
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+   http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+#include <Eigen/Eigen>
+
+#include <ceres/ceres.h>
+
+#include <calibu/pcalib/response_linear.h>
+#include <calibu/pcalib/response_poly.h>
+#include <calibu/pcalib/vignetting_grid.h>
+#include <calibu/pcalib/vignetting_poly.h>
+#include <calibu/pcalib/vignetting_uniform.h>
+
+namespace calibu
+{
+
+/// Output of a photometric model as an affine function of its parameters,
+/// constant + sum of weights[i] * params[indices[i]]. Calibu's response and
+/// vignetting models are all linear in their parameters, so the form of a
+/// given intensity or image position holds wherever the parameters move.
+struct PhotoLinearForm
+{
+    PhotoLinearForm() : constant(0) {}
+
+    double Evaluate(const double* params) const
+    {
+        double result = constant;
+        for(size_t i=0; i < indices.size(); ++i) {
+            result += weights[i] * params[indices[i]];
+        }
+        return result;
+    }
+
+    double constant;
+
+    /// Parameters with a non-zero weight, in increasing order.
+    std::vector<int> indices;
+    std::vector<double> weights;
+};
+
+/// Jet used to differentiate photometric models, a few parameters at a time.
+typedef ceres::Jet<double,4> PhotoJet;
+
+/// Find the linear form of f at params by automatic differentiation,
+/// perturbing a few parameters at a time so large models stay cheap.
+template<typename Func>
+inline void LinearizePhotoModel(const double* params, int num_params,
+                                const Func& f, PhotoLinearForm& form)
+{
+    static const int kStride = 4;
+    typedef PhotoJet JetT;
+
+    std::vector<JetT> x(num_params);
+    for(int i=0; i < num_params; ++i) {
+        x[i] = JetT(params[i]);
+    }
+
+    form.indices.clear();
+    form.weights.clear();
+    double value = f(x.data()).a;
+
+    for(int i0=0; i0 < num_params; i0 += kStride) {
+        const int n = std::min(kStride, num_params - i0);
+        for(int k=0; k < n; ++k) {
+            x[i0+k].v[k] = 1;
+        }
+        const JetT y = f(x.data());
+        for(int k=0; k < n; ++k) {
+            if(y.v[k] != 0) {
+                form.indices.push_back(i0+k);
+                form.weights.push_back(y.v[k]);
+            }
+            x[i0+k].v[k] = 0;
+        }
+    }
+
+    form.constant = value;
+    for(size_t i=0; i < form.indices.size(); ++i) {
+        form.constant -= form.weights[i] * params[form.indices[i]];
+    }
+}
+
+/// Computes linear forms of one inverse-response model, see
+/// PhotoResponseModelList.
+class PhotoResponseLinearizer
+{
+public:
+    virtual ~PhotoResponseLinearizer() {}
+
+    /// Linear form of the inverse-response of intensity 'value'.
+    virtual void Linearize(const double* params, int num_params,
+                           double value, PhotoLinearForm& form) const = 0;
+};
+
+template<typename Model>
+class PhotoResponseLinearizerT : public PhotoResponseLinearizer
+{
+public:
+    void Linearize(const double* params, int num_params,
+                   double value, PhotoLinearForm& form) const
+    {
+        LinearizePhotoModel(params, num_params, [value](const PhotoJet* p) {
+            return Model::GetResponse(p, PhotoJet(value));
+        }, form);
+    }
+};
+
+/// Computes linear forms of one vignetting model, see
+/// PhotoVignettingModelList.
+class PhotoVignettingLinearizer
+{
+public:
+    virtual ~PhotoVignettingLinearizer() {}
+
+    /// Linear form of the attenuation at image position (u, v).
+    virtual void Linearize(const double* params, double u, double v,
+                           PhotoLinearForm& form) const = 0;
+};
+
+template<typename Model>
+class PhotoVignettingLinearizerT : public PhotoVignettingLinearizer
+{
+public:
+    PhotoVignettingLinearizerT(const Model& model) : m_model(model)
+    {
+    }
+
+    void Linearize(const double* params, double u, double v,
+                   PhotoLinearForm& form) const
+    {
+        const Model& model = m_model;
+        LinearizePhotoModel(params, model.NumParams(), [&](const PhotoJet* p) {
+            return GetAttenuation(model, p, u, v);
+        }, form);
+    }
+
+protected:
+    template<typename T, typename M>
+    static T GetAttenuation(const M& model, const T* params, double u, double v)
+    {
+        return M::GetAttenuation(params, u, v, model.Width(), model.Height());
+    }
+
+    template<typename T>
+    static T GetAttenuation(const GridVignetting<double>& model,
+                            const T* params, double u, double v)
+    {
+        return GridVignetting<double>::GetAttenuation(params, u, v,
+                model.Width(), model.Height(), model.GridWidth(),
+                model.GridHeight(), model.Interpolation());
+    }
+
+    const Model& m_model;
+};
+
+/// Compile time list of response models, used to find the linearizer for a
+/// response from its runtime type, as CameraModelList does for cameras.
+template<typename... Models>
+struct PhotoResponseModelList;
+
+template<>
+struct PhotoResponseModelList<>
+{
+    static std::shared_ptr<PhotoResponseLinearizer> NewLinearizer(
+            const Response<double>* /*response*/)
+    {
+        return nullptr;
+    }
+};
+
+template<typename Model, typename... Models>
+struct PhotoResponseModelList<Model, Models...>
+{
+    /// Return linearizer for the response's model, or nullptr if it isn't
+    /// listed.
+    static std::shared_ptr<PhotoResponseLinearizer> NewLinearizer(
+            const Response<double>* response)
+    {
+        if( dynamic_cast<const Model*>(response) ) {
+            return std::make_shared<PhotoResponseLinearizerT<Model> >();
+        }
+        return PhotoResponseModelList<Models...>::NewLinearizer(response);
+    }
+};
+
+/// Compile time list of vignetting models, as PhotoResponseModelList. The
+/// linearizer refers to the model, which must outlive it.
+template<typename... Models>
+struct PhotoVignettingModelList;
+
+template<>
+struct PhotoVignettingModelList<>
+{
+    static std::shared_ptr<PhotoVignettingLinearizer> NewLinearizer(
+            const Vignetting<double>* /*vignetting*/)
+    {
+        return nullptr;
+    }
+};
+
+template<typename Model, typename... Models>
+struct PhotoVignettingModelList<Model, Models...>
+{
+    /// Return linearizer for the vignetting's model, or nullptr if it isn't
+    /// listed.
+    static std::shared_ptr<PhotoVignettingLinearizer> NewLinearizer(
+            const Vignetting<double>* vignetting)
+    {
+        if( const Model* model = dynamic_cast<const Model*>(vignetting) ) {
+            return std::make_shared<PhotoVignettingLinearizerT<Model> >(*model);
+        }
+        return PhotoVignettingModelList<Models...>::NewLinearizer(vignetting);
+    }
+};
+
+/// Response models PhotoCalibrator can optimize.
+typedef PhotoResponseModelList<
+        LinearResponse<double>, Poly3Response<double>,
+        Poly4Response<double> > PhotoCalibratorResponseModels;
+
+/// Vignetting models PhotoCalibrator can optimize directly. Dense vignetting
+/// has a parameter per pixel, so is estimated through a grid model instead.
+typedef PhotoVignettingModelList<
+        UniformVignetting<double>, EvenPoly6Vignetting<double>,
+        GridVignetting<double> > PhotoCalibratorVignettingModels;
+
+/// Photometric error of one observation of a static scene point: the
+/// inverse-response of the observed intensity less the exposure times the
+/// attenuation times the point's irradiance,
+///   r = R^-1(I) - t V(u,v) B
+/// Parameter blocks are the response parameters, if there are any, the
+/// image exposure t, the irradiance B and then one block of size one for
+/// each vignetting parameter the attenuation at (u,v) depends upon.
+class PhotometricCostFunction : public ceres::CostFunction
+{
+public:
+    PhotometricCostFunction(int num_response_params,
+                            const PhotoLinearForm& response,
+                            const PhotoLinearForm& attenuation)
+        : m_num_response_params(num_response_params),
+          m_response(response), m_attenuation(attenuation)
+    {
+        set_num_residuals(1);
+        if(m_num_response_params > 0) {
+            mutable_parameter_block_sizes()->push_back(m_num_response_params);
+        }
+        mutable_parameter_block_sizes()->push_back(1);
+        mutable_parameter_block_sizes()->push_back(1);
+        for(size_t i=0; i < m_attenuation.indices.size(); ++i) {
+            mutable_parameter_block_sizes()->push_back(1);
+        }
+    }
+
+    bool Evaluate(double const* const* parameters, double* residuals,
+                  double** jacobians) const
+    {
+        int b = 0;
+        const double* response = nullptr;
+        if(m_num_response_params > 0) {
+            response = parameters[b++];
+        }
+        const double t = parameters[b++][0];
+        const double B = parameters[b++][0];
+
+        const double irradiance = response ? m_response.Evaluate(response)
+                                           : m_response.constant;
+        double V = m_attenuation.constant;
+        for(size_t i=0; i < m_attenuation.weights.size(); ++i) {
+            V += m_attenuation.weights[i] * parameters[b+i][0];
+        }
+
+        residuals[0] = irradiance - t * V * B;
+
+        if(!jacobians) {
+            return true;
+        }
+
+        b = 0;
+        if(response) {
+            if(jacobians[b]) {
+                std::fill(jacobians[b], jacobians[b] + m_num_response_params, 0.0);
+                for(size_t i=0; i < m_response.indices.size(); ++i) {
+                    jacobians[b][m_response.indices[i]] = m_response.weights[i];
+                }
+            }
+            ++b;
+        }
+        if(jacobians[b]) {
+            jacobians[b][0] = -V * B;
+        }
+        ++b;
+        if(jacobians[b]) {
+            jacobians[b][0] = -t * V;
+        }
+        ++b;
+        for(size_t i=0; i < m_attenuation.weights.size(); ++i) {
+            if(jacobians[b+i]) {
+                jacobians[b+i][0] = -t * B * m_attenuation.weights[i];
+            }
+        }
+        return true;
+    }
+
+protected:
+    int m_num_response_params;
+    PhotoLinearForm m_response;
+    PhotoLinearForm m_attenuation;
+};
+
+/// Weighted deviation of a linear form from a target value, used to pin the
+/// scale of a model that is otherwise only defined up to a factor. The form
+/// is over a single parameter block of the given size, or, with size zero,
+/// over one block of size one per parameter it depends upon.
+class PhotoPriorCostFunction : public ceres::CostFunction
+{
+public:
+    PhotoPriorCostFunction(int block_size, const PhotoLinearForm& form,
+                           double target, double weight)
+        : m_block_size(block_size), m_form(form),
+          m_target(target), m_weight(weight)
+    {
+        set_num_residuals(1);
+        if(m_block_size > 0) {
+            mutable_parameter_block_sizes()->push_back(m_block_size);
+        }else{
+            for(size_t i=0; i < m_form.indices.size(); ++i) {
+                mutable_parameter_block_sizes()->push_back(1);
+            }
+        }
+    }
+
+    bool Evaluate(double const* const* parameters, double* residuals,
+                  double** jacobians) const
+    {
+        double value = m_form.constant;
+        for(size_t i=0; i < m_form.weights.size(); ++i) {
+            value += m_form.weights[i] * (m_block_size > 0 ?
+                    parameters[0][m_form.indices[i]] : parameters[i][0]);
+        }
+        residuals[0] = m_weight * (value - m_target);
+
+        if(!jacobians) {
+            return true;
+        }
+
+        if(m_block_size > 0) {
+            if(jacobians[0]) {
+                std::fill(jacobians[0], jacobians[0] + m_block_size, 0.0);
+                for(size_t i=0; i < m_form.indices.size(); ++i) {
+                    jacobians[0][m_form.indices[i]] = m_weight * m_form.weights[i];
+                }
+            }
+        }else{
+            for(size_t i=0; i < m_form.weights.size(); ++i) {
+                if(jacobians[i]) {
+                    jacobians[i][0] = m_weight * m_form.weights[i];
+                }
+            }
+        }
+        return true;
+    }
+
+protected:
+    int m_block_size;
+    PhotoLinearForm m_form;
+    double m_target;
+    double m_weight;
+};
+
+}
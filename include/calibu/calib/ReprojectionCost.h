@@ -22,42 +22,75 @@
 
 #include <calibu/calib/CostFunctionAndParams.h>
 #include <calibu/calib/AutoDiffArrayCostFunction.h>
+#include <calibu/calib/ReprojectionCostFunctor.h>
 
 namespace calibu
 {
 
 // Parameter block 0: T_kw // keyframe
 // Parameter block 1: T_ck // keyframe to cam
-// Parameter block 2: fu,fv,u0,v0,w
-template<typename ProjModel>
+// Parameter block 2: camera params
+template<typename CameraModel>
 struct ReprojectionCost
         : public ceres::AutoDiffArrayCostFunction<
-        ceres::CostFunction, ReprojectionCost<ProjModel>,
+        ceres::CostFunction, ReprojectionCost<CameraModel>,
         2,  Sophus::SE3d::num_parameters, Sophus::SE3d::num_parameters,
-        ProjModel::NUM_PARAMS>
+        CameraModel::NumParams>
 {
     EIGEN_MAKE_ALIGNED_OPERATOR_NEW;
     ReprojectionCost(const Eigen::Vector3d& Pw, const Eigen::Vector2d& pc)
-        : m_Pw(Pw), m_pc(pc)
+        : m_functor(Pw, pc)
     {
     }
 
     template<typename T=double>
     bool Evaluate(T const* const* parameters, T* residuals) const
     {
-        Eigen::Map<Eigen::Matrix<T,2,1> > r(residuals);
-        const Eigen::Map<const Sophus::SE3Group<T> > T_kw(parameters[0]);
-        const Eigen::Map<const Sophus::SE3Group<T> > T_ck(parameters[1]);
-        T const* camparam = parameters[2];
-
-        const Eigen::Matrix<T,3,1> Pc = T_ck * (T_kw * m_Pw.cast<T>());
-        const Eigen::Matrix<T,2,1> pc = ProjModel::template Map<T>(Project<T>(Pc), camparam);
-        r = pc - m_pc.cast<T>();
-        return true;
+        return m_functor(parameters[0], parameters[1], parameters[2], residuals);
     }
 
-    Eigen::Vector3d m_Pw;
-    Eigen::Vector2d m_pc;
+    ReprojectionCostFunctor<CameraModel> m_functor;
+};
+
+// All observations of one camera in one keyframe as a single residual block,
+// see ReprojectionsCostFunctor. Every point is differentiated in the same
+// pass, so the Jets of T_ck * T_kw are formed once per block rather than
+// once per point. Parameter blocks are as for ReprojectionCost.
+template<typename CameraModel>
+struct ReprojectionsCost
+        : public ceres::AutoDiffArrayCostFunction<
+        ceres::CostFunction, ReprojectionsCost<CameraModel>,
+        ceres::DYNAMIC,  Sophus::SE3d::num_parameters, Sophus::SE3d::num_parameters,
+        CameraModel::NumParams>
+{
+    typedef ceres::AutoDiffArrayCostFunction<
+        ceres::CostFunction, ReprojectionsCost<CameraModel>,
+        ceres::DYNAMIC,  Sophus::SE3d::num_parameters, Sophus::SE3d::num_parameters,
+        CameraModel::NumParams> Base;
+
+    ReprojectionsCost(
+            const std::vector<Eigen::Vector3d,
+                              Eigen::aligned_allocator<Eigen::Vector3d> >& Pw,
+            const std::vector<Eigen::Vector2d,
+                              Eigen::aligned_allocator<Eigen::Vector2d> >& pc,
+            double loss_scale = 0.0)
+        : Base(2 * Pw.size()), m_functor(Pw, pc, loss_scale)
+    {
+    }
+
+    ReprojectionsCost(const Eigen::Vector3d* Pw, const Eigen::Vector2d* pc,
+                      size_t n, double loss_scale = 0.0)
+        : Base(2 * n), m_functor(Pw, pc, n, loss_scale)
+    {
+    }
+
+    template<typename T=double>
+    bool Evaluate(T const* const* parameters, T* residuals) const
+    {
+        return m_functor(parameters[0], parameters[1], parameters[2], residuals);
+    }
+
+    ReprojectionsCostFunctor<CameraModel> m_functor;
 };
 
 }
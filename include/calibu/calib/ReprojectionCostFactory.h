@@ -0,0 +1,173 @@
+/*
+   This file is part of the Calibu Project.
+   https://github.com/arpg/Calibu
+
+   Copyright (C) 2013 George Washington University,
+                      Steven Lovegrove,
+                      Gabe Sibley
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+   http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include <Eigen/Eigen>
+#include <Eigen/StdVector>
+#include <sophus/se3.hpp>
+
+#include <ceres/ceres.h>
+
+#include <calibu/cam/camera_crtp.h>
+#include <calibu/cam/camera_models_crtp.h>
+#include <calibu/calib/ReprojectionCostFunctor.h>
+#include <calibu/calib/ReprojectionCost.h>
+#include <calibu/calib/AnalyticReprojectionCost.h>
+
+namespace calibu
+{
+
+/// How reprojection costs compute their Jacobians.
+enum CostJacobians
+{
+    /// Automatic differentiation of ReprojectionCostFunctor.
+    COST_JACOBIANS_AUTODIFF,
+    /// Analytic, w.r.t. the ambient pose parameters, for ParameterizationSe3.
+    COST_JACOBIANS_ANALYTIC,
+    /// Analytic, w.r.t. the pose tangent space, for
+    /// TangentParameterizationSe3.
+    COST_JACOBIANS_ANALYTIC_TANGENT
+};
+
+/// Creates reprojection costs for cameras of one model. Calibrator resolves
+/// a factory for each camera when it is added, so that observations need no
+/// knowledge of the camera model.
+class ReprojectionCostFactory
+{
+public:
+    virtual ~ReprojectionCostFactory() {}
+
+    /// Create cost for a single observation.
+    virtual ceres::CostFunction* NewCost(
+            const Eigen::Vector3d& P_w, const Eigen::Vector2d& p_c,
+            CostJacobians jacobians) const = 0;
+
+    /// Create a single multi-residual cost for a set of observations, each
+    /// robustified with a soft L1 loss of the given scale.
+    virtual ceres::CostFunction* NewCosts(
+            const std::vector<Eigen::Vector3d,
+                              Eigen::aligned_allocator<Eigen::Vector3d> >& P_w,
+            const std::vector<Eigen::Vector2d,
+                              Eigen::aligned_allocator<Eigen::Vector2d> >& p_c,
+            double loss_scale, CostJacobians jacobians) const = 0;
+
+    /// As NewCosts, but for the n observations P_w[i] / p_c[i], which the
+    /// cost may refer to in place. They must stay where they are for the
+    /// life of the cost. By default they are copied.
+    virtual ceres::CostFunction* NewCosts(
+            const Eigen::Vector3d* P_w, const Eigen::Vector2d* p_c, size_t n,
+            double loss_scale, CostJacobians jacobians) const
+    {
+        return NewCosts(
+                    std::vector<Eigen::Vector3d,
+                                Eigen::aligned_allocator<Eigen::Vector3d> >(P_w, P_w + n),
+                    std::vector<Eigen::Vector2d,
+                                Eigen::aligned_allocator<Eigen::Vector2d> >(p_c, p_c + n),
+                    loss_scale, jacobians);
+    }
+};
+
+/// Reprojection cost factory for the CRTP camera model CameraModel.
+template<typename CameraModel>
+class ReprojectionCostFactoryT : public ReprojectionCostFactory
+{
+public:
+    ceres::CostFunction* NewCost(
+            const Eigen::Vector3d& P_w, const Eigen::Vector2d& p_c,
+            CostJacobians jacobians) const
+    {
+        if(jacobians != COST_JACOBIANS_AUTODIFF) {
+            return new ReprojectionCostFunction<CameraModel>(
+                        P_w, p_c, jacobians == COST_JACOBIANS_ANALYTIC_TANGENT);
+        }
+        return new ceres::AutoDiffCostFunction<ReprojectionCostFunctor<CameraModel>,
+                2, Sophus::SE3d::num_parameters, Sophus::SE3d::num_parameters,
+                CameraModel::NumParams>( new ReprojectionCostFunctor<CameraModel>(P_w, p_c) );
+    }
+
+    ceres::CostFunction* NewCosts(
+            const std::vector<Eigen::Vector3d,
+                              Eigen::aligned_allocator<Eigen::Vector3d> >& P_w,
+            const std::vector<Eigen::Vector2d,
+                              Eigen::aligned_allocator<Eigen::Vector2d> >& p_c,
+            double loss_scale, CostJacobians jacobians) const
+    {
+        if(jacobians != COST_JACOBIANS_AUTODIFF) {
+            return new ReprojectionsCostFunction<CameraModel>(
+                        P_w, p_c, loss_scale,
+                        jacobians == COST_JACOBIANS_ANALYTIC_TANGENT);
+        }
+        return new ReprojectionsCost<CameraModel>(P_w, p_c, loss_scale);
+    }
+
+    ceres::CostFunction* NewCosts(
+            const Eigen::Vector3d* P_w, const Eigen::Vector2d* p_c, size_t n,
+            double loss_scale, CostJacobians jacobians) const
+    {
+        if(jacobians != COST_JACOBIANS_AUTODIFF) {
+            return new ReprojectionsCostFunction<CameraModel>(
+                        P_w, p_c, n, loss_scale,
+                        jacobians == COST_JACOBIANS_ANALYTIC_TANGENT);
+        }
+        return new ReprojectionsCost<CameraModel>(P_w, p_c, n, loss_scale);
+    }
+};
+
+/// Compile time list of camera models, used to find the cost factory for a
+/// camera from its runtime type.
+template<typename... Models>
+struct CameraModelList;
+
+template<>
+struct CameraModelList<>
+{
+    static std::shared_ptr<ReprojectionCostFactory> NewCostFactory(
+            const CameraInterface<double>* /*camera*/)
+    {
+        return nullptr;
+    }
+};
+
+template<typename Model, typename... Models>
+struct CameraModelList<Model, Models...>
+{
+    /// Return factory for camera's model, or nullptr if it isn't listed.
+    static std::shared_ptr<ReprojectionCostFactory> NewCostFactory(
+            const CameraInterface<double>* camera)
+    {
+        if( dynamic_cast<const Model*>(camera) ) {
+            return std::make_shared<ReprojectionCostFactoryT<Model> >();
+        }
+        return CameraModelList<Models...>::NewCostFactory(camera);
+    }
+};
+
+/// Camera models Calibrator can optimize without a user supplied factory.
+typedef CameraModelList<
+        LinearCamera<double>, FovCamera<double>, Poly2Camera<double>,
+        Poly3Camera<double>, KannalaBrandtCamera<double>,
+        Rational6Camera<double> > CalibratorCameraModels;
+
+}
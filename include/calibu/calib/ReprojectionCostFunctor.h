@@ -20,7 +20,10 @@
 
 #pragma once
 
+#include <vector>
+
 #include <Eigen/Eigen>
+#include <Eigen/StdVector>
 #include <sophus/se3.hpp>
 
 #include <calibu/cam/camera_crtp.h>
@@ -62,4 +65,83 @@ struct ReprojectionCostFunctor
     Eigen::Vector2d m_pc;
 };
 
+// Reprojection error of all target points seen by one camera in one
+// keyframe, stacked into a single residual block of size 2 * Pw.size().
+// A loss function attached to the block would apply to the summed error,
+// so each point is instead robustified here with a soft L1 loss of the given
+// scale: residuals are weighted such that their squared norm equals
+// rho(s) = 2 a^2 (sqrt(1 + s / a^2) - 1). A scale <= 0 disables the loss.
+// Parameter blocks are as for ReprojectionCostFunctor.
+template<typename CameraInt>
+struct ReprojectionsCostFunctor
+{
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW;
+    ReprojectionsCostFunctor(
+            const std::vector<Eigen::Vector3d,
+                              Eigen::aligned_allocator<Eigen::Vector3d> >& Pw,
+            const std::vector<Eigen::Vector2d,
+                              Eigen::aligned_allocator<Eigen::Vector2d> >& pc,
+            double loss_scale = 0.0)
+        : m_Pw(Pw), m_pc(pc), m_Pw_ref(nullptr), m_pc_ref(nullptr),
+          m_size(Pw.size()),
+          m_inv_loss_scale2(loss_scale > 0 ? 1.0 / (loss_scale * loss_scale) : 0.0)
+    {
+    }
+
+    // Refer to the n points Pw[i] / pc[i] in place rather than copying
+    // them. They must stay where they are for the life of the functor.
+    ReprojectionsCostFunctor(
+            const Eigen::Vector3d* Pw, const Eigen::Vector2d* pc, size_t n,
+            double loss_scale = 0.0)
+        : m_Pw_ref(Pw), m_pc_ref(pc), m_size(n),
+          m_inv_loss_scale2(loss_scale > 0 ? 1.0 / (loss_scale * loss_scale) : 0.0)
+    {
+    }
+
+    size_t size() const
+    {
+        return m_size;
+    }
+
+    template<typename T>
+    bool operator()(
+            const T* const pT_kw, const T* const pT_ck, const T* const camparam,
+            T* residuals
+            ) const
+    {
+        using std::sqrt;
+
+        const Eigen::Map<const Sophus::SE3Group<T> > T_kw(pT_kw);
+        const Eigen::Map<const Sophus::SE3Group<T> > T_ck(pT_ck);
+        const Sophus::SE3Group<T> T_cw = T_ck * T_kw;
+        const Eigen::Vector3d* Pw = m_Pw_ref ? m_Pw_ref : m_Pw.data();
+        const Eigen::Vector2d* pc_obs = m_pc_ref ? m_pc_ref : m_pc.data();
+
+        for(size_t i = 0; i < m_size; ++i) {
+            Eigen::Map<Eigen::Matrix<T,2,1> > r(residuals + 2 * i);
+            const Eigen::Matrix<T,3,1> Pc = T_cw * Pw[i].cast<T>();
+            Eigen::Matrix<T,2,1> pc;
+            CameraInt::Project(Pc.data(), camparam, pc.data());
+            r = pc - pc_obs[i].cast<T>();
+
+            if(m_inv_loss_scale2 > 0) {
+                // sqrt(rho(s) / s), which is smooth at s = 0
+                const T x = r.squaredNorm() * T(m_inv_loss_scale2);
+                r *= sqrt(T(2) / (sqrt(T(1) + x) + T(1)));
+            }
+        }
+        return true;
+    }
+
+    std::vector<Eigen::Vector3d, Eigen::aligned_allocator<Eigen::Vector3d> > m_Pw;
+    std::vector<Eigen::Vector2d, Eigen::aligned_allocator<Eigen::Vector2d> > m_pc;
+
+    // Points referred to in place, used instead of m_Pw / m_pc if set
+    const Eigen::Vector3d* m_Pw_ref;
+    const Eigen::Vector2d* m_pc_ref;
+    size_t m_size;
+
+    double m_inv_loss_scale2;
+};
+
 }
@@ -0,0 +1,129 @@
+/*
+   This file is part of the Calibu Project.
+   https://github.com/arpg/Calibu
+
+   Copyright (C) 2013 George Washington University,
+                      Steven Lovegrove,
+                      Gabe Sibley
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+   http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include <calibu/Platform.h>
+#include <calibu/cam/camera_crtp.h>
+
+namespace calibu
+{
+
+  ///////////////////////////////////////////////////////////////////////////////
+  /// On-disk layout of a binary rig file: this header followed directly by
+  /// num_cameras RigFileCamera records. As for lookup table files, values
+  /// are stored in the byte order of the machine that wrote the file, and
+  /// the magic, version and record size reject files from an incompatible
+  /// writer. Records are fixed size, so a mapped file is read in place.
+  struct RigFileHeader
+  {
+    char magic[8];         // "CALIBURG"
+    uint32_t version;      // kRigFileVersion
+    uint32_t camera_size;  // sizeof(RigFileCamera)
+    uint32_t num_cameras;
+    uint8_t reserved[44];  // pads the header to 64 bytes
+  };
+
+  static const uint32_t kRigFileVersion = 1;
+
+  /// Most parameters of a camera a rig file can hold.
+  static const int kRigFileMaxParams = 16;
+
+  /// One camera of a rig file. Strings are nul terminated.
+  struct RigFileCamera
+  {
+    char type[48];         // model type, as in camera XML files
+    char name[80];
+    uint64_t serial_no;
+    int32_t version;
+    int32_t index;
+    uint32_t width;
+    uint32_t height;
+    uint32_t num_params;
+    uint32_t reserved0;
+    double params[kRigFileMaxParams];
+    double t_rc[7];        // quaternion x, y, z, w then translation
+    double rdf[9];         // column major
+    uint8_t reserved[96];  // pads the record to 512 bytes
+  };
+
+  /// Write 'rig' to 'filename'. Cameras need a model type (Type()) and at
+  /// most kRigFileMaxParams parameters. The file is written next to its
+  /// destination and renamed into place, so readers never see a partial
+  /// rig.
+  CALIBU_EXPORT bool WriteBinaryRig(
+      const std::string& filename,
+      const std::shared_ptr<Rig<double>>& rig
+      );
+
+  /// Read a rig written by WriteBinaryRig, or nullptr if the file is
+  /// missing, truncated, written by an incompatible version or holds an
+  /// unknown model.
+  CALIBU_EXPORT std::shared_ptr<Rig<double>> ReadBinaryRig(
+      const std::string& filename
+      );
+
+  ///////////////////////////////////////////////////////////////////////////////
+  /// Read-only rig file mapped from disk, for reading single cameras without
+  /// building the whole rig.
+  class CALIBU_EXPORT MappedRig
+  {
+    public:
+      MappedRig();
+      ~MappedRig();
+
+      MappedRig( const MappedRig& ) = delete;
+      MappedRig& operator=( const MappedRig& ) = delete;
+
+      /// Map 'filename'. Returns false if the file is missing, truncated or
+      /// was written by an incompatible version.
+      bool Open( const std::string& filename );
+
+      void Close();
+
+      bool IsOpen() const { return header_ != nullptr; }
+
+      unsigned int NumCams() const { return header_ ? header_->num_cameras : 0; }
+
+      /// Record of camera i, in place in the mapping.
+      const RigFileCamera& CameraRecord( unsigned int i ) const
+      {
+        return cameras_[i];
+      }
+
+      /// Camera i, or nullptr if its model is unknown.
+      std::shared_ptr<CameraInterface<double>> Camera( unsigned int i ) const;
+
+      /// All cameras as a rig, or nullptr if one of the models is unknown.
+      std::shared_ptr<Rig<double>> ToRig() const;
+
+    private:
+      const RigFileHeader* header_;
+      const RigFileCamera* cameras_;
+      void* mapping_;
+      size_t mapping_size_;
+  };
+
+}
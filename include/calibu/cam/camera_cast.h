@@ -0,0 +1,91 @@
+/*
+  This file is part of the Calibu Project.
+  https://github.com/gwu-robotics/Calibu
+
+  Copyright (C) 2013 George Washington University,
+  Steven Lovegrove,
+  Nima Keivan
+  Gabe Sibley
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+  http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+/*
+   Conversion of cameras and rigs between scalar types, e.g. to run
+   projection heavy code on float copies of double calibrations.
+*/
+
+#pragma once
+#include <calibu/cam/camera_models_crtp.h>
+#include <memory>
+
+namespace calibu {
+
+namespace internal {
+template <typename To, template <typename> class Model, typename From>
+bool CastModel(const std::shared_ptr<CameraInterface<From>>& cam,
+               std::shared_ptr<CameraInterface<To>>& out) {
+  if (!std::dynamic_pointer_cast<Model<From>>(cam)) {
+    return false;
+  }
+  out = std::make_shared<Model<To>>();
+  return true;
+}
+}  // namespace internal
+
+/// Camera of the same model and calibration as cam, with scalar type To.
+/// Parameters are stored in double precision for all scalar types and are
+/// copied exactly. Returns nullptr for models other than those of
+/// camera_models_crtp.h.
+template <typename To, typename From>
+std::shared_ptr<CameraInterface<To>> CameraCast(
+    const std::shared_ptr<CameraInterface<From>>& cam) {
+  std::shared_ptr<CameraInterface<To>> out;
+  if (!cam ||
+      !(internal::CastModel<To, FovCamera>(cam, out) ||
+        internal::CastModel<To, LinearCamera>(cam, out) ||
+        internal::CastModel<To, Poly2Camera>(cam, out) ||
+        internal::CastModel<To, Poly3Camera>(cam, out) ||
+        internal::CastModel<To, KannalaBrandtCamera>(cam, out) ||
+        internal::CastModel<To, Rational6Camera>(cam, out))) {
+    return nullptr;
+  }
+
+  out->SetParams(cam->GetParams());
+  out->SetImageDimensions(cam->Width(), cam->Height());
+  out->SetRDF(cam->RDF().template cast<To>());
+  out->SetPose(cam->Pose().template cast<To>());
+  out->SetVersion(cam->Version());
+  out->SetIndex(cam->Index());
+  out->SetSerialNumber(cam->SerialNumber());
+  out->SetName(cam->Name());
+  out->SetType(cam->Type());
+  return out;
+}
+
+/// Rig of CameraCast copies of the cameras of rig, or nullptr if one of them
+/// can't be converted, so that camera indices always match those of rig.
+template <typename To, typename From>
+std::shared_ptr<Rig<To>> RigCast(const std::shared_ptr<Rig<From>>& rig) {
+  std::shared_ptr<Rig<To>> out(new Rig<To>());
+  for (const std::shared_ptr<CameraInterface<From>>& cam : rig->cameras_) {
+    std::shared_ptr<CameraInterface<To>> converted = CameraCast<To>(cam);
+    if (!converted) {
+      return nullptr;
+    }
+    out->AddCamera(converted);
+  }
+  return out;
+}
+
+}  // namespace calibu
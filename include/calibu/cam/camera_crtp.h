@@ -29,6 +29,48 @@
 
 namespace calibu {
 
+template<typename Scalar> class CameraInterface;
+
+/**
+ * Immutable copy of a camera, made by CameraInterface::Snapshot, with the
+ * values of its model that only depend on the parameters computed once.
+ * Nothing modifies it once made, so any number of threads can project
+ * through it without locking while the camera it was made from is being
+ * calibrated. Hand readers new parameters by publishing a new snapshot,
+ * e.g. with std::atomic_store of a shared_ptr, as CalibratorSnapshot does.
+ */
+template<typename Scalar = double>
+class CameraSnapshot {
+ public:
+  typedef Eigen::Matrix<Scalar, 2, 1> Vec2t;
+  typedef Eigen::Matrix<Scalar, 3, 1> Vec3t;
+
+  virtual ~CameraSnapshot() {}
+
+  virtual Vec2t Project(const Vec3t& ray) const = 0;
+
+  virtual Vec3t Unproject(const Vec2t& pix) const = 0;
+
+  virtual Eigen::Matrix<Scalar, 2, 3> dProject_dray(const Vec3t& ray) const = 0;
+
+  /** See CameraInterface::ProjectN. */
+  virtual void ProjectN(const Scalar* x, const Scalar* y, const Scalar* z,
+                        Scalar* u, Scalar* v,
+                        size_t n) const = 0;
+
+  /** See CameraInterface::UnprojectN. */
+  virtual void UnprojectN(const Scalar* u, const Scalar* v,
+                          Scalar* x, Scalar* y, Scalar* z,
+                          size_t n) const = 0;
+
+  /**
+   * The snapshot's own copy of the camera, with its model, parameters,
+   * image size, pose, type and name, for everything else. Only its const
+   * members may be used, which are safe to call from many threads.
+   */
+  virtual const CameraInterface<Scalar>& Camera() const = 0;
+};
+
 /*
   CameraInterface is the top-level mostly pure-virtual interface
   class all cameras must honor.
@@ -40,6 +82,8 @@ protected:
   typedef Eigen::Matrix<Scalar, 2, 1> Vec2t;
   typedef Eigen::Matrix<Scalar, 3, 1> Vec3t;
   typedef Eigen::Matrix<Scalar, Eigen::Dynamic, 1> VecXt;
+  typedef Eigen::Matrix<Scalar, 2, Eigen::Dynamic> Mat2Xt;
+  typedef Eigen::Matrix<Scalar, 3, Eigen::Dynamic> Mat3Xt;
   typedef Sophus::SE3Group<Scalar> SE3t;
 
 public:
@@ -63,15 +107,111 @@ public:
   /** Project a world point into an image location. */
   virtual Vec2t Project(const Vec3t& ray) const = 0;
 
+  /**
+   * Unproject a batch of image locations into world coordinates.
+   *
+   * @param pix 2xN image locations, one per column.
+   * @param rays Output 3xN rays, resized to match pix.
+   */
+  virtual void UnprojectN(const Mat2Xt& pix, Mat3Xt& rays) const = 0;
+
+  /**
+   * Project a batch of world points into image locations.
+   *
+   * @param rays 3xN world points, one per column.
+   * @param pix Output 2xN image locations, resized to match rays.
+   */
+  virtual void ProjectN(const Mat3Xt& rays, Mat2Xt& pix) const = 0;
+
+  /**
+   * Unproject image locations held as separate u/v arrays (struct of
+   * arrays) into separate x/y/z ray arrays. Each array holds n elements.
+   */
+  virtual void UnprojectN(const Scalar* u, const Scalar* v,
+                          Scalar* x, Scalar* y, Scalar* z,
+                          size_t n) const = 0;
+
+  /**
+   * Project world points held as separate x/y/z arrays (struct of
+   * arrays) into separate u/v pixel arrays. Each array holds n elements.
+   */
+  virtual void ProjectN(const Scalar* x, const Scalar* y, const Scalar* z,
+                        Scalar* u, Scalar* v,
+                        size_t n) const = 0;
+
+  /**
+   * Immutable copy of the camera as it is now, for threads reading it while
+   * it is modified. Must not be called while the camera is being modified.
+   */
+  virtual std::shared_ptr<const CameraSnapshot<Scalar>> Snapshot() const = 0;
+
   /** Derivative of the Project along a ray */
   virtual Eigen::Matrix<Scalar, 2, 3>
   dProject_dray(const Vec3t& ray) const = 0;
 
-  virtual Eigen::Matrix<Scalar, 2, Eigen::Dynamic>
-  dProject_dparams(const Vec3t& ray) const = 0;
+  Eigen::Matrix<Scalar, 2, Eigen::Dynamic>
+  dProject_dparams(const Vec3t& ray) const {
+    Eigen::Matrix<Scalar, 2, Eigen::Dynamic> j(2, NumParams());
+    dProject_dparams(ray, j.data());
+    return j;
+  }
+
+  Eigen::Matrix<Scalar, 3, Eigen::Dynamic>
+  dUnproject_dparams(const Vec2t& pix) const {
+    Eigen::Matrix<Scalar, 3, Eigen::Dynamic> j(3, NumParams());
+    dUnproject_dparams(pix, j.data());
+    return j;
+  }
+
+  /**
+   * Derivative of Project w.r.t. the parameters, written to caller
+   * provided storage so that nothing is allocated.
+   *
+   * @param j Output 2 x NumParams() matrix, stored column-major.
+   */
+  virtual void dProject_dparams(const Vec3t& ray, Scalar* j) const = 0;
+
+  /**
+   * Derivative of Unproject w.r.t. the parameters, written to caller
+   * provided storage so that nothing is allocated.
+   *
+   * @param j Output 3 x NumParams() matrix, stored column-major.
+   */
+  virtual void dUnproject_dparams(const Vec2t& pix, Scalar* j) const = 0;
 
-  virtual Eigen::Matrix<Scalar, 3, Eigen::Dynamic>
-  dUnproject_dparams(const Vec2t& pix) const = 0;
+  /**
+   * Project a world point along with the derivatives of its projection,
+   * computed in one pass rather than by separate calls to Project,
+   * dProject_dray and dProject_dparams.
+   *
+   * @param ray World point to project.
+   * @param pix Output image location.
+   * @param j_ray If not null, receives dProject_dray(ray).
+   * @param j_params If not null, receives dProject_dparams(ray), resized
+   *        to 2 x NumParams().
+   */
+  void ProjectWithJacobians(
+      const Vec3t& ray, Vec2t& pix,
+      Eigen::Matrix<Scalar, 2, 3>* j_ray,
+      Eigen::Matrix<Scalar, 2, Eigen::Dynamic>* j_params = nullptr) const {
+    if (j_params) {
+      j_params->resize(2, NumParams());
+    }
+    ProjectWithJacobians(ray, pix, j_ray ? j_ray->data() : nullptr,
+                         j_params ? j_params->data() : nullptr);
+  }
+
+  /**
+   * As ProjectWithJacobians above, writing the Jacobians to caller
+   * provided storage so that nothing is allocated.
+   *
+   * @param j_ray If not null, receives the 2x3 dProject_dray(ray), stored
+   *        column-major.
+   * @param j_params If not null, receives the 2 x NumParams()
+   *        dProject_dparams(ray), stored column-major.
+   */
+  virtual void ProjectWithJacobians(const Vec3t& ray, Vec2t& pix,
+                                    Scalar* j_ray, Scalar* j_params) const = 0;
 
   /**
    * Project a point into a camera located at t_ba.
@@ -108,6 +248,46 @@ public:
     return dtransfer3d_dray;
   }
 
+  /**
+   * Transfer3d of every ray at every inverse depth, e.g. for a plane sweep.
+   * The rays are rotated once, and each depth is one ProjectN call.
+   *
+   * @param rays 3xN rays in frame a, as from UnprojectN.
+   * @param rho D inverse depths.
+   * @param u, v Output D*N image locations in frame b, depth-major: the
+   *        transfer of rays.col(i) at rho[d] is (u[d*N + i], v[d*N + i]).
+   */
+  void Transfer3dN(const SE3t& t_ba,
+                   const Mat3Xt& rays,
+                   const std::vector<Scalar>& rho,
+                   Scalar* u, Scalar* v) const {
+    const size_t n = rays.cols();
+    const Mat3Xt rotated = t_ba.rotationMatrix() * rays;
+    const Vec3t t = t_ba.translation();
+    std::vector<Scalar> xyz(3 * n);
+    Scalar* x = xyz.data();
+    Scalar* y = x + n;
+    Scalar* z = y + n;
+    for (size_t d = 0; d < rho.size(); ++d) {
+      for (size_t i = 0; i < n; ++i) {
+        x[i] = rotated(0, i) + rho[d] * t[0];
+        y[i] = rotated(1, i) + rho[d] * t[1];
+        z[i] = rotated(2, i) + rho[d] * t[2];
+      }
+      ProjectN(x, y, z, u + d * n, v + d * n, n);
+    }
+  }
+
+  /** Transfer3dN of the rays through 2xN image locations pix. */
+  void Transfer3dN(const SE3t& t_ba,
+                   const Mat2Xt& pix,
+                   const std::vector<Scalar>& rho,
+                   Scalar* u, Scalar* v) const {
+    Mat3Xt rays;
+    UnprojectN(pix, rays);
+    Transfer3dN(t_ba, rays, rho, u, v);
+  }
+
   Eigen::Matrix<Scalar, 2, Eigen::Dynamic> dTransfer_dparams(
                   const SE3t& t_ba,
                   const Vec2t& pix,
@@ -117,16 +297,16 @@ public:
     const Eigen::Matrix<Scalar, 3, 3> rot_matrix = t_ba.rotationMatrix();
     const Vec3t ray_dehomogenized =
                     rot_matrix * ray + rho * t_ba.translation();
-    const Eigen::Matrix<Scalar, 2, 3> dproject_dray =
-                    dProject_dray(ray_dehomogenized);
+    Vec2t pix_transfered;
+    Eigen::Matrix<Scalar, 2, 3> dproject_dray;
+    Eigen::Matrix<Scalar, 2, Eigen::Dynamic> d_project_dparams;
+    ProjectWithJacobians(ray_dehomogenized, pix_transfered,
+                         &dproject_dray, &d_project_dparams);
     const Eigen::Matrix<Scalar, 2, 3> dtransfer3d_dray =
                     dproject_dray * rot_matrix;
     const Eigen::Matrix<Scalar, 3, Eigen::Dynamic> dray_dparams =
                     dUnproject_dparams(pix);
 
-    const Eigen::Matrix<Scalar, 2, Eigen::Dynamic> d_project_dparams =
-                    dProject_dparams(ray_dehomogenized);
-
     // This is a total derivative comprised of the derivative of the projection
     // function wrt to the calibration parameters + the derivative of the
     // transferred point wrt the calibration parameters (which is required
@@ -237,8 +417,19 @@ public:
   /// Set generic camera intrinsics and parameters.
   void SetParams( const Eigen::VectorXd params ) {
     params_ = params;
+    ParamsChanged();
   }
 
+  /**
+   * Answer Unproject from a grid of rays precomputed every spacing pixels,
+   * bilinearly interpolated and, if polish, refined by one Newton step.
+   * The grid is rebuilt by SetParams and Scale. While parameters changed
+   * through GetParams() differ from those of the grid, Unproject is exact.
+   */
+  virtual void EnableUnprojectCache( int spacing = 8, bool polish = true ) {}
+
+  virtual void DisableUnprojectCache() {}
+
   /// Set the pose of the camera (typically in the "rig" frame).
   void SetPose( const SE3t& t_rc ) {
     t_rc_ = t_rc;
@@ -262,6 +453,9 @@ protected:
           : image_size_(image_size), params_(params_in) {
   }
 
+  /// Called after the parameters have been replaced by SetParams.
+  virtual void ParamsChanged() {}
+
   Eigen::Vector2i image_size_;
 
   /// All the camera parameters (fu, fv, u0, v0, ...distortion).
@@ -22,6 +22,12 @@
   limitations under the License.
 */
 #pragma once
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <memory>
+#include <vector>
+
 #include <calibu/cam/camera_crtp.h>
 
 /**
@@ -35,17 +41,71 @@
  * - static void dProject_dray(const T* ray, const T* params, T* j) {
  * - static void dProject_dparams(const T* ray, const T* params, T* j)
  * - static void dUnproject_dparams(const T* pix, const T* params, T* j)
+ * - static void ProjectWithJacobians(const T* ray, const T* params, T* pix,
+ *                                   T* j_ray, T* j_params)
+ *   which computes Project, dProject_dray and dProject_dparams at once,
+ *   sharing their intermediate terms, with either Jacobian possibly null.
+ *
+ * The batch ProjectN/UnprojectN entry points run the static kernels in a
+ * single loop, so the per-point cost is that of the model math alone.
+ *
+ * Parameters are stored in double precision for every Scalar. Models of
+ * other precisions, e.g. float, run their kernels on a copy cast to Scalar,
+ * made once per call (or batch), so the model math stays in Scalar.
  */
 namespace calibu {
+
+/// Parameters of an N parameter model as Scalar. Double models use the
+/// stored parameters in place.
+template <typename Scalar, int N>
+struct ModelParams {
+  explicit ModelParams(const Eigen::VectorXd& params) {
+    for (int i = 0; i < N; ++i) {
+      p[i] = static_cast<Scalar>(params[i]);
+    }
+  }
+  const Scalar* data() const { return p; }
+  Scalar p[N];
+};
+
+template <int N>
+struct ModelParams<double, N> {
+  explicit ModelParams(const Eigen::VectorXd& params) : p(params.data()) {}
+  const double* data() const { return p; }
+  const double* p;
+};
+
 template <typename Scalar, int ParamSize, typename Derived>
 class CameraImpl : public CameraInterface<Scalar> {
   typedef typename CameraInterface<Scalar>::Vec2t Vec2t;
   typedef typename CameraInterface<Scalar>::Vec3t Vec3t;
   typedef typename CameraInterface<Scalar>::SE3t SE3t;
+  typedef typename CameraInterface<Scalar>::Mat2Xt Mat2Xt;
+  typedef typename CameraInterface<Scalar>::Mat3Xt Mat3Xt;
+
+ protected:
+  typedef ModelParams<Scalar, ParamSize> ScalarParams;
 
  public:
   static constexpr int kParamSize = ParamSize;
 
+  /// Project and Unproject kernels for the current parameters, made once
+  /// per call or batch. Models can declare their own Kernels, e.g. to
+  /// compute values that only depend on the parameters once.
+  struct Kernels {
+    explicit Kernels(const Derived& cam) : params(cam.params_) {}
+
+    void Project(const Scalar* ray, Scalar* pix) const {
+      Derived::Project(ray, params.data(), pix);
+    }
+
+    void Unproject(const Scalar* pix, Scalar* ray) const {
+      Derived::Unproject(pix, params.data(), ray);
+    }
+
+    ScalarParams params;
+  };
+
   CameraImpl() {}
   virtual ~CameraImpl() {}
   CameraImpl(const Eigen::VectorXd& params, Eigen::Vector2i& image_size) :
@@ -55,6 +115,20 @@ class CameraImpl : public CameraInterface<Scalar> {
   void
   Scale(const Scalar& s) override {
     Derived::Scale( s, this->params_.data() );
+    ParamsChanged();
+  }
+
+  void
+  EnableUnprojectCache(int spacing, bool polish) override {
+    cache_spacing_ = std::max(1, spacing);
+    cache_polish_ = polish;
+    BuildUnprojectCache();
+  }
+
+  void
+  DisableUnprojectCache() override {
+    cache_spacing_ = 0;
+    unproject_cache_.reset();
   }
 
   void
@@ -77,43 +151,380 @@ class CameraImpl : public CameraInterface<Scalar> {
   Eigen::Matrix<Scalar, 3, 3>
   K() const override {
     Eigen::Matrix<Scalar,3,3> Kmat;
-    Derived::K( this->params_.data() , Kmat.data());
+    Derived::K( ScalarParams(this->params_).data() , Kmat.data());
     return Kmat;
   }
 
   Vec3t
   Unproject(const Vec2t& pix) const override {
     Vec3t ray;
-    Derived::Unproject(pix.data(), this->params_.data(), ray.data());
+    const UnprojectCache* cache = ValidUnprojectCache();
+    if (!cache || !CachedUnproject(*cache, pix.data(), ray.data())) {
+      ModelKernels().Unproject(pix.data(), ray.data());
+    }
     return ray;
   }
 
   Vec2t
   Project(const Vec3t& ray) const override {
     Vec2t pix;
-    Derived::Project(ray.data(), this->params_.data(), pix.data());
+    ModelKernels().Project(ray.data(), pix.data());
     return pix;
   }
 
-  Eigen::Matrix<Scalar, 2, Eigen::Dynamic>
-  dProject_dparams(const Vec3t& ray) const override {
-    Eigen::Matrix<Scalar, 2, kParamSize> j;
-    Derived::dProject_dparams(ray.data(), this->params_.data(), j.data());
-    return j;
+  void
+  UnprojectN(const Mat2Xt& pix, Mat3Xt& rays) const override {
+    const auto kernels = ModelKernels();
+    const Eigen::Index n = pix.cols();
+    rays.resize(3, n);
+    const Scalar* in = pix.data();
+    Scalar* out = rays.data();
+    const UnprojectCache* cache = ValidUnprojectCache();
+    for (Eigen::Index i = 0; i < n; ++i) {
+      if (!cache || !CachedUnproject(*cache, in + 2 * i, out + 3 * i)) {
+        kernels.Unproject(in + 2 * i, out + 3 * i);
+      }
+    }
   }
 
-  Eigen::Matrix<Scalar, 3, Eigen::Dynamic>
-  dUnproject_dparams(const Vec2t& pix) const override {
-    Eigen::Matrix<Scalar, 3, kParamSize> j;
-    Derived::dUnproject_dparams(pix.data(), this->params_.data(), j.data());
-    return j;
+  void
+  ProjectN(const Mat3Xt& rays, Mat2Xt& pix) const override {
+    const auto kernels = ModelKernels();
+    const Eigen::Index n = rays.cols();
+    pix.resize(2, n);
+    const Scalar* in = rays.data();
+    Scalar* out = pix.data();
+    for (Eigen::Index i = 0; i < n; ++i) {
+      kernels.Project(in + 3 * i, out + 2 * i);
+    }
+  }
+
+  void
+  UnprojectN(const Scalar* u, const Scalar* v,
+             Scalar* x, Scalar* y, Scalar* z,
+             size_t n) const override {
+    const auto kernels = ModelKernels();
+    const UnprojectCache* cache = ValidUnprojectCache();
+    for (size_t i = 0; i < n; ++i) {
+      const Scalar pix[2] = {u[i], v[i]};
+      Scalar ray[3];
+      if (!cache || !CachedUnproject(*cache, pix, ray)) {
+        kernels.Unproject(pix, ray);
+      }
+      x[i] = ray[0];
+      y[i] = ray[1];
+      z[i] = ray[2];
+    }
+  }
+
+  void
+  ProjectN(const Scalar* x, const Scalar* y, const Scalar* z,
+           Scalar* u, Scalar* v,
+           size_t n) const override {
+    const auto kernels = ModelKernels();
+    for (size_t i = 0; i < n; ++i) {
+      const Scalar ray[3] = {x[i], y[i], z[i]};
+      Scalar pix[2];
+      kernels.Project(ray, pix);
+      u[i] = pix[0];
+      v[i] = pix[1];
+    }
+  }
+
+  using CameraInterface<Scalar>::dProject_dparams;
+  using CameraInterface<Scalar>::dUnproject_dparams;
+  using CameraInterface<Scalar>::ProjectWithJacobians;
+
+  void
+  dProject_dparams(const Vec3t& ray, Scalar* j) const override {
+    Derived::dProject_dparams(ray.data(), ScalarParams(this->params_).data(), j);
+  }
+
+  void
+  dUnproject_dparams(const Vec2t& pix, Scalar* j) const override {
+    Derived::dUnproject_dparams(pix.data(), ScalarParams(this->params_).data(), j);
   }
 
   Eigen::Matrix<Scalar, 2, 3>
   dProject_dray(const Vec3t& ray) const override {
     Eigen::Matrix<Scalar, 2, 3> j;
-    Derived::dProject_dray(ray.data(), this->params_.data(), j.data());
+    Derived::dProject_dray(ray.data(), ScalarParams(this->params_).data(), j.data());
     return j;
   }
+
+  void
+  ProjectWithJacobians(const Vec3t& ray, Vec2t& pix,
+                       Scalar* j_ray, Scalar* j_params) const override {
+    Derived::ProjectWithJacobians(ray.data(), ScalarParams(this->params_).data(),
+                                  pix.data(), j_ray, j_params);
+  }
+
+  std::shared_ptr<const CameraSnapshot<Scalar>>
+  Snapshot() const override {
+    return std::make_shared<ModelSnapshot>(static_cast<const Derived&>(*this));
+  }
+
+ protected:
+  /// Kernels of the model, which may be Derived's own.
+  auto ModelKernels() const {
+    return typename Derived::Kernels(static_cast<const Derived&>(*this));
+  }
+
+  /// Rays at grid nodes every spacing pixels, for the parameters params.
+  struct UnprojectCache {
+    Eigen::VectorXd params;
+    Scalar spacing;
+    int nx;
+    int ny;
+    bool polish;
+    // Rays of the model have unit z rather than unit length
+    bool unit_z;
+    std::vector<Scalar> rays;
+  };
+
+  void ParamsChanged() override {
+    if (cache_spacing_ > 0) {
+      BuildUnprojectCache();
+    }
+  }
+
+  void BuildUnprojectCache() {
+    std::shared_ptr<UnprojectCache> cache(new UnprojectCache);
+    cache->params = this->params_;
+    cache->spacing = cache_spacing_;
+    cache->polish = cache_polish_;
+    cache->nx = (this->image_size_[0] + cache_spacing_ - 1) / cache_spacing_ + 1;
+    cache->ny = (this->image_size_[1] + cache_spacing_ - 1) / cache_spacing_ + 1;
+    cache->rays.resize(3 * cache->nx * cache->ny);
+    cache->unit_z = true;
+    const ScalarParams params(this->params_);
+    Scalar* ray = cache->rays.data();
+    for (int y = 0; y < cache->ny; ++y) {
+      for (int x = 0; x < cache->nx; ++x, ray += 3) {
+        const Scalar pix[2] = {Scalar(x * cache_spacing_),
+                               Scalar(y * cache_spacing_)};
+        Derived::Unproject(pix, params.data(), ray);
+        if (ray[2] != Scalar(1)) {
+          cache->unit_z = false;
+        }
+
+        // Leave out nodes the model doesn't unproject consistently, e.g.
+        // on singularities of its inverse, so that pixels near them are
+        // unprojected exactly
+        Scalar check[2];
+        Derived::Project(ray, params.data(), check);
+        if (!(std::abs(check[0] - pix[0]) + std::abs(check[1] - pix[1]) <
+              Scalar(1E-3) * cache_spacing_)) {
+          ray[0] = ray[1] = ray[2] = std::numeric_limits<Scalar>::quiet_NaN();
+        }
+      }
+    }
+    unproject_cache_ = cache;
+  }
+
+  /// Cache matching the current parameters, or nullptr.
+  const UnprojectCache* ValidUnprojectCache() const {
+    const UnprojectCache* cache = unproject_cache_.get();
+    if (cache && cache->params.size() == this->params_.size() &&
+        cache->params == this->params_) {
+      return cache;
+    }
+    return nullptr;
+  }
+
+  /// Interpolated ray at pix, false if pix is outside of the grid or near
+  /// rays the model can't unproject.
+  bool CachedUnproject(const UnprojectCache& cache, const Scalar* pix,
+                       Scalar* ray_out) const {
+    const Scalar fx = pix[0] / cache.spacing;
+    const Scalar fy = pix[1] / cache.spacing;
+    if (!(fx >= 0 && fy >= 0 && fx < cache.nx - 1 && fy < cache.ny - 1)) {
+      return false;
+    }
+    const int ix = (int)fx;
+    const int iy = (int)fy;
+    const Scalar ax = fx - ix;
+    const Scalar ay = fy - iy;
+    const Scalar* r00 = &cache.rays[3 * (iy * cache.nx + ix)];
+    const Scalar* r10 = r00 + 3;
+    const Scalar* r01 = r00 + 3 * cache.nx;
+    const Scalar* r11 = r01 + 3;
+
+    Vec3t ray;
+    for (int k = 0; k < 3; ++k) {
+      ray[k] = (1 - ay) * ((1 - ax) * r00[k] + ax * r10[k]) +
+               ay * ((1 - ax) * r01[k] + ax * r11[k]);
+    }
+    if (!ray.allFinite()) {
+      return false;
+    }
+
+    if (cache.polish) {
+      // Smallest ray change moving its projection onto pix
+      Vec2t p;
+      Eigen::Matrix<Scalar, 2, 3> J;
+      const ScalarParams params(this->params_);
+      Derived::ProjectWithJacobians(ray.data(), params.data(), p.data(),
+                                    J.data(), (Scalar*)nullptr);
+      const Vec2t e = Eigen::Map<const Vec2t>(pix) - p;
+      const Eigen::Matrix<Scalar, 2, 2> JJt = J * J.transpose();
+      const Vec3t step = J.transpose() * JJt.inverse() * e;
+      if (step.allFinite()) {
+        ray += step;
+      }
+    }
+
+    if (cache.unit_z) {
+      ray /= ray[2];
+    } else {
+      ray.normalize();
+    }
+    ray_out[0] = ray[0];
+    ray_out[1] = ray[1];
+    ray_out[2] = ray[2];
+    return true;
+  }
+
+  /// Snapshot holding a copy of the camera and its kernels, and the
+  /// unproject cache if it was valid for the copied parameters.
+  class ModelSnapshot : public CameraSnapshot<Scalar> {
+   public:
+    explicit ModelSnapshot(const Derived& cam)
+        : camera_(cam), kernels_(camera_),
+          cache_(static_cast<const CameraImpl&>(camera_).ValidUnprojectCache()) {
+      // The copy constructor only copies the parameters and image size
+      camera_.SetPose(cam.Pose());
+      camera_.SetType(cam.Type());
+      camera_.SetName(cam.Name());
+      camera_.SetRDF(cam.RDF());
+    }
+
+    Vec2t Project(const Vec3t& ray) const override {
+      Vec2t pix;
+      kernels_.Project(ray.data(), pix.data());
+      return pix;
+    }
+
+    Vec3t Unproject(const Vec2t& pix) const override {
+      Vec3t ray;
+      if (!cache_ || !camera_.CachedUnproject(*cache_, pix.data(), ray.data())) {
+        kernels_.Unproject(pix.data(), ray.data());
+      }
+      return ray;
+    }
+
+    Eigen::Matrix<Scalar, 2, 3> dProject_dray(const Vec3t& ray) const override {
+      Eigen::Matrix<Scalar, 2, 3> j;
+      Derived::dProject_dray(ray.data(), kernels_.params.data(), j.data());
+      return j;
+    }
+
+    void ProjectN(const Scalar* x, const Scalar* y, const Scalar* z,
+                  Scalar* u, Scalar* v,
+                  size_t n) const override {
+      for (size_t i = 0; i < n; ++i) {
+        const Scalar ray[3] = {x[i], y[i], z[i]};
+        Scalar pix[2];
+        kernels_.Project(ray, pix);
+        u[i] = pix[0];
+        v[i] = pix[1];
+      }
+    }
+
+    void UnprojectN(const Scalar* u, const Scalar* v,
+                    Scalar* x, Scalar* y, Scalar* z,
+                    size_t n) const override {
+      for (size_t i = 0; i < n; ++i) {
+        const Scalar pix[2] = {u[i], v[i]};
+        Scalar ray[3];
+        if (!cache_ || !camera_.CachedUnproject(*cache_, pix, ray)) {
+          kernels_.Unproject(pix, ray);
+        }
+        x[i] = ray[0];
+        y[i] = ray[1];
+        z[i] = ray[2];
+      }
+    }
+
+    const CameraInterface<Scalar>& Camera() const override {
+      return camera_;
+    }
+
+   private:
+    Derived camera_;
+    // Refers to camera_'s parameters, which never change
+    const typename Derived::Kernels kernels_;
+    const UnprojectCache* cache_;
+  };
+
+  std::shared_ptr<const UnprojectCache> unproject_cache_;
+  int cache_spacing_ = 0;
+  bool cache_polish_ = true;
 }; // public CameraInterface<Scalar>
+
+/**
+ * Parameters of a camera of CRTP model Model held inline, with the model's
+ * kernels as members. Unlike CameraInterface, which keeps its parameters in
+ * a heap allocated Eigen::VectorXd and is called through virtual functions,
+ * nothing here allocates and every call can be inlined, for tight loops
+ * evaluating a model whose type is known at compile time.
+ */
+template <typename Model, typename Scalar = double>
+struct FixedParamsCamera {
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+  static constexpr int kParamSize = Model::kParamSize;
+  typedef Eigen::Matrix<Scalar, kParamSize, 1> Params;
+  typedef Eigen::Matrix<Scalar, 2, 1> Vec2t;
+  typedef Eigen::Matrix<Scalar, 3, 1> Vec3t;
+
+  FixedParamsCamera() : params(Params::Zero()) {}
+
+  explicit FixedParamsCamera(const Params& params) : params(params) {}
+
+  /// Copy of cam's parameters, which must be of Model.
+  explicit FixedParamsCamera(const CameraInterface<Scalar>& cam)
+      : params(cam.GetParams().template head<kParamSize>().template cast<Scalar>()) {}
+
+  Vec2t Project(const Vec3t& ray) const {
+    Vec2t pix;
+    Model::Project(ray.data(), params.data(), pix.data());
+    return pix;
+  }
+
+  Vec3t Unproject(const Vec2t& pix) const {
+    Vec3t ray;
+    Model::Unproject(pix.data(), params.data(), ray.data());
+    return ray;
+  }
+
+  Eigen::Matrix<Scalar, 2, 3> dProject_dray(const Vec3t& ray) const {
+    Eigen::Matrix<Scalar, 2, 3> j;
+    Model::dProject_dray(ray.data(), params.data(), j.data());
+    return j;
+  }
+
+  Eigen::Matrix<Scalar, 2, kParamSize> dProject_dparams(const Vec3t& ray) const {
+    Eigen::Matrix<Scalar, 2, kParamSize> j;
+    Model::dProject_dparams(ray.data(), params.data(), j.data());
+    return j;
+  }
+
+  Eigen::Matrix<Scalar, 3, kParamSize> dUnproject_dparams(const Vec2t& pix) const {
+    Eigen::Matrix<Scalar, 3, kParamSize> j;
+    Model::dUnproject_dparams(pix.data(), params.data(), j.data());
+    return j;
+  }
+
+  /// See CameraInterface::ProjectWithJacobians. Either Jacobian may be null.
+  void ProjectWithJacobians(const Vec3t& ray, Vec2t& pix,
+                            Eigen::Matrix<Scalar, 2, 3>* j_ray,
+                            Eigen::Matrix<Scalar, 2, kParamSize>* j_params) const {
+    Model::ProjectWithJacobians(ray.data(), params.data(), pix.data(),
+                                j_ray ? j_ray->data() : nullptr,
+                                j_params ? j_params->data() : nullptr);
+  }
+
+  Params params;
+};
 }  // namespace calibu
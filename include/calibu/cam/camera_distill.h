@@ -0,0 +1,98 @@
+/*
+   This file is part of the Calibu Project.
+   https://github.com/arpg/Calibu
+
+   Copyright (C) 2013 George Washington University,
+                      Steven Lovegrove,
+                      Gabe Sibley
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+   http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+
+#pragma once
+
+#include <memory>
+#include <string>
+
+#include <calibu/Platform.h>
+#include <calibu/cam/camera_crtp.h>
+
+namespace calibu
+{
+
+struct ParamsCameraDistill
+{
+    ParamsCameraDistill()
+        : pixel_step(4), max_iterations(100), num_threads(0)
+    {
+    }
+
+    /// Spacing, in pixels, of the grid of samples over the image. The last
+    /// row and column of the image are always sampled.
+    int pixel_step;
+
+    /// Levenberg-Marquardt iterations of the fit.
+    int max_iterations;
+
+    /// Threads to sample and fit with, 0 for one per core.
+    unsigned int num_threads;
+};
+
+/// How closely a camera returned by DistillCamera matches its source.
+/// Errors are in pixels over the sample grid.
+struct CameraDistillation
+{
+    CameraDistillation()
+        : num_samples(0), num_dropped(0), iterations(0),
+          rms_error(0), max_error(0), max_unproject_error(0)
+    {
+    }
+
+    /// Pixels fitted, and those left out because the source couldn't
+    /// unproject them in front of the camera.
+    size_t num_samples;
+    size_t num_dropped;
+
+    int iterations;
+
+    /// Distance between each pixel and the projection by the fit of the
+    /// source's ray through it.
+    double rms_error;
+    double max_error;
+
+    /// Largest distance between a pixel and the projection by the source
+    /// of the fit's ray through it, i.e. the error of using the fit's
+    /// Unproject in place of the source's.
+    double max_unproject_error;
+};
+
+/// Fit a camera of the model named by type, as in CreateCameraModel, to
+/// 'camera', e.g. to replace a Rational6 or KB4 calibration, whose
+/// Unproject iterates, by one that is cheaper to evaluate at runtime. A
+/// grid of pixels over the image is unprojected by 'camera', and the
+/// parameters of the fit are refined by Levenberg-Marquardt from the
+/// pinhole parameters of 'camera' to minimise the reprojection error of
+/// those rays. Samples are split between threads in fixed blocks, so the
+/// fit doesn't depend on the number of threads. The fit takes the image
+/// size, pose and identity of 'camera' and its error is written to
+/// 'result'. Returns nullptr if type is unknown or no pixel could be
+/// unprojected.
+CALIBU_EXPORT std::shared_ptr<CameraInterface<double> > DistillCamera(
+        const CameraInterface<double>& camera,
+        const std::string& type,
+        CameraDistillation& result,
+        const ParamsCameraDistill& params = ParamsCameraDistill()
+        );
+
+}
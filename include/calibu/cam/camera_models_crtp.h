@@ -53,3 +53,37 @@
 #include <calibu/cam/camera_models_poly.h>
 #include <calibu/cam/camera_models_kb4.h>
 #include <calibu/cam/camera_models_rational.h>
+
+#include <memory>
+#include <string>
+
+namespace calibu {
+
+/// New camera of the model named by type, as in the type attribute of
+/// camera XML files, with all parameters 1. nullptr for unknown types.
+inline std::shared_ptr<CameraInterface<double>> CreateCameraModel(
+    const std::string& type) {
+  std::shared_ptr<CameraInterface<double>> cam;
+  if (type == "calibu_fu_fv_u0_v0_w") {
+    cam.reset(new FovCamera<double>());
+    cam->SetParams(Eigen::VectorXd::Constant(FovCamera<double>::NumParams, 1));
+  } else if (type == "calibu_fu_fv_u0_v0") {
+    cam.reset(new LinearCamera<double>());
+    cam->SetParams(Eigen::VectorXd::Constant(LinearCamera<double>::NumParams, 1));
+  } else if (type == "calibu_fu_fv_u0_v0_k1_k2") {
+    cam.reset(new Poly2Camera<double>());
+    cam->SetParams(Eigen::VectorXd::Constant(Poly2Camera<double>::NumParams, 1));
+  } else if (type == "calibu_fu_fv_u0_v0_kb4") {
+    cam.reset(new KannalaBrandtCamera<double>());
+    cam->SetParams(Eigen::VectorXd::Constant(KannalaBrandtCamera<double>::NumParams, 1));
+  } else if (type == "calibu_fu_fv_u0_v0_k1_k2_k3") {
+    cam.reset(new Poly3Camera<double>());
+    cam->SetParams(Eigen::VectorXd::Constant(Poly3Camera<double>::NumParams, 1));
+  } else if (type == "calibu_fu_fv_u0_v0_rational6") {
+    cam.reset(new Rational6Camera<double>());
+    cam->SetParams(Eigen::VectorXd::Constant(Rational6Camera<double>::NumParams, 1));
+  }
+  return cam;
+}
+
+}  // namespace calibu
@@ -58,7 +58,7 @@ class KannalaBrandtCamera : public CameraImpl<Scalar, 8, KannalaBrandtCamera<Sca
   }
 
   template<typename T>
-  static void Unproject(const T* pix, const T* params, T* ray) {
+  CALIBU_HOST_DEVICE static void Unproject(const T* pix, const T* params, T* ray) {
 
     const T fu = params[0];
     const T fv = params[1];
@@ -99,7 +99,7 @@ class KannalaBrandtCamera : public CameraImpl<Scalar, 8, KannalaBrandtCamera<Sca
   }
 
   template<typename T>
-  static void Project(const T* ray, const T* params, T* pix) {
+  CALIBU_HOST_DEVICE static void Project(const T* ray, const T* params, T* pix) {
     const T fu = params[0];
     const T fv = params[1];
     const T u0 = params[2];
@@ -127,9 +127,36 @@ class KannalaBrandtCamera : public CameraImpl<Scalar, 8, KannalaBrandtCamera<Sca
 
   template<typename T>
   static void dProject_dparams(const T* ray, const T* params, T* j) {
-    T pix[2];
-    CameraUtils::Dehomogenize(ray, pix);
-    CameraUtils::dMultK_dparams(params, pix, j);
+    const T fu = params[0];
+    const T fv = params[1];
+
+    const T k0 = params[4];
+    const T k1 = params[5];
+    const T k2 = params[6];
+    const T k3 = params[7];
+
+    const T Xsq_plus_Ysq = ray[0]*ray[0]+ray[1]*ray[1];
+    const T theta = atan2( sqrt(Xsq_plus_Ysq), ray[2] );
+    const T psi = atan2( ray[1], ray[0] );
+    const T cos_psi = cos(psi);
+    const T sin_psi = sin(psi);
+
+    const T theta2 = theta*theta;
+    const T theta3 = theta2*theta;
+    const T theta5 = theta3*theta2;
+    const T theta7 = theta5*theta2;
+    const T theta9 = theta7*theta2;
+    const T r = theta + k0*theta3 + k1*theta5 + k2*theta7 + k3*theta9;
+
+    // Column major storage order.
+    j[0] = r*cos_psi;       j[1] = 0;
+    j[2] = 0;               j[3] = r*sin_psi;
+    j[4] = 1;               j[5] = 0;
+    j[6] = 0;               j[7] = 1;
+    j[8] = fu*cos_psi*theta3;   j[9] = fv*sin_psi*theta3;
+    j[10] = fu*cos_psi*theta5;  j[11] = fv*sin_psi*theta5;
+    j[12] = fu*cos_psi*theta7;  j[13] = fv*sin_psi*theta7;
+    j[14] = fu*cos_psi*theta9;  j[15] = fv*sin_psi*theta9;
   }
 
   template<typename T>
@@ -168,12 +195,86 @@ class KannalaBrandtCamera : public CameraImpl<Scalar, 8, KannalaBrandtCamera<Sca
       const T x19 = x17/x3;
       const T x20 = ray[2]*x12/(x2*x5);
 
+      // Column major storage order.
       j[0] = fu*(x0*x16*x17 + x0*x20 + x19);
-      j[1] = ray[1]*x13*x14;
-      j[2] = x14*x18;
-      j[3] = ray[0]*x13*x15;
-      j[4] = fv*(x1*x16*x17 + x1*x20 + x19);
+      j[1] = ray[0]*x13*x15;
+      j[2] = ray[1]*x13*x14;
+      j[3] = fv*(x1*x16*x17 + x1*x20 + x19);
+      j[4] = x14*x18;
       j[5] = x15*x18;
       }
+
+  /// Project, dProject_dray and dProject_dparams in one pass, sharing the
+  /// angles and their powers. Either Jacobian may be null.
+  template<typename T>
+  static void ProjectWithJacobians(const T* ray, const T* params, T* pix,
+                                   T* j_ray, T* j_params) {
+    const T fu = params[0];
+    const T fv = params[1];
+    const T u0 = params[2];
+    const T v0 = params[3];
+
+    const T k0 = params[4];
+    const T k1 = params[5];
+    const T k2 = params[6];
+    const T k3 = params[7];
+
+    const T Xsq_plus_Ysq = ray[0]*ray[0]+ray[1]*ray[1];
+    const T sqrt_Xsq_plus_Ysq = sqrt(Xsq_plus_Ysq);
+    const T theta = atan2( sqrt_Xsq_plus_Ysq, ray[2] );
+    const T psi = atan2( ray[1], ray[0] );
+    const T cos_psi = cos(psi);
+    const T sin_psi = sin(psi);
+
+    const T theta2 = theta*theta;
+    const T theta4 = theta2*theta2;
+    const T theta6 = theta4*theta2;
+    const T theta8 = theta4*theta4;
+    const T poly = 1 + k0*theta2 + k1*theta4 + k2*theta6 + k3*theta8;
+    const T r = theta*poly;
+
+    pix[0] = fu*r*cos_psi + u0;
+    pix[1] = fv*r*sin_psi + v0;
+
+    if (j_ray) {
+      // As dProject_dray, with theta and its powers shared
+      const T x0 = ray[0]*ray[0];
+      const T x1 = ray[1]*ray[1];
+      const T x4 = Xsq_plus_Ysq*sqrt_Xsq_plus_Ysq;
+      const T x5 = ray[2]*ray[2] + Xsq_plus_Ysq;
+      const T x12 = 3*k0*theta2 + 5*k1*theta4 + 7*k2*theta6 + 9*k3*theta8 + 1;
+      const T x20 = ray[2]*x12/(Xsq_plus_Ysq*x5);
+      const T x13 = x20 - r/x4;
+      const T x14 = ray[0]*fu;
+      const T x15 = ray[1]*fv;
+      const T x18 = -x12/x5;
+      const T x19 = r/sqrt_Xsq_plus_Ysq;
+
+      // Column major storage order.
+      j_ray[0] = fu*(x19 - x0*r/x4 + x0*x20);
+      j_ray[1] = ray[0]*x13*x15;
+      j_ray[2] = ray[1]*x13*x14;
+      j_ray[3] = fv*(x19 - x1*r/x4 + x1*x20);
+      j_ray[4] = x14*x18;
+      j_ray[5] = x15*x18;
+    }
+
+    if (j_params) {
+      const T theta3 = theta2*theta;
+      const T theta5 = theta4*theta;
+      const T theta7 = theta6*theta;
+      const T theta9 = theta8*theta;
+
+      // Column major storage order.
+      j_params[0] = r*cos_psi;       j_params[1] = 0;
+      j_params[2] = 0;               j_params[3] = r*sin_psi;
+      j_params[4] = 1;               j_params[5] = 0;
+      j_params[6] = 0;               j_params[7] = 1;
+      j_params[8] = fu*cos_psi*theta3;   j_params[9] = fv*sin_psi*theta3;
+      j_params[10] = fu*cos_psi*theta5;  j_params[11] = fv*sin_psi*theta5;
+      j_params[12] = fu*cos_psi*theta7;  j_params[13] = fv*sin_psi*theta7;
+      j_params[14] = fu*cos_psi*theta9;  j_params[15] = fv*sin_psi*theta9;
+    }
+  }
 };
 }
@@ -31,8 +31,22 @@
 
 namespace calibu {
 
-/// Model "fov," colloquially known as "fisheye" model.
 constexpr double kFovCamDistEps = 1e-5;
+
+/// Squared radius and squared w below which the fov model takes its limits.
+/// The derivatives subtract terms of order 1/w (and 1/rad), so in float the
+/// double threshold leaves them with few significant digits.
+template<typename T>
+CALIBU_HOST_DEVICE inline T FovCamDistEps() {
+  return T(kFovCamDistEps);
+}
+
+template<>
+CALIBU_HOST_DEVICE inline float FovCamDistEps<float>() {
+  return 1e-4f;
+}
+
+/// Model "fov," colloquially known as "fisheye" model.
 template<typename Scalar = double>
 class FovCamera : public CameraImpl<Scalar, 5, FovCamera<Scalar> > {
   typedef CameraImpl<Scalar, 5, FovCamera<Scalar> > Base;
@@ -41,6 +55,17 @@ class FovCamera : public CameraImpl<Scalar, 5, FovCamera<Scalar> > {
 
   static constexpr int NumParams = 5;
 
+  /// Evaluate atan/tan of Project, Unproject and their batch versions with
+  /// the fast approximations of CameraUtils, at most about 1.2e-5 rad off
+  /// the exact distortion angle. Off by default.
+  void SetFastMath(bool fast) {
+    fast_math_ = fast;
+  }
+
+  bool FastMath() const {
+    return fast_math_;
+  }
+
   template<typename T>
   static void Scale( const double s, T* params ) {
     CameraUtils::Scale( s, params );
@@ -58,17 +83,52 @@ class FovCamera : public CameraImpl<Scalar, 5, FovCamera<Scalar> > {
     CameraUtils::K( params, Kmat);
   }
 
+  /// Values of the model that only depend on the parameters, computed once
+  /// per call or batch by CameraImpl, and whether the factors use the fast
+  /// CameraUtils::FastAtan/FastTan instead of atan/tan.
+  template<typename T>
+  struct Constants {
+    CALIBU_HOST_DEVICE explicit Constants(const T* params, bool fast = false)
+        : w(params[4]), mul2_tanw_by2((T)2.0 * tan(params[4] / (T)2.0)),
+          fast(fast) {}
+
+    T w;
+    T mul2_tanw_by2;
+    bool fast;
+  };
+
+  /// Kernels of CameraImpl, with the constants computed once.
+  struct Kernels {
+    explicit Kernels(const FovCamera& cam)
+        : params(cam.params_), constants(params.data(), cam.fast_math_) {}
+
+    void Project(const Scalar* ray, Scalar* pix) const {
+      FovCamera::Project(ray, params.data(), constants, pix);
+    }
+
+    void Unproject(const Scalar* pix, Scalar* ray) const {
+      FovCamera::Unproject(pix, params.data(), constants, ray);
+    }
+
+    typename Base::ScalarParams params;
+    Constants<Scalar> constants;
+  };
+
   // For these derivatives, refer to the camera_derivatives.m matlab file.
   template<typename T>
-  static T Factor(const T rad, const T* params) {
-    const T param = params[4];
-    if (param * param > (T)kFovCamDistEps) {
-      const T mul2_tanw_by2 = (T)2.0 * tan(param / (T)2.0);
-      if (rad * rad < (T)kFovCamDistEps) {
+  CALIBU_HOST_DEVICE static T Factor(const T rad, const T* params) {
+    return Factor(rad, Constants<T>(params));
+  }
+
+  template<typename T>
+  CALIBU_HOST_DEVICE static T Factor(const T rad, const Constants<T>& c) {
+    if (c.w * c.w > FovCamDistEps<T>()) {
+      if (rad * rad < FovCamDistEps<T>()) {
         // limit r->0
-        return mul2_tanw_by2 / param;
+        return c.mul2_tanw_by2 / c.w;
       }
-      return atan(rad * mul2_tanw_by2) / (rad * param);
+      const T x = rad * c.mul2_tanw_by2;
+      return (c.fast ? CameraUtils::FastAtan(x) : atan(x)) / (rad * c.w);
     }
     // limit w->0
     return (T)1;
@@ -77,10 +137,10 @@ class FovCamera : public CameraImpl<Scalar, 5, FovCamera<Scalar> > {
   template<typename T>
   static T dFactor_dparam(const T rad, const T* params, T* fac) {
     const T param = params[4];
-    if (param * param > kFovCamDistEps) {
+    if (param * param > FovCamDistEps<T>()) {
       const T tanw_by2 = tan(param / (T)2.0);
       const T mul2_tanw_by2 = (T)2.0 * tanw_by2;
-      if (rad * rad < kFovCamDistEps) {
+      if (rad * rad < FovCamDistEps<T>()) {
         // limit r->0
         *fac = mul2_tanw_by2 / param;
         return ((T)2 * ((tanw_by2 * tanw_by2) / (T)2 + (T)0.5)) / param -
@@ -102,14 +162,14 @@ class FovCamera : public CameraImpl<Scalar, 5, FovCamera<Scalar> > {
   template<typename T>
   static T dFactor_drad(const T rad, const T* params, T* fac) {
     const T param = params[4];
-    if(param * param < kFovCamDistEps) {
+    if(param * param < FovCamDistEps<T>()) {
       *fac = (T)1;
       return (T)0;
     }else{
       const T tan_wby2 = tan(param / (T)2.0);
       const T mul2_tanw_by2 = (T)2.0 * tan_wby2;
 
-      if(rad * rad < kFovCamDistEps) {
+      if(rad * rad < FovCamDistEps<T>()) {
         *fac = mul2_tanw_by2 / param;
         return (T)0;
       }else{
@@ -125,18 +185,53 @@ class FovCamera : public CameraImpl<Scalar, 5, FovCamera<Scalar> > {
   }
 
 
+  /// Factor and its derivatives w.r.t. rad and w, sharing the tan and atan
+  /// that dFactor_drad and dFactor_dparam each evaluate.
   template<typename T>
-  static T Factor_inv(const T rad, const T* params) {
+  static T FactorDerivatives(const T rad, const T* params, T* dfac_drad,
+                             T* dfac_dparam) {
     const T param = params[4];
-    if(param * param > kFovCamDistEps) {
-      const T w_by2 = param / (T)2.0;
-      const T mul_2tanw_by2 = tan(w_by2) * (T)2.0;
+    if (param * param > FovCamDistEps<T>()) {
+      const T tanw_by2 = tan(param / (T)2.0);
+      const T tanw_by2_sq = tanw_by2 * tanw_by2;
+      const T mul2_tanw_by2 = (T)2.0 * tanw_by2;
+      if (rad * rad < FovCamDistEps<T>()) {
+        // limit r->0
+        *dfac_drad = (T)0;
+        *dfac_dparam = ((T)2 * (tanw_by2_sq / (T)2 + (T)0.5)) / param -
+            mul2_tanw_by2 / (param * param);
+        return mul2_tanw_by2 / param;
+      }
+      const T atan_mul2_tanw_by2 = atan(rad * mul2_tanw_by2);
+      const T rad_mul_param = (rad * param);
+      const T denom = (T)4 * tanw_by2_sq * rad * rad + (T)1;
+      *dfac_drad = mul2_tanw_by2 / (rad_mul_param * denom) -
+          atan_mul2_tanw_by2 / (rad * rad_mul_param);
+      *dfac_dparam = ((T)2 * (tanw_by2_sq / (T)2 + (T)0.5)) / (param * denom) -
+          atan_mul2_tanw_by2 / (rad_mul_param * param);
+      return atan_mul2_tanw_by2 / rad_mul_param;
+    }
+    // limit w->0
+    *dfac_drad = (T)0;
+    *dfac_dparam = (T)0;
+    return (T)1;
+  }
+
+  template<typename T>
+  CALIBU_HOST_DEVICE static T Factor_inv(const T rad, const T* params) {
+    return Factor_inv(rad, Constants<T>(params));
+  }
 
-      if(rad * rad < kFovCamDistEps) {
+  template<typename T>
+  CALIBU_HOST_DEVICE static T Factor_inv(const T rad, const Constants<T>& c) {
+    if(c.w * c.w > FovCamDistEps<T>()) {
+      if(rad * rad < FovCamDistEps<T>()) {
         // limit r->0
-        return param / mul_2tanw_by2;
+        return c.w / c.mul2_tanw_by2;
       }
-      return tan(rad * param) / (rad * mul_2tanw_by2);
+      const T x = rad * c.w;
+      return (c.fast ? CameraUtils::FastTan(x) : tan(x)) /
+          (rad * c.mul2_tanw_by2);
     }
     // limit w->0
     return (T)1.0;
@@ -145,9 +240,9 @@ class FovCamera : public CameraImpl<Scalar, 5, FovCamera<Scalar> > {
   template<typename T>
   static T dFactor_inv_dparam(const T rad, const T* params) {
     const T param = params[4];
-    if(param * param > kFovCamDistEps) {
+    if(param * param > FovCamDistEps<T>()) {
       const T tan_wby2 = tan(param / (T)2.0);
-      if(rad * rad < kFovCamDistEps) {
+      if(rad * rad < FovCamDistEps<T>()) {
         return (T)1.0 / ((T)2 * tan_wby2) -
             (param * (tan_wby2 * tan_wby2 / (T)2.0 + (T)0.5)) /
             ((T)2.0 * tan_wby2 * tan_wby2);
@@ -165,11 +260,11 @@ class FovCamera : public CameraImpl<Scalar, 5, FovCamera<Scalar> > {
   template<typename T>
   static T dFactor_inv_drad(const T rad, const T* params, T* fac) {
     const T param = params[4];
-    if(param * param > kFovCamDistEps) {
+    if(param * param > FovCamDistEps<T>()) {
       const T w_by2 = param / (T)2.0;
       const T tan_w_by2 = tan(w_by2);
       const T mul_2tanw_by2 = tan_w_by2 * (T)2.0;
-      if(rad * rad < kFovCamDistEps) {
+      if(rad * rad < FovCamDistEps<T>()) {
         *fac = param / tan_w_by2;
         return (T)0;
       }
@@ -186,12 +281,18 @@ class FovCamera : public CameraImpl<Scalar, 5, FovCamera<Scalar> > {
   }
 
   template<typename T>
-  static void Unproject(const T* pix, const T* params, T* ray) {
+  CALIBU_HOST_DEVICE static void Unproject(const T* pix, const T* params, T* ray) {
+    Unproject(pix, params, Constants<T>(params), ray);
+  }
+
+  template<typename T>
+  CALIBU_HOST_DEVICE static void Unproject(const T* pix, const T* params,
+                                           const Constants<T>& c, T* ray) {
     // First multiply by inverse K and calculate distortion parameter.
     T pix_kinv[2];
     CameraUtils::MultInvK(params, pix, pix_kinv);
     const T fac_inv =
-        Factor_inv(CameraUtils::PixNorm(pix_kinv), params);
+        Factor_inv(CameraUtils::PixNorm(pix_kinv), c);
     pix_kinv[0] *= fac_inv;
     pix_kinv[1] *= fac_inv;
     // Homogenize the point.
@@ -253,12 +354,18 @@ class FovCamera : public CameraImpl<Scalar, 5, FovCamera<Scalar> > {
   }
 
   template<typename T>
-  static void Project(const T* ray, const T* params, T* pix) {
+  CALIBU_HOST_DEVICE static void Project(const T* ray, const T* params, T* pix) {
+    Project(ray, params, Constants<T>(params), pix);
+  }
+
+  template<typename T>
+  CALIBU_HOST_DEVICE static void Project(const T* ray, const T* params,
+                                         const Constants<T>& c, T* pix) {
     // De-homogenize and multiply by K.
     CameraUtils::Dehomogenize(ray, pix);
     // Calculate distortion parameter.
     const T fac =
-        Factor(CameraUtils::PixNorm(pix), params);
+        Factor(CameraUtils::PixNorm(pix), c);
     pix[0] *= fac;
     pix[1] *= fac;
     CameraUtils::MultK<T>(params, pix, pix);
@@ -313,6 +420,37 @@ class FovCamera : public CameraImpl<Scalar, 5, FovCamera<Scalar> > {
     j[4] = j_dehomog[4] * k00 + j_dehomog[5] * k01;
     j[5] = j_dehomog[4] * k10 + j_dehomog[5] * k11;
   }
+
+  /// Project, dProject_dray and dProject_dparams in one pass, evaluating
+  /// the factor and its derivatives once. Either Jacobian may be null.
+  template<typename T>
+  static void ProjectWithJacobians(const T* ray, const T* params, T* pix,
+                                   T* j_ray, T* j_params) {
+    T pix_dehomog[2];
+    CameraUtils::Dehomogenize(ray, pix_dehomog);
+    const T rad = CameraUtils::PixNorm(pix_dehomog);
+    T dfac_drad, dfac_dparam;
+    const T fac = FactorDerivatives(rad, params, &dfac_drad, &dfac_dparam);
+
+    const T pix_dist[2] = { pix_dehomog[0] * fac, pix_dehomog[1] * fac };
+    CameraUtils::MultK<T>(params, pix_dist, pix);
+
+    if (j_ray) {
+      CameraUtils::dRadialProject_dray(ray, params, pix_dehomog, fac,
+                                       rad > (T)0 ? dfac_drad / rad : (T)0,
+                                       j_ray);
+    }
+    if (j_params) {
+      CameraUtils::dMultK_dparams(params, pix_dehomog, j_params);
+      j_params[0] *= fac;
+      j_params[3] *= fac;
+      j_params[8] = params[0] * pix_dehomog[0] * dfac_dparam;
+      j_params[9] = params[1] * pix_dehomog[1] * dfac_dparam;
+    }
+  }
+
+ private:
+  bool fast_math_ = false;
 };
 
 /** A two-coefficient polynomial distortion model. */
@@ -342,7 +480,7 @@ class Poly2Camera : public CameraImpl<Scalar, 6, Poly2Camera<Scalar> > {
   }
 
   template<typename T>
-  static T Factor(const T rad, const T* params) {
+  CALIBU_HOST_DEVICE static T Factor(const T rad, const T* params) {
     T r2 = rad * rad;
     T r4 = r2 * r2;
     return (static_cast<T>(1.0) + params[4]*r2 + params[5]*r4);
@@ -355,7 +493,7 @@ class Poly2Camera : public CameraImpl<Scalar, 6, Poly2Camera<Scalar> > {
   }
 
   template<typename T>
-  static T Factor_inv(const T r, const T* params) {
+  CALIBU_HOST_DEVICE static T Factor_inv(const T r, const T* params) {
     T k1 = params[4];
     T k2 = params[5];
 
@@ -386,7 +524,7 @@ class Poly2Camera : public CameraImpl<Scalar, 6, Poly2Camera<Scalar> > {
   }
 
   template<typename T>
-  static void Unproject(const T* pix, const T* params, T* ray) {
+  CALIBU_HOST_DEVICE static void Unproject(const T* pix, const T* params, T* ray) {
     // First multiply by inverse K and calculate distortion parameter.
     T pix_kinv[2];
     CameraUtils::MultInvK(params, pix, pix_kinv);
@@ -400,7 +538,7 @@ class Poly2Camera : public CameraImpl<Scalar, 6, Poly2Camera<Scalar> > {
   }
 
   template<typename T>
-  static void Project(const T* ray, const T* params, T* pix) {
+  CALIBU_HOST_DEVICE static void Project(const T* ray, const T* params, T* pix) {
     // De-homogenize and multiply by K.
     CameraUtils::Dehomogenize(ray, pix);
 
@@ -445,10 +583,60 @@ class Poly2Camera : public CameraImpl<Scalar, 6, Poly2Camera<Scalar> > {
   }
 
   template<typename T>
-  static void dProject_dparams(const T*, const T*, T* ) {
-    std::cerr << "dProjedt_dparams not defined for the poly2 model. "
-        " Throwing exception." << std::endl;
-    throw 0;
+  static void dProject_dparams(const T* ray, const T* params, T* j) {
+    T pix[2];
+    CameraUtils::Dehomogenize(ray, pix);
+    // The distortion factor is applied before multiplying by K, so the
+    // derivatives are a simple application of the chain rule.
+    const T r2 = pix[0] * pix[0] + pix[1] * pix[1];
+    const T fac = Factor(CameraUtils::PixNorm(pix), params);
+    CameraUtils::dMultK_dparams(params, pix, j);
+    j[0] *= fac;
+    j[3] *= fac;
+    // Derivatives w.r.t. the distortion coefficients:
+    const T params0_pix0 = params[0] * pix[0];
+    const T params1_pix1 = params[1] * pix[1];
+    T rn = r2;
+    j[8] = params0_pix0 * rn;
+    j[9] = params1_pix1 * rn;
+    rn *= r2;
+    j[10] = params0_pix0 * rn;
+    j[11] = params1_pix1 * rn;
+  }
+
+  /// Project, dProject_dray and dProject_dparams in one pass, sharing the
+  /// powers of the radius. Either Jacobian may be null.
+  template<typename T>
+  static void ProjectWithJacobians(const T* ray, const T* params, T* pix,
+                                   T* j_ray, T* j_params) {
+    T pix_dehomog[2];
+    CameraUtils::Dehomogenize(ray, pix_dehomog);
+    const T r2 = pix_dehomog[0] * pix_dehomog[0] + pix_dehomog[1] * pix_dehomog[1];
+    const T fac = static_cast<T>(1.0) + params[4] * r2 + params[5] * r2 * r2;
+
+    const T pix_dist[2] = { pix_dehomog[0] * fac, pix_dehomog[1] * fac };
+    CameraUtils::MultK<T>(params, pix_dist, pix);
+
+    if (j_ray) {
+      // fac'(r) / r, which unlike dFactor_drad / r is finite at r = 0
+      const T dfac_drad_byrad = 2.0 * params[4] + 4.0 * params[5] * r2;
+      CameraUtils::dRadialProject_dray(ray, params, pix_dehomog, fac,
+                                       dfac_drad_byrad, j_ray);
+    }
+    if (j_params) {
+      CameraUtils::dMultK_dparams(params, pix_dehomog, j_params);
+      j_params[0] *= fac;
+      j_params[3] *= fac;
+      // Derivatives w.r.t. the distortion coefficients:
+      const T params0_pix0 = params[0] * pix_dehomog[0];
+      const T params1_pix1 = params[1] * pix_dehomog[1];
+      T rn = r2;
+      j_params[8] = params0_pix0 * rn;
+      j_params[9] = params1_pix1 * rn;
+    rn *= r2;
+    j_params[10] = params0_pix0 * rn;
+    j_params[11] = params1_pix1 * rn;
+    }
   }
 
   template<typename T>
@@ -486,7 +674,7 @@ class Poly3Camera : public CameraImpl<Scalar, 7, Poly3Camera<Scalar> > {
   }
 
   template<typename T>
-  static T Factor(const T rad, const T* params) {
+  CALIBU_HOST_DEVICE static T Factor(const T rad, const T* params) {
     T r2 = rad * rad;
     T r4 = r2 * r2;
     return (static_cast<T>(1.0) +
@@ -506,7 +694,7 @@ class Poly3Camera : public CameraImpl<Scalar, 7, Poly3Camera<Scalar> > {
   }
 
   template<typename T>
-  static T Factor_inv(const T r, const T* params) {
+  CALIBU_HOST_DEVICE static T Factor_inv(const T r, const T* params) {
     T k1 = params[4];
     T k2 = params[5];
     T k3 = params[6];
@@ -539,7 +727,7 @@ class Poly3Camera : public CameraImpl<Scalar, 7, Poly3Camera<Scalar> > {
   }
 
   template<typename T>
-  static void Unproject(const T* pix, const T* params, T* ray) {
+  CALIBU_HOST_DEVICE static void Unproject(const T* pix, const T* params, T* ray) {
     // First multiply by inverse K and calculate distortion parameter.
     T pix_kinv[2];
     CameraUtils::MultInvK(params, pix, pix_kinv);
@@ -553,7 +741,7 @@ class Poly3Camera : public CameraImpl<Scalar, 7, Poly3Camera<Scalar> > {
   }
 
   template<typename T>
-  static void Project(const T* ray, const T* params, T* pix) {
+  CALIBU_HOST_DEVICE static void Project(const T* ray, const T* params, T* pix) {
     // De-homogenize and multiply by K.
     CameraUtils::Dehomogenize(ray, pix);
 
@@ -598,10 +786,69 @@ class Poly3Camera : public CameraImpl<Scalar, 7, Poly3Camera<Scalar> > {
   }
 
   template<typename T>
-  static void dProject_dparams(const T*, const T*, T* ) {
-    std::cerr << "dProjedt_dparams not defined for the poly3 model. "
-        " Throwing exception." << std::endl;
-    throw 0;
+  static void dProject_dparams(const T* ray, const T* params, T* j) {
+    T pix[2];
+    CameraUtils::Dehomogenize(ray, pix);
+    // The distortion factor is applied before multiplying by K, so the
+    // derivatives are a simple application of the chain rule.
+    const T r2 = pix[0] * pix[0] + pix[1] * pix[1];
+    const T fac = Factor(CameraUtils::PixNorm(pix), params);
+    CameraUtils::dMultK_dparams(params, pix, j);
+    j[0] *= fac;
+    j[3] *= fac;
+    // Derivatives w.r.t. the distortion coefficients:
+    const T params0_pix0 = params[0] * pix[0];
+    const T params1_pix1 = params[1] * pix[1];
+    T rn = r2;
+    j[8] = params0_pix0 * rn;
+    j[9] = params1_pix1 * rn;
+    rn *= r2;
+    j[10] = params0_pix0 * rn;
+    j[11] = params1_pix1 * rn;
+    rn *= r2;
+    j[12] = params0_pix0 * rn;
+    j[13] = params1_pix1 * rn;
+  }
+
+  /// Project, dProject_dray and dProject_dparams in one pass, sharing the
+  /// powers of the radius. Either Jacobian may be null.
+  template<typename T>
+  static void ProjectWithJacobians(const T* ray, const T* params, T* pix,
+                                   T* j_ray, T* j_params) {
+    T pix_dehomog[2];
+    CameraUtils::Dehomogenize(ray, pix_dehomog);
+    const T r2 = pix_dehomog[0] * pix_dehomog[0] + pix_dehomog[1] * pix_dehomog[1];
+    const T r4 = r2 * r2;
+    const T fac = static_cast<T>(1.0) +
+        params[4] * r2 + params[5] * r4 + params[6] * r4 * r2;
+
+    const T pix_dist[2] = { pix_dehomog[0] * fac, pix_dehomog[1] * fac };
+    CameraUtils::MultK<T>(params, pix_dist, pix);
+
+    if (j_ray) {
+      // fac'(r) / r, which unlike dFactor_drad / r is finite at r = 0
+      const T dfac_drad_byrad =
+          2.0 * params[4] + 4.0 * params[5] * r2 + 6.0 * params[6] * r4;
+      CameraUtils::dRadialProject_dray(ray, params, pix_dehomog, fac,
+                                       dfac_drad_byrad, j_ray);
+    }
+    if (j_params) {
+      CameraUtils::dMultK_dparams(params, pix_dehomog, j_params);
+      j_params[0] *= fac;
+      j_params[3] *= fac;
+      // Derivatives w.r.t. the distortion coefficients:
+      const T params0_pix0 = params[0] * pix_dehomog[0];
+      const T params1_pix1 = params[1] * pix_dehomog[1];
+      T rn = r2;
+      j_params[8] = params0_pix0 * rn;
+      j_params[9] = params1_pix1 * rn;
+    rn *= r2;
+    j_params[10] = params0_pix0 * rn;
+    j_params[11] = params1_pix1 * rn;
+    rn *= r2;
+    j_params[12] = params0_pix0 * rn;
+    j_params[13] = params1_pix1 * rn;
+    }
   }
 
   template<typename T>
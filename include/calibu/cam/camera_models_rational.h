@@ -62,7 +62,7 @@ class Rational6Camera : public CameraImpl<Scalar, 10, Rational6Camera<Scalar> >
   }
 
   template<typename T>
-  static T Factor(const T rad, const T* params) {
+  CALIBU_HOST_DEVICE static T Factor(const T rad, const T* params) {
     T r2 = rad * rad;
     T r4 = r2 * r2;
     return ((static_cast<T>(1.0) +
@@ -91,8 +91,8 @@ class Rational6Camera : public CameraImpl<Scalar, 10, Rational6Camera<Scalar> >
 	T ru6 = ru4 * ru2;
 	T numer = k1 * ru2 + k2 * ru4 + k3 * ru6 + 1;
 	T denom = k4 * ru2 + k5 * ru4 + k6 * ru6 + 1;
-	T d_numer = ru * (2*k1 + 4*k2*ru2 * 6*k3*ru4);
-	T d_denom = ru * (2*k4 + 4*k5*ru2 * 6*k6*ru4);
+	T d_numer = ru * (2*k1 + 4*k2*ru2 + 6*k3*ru4);
+	T d_denom = ru * (2*k4 + 4*k5*ru2 + 6*k6*ru4);
 	T denom2 = (denom * denom);
 	T numer2 = (d_numer * denom - numer * d_denom);
 	T d_pol = numer2 / denom2;
@@ -100,7 +100,7 @@ class Rational6Camera : public CameraImpl<Scalar, 10, Rational6Camera<Scalar> >
   }
 
   template<typename T>
-  static T Factor_inv(const T rd, const T* params) {
+  CALIBU_HOST_DEVICE static T Factor_inv(const T rd, const T* params) {
     T k1 = params[4];
     T k2 = params[5];
     T k3 = params[6];
@@ -121,8 +121,8 @@ class Rational6Camera : public CameraImpl<Scalar, 10, Rational6Camera<Scalar> >
       T numer = k1 * ru2 + k2 * ru4 + k3 * ru6 + 1;
       T denom = k4 * ru2 + k5 * ru4 + k6 * ru6 + 1;
       T pol = numer / denom;
-      T d_numer = ru * (2*k1 + 4*k2*ru2 * 6*k3*ru4);
-      T d_denom = ru * (2*k4 + 4*k5*ru2 * 6*k6*ru4);
+      T d_numer = ru * (2*k1 + 4*k2*ru2 + 6*k3*ru4);
+      T d_denom = ru * (2*k4 + 4*k5*ru2 + 6*k6*ru4);
       T denom2 = (denom * denom);
       T numer2 = (d_numer * denom - numer * d_denom);
       T d_pol = numer2 / denom2;
@@ -150,7 +150,7 @@ class Rational6Camera : public CameraImpl<Scalar, 10, Rational6Camera<Scalar> >
   }
 
   template<typename T>
-  static void Unproject(const T* pix, const T* params, T* ray) {
+  CALIBU_HOST_DEVICE static void Unproject(const T* pix, const T* params, T* ray) {
     // First multiply by inverse K and calculate distortion parameter.
     T pix_kinv[2];
     CameraUtils::MultInvK(params, pix, pix_kinv);
@@ -164,7 +164,7 @@ class Rational6Camera : public CameraImpl<Scalar, 10, Rational6Camera<Scalar> >
   }
 
   template<typename T>
-  static void Project(const T* ray, const T* params, T* pix) {
+  CALIBU_HOST_DEVICE static void Project(const T* ray, const T* params, T* pix) {
     // De-homogenize and multiply by K.
     CameraUtils::Dehomogenize(ray, pix);
 
@@ -209,10 +209,77 @@ class Rational6Camera : public CameraImpl<Scalar, 10, Rational6Camera<Scalar> >
   }
 
   template<typename T>
-  static void dProject_dparams(const T*, const T*, T* ) {
-    std::cerr << "dProjedt_dparams not defined for the rational6 model. "
-        " Throwing exception." << std::endl;
-    throw 0;
+  static void dProject_dparams(const T* ray, const T* params, T* j) {
+    T pix[2];
+    CameraUtils::Dehomogenize(ray, pix);
+    // The distortion factor is applied before multiplying by K, so the
+    // derivatives are a simple application of the chain rule.
+    const T r2 = pix[0] * pix[0] + pix[1] * pix[1];
+    const T r4 = r2 * r2;
+    const T r6 = r4 * r2;
+    const T denom = static_cast<T>(1.0) +
+        params[7] * r2 + params[8] * r4 + params[9] * r6;
+    const T fac = Factor(CameraUtils::PixNorm(pix), params);
+    CameraUtils::dMultK_dparams(params, pix, j);
+    j[0] *= fac;
+    j[3] *= fac;
+    // Derivatives w.r.t. the numerator and denominator coefficients:
+    const T dnumer[2] = { params[0] * pix[0] / denom,
+                          params[1] * pix[1] / denom };
+    const T ddenom[2] = { -dnumer[0] * fac, -dnumer[1] * fac };
+    j[8] = dnumer[0] * r2;    j[9] = dnumer[1] * r2;
+    j[10] = dnumer[0] * r4;   j[11] = dnumer[1] * r4;
+    j[12] = dnumer[0] * r6;   j[13] = dnumer[1] * r6;
+    j[14] = ddenom[0] * r2;   j[15] = ddenom[1] * r2;
+    j[16] = ddenom[0] * r4;   j[17] = ddenom[1] * r4;
+    j[18] = ddenom[0] * r6;   j[19] = ddenom[1] * r6;
+  }
+
+  /// Project, dProject_dray and dProject_dparams in one pass, evaluating
+  /// the numerator and denominator of the factor once. Either Jacobian may
+  /// be null.
+  template<typename T>
+  static void ProjectWithJacobians(const T* ray, const T* params, T* pix,
+                                   T* j_ray, T* j_params) {
+    T pix_dehomog[2];
+    CameraUtils::Dehomogenize(ray, pix_dehomog);
+    const T r2 = pix_dehomog[0] * pix_dehomog[0] + pix_dehomog[1] * pix_dehomog[1];
+    const T r4 = r2 * r2;
+    const T r6 = r4 * r2;
+    const T numer = static_cast<T>(1.0) +
+        params[4] * r2 + params[5] * r4 + params[6] * r6;
+    const T denom = static_cast<T>(1.0) +
+        params[7] * r2 + params[8] * r4 + params[9] * r6;
+    const T fac = numer / denom;
+
+    const T pix_dist[2] = { pix_dehomog[0] * fac, pix_dehomog[1] * fac };
+    CameraUtils::MultK<T>(params, pix_dist, pix);
+
+    if (j_ray) {
+      // fac'(r) / r, from the derivatives of numerator and denominator
+      // over r
+      const T d_numer_byrad = 2*params[4] + 4*params[5]*r2 + 6*params[6]*r4;
+      const T d_denom_byrad = 2*params[7] + 4*params[8]*r2 + 6*params[9]*r4;
+      const T dfac_drad_byrad =
+          (d_numer_byrad * denom - numer * d_denom_byrad) / (denom * denom);
+      CameraUtils::dRadialProject_dray(ray, params, pix_dehomog, fac,
+                                       dfac_drad_byrad, j_ray);
+    }
+    if (j_params) {
+      CameraUtils::dMultK_dparams(params, pix_dehomog, j_params);
+      j_params[0] *= fac;
+      j_params[3] *= fac;
+      // Derivatives w.r.t. the numerator and denominator coefficients:
+      const T dnumer[2] = { params[0] * pix_dehomog[0] / denom,
+                            params[1] * pix_dehomog[1] / denom };
+      const T ddenom[2] = { -dnumer[0] * fac, -dnumer[1] * fac };
+      j_params[8] = dnumer[0] * r2;    j_params[9] = dnumer[1] * r2;
+      j_params[10] = dnumer[0] * r4;   j_params[11] = dnumer[1] * r4;
+      j_params[12] = dnumer[0] * r6;   j_params[13] = dnumer[1] * r6;
+      j_params[14] = ddenom[0] * r2;   j_params[15] = ddenom[1] * r2;
+      j_params[16] = ddenom[0] * r4;   j_params[17] = ddenom[1] * r4;
+      j_params[18] = ddenom[0] * r6;   j_params[19] = ddenom[1] * r6;
+    }
   }
 
   template<typename T>
@@ -25,11 +25,13 @@
 */
 
 #pragma once
+#include <calibu/Platform.h>
+
 namespace calibu {
 struct CameraUtils {
   /** Euclidean distance from (0, 0) to given pixel */
   template<typename T>
-  static inline T PixNorm(const T* pix) {
+  CALIBU_HOST_DEVICE static inline T PixNorm(const T* pix) {
     return sqrt(pix[0] * pix[0] + pix[1] * pix[1]);
   }
 
@@ -42,7 +44,7 @@ struct CameraUtils {
   }
 
   template<typename T>
-  static inline void K(const T* params, T* Kmat) {
+  CALIBU_HOST_DEVICE static inline void K(const T* params, T* Kmat) {
     Kmat[0] = params[0];
     Kmat[1] = 0;
     Kmat[2] = 0;
@@ -63,7 +65,7 @@ struct CameraUtils {
    * @param pix A 2-vector (x, y)
    * */
   template<typename T>
-  static inline void Dehomogenize(const T* ray, T* px_dehomogenized) {
+  CALIBU_HOST_DEVICE static inline void Dehomogenize(const T* ray, T* px_dehomogenized) {
     px_dehomogenized[0] = ray[0] / ray[2];
     px_dehomogenized[1] = ray[1] / ray[2];
   }
@@ -75,7 +77,7 @@ struct CameraUtils {
    * @param ray_homogenized A 3-vector to be filled in
    */
   template<typename T>
-  static inline void Homogenize(const T* pix, T* ray_homogenized) {
+  CALIBU_HOST_DEVICE static inline void Homogenize(const T* pix, T* ray_homogenized) {
     ray_homogenized[0] = pix[0];
     ray_homogenized[1] = pix[1];
     ray_homogenized[2] = (T)1.0;
@@ -89,7 +91,7 @@ struct CameraUtils {
    * @param j A 2x3 matrix stored in column-major order
    */
   template<typename T>
-  static inline void dDehomogenize_dray(const T* ray, T* j) {
+  CALIBU_HOST_DEVICE static inline void dDehomogenize_dray(const T* ray, T* j) {
     const T z_sq = ray[2] * ray[2];
     const T z_inv = 1.0 / ray[2];
     // Column major storage order.
@@ -98,13 +100,13 @@ struct CameraUtils {
   }
 
   template<typename T>
-  static inline void dMultK_dparams(const T*, const T* pix, T* j) {
+  CALIBU_HOST_DEVICE static inline void dMultK_dparams(const T*, const T* pix, T* j) {
     j[0] = pix[0];    j[2] = 0;       j[4] = 1;   j[6] = 0;
     j[1] = 0;         j[3] = pix[1];  j[5] = 0;   j[7] = 1;
   }
 
   template<typename T>
-  static inline void dMultInvK_dparams(const T* params, const T* pix, T* j) {
+  CALIBU_HOST_DEVICE static inline void dMultInvK_dparams(const T* params, const T* pix, T* j) {
     j[0] = -(pix[0] - params[2]) / (params[0] * params[0]);
     j[1] = 0;
     j[2] = 0;
@@ -122,12 +124,46 @@ struct CameraUtils {
     j[11] = 0;
   }
 
+  /**
+   * Derivative w.r.t. the ray of radial models, which project a ray to
+   * K * fac(r) * pix, where pix is the dehomogenized ray and r its norm.
+   *
+   * @param fac The distortion factor fac(r).
+   * @param dfac_drad_byrad Its derivative over the radius, fac'(r) / r.
+   * @param j A 2x3 matrix stored in column-major order
+   */
+  template<typename T>
+  CALIBU_HOST_DEVICE static inline void dRadialProject_dray(
+      const T* ray, const T* params, const T* pix, const T fac,
+      const T dfac_drad_byrad, T* j) {
+    T j_dehomog[6];
+    dDehomogenize_dray(ray, j_dehomog);
+    const T dfac_dp[2] = { pix[0] * dfac_drad_byrad,
+                           pix[1] * dfac_drad_byrad };
+
+    // Calculate the k matrix and distortion derivative.
+    const T params0_pix0 = params[0] * pix[0];
+    const T params1_pix1 = params[1] * pix[1];
+    const T k00 = dfac_dp[0] * params0_pix0 + fac * params[0];
+    const T k01 = dfac_dp[1] * params0_pix0;
+    const T k10 = dfac_dp[0] * params1_pix1;
+    const T k11 = dfac_dp[1] * params1_pix1 + fac * params[1];
+
+    // Do the multiplication dkmult * ddehomogenized_dray
+    j[0] = j_dehomog[0] * k00;
+    j[1] = j_dehomog[0] * k10;
+    j[2] = j_dehomog[3] * k01;
+    j[3] = j_dehomog[3] * k11;
+    j[4] = j_dehomog[4] * k00 + j_dehomog[5] * k01;
+    j[5] = j_dehomog[4] * k10 + j_dehomog[5] * k11;
+  }
+
   /**
    * Transform a dehomogenized real-world point with calibration focal
    * length and principal point to place it in its imaged location.
    */
   template<typename T>
-  static inline void MultK(const T* params, const T* pix, T* pix_k) {
+  CALIBU_HOST_DEVICE static inline void MultK(const T* params, const T* pix, T* pix_k) {
     pix_k[0] = params[0] * pix[0] + params[2];
     pix_k[1] = params[1] * pix[1] + params[3];
   }
@@ -137,10 +173,39 @@ struct CameraUtils {
    * dehomogenized world coords.
    */
   template<typename T>
-  static inline void MultInvK(const T* params, const T* pix, T* pix_kinv) {
+  CALIBU_HOST_DEVICE static inline void MultInvK(const T* params, const T* pix, T* pix_kinv) {
     pix_kinv[0] = (pix[0] - params[2]) / params[0];
     pix_kinv[1] = (pix[1] - params[3]) / params[1];
   }
+
+  /**
+   * Polynomial atan (Abramowitz & Stegun 4.4.49), reduced to |x| <= 1
+   * through atan(x) = pi/2 - atan(1/x). Absolute error below 1.2e-5 rad.
+   */
+  template<typename T>
+  CALIBU_HOST_DEVICE static inline T FastAtan(const T x) {
+    if (x < (T)0) {
+      return -FastAtan(-x);
+    }
+    if (x > (T)1) {
+      return (T)1.57079632679489662 - FastAtan((T)1 / x);
+    }
+    const T x2 = x * x;
+    return x * ((T)0.9998660 + x2 * ((T)-0.3302995 + x2 * ((T)0.1801410 +
+                x2 * ((T)-0.0851330 + x2 * (T)0.0208351))));
+  }
+
+  /**
+   * Rational tan, from the continued fraction of Lambert truncated to a
+   * 7/6 Pade approximant. Relative error below 3e-9 for |x| <= 1.4 rad,
+   * 2e-8 at 1.5 rad; not valid beyond pi/2.
+   */
+  template<typename T>
+  CALIBU_HOST_DEVICE static inline T FastTan(const T x) {
+    const T x2 = x * x;
+    return x * ((T)135135 + x2 * ((T)-17325 + x2 * ((T)378 - x2))) /
+        ((T)135135 + x2 * ((T)-62370 + x2 * ((T)3150 - (T)28 * x2)));
+  }
 };
 
 template<typename Scalar = double>
@@ -160,12 +225,12 @@ class LinearCamera : public CameraImpl<Scalar, 4, LinearCamera<Scalar> > {
   // and sy. If your camera model doesn't respect this ordering, then evaluating
   // K for it will result in an incorrect matrix.
   template<typename T>
-  static void K( const T* params , T* Kmat) {
+  CALIBU_HOST_DEVICE static void K( const T* params , T* Kmat) {
     CameraUtils::K( params , Kmat);
   }
 
   template<typename T>
-  static void Unproject(const T* pix, const T* params, T* ray) {
+  CALIBU_HOST_DEVICE static void Unproject(const T* pix, const T* params, T* ray) {
     // First multiply by inverse K and calculate distortion parameter.
     T pix_kinv[2];
     CameraUtils::MultInvK(params, pix, pix_kinv);
@@ -174,26 +239,26 @@ class LinearCamera : public CameraImpl<Scalar, 4, LinearCamera<Scalar> > {
   }
 
   template<typename T>
-  static void Project(const T* ray, const T* params, T* pix) {
+  CALIBU_HOST_DEVICE static void Project(const T* ray, const T* params, T* pix) {
     // De-homogenize and multiply by K.
     CameraUtils::Dehomogenize(ray, pix);
     CameraUtils::MultK<T>(params, pix, pix);
   }
 
   template<typename T>
-  static void dProject_dparams(const T* ray, const T* params, T* j) {
+  CALIBU_HOST_DEVICE static void dProject_dparams(const T* ray, const T* params, T* j) {
     T pix[2];
     CameraUtils::Dehomogenize(ray, pix);
     CameraUtils::dMultK_dparams(params, pix, j);
   }
 
   template<typename T>
-  static void dUnproject_dparams(const T* pix, const T* params, T* j) {
+  CALIBU_HOST_DEVICE static void dUnproject_dparams(const T* pix, const T* params, T* j) {
     CameraUtils::dMultInvK_dparams(params, pix, j);
   }
 
   template<typename T>
-  static void dProject_dray(const T* ray, const T* params, T* j) {
+  CALIBU_HOST_DEVICE static void dProject_dray(const T* ray, const T* params, T* j) {
     // De-homogenize and multiply by K.
     T pix[2];
     CameraUtils::Dehomogenize(ray, pix);
@@ -208,6 +273,20 @@ class LinearCamera : public CameraImpl<Scalar, 4, LinearCamera<Scalar> > {
     j[4] *= params[0];
     j[5] *= params[1];
   }
+
+  template<typename T>
+  CALIBU_HOST_DEVICE static void ProjectWithJacobians(
+      const T* ray, const T* params, T* pix, T* j_ray, T* j_params) {
+    T pix_dehomog[2];
+    CameraUtils::Dehomogenize(ray, pix_dehomog);
+    CameraUtils::MultK<T>(params, pix_dehomog, pix);
+    if (j_ray) {
+      dProject_dray(ray, params, j_ray);
+    }
+    if (j_params) {
+      CameraUtils::dMultK_dparams(params, pix_dehomog, j_params);
+    }
+  }
 };
 
 }//end namespace calibu
@@ -27,6 +27,8 @@
 #include <calibu/utils/StreamOperatorsEigen.h>
 #include <calibu/cam/camera_rig.h>
 #include <glog/logging.h>
+#include <fstream>
+#include <memory>
 #include <sstream>
 
 namespace calibu
@@ -158,4 +160,58 @@ std::shared_ptr<Rigd> ReadXmlRig(const std::string& filename);
 
 CALIBU_EXPORT
 std::shared_ptr<Rigd> ReadXmlRigFromString(const std::string& modelXML);
+
+////////////////////////////////////////////////////////////////////////
+/// Reads the <rig> elements of a file or stream one at a time, e.g. from
+/// an export holding many rigs. The input is scanned tag by tag and only
+/// the text of the camera being decoded is held in memory, so the document
+/// is never loaded whole.
+///
+///   XmlRigReader reader("rigs.xml");
+///   while(std::shared_ptr<Rigd> rig = reader.Next()) { ... }
+///
+/// or, to decode only the cameras that are needed:
+///
+///   while(reader.NextRig()) {
+///       while(std::shared_ptr<CameraInterfaced> cam = reader.NextCamera()) {
+///           ...
+///       }
+///   }
+class CALIBU_EXPORT XmlRigReader
+{
+public:
+    /// Read from 'in', which must outlive the reader.
+    explicit XmlRigReader(std::istream& in);
+    explicit XmlRigReader(const std::string& filename);
+
+    XmlRigReader(const XmlRigReader&) = delete;
+    XmlRigReader& operator=(const XmlRigReader&) = delete;
+
+    bool IsOpen() const { return buf_ != nullptr; }
+
+    /// Move to the next <rig>, skipping the cameras of the current one that
+    /// were not read. Returns false at the end of the input.
+    bool NextRig();
+
+    /// Decode the next camera of the current rig, or nullptr once all have
+    /// been read. Cameras which fail to parse are reported and skipped, and,
+    /// as for ReadXmlRig, uninitialized cameras are dropped.
+    std::shared_ptr<CameraInterfaced> NextCamera();
+
+    /// Move to the next <rig> and decode all of its cameras, or nullptr at
+    /// the end of the input.
+    std::shared_ptr<Rigd> Next();
+
+private:
+    int Get();
+    bool NextTag(std::string& name, bool& closing, bool& empty);
+
+    std::unique_ptr<std::ifstream> file_;
+    std::streambuf* buf_;
+    bool in_rig_;
+    bool capturing_;
+    std::string tag_;      // text between '<' and '>' of the last tag
+    std::string capture_;  // text of the camera being read
+};
+
 } // namespace calibu
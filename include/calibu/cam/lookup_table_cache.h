@@ -0,0 +1,171 @@
+/*
+   This file is part of the Calibu Project.
+   https://github.com/arpg/Calibu
+
+   Copyright (C) 2013 George Washington University,
+                      Steven Lovegrove,
+                      Gabe Sibley
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+   http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include <calibu/Platform.h>
+#include <calibu/cam/camera_crtp.h>
+#include <calibu/cam/rectify_crtp.h>
+
+namespace calibu
+{
+
+  ///////////////////////////////////////////////////////////////////////////////
+  /// On-disk layout of a lookup table file: this header followed directly by
+  /// width * height BilinearLutPoint records. Values are stored in the byte
+  /// order of the machine that wrote the file; the magic and version reject
+  /// files from an incompatible writer.
+  struct LookupTableFileHeader
+  {
+    char magic[8];         // "CALIBULT"
+    uint32_t version;      // kLookupTableFileVersion
+    uint32_t point_size;   // sizeof(BilinearLutPoint)
+    uint32_t width;
+    uint32_t height;
+    uint64_t params_hash;  // LookupTableHash() of the source camera
+    double R_onKinv[9];    // column major
+    uint8_t reserved[24];  // pads the header to 128 bytes
+  };
+
+  static const uint32_t kLookupTableFileVersion = 1;
+
+  /// Hash of everything that determines a lookup table: camera type, image
+  /// size and parameters, R_onKinv and the table dimensions.
+  CALIBU_EXPORT uint64_t LookupTableHash(
+      const std::shared_ptr<calibu::CameraInterface<double>>& cam_from,
+      const Eigen::Matrix3d& R_onKinv,
+      int lookup_width,
+      int lookup_height
+      );
+
+  /// Write 'lut' to 'filename'. The file is written next to its destination
+  /// and renamed into place, so readers never see a partial table.
+  CALIBU_EXPORT bool SaveLookupTable(
+      const std::string& filename,
+      const LookupTable& lut,
+      uint64_t params_hash,
+      const Eigen::Matrix3d& R_onKinv
+      );
+
+  ///////////////////////////////////////////////////////////////////////////////
+  /// Read-only lookup table mapped from a file written by SaveLookupTable.
+  /// Pages are shared between all processes mapping the same file.
+  class CALIBU_EXPORT MappedLookupTable
+  {
+    public:
+      MappedLookupTable();
+      ~MappedLookupTable();
+
+      MappedLookupTable( const MappedLookupTable& ) = delete;
+      MappedLookupTable& operator=( const MappedLookupTable& ) = delete;
+
+      /// Map 'filename'. Returns false if the file is missing, truncated or
+      /// was written by an incompatible version.
+      bool Open( const std::string& filename );
+
+      void Close();
+
+      bool IsOpen() const { return header_ != nullptr; }
+
+      const BilinearLutPoint* Data() const { return points_; }
+
+      unsigned int Width() const { return header_ ? header_->width : 0; }
+
+      unsigned int Height() const { return header_ ? header_->height : 0; }
+
+      uint64_t ParamsHash() const { return header_ ? header_->params_hash : 0; }
+
+      Eigen::Matrix3d R_onKinv() const;
+
+      /// Copy the mapped points into an in-memory table.
+      void CopyTo( LookupTable& lut ) const;
+
+    private:
+      const LookupTableFileHeader* header_;
+      const BilinearLutPoint* points_;
+      void* mapping_;
+      size_t mapping_size_;
+  };
+
+  /// Rectify image pInputImageData with a mapped lookup table.
+  template <typename scalar>
+  void Rectify(
+          const MappedLookupTable& lut,
+          const scalar* pInputImageData,
+          scalar* pOutputRectImageData,
+          int w, int h, int channels = 1,
+          unsigned int num_threads = 1
+          )
+  {
+    // Make sure we have been given a correct lookup table.
+    assert(w == (int)lut.Width() && h == (int)lut.Height());
+
+    Rectify( lut.Data(), lut.Width(), lut.Height(),
+             pInputImageData, pOutputRectImageData, channels, num_threads );
+  }
+
+  ///////////////////////////////////////////////////////////////////////////////
+  /// Directory of lookup tables keyed on LookupTableHash(). A table is only
+  /// computed with CreateLookupTable the first time a camera/R_onKinv pair is
+  /// seen; afterwards it is mapped from disk. Tables already mapped by this
+  /// cache are shared rather than mapped again.
+  class CALIBU_EXPORT LookupTableCache
+  {
+    public:
+      explicit LookupTableCache( const std::string& directory,
+                                 unsigned int num_threads = 1 );
+
+      /// Mapped table for 'cam_from' and 'R_onKinv'. lookup_width and
+      /// lookup_height default to the camera image size.
+      std::shared_ptr<const MappedLookupTable> Get(
+          const std::shared_ptr<calibu::CameraInterface<double>>& cam_from,
+          const Eigen::Matrix3d& R_onKinv,
+          int lookup_width = 0,
+          int lookup_height = 0
+          );
+
+      /// As Get, but copy the table into 'lut' for callers that need an
+      /// owning LookupTable.
+      void Fill(
+          const std::shared_ptr<calibu::CameraInterface<double>>& cam_from,
+          const Eigen::Matrix3d& R_onKinv,
+          LookupTable& lut,
+          int lookup_width = 0,
+          int lookup_height = 0
+          );
+
+      /// File used for the table with the given hash.
+      std::string Filename( uint64_t params_hash ) const;
+
+    private:
+      std::string directory_;
+      unsigned int num_threads_;
+      std::mutex mutex_;
+      std::map<uint64_t, std::weak_ptr<const MappedLookupTable>> mapped_;
+  };
+
+}
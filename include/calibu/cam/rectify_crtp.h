@@ -22,12 +22,16 @@
 #pragma once
 
 #include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <type_traits>
 #include <vector>
 #include <sophus/se3.hpp>
 
 #include <calibu/Platform.h>
 #include <calibu/cam/camera_crtp.h>
 #include <calibu/cam/camera_crtp_impl.h>
+#include <calibu/utils/Parallel.h>
 #include <calibu/utils/Range.h>
 
 #include <iostream>
@@ -85,7 +89,7 @@ namespace calibu
 
       inline unsigned int Height() const
       {
-        return m_vLutPixels.size() / m_nWidth;
+        return m_nWidth == 0 ? 0 : m_vLutPixels.size() / m_nWidth;
       }
 
       inline void SetPoint( unsigned int nRow, unsigned int nCol, const BilinearLutPoint& p )
@@ -98,6 +102,74 @@ namespace calibu
       int m_nWidth; // so m_nHeight = m_vPixels.size()/m_nWidth
     };
 
+  ///////////////////////////////////////////////////////////////////////////////
+  /// Number of fractional bits used by the fixed-point bilinear weights. The
+  /// four weights of a point always sum to exactly 1 << kLutWeightBits, and
+  /// a weight times an 8-bit pixel fits in a signed 16 x 16 bit multiply.
+  static const int kLutWeightBits = 14;
+
+  /// Compact LUT entry: the bilinear weights are packed as 16-bit fixed
+  /// point, two per 32-bit word, so a row of weights can be fed directly to
+  /// pairwise multiply-add instructions. 16 bytes per pixel instead of 24.
+  struct FixedPointLutPoint
+  {
+    int idx0; // index to pixel in src image
+    int idx1; // index to pixel + one row in src image
+    uint32_t w0; // top-left weight | top-right weight << 16
+    uint32_t w1; // bottom-left weight | bottom-right weight << 16
+  };
+
+  ///////////////////////////////////////////////////////////////////////////////
+  /// Fixed-point version of LookupTable, built from a floating point table.
+  /// Used with the vectorized 8-bit Rectify below.
+  struct CALIBU_EXPORT FixedPointLookupTable
+  {
+    FixedPointLookupTable() : m_nWidth(0) {}
+    explicit FixedPointLookupTable( const LookupTable& lut );
+
+    /// Quantize the floating point weights of 'lut' into this table.
+    void Set( const LookupTable& lut );
+
+    inline unsigned int Width() const
+    {
+      return m_nWidth;
+    }
+
+    inline unsigned int Height() const
+    {
+      return m_nWidth == 0 ? 0 : m_vLutPixels.size() / m_nWidth;
+    }
+
+    std::vector<FixedPointLutPoint> m_vLutPixels;
+    int m_nWidth;
+  };
+
+  /// Instruction set used by the fixed-point Rectify.
+  enum RectifyKernel{
+    RECTIFY_KERNEL_AUTO,   // best kernel supported by the running CPU
+    RECTIFY_KERNEL_SCALAR,
+    RECTIFY_KERNEL_SSE2,
+    RECTIFY_KERNEL_AVX2,
+    RECTIFY_KERNEL_NEON
+  };
+
+  /// Best kernel supported by the running CPU and this build.
+  CALIBU_EXPORT RectifyKernel BestRectifyKernel();
+
+  /// Rectify an 8-bit single channel image with a fixed-point lookup table.
+  /// All kernels produce identical output; RECTIFY_KERNEL_AUTO picks the
+  /// fastest one available at runtime, and a kernel that is not supported
+  /// falls back to the scalar loop. Rows are split into num_threads bands
+  /// (0 for one per core).
+  CALIBU_EXPORT void Rectify(
+      const FixedPointLookupTable& lut,
+      const unsigned char* pInputImageData,
+      unsigned char* pOutputRectImageData,
+      int w, int h,
+      RectifyKernel kernel = RECTIFY_KERNEL_AUTO,
+      unsigned int num_threads = 1
+      );
+
   enum BorderTreatment{
 	  BORDER_REPEAT,
 	  BORDER_BLACK
@@ -108,12 +180,15 @@ namespace calibu
   /// 'cam_from' to a linear and potentially rotated model, 'R_onK'.
   /// R_onK is formed from the multiplication R_on (old form new) and the new
   /// camera intrinsics K.
+  /// The table is filled in num_threads row bands (0 for one per core); the
+  /// result does not depend on the thread count.
     CALIBU_EXPORT void CreateLookupTable(
         const std::shared_ptr<calibu::CameraInterface<double>>& cam_from,
         const Eigen::Matrix3d& R_onKinv,
         LookupTable& lut,
 		int lookup_width = 0,
-		int lookup_height= 0
+		int lookup_height= 0,
+        unsigned int num_threads = 1
         );
 
     /// Create lookup table which can be used to remap a general camera model
@@ -122,45 +197,148 @@ namespace calibu
         const std::shared_ptr<calibu::CameraInterface<double>>& cam_from,
         LookupTable& lut,
 		int lookup_width = 0,
-		int lookup_height = 0
+		int lookup_height = 0,
+        unsigned int num_threads = 1
         );
 
 
+  /// Convert an interpolated value back to the pixel type. Integer types are
+  /// rounded to nearest and saturated, floating point types pass through.
+  template <typename scalar,
+            bool is_integer = std::numeric_limits<scalar>::is_integer>
+  struct RectifyPixel
+  {
+    static inline scalar Convert( float value )
+    {
+      return (scalar) value;
+    }
+  };
+
+  template <typename scalar>
+  struct RectifyPixel<scalar, true>
+  {
+    // Types wider than float's mantissa, e.g. 32 bit integers, are
+    // saturated in double.
+    typedef typename std::conditional<
+        std::numeric_limits<scalar>::digits <= std::numeric_limits<float>::digits,
+        float, double>::type Real;
+
+    static inline scalar Convert( float value )
+    {
+      const Real lo = (Real) std::numeric_limits<scalar>::min();
+      const Real hi = (Real) std::numeric_limits<scalar>::max();
+      const Real v = value;
+      // hi may still round up past max() (64 bit integers), so values
+      // reaching it saturate instead of being converted.
+      if( v >= hi ) {
+        return std::numeric_limits<scalar>::max();
+      }
+      if( v <= lo ) {
+        return std::numeric_limits<scalar>::min();
+      }
+      // Truncation after the half offset rounds to nearest, and cannot
+      // leave (lo, hi) once the value lies strictly inside it.
+      return (scalar) ( v < 0 ? v - Real(0.5) : v + Real(0.5) );
+    }
+  };
+
+  /// Rectify 'count' pixels with a compile-time channel count, which lets
+  /// the compiler unroll and vectorize the channel loop.
+  template <typename scalar, int Channels>
+  inline void RectifyPixels(
+          const BilinearLutPoint* ptr,
+          int count,
+          const scalar* pInputImageData,
+          scalar* pOutput
+          )
+  {
+    for( int i = 0; i < count; ++i, ++ptr, pOutput += Channels ) {
+      const scalar* p00 = pInputImageData + ptr->idx0 * Channels;
+      const scalar* p10 = pInputImageData + ptr->idx1 * Channels;
+      for( int n_channel = 0; n_channel < Channels; ++n_channel ) {
+        pOutput[n_channel] = RectifyPixel<scalar>::Convert(
+            ptr->w00 * p00[n_channel] + ptr->w01 * p00[Channels + n_channel] +
+            ptr->w10 * p10[n_channel] + ptr->w11 * p10[Channels + n_channel] );
+      }
+    }
+  }
+
+  /// Run-time channel count version of RectifyPixels.
+  template <typename scalar>
+  inline void RectifyPixels(
+          const BilinearLutPoint* ptr,
+          int count,
+          const scalar* pInputImageData,
+          scalar* pOutput,
+          int channels
+          )
+  {
+    for( int i = 0; i < count; ++i, ++ptr, pOutput += channels ) {
+      const scalar* p00 = pInputImageData + ptr->idx0 * channels;
+      const scalar* p10 = pInputImageData + ptr->idx1 * channels;
+      for( int n_channel = 0; n_channel < channels; ++n_channel ) {
+        pOutput[n_channel] = RectifyPixel<scalar>::Convert(
+            ptr->w00 * p00[n_channel] + ptr->w01 * p00[channels + n_channel] +
+            ptr->w10 * p10[n_channel] + ptr->w11 * p10[channels + n_channel] );
+      }
+    }
+  }
+
+  /// Rectify image pInputImageData with the lut_width x lut_height table of
+  /// points 'lut', e.g. one held by a LookupTable or mapped from disk.
+  /// Channels are interleaved; 1, 3 and 4 channels use unrolled kernels.
+  /// Rows are split into num_threads bands (0 for one per core).
+  template <typename scalar>
+  void Rectify(
+          const BilinearLutPoint* lut,
+          int lut_width, int lut_height,
+          const scalar* pInputImageData,
+          scalar* pOutputRectImageData,
+          int channels = 1,
+          unsigned int num_threads = 1
+          )
+  {
+    ParallelForBands( lut_height, num_threads,
+                      [&]( int row_begin, int row_end ) {
+      // Make the most of the continuous block of memory!
+      const BilinearLutPoint* ptr = lut + row_begin * lut_width;
+      scalar* pOutput = pOutputRectImageData + row_begin * lut_width * channels;
+      const int count = (row_end - row_begin) * lut_width;
+
+      switch( channels ) {
+        case 1:
+          RectifyPixels<scalar, 1>( ptr, count, pInputImageData, pOutput );
+          break;
+        case 3:
+          RectifyPixels<scalar, 3>( ptr, count, pInputImageData, pOutput );
+          break;
+        case 4:
+          RectifyPixels<scalar, 4>( ptr, count, pInputImageData, pOutput );
+          break;
+        default:
+          RectifyPixels( ptr, count, pInputImageData, pOutput, channels );
+          break;
+      }
+    } );
+  }
+
   /// Rectify image pInputImageData using lookup table generated by
   /// 'CreateLookupTable' to output image pOutputRectImageData.
+  /// Rows are split into num_threads bands (0 for one per core).
   template <typename scalar>
   void Rectify(
           const LookupTable& lut,
           const scalar* pInputImageData,
           scalar* pOutputRectImageData,
-          int w, int h, int channels = 1
+          int w, int h, int channels = 1,
+          unsigned int num_threads = 1
           )
   {
-    // Make the most of the continuous block of memory!
-    const BilinearLutPoint* ptr   = &lut.m_vLutPixels[0];
-
-    const int nHeight = lut.Height();
-    const int nWidth  = lut.Width();
-
     // Make sure we have been given a correct lookup table.
-    assert(w== nWidth && h == nHeight);
-
-    for( int nRow = 0; nRow < nHeight; nRow++ ) {
-      for( int nCol = 0; nCol < nWidth; nCol++ ) {
-        for( int n_channel = 0; n_channel < channels; ++n_channel ) {
-          *pOutputRectImageData++ =
-            (scalar) ( ptr->w00 *
-                       pInputImageData[ptr->idx0 * channels + n_channel] +
-                ptr->w01 *
-                pInputImageData[(ptr->idx0 + 1) * channels + n_channel] +
-                ptr->w10 *
-                pInputImageData[ptr->idx1 * channels + n_channel] +
-                ptr->w11 *
-                pInputImageData[(ptr->idx1 + 1) * channels + n_channel] );
-        }
-        ptr++;
-      }
-    }
+    assert(w == (int)lut.Width() && h == (int)lut.Height());
+
+    Rectify( lut.m_vLutPixels.data(), lut.Width(), lut.Height(),
+             pInputImageData, pOutputRectImageData, channels, num_threads );
   }
 
   /// Some helper functions that were in the old Undistort/Distort world.
@@ -0,0 +1,130 @@
+/*
+  This file is part of the Calibu Project.
+  https://github.com/gwu-robotics/Calibu
+
+  Copyright (C) 2013 George Washington University,
+  Steven Lovegrove,
+  Gabe Sibley
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+  http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+/*
+   CUDA rectification, for images that already live on the device. Only
+   built with BUILD_CUDA (HAVE_CUDA in calibu/config.h). All image pointers
+   below are device pointers, with interleaved channels and rows of width
+   pixels, and work is queued on 'stream' without synchronizing. Errors of
+   the CUDA runtime are thrown as calibu::Exception.
+
+   The camera model kernels (Project, Unproject and their helpers) are
+   CALIBU_HOST_DEVICE, so device code compiled by nvcc can also call them
+   directly, e.g. FovCamera<float>::Project(ray, params, pix).
+*/
+
+#pragma once
+
+#include <memory>
+#include <cuda_runtime_api.h>
+#include <Eigen/Core>
+
+#include <calibu/Platform.h>
+#include <calibu/cam/camera_crtp.h>
+#include <calibu/cam/rectify_crtp.h>
+
+namespace calibu
+{
+  ///////////////////////////////////////////////////////////////////////////////
+  /// LookupTable held in device memory, uploaded once and used for every
+  /// frame. The device buffer is kept when a table of at most the same size
+  /// is set again.
+  class CALIBU_EXPORT CudaLookupTable
+  {
+  public:
+    CudaLookupTable();
+    explicit CudaLookupTable( const LookupTable& lut );
+    ~CudaLookupTable();
+
+    CudaLookupTable( const CudaLookupTable& ) = delete;
+    CudaLookupTable& operator=( const CudaLookupTable& ) = delete;
+
+    /// Upload 'lut' to the device.
+    void Set( const LookupTable& lut );
+
+    inline unsigned int Width() const
+    {
+      return m_nWidth;
+    }
+
+    inline unsigned int Height() const
+    {
+      return m_nHeight;
+    }
+
+    /// Device pointer to the Width() x Height() table points.
+    inline const BilinearLutPoint* DevicePoints() const
+    {
+      return m_pPoints;
+    }
+
+  private:
+    BilinearLutPoint* m_pPoints;
+    size_t m_nCapacity;
+    int m_nWidth;
+    int m_nHeight;
+  };
+
+  ///////////////////////////////////////////////////////////////////////////////
+  /// Rectify device image pInputImageData with a device lookup table, as the
+  /// CPU Rectify does. The output image is lut.Width() x lut.Height().
+  CALIBU_EXPORT void CudaRectify(
+      const CudaLookupTable& lut,
+      const unsigned char* pInputImageData,
+      unsigned char* pOutputRectImageData,
+      int channels = 1,
+      cudaStream_t stream = 0
+      );
+
+  CALIBU_EXPORT void CudaRectify(
+      const CudaLookupTable& lut,
+      const float* pInputImageData,
+      float* pOutputRectImageData,
+      int channels = 1,
+      cudaStream_t stream = 0
+      );
+
+  /// Rectify device image pInputImageData, taken by cam_from, without a
+  /// table: the camera model is evaluated in float for every output pixel,
+  /// which gives the image of CreateLookupTable( cam_from, R_onKinv, ... )
+  /// followed by Rectify up to float rounding. Useful when the camera
+  /// changes too often for a table to pay off. Throws for camera models
+  /// other than those of camera_models_crtp.h.
+  CALIBU_EXPORT void CudaRectify(
+      const std::shared_ptr<CameraInterface<double>>& cam_from,
+      const Eigen::Matrix3d& R_onKinv,
+      const unsigned char* pInputImageData,
+      unsigned char* pOutputRectImageData,
+      int out_width, int out_height,
+      int channels = 1,
+      cudaStream_t stream = 0
+      );
+
+  CALIBU_EXPORT void CudaRectify(
+      const std::shared_ptr<CameraInterface<double>>& cam_from,
+      const Eigen::Matrix3d& R_onKinv,
+      const float* pInputImageData,
+      float* pOutputRectImageData,
+      int out_width, int out_height,
+      int channels = 1,
+      cudaStream_t stream = 0
+      );
+}
@@ -0,0 +1,190 @@
+/*
+   This file is part of the Calibu Project.
+   https://github.com/arpg/Calibu
+
+   Copyright (C) 2013 George Washington University,
+                      Steven Lovegrove,
+                      Gabe Sibley
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+   http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#pragma once
+
+#include <vector>
+
+#include <calibu/Platform.h>
+#include <calibu/cam/camera_crtp.h>
+#include <calibu/cam/rectify_crtp.h>
+#include <calibu/utils/Parallel.h>
+
+namespace calibu
+{
+
+  ///////////////////////////////////////////////////////////////////////////////
+  /// Coarse warp map: source image coordinates stored only every m_nStep
+  /// output pixels and bilinearly interpolated in between by Rectify. With a
+  /// step of 8 the table is 8 bytes per 64 pixels instead of 24 per pixel,
+  /// 192 times smaller than a LookupTable; a step of 16 makes it 768 times
+  /// smaller.
+  /// The grid extends one control point past the last row/column when the
+  /// image size is not a multiple of the step.
+  struct CALIBU_EXPORT SparseLookupTable
+  {
+    SparseLookupTable()
+      : m_nWidth(0), m_nHeight(0), m_nStep(1), m_nGridWidth(0),
+        m_nGridHeight(0), m_nSrcWidth(0), m_nSrcHeight(0) {}
+
+    inline unsigned int Width() const { return m_nWidth; }
+
+    inline unsigned int Height() const { return m_nHeight; }
+
+    inline const Eigen::Vector2f& GridPoint( int grid_row, int grid_col ) const
+    {
+      return m_vGrid[grid_row * m_nGridWidth + grid_col];
+    }
+
+    /// Source coordinate of output pixel (col, row), not clamped.
+    Eigen::Vector2f Interpolate( int col, int row ) const;
+
+    std::vector<Eigen::Vector2f> m_vGrid;
+    int m_nWidth;
+    int m_nHeight;
+    int m_nStep;
+    int m_nGridWidth;
+    int m_nGridHeight;
+    int m_nSrcWidth;  // size of the image the table samples from
+    int m_nSrcHeight;
+  };
+
+  /// Accuracy of a SparseLookupTable against the exact per-pixel warp, in
+  /// source image pixels. Coordinates are clamped to the source image as
+  /// Rectify does before being compared.
+  struct SparseLookupTableError
+  {
+    double max_error;
+    double rms_error;
+  };
+
+  /// Create a sparse lookup table with one control point every 'step'
+  /// output pixels, remapping 'cam_from' to the linear, potentially rotated
+  /// model R_onKinv (see CreateLookupTable). lookup_width/height default to
+  /// the camera image size.
+  CALIBU_EXPORT void CreateSparseLookupTable(
+      const std::shared_ptr<calibu::CameraInterface<double>>& cam_from,
+      const Eigen::Matrix3d& R_onKinv,
+      int step,
+      SparseLookupTable& lut,
+      int lookup_width = 0,
+      int lookup_height = 0,
+      unsigned int num_threads = 1
+      );
+
+  /// Compare every interpolated coordinate of 'lut' with the exact
+  /// projection through 'cam_from'.
+  CALIBU_EXPORT SparseLookupTableError ComputeSparseLookupTableError(
+      const std::shared_ptr<calibu::CameraInterface<double>>& cam_from,
+      const Eigen::Matrix3d& R_onKinv,
+      const SparseLookupTable& lut,
+      unsigned int num_threads = 1
+      );
+
+  /// Largest power of two step, up to max_step, whose sparse table stays
+  /// within max_error source pixels of the exact warp. Returns 1 if no
+  /// coarser step qualifies.
+  CALIBU_EXPORT int ChooseSparseLookupTableStep(
+      const std::shared_ptr<calibu::CameraInterface<double>>& cam_from,
+      const Eigen::Matrix3d& R_onKinv,
+      double max_error,
+      int max_step = 32,
+      int lookup_width = 0,
+      int lookup_height = 0,
+      unsigned int num_threads = 1
+      );
+
+  /// Rectify image pInputImageData with a sparse lookup table, with the
+  /// same border handling as the dense LookupTable. Rows are split into
+  /// num_threads bands (0 for one per core).
+  template <typename scalar>
+  void Rectify(
+          const SparseLookupTable& lut,
+          const scalar* pInputImageData,
+          scalar* pOutputRectImageData,
+          int w, int h, int channels = 1,
+          unsigned int num_threads = 1
+          )
+  {
+    // Make sure we have been given a correct lookup table.
+    assert(w == (int)lut.Width() && h == (int)lut.Height());
+
+    const int src_width = lut.m_nSrcWidth;
+    const int src_height = lut.m_nSrcHeight;
+    const float max_u = src_width - 1.0f;
+    const float max_v = src_height - 1.0f;
+    const float inv_step = 1.0f / lut.m_nStep;
+
+    ParallelForBands( h, num_threads, [&]( int row_begin, int row_end ) {
+      // Control points interpolated down to the current output row.
+      std::vector<Eigen::Vector2f> row_grid( lut.m_nGridWidth );
+      scalar* pOutput = pOutputRectImageData + row_begin * w * channels;
+
+      for( int r = row_begin; r < row_end; ++r ) {
+        const int gr = std::min( r / lut.m_nStep, lut.m_nGridHeight - 2 );
+        const float fr = (r - gr * lut.m_nStep) * inv_step;
+        for( int gc = 0; gc < lut.m_nGridWidth; ++gc ) {
+          row_grid[gc] = (1 - fr) * lut.GridPoint( gr, gc ) +
+                              fr  * lut.GridPoint( gr + 1, gc );
+        }
+
+        for( int c = 0; c < w; ++c ) {
+          const int gc = std::min( c / lut.m_nStep, lut.m_nGridWidth - 2 );
+          const float fc = (c - gc * lut.m_nStep) * inv_step;
+          const Eigen::Vector2f p = (1 - fc) * row_grid[gc] +
+                                         fc  * row_grid[gc + 1];
+
+          // Clamp and sample exactly as the dense LUT does.
+          const float pu = std::min( std::max( 0.0f, p[0] ), max_u );
+          const float pv = std::min( std::max( 0.0f, p[1] ), max_v );
+          int u = (int) pu;
+          int v = (int) pv;
+          float su = pu - u;
+          float sv = pv - v;
+          if( u == src_width - 1 ) {
+            u -= 1;
+            su = 1.0f;
+          }
+          if( v == src_height - 1 ) {
+            v -= 1;
+            sv = 1.0f;
+          }
+
+          const int idx0 = u + v * src_width;
+          const int idx1 = idx0 + src_width;
+          const float w00 = (1 - su) * (1 - sv);
+          const float w01 =      su  * (1 - sv);
+          const float w10 = (1 - su) *      sv;
+          const float w11 =      su  *      sv;
+
+          for( int n_channel = 0; n_channel < channels; ++n_channel ) {
+            *pOutput++ = RectifyPixel<scalar>::Convert(
+                w00 * pInputImageData[idx0 * channels + n_channel] +
+                w01 * pInputImageData[(idx0 + 1) * channels + n_channel] +
+                w10 * pInputImageData[idx1 * channels + n_channel] +
+                w11 * pInputImageData[(idx1 + 1) * channels + n_channel] );
+          }
+        }
+      }
+    } );
+  }
+
+}
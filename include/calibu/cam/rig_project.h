@@ -0,0 +1,125 @@
+/*
+   This file is part of the Calibu Project.
+   https://github.com/arpg/Calibu
+
+   Copyright (C) 2013 George Washington University,
+                      Steven Lovegrove,
+                      Gabe Sibley
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+   http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+
+#pragma once
+
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <vector>
+
+#include <Eigen/Eigen>
+#include <Eigen/StdVector>
+
+#include <calibu/Platform.h>
+#include <calibu/cam/camera_crtp.h>
+
+namespace calibu
+{
+
+/// Point 'index' of a point set seen at pixel (u, v) of a camera.
+struct RigProjection
+{
+    uint32_t index;
+    double u;
+    double v;
+};
+
+/// Projects point sets given in the rig frame, e.g. maps or LiDAR sweeps,
+/// into every camera of a rig. Each camera's extrinsics and field of view
+/// are taken once by Init. Points are then moved into each camera's frame,
+/// those outside of its depth range or field of view are culled, and the
+/// rest are projected in batches and kept if they land in the image.
+/// Cameras are projected through snapshots, see CameraSnapshot, so Project
+/// may run while the rig's cameras are being modified.
+class CALIBU_EXPORT RigProjector
+{
+public:
+    RigProjector();
+
+    /// Take the poses and fields of view of the rig's cameras. Points
+    /// closer to a camera's center than min_range, or further than
+    /// max_range, are culled. The field of view is bounded from rays
+    /// through the image border every border_step pixels.
+    void Init(
+        const std::shared_ptr<calibu::Rig<double>>& rig,
+        double min_range = 0,
+        double max_range = std::numeric_limits<double>::infinity(),
+        int border_step = 8
+        );
+
+    size_t NumCams() const
+    {
+        return cams_.size();
+    }
+
+    /// Half angle of the cone around camera cam's optical axis, in radians,
+    /// outside of which points are culled. Above pi/2 for fisheye cameras
+    /// seeing behind themselves.
+    double HalfFov( size_t cam ) const;
+
+    /// Project points P_r[0..count) into every camera. projections[c] is
+    /// replaced by the points camera c sees, in increasing index order.
+    /// Cameras are split between num_threads threads (0 for one per core).
+    void Project(
+        const Eigen::Vector3d* P_r,
+        size_t count,
+        std::vector<std::vector<RigProjection> >& projections,
+        unsigned int num_threads = 1
+        ) const;
+
+    void Project(
+        const std::vector<Eigen::Vector3d, Eigen::aligned_allocator<Eigen::Vector3d> >& P_r,
+        std::vector<std::vector<RigProjection> >& projections,
+        unsigned int num_threads = 1
+        ) const
+    {
+        Project( P_r.data(), P_r.size(), projections, num_threads );
+    }
+
+protected:
+    struct CameraView
+    {
+        EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+        std::shared_ptr<const CameraSnapshot<double> > camera;
+        Eigen::Matrix3d R_cr;
+        Eigen::Vector3d t_cr;
+        double half_fov;
+        double cos_fov;
+        double width;
+        double height;
+    };
+
+    void ProjectCamera(
+        const CameraView& view,
+        const Eigen::Vector3d* P_r,
+        size_t count,
+        std::vector<RigProjection>& projections
+        ) const;
+
+    std::vector<CameraView, Eigen::aligned_allocator<CameraView> > cams_;
+    double min_range_;
+    double max_range_;
+};
+
+}
@@ -0,0 +1,112 @@
+/*
+   This file is part of the Calibu Project.
+   https://github.com/arpg/Calibu
+
+   Copyright (C) 2013 George Washington University,
+                      Steven Lovegrove,
+                      Gabe Sibley
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+   http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#pragma once
+
+#include <vector>
+
+#include <calibu/Platform.h>
+#include <calibu/cam/camera_crtp.h>
+#include <calibu/cam/lookup_table_cache.h>
+#include <calibu/cam/rectify_crtp.h>
+#include <calibu/cam/stereo_rectify.h>
+
+namespace calibu
+{
+
+/// Common-plane rectification of every camera of a rig, for multi-baseline
+/// stereo. All cameras are rotated to one orientation, whose x-axis follows
+/// the line best fitting the camera centers, and share the intrinsics of one
+/// virtual LinearCamera chosen so that every rectified image stays inside its
+/// source image. Cameras along that line then share scanlines. As with
+/// StereoRectifier, border rays are cached per camera.
+class CALIBU_EXPORT RigRectifier
+{
+public:
+    RigRectifier();
+
+    /// Compute the rectified rig and one lookup table per camera. Tables are
+    /// built concurrently, sharing num_threads threads (0 for one per core).
+    /// The virtual cameras have the image size of the first camera.
+    /// cache: Optional on-disk cache of lookup tables.
+    void Init(
+        const std::shared_ptr<calibu::Rig<double>>& rig,
+        LookupTableCache* cache = nullptr,
+        unsigned int num_threads = 0
+        );
+
+    /// Rectified rig, with camera poses in the frame of the source rig.
+    const std::shared_ptr<calibu::Rig<double>>& RectifiedRig() const
+    {
+        return rig_;
+    }
+
+    /// Rotation from the source rig frame to that of every rectified camera.
+    const Eigen::Matrix3d& R_nr() const
+    {
+        return R_nr_;
+    }
+
+    size_t NumCams() const
+    {
+        return luts_.size();
+    }
+
+    /// Lookup table from rectified camera 'cam' to the source camera.
+    const LookupTable& GetLookupTable( size_t cam ) const
+    {
+        return luts_[cam];
+    }
+
+    /// Size of each rectified image.
+    int Width() const
+    {
+        return luts_.empty() ? 0 : luts_[0].Width();
+    }
+
+    int Height() const
+    {
+        return luts_.empty() ? 0 : luts_[0].Height();
+    }
+
+    /// Rectify image 'in' of camera 'cam' to 'out' of Width() * Height()
+    /// pixels. Rows are split into num_threads bands (0 for one per core).
+    template <typename scalar>
+    void Rectify(
+        size_t cam,
+        const scalar* in,
+        scalar* out,
+        int channels = 1,
+        unsigned int num_threads = 1
+        ) const
+    {
+        calibu::Rectify( luts_[cam], in, out, Width(), Height(), channels,
+                         num_threads );
+    }
+
+protected:
+    std::shared_ptr<calibu::Rig<double>> rig_;
+    Eigen::Matrix3d R_nr_;
+    std::vector<LookupTable> luts_;
+    std::vector<RectifyBorderRays> rays_;
+};
+
+}
@@ -21,12 +21,19 @@
 
 #pragma once
 
+#include <algorithm>
+#include <string>
+#include <vector>
+
 #include <sophus/se3.hpp>
 
 #include <calibu/Platform.h>
 #include <calibu/cam/camera_crtp.h>
+#include <calibu/cam/lookup_table_cache.h>
 #include <calibu/cam/rectify_crtp.h>
 #include <calibu/cam/camera_models_crtp.h>
+#include <calibu/utils/Parallel.h>
+#include <calibu/utils/Range.h>
 
 namespace calibu
 {
@@ -35,6 +42,7 @@ namespace calibu
 /// and output their new intrinsics and extrinsics.
 /// Returns: New camera rig (intrinsics same for both cameras)
 /// T_nr_nl: New scanline rectified extrinsics considering rotation applied in lookup tables.
+/// cache: Optional on-disk cache the lookup tables are loaded from / saved to.
     CALIBU_EXPORT
     std::shared_ptr<calibu::Rig<double> > CreateScanlineRectifiedLookupAndCameras(
         const Sophus::SE3d& T_rl,
@@ -42,8 +50,152 @@ namespace calibu
         const std::shared_ptr<calibu::CameraInterface<double>> cam_right,
         Sophus::SE3d& T_nr_nl,
         LookupTable& left_lut,
-        LookupTable& right_lut
+        LookupTable& right_lut,
+        LookupTableCache* cache = nullptr
+        );
+
+/// Layout of a rectified stereo pair written to a single buffer.
+enum StereoLayout {
+    STEREO_SIDE_BY_SIDE, // each row holds the left row then the right row
+    STEREO_INTERLEAVED   // left and right pixels alternate along each row
+};
+
+/// Rays through the image border of a camera, from which the range of
+/// rectified coordinates that stay inside the image is found for any
+/// rotation, as MinMaxRotatedCol and MinMaxRotatedRow. The border is only
+/// unprojected again when the camera model changes.
+class CALIBU_EXPORT RectifyBorderRays
+{
+public:
+    /// Unproject the border of 'cam' unless already cached.
+    void Update( const calibu::CameraInterface<double>& cam );
+
+    /// Horizontal and vertical range of the rays rotated by R_nc.
+    Range RotatedColRange( const Eigen::Matrix3d& R_nc ) const;
+    Range RotatedRowRange( const Eigen::Matrix3d& R_nc ) const;
+
+protected:
+    std::string type_;
+    Eigen::VectorXd params_;
+    int width_ = 0;
+    int height_ = 0;
+
+    Eigen::Matrix3Xd left_, right_;  // first and last column, per row
+    Eigen::Matrix3Xd top_, bottom_;  // first and last row, per column
+};
+
+/// Scanline rectification of a stereo pair, as computed by
+/// CreateScanlineRectifiedLookupAndCameras, that keeps both lookup tables to
+/// rectify pairs into a single buffer. The new intrinsics keep both
+/// rectified images inside their source images. The rays through each
+/// camera's image border are cached, so re-rectifying after a change of
+/// extrinsics only unprojects the borders of cameras whose model changed.
+class CALIBU_EXPORT StereoRectifier
+{
+public:
+    StereoRectifier();
+
+    /// Compute rectified cameras and lookup tables for the pair. The two
+    /// tables are built concurrently, sharing num_threads threads (0 for one
+    /// per core). cache: Optional on-disk cache of lookup tables.
+    void Init(
+        const Sophus::SE3d& T_rl,
+        const std::shared_ptr<calibu::CameraInterface<double>>& cam_left,
+        const std::shared_ptr<calibu::CameraInterface<double>>& cam_right,
+        LookupTableCache* cache = nullptr,
+        unsigned int num_threads = 0
         );
 
+    /// New camera rig (intrinsics same for both cameras).
+    const std::shared_ptr<calibu::Rig<double>>& RectifiedRig() const
+    {
+        return rig_;
+    }
+
+    /// New scanline rectified extrinsics.
+    const Sophus::SE3d& T_nr_nl() const
+    {
+        return T_nr_nl_;
+    }
+
+    const LookupTable& LeftLookupTable() const
+    {
+        return left_lut_;
+    }
+
+    const LookupTable& RightLookupTable() const
+    {
+        return right_lut_;
+    }
+
+    /// Size of each rectified image.
+    int Width() const
+    {
+        return left_lut_.Width();
+    }
+
+    int Height() const
+    {
+        return left_lut_.Height();
+    }
+
+    /// Rectify images 'left' and 'right' into one buffer 'out' of 2 * Width()
+    /// * Height() pixels laid out as 'layout'. Channels are interleaved
+    /// within each pixel. Rows are split into num_threads bands (0 for one
+    /// per core).
+    template <typename scalar>
+    void Rectify(
+        const scalar* left,
+        const scalar* right,
+        scalar* out,
+        StereoLayout layout = STEREO_SIDE_BY_SIDE,
+        int channels = 1,
+        unsigned int num_threads = 1
+        ) const
+    {
+        const int w = Width();
+        const BilinearLutPoint* left_points = left_lut_.m_vLutPixels.data();
+        const BilinearLutPoint* right_points = right_lut_.m_vLutPixels.data();
+
+        ParallelForBands( Height(), num_threads,
+                          [&]( int row_begin, int row_end ) {
+            std::vector<scalar> rows;
+            if( layout == STEREO_INTERLEAVED ) {
+                rows.resize( 2 * w * channels );
+            }
+
+            for( int row = row_begin; row < row_end; ++row ) {
+                scalar* out_row = out + (size_t)row * 2 * w * channels;
+                scalar* left_row = out_row;
+                scalar* right_row = out_row + w * channels;
+                if( layout == STEREO_INTERLEAVED ) {
+                    left_row = rows.data();
+                    right_row = rows.data() + w * channels;
+                }
+
+                calibu::Rectify( left_points + row * w, w, 1, left, left_row, channels );
+                calibu::Rectify( right_points + row * w, w, 1, right, right_row, channels );
+
+                if( layout == STEREO_INTERLEAVED ) {
+                    for( int x = 0; x < w; ++x ) {
+                        std::copy( left_row + x * channels, left_row + (x + 1) * channels,
+                                   out_row + 2 * x * channels );
+                        std::copy( right_row + x * channels, right_row + (x + 1) * channels,
+                                   out_row + (2 * x + 1) * channels );
+                    }
+                }
+            }
+        } );
+    }
+
+protected:
+    std::shared_ptr<calibu::Rig<double>> rig_;
+    Sophus::SE3d T_nr_nl_;
+    LookupTable left_lut_;
+    LookupTable right_lut_;
+    RectifyBorderRays left_rays_;
+    RectifyBorderRays right_rays_;
+};
+
 }
 
@@ -67,6 +67,15 @@ std::pair<Eigen::Vector3d,Eigen::Matrix3d > PlaneFromConics(
 CALIBU_EXPORT
 Conic UnmapConic( const Conic& c, const std::shared_ptr<CameraInterface<double>> cam );
 
+/** UnmapConic of every conic, unprojecting them together through the batch
+ *  camera API, on num_threads threads (0 for one per core). */
+CALIBU_EXPORT
+void UnmapConics(
+    const std::vector<Conic, Eigen::aligned_allocator<Conic> >& conics,
+    const std::shared_ptr<CameraInterface<double>> cam,
+    std::vector<Conic, Eigen::aligned_allocator<Conic> >& unmapped,
+    unsigned int num_threads = 1 );
+
 /** Returns the major and minor axes lengths of the conic */
 CALIBU_EXPORT
 Eigen::Vector2d GetAxesLengths(const Conic& c);
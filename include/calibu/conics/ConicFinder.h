@@ -20,6 +20,7 @@
 
 #pragma once
 
+#include <memory>
 #include <vector>
 #include <Eigen/Eigen>
 #include <Eigen/StdVector>
@@ -27,24 +28,70 @@
 #include <calibu/Platform.h>
 #include <calibu/image/ImageProcessing.h>
 #include <calibu/conics/Conic.h>
+#include <calibu/conics/ConicSet.h>
 
 namespace calibu {
 
+enum ConicFinderMethod {
+    // OpenCV SimpleBlobDetector on the thresholded image, sweeping
+    // blob_min_threshold..blob_max_threshold in steps of blob_threshold_step
+    CONIC_FINDER_BLOBS,
+    // Candidates from the connected components found by ImageProcessing,
+    // filtered by the conic_* parameters and fit with FindConics. Avoids the
+    // multi threshold sweep.
+    CONIC_FINDER_LABELS
+
+    // Images processed with ParamsImageProcessing::use_cuda always use the
+    // moments of their components instead, see ConicFromMoments, filtered
+    // as CONIC_FINDER_LABELS and refined on the input image.
+};
+
 struct ParamsConicFinder
 {
     ParamsConicFinder() :
+        method(CONIC_FINDER_BLOBS),
         conic_min_area(25),
         conic_max_area(4E4),
         conic_min_density(0.4),
-        conic_min_aspect(0.1)
+        conic_min_aspect(0.1),
+        blob_min_threshold(0),
+        blob_max_threshold(90),
+        blob_threshold_step(45),
+        blob_min_dist_between_blobs(2.5),
+        blob_min_area(3.7),
+        blob_filter_by_convexity(true),
+        blob_min_convexity(0.89375),
+        blob_filter_by_inertia(false),
+        num_threads(1),
+        refine_margin(2)
     {
 
     }
 
+    ConicFinderMethod method;
+
+    // CONIC_FINDER_LABELS candidate filter
     float conic_min_area;
     float conic_max_area;
     float conic_min_density;
     float conic_min_aspect;
+
+    // CONIC_FINDER_BLOBS detector, see cv::SimpleBlobDetector::Params
+    float blob_min_threshold;
+    float blob_max_threshold;
+    float blob_threshold_step;
+    float blob_min_dist_between_blobs;
+    float blob_min_area;
+    bool blob_filter_by_convexity;
+    float blob_min_convexity;
+    bool blob_filter_by_inertia;
+
+    // Threads fitting CONIC_FINDER_LABELS candidates (0 for one per core)
+    unsigned int num_threads;
+
+    // Pixels around a blob found at a pyramid level searched when refining
+    // it at full resolution, in addition to one pyramid level pixel.
+    int refine_margin;
 };
 
 
@@ -52,10 +99,12 @@ class CALIBU_EXPORT ConicFinder
 {
 public:
     ConicFinder();
+    ~ConicFinder();
     void Find(const ImageProcessing& imgs, const std::shared_ptr<calibu::CameraInterface<double>> camera = nullptr);
 
-  inline const std::vector<Conic, Eigen::aligned_allocator<Conic> >&
-  Conics() const {
+    // Conics found by the last call to Find, shared by reference with the
+    // target and trackers
+    inline const ConicSet& Conics() const {
         return conics;
     }
 
@@ -66,11 +115,32 @@ public:
     EIGEN_MAKE_ALIGNED_OPERATOR_NEW
 
 protected:
+    void FindBlobs(const ImageProcessing& imgs);
+    void FindFromLabels(const ImageProcessing& imgs);
+    void FindFromMoments(const ImageProcessing& imgs);
+
+    // Refine conic found at a pyramid level of imgs with FindEllipse on the
+    // full resolution input. Returns false, leaving conic unchanged, if the
+    // fit fails.
+    bool RefineConic(const ImageProcessing& imgs, Conic& conic);
+
     // Output of this class
   std::vector<PixelClass> candidates;
-  std::vector<Conic, Eigen::aligned_allocator<Conic> > conics;
+  ConicSet conics;
+
+  // Conics being fit, before they are added to conics
+  std::vector<Conic, Eigen::aligned_allocator<Conic> > fitted;
+
+  // Gradient of the window being refined
+  std::vector<int16_t> window_dx;
+  std::vector<int16_t> window_dy;
 
   ParamsConicFinder params;
+
+  // Blob detector, kept across calls and only recreated when the blob_*
+  // parameters change
+  struct BlobDetector;
+  std::unique_ptr<BlobDetector> blob_detector;
 };
 
 }
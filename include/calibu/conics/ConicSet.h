@@ -0,0 +1,188 @@
+/*
+   This file is part of the Calibu Project.
+   https://github.com/gwu-robotics/Calibu
+
+   Copyright (C) 2013 George Washington University,
+                      Steven Lovegrove
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+   http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#pragma once
+
+#include <array>
+#include <memory>
+#include <vector>
+
+#include <Eigen/Dense>
+#include <Eigen/StdVector>
+
+#include <calibu/Platform.h>
+#include <calibu/conics/Conic.h>
+#include <calibu/utils/Rectangle.h>
+
+namespace calibu {
+
+/// Structure of arrays set of conics. Centres, undistorted centres, radii
+/// and bounding boxes are each contiguous, and the quadratic form is kept
+/// as its 6 distinct coefficients. C and its dual are only formed when
+/// asked for, so a detection pass that only needs centres touches a small
+/// fraction of the memory of a std::vector<Conic>.
+class ConicSet
+{
+public:
+    typedef std::vector<Eigen::Vector2d, Eigen::aligned_allocator<Eigen::Vector2d> > Centers;
+    typedef std::vector<Eigen::Vector3d, Eigen::aligned_allocator<Eigen::Vector3d> > Rays;
+
+    ConicSet() {}
+
+    /// Copy of conics, for code still producing a std::vector<Conic>.
+    ConicSet(const std::vector<Conic, Eigen::aligned_allocator<Conic> >& conics)
+    {
+        reserve(conics.size());
+        for (const Conic& c : conics) {
+            push_back(c);
+        }
+    }
+
+    inline size_t size() const { return centers_.size(); }
+    inline bool empty() const { return centers_.empty(); }
+
+    inline void clear()
+    {
+        centers_.clear();
+        centers_undistorted_.clear();
+        radii_.clear();
+        bboxes_.clear();
+        coeffs_.clear();
+    }
+
+    inline void reserve(size_t n)
+    {
+        centers_.reserve(n);
+        centers_undistorted_.reserve(n);
+        radii_.reserve(n);
+        bboxes_.reserve(n);
+        coeffs_.reserve(n);
+    }
+
+    inline void resize(size_t n)
+    {
+        centers_.resize(n);
+        centers_undistorted_.resize(n, Eigen::Vector3d::Zero());
+        radii_.resize(n, 0.0);
+        bboxes_.resize(n, IRectangle(0, 0, 0, 0));
+        coeffs_.resize(n, Coefficients{{0, 0, 0, 0, 0, 0}});
+    }
+
+    inline void push_back(const Conic& c)
+    {
+        centers_.push_back(c.center);
+        centers_undistorted_.push_back(c.center_undistorted);
+        radii_.push_back(c.radius);
+        bboxes_.push_back(c.bbox);
+        coeffs_.push_back(Coefficients{{c.C(0,0), c.C(0,1), c.C(0,2),
+                                        c.C(1,1), c.C(1,2), c.C(2,2)}});
+    }
+
+    /// Overwrite conic i with c.
+    inline void Set(size_t i, const Conic& c)
+    {
+        centers_[i] = c.center;
+        centers_undistorted_[i] = c.center_undistorted;
+        radii_[i] = c.radius;
+        bboxes_[i] = c.bbox;
+        SetC(i, c.C);
+    }
+
+    inline const Eigen::Vector2d& Center(size_t i) const { return centers_[i]; }
+    inline Eigen::Vector2d& Center(size_t i) { return centers_[i]; }
+
+    inline const Eigen::Vector3d& CenterUndistorted(size_t i) const { return centers_undistorted_[i]; }
+    inline Eigen::Vector3d& CenterUndistorted(size_t i) { return centers_undistorted_[i]; }
+
+    inline double Radius(size_t i) const { return radii_[i]; }
+    inline double& Radius(size_t i) { return radii_[i]; }
+
+    inline const IRectangle& BBox(size_t i) const { return bboxes_[i]; }
+    inline IRectangle& BBox(size_t i) { return bboxes_[i]; }
+
+    /// Contiguous centres of all conics.
+    inline const Centers& CentersData() const { return centers_; }
+
+    /// Contiguous undistorted centres of all conics.
+    inline const Rays& CentersUndistortedData() const { return centers_undistorted_; }
+
+    /// Quadratic form of conic i, x'*C*x = 0.
+    inline Eigen::Matrix3d C(size_t i) const
+    {
+        const Coefficients& k = coeffs_[i];
+        Eigen::Matrix3d C;
+        C << k[0], k[1], k[2],
+             k[1], k[3], k[4],
+             k[2], k[4], k[5];
+        return C;
+    }
+
+    inline void SetC(size_t i, const Eigen::Matrix3d& C)
+    {
+        coeffs_[i] = Coefficients{{C(0,0), C(0,1), C(0,2),
+                                   C(1,1), C(1,2), C(2,2)}};
+    }
+
+    /// Dual of conic i, C^{-1} scaled so that Dual(2,2) = 1.
+    inline Eigen::Matrix3d Dual(size_t i) const
+    {
+        Eigen::Matrix3d D = C(i).inverse();
+        D /= D(2,2);
+        return D;
+    }
+
+    /// Conic i with all of its fields formed.
+    inline Conic Get(size_t i) const
+    {
+        Conic c;
+        c.bbox = bboxes_[i];
+        c.C = C(i);
+        c.Dual = Dual(i);
+        c.center = centers_[i];
+        c.center_undistorted = centers_undistorted_[i];
+        c.radius = radii_[i];
+        return c;
+    }
+
+    inline Conic operator[](size_t i) const
+    {
+        return Get(i);
+    }
+
+private:
+    typedef std::array<double,6> Coefficients;
+
+    Centers centers_;
+    Rays centers_undistorted_;
+    std::vector<double> radii_;
+    std::vector<IRectangle> bboxes_;
+    std::vector<Coefficients> coeffs_;
+};
+
+/** UnmapConics of every conic in the set, see UnmapConic. Radii, bounding
+ *  boxes and undistorted centres are carried over from conics. */
+CALIBU_EXPORT
+void UnmapConics(
+    const ConicSet& conics,
+    const std::shared_ptr<CameraInterface<double>> cam,
+    ConicSet& unmapped,
+    unsigned int num_threads = 1 );
+
+}
@@ -20,6 +20,9 @@
 
 #pragma once
 
+#include <cstdint>
+#include <vector>
+
 #include <Eigen/Dense>
 
 #include <calibu/Platform.h>
@@ -36,6 +39,30 @@ Eigen::Matrix3d FindEllipse(
         double& /*residual*/
         );
 
+/// FindEllipse for a gradient stored as planar dx and dy images, as
+/// computed by GradientPlanar.
+CALIBU_EXPORT
+Eigen::Matrix3d FindEllipse(
+        const int w, const int h,
+        const int16_t* dx, const int16_t* dy,
+        const IRectangle& r,
+        double& residual
+        );
+
+/// True if the component 'label' of a w x h image lies away from its
+/// border, and its bounding box has an area within [min_area, max_area] and
+/// an aspect ratio within (min_aspect, 1 / min_aspect).
+CALIBU_EXPORT
+bool IsCandidateConic(
+        unsigned w, unsigned h,
+        const PixelClass& label,
+        float min_area,
+        float max_area,
+        float min_aspect
+        );
+
+/// Append the labels for which IsCandidateConic holds to candidates, with
+/// their bounding boxes grown by 2 pixels.
 CALIBU_EXPORT
 void FindCandidateConicsFromLabels(
         unsigned w, unsigned h,
@@ -47,12 +74,38 @@ void FindCandidateConicsFromLabels(
         float min_aspect
         );
 
+/// Conic of the filled ellipse with the centroid and second moments of a
+/// component whose bounding box is bbox. A filled ellipse whose points have
+/// covariance S is bounded by (x - c)' (4 S)^-1 (x - c) = 1. Returns false,
+/// leaving conic unchanged, for degenerate moments, e.g. of a line of
+/// pixels.
+CALIBU_EXPORT
+bool ConicFromMoments(
+        const BlobMoments& moments,
+        const IRectangle& bbox,
+        Conic& conic
+        );
+
+/// Fit a conic to the gradient within the bbox of each candidate and
+/// append those centred in their bbox to conics, in candidate order.
+/// Candidates are split over num_threads threads (0 for one per core).
 template<typename TdI>
 void FindConics(
         const int w, const int h,
         const std::vector<PixelClass>& candidates,
         const TdI* dI,
-        std::vector<Conic, Eigen::aligned_allocator<Conic> >& conics
+        std::vector<Conic, Eigen::aligned_allocator<Conic> >& conics,
+        unsigned int num_threads = 1
+        );
+
+/// FindConics for a gradient stored as planar dx and dy images.
+CALIBU_EXPORT
+void FindConics(
+        const int w, const int h,
+        const std::vector<PixelClass>& candidates,
+        const int16_t* dx, const int16_t* dy,
+        std::vector<Conic, Eigen::aligned_allocator<Conic> >& conics,
+        unsigned int num_threads = 1
         );
 
 }
@@ -23,6 +23,8 @@
 #include <calibu/Platform.h>
 
 #include <algorithm>
+#include <cstddef>
+#include <cstdint>
 
 namespace calibu {
 
@@ -81,4 +83,14 @@ void AdaptiveThreshold( int w, int h, const TI* I, const TintI* intI, Tout* out,
     }
 }
 
+// As the min diff variant above, for an 8 bit image whose rows are pitch
+// bytes apart and its contiguous integral image (see integral_image). The
+// box bounds are computed once per row and pixels whose box is not clipped
+// by the image border are thresholded with SSE2 / NEON, without branches.
+// The output is identical to the template version.
+CALIBU_EXPORT void AdaptiveThreshold(
+        int w, int h, size_t pitch, const unsigned char* I, const uint32_t* intI,
+        unsigned char* out, float threshold, int rad, int min_diff,
+        unsigned char pass, unsigned char fail );
+
 }
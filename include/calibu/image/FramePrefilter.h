@@ -0,0 +1,113 @@
+/*
+  This file is part of the Calibu Project.
+  https://github.com/gwu-robotics/Calibu
+
+  Copyright (C) 2013 George Washington University,
+  Steven Lovegrove
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+  http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+#pragma once
+
+#include <calibu/Platform.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace calibu {
+
+struct ParamsFramePrefilter {
+  ParamsFramePrefilter() : min_sharpness(0),
+                           min_difference(0),
+                           thumbnail_scale(8) {}
+
+  // Skip frames with an image less sharp than this, see
+  // FramePrefilter::Sharpness. 0 keeps blurred frames.
+  double min_sharpness;
+
+  // Skip frames whose thumbnails all differ from those of the last frame
+  // kept by less than this mean absolute grey level. 0 keeps duplicates.
+  double min_difference;
+
+  // Thumbnail pixels are the means of thumbnail_scale^2 image pixels.
+  int thumbnail_scale;
+};
+
+// Greyscale image with rows pitch bytes apart.
+struct PrefilterImage {
+  const unsigned char* data;
+  size_t w;
+  size_t h;
+  size_t pitch;
+};
+
+// Cheap test of whether a frame is worth detecting the target in, ahead of
+// ImageProcessing. Frames blurred by motion, and frames nearly the same as
+// the last one kept, e.g. most of a slow hand-held sweep, are skipped.
+// Frames must be given in order, as each is compared to the last kept.
+class CALIBU_EXPORT FramePrefilter {
+ public:
+  FramePrefilter();
+
+  // Whether to keep the frame made of images[0..count), one per camera. A
+  // frame is kept if all of its images are sharp enough and any of them
+  // differs enough from the last frame kept, which it then replaces.
+  bool Accept(const PrefilterImage* images, size_t count);
+
+  bool Accept(const unsigned char* image, size_t w, size_t h, size_t pitch) {
+    const PrefilterImage view = {image, w, h, pitch};
+    return Accept(&view, 1);
+  }
+
+  // Variance of the Laplacian of image at half resolution, in squared grey
+  // levels, which drops as the image blurs.
+  double Sharpness(const PrefilterImage& image);
+
+  // Measures of image i of the last frame given to Accept. They are 0 when
+  // not measured, as their threshold is 0 or the frame was already found
+  // blurred. Difference is infinite with no frame kept to compare to.
+  double LastSharpness(size_t i) const { return sharpness_[i]; }
+  double LastDifference(size_t i) const { return difference_[i]; }
+
+  size_t NumAccepted() const { return num_accepted_; }
+  size_t NumBlurred() const { return num_blurred_; }
+  size_t NumDuplicates() const { return num_duplicates_; }
+
+  ParamsFramePrefilter& Params() { return params_; }
+
+ protected:
+  struct Thumbnail {
+    size_t w = 0;
+    size_t h = 0;
+    size_t scale = 1;
+    std::vector<uint32_t> sums;
+  };
+
+  void MakeThumbnail(const PrefilterImage& image, Thumbnail& thumbnail) const;
+
+  static double Difference(const Thumbnail& a, const Thumbnail& b);
+
+  ParamsFramePrefilter params_;
+  std::vector<Thumbnail> last_;
+  std::vector<Thumbnail> candidate_;
+  std::vector<double> sharpness_;
+  std::vector<double> difference_;
+  std::vector<uint16_t> half_;
+  size_t num_accepted_;
+  size_t num_blurred_;
+  size_t num_duplicates_;
+};
+
+}  // namespace calibu
@@ -20,7 +20,11 @@
 
 #pragma once
 
+#include <cstddef>
+#include <cstdint>
+
 #include <calibu/Platform.h>
+#include <calibu/image/ImageKernel.h>
 
 namespace calibu {
 
@@ -40,4 +44,43 @@ void gradient(const int w, const int h, const TI* I, TD* grad)
     }
 }
 
+// As above, for an input image whose rows are pitch bytes apart. The output
+// is contiguous.
+template<typename TI, typename TD>
+void gradient(const int w, const int h, const size_t pitch, const TI* I, TD* grad)
+{
+    if(pitch == w * sizeof(TI)) {
+        gradient<TI,TD>(w, h, I, grad);
+        return;
+    }
+
+    const unsigned char* rows = reinterpret_cast<const unsigned char*>(I);
+    for(int y = 1; y < h - 1; ++y) {
+        const TI* pI = reinterpret_cast<const TI*>(rows + y * pitch);
+        const TI* pU = reinterpret_cast<const TI*>(rows + (y - 1) * pitch);
+        const TI* pD = reinterpret_cast<const TI*>(rows + (y + 1) * pitch);
+        TD* pOut = grad + y * w;
+        for(int x = 1; x < w - 1; ++x) {
+            pOut[x][0] = pI[x+1] - pI[x-1];
+            pOut[x][1] = pD[x] - pU[x];
+        }
+    }
+}
+
+// Central difference gradient of an 8 bit image whose rows are pitch bytes
+// apart, written as planar dx and dy images of w*h elements. Unlike the
+// templates above, the one pixel image border is set to zero. All kernels
+// produce identical output; one that is not supported falls back to the
+// scalar loop.
+CALIBU_EXPORT void GradientPlanar(
+        int w, int h, size_t pitch, const unsigned char* I,
+        int16_t* dx, int16_t* dy, ImageKernel kernel = IMAGE_KERNEL_AUTO );
+
+// As above, writing output rows stride elements apart. This lets the
+// gradient of an image region be written into a larger image.
+CALIBU_EXPORT void GradientPlanar(
+        int w, int h, size_t pitch, const unsigned char* I,
+        int16_t* dx, int16_t* dy, size_t stride,
+        ImageKernel kernel = IMAGE_KERNEL_AUTO );
+
 }
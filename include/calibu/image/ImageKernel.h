@@ -0,0 +1,43 @@
+/*
+   This file is part of the Calibu Project.
+   https://github.com/gwu-robotics/Calibu
+
+   Copyright (C) 2013 George Washington University,
+                      Steven Lovegrove
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+   http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#pragma once
+
+#include <calibu/Platform.h>
+
+namespace calibu {
+
+/// Instruction set used by the vectorized per pixel image kernels
+/// (GradientPlanar, IntegralImage).
+enum ImageKernel {
+    IMAGE_KERNEL_AUTO,   // best kernel supported by the running CPU
+    IMAGE_KERNEL_SCALAR,
+    IMAGE_KERNEL_SSE2,
+    IMAGE_KERNEL_AVX2,
+    IMAGE_KERNEL_NEON
+};
+
+/// True if kernel can run on this CPU and was compiled into this build.
+CALIBU_EXPORT bool ImageKernelSupported( ImageKernel kernel );
+
+/// Best kernel supported by the running CPU and this build.
+CALIBU_EXPORT ImageKernel BestImageKernel();
+
+}
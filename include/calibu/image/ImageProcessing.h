@@ -23,18 +23,59 @@
 #include <calibu/Platform.h>
 #include <calibu/image/Label.h>
 
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
 #include <Eigen/Eigen>
 #include <Eigen/StdVector>
 
 namespace calibu {
 
+enum ThresholdMethod {
+  // OpenCV Gaussian weighted adaptive threshold with a fixed 127 pixel window
+  THRESHOLD_GAUSSIAN,
+  // Box filtered AdaptiveThreshold on the integral image, of radius
+  // width / at_window_ratio. Constant cost per pixel for any window size.
+  THRESHOLD_INTEGRAL
+};
+
 struct ParamsImageProcessing {
   ParamsImageProcessing() : at_threshold(0.7),
                             at_window_ratio(3),
-                            black_on_white(true) {}
+                            at_min_diff(20),
+                            black_on_white(true),
+                            threshold_method(THRESHOLD_GAUSSIAN),
+                            copy_input(false),
+                            pyramid_levels(0),
+                            label_threads(1),
+                            use_cuda(false) {}
   float at_threshold;
   int at_window_ratio;
+  int at_min_diff;
   bool black_on_white;
+  ThresholdMethod threshold_method;
+
+  // Copy the input image rather than reading the caller's buffer in place.
+  // Without a copy, Input() is only valid while the caller's buffer is.
+  bool copy_input;
+
+  // Process the image at 1 / 2^pyramid_levels of its resolution, e.g. to
+  // detect large target dots cheaply. ConicFinder then refines the conics
+  // on the full resolution input.
+  int pyramid_levels;
+
+  // Threads labelling connected components, in bands of rows (0 for one
+  // per core).
+  unsigned int label_threads;
+
+  // Threshold, label and accumulate the moments of connected components on
+  // the GPU, see CudaImageProcessing, which always thresholds as
+  // THRESHOLD_INTEGRAL. Only the thresholded image and the components are
+  // copied back; the derivative images aren't computed, and ConicFinder
+  // fits conics to Moments() instead. Ignored unless built with HAVE_CUDA.
+  bool use_cuda;
 };
 
 
@@ -43,15 +84,48 @@ class CALIBU_EXPORT ImageProcessing {
   ImageProcessing(int maxWidth, int maxHeight);
   ~ImageProcessing();
 
+  // Process image with the given row pitch in bytes. The image is read in
+  // place unless Params().copy_input is set.
   void Process(const unsigned char* greyscale_image, size_t w, size_t h, size_t pitch);
 
+  // As above, but only process pixels within region of the input image,
+  // e.g. around a target being tracked. Output images keep the size of the
+  // whole image: outside the region the threshold image reads as background
+  // and the derivatives are zero. Labels are only found within the region.
+  // An empty region processes the whole image.
+  void Process(const unsigned char* greyscale_image, size_t w, size_t h,
+               size_t pitch, const IRectangle& region);
+
+  // Size of the processed pyramid level. All images but Input() are of
+  // this size, and coordinates in them are Scale() times smaller than in
+  // the input.
   inline int Width()  const { return width; }
   inline int Height() const { return height; }
-
-  inline const unsigned char* Img() const { return &I[0]; }
-  inline const Eigen::Vector2f* ImgDeriv() const { return &dI[0]; }
+  inline int Scale() const { return 1 << std::max(0, params.pyramid_levels); }
+
+  // Region processed by the last call to Process, at the pyramid level
+  inline const IRectangle& Roi() const { return roi; }
+
+  // Full resolution input image, with rows InputPitch() bytes apart
+  inline const unsigned char* Input() const { return input_img; }
+  inline size_t InputPitch() const { return input_pitch; }
+  inline int InputWidth() const { return input_width; }
+  inline int InputHeight() const { return input_height; }
+
+  // Image at the processed pyramid level, which is the input image without
+  // a pyramid, with rows ImgPitch() bytes apart. All other images are
+  // stored contiguously.
+  inline const unsigned char* Img() const { return img; }
+  inline size_t ImgPitch() const { return img_pitch; }
+  // Planar image derivatives, see GradientPlanar
+  inline const int16_t* ImgDerivX() const { return &dx[0]; }
+  inline const int16_t* ImgDerivY() const { return &dy[0]; }
   inline const unsigned char* ImgThresh() const { return &tI[0]; }
   inline const std::vector<PixelClass>& Labels() const { return labels; }
+  // Moments of each of Labels() if HasMoments(), which is only the case
+  // when processed with ParamsImageProcessing::use_cuda
+  inline const std::vector<BlobMoments>& Moments() const { return moments; }
+  inline bool HasMoments() const { return has_moments; }
 
   ParamsImageProcessing& Params() { return params; }
 
@@ -62,16 +136,32 @@ class CALIBU_EXPORT ImageProcessing {
   void DeallocateImageData();
 
   int width, height;
+  IRectangle roi;
+
+  // Processed image, either the input or a pyramid level
+  const unsigned char* img;
+  size_t img_pitch;
+
+  // Input image, either borrowed or pointing into I
+  const unsigned char* input_img;
+  size_t input_pitch;
+  int input_width, input_height;
 
   // Images owned by this class
   std::vector<unsigned char> I;
-  std::vector<float> intI;
-  std::vector<Eigen::Vector2f, Eigen::aligned_allocator<Eigen::Vector2f> > dI;
-  std::vector<short> lI;
+  std::vector<int16_t> dx;
+  std::vector<int16_t> dy;
   std::vector<unsigned char> tI;
+  std::vector<uint32_t> intI;  // only used by THRESHOLD_INTEGRAL
 
   std::vector<PixelClass> labels;
+  std::vector<BlobMoments> moments;
+  bool has_moments;
   ParamsImageProcessing params;
+
+  // Intermediate images of the labelling stage
+  struct Workspace;
+  std::unique_ptr<Workspace> workspace;
 };
 
 }
@@ -0,0 +1,98 @@
+/*
+  This file is part of the Calibu Project.
+  https://github.com/gwu-robotics/Calibu
+
+  Copyright (C) 2013 George Washington University,
+  Steven Lovegrove
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+  http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+// GPU detection front end of ImageProcessing, see
+// ParamsImageProcessing::use_cuda. Only built with BUILD_CUDA (HAVE_CUDA in
+// calibu/config.h). Errors of the CUDA runtime are thrown as
+// calibu::Exception.
+
+#pragma once
+
+#include <calibu/Platform.h>
+#include <calibu/image/ImageProcessing.h>
+#include <calibu/image/Label.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <cuda_runtime_api.h>
+
+namespace calibu {
+
+class CALIBU_EXPORT CudaImageProcessing {
+ public:
+  CudaImageProcessing();
+  ~CudaImageProcessing();
+
+  CudaImageProcessing(const CudaImageProcessing&) = delete;
+  CudaImageProcessing& operator=(const CudaImageProcessing&) = delete;
+
+  // Upload region of the w x h host image img, with rows pitch bytes apart,
+  // threshold it as AdaptiveThreshold with params, and find the 8-connected
+  // components of its dark pixels as Label does, along with their moments.
+  // Components are found by union-find over the pixels, merging towards
+  // the lowest pixel index, and their counts, bounding boxes and moments
+  // are accumulated with integer atomics, so the result is exact and
+  // deterministic.
+  //
+  // The region of thresholded, a contiguous w x h image, is overwritten,
+  // and labels and moments are replaced by the components in raster order
+  // of their first pixel, in image coordinates. Nothing else is copied
+  // back. Device buffers are kept for regions of at most the same size.
+  // Work is queued on a stream of this instance's own, so that instances
+  // used by different threads overlap.
+  void Process(const unsigned char* img, int w, int h, size_t pitch,
+               const IRectangle& region, const ParamsImageProcessing& params,
+               unsigned char* thresholded, std::vector<PixelClass>& labels,
+               std::vector<BlobMoments>& moments);
+
+  // Component accumulated on the device, in region coordinates, with its
+  // root pixel, pixel count, bounding box and raw moments.
+  struct DeviceBlob {
+    int32_t root;
+    uint32_t size;
+    int32_t x1, y1, x2, y2;
+    unsigned long long sx, sy, sxx, sxy, syy;
+  };
+
+ protected:
+  void Allocate(size_t pixels);
+  void Free();
+
+  cudaStream_t stream;
+  size_t capacity;
+
+  // Device images of the region
+  unsigned char* d_img;
+  uint32_t* d_integral;
+  unsigned char* d_thresh;
+  int32_t* d_parent;
+  int32_t* d_slot;
+
+  // Device components and their number
+  DeviceBlob* d_blobs;
+  unsigned int* d_num_blobs;
+
+  // Host copy of the components
+  std::vector<DeviceBlob> blobs;
+};
+
+}
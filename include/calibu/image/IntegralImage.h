@@ -20,7 +20,11 @@
 
 #pragma once
 
+#include <cstddef>
+#include <cstdint>
+
 #include <calibu/Platform.h>
+#include <calibu/image/ImageKernel.h>
 
 namespace calibu {
 
@@ -49,4 +53,38 @@ void integral_image(const int w, const int h, const TI* in, TO* out)
     }
 }
 
+// As above, for an input image whose rows are pitch bytes apart. Each row
+// is prefix summed and then added to the row above, which the compiler can
+// vectorize. With an unsigned integer TO, sums wrap around but differences
+// of them, as taken by AdaptiveThreshold, remain exact.
+template<typename TI, typename TO>
+void integral_image(const int w, const int h, const size_t pitch, const TI* in, TO* out)
+{
+    const unsigned char* rows = reinterpret_cast<const unsigned char*>(in);
+    for(int y=0; y < h; y++) {
+        const TI* pI = reinterpret_cast<const TI*>(rows + y * pitch);
+        TO* pOut = out + y*w;
+
+        TO sum = 0;
+        for(int x=0; x < w; x++) {
+            sum += pI[x];
+            pOut[x] = sum;
+        }
+
+        if(y > 0) {
+            const TO* pAbove = pOut - w;
+            for(int x=0; x < w; x++) {
+                pOut[x] += pAbove[x];
+            }
+        }
+    }
+}
+
+// Vectorized integral_image for 8 bit images whose rows are pitch bytes
+// apart, with sums modulo 2^32. All kernels produce identical output; one
+// that is not supported falls back to the scalar loop.
+CALIBU_EXPORT void IntegralImage(
+        int w, int h, size_t pitch, const unsigned char* in, uint32_t* out,
+        ImageKernel kernel = IMAGE_KERNEL_AUTO );
+
 }
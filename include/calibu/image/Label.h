@@ -23,6 +23,7 @@
 #include <calibu/Platform.h>
 #include <calibu/utils/Rectangle.h>
 
+#include <cstdint>
 #include <vector>
 
 namespace calibu {
@@ -34,13 +35,46 @@ struct PixelClass
     int size;
 };
 
+/// Centroid and central second moments, divided by the pixel count, of a
+/// connected component, with pixels at integer coordinates.
+struct BlobMoments
+{
+    double cx, cy;
+    double cxx, cxy, cyy;
+};
+
+/// Buffers used by Label, kept between calls so that labelling a stream of
+/// equally sized images doesn't allocate.
+struct LabelWorkspace
+{
+    /// Union-find forest over the pixels of the region, -1 for background
+    std::vector<int32_t> parent;
+
+    /// Components found by each band of rows, with the root of each
+    std::vector<std::vector<PixelClass> > band_labels;
+    std::vector<std::vector<int32_t> > band_roots;
+};
+
+/// Find the 8-connected components of pixels equal to 'passval' within
+/// 'region' of the w x h image I, with rows 'pitch' bytes apart. Each
+/// component is output to 'labels' with its bounding box, in image
+/// coordinates, and pixel count, and equiv = -1, in raster order of its
+/// first pixel.
+///
+/// Rows are split into num_threads bands (0 for one per core), labelled
+/// independently by union-find with path compression and then joined
+/// along the band boundaries. Labels are 32 bit, so there is no limit on
+/// the number of components. The result does not depend on the thread
+/// count.
 CALIBU_EXPORT
 void Label(
-        int w, int h,
+        int w, int h, size_t pitch,
         const unsigned char* I,
-        short* label,
+        const IRectangle& region,
+        unsigned char passval,
         std::vector<PixelClass>& labels,
-        unsigned char passval
+        LabelWorkspace& workspace,
+        unsigned int num_threads = 1
         );
 
 }
@@ -75,6 +75,24 @@ class DoubleEncoder
       return result;
     }
 
+    /**
+     * Encodes the given doubles as consecutive little-endian, IEEE-754
+     * values, giving the same bytes as calling Encode on each value
+     * @param data values to be encoded
+     * @param count number of values to be encoded
+     * @param bytes output of sizeof(uint64_t) * count bytes
+     */
+    static void Encode(const double* data, size_t count, uint8_t* bytes);
+
+    /**
+     * Decodes consecutive little-endian, IEEE-754 values, giving the same
+     * doubles as calling Decode on each value
+     * @param bytes sizeof(uint64_t) * count bytes to be decoded
+     * @param count number of values to be decoded
+     * @param data output of count decoded values
+     */
+    static void Decode(const uint8_t* bytes, size_t count, double* data);
+
   protected:
 
     /**
@@ -179,46 +197,22 @@ class Base64
      * @param count number of bytes to be encoded
      * @return base-64 encoding of given byte-array
      */
-    static std::string Encode(const uint8_t* data, size_t count)
+    static inline std::string Encode(const uint8_t* data, size_t count)
     {
-      // allocate output buffer
-
-      const size_t size = GetEncodingSize(count);
-      std::string result(size, 'A');
-
-      // encode all complete 3-byte tuples
-
-      for (size_t i = 0; i < count / 3; ++i)
-      {
-        const uint8_t v0 = data[3 * i + 0];
-        const uint8_t v1 = data[3 * i + 1];
-        const uint8_t v2 = data[3 * i + 2];
-        result[4 * i + 0] = encoding_map[v0 >> 2];
-        result[4 * i + 1] = encoding_map[(v0 << 4 | v1 >> 4) & 0x3F];
-        result[4 * i + 2] = encoding_map[(v1 << 2 | v2 >> 6) & 0x3F];
-        result[4 * i + 3] = encoding_map[v2 & 0x3F];
-      }
-
-      // encode any partial 3-byte tuples
-
-      if (count % 3 == 1)
-      {
-        const uint8_t v0 = data[count - 1];
-        result[size - 2] = encoding_map[v0 >> 2];
-        result[size - 1] = encoding_map[(v0 << 4) & 0x3F];
-      }
-      else if (count % 3 == 2)
-      {
-        const uint8_t v0 = data[count - 2];
-        const uint8_t v1 = data[count - 1];
-        result[size - 3] = encoding_map[v0 >> 2];
-        result[size - 2] = encoding_map[(v0 << 4 | v1 >> 4) & 0x3F];
-        result[size - 1] = encoding_map[(v1 << 2) & 0x3F];
-      }
-
+      std::string result(GetEncodingSize(count), 'A');
+      Encode(data, count, &result[0]);
       return result;
     }
 
+    /**
+     * Encodes the given byte-array as base-64 characters, using AVX2 when
+     * the processor supports it
+     * @param data input byte-array to be encoded
+     * @param count number of bytes to be encoded
+     * @param chars output of GetEncodingSize(count) characters
+     */
+    static void Encode(const uint8_t* data, size_t count, char* chars);
+
     /**
      * Decodes the given base-64 string into a byte-array
      * @param data base-64 string to be decoded
@@ -245,53 +239,22 @@ class Base64
      * @param count number of characters to be decoded
      * @return byte-array decoded from given base-64 string
      */
-    static std::vector<uint8_t> Decode(const char* data, size_t count)
+    static inline std::vector<uint8_t> Decode(const char* data, size_t count)
     {
-      // allocate output buffer
-
-      const size_t size = GetDecodingSize(count);
-      std::vector<uint8_t> result(size);
-
-      // decode all complete 4-char tuples
-
-      for (size_t i = 0; i < count / 4; ++i)
-      {
-        const uint8_t v0 = decoding_map[uint8_t(data[4 * i + 0])];
-        const uint8_t v1 = decoding_map[uint8_t(data[4 * i + 1])];
-        const uint8_t v2 = decoding_map[uint8_t(data[4 * i + 2])];
-        const uint8_t v3 = decoding_map[uint8_t(data[4 * i + 3])];
-        result[3 * i + 0] = v0 << 2 | v1 >> 4;
-        result[3 * i + 1] = v1 << 4 | v2 >> 2;
-        result[3 * i + 2] = v2 << 6 | v3 >> 0;
-      }
-
-      // decode any partial 4-char tuples
-
-      if (count % 4 == 1)
-      {
-        const uint8_t v0 = decoding_map[uint8_t(data[count - 1])];
-        result[size - 1] = v0 << 2;
-      }
-      else if (count % 4 == 2)
-      {
-        const uint8_t v0 = decoding_map[uint8_t(data[count - 2])];
-        const uint8_t v1 = decoding_map[uint8_t(data[count - 1])];
-        result[size - 2] = v0 << 2 | v1 >> 4;
-        result[size - 1] = v1 << 4;
-      }
-      else if (count % 4 == 3)
-      {
-        const uint8_t v0 = decoding_map[uint8_t(data[count - 3])];
-        const uint8_t v1 = decoding_map[uint8_t(data[count - 2])];
-        const uint8_t v2 = decoding_map[uint8_t(data[count - 1])];
-        result[size - 3] = v0 << 2 | v1 >> 4;
-        result[size - 2] = v1 << 4 | v2 >> 2;
-        result[size - 1] = v2 << 6;
-      }
-
+      std::vector<uint8_t> result(GetDecodingSize(count));
+      Decode(data, count, result.data());
       return result;
     }
 
+    /**
+     * Decodes the given base-64 characters into a byte-array, using AVX2
+     * when the processor supports it
+     * @param data base-64 characters to be decoded
+     * @param count number of characters to be decoded
+     * @param bytes output of GetDecodingSize(count) bytes
+     */
+    static void Decode(const char* data, size_t count, uint8_t* bytes);
+
     /**
      * Computes the number of base-64 characters required to encode the
      * specified number of bytes
@@ -340,8 +303,8 @@ class Base64Encoder : public Base64
 
   protected:
 
-    /** Output stream of encoded data */
-    std::ostringstream stream_;
+    /** Encoded data */
+    std::string data_;
 };
 
 class Base64Decoder: public Base64
@@ -352,7 +315,7 @@ class Base64Decoder: public Base64
      * Create a default Base64Decoder object for decoding the given string
      * @param data base-64 encoded string to be decoded
      */
-    Base64Decoder(const std::string data);
+    Base64Decoder(std::string data);
 
     /**
      * Reads the current stream and decodes value of the specified type
@@ -364,8 +327,11 @@ class Base64Decoder: public Base64
 
   protected:
 
-    /** Input stream of encoded data */
-    std::istringstream stream_;
+    /** Encoded data */
+    std::string data_;
+
+    /** Number of characters of data_ already decoded */
+    size_t offset_;
 };
 
 } // namespace calibu
\ No newline at end of file
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <string>
+#include <Eigen/Eigen>
+#include <calibu/Platform.h>
+
+namespace calibu
+{
+
+/**
+ * Storage of large model parameters, such as those of dense vignetting, in a
+ * binary file next to the photometric rig XML file. Values are stored as
+ * little-endian IEEE-754 floats, and deflate compressed if Calibu was built
+ * with zlib (HAVE_ZLIB).
+ */
+enum SidecarFormat
+{
+  /** Parameters are written base-64 encoded into the XML file */
+  SIDECAR_NONE = 0,
+
+  /** Parameters are written as 32-bit floats */
+  SIDECAR_FLOAT32 = 1,
+
+  /** Parameters are written as 16-bit floats, with a relative error of
+   *  up to 2^-11, which is ample for attenuation factors */
+  SIDECAR_FLOAT16 = 2,
+};
+
+/**
+ * Writes the given parameters to a sidecar file
+ * @param filename full file path to the output file
+ * @param params parameters to be written
+ * @param format value format, which must not be SIDECAR_NONE
+ */
+CALIBU_EXPORT
+void WriteSidecar(const std::string& filename, const Eigen::VectorXd& params,
+    SidecarFormat format);
+
+/**
+ * Reads parameters from a sidecar file, decoding the file in chunks
+ * directly into the given vector, whose size must match the stored count
+ * @param filename full file path to the input file
+ * @param params output parameters of the expected size
+ */
+CALIBU_EXPORT
+void ReadSidecar(const std::string& filename, Eigen::VectorXd& params);
+
+} // namespace calibu
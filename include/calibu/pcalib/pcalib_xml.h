@@ -5,6 +5,7 @@
 #include <tinyxml2.h>
 #include <calibu/Platform.h>
 #include <calibu/pcalib/pcalib.h>
+#include <calibu/pcalib/pcalib_sidecar.h>
 
 namespace calibu
 {
@@ -161,6 +162,15 @@ class PhotoRigWriter
      */
     void Write(const PhotoRigd& rig);
 
+    /**
+     * Selects how large vignetting parameters are stored. With any format
+     * other than SIDECAR_NONE, each vignetting with more parameters than
+     * fit as plain text is written to its own binary file next to the XML
+     * file, named after it, which the XML file then references.
+     * @param format sidecar value format
+     */
+    void SetSidecarFormat(SidecarFormat format);
+
   protected:
 
     /**
@@ -238,11 +248,24 @@ class PhotoRigWriter
      */
     static std::string GetLongText(const Eigen::MatrixXd& matrix);
 
+    /**
+     * Returns the name of the next sidecar file, relative to the directory
+     * of the output XML file
+     * @return sidecar file name
+     */
+    std::string GetSidecarName();
+
   protected:
 
     /** Full file path to the output XML file */
     std::string filename_;
 
+    /** Storage format of large vignetting parameters */
+    SidecarFormat sidecar_format_;
+
+    /** Number of sidecar files written for the current rig */
+    int sidecar_count_;
+
     /** Intermediate XML document to be constructed */
     tinyxml2::XMLDocument document_;
 };
@@ -259,8 +282,11 @@ std::shared_ptr<PhotoRigd> ReadXmlPhotoRig(const std::string& filename);
  * Writes the given photometric camera rig to the specified XML file
  * @param filename output XML file to be written
  * @param rig photometric camera rig object to be written
+ * @param format storage of large vignetting parameters, see
+ *        PhotoRigWriter::SetSidecarFormat
  */
 CALIBU_EXPORT
-void WriteXmlPhotoRig(const std::string& filename, const PhotoRigd& rig);
+void WriteXmlPhotoRig(const std::string& filename, const PhotoRigd& rig,
+    SidecarFormat format = SIDECAR_NONE);
 
 } // namespace calibu
\ No newline at end of file
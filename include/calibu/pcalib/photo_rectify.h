@@ -0,0 +1,280 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+#include <calibu/exception.h>
+#include <calibu/cam/rectify_crtp.h>
+#include <calibu/pcalib/pcalib.h>
+#include <calibu/utils/Parallel.h>
+
+namespace calibu
+{
+
+/**
+ * Rectifies images and removes the camera response and vignetting in a
+ * single pass. Raw intensities are mapped through a precomputed
+ * inverse-response table before bilinear interpolation, and the result is
+ * divided by the vignetting attenuation, which is precomputed in the
+ * rectified frame. The output is a float irradiance image.
+ *
+ * The response range should match the input bit depth, e.g. [0..255] for
+ * 8-bit images; intensities outside it are clamped before evaluation.
+ * Channel c uses response c and vignetting c of the photometric camera, or
+ * the first model if the camera has only one. A camera without responses is
+ * treated as linear and one without vignetting as uniform.
+ */
+template <typename Scalar>
+class PhotoRectifier
+{
+  public:
+
+    /**
+     * Creates a fused rectification stage
+     * @param lut lookup table used to rectify input images
+     * @param camera photometric calibration of the source camera
+     * @param source_width width of the unrectified source image
+     * @param source_height height of the unrectified source image
+     * @param bits bit depth of the input pixels (8 or 16)
+     * @param channels number of interleaved channels in the input images
+     */
+    PhotoRectifier(const LookupTable& lut, const PhotoCamera<Scalar>& camera,
+        int source_width, int source_height, int bits = 8, int channels = 1) :
+      lut_(lut),
+      bits_(bits),
+      channels_(channels)
+    {
+      CALIBU_ASSERT_DESC(bits == 8 || bits == 16, "unsupported bit depth");
+      CALIBU_ASSERT_DESC(channels > 0, "invalid channel count");
+      CreateResponseTables(camera);
+      CreateAttenuationImages(camera, source_width, source_height);
+    }
+
+    /**
+     * Returns the width of rectified images
+     * @return rectified image width
+     */
+    inline int Width() const
+    {
+      return lut_.Width();
+    }
+
+    /**
+     * Returns the height of rectified images
+     * @return rectified image height
+     */
+    inline int Height() const
+    {
+      return lut_.Height();
+    }
+
+    /**
+     * Returns the number of interleaved channels
+     * @return channel count
+     */
+    inline int Channels() const
+    {
+      return channels_;
+    }
+
+    /**
+     * Rectifies and photometrically corrects an 8-bit image
+     * @param input unrectified source image
+     * @param output rectified irradiance image, Width() x Height() x Channels()
+     * @param num_threads number of row bands (0 for one per core)
+     */
+    inline void Rectify(const uint8_t* input, float* output,
+        unsigned int num_threads = 1) const
+    {
+      CALIBU_ASSERT_DESC(bits_ == 8, "rectifier created for 16-bit input");
+      Process(input, output, num_threads);
+    }
+
+    /**
+     * Rectifies and photometrically corrects a 16-bit image
+     * @param input unrectified source image
+     * @param output rectified irradiance image, Width() x Height() x Channels()
+     * @param num_threads number of row bands (0 for one per core)
+     */
+    inline void Rectify(const uint16_t* input, float* output,
+        unsigned int num_threads = 1) const
+    {
+      CALIBU_ASSERT_DESC(bits_ == 16, "rectifier created for 8-bit input");
+      Process(input, output, num_threads);
+    }
+
+  protected:
+
+    /**
+     * Performs the fused rectification for any integer pixel type
+     * @param input unrectified source image
+     * @param output rectified irradiance image
+     * @param num_threads number of row bands
+     */
+    template <typename T>
+    void Process(const T* input, float* output, unsigned int num_threads) const
+    {
+      const int width = lut_.Width();
+      const int channels = channels_;
+      const int table_size = 1 << bits_;
+
+      ParallelForBands(lut_.Height(), num_threads,
+          [&](int row_begin, int row_end)
+      {
+        const int begin = row_begin * width;
+        const int end = row_end * width;
+
+        for (int c = 0; c < channels; ++c)
+        {
+          const float* table = &responses_[c * table_size];
+          const float* attenuation = &attenuations_[c * width * lut_.Height()];
+
+          for (int i = begin; i < end; ++i)
+          {
+            const BilinearLutPoint& p = lut_.m_vLutPixels[i];
+            const T* p0 = input + p.idx0 * channels + c;
+            const T* p1 = input + p.idx1 * channels + c;
+
+            const float irradiance =
+                p.w00 * table[p0[0]] + p.w01 * table[p0[channels]] +
+                p.w10 * table[p1[0]] + p.w11 * table[p1[channels]];
+
+            output[i * channels + c] = irradiance * attenuation[i];
+          }
+        }
+      });
+    }
+
+    /**
+     * Evaluates each inverse-response once for every input intensity
+     * @param camera photometric calibration of the source camera
+     */
+    void CreateResponseTables(const PhotoCamera<Scalar>& camera)
+    {
+      const int table_size = 1 << bits_;
+      responses_.resize(channels_ * table_size);
+
+      for (int c = 0; c < channels_; ++c)
+      {
+        float* table = &responses_[c * table_size];
+        const Response<Scalar>* response = SelectModel(camera.responses, c);
+
+        if (!response)
+        {
+          for (int i = 0; i < table_size; ++i) table[i] = i;
+          continue;
+        }
+
+        // reuse the table baked into the model when it has the same depth
+
+        if (response->LUTBits() == bits_)
+        {
+          const std::vector<float>& lut = response->GetLUT();
+          std::copy(lut.begin(), lut.end(), table);
+          continue;
+        }
+
+        // intensities outside the modeled range map to the nearest bound
+
+        const Eigen::Vector2d& range = response->GetRange();
+        std::vector<Scalar> values(table_size);
+
+        for (int i = 0; i < table_size; ++i)
+        {
+          values[i] = std::max(range[0], std::min(range[1], double(i)));
+        }
+
+        response->Evaluate(values.data(), values.data(), table_size);
+        std::copy(values.begin(), values.end(), table);
+      }
+    }
+
+    /**
+     * Computes the reciprocal attenuation at each rectified pixel, sampled at
+     * the source image location the lookup table reads from
+     * @param camera photometric calibration of the source camera
+     * @param source_width width of the unrectified source image
+     * @param source_height height of the unrectified source image
+     */
+    void CreateAttenuationImages(const PhotoCamera<Scalar>& camera,
+        int source_width, int source_height)
+    {
+      const int count = lut_.m_vLutPixels.size();
+      attenuations_.resize(channels_ * count);
+
+      std::vector<Scalar> us(count);
+      std::vector<Scalar> vs(count);
+      std::vector<Scalar> factors(count);
+
+      for (int c = 0; c < channels_; ++c)
+      {
+        float* attenuation = &attenuations_[c * count];
+        const Vignetting<Scalar>* vignetting =
+            SelectModel(camera.vignettings, c);
+
+        if (!vignetting)
+        {
+          std::fill(attenuation, attenuation + count, 1.0f);
+          continue;
+        }
+
+        // vignetting models may have been fit at another resolution
+
+        const double sx = double(vignetting->Width()) / source_width;
+        const double sy = double(vignetting->Height()) / source_height;
+
+        for (int i = 0; i < count; ++i)
+        {
+          // recover source location from lookup table indices and weights
+
+          const BilinearLutPoint& p = lut_.m_vLutPixels[i];
+          const double u = p.idx0 % source_width + p.w01 + p.w11;
+          const double v = p.idx0 / source_width + p.w10 + p.w11;
+          us[i] = sx * (u + 0.5);
+          vs[i] = sy * (v + 0.5);
+        }
+
+        vignetting->Evaluate(us.data(), vs.data(), factors.data(), count);
+
+        for (int i = 0; i < count; ++i)
+        {
+          const Scalar factor = factors[i];
+          attenuation[i] = (factor > 0) ? float(1 / factor) : 0.0f;
+        }
+      }
+    }
+
+    /**
+     * Returns the model for the given channel, following PhotoCamera rules
+     * @param models list of per-channel models
+     * @param channel index of channel
+     * @return model for channel or nullptr if list is empty
+     */
+    template <typename Model>
+    static inline const Model* SelectModel(
+        const std::vector<std::shared_ptr<Model>>& models, int channel)
+    {
+      if (models.empty()) return nullptr;
+      const size_t index = (size_t(channel) < models.size()) ? channel : 0;
+      return models[index].get();
+    }
+
+  protected:
+
+    /** Lookup table used for rectification */
+    LookupTable lut_;
+
+    /** Bit depth of input pixels */
+    int bits_;
+
+    /** Number of interleaved channels */
+    int channels_;
+
+    /** Inverse-response tables, one per channel */
+    std::vector<float> responses_;
+
+    /** Reciprocal attenuation in rectified frame, one image per channel */
+    std::vector<float> attenuations_;
+};
+
+} // namespace calibu
@@ -1,6 +1,9 @@
 #pragma once
 
+#include <algorithm>
 #include <iostream>
+#include <limits>
+#include <vector>
 #include <Eigen/Eigen>
 #include <calibu/exception.h>
 
@@ -85,6 +88,7 @@ class Response
     inline void SetRange(const Eigen::Vector2d& range)
     {
       range_ = range;
+      RebakeLUT();
     }
 
     /**
@@ -104,6 +108,7 @@ class Response
     {
       CALIBU_ASSERT_DESC(params.size() == params_.size(), "invalid param count");
       params_ = params;
+      RebakeLUT();
     }
 
     /**
@@ -113,13 +118,131 @@ class Response
      */
     virtual Scalar operator()(Scalar value) const = 0;
 
+    /**
+     * Evaluates the inverse-response for a buffer of pixel intensities, with
+     * a single virtual call for the whole buffer. The buffers may alias.
+     * @param in input pixel intensities
+     * @param out output inverse-response values
+     * @param n number of values
+     */
+    virtual void Evaluate(const Scalar* in, Scalar* out, size_t n) const
+    {
+      for (size_t i = 0; i < n; ++i)
+      {
+        out[i] = (*this)(in[i]);
+      }
+    }
+
     /**
      * Resets the model parameters, which results in a linear response.
      */
     virtual void Reset() = 0;
 
+    /**
+     * Precomputes the inverse-response for every integer intensity of a
+     * bits-deep image, i.e. [0..2^bits - 1]. Intensities outside the response
+     * range are clamped to it before evaluation. The table is kept up to date
+     * when the parameters or range change, and is used by Apply.
+     * @param bits bit depth of the images to be corrected (1..16)
+     */
+    inline void BakeLUT(int bits)
+    {
+      CALIBU_ASSERT_DESC(bits > 0 && bits <= 16, "invalid bit depth");
+      lut_bits_ = bits;
+      RebakeLUT();
+    }
+
+    /**
+     * Discards the table created by BakeLUT
+     */
+    inline void ClearLUT()
+    {
+      lut_bits_ = 0;
+      lut_.clear();
+    }
+
+    /**
+     * Returns the bit depth of the baked table, or zero if there is none
+     * @return table bit depth
+     */
+    inline int LUTBits() const
+    {
+      return lut_bits_;
+    }
+
+    /**
+     * Returns the baked inverse-response table, indexed by intensity
+     * @return table of 2^LUTBits() entries, empty if not baked
+     */
+    inline const std::vector<float>& GetLUT() const
+    {
+      return lut_;
+    }
+
+    /**
+     * Evaluates the inverse-response for a buffer of intensities. Integer
+     * intensities are looked up in the baked table when there is one, with
+     * negative values mapped to the first entry and values past its end to
+     * the last. Otherwise, or for floating
+     * point input, values are evaluated by the model, a block at a time.
+     * @param in input pixel intensities
+     * @param out output inverse-response values
+     * @param n number of values
+     */
+    template <typename T>
+    inline void Apply(const T* in, float* out, size_t n) const
+    {
+      if (std::numeric_limits<T>::is_integer && !lut_.empty())
+      {
+        const float* table = lut_.data();
+        const size_t last = lut_.size() - 1;
+
+        for (size_t i = 0; i < n; ++i)
+        {
+          // Clamp signed values at zero before widening to an index
+          const T value = (in[i] > T(0)) ? in[i] : T(0);
+          out[i] = table[std::min<size_t>(value, last)];
+        }
+      }
+      else
+      {
+        Scalar values[apply_block_size];
+
+        for (size_t i = 0; i < n; i += apply_block_size)
+        {
+          const size_t count = std::min<size_t>(apply_block_size, n - i);
+          std::copy(in + i, in + i + count, values);
+          Evaluate(values, values, count);
+          std::copy(values, values + count, out + i);
+        }
+      }
+    }
+
   protected:
 
+    /**
+     * Recomputes the baked table, if any, from the current model
+     */
+    inline void RebakeLUT()
+    {
+      if (lut_bits_ == 0) return;
+
+      std::vector<Scalar> values(size_t(1) << lut_bits_);
+
+      for (size_t i = 0; i < values.size(); ++i)
+      {
+        values[i] = std::max(range_[0], std::min(range_[1], double(i)));
+      }
+
+      Evaluate(values.data(), values.data(), values.size());
+      lut_.assign(values.begin(), values.end());
+    }
+
+  protected:
+
+    /** Number of intensities Apply evaluates per call to Evaluate */
+    static const size_t apply_block_size = 256;
+
     /** Response type name */
     std::string type_;
 
@@ -128,6 +251,15 @@ class Response
 
     /** Response model parameter vector */
     Eigen::VectorXd params_;
+
+    /** Bit depth of baked inverse-response table, zero if none */
+    int lut_bits_ = 0;
+
+    /** Baked inverse-response table, indexed by intensity */
+    std::vector<float> lut_;
 };
 
+template <typename Scalar>
+const size_t Response<Scalar>::apply_block_size;
+
 } // namespace calibu
\ No newline at end of file
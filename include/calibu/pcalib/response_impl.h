@@ -38,12 +38,31 @@ class ResponseImpl : public Response<Scalar>
       return Derived::GetResponse(this->params_.data(), value);
     }
 
+    /**
+     * Evaluates the inverse-response for a buffer of pixel intensities,
+     * calling the model directly for each value. The buffers may alias.
+     * @param in input pixel intensities
+     * @param out output inverse-response values
+     * @param n number of values
+     */
+    void Evaluate(const Scalar* in, Scalar* out, size_t n) const override
+    {
+      const double* params = this->params_.data();
+
+      for (size_t i = 0; i < n; ++i)
+      {
+        CALIBU_DEBUG_DESC(this->InRange(in[i]), "invalid intensity value");
+        out[i] = Derived::GetResponse(params, in[i]);
+      }
+    }
+
     /**
      * Resets the model parameters, which results in a linear response.
      */
     virtual void Reset() override
     {
       Derived::ResetParameters(this->params_.data());
+      this->RebakeLUT();
     }
 
   private:
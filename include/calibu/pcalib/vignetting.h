@@ -1,6 +1,10 @@
 #pragma once
 
+#include <algorithm>
 #include <iostream>
+#include <memory>
+#include <mutex>
+#include <vector>
 #include <Eigen/Eigen>
 #include <calibu/exception.h>
 
@@ -26,6 +30,33 @@ class Vignetting
     {
     }
 
+    /**
+     * Copies the model, but not its cached attenuation images
+     * @param other model to be copied
+     */
+    Vignetting(const Vignetting& other) :
+      width_(other.width_),
+      height_(other.height_),
+      type_(other.type_),
+      params_(other.params_)
+    {
+    }
+
+    /**
+     * Copies the model, but not its cached attenuation images
+     * @param other model to be copied
+     * @return reference to this model
+     */
+    Vignetting& operator=(const Vignetting& other)
+    {
+      width_ = other.width_;
+      height_ = other.height_;
+      type_ = other.type_;
+      params_ = other.params_;
+      InvalidateImages();
+      return *this;
+    }
+
     virtual ~Vignetting()
     {
     }
@@ -84,6 +115,7 @@ class Vignetting
     {
       CALIBU_ASSERT_DESC(params.size() == params_.size(), "invalid param count");
       params_ = params;
+      InvalidateImages();
     }
 
     /**
@@ -94,11 +126,156 @@ class Vignetting
      */
     virtual Scalar operator()(Scalar u, Scalar v) const = 0;
 
+    /**
+     * Evaluates the attenuation at a buffer of image points, with a single
+     * virtual call for the whole buffer.
+     * @param u horizontal image coordinates of points being evaluated
+     * @param v vertical image coordinates of points being evaluated
+     * @param out output attenuation factors
+     * @param n number of points
+     */
+    virtual void Evaluate(const Scalar* u, const Scalar* v, Scalar* out,
+        size_t n) const
+    {
+      for (size_t i = 0; i < n; ++i)
+      {
+        out[i] = (*this)(u[i], v[i]);
+      }
+    }
+
+    /**
+     * Evaluates the attenuation along part of an image row, at the n points
+     * (u0, v), (u0 + 1, v), ..., (u0 + n - 1, v). Passing u0 = x + 0.5 and
+     * v = y + 0.5 evaluates pixel centers.
+     * @param v vertical image coordinate of the row
+     * @param u0 horizontal image coordinate of the first point
+     * @param n number of points
+     * @param out output attenuation factors
+     */
+    virtual void EvaluateRow(Scalar v, Scalar u0, size_t n, Scalar* out) const
+    {
+      for (size_t i = 0; i < n; ++i)
+      {
+        out[i] = (*this)(u0 + Scalar(i), v);
+      }
+    }
+
     /**
      * Resets the model parameters, which results in uniform attenuation.
      */
     virtual void Reset() = 0;
 
+    /**
+     * Returns the attenuation at every pixel center of the model image, in
+     * row-major order. The image is computed on first use and cached until
+     * the parameters change. The returned image is never modified, and stays
+     * valid after the parameters change, so it may be read while another
+     * thread updates the model.
+     * @return width x height attenuation image
+     */
+    inline std::shared_ptr<const std::vector<float>> GetAttenuationImage() const
+    {
+      std::lock_guard<std::mutex> lock(image_mutex_);
+      UpdateImages();
+      return attenuation_;
+    }
+
+    /**
+     * Returns the reciprocal of GetAttenuationImage, so an image can be
+     * corrected with a single multiply per pixel. Pixels with no positive
+     * attenuation map to zero.
+     * @return width x height inverse attenuation image
+     */
+    inline std::shared_ptr<const std::vector<float>> GetInverseAttenuationImage() const
+    {
+      std::lock_guard<std::mutex> lock(image_mutex_);
+      UpdateImages();
+      return inverse_attenuation_;
+    }
+
+    /**
+     * Writes the attenuation image into the given buffer
+     * @param out output buffer of at least height rows
+     * @param stride number of floats between rows, zero for the image width
+     */
+    inline void RenderAttenuationImage(float* out, int stride = 0) const
+    {
+      CopyImage(*GetAttenuationImage(), out, stride);
+    }
+
+    /**
+     * Writes the inverse attenuation image into the given buffer
+     * @param out output buffer of at least height rows
+     * @param stride number of floats between rows, zero for the image width
+     */
+    inline void RenderInverseAttenuationImage(float* out, int stride = 0) const
+    {
+      CopyImage(*GetInverseAttenuationImage(), out, stride);
+    }
+
+  protected:
+
+    /**
+     * Evaluates the attenuation at every pixel center of the model image
+     * @param out row-major output buffer of width x height values
+     */
+    virtual void ComputeAttenuationImage(float* out) const = 0;
+
+    /**
+     * Discards the cached attenuation images. Images already returned are
+     * left as they were.
+     */
+    inline void InvalidateImages()
+    {
+      std::lock_guard<std::mutex> lock(image_mutex_);
+      attenuation_.reset();
+      inverse_attenuation_.reset();
+    }
+
+  private:
+
+    /**
+     * Computes the cached attenuation images if needed. Caller holds lock.
+     */
+    inline void UpdateImages() const
+    {
+      if (attenuation_) return;
+
+      const size_t count = size_t(width_) * height_;
+      std::shared_ptr<std::vector<float>> attenuation =
+          std::make_shared<std::vector<float>>(count);
+      std::shared_ptr<std::vector<float>> inverse =
+          std::make_shared<std::vector<float>>(count);
+      ComputeAttenuationImage(attenuation->data());
+
+      for (size_t i = 0; i < count; ++i)
+      {
+        const float a = (*attenuation)[i];
+        (*inverse)[i] = (a > 0) ? 1.0f / a : 0.0f;
+      }
+
+      attenuation_ = attenuation;
+      inverse_attenuation_ = inverse;
+    }
+
+    /**
+     * Copies a cached image into a strided buffer
+     * @param image cached image
+     * @param out output buffer
+     * @param stride number of floats between rows, zero for the image width
+     */
+    inline void CopyImage(const std::vector<float>& image, float* out,
+        int stride) const
+    {
+      if (stride <= 0) stride = width_;
+
+      for (int y = 0; y < height_; ++y)
+      {
+        const float* row = image.data() + size_t(y) * width_;
+        std::copy(row, row + width_, out + size_t(y) * stride);
+      }
+    }
+
   protected:
 
     /** Image width of vignetting model */
@@ -112,6 +289,17 @@ class Vignetting
 
     /** Vignetting model parameter vector */
     Eigen::VectorXd params_;
+
+  private:
+
+    /** Guards the cached attenuation images */
+    mutable std::mutex image_mutex_;
+
+    /** Cached attenuation image, null until requested */
+    mutable std::shared_ptr<const std::vector<float>> attenuation_;
+
+    /** Cached inverse attenuation image, null until requested */
+    mutable std::shared_ptr<const std::vector<float>> inverse_attenuation_;
 };
 
 } // namespace calibu
\ No newline at end of file
@@ -78,6 +78,22 @@ class DenseVignetting : public VignettingImpl<Scalar, DenseVignetting<Scalar>>
       return result;
     }
 
+    /**
+     * Evaluates the attenuation at every pixel center of the image. At pixel
+     * centers the bilinear interpolation reduces to the stored factors.
+     * @param params model parameters used for evaluation
+     * @param width image width of model
+     * @param height image height of model
+     * @param out row-major output buffer of width x height values
+     */
+    static inline void GetAttenuations(const double* params, int width,
+        int height, float* out)
+    {
+      const int count = GetNumParams(width, height);
+      Eigen::Map<Eigen::ArrayXf>(out, count) =
+          Eigen::Map<const Eigen::ArrayXd>(params, count).cast<float>();
+    }
+
     /**
      * Resets the model parameters, which results in uniform attenuation
      * @param params parameter vector to be reset
@@ -0,0 +1,423 @@
+#pragma once
+
+#include <calibu/pcalib/vignetting.h>
+
+namespace calibu
+{
+
+/**
+ * Upsampling used to evaluate a grid vignetting model between its nodes
+ */
+enum GridInterpolation
+{
+  /** Bilinear interpolation of the four surrounding nodes */
+  GRID_BILINEAR = 0,
+
+  /** Catmull-Rom interpolation of the sixteen surrounding nodes */
+  GRID_BICUBIC = 1,
+};
+
+/**
+ * Dense vignetting model at reduced resolution, with one attenuation factor
+ * per node of a regular grid spanning the image. As vignetting is smooth, a
+ * coarse grid upsampled with bilinear or bicubic interpolation reproduces it
+ * with a small fraction of the parameters of DenseVignetting. Nodes are
+ * spread evenly from the left to right and top to bottom image borders, and
+ * the 1D parameter vector is organized in row-major order.
+ */
+template <typename Scalar>
+class GridVignetting : public Vignetting<Scalar>
+{
+  public:
+
+    /** Unique vignetting type name */
+    static constexpr const char* type = "grid";
+
+    /** Default image size in pixels covered by each grid cell */
+    static const int default_cell_size = 32;
+
+  public:
+
+    /**
+     * Create vignetting model for given image resolution, with a grid of
+     * default resolution and bicubic interpolation
+     * @param width image width
+     * @param height image height
+     */
+    GridVignetting(int width, int height) :
+      GridVignetting(width, height, GetDefaultGridSize(width),
+          GetDefaultGridSize(height))
+    {
+    }
+
+    /**
+     * Create vignetting model for given image and grid resolution
+     * @param width image width
+     * @param height image height
+     * @param grid_width number of grid nodes per row, at least two
+     * @param grid_height number of grid nodes per column, at least two
+     * @param interpolation upsampling used between grid nodes
+     */
+    GridVignetting(int width, int height, int grid_width, int grid_height,
+        GridInterpolation interpolation = GRID_BICUBIC) :
+      Vignetting<Scalar>(width, height),
+      grid_width_(grid_width),
+      grid_height_(grid_height),
+      interpolation_(interpolation)
+    {
+      CALIBU_ASSERT_DESC(grid_width >= 2 && grid_height >= 2,
+          "invalid vignetting grid size");
+
+      this->type_ = std::string(type);
+      this->params_.resize(GetNumParams(grid_width, grid_height));
+      ResetParameters(this->params_.data(), grid_width, grid_height);
+    }
+
+    virtual ~GridVignetting()
+    {
+    }
+
+    /**
+     * Returns the number of grid nodes per row
+     * @return grid width
+     */
+    inline int GridWidth() const
+    {
+      return grid_width_;
+    }
+
+    /**
+     * Returns the number of grid nodes per column
+     * @return grid height
+     */
+    inline int GridHeight() const
+    {
+      return grid_height_;
+    }
+
+    /**
+     * Returns the upsampling used between grid nodes
+     * @return grid interpolation
+     */
+    inline GridInterpolation Interpolation() const
+    {
+      return interpolation_;
+    }
+
+    /**
+     * Evaluates the attenuation at the specified point in the image.
+     * @param u horizontal image coordinate for point being evaluated
+     * @param v vertical image coordinate for point being evaluated
+     * @return evaluated attenuation factor at image position
+     */
+    Scalar operator()(Scalar u, Scalar v) const override
+    {
+      return GetAttenuation(this->params_.data(), u, v, this->width_,
+          this->height_, grid_width_, grid_height_, interpolation_);
+    }
+
+    /**
+     * Evaluates the attenuation at a buffer of image points
+     * @param u horizontal image coordinates of points being evaluated
+     * @param v vertical image coordinates of points being evaluated
+     * @param out output attenuation factors
+     * @param n number of points
+     */
+    void Evaluate(const Scalar* u, const Scalar* v, Scalar* out,
+        size_t n) const override
+    {
+      for (size_t i = 0; i < n; ++i)
+      {
+        out[i] = GetAttenuation(this->params_.data(), u[i], v[i],
+            this->width_, this->height_, grid_width_, grid_height_,
+            interpolation_);
+      }
+    }
+
+    /**
+     * Evaluates the attenuation along part of an image row. The grid is
+     * interpolated vertically once for the row, then horizontally per point.
+     * @param v vertical image coordinate of the row
+     * @param u0 horizontal image coordinate of the first point
+     * @param n number of points
+     * @param out output attenuation factors
+     */
+    void EvaluateRow(Scalar v, Scalar u0, size_t n, Scalar* out) const override
+    {
+      const int taps = (interpolation_ == GRID_BICUBIC) ? 4 : 2;
+      std::vector<double> nodes(grid_width_);
+      InterpolateRow(this->params_.data(), v, this->height_, grid_width_,
+          grid_height_, interpolation_, nodes.data());
+
+      for (size_t k = 0; k < n; ++k)
+      {
+        int x0;
+        double wx[4];
+        GetWeights(u0 + Scalar(k), this->width_, grid_width_, interpolation_,
+            x0, wx);
+
+        double sum = 0;
+
+        for (int i = 0; i < taps; ++i)
+        {
+          sum += wx[i] * nodes[ClampNode(x0 + i, grid_width_)];
+        }
+
+        out[k] = sum;
+      }
+    }
+
+    /**
+     * Resets the model parameters, which results in uniform attenuation.
+     */
+    void Reset() override
+    {
+      ResetParameters(this->params_.data(), grid_width_, grid_height_);
+      this->InvalidateImages();
+    }
+
+    /**
+     * Evaluates the attenuation at the specified point in the image.
+     * Interpolation weights only depend on the point, so the result is
+     * linear in the parameters and may be evaluated with autodiff types.
+     * Points outside the image are clamped to its borders.
+     * @param params model parameters used for evaluation
+     * @param u horizontal image coordinate for point being evaluated
+     * @param v vertical image coordinate for point being evaluated
+     * @param width image width of model
+     * @param height image height of model
+     * @param grid_width number of grid nodes per row
+     * @param grid_height number of grid nodes per column
+     * @param interpolation upsampling used between grid nodes
+     * @return evaluated attenuation factor at image position
+     */
+    template <typename T>
+    static inline T GetAttenuation(const T* params, double u, double v,
+        int width, int height, int grid_width, int grid_height,
+        GridInterpolation interpolation)
+    {
+      int x0, y0;
+      double wx[4], wy[4];
+      GetWeights(u, width, grid_width, interpolation, x0, wx);
+      GetWeights(v, height, grid_height, interpolation, y0, wy);
+
+      // sum the weighted nodes, repeating border nodes as needed
+
+      const int taps = (interpolation == GRID_BICUBIC) ? 4 : 2;
+      T result = T(0);
+
+      for (int j = 0; j < taps; ++j)
+      {
+        const int y = ClampNode(y0 + j, grid_height);
+        const T* row = params + y * grid_width;
+        T sum = T(0);
+
+        for (int i = 0; i < taps; ++i)
+        {
+          sum += T(wx[i]) * row[ClampNode(x0 + i, grid_width)];
+        }
+
+        result += T(wy[j]) * sum;
+      }
+
+      return result;
+    }
+
+    /**
+     * Evaluates the attenuation at every pixel center of the image. Each
+     * output row first interpolates the grid vertically into one row of
+     * nodes, which is then interpolated horizontally.
+     * @param params model parameters used for evaluation
+     * @param width image width of model
+     * @param height image height of model
+     * @param grid_width number of grid nodes per row
+     * @param grid_height number of grid nodes per column
+     * @param interpolation upsampling used between grid nodes
+     * @param out row-major output buffer of width x height values
+     */
+    static inline void GetAttenuations(const double* params, int width,
+        int height, int grid_width, int grid_height,
+        GridInterpolation interpolation, float* out)
+    {
+      const int taps = (interpolation == GRID_BICUBIC) ? 4 : 2;
+
+      // horizontal first node and weights of each pixel column
+
+      std::vector<int> x0(width);
+      std::vector<double> wx(4 * width);
+
+      for (int x = 0; x < width; ++x)
+      {
+        GetWeights(x + 0.5, width, grid_width, interpolation, x0[x],
+            &wx[4 * x]);
+      }
+
+      std::vector<double> nodes(grid_width);
+
+      for (int y = 0; y < height; ++y)
+      {
+        InterpolateRow(params, y + 0.5, height, grid_width, grid_height,
+            interpolation, nodes.data());
+
+        // interpolate nodes horizontally
+
+        float* pixels = out + size_t(y) * width;
+
+        for (int x = 0; x < width; ++x)
+        {
+          double sum = 0;
+
+          for (int i = 0; i < taps; ++i)
+          {
+            sum += wx[4 * x + i] * nodes[ClampNode(x0[x] + i, grid_width)];
+          }
+
+          pixels[x] = sum;
+        }
+      }
+    }
+
+    /**
+     * Resets the model parameters, which results in uniform attenuation
+     * @param params parameter vector to be reset
+     * @param grid_width number of grid nodes per row
+     * @param grid_height number of grid nodes per column
+     */
+    static inline void ResetParameters(double* params, int grid_width,
+        int grid_height)
+    {
+      const int count = GetNumParams(grid_width, grid_height);
+      Eigen::Map<Eigen::VectorXd> x(params, count);
+      x.setOnes();
+    }
+
+    /**
+     * Returns the number of parameters needed for the specified grid size
+     * @param grid_width number of grid nodes per row
+     * @param grid_height number of grid nodes per column
+     * @return number of parameters of the model
+     */
+    static inline int GetNumParams(int grid_width, int grid_height)
+    {
+      return grid_width * grid_height;
+    }
+
+    /**
+     * Returns the default number of grid nodes along an image dimension
+     * @param size image width or height
+     * @return number of grid nodes
+     */
+    static inline int GetDefaultGridSize(int size)
+    {
+      return std::max(2, (size + default_cell_size - 1) /
+          default_cell_size + 1);
+    }
+
+  protected:
+
+    /**
+     * Evaluates the attenuation at every pixel center of the model image
+     * @param out row-major output buffer of width x height values
+     */
+    void ComputeAttenuationImage(float* out) const override
+    {
+      GetAttenuations(this->params_.data(), this->width_, this->height_,
+          grid_width_, grid_height_, interpolation_, out);
+    }
+
+    /**
+     * Computes the first node and node weights interpolating the given
+     * image coordinate along one dimension
+     * @param u image coordinate
+     * @param size image size along the dimension
+     * @param grid_size number of grid nodes along the dimension
+     * @param interpolation upsampling used between grid nodes
+     * @param first output index of the first weighted node
+     * @param weights output weights of two or four consecutive nodes
+     */
+    static inline void GetWeights(double u, int size, int grid_size,
+        GridInterpolation interpolation, int& first, double* weights)
+    {
+      // map to grid coordinates, clamped to the grid
+
+      const double g = std::max(0.0, std::min(grid_size - 1.0,
+          u * (grid_size - 1) / size));
+
+      const int g0 = std::min(int(g), grid_size - 2);
+      const double s = g - g0;
+
+      if (interpolation == GRID_BICUBIC)
+      {
+        const double ss = s * s;
+        const double sss = ss * s;
+        first = g0 - 1;
+        weights[0] = 0.5 * (-sss + 2 * ss - s);
+        weights[1] = 0.5 * (3 * sss - 5 * ss + 2);
+        weights[2] = 0.5 * (-3 * sss + 4 * ss + s);
+        weights[3] = 0.5 * (sss - ss);
+      }
+      else
+      {
+        first = g0;
+        weights[0] = 1 - s;
+        weights[1] = s;
+      }
+    }
+
+    /**
+     * Interpolates the grid vertically into one row of nodes
+     * @param params model parameters used for evaluation
+     * @param v vertical image coordinate of the row
+     * @param height image height of model
+     * @param grid_width number of grid nodes per row
+     * @param grid_height number of grid nodes per column
+     * @param interpolation upsampling used between grid nodes
+     * @param nodes output row of grid_width interpolated nodes
+     */
+    static inline void InterpolateRow(const double* params, double v,
+        int height, int grid_width, int grid_height,
+        GridInterpolation interpolation, double* nodes)
+    {
+      const int taps = (interpolation == GRID_BICUBIC) ? 4 : 2;
+
+      int y0;
+      double wy[4];
+      GetWeights(v, height, grid_height, interpolation, y0, wy);
+      std::fill(nodes, nodes + grid_width, 0.0);
+
+      for (int j = 0; j < taps; ++j)
+      {
+        const double* row = params + ClampNode(y0 + j, grid_height) *
+            grid_width;
+
+        for (int i = 0; i < grid_width; ++i)
+        {
+          nodes[i] += wy[j] * row[i];
+        }
+      }
+    }
+
+    /**
+     * Clamps a node index to the grid, repeating its border nodes
+     * @param index node index
+     * @param grid_size number of grid nodes along the dimension
+     * @return clamped index
+     */
+    static inline int ClampNode(int index, int grid_size)
+    {
+      return std::max(0, std::min(grid_size - 1, index));
+    }
+
+  protected:
+
+    /** Number of grid nodes per row */
+    int grid_width_;
+
+    /** Number of grid nodes per column */
+    int grid_height_;
+
+    /** Upsampling used between grid nodes */
+    GridInterpolation interpolation_;
+};
+
+} // namespace calibu
@@ -41,6 +41,47 @@ class VignettingImpl : public Vignetting<Scalar>
           this->width_, this->height_);
     }
 
+    /**
+     * Evaluates the attenuation at a buffer of image points, calling the
+     * model directly for each point.
+     * @param u horizontal image coordinates of points being evaluated
+     * @param v vertical image coordinates of points being evaluated
+     * @param out output attenuation factors
+     * @param n number of points
+     */
+    void Evaluate(const Scalar* u, const Scalar* v, Scalar* out,
+        size_t n) const override
+    {
+      const double* params = this->params_.data();
+      const int w = this->width_;
+      const int h = this->height_;
+
+      for (size_t i = 0; i < n; ++i)
+      {
+        out[i] = Derived::GetAttenuation(params, u[i], v[i], w, h);
+      }
+    }
+
+    /**
+     * Evaluates the attenuation along part of an image row, calling the
+     * model directly for each point.
+     * @param v vertical image coordinate of the row
+     * @param u0 horizontal image coordinate of the first point
+     * @param n number of points
+     * @param out output attenuation factors
+     */
+    void EvaluateRow(Scalar v, Scalar u0, size_t n, Scalar* out) const override
+    {
+      const double* params = this->params_.data();
+      const int w = this->width_;
+      const int h = this->height_;
+
+      for (size_t i = 0; i < n; ++i)
+      {
+        out[i] = Derived::GetAttenuation(params, u0 + Scalar(i), v, w, h);
+      }
+    }
+
     /**
      * Resets the model parameters, which results in uniform attenuation.
      */
@@ -48,6 +89,20 @@ class VignettingImpl : public Vignetting<Scalar>
     {
       Derived::ResetParameters(this->params_.data(),
           this->width_, this->height_);
+
+      this->InvalidateImages();
+    }
+
+  protected:
+
+    /**
+     * Evaluates the attenuation at every pixel center of the model image
+     * @param out row-major output buffer of width x height values
+     */
+    void ComputeAttenuationImage(float* out) const override
+    {
+      Derived::GetAttenuations(this->params_.data(),
+          this->width_, this->height_, out);
     }
 
   private:
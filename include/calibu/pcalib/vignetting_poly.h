@@ -60,7 +60,7 @@ class EvenPoly6Vignetting :
       const double radius = (point - center).norm();
       const double max_radius = center.norm();
       const double ratio = radius / max_radius;
-      const T rr = ratio * ratio;
+      const T rr = T(ratio * ratio);
       T pow = rr;
 
       // add each term of the polynomial
@@ -74,6 +74,38 @@ class EvenPoly6Vignetting :
       return result;
     }
 
+    /**
+     * Evaluates the attenuation at every pixel center of the image. The
+     * squared horizontal radius is computed once per column, and each row is
+     * evaluated with array operations that the compiler can vectorize.
+     * @param params model parameters used for evaluation
+     * @param width image width of model
+     * @param height image height of model
+     * @param out row-major output buffer of width x height values
+     */
+    static inline void GetAttenuations(const double* params, int width,
+        int height, float* out)
+    {
+      const Eigen::Vector2d center = 0.5 * Eigen::Vector2d(width, height);
+      const double inv_max_rr = 1.0 / center.squaredNorm();
+
+      // squared horizontal distance to center for each pixel column
+
+      const Eigen::ArrayXd dx = Eigen::ArrayXd::LinSpaced(width,
+          0.5 - center[0], width - 0.5 - center[0]);
+
+      const Eigen::ArrayXd dxx = inv_max_rr * dx.square();
+
+      for (int y = 0; y < height; ++y)
+      {
+        const double dy = y + 0.5 - center[1];
+        const Eigen::ArrayXd rr = dxx + inv_max_rr * dy * dy;
+        Eigen::Map<Eigen::ArrayXf> row(out + size_t(y) * width, width);
+        row = (1 + rr * (params[0] + rr * (params[1] + rr * params[2])))
+            .cast<float>();
+      }
+    }
+
     /**
      * Resets the model parameters, which results in uniform attenuation
      * @param params parameter vector to be reset
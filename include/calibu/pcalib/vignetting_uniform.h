@@ -52,6 +52,20 @@ class UniformVignetting :
       return T(1);
     }
 
+    /**
+     * Evaluates the attenuation at every pixel center of the image, which is
+     * always one for this model.
+     * @param params model parameters used for evaluation
+     * @param width image width of model
+     * @param height image height of model
+     * @param out row-major output buffer of width x height values
+     */
+    static inline void GetAttenuations(const double*, int width,
+        int height, float* out)
+    {
+      std::fill(out, out + size_t(width) * height, 1.0f);
+    }
+
     /**
      * Resets the model parameters, which results in uniform attenuation.
      * For this specific model, this function does nothing
@@ -0,0 +1,51 @@
+/*
+   This file is part of the Calibu Project.
+   https://github.com/gwu-robotics/Calibu
+
+   Copyright (C) 2013 George Washington University,
+                      Steven Lovegrove
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+   http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#pragma once
+
+#include <cmath>
+#include <vector>
+#include <Eigen/Core>
+#include <sophus/se3.hpp>
+#include <calibu/Platform.h>
+
+namespace calibu {
+
+/// Poses T_cw for which unit bearing vectors f[0..2] point at T_cw * P[i],
+/// by Grunert's solution of the perspective three point problem. Returns
+/// the number of solutions written to T_cw, at most 4.
+CALIBU_EXPORT
+int P3p( const Eigen::Vector3d f[3], const Eigen::Vector3d P[3],
+         Sophus::SE3d T_cw[4] );
+
+/// Gauss-Newton refinement of T_cw on the angular error between unit
+/// bearing vectors f.col(i) and T_cw * P.col(i), for i in idx.
+CALIBU_EXPORT
+void RefineBearingPose(
+        const Eigen::Matrix3Xd& f, const Eigen::Matrix3Xd& P,
+        const std::vector<int>& idx, int iterations, Sophus::SE3d& T_cw );
+
+/// Angle between unit bearing vector f and point P_c, in radians.
+inline double BearingError( const Eigen::Vector3d& f, const Eigen::Vector3d& P_c )
+{
+    return std::atan2( f.cross(P_c).norm(), f.dot(P_c) );
+}
+
+}
@@ -21,6 +21,7 @@
 
 #pragma once
 
+#include <random>
 #include <vector>
 #include <sophus/se3.hpp>
 #include <calibu/Platform.h>
@@ -49,4 +50,85 @@ namespace calibu {
 
   int CountInliers(const std::vector<int> & conics_target_map);
 
+    struct ParamsPnp
+    {
+        ParamsPnp() :
+            robust_3pt_its(100),
+            robust_3pt_tol(1.5),
+            refine_its(10),
+            min_inliers(4) {}
+
+        // RANSAC iterations, and inlier reprojection error in pixels. At
+        // least one hypothesis is always tried.
+        int robust_3pt_its;
+        double robust_3pt_tol;
+
+        // Gauss-Newton iterations refining the pose on its inliers
+        int refine_its;
+        int min_inliers;
+    };
+
+    /// Pose of a target from 2D / 3D correspondences, keeping its buffers
+    /// between calls so that per frame use doesn't allocate. Points are
+    /// unprojected once with the camera's own model, so every camera model
+    /// is handled exactly.
+    class CALIBU_EXPORT PnpSolver
+    {
+    public:
+        /// Robustly estimate T_cw from the candidate correspondences
+        /// img_pts[i] <-> ideal_pts[candidate_map[i]] by P3P RANSAC on
+        /// bearing vectors, then refine it.
+        /// Returns the number of inliers, which inlier_map holds (the
+        /// candidate map with outliers set to -1). T_cw is only changed if
+        /// at least min_inliers are found.
+        int Solve(
+            const std::shared_ptr<CameraInterface<double>> cam,
+            const std::vector<Eigen::Vector2d, Eigen::aligned_allocator<Eigen::Vector2d> > & img_pts,
+            const std::vector<Eigen::Vector3d, Eigen::aligned_allocator<Eigen::Vector3d> > & ideal_pts,
+            const std::vector<int> & candidate_map,
+            Sophus::SE3d& T_cw,
+            std::vector<int> & inlier_map
+            );
+
+        /// As Solve, but starting from prior T_cw instead of RANSAC. Inliers
+        /// are the candidates that reproject within robust_3pt_tol, so the
+        /// prior must already be close.
+        int Refine(
+            const std::shared_ptr<CameraInterface<double>> cam,
+            const std::vector<Eigen::Vector2d, Eigen::aligned_allocator<Eigen::Vector2d> > & img_pts,
+            const std::vector<Eigen::Vector3d, Eigen::aligned_allocator<Eigen::Vector3d> > & ideal_pts,
+            const std::vector<int> & candidate_map,
+            Sophus::SE3d& T_cw,
+            std::vector<int> & inlier_map
+            );
+
+        ParamsPnp& Params() {
+            return params_;
+        }
+
+    protected:
+        // Gauss-Newton on the reprojection error of candidates within
+        // robust_3pt_tol of T_cw. Returns the number of inliers of T_cw.
+        int GaussNewton(
+            const std::shared_ptr<CameraInterface<double>> cam,
+            const std::vector<Eigen::Vector2d, Eigen::aligned_allocator<Eigen::Vector2d> > & img_pts,
+            const std::vector<Eigen::Vector3d, Eigen::aligned_allocator<Eigen::Vector3d> > & ideal_pts,
+            const std::vector<int> & candidate_map,
+            Sophus::SE3d& T_cw,
+            std::vector<int> & inlier_map
+            );
+
+        ParamsPnp params_;
+
+        // RANSAC workspace: candidate pixels, their unit bearing vectors
+        // and target points, and index into the input of each
+        Eigen::Matrix2Xd pix_;
+        Eigen::Matrix3Xd rays_;
+        Eigen::Matrix3Xd obj_;
+        std::vector<int> idx_;
+        std::vector<int> inliers_;
+        std::vector<int> best_inliers_;
+        std::mt19937 rng_;
+    };
+
 }
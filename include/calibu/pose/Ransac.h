@@ -21,13 +21,78 @@
 #pragma once
 
 #include <calibu/Platform.h>
+#include <calibu/utils/Parallel.h>
 
 #include <algorithm>
+#include <cmath>
+#include <cstdint>
 #include <vector>
 #include <limits>
 
 namespace calibu {
 
+/// Small, fast xorshift64* generator for sampling minimal sets.
+class RansacRandom
+{
+public:
+    explicit RansacRandom(uint64_t seed = 0x9E3779B97F4A7C15ull)
+        : state(seed ? seed : 0x9E3779B97F4A7C15ull)
+    {
+    }
+
+    uint64_t operator()()
+    {
+        state ^= state >> 12;
+        state ^= state << 25;
+        state ^= state >> 27;
+        return state * 0x2545F4914F6CDD1Dull;
+    }
+
+    /// Uniform integer in [0, n)
+    unsigned int Uniform(unsigned int n)
+    {
+        return (unsigned int)(((*this)() >> 32) * n >> 32);
+    }
+
+    /// Generator for the stream'th of a sequence seeded by seed. Streams are
+    /// decorrelated by the splitmix64 finaliser.
+    static RansacRandom Stream(uint64_t seed, uint64_t stream)
+    {
+        uint64_t z = seed + (stream + 1) * 0x9E3779B97F4A7C15ull;
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+        return RansacRandom(z ^ (z >> 31));
+    }
+
+protected:
+    uint64_t state;
+};
+
+struct ParamsRansac
+{
+    ParamsRansac() :
+        confidence(0.99),
+        preemptive_test_size(1),
+        num_threads(1),
+        seed(0) {}
+
+    // Stop once a better hypothesis would have been sampled with this
+    // probability, given the best inlier ratio found
+    double confidence;
+
+    // Number of random elements a hypothesis must fit before its full
+    // consensus set is evaluated (the T(d,d) test). 0 disables the test.
+    int preemptive_test_size;
+
+    // Hypotheses evaluated concurrently, 0 for one per core. ModelFunction
+    // and CostFunction must be safe to call from several threads.
+    unsigned int num_threads;
+
+    // Seed of the samples. Each hypothesis samples from its own stream, so
+    // results are repeatable whichever thread evaluates it.
+    uint64_t seed;
+};
+
 template<typename Model, int minimum_set_size, typename Data>
 class Ransac
 {
@@ -35,75 +100,165 @@ public:
     typedef double(*CostFunction)(const Model& model, int element_index, Data);
     typedef Model(*ModelFunction)(const std::vector<int>& element_indices, Data);
 
-    Ransac(ModelFunction mf, CostFunction cf, Data data)
-        : mf(mf), cf(cf), data(data)
+    Ransac(ModelFunction mf, CostFunction cf, Data data,
+           const ParamsRansac& params = ParamsRansac())
+        : mf(mf), cf(cf), data(data), params(params)
     {
     }
 
+    ParamsRansac& Params() {
+        return params;
+    }
+
+    /// Model fit to the largest consensus set found within iterations
+    /// hypotheses, or fewer once the best inlier ratio makes a larger set
+    /// unlikely. The model is refit to that set once at the end, and the
+    /// refit is returned unless its consensus set is smaller, in which case
+    /// the winning hypothesis is. inliers is the consensus set of the
+    /// returned model. Results don't depend on num_threads.
     Model Compute(unsigned int num_elements, std::vector<int>& inliers, int iterations, double max_datum_fit_error, unsigned int min_consensus_size)
     {
         // http://en.wikipedia.org/wiki/RANSAC
+        inliers.clear();
         if (num_elements < minimum_set_size)
             return Model();
 
-        Model best_model;
-        std::vector<int> best_consensus_set;
-        double best_error = std::numeric_limits<double>::max();
+        const int slots = std::min<int>(NumWorkerThreads(params.num_threads),
+                                        std::max(iterations, 1));
+        hypotheses.resize(slots);
+        for (Hypothesis& h : hypotheses)
+            h.member.assign((num_elements + 63) / 64, 0);
 
-        for (int k = 0; k < iterations; ++k)
+        best_consensus_set.clear();
+        best_sample.clear();
+        int max_iterations = iterations;
+        for (int k = 0; k < max_iterations; k += slots)
         {
-            std::vector<int> maybe_inliers;
-            SelectCandidates(maybe_inliers, num_elements);
-            Model maybe_model = (*mf)(maybe_inliers, data);
-            std::vector<int> consensus_set(maybe_inliers);
+            const int count = std::min(slots, max_iterations - k);
+            ParallelForBands(count, params.num_threads, [&](int begin, int end) {
+                for (int b = begin; b < end; ++b)
+                    Evaluate(hypotheses[b], k + b, num_elements, max_datum_fit_error);
+            });
 
-            for (unsigned int i = 0; i<num_elements; ++i)
+            // Accept hypotheses in order, as if evaluated one at a time, so
+            // that those past the point a serial search would stop are
+            // ignored
+            for (int b = 0; b < count && k + b < max_iterations; ++b)
             {
-                if (find(maybe_inliers.begin(), maybe_inliers.end(), i) == maybe_inliers.end())
+                if (hypotheses[b].consensus_set.size() > best_consensus_set.size())
                 {
-                    const double err = (*cf)(maybe_model, i, data);
-                    if (err < max_datum_fit_error)
-                        consensus_set.push_back(i);
+                    best_consensus_set.swap(hypotheses[b].consensus_set);
+                    best_sample = hypotheses[b].sample;
+                    max_iterations = std::min(iterations, k + b + 1 +
+                        RequiredIterations(best_consensus_set.size(), num_elements));
                 }
             }
+        }
 
-            if (consensus_set.size() >= min_consensus_size)
+        if (best_consensus_set.size() < min_consensus_size)
+            return Model();
+
+        // Refit to the best consensus set, keeping the winning hypothesis if
+        // the refit model's consensus is smaller
+        const Model refit_model = (*mf)(best_consensus_set, data);
+        inliers.clear();
+        for (unsigned int i = 0; i < num_elements; ++i)
+        {
+            if ((*cf)(refit_model, i, data) < max_datum_fit_error)
+                inliers.push_back(i);
+        }
+        if (inliers.size() < best_consensus_set.size())
+        {
+            inliers = best_consensus_set;
+            return (*mf)(best_sample, data);
+        }
+        return refit_model;
+    }
+
+protected:
+    struct Hypothesis
+    {
+        std::vector<int> sample;
+        std::vector<uint64_t> member;
+        std::vector<int> consensus_set;
+    };
+
+    // Hypotheses still needed after the current ones to reach confidence
+    int RequiredIterations(size_t num_inliers, unsigned int num_elements) const
+    {
+        const double w = (double)num_inliers / num_elements;
+        const double p_good = std::pow(w, (int)minimum_set_size);
+        if (p_good >= 1.0)
+            return 0;
+        if (p_good <= 0.0)
+            return std::numeric_limits<int>::max() / 2;
+        const double n = std::ceil(std::log(1.0 - params.confidence) /
+                                   std::log(1.0 - p_good));
+        return n < std::numeric_limits<int>::max() / 2 ? (int)n :
+                                                         std::numeric_limits<int>::max() / 2;
+    }
+
+    // Sample and fit the index'th hypothesis, leaving its consensus set
+    // empty if it fails the preemptive test
+    void Evaluate(Hypothesis& h, int index, unsigned int num_elements,
+                  double max_datum_fit_error)
+    {
+        RansacRandom rng = RansacRandom::Stream(params.seed, index);
+        SelectCandidates(h, num_elements, rng);
+        const Model maybe_model = (*mf)(h.sample, data);
+        h.consensus_set.clear();
+
+        for (int t = 0; t < params.preemptive_test_size; ++t)
+        {
+            const unsigned int i = rng.Uniform(num_elements);
+            if (!IsMember(h, i) && !((*cf)(maybe_model, i, data) < max_datum_fit_error))
             {
-                Model better_model = (*mf)(consensus_set, data);
-                double this_error = 0;
-                for (unsigned int i = 0; i< consensus_set.size(); ++i)
-                {
-                    double err = (*cf)(better_model, consensus_set[i], data);
-                    this_error += err*err;
-                }
-                this_error /= consensus_set.size();
-                if (this_error < best_error)
-                {
-                    best_model = better_model;
-                    best_consensus_set = consensus_set;
-                    best_error = this_error;
-                }
+                ClearMembers(h);
+                return;
             }
         }
 
-        inliers = best_consensus_set;
-        return best_model;
+        h.consensus_set = h.sample;
+        for (unsigned int i = 0; i < num_elements; ++i)
+        {
+            if (!IsMember(h, i) && (*cf)(maybe_model, i, data) < max_datum_fit_error)
+                h.consensus_set.push_back(i);
+        }
+        ClearMembers(h);
     }
 
-protected:
-    void SelectCandidates(std::vector<int>& set, int num_elements)
+    void SelectCandidates(Hypothesis& h, unsigned int num_elements, RansacRandom& rng)
     {
-        while (set.size() < minimum_set_size)
+        h.sample.clear();
+        while (h.sample.size() < minimum_set_size)
         {
-            const int i = rand() % num_elements;
-            if (find(set.begin(), set.end(), i) == set.end())
-                set.push_back(i);
+            const unsigned int i = rng.Uniform(num_elements);
+            if (!IsMember(h, i)) {
+                h.member[i >> 6] |= uint64_t(1) << (i & 63);
+                h.sample.push_back(i);
+            }
         }
     }
 
+    static bool IsMember(const Hypothesis& h, unsigned int i)
+    {
+        return (h.member[i >> 6] >> (i & 63)) & 1;
+    }
+
+    static void ClearMembers(Hypothesis& h)
+    {
+        for (int i : h.sample)
+            h.member[i >> 6] = 0;
+    }
+
     ModelFunction mf;
     CostFunction cf;
     Data data;
+    ParamsRansac params;
+
+    std::vector<Hypothesis> hypotheses;
+    std::vector<int> best_consensus_set;
+    std::vector<int> best_sample;
 };
 
 }
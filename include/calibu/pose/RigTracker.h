@@ -0,0 +1,128 @@
+/*
+   This file is part of the Calibu Project.
+   https://github.com/gwu-robotics/Calibu
+
+   Copyright (C) 2013 George Washington University,
+                      Steven Lovegrove
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+   http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#pragma once
+
+#include <memory>
+#include <vector>
+#include <sophus/se3.hpp>
+
+#include <calibu/target/Target.h>
+#include <calibu/conics/ConicFinder.h>
+#include <calibu/pose/Pnp.h>
+#include <calibu/pose/Tracker.h>
+#include <calibu/cam/camera_crtp.h>
+
+namespace calibu {
+
+struct ParamsRigTracker
+{
+    ParamsRigTracker() :
+        num_threads(0),
+        refine_its(10) {}
+
+    // Detection and pose thresholds, with inlier_num_required and max_rms
+    // applying to all cameras together
+    ParamsTracker tracker;
+
+    // Threads processing camera images, 0 for one per core
+    unsigned int num_threads;
+
+    // Gauss-Newton iterations of the joint rig pose
+    int refine_its;
+};
+
+/// Finds a target in synchronized images of every camera of a rig, and the
+/// single pose T_rw of the rig that best explains all of them, using the
+/// rig to camera extrinsics cam->Pose().
+class CALIBU_EXPORT RigTracker
+{
+public:
+    RigTracker(TargetInterface& target, std::shared_ptr<Rig<double>> rig);
+
+    /// Process one image per camera, with rows pitches[c] bytes apart and
+    /// the size of the camera. Returns true if the rig pose was found.
+    bool ProcessFrames( const std::vector<const unsigned char*>& images,
+                        const std::vector<size_t>& pitches );
+
+    const TargetInterface& Target() const {
+        return target;
+    }
+
+    size_t NumCams() const {
+        return cams.size();
+    }
+
+    const ConicFinder& GetConicFinder(size_t c) const {
+        return *finders[c];
+    }
+
+    const ImageProcessing& Images(size_t c) const {
+        return *imgs[c];
+    }
+
+    const std::vector<int>& ConicsTargetMap(size_t c) const {
+        return conics_target_map[c];
+    }
+
+    const Sophus::SE3d& PoseT_rw() const {
+        return T_rw;
+    }
+
+    ParamsRigTracker& Params() {
+        return params;
+    }
+
+protected:
+    // Find target in camera c, given its pose T_cw if pose_known. Returns
+    // the number of correspondences found, and their pose in T_cw.
+    int FindCamera( size_t c, bool pose_known, Sophus::SE3d& T_cw );
+
+    // Gauss-Newton on the reprojection error of all cameras' inliers
+    void RefineRigPose( Sophus::SE3d& T );
+
+    // Keep the correspondences of all cameras consistent with T. Returns
+    // their number in inliers, and their reprojection error RMS.
+    double UpdateInliers( const Sophus::SE3d& T, int& inliers );
+
+    // Estimate T_rw from this frame's conics, starting from T_rw if
+    // pose_known
+    bool FindRigPose( bool pose_known );
+
+    TargetInterface& target;
+    std::vector<std::shared_ptr<CameraInterface<double>>> cams;
+
+    // Per camera detection
+    std::vector<std::unique_ptr<ImageProcessing> > imgs;
+    std::vector<std::unique_ptr<ConicFinder> > finders;
+    std::vector<ConicSet> conics_camframe;
+    std::vector<std::vector<int> > conics_target_map;
+    std::vector<std::vector<int> > candidate_map;
+    PnpSolver pnp;
+
+    // Last good rig pose
+    Sophus::SE3d T_rw;
+    bool pose_valid;
+    int tracked_frames;
+
+    ParamsRigTracker params;
+};
+
+}
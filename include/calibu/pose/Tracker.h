@@ -21,15 +21,23 @@
 
 #pragma once
 
+#include <condition_variable>
+#include <cstdint>
+#include <ctime>
+#include <functional>
+#include <future>
 #include <memory>
+#include <mutex>
+#include <thread>
 #include <sophus/se3.hpp>
-#include <ctime>
 
 #include <calibu/target/Target.h>
 #include <calibu/conics/ConicFinder.h>
+#include <calibu/pose/Pnp.h>
 #include <calibu/cam/camera_crtp.h>
 #include <calibu/cam/camera_crtp_impl.h>
 #include <calibu/cam/camera_models_crtp.h>
+#include <calibu/utils/PipelineStats.h>
 
 namespace calibu {
 
@@ -39,51 +47,182 @@ struct ParamsTracker
         robust_3pt_inlier_tol(1.5),
         robust_3pt_its(100),
         inlier_num_required(10),
-        max_rms(3.0) {}
+        max_rms(3.0),
+        roi_tracking(false),
+        roi_margin(0.25),
+        roi_min_margin(16),
+        target_tracking(false),
+        revalidate_frames(30),
+        motion_model(true) {}
     
     double robust_3pt_inlier_tol;
     int robust_3pt_its;
     int inlier_num_required;
     double max_rms;
+
+    // Once the target has been found, only process the image around where
+    // it was last seen. The bounding box of the reprojected target grows by
+    // roi_margin of its size, and at least roi_min_margin pixels.
+    bool roi_tracking;
+    double roi_margin;
+    int roi_min_margin;
+
+    // Once the target has been found, find it in the next frame from the
+    // last good pose instead of searching for it. The full search runs when
+    // tracking fails, and at least every revalidate_frames frames.
+    bool target_tracking;
+    int revalidate_frames;
+
+    // When tracking, predict the pose from the last two good frames with a
+    // constant velocity model, rather than reuse the last pose
+    bool motion_model;
+};
+
+// Outcome of a frame given to Tracker::Submit
+struct TrackerResult
+{
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW;
+
+    TrackerResult() : frame(0), processed(false), good(false) {}
+
+    // Sequence number returned by Submit
+    uint64_t frame;
+
+    // False if the frame was dropped for a newer one before it was reached
+    bool processed;
+
+    // Whether the target was found, and the last good pose
+    bool good;
+    Sophus::SE3d T_gw;
 };
 
 class Tracker
 {
 public:
+    typedef std::function<void(const TrackerResult&)> Callback;
+
     Tracker(TargetInterface& target, int w, int h);
+    ~Tracker();
 
     bool ProcessFrame( std::shared_ptr<CameraInterface<double>> cam,
                       const unsigned char *I, size_t w, size_t h, size_t pitch );
+
+    // Process a frame on a worker thread, returning straight away. The
+    // image is copied, so the caller may reuse it. A frame still waiting
+    // when the next one is submitted is dropped rather than queued, so the
+    // worker always moves on to the newest frame. The returned future, and
+    // the callback for processed frames, give the result. Frame k+1 is
+    // detected while the result of frame k is consumed: Images(),
+    // GetConicFinder(), ConicsTargetMap() and PoseT_gw() read the last
+    // completed frame, and stay unchanged while LockResult() is held.
+    // Don't mix with ProcessFrame, or change Params() meanwhile.
+    std::future<TrackerResult> Submit( std::shared_ptr<CameraInterface<double>> cam,
+                                       const unsigned char *I, size_t w, size_t h, size_t pitch );
+
+    // Called on the worker thread after each processed frame, so it holds
+    // up the next one and should be quick.
+    void SetCallback( const Callback& callback ) {
+        std::lock_guard<std::mutex> lock(queue_mutex);
+        result_callback = callback;
+    }
+
+    // Block until all submitted frames are processed or dropped
+    void Wait();
+
+    // Lock the results of the last completed frame against the worker
+    // replacing them
+    std::unique_lock<std::mutex> LockResult() const {
+        return std::unique_lock<std::mutex>(result_mutex);
+    }
     
     const TargetInterface& Target() const {
         return target;
     }
     
     const ConicFinder& GetConicFinder() const {
-        return conic_finder;
+        return front->conic_finder;
     }
     
     const ImageProcessing& Images() const {
-        return imgs;
+        return front->imgs;
     }
     
     const std::vector<int>& ConicsTargetMap() const{
-        return conics_target_map;
+        return front->conics_target_map;
     }
     
     const Sophus::SE3d& PoseT_gw() const
     {
-        return T_gw;
+        return front->T_gw;
+    }
+
+    // Time spent in each detection stage, summed over all threads. Empty
+    // unless Calibu is built with BUILD_PIPELINE_STATS.
+    PipelineStats Stats() const {
+        return GetPipelineStats();
+    }
+
+    ParamsTracker& Params() {
+        return params;
+    }
+
+    // Prior for the pose of the next frame, e.g. from an IMU. The target
+    // is then tracked from T_hw without searching for it, even if tracking
+    // is disabled or was lost.
+    void SetPosePrior( const Sophus::SE3d& T_hw ) {
+        std::lock_guard<std::mutex> lock(queue_mutex);
+        T_prior = T_hw;
+        prior_valid = true;
     }
     
 protected:
+    // Detection state of one frame. Frames are processed into back, which
+    // is then swapped with front, the last completed frame.
+    struct Buffer
+    {
+        EIGEN_MAKE_ALIGNED_OPERATOR_NEW;
+        Buffer(int w, int h) : imgs(w,h) {}
+
+        ImageProcessing imgs;
+        ConicFinder conic_finder;
+        std::vector<int> conics_target_map;
+        Sophus::SE3d T_gw;
+    };
+
+    // ProcessFrame into the back buffer
+    bool ProcessBack( std::shared_ptr<CameraInterface<double>> cam,
+                      const unsigned char *I, size_t w, size_t h, size_t pitch );
+
+    // Submit worker loop
+    void Work();
+
+    // Find target and its pose in the processed images
+    bool FindPose( std::shared_ptr<CameraInterface<double>> cam );
+
+    // Set region of interest around the target seen with pose T_hw
+    void UpdateRoi( std::shared_ptr<CameraInterface<double>> cam );
+
+    // Predicted pose of this frame, false if there is no confident one
+    bool PredictPose( Sophus::SE3d& T_pw );
+
+    // Update motion model with new good pose T_gw
+    void UpdateMotion( bool tracked );
+
+    // Refine T_hw from candidate map conics_target_map
+    bool EstimatePose( std::shared_ptr<CameraInterface<double>> cam,
+        const std::vector<Eigen::Vector2d, Eigen::aligned_allocator<Eigen::Vector2d> >& ellipses );
+
     // Target
     TargetInterface& target;
-    ImageProcessing imgs;
-    ConicFinder conic_finder;
+    std::unique_ptr<Buffer> front;
+    std::unique_ptr<Buffer> back;
+    mutable std::mutex result_mutex;
+    PnpSolver pnp;
     
+    // Conics of the last frame unmapped through the camera
+    ConicSet conics_camframe;
+
     // Hypothesis conics
-    std::vector<int> conics_target_map;
     std::vector<int> conics_candidate_map_first_pass;
     std::vector<int> conics_candidate_map_second_pass;
     
@@ -91,11 +230,46 @@ protected:
     Sophus::SE3d T_gw;
     std::clock_t last_good;
     int good_frames;
+
+    // True if T_gw is the pose of the last frame, and the number of frames
+    // tracked from it since the last full search
+    bool pose_valid;
+    int tracked_frames;
+
+    // Motion between the last two good frames, T_gw = T_vel * T_gw_last,
+    // if vel_valid
+    Sophus::SE3d T_vel;
+    bool vel_valid;
+
+    // Pose prior for the next frame, if prior_valid
+    Sophus::SE3d T_prior;
+    bool prior_valid;
     
     // Pose hypothesis
     Sophus::SE3d T_hw;
+
+    // Image region to search in the next frame, if roi_valid
+    IRectangle roi;
+    bool roi_valid;
     
     ParamsTracker params;
+
+    // Submit state. pending holds the newest frame not yet started, if
+    // pending_valid; busy while the worker processes a frame.
+    std::thread worker;
+    std::mutex queue_mutex;
+    std::condition_variable queue_cond;
+    std::shared_ptr<CameraInterface<double>> pending_cam;
+    std::vector<unsigned char> pending_image;
+    std::vector<unsigned char> work_image;
+    size_t pending_w, pending_h;
+    uint64_t pending_frame;
+    std::promise<TrackerResult> pending_promise;
+    bool pending_valid;
+    bool busy;
+    bool stop;
+    uint64_t next_frame;
+    Callback result_callback;
 };
 
 }
@@ -0,0 +1,104 @@
+/*
+   This file is part of the Calibu Project.
+   https://github.com/gwu-robotics/Calibu
+
+   Copyright (C) 2013 George Washington University,
+                      Steven Lovegrove
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+   http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#pragma once
+
+#include <calibu/Platform.h>
+
+#include <Eigen/Core>
+#include <limits>
+#include <vector>
+
+namespace calibu
+{
+
+/// Allowed assignment of row to col at cost.
+struct AssignmentEdge
+{
+    AssignmentEdge() {}
+    AssignmentEdge(int row, int col, double cost)
+        : row(row), col(col), cost(cost) {}
+
+    int row;
+    int col;
+    double cost;
+};
+
+/// Minimum cost assignment of rows to columns, each column taking at most
+/// one row, by Jonker-Volgenant style shortest augmenting paths over the
+/// allowed (sparse) edges only. Every row may instead be left unassigned at
+/// unassigned_cost, so gated problems always have a solution.
+///
+/// The column prices of the last solution are kept, and can warm start the
+/// next solve of a problem of the same size: rows whose cheapest column at
+/// those prices is free are assigned without a search, which for problems
+/// that change little between frames leaves few paths to augment.
+class CALIBU_EXPORT LinearAssignment
+{
+public:
+    /// Assign rows x cols problem with allowed edges. row_to_col[r] is the
+    /// column assigned to row r, or -1 if it is left unassigned. Returns the
+    /// total cost, including unassigned_cost for each unassigned row.
+    double Solve(
+            int rows, int cols,
+            const std::vector<AssignmentEdge>& edges,
+            double unassigned_cost,
+            std::vector<int>& row_to_col,
+            bool warm_start = false
+            );
+
+    /// Assign rows to columns of dense cost matrix, allowing only costs no
+    /// greater than gate. Rows are left unassigned at cost gate, or if gate
+    /// is infinite, only when no complete assignment exists. Returns the
+    /// total cost of assigned rows, plus gate for each unassigned row if
+    /// gate is finite.
+    double Solve(
+            const Eigen::MatrixXd& cost,
+            std::vector<int>& row_to_col,
+            double gate = std::numeric_limits<double>::infinity(),
+            bool warm_start = false
+            );
+
+protected:
+    // Allowed edges in compressed row order, with column cols+r standing
+    // for leaving row r unassigned
+    std::vector<int> row_begin_;
+    std::vector<int> edge_col_;
+    std::vector<double> edge_cost_;
+    std::vector<AssignmentEdge> dense_edges_;
+
+    // Dual prices of rows and columns
+    std::vector<double> u_;
+    std::vector<double> v_;
+    int rows_ = 0;
+    int cols_ = 0;
+
+    // Search scratch
+    std::vector<int> col_to_row_;
+    std::vector<int> row_col_;
+    std::vector<double> dist_;
+    std::vector<int> pred_;
+    std::vector<int> scanned_;
+    std::vector<int> touched_;
+    std::vector<char> done_;
+    std::vector<std::pair<double,int> > heap_;
+};
+
+}
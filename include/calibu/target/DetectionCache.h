@@ -0,0 +1,93 @@
+/*
+   This file is part of the Calibu Project.
+   https://github.com/arpg/Calibu
+
+   Copyright (C) 2013 George Washington University,
+                      Steven Lovegrove,
+                      Gabe Sibley
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+   http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <calibu/Platform.h>
+#include <calibu/conics/ConicFinder.h>
+#include <calibu/image/ImageProcessing.h>
+#include <calibu/target/TargetGridDot.h>
+#include <Eigen/Eigen>
+#include <Eigen/StdVector>
+
+namespace calibu {
+
+// Target detected in one camera image, before any pose is estimated: the
+// centre of each conic found, the target dot it was matched to (-1 for
+// none) and that dot's grid position.
+struct CachedCameraDetection
+{
+    CachedCameraDetection() : tracking_good(false) {}
+
+    bool tracking_good;
+    std::vector<Eigen::Vector2d, Eigen::aligned_allocator<Eigen::Vector2d> > centers;
+    std::vector<int> target_map;
+    std::vector<Eigen::Vector2i> grid;
+};
+
+// Detections of every camera at one frame.
+typedef std::vector<CachedCameraDetection> CachedFrameDetection;
+
+// Target detections of every frame of a video, so that calibration can be
+// re-run with other camera models or options without decoding the video
+// and detecting the target again. The file stores values in the byte order
+// of the machine that wrote it.
+struct CALIBU_EXPORT DetectionCache
+{
+    DetectionCache() : key(0) {}
+
+    // Write the cache to 'filename', next to its destination and then
+    // renamed into place, so that a partial file is never read.
+    bool Save(const std::string& filename) const;
+
+    // Read 'filename'. Returns false if it is missing or corrupt, or was
+    // written for a key other than 'expected_key'.
+    bool Load(const std::string& filename, uint64_t expected_key);
+
+    // See DetectionCacheHash
+    uint64_t key;
+
+    // Size of each camera's images
+    std::vector<Eigen::Vector2i> image_sizes;
+
+    std::vector<CachedFrameDetection> frames;
+};
+
+static const uint32_t kDetectionCacheVersion = 1;
+
+// Key of the detections of video 'source' with the given detection
+// parameters. 'source' should change whenever the video does, e.g. by
+// including the video file's size and modification time.
+CALIBU_EXPORT uint64_t DetectionCacheHash(
+        const std::string& source,
+        const ParamsImageProcessing& image_params,
+        const ParamsConicFinder& conic_params,
+        const ParamsGridDot& target_params,
+        double grid_spacing,
+        const Eigen::Vector2i& grid_size,
+        uint32_t grid_seed
+        );
+
+}
@@ -25,51 +25,43 @@
 #include <Eigen/Eigen>
 #include <vector>
 #include <array>
-#include <set>
 #include <algorithm>
 
 #include <calibu/Platform.h>
 #include <calibu/conics/Conic.h>
+#include <calibu/conics/ConicSet.h>
+#include <calibu/utils/InlineVector.h>
 
 namespace calibu {
 
 const static int GRID_INVALID = std::numeric_limits<int>::min();
 
-struct Triple;
+struct Vertex;
 
-struct Vertex
+// Capacity of the per vertex graph lists. FindTriples pairs up each of its
+// 13 closest points at most once, so a vertex has at most 6 triples and 12
+// line neighbours, or 9 grid neighbours including itself.
+const static size_t VERTEX_MAX_TRIPLES = 8;
+const static size_t VERTEX_MAX_NEIGHBOURS = 16;
+
+typedef InlineVector<Vertex*, VERTEX_MAX_NEIGHBOURS> VertexNeighbours;
+
+struct Triple
 {
     EIGEN_MAKE_ALIGNED_OPERATOR_NEW;
-    inline Vertex(size_t id, const Conic& c)
-        : id(id), conic(c), pc(c.center), pg(GRID_INVALID,GRID_INVALID), area(0.0), value(-1), pc_u(c.center_undistorted)
-    {
-    }
-
-    inline bool HasGridPosition()
+    inline Triple()
+      : vs{{nullptr, nullptr, nullptr}}
     {
-        return pg(0) != GRID_INVALID;
     }
 
-    size_t id;
-    Conic conic;
-    Eigen::Vector2d pc;
-    Eigen::Vector3d pc_u;
-    Eigen::Vector2i pg;
-    std::vector<Triple> triples;
-    std::set<Vertex*> neighbours;
-    double area;
-    int value;
-};
-
-struct Triple
-{
     inline Triple(Vertex& o1, Vertex& c, Vertex& o2, Eigen::Vector2d angles = Eigen::Vector2d())
     {
-      vs = {&o1, &c, &o2};
+      vs = {{&o1, &c, &o2}};
       m_angles = angles;
     }
 
     Triple(const Triple& triple) = default;
+    Triple& operator=(const Triple& triple) = default;
 
     inline Vertex& Center() { return *vs[1]; }
     inline const Vertex& Center() const { return *vs[1]; }
@@ -83,10 +75,7 @@ struct Triple
     inline Vertex& Vert(size_t i) { return *vs[i]; }
     inline const Vertex& Vert(size_t i) const { return *vs[i]; }
 
-    inline Eigen::Vector2d Dir() const
-    {
-        return vs[2]->pc - vs[0]->pc;
-    }
+    inline Eigen::Vector2d Dir() const;
 
     inline bool Contains(const Vertex& v) const
     {
@@ -94,9 +83,9 @@ struct Triple
         return found;
     }
 
-    inline bool In(const std::set<Vertex*> bag) const
+    inline bool In(const VertexNeighbours& bag) const
     {
-        return bag.find(vs[0]) != bag.end() && bag.find(vs[2]) != bag.end();
+        return bag.contains(vs[0]) && bag.contains(vs[2]);
     }
 
     inline void Reverse()
@@ -105,10 +94,45 @@ struct Triple
     }
 
     // Colinear sequence of vertices, v[0], v[1], v[2]. v[1] is center
-  std::vector<Vertex*> vs;
+  std::array<Vertex*,3> vs;
   Eigen::Vector2d m_angles;
 };
 
+struct Vertex
+{
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW;
+    inline Vertex(size_t id, const Conic& c)
+        : id(id), radius(c.radius), pc(c.center), pc_u(c.center_undistorted), pg(GRID_INVALID,GRID_INVALID), area(0.0), value(-1)
+    {
+    }
+
+    // Vertex of conic id of conics
+    inline Vertex(size_t id, const ConicSet& conics)
+        : id(id), radius(conics.Radius(id)), pc(conics.Center(id)), pc_u(conics.CenterUndistorted(id)), pg(GRID_INVALID,GRID_INVALID), area(0.0), value(-1)
+    {
+    }
+
+    inline bool HasGridPosition()
+    {
+        return pg(0) != GRID_INVALID;
+    }
+
+    size_t id;
+    double radius;
+    Eigen::Vector2d pc;
+    Eigen::Vector3d pc_u;
+    Eigen::Vector2i pg;
+    InlineVector<Triple, VERTEX_MAX_TRIPLES> triples;
+    VertexNeighbours neighbours;
+    double area;
+    int value;
+};
+
+inline Eigen::Vector2d Triple::Dir() const
+{
+    return vs[2]->pc - vs[0]->pc;
+}
+
 inline bool operator==(const Vertex& lhs, const Vertex& rhs)
 {
     return lhs.id == rhs.id;
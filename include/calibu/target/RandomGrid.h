@@ -29,7 +29,9 @@
 #include <array>
 #include <signal.h>
 #include <fstream>
+#include <limits>
 #include <stdint.h>
+#include <vector>
 
 namespace calibu
 {
@@ -60,18 +62,84 @@ int NumExactMatches(const Eigen::MatrixXi& M, const Eigen::MatrixXi& m, int& bes
 CALIBU_EXPORT
 int NumExactMatches(const std::array<Eigen::MatrixXi, 4>& PG, const Eigen::MatrixXi& m, int& best_score, int& best_g, int& best_r, int& best_c);
 
+/// Matrix of 0 / 1 cells packed into 64 bit words per row, so that Hamming
+/// distances are computed with popcounts. Cells holding any other value,
+/// such as the -1 of unobserved cells, are unknown.
+struct CALIBU_EXPORT PackedPattern
+{
+    PackedPattern() : rows(0), cols(0), words(0) {}
+    explicit PackedPattern(const Eigen::MatrixXi& M);
+
+    int rows;
+    int cols;
+    int words;  // per row
+
+    // Row major bit planes, bit i of word w of a row is column 64*w+i.
+    std::vector<uint64_t> known;
+    std::vector<uint64_t> ones;
+};
+
+typedef std::array<PackedPattern, 4> PackedPatternGroup;
+
+CALIBU_EXPORT
+PackedPatternGroup PackGroup(const std::array<Eigen::MatrixXi, 4>& PG);
+
+/// HammingDistance of packed matrices. Equal to the unpacked version for
+/// binary patterns M.
+CALIBU_EXPORT
+int HammingDistance(const PackedPattern& M, const PackedPattern& m, int r, int c);
+
+CALIBU_EXPORT
+int NumExactMatches(const PackedPattern& M, const PackedPattern& m, int& best_score, int& best_r, int& best_c);
+
+CALIBU_EXPORT
+int NumExactMatches(const PackedPatternGroup& PG, const PackedPattern& m, int& best_score, int& best_g, int& best_r, int& best_c);
+
+/// Number of exact matches of windows of PG[0], of at least minr x minc
+/// cells (and at least 2 x 2), with placements in PG other than their own.
+/// Windows grow a column at a time, and only windows still matching some
+/// other placement are compared again, so a binary pattern is scored in a
+/// single pass per window height.
 CALIBU_EXPORT
 int AutoCorrelation(const std::array<Eigen::MatrixXi, 4>& PG, int minr = 2, int minc = 2);
 
+/// Area plus one of the largest window of PG[0] that exactly matches more
+/// than one placement across PG, or 0 if no window does, found as for
+/// AutoCorrelation. The search stops once the result reaches 'bound',
+/// returning some value >= bound.
 CALIBU_EXPORT
-int AutoCorrelationMinArea(const std::array<Eigen::MatrixXi, 4>& PG);
+int AutoCorrelationMinArea(const std::array<Eigen::MatrixXi, 4>& PG,
+                           int bound = std::numeric_limits<int>::max());
 
 CALIBU_EXPORT
 int SeedScore(uint32_t seed, int r, int c);
 
+/// Budget for FindBestSeed.
+struct CALIBU_EXPORT SeedSearchOptions
+{
+    SeedSearchOptions() : num_threads(0), max_seeds(0), max_seconds(0) {}
+
+    /// Threads scoring seeds, 0 for one per core.
+    unsigned int num_threads;
+
+    /// Seeds to try, counting up from 0, and time allowed for the search,
+    /// 0 for no limit.
+    uint32_t max_seeds;
+    double max_seconds;
+};
+
+/// Search seeds from 0 for the lowest SeedScore, until should_run is
+/// cleared. Returns the lowest such seed.
 CALIBU_EXPORT
 uint32_t FindBestSeed(int r, int c, bool& should_run);
 
+/// As above, scoring seeds on several threads. Seeds are given up on once
+/// they can't beat the best score so far. Stops when should_run is cleared
+/// or the budget in 'options' is spent.
+CALIBU_EXPORT
+uint32_t FindBestSeed(int r, int c, bool& should_run,
+                      const SeedSearchOptions& options);
+
 CALIBU_EXPORT
 void PrintPattern(const Eigen::MatrixXi& M);
 
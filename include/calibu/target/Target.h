@@ -28,7 +28,7 @@
 #include <calibu/Platform.h>
 #include <calibu/cam/camera_crtp.h>
 #include <calibu/image/ImageProcessing.h>
-#include <calibu/conics/Conic.h>
+#include <calibu/conics/ConicSet.h>
 
 namespace calibu
 {
@@ -46,7 +46,7 @@ public:
             const Sophus::SE3d& T_cw,
             const std::shared_ptr<CameraInterface<double>> cam,
             const ImageProcessing& images,
-            const std::vector<Conic, Eigen::aligned_allocator<Conic> >& conics,
+            const ConicSet& conics,
             std::vector<int>& conics_target_map
             ) = 0;
 
@@ -54,14 +54,14 @@ public:
     virtual bool FindTarget(
             const std::shared_ptr<CameraInterface<double>> cam,
             const ImageProcessing& images,
-            const std::vector<Conic, Eigen::aligned_allocator<Conic> >& conics,
+            const ConicSet& conics,
             std::vector<int>& conics_target_map
             ) = 0;
 
     // Only observations known
     virtual bool FindTarget(
             const ImageProcessing& images,
-            const std::vector<Conic, Eigen::aligned_allocator<Conic> >& conics,
+            const ConicSet& conics,
             std::vector<int>& conics_target_map
             ) = 0;
 
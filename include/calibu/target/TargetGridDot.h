@@ -25,11 +25,16 @@
 #pragma once
 
 #include <array>
+#include <limits>
+#include <list>
 #include <map>
+#include <vector>
 
 #include <calibu/Platform.h>
 #include <calibu/target/Target.h>
 #include <calibu/target/LineGroup.h>
+#include <calibu/target/RandomGrid.h>
+#include <calibu/utils/KdTree.h>
 #include <Eigen/Eigen>
 #include <Eigen/StdVector>
 
@@ -46,6 +51,127 @@ namespace calibu {
 struct Dist { Vertex* v; double dist; };
 inline bool operator<(const Dist& lhs, const Dist& rhs) { return lhs.dist < rhs.dist; }
 
+/// Closest points n1 and n2 of a vertex on opposite sides of it, a
+/// candidate Triple. angle1 and angle2 are their directions from the vertex,
+/// and valid is set if they pass the spacing, collinearity and image checks.
+struct TriplePair { int n1; int n2; double angle1; double angle2; bool valid; };
+typedef InlineVector<TriplePair, VERTEX_MAX_TRIPLES> TriplePairs;
+
+/// Dense map from grid positions, which may be negative, to vertices. The
+/// cell array grows to cover any position that is set and keeps its storage
+/// when cleared, so that matching frame after frame doesn't allocate.
+class VertexGrid
+{
+public:
+    VertexGrid()
+        : origin_(0,0), size_(0,0)
+    {
+        ResetUsed();
+    }
+
+    /// Allocate cells for positions within [-extent, extent].
+    void Reserve(const Eigen::Vector2i& extent)
+    {
+        Cover(-extent);
+        Cover(extent);
+    }
+
+    void Clear()
+    {
+        ForEach([this](const Eigen::Vector2i& g, Vertex*) {
+            cells_[Index(g)] = nullptr;
+        });
+        ResetUsed();
+    }
+
+    /// Vertex at g, or nullptr if there is none.
+    Vertex* Find(const Eigen::Vector2i& g) const
+    {
+        return Contains(g) ? cells_[Index(g)] : nullptr;
+    }
+
+    /// Place v at g, or remove the vertex at g if v is nullptr.
+    void Set(const Eigen::Vector2i& g, Vertex* v)
+    {
+        if(!v) {
+            if(Contains(g)) {
+                cells_[Index(g)] = nullptr;
+            }
+            return;
+        }
+        Cover(g);
+        cells_[Index(g)] = v;
+        used_min_ = used_min_.cwiseMin(g);
+        used_max_ = used_max_.cwiseMax(g);
+    }
+
+    /// Call f(g, v) for each vertex v placed at position g.
+    template<typename F>
+    void ForEach(F f) const
+    {
+        for(int y = used_min_[1]; y <= used_max_[1]; ++y) {
+            for(int x = used_min_[0]; x <= used_max_[0]; ++x) {
+                const Eigen::Vector2i g(x, y);
+                Vertex* v = cells_[Index(g)];
+                if(v) f(g, v);
+            }
+        }
+    }
+
+protected:
+    bool Contains(const Eigen::Vector2i& g) const
+    {
+        return origin_[0] <= g[0] && g[0] < origin_[0] + size_[0] &&
+               origin_[1] <= g[1] && g[1] < origin_[1] + size_[1];
+    }
+
+    size_t Index(const Eigen::Vector2i& g) const
+    {
+        return (size_t)(g[1] - origin_[1]) * size_[0] + (g[0] - origin_[0]);
+    }
+
+    void ResetUsed()
+    {
+        used_min_.setConstant(std::numeric_limits<int>::max());
+        used_max_.setConstant(std::numeric_limits<int>::min());
+    }
+
+    // Grow the cell array to cover g, with some margin so that growing one
+    // position at a time doesn't copy the array every time.
+    void Cover(const Eigen::Vector2i& g)
+    {
+        if(Contains(g)) {
+            return;
+        }
+
+        const int margin = std::max(4, std::max(size_[0], size_[1]) / 2);
+        Eigen::Vector2i lo = g - Eigen::Vector2i::Constant(margin);
+        Eigen::Vector2i hi = g + Eigen::Vector2i::Constant(margin);
+        if(size_[0] > 0) {
+            lo = lo.cwiseMin(origin_);
+            hi = hi.cwiseMax(origin_ + size_ - Eigen::Vector2i::Ones());
+        }
+
+        VertexGrid grown;
+        grown.origin_ = lo;
+        grown.size_ = hi - lo + Eigen::Vector2i::Ones();
+        grown.cells_.assign((size_t)grown.size_[0] * grown.size_[1], nullptr);
+        ForEach([&grown](const Eigen::Vector2i& p, Vertex* v) {
+            grown.cells_[grown.Index(p)] = v;
+        });
+
+        origin_ = grown.origin_;
+        size_ = grown.size_;
+        cells_.swap(grown.cells_);
+    }
+
+    Eigen::Vector2i origin_;
+    Eigen::Vector2i size_;
+    Eigen::Vector2i used_min_;
+    Eigen::Vector2i used_max_;
+    std::vector<Vertex*> cells_;
+};
+
 struct ParamsGridDot
 {
     ParamsGridDot() :
@@ -54,7 +180,10 @@ struct ParamsGridDot
         min_cross_area(1.5),
         max_cross_area(9.0),
         cross_radius_ratio(0.058),
-        cross_line_ratio(0.036)
+        cross_line_ratio(0.036),
+        track_gate_ratio(0.35),
+        track_min_inlier_ratio(0.5),
+        num_threads(1)
     {}
 
     double max_line_dist_ratio;
@@ -63,6 +192,17 @@ struct ParamsGridDot
     double max_cross_area;
     double cross_radius_ratio;
     double cross_line_ratio;
+
+    // Given a pose, FindTarget associates each projected dot with the
+    // nearest conic within track_gate_ratio of the projected dot spacing.
+    // The full search only runs if fewer than track_min_inlier_ratio of the
+    // dots in view are associated.
+    double track_gate_ratio;
+    double track_min_inlier_ratio;
+
+    // Threads finding the candidate triples of the vertices (0 for one per
+    // core)
+    unsigned int num_threads;
 };
 
 
@@ -82,25 +222,48 @@ public:
             const Sophus::SE3d& T_cw,
             const std::shared_ptr<CameraInterface<double>> cam,
             const ImageProcessing& images,
-            const std::vector<Conic, Eigen::aligned_allocator<Conic> >& conics,
+            const ConicSet& conics,
             std::vector<int>& ellipse_target_map
             );
 
     bool FindTarget(
             const std::shared_ptr<CameraInterface<double>> cam,
             const ImageProcessing& images,
-            const std::vector<Conic, Eigen::aligned_allocator<Conic> >& conics,
+            const ConicSet& conics,
             std::vector<int>& ellipse_target_map
             );
 
     bool FindTarget(
             const ImageProcessing& images,
-            const std::vector<Conic, Eigen::aligned_allocator<Conic> >& conics,
+            const ConicSet& conics,
             std::vector<int>& ellipse_target_map
             );
 
+    /// Find several targets, for instance boards printed with different
+    /// seeds, among the same conics. The conic graph is built once, with
+    /// the parameters of this target, and each of its connected components
+    /// is decoded against the patterns of the targets not found yet. Each
+    /// target is found at most once. maps[t] is the ellipse_target_map of
+    /// targets[t], all -1 if it wasn't found. Returns the number found.
+    int FindTargets(
+            const ImageProcessing& images,
+            const ConicSet& conics,
+            const std::vector<const TargetGridDot*>& targets,
+            std::vector<std::vector<int> >& maps
+            );
+
     ////////////////////////////////////////////////////////////////////////////
 
+    inline double GridSpacing() const
+    {
+        return grid_spacing_;
+    }
+
+    inline const Eigen::Vector2i& GridSize() const
+    {
+        return grid_size_;
+    }
+
     inline double CircleRadius() const
     {
         // TODO: Load this from eps or something.
@@ -141,6 +304,10 @@ public:
         return line_groups_;
     }
 
+    ParamsGridDot& Params() {
+        return params_;
+    }
+
     Eigen::MatrixXi GetBinaryPattern( unsigned int idx = 0 ) const
     {
         return PG_[idx];
@@ -165,10 +332,30 @@ public:
     void Init();
     void Clear();
     void SetGrid(Vertex& v, const Eigen::Vector2i& g);
-    bool Match(std::map<Eigen::Vector2i const, Vertex*,
-                std::less<Eigen::Vector2i>,
-                Eigen::aligned_allocator<std::pair<Eigen::Vector2i const, Vertex*> > >& obs,
-                const std::array<Eigen::MatrixXi,4>& PG);
+
+    // Associate conics with the dots of the target seen from T_cw by
+    // camera cam. Returns false if too few are associated.
+    bool TrackTarget(
+            const Sophus::SE3d& T_cw,
+            const std::shared_ptr<CameraInterface<double>> cam,
+            const ConicSet& conics,
+            std::vector<int>& ellipse_target_map
+            );
+
+    // Vertices, closest points and triples of conics, shared by the
+    // searches for each target
+    void BuildGraph(const ImageProcessing& images, const ConicSet& conics);
+
+    // Assign grid positions to the connected vertices, from the first well
+    // connected vertex of central_order outwards, and binary values from
+    // their areas. Returns false if no vertex has two principal directions.
+    bool GrowGrid(const std::vector<Dist>& central_order,
+                  const std::vector<Vertex*>& vertices);
+
+    // Match the values of obs against the pattern PG of a grid_size target,
+    // moving the grid positions of obs into target coordinates on success
+    bool Match(VertexGrid& obs, const PackedPatternGroup& PG,
+               const Eigen::Vector2i& grid_size);
 
     std::vector<Eigen::Vector2d, Eigen::aligned_allocator<Eigen::Vector2d> > tpts2d;
     std::vector<double> tpts2d_radius;
@@ -178,16 +365,38 @@ public:
     double grid_spacing_;
     Eigen::Vector2i grid_size_;
     std::array<Eigen::MatrixXi,4> PG_;
+    PackedPatternGroup PG_packed_;
 
     ParamsGridDot params_;
 
   std::vector<Vertex, Eigen::aligned_allocator<Vertex> > vs_;
-    std::map<Eigen::Vector2i const, Vertex*,
-             std::less<Eigen::Vector2i>,
-             Eigen::aligned_allocator<
-               std::pair<Eigen::Vector2i const, Vertex*> > > map_grid_ellipse_;
+
+    // Index over vs_ for nearest neighbour queries, reused across frames
+    KdTree<3> kdtree_;
+
+    VertexGrid map_grid_ellipse_;
 
     std::list<LineGroup> line_groups_;
+
+    // Per frame search structures, kept so that their storage is reused
+    std::vector<std::vector<Dist> > vs_distance_;
+    std::vector<TriplePairs> vs_pairs_;
+    std::vector<double> vs_central_dist_;
+    std::vector<size_t> vs_central_order_;
+    std::vector<Dist> vs_central_;
+    std::vector<Vertex*> fringe_;
+    std::vector<Vertex*> available_;
+    std::vector<Vertex*> component_;
+    std::vector<Dist> component_central_;
+    std::vector<int> component_parent_;
+    std::vector<int> component_size_;
+
+    // Tracking structures
+    KdTree<2> track_tree_;
+    std::vector<Eigen::Vector2d, Eigen::aligned_allocator<Eigen::Vector2d> > track_predicted_;
+    std::vector<double> track_gate_;
+    std::vector<int> track_dot_;
+    std::vector<double> track_dist_;
 };
 
 }
@@ -0,0 +1,135 @@
+/*
+   This file is part of the Calibu Project.
+   https://github.com/gwu-robotics/Calibu
+
+   Copyright (C) 2013 George Washington University,
+                      Steven Lovegrove,
+                      Nima Keivan
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+   http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <Eigen/Eigen>
+#include <Eigen/StdVector>
+#include <sophus/se3.hpp>
+
+#include <calibu/Platform.h>
+#include <calibu/cam/camera_crtp.h>
+#include <calibu/pcalib/vignetting.h>
+#include <calibu/target/TargetGridDot.h>
+
+namespace calibu {
+
+struct ParamsTargetRenderer
+{
+    ParamsTargetRenderer() :
+        background(230),
+        foreground(30),
+        supersampling(4),
+        blur_sigma(0),
+        noise_sigma(0),
+        seed(71),
+        num_threads(1)
+    {}
+
+    // Intensity of the target background and of its dots
+    double background;
+    double foreground;
+
+    // Samples per pixel along each axis, averaged to anti-alias dot edges
+    int supersampling;
+
+    // Standard deviation in pixels of a gaussian blur, 0 for none
+    double blur_sigma;
+
+    // Standard deviation of additive gaussian noise, 0 for none
+    double noise_sigma;
+    uint32_t seed;
+
+    // Optional attenuation applied to the rendered intensities
+    std::shared_ptr<Vignetting<double> > vignetting;
+
+    // Rows are split into num_threads bands (0 for one per core)
+    unsigned int num_threads;
+};
+
+// Ground truth of one target dot in a rendered image
+struct RenderedDot
+{
+    // Index of the dot in TargetGridDot::Circles3D()
+    int index;
+
+    // Projection of the dot center
+    Eigen::Vector2d center;
+
+    // False if the dot is behind the camera or its center out of the image
+    bool visible;
+};
+
+// Renders synthetic views of a TargetGridDot through any camera model, to
+// benchmark and test detection without recorded data. The target lies on
+// the z = 0 plane of the world frame, as TargetGridDot::Circles3D(), with
+// the background extending infinitely around it.
+class CALIBU_EXPORT TargetRenderer
+{
+public:
+    explicit TargetRenderer( const TargetGridDot& target );
+
+    // Target from a GridDefinitions.h preset, e.g. "small"
+    explicit TargetRenderer( const std::string& preset );
+
+    ParamsTargetRenderer& Params()
+    {
+        return params_;
+    }
+
+    const ParamsTargetRenderer& Params() const
+    {
+        return params_;
+    }
+
+    // Render the target seen by 'cam' from pose T_cw into a row-major 8-bit
+    // image of the camera resolution, with the ground truth of every dot.
+    void Render(
+            const std::shared_ptr<CameraInterface<double> >& cam,
+            const Sophus::SE3d& T_cw,
+            std::vector<unsigned char>& image,
+            std::vector<RenderedDot>& dots
+            ) const;
+
+    // Fraction of each pixel covered by dots, before blur, noise
+    // and vignetting. 'coverage' has the camera resolution.
+    void RenderCoverage(
+            const std::shared_ptr<CameraInterface<double> >& cam,
+            const Sophus::SE3d& T_cw,
+            std::vector<float>& coverage
+            ) const;
+
+protected:
+    // True if point p on the target plane lies within a dot
+    bool InsideDot( const Eigen::Vector2d& p ) const;
+
+    ParamsTargetRenderer params_;
+    double grid_spacing_;
+    Eigen::Vector2i grid_size_;
+    std::vector<Eigen::Vector3d, Eigen::aligned_allocator<Eigen::Vector3d> > centers_;
+    std::vector<double> radii_;
+};
+
+}
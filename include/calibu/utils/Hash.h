@@ -0,0 +1,58 @@
+/*
+   This file is part of the Calibu Project.
+   https://github.com/arpg/Calibu
+
+   Copyright (C) 2013 George Washington University,
+                      Steven Lovegrove,
+                      Gabe Sibley
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+   http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace calibu
+{
+
+/// 64-bit FNV-1a hash, used to key files cached on disk. Values are added
+/// by their bytes, so should be added field by field rather than as structs
+/// that may contain padding.
+class Fnv1aHash
+{
+public:
+    Fnv1aHash() : hash_(14695981039346656037ULL) {}
+
+    void Add( const void* data, size_t size )
+    {
+        const unsigned char* bytes = static_cast<const unsigned char*>( data );
+        for( size_t i = 0; i < size; ++i ) {
+            hash_ = (hash_ ^ bytes[i]) * 1099511628211ULL;
+        }
+    }
+
+    template <typename T>
+    void Add( const T& value )
+    {
+        Add( &value, sizeof(T) );
+    }
+
+    uint64_t Hash() const { return hash_; }
+
+private:
+    uint64_t hash_;
+};
+
+}
@@ -0,0 +1,94 @@
+/*
+   This file is part of the Calibu Project.
+   https://github.com/gwu-robotics/Calibu
+
+   Copyright (C) 2013 George Washington University,
+                      Steven Lovegrove
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+   http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+
+namespace calibu
+{
+
+/// Vector of at most N elements stored inline, for small per element lists
+/// that shouldn't allocate. T must be default constructible; unused slots
+/// hold default constructed values. Elements pushed beyond N are dropped.
+template<typename T, size_t N>
+class InlineVector
+{
+public:
+    typedef T value_type;
+    typedef T* iterator;
+    typedef const T* const_iterator;
+
+    InlineVector() : size_(0) {}
+
+    size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+    bool full() const { return size_ == N; }
+    static size_t capacity() { return N; }
+
+    iterator begin() { return data_; }
+    iterator end() { return data_ + size_; }
+    const_iterator begin() const { return data_; }
+    const_iterator end() const { return data_ + size_; }
+
+    T& operator[](size_t i) { return data_[i]; }
+    const T& operator[](size_t i) const { return data_[i]; }
+    T& front() { return data_[0]; }
+    T& back() { return data_[size_ - 1]; }
+
+    void clear() { size_ = 0; }
+
+    void push_back(const T& value)
+    {
+        assert(size_ < N);
+        if(size_ < N) {
+            data_[size_++] = value;
+        }
+    }
+
+    /// Remove the element at pos, keeping the order of the others.
+    iterator erase(iterator pos)
+    {
+        std::move(pos + 1, end(), pos);
+        --size_;
+        return pos;
+    }
+
+    /// push_back value unless it is already held, for set like use.
+    void insert_unique(const T& value)
+    {
+        if(std::find(begin(), end(), value) == end()) {
+            push_back(value);
+        }
+    }
+
+    bool contains(const T& value) const
+    {
+        return std::find(begin(), end(), value) != end();
+    }
+
+private:
+    T data_[N];
+    size_t size_;
+};
+
+} // namespace calibu
@@ -0,0 +1,160 @@
+/*
+   This file is part of the Calibu Project.
+   https://github.com/gwu-robotics/Calibu
+
+   Copyright (C) 2013 George Washington University,
+                      Steven Lovegrove
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+   http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include <Eigen/Core>
+#include <Eigen/StdVector>
+
+namespace calibu
+{
+
+/// Static k-d tree over D dimensional points for k nearest neighbour
+/// queries. The tree is stored implicitly in one array: the median of each
+/// range is its node, with the lower half to the left and the upper half to
+/// the right. Storage is kept across Build calls, so rebuilding the tree
+/// for every frame doesn't allocate once it has grown.
+template<int D>
+class KdTree
+{
+public:
+    typedef Eigen::Matrix<double,D,1> Point;
+
+    /// (squared distance, index of point) of a query result.
+    typedef std::pair<double,size_t> Neighbour;
+
+    /// Build the tree over n points, where point(i) is the i'th point.
+    template<typename F>
+    void Build(size_t n, F point)
+    {
+        nodes_.resize(n);
+        for(size_t i = 0; i < n; ++i) {
+            nodes_[i].p = point(i);
+            nodes_[i].index = i;
+            nodes_[i].axis = 0;
+        }
+        BuildRange(0, n);
+    }
+
+    size_t Size() const { return nodes_.size(); }
+
+    /// The min(k, Size()) points closest to q, sorted by increasing squared
+    /// distance and then by index.
+    void Knn(const Point& q, size_t k, std::vector<Neighbour>& result) const
+    {
+        result.clear();
+        k = std::min(k, nodes_.size());
+        if(k == 0) {
+            return;
+        }
+        result.reserve(k);
+        // result is a max heap on distance while searching
+        Search(q, k, 0, nodes_.size(), result);
+        std::sort_heap(result.begin(), result.end());
+    }
+
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+protected:
+    struct Node
+    {
+        EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+        Point p;
+        size_t index;
+        int axis;
+    };
+
+    void BuildRange(size_t begin, size_t end)
+    {
+        if(end - begin <= 1) {
+            return;
+        }
+
+        // Split along the axis of largest extent
+        Point lo = nodes_[begin].p;
+        Point hi = lo;
+        for(size_t i = begin + 1; i < end; ++i) {
+            lo = lo.cwiseMin(nodes_[i].p);
+            hi = hi.cwiseMax(nodes_[i].p);
+        }
+        int axis;
+        (hi - lo).maxCoeff(&axis);
+
+        const size_t mid = begin + (end - begin) / 2;
+        std::nth_element(nodes_.begin() + begin, nodes_.begin() + mid,
+                         nodes_.begin() + end,
+                         [axis](const Node& a, const Node& b) {
+                             return a.p[axis] < b.p[axis];
+                         });
+        nodes_[mid].axis = axis;
+        BuildRange(begin, mid);
+        BuildRange(mid + 1, end);
+    }
+
+    void Search(const Point& q, size_t k, size_t begin, size_t end,
+                std::vector<Neighbour>& heap) const
+    {
+        if(begin >= end) {
+            return;
+        }
+
+        const size_t mid = begin + (end - begin) / 2;
+        const Node& node = nodes_[mid];
+        const Neighbour n((q - node.p).squaredNorm(), node.index);
+        if(heap.size() < k) {
+            heap.push_back(n);
+            std::push_heap(heap.begin(), heap.end());
+        }else if(n < heap.front()) {
+            std::pop_heap(heap.begin(), heap.end());
+            heap.back() = n;
+            std::push_heap(heap.begin(), heap.end());
+        }
+
+        if(end - begin == 1) {
+            return;
+        }
+
+        // Descend into the side containing q first, and only search the
+        // other side if it can still hold a closer point.
+        const double d = q[node.axis] - node.p[node.axis];
+        const bool left_first = d < 0;
+        if(left_first) {
+            Search(q, k, begin, mid, heap);
+        }else{
+            Search(q, k, mid + 1, end, heap);
+        }
+        if(heap.size() < k || d * d <= heap.front().first) {
+            if(left_first) {
+                Search(q, k, mid + 1, end, heap);
+            }else{
+                Search(q, k, begin, mid, heap);
+            }
+        }
+    }
+
+    std::vector<Node, Eigen::aligned_allocator<Node> > nodes_;
+};
+
+} // namespace calibu
@@ -0,0 +1,69 @@
+/*
+   This file is part of the Calibu Project.
+   https://github.com/gwu-robotics/Calibu
+
+   Copyright (C) 2013 George Washington University,
+                      Steven Lovegrove
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+   http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+namespace calibu
+{
+
+/// Resolve a requested thread count: 0 means one per hardware thread.
+inline unsigned int NumWorkerThreads(unsigned int num_threads)
+{
+    if(num_threads == 0) {
+        num_threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    return num_threads;
+}
+
+/// Split [0, count) into contiguous bands and call f(begin, end) for each
+/// band on its own thread. The calling thread processes the first band.
+/// With one thread (or one element) f(0, count) runs inline.
+template<typename F>
+void ParallelForBands(int count, unsigned int num_threads, F f)
+{
+    if(count <= 0) {
+        return;
+    }
+
+    const int bands = std::min<int>(NumWorkerThreads(num_threads), count);
+    if(bands == 1) {
+        f(0, count);
+        return;
+    }
+
+    std::vector<std::thread> workers;
+    workers.reserve(bands - 1);
+    for(int b = 1; b < bands; ++b) {
+        const int begin = (int)((long long)count * b / bands);
+        const int end = (int)((long long)count * (b + 1) / bands);
+        workers.emplace_back([&f, begin, end]() { f(begin, end); });
+    }
+    f(0, (int)((long long)count / bands));
+
+    for(std::thread& worker : workers) {
+        worker.join();
+    }
+}
+
+} // namespace calibu
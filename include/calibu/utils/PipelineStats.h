@@ -0,0 +1,171 @@
+/*
+   This file is part of the Calibu Project.
+   https://github.com/gwu-robotics/Calibu
+
+   Copyright (C) 2013 George Washington University,
+                      Steven Lovegrove
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+   http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#pragma once
+
+#include <calibu/Platform.h>
+
+#include <chrono>
+#include <cstdint>
+#include <iosfwd>
+#include <vector>
+
+namespace calibu
+{
+
+/// Timed stages of target detection and calibration.
+enum PipelineStage
+{
+    STAGE_COPY,            // ImageProcessing input copy and pyramid
+    STAGE_GRADIENT,        // ImageProcessing gradient
+    STAGE_THRESHOLD,       // ImageProcessing adaptive threshold
+    STAGE_LABEL,           // ImageProcessing connected components
+    STAGE_CONICS,          // ConicFinder::Find
+    STAGE_FIND_TARGET,     // TargetGridDot::FindTarget
+    STAGE_PNP,             // Pose from target correspondences
+    STAGE_ADD_OBSERVATION, // Calibrator::AddObservation(s)
+    NUM_PIPELINE_STAGES
+};
+
+/// Counted events of target detection.
+enum PipelineCounter
+{
+    COUNTER_CONICS,            // Conics found by ConicFinder
+    COUNTER_TRIPLES,           // Collinear dot triples found by FindTarget
+    COUNTER_RANSAC_ITERATIONS, // PnP RANSAC hypotheses
+    NUM_PIPELINE_COUNTERS
+};
+
+/// Name of a stage or counter, for printing.
+CALIBU_EXPORT const char* PipelineStageName( PipelineStage stage );
+CALIBU_EXPORT const char* PipelineCounterName( PipelineCounter counter );
+
+/// One timed run of a stage.
+struct PipelineSample
+{
+    PipelineStage stage;
+    uint64_t begin_ns; // steady clock time the stage started
+    uint64_t duration_ns;
+};
+
+/// Snapshot of the timings and counters recorded by every thread since the
+/// last ResetPipelineStats(). Only filled in when Calibu is built with
+/// BUILD_PIPELINE_STATS, and empty otherwise.
+struct CALIBU_EXPORT PipelineStats
+{
+    struct Stage
+    {
+        uint64_t count;
+        uint64_t total_ns;
+        uint64_t max_ns;
+
+        double MeanMs() const
+        {
+            return count ? 1e-6 * total_ns / count : 0.0;
+        }
+    };
+
+    PipelineStats();
+
+    /// Print a table of the stages and counters that were recorded.
+    void Print( std::ostream& os ) const;
+
+    Stage stages[NUM_PIPELINE_STAGES];
+    uint64_t counters[NUM_PIPELINE_COUNTERS];
+
+    /// Most recent samples of each thread, oldest first per thread. Each
+    /// thread keeps the last kPipelineRingSize.
+    std::vector<PipelineSample> recent;
+};
+
+/// Samples kept per thread for PipelineStats::recent.
+static const int kPipelineRingSize = 256;
+
+/// Sum of the statistics of all threads. Safe to call while other threads
+/// record; samples being written concurrently may be missed.
+CALIBU_EXPORT PipelineStats GetPipelineStats();
+
+/// Clear the statistics of all threads.
+CALIBU_EXPORT void ResetPipelineStats();
+
+/// Add a timed run of 'stage' to the calling thread's statistics.
+CALIBU_EXPORT void RecordPipelineStage( PipelineStage stage,
+                                        uint64_t begin_ns,
+                                        uint64_t duration_ns );
+
+/// Add 'n' to a counter of the calling thread.
+CALIBU_EXPORT void RecordPipelineCount( PipelineCounter counter, uint64_t n );
+
+/// Records the lifetime of the timer as a run of its stage. Next() ends the
+/// current stage and starts another, to time consecutive stages of a scope.
+class PipelineTimer
+{
+public:
+    explicit PipelineTimer( PipelineStage stage )
+        : stage_(stage), begin_(std::chrono::steady_clock::now())
+    {
+    }
+
+    ~PipelineTimer()
+    {
+        Record( std::chrono::steady_clock::now() );
+    }
+
+    void Next( PipelineStage stage )
+    {
+        const std::chrono::steady_clock::time_point now =
+            std::chrono::steady_clock::now();
+        Record( now );
+        stage_ = stage;
+        begin_ = now;
+    }
+
+    PipelineTimer( const PipelineTimer& ) = delete;
+    PipelineTimer& operator=( const PipelineTimer& ) = delete;
+
+private:
+    void Record( std::chrono::steady_clock::time_point end ) const
+    {
+        RecordPipelineStage(
+            stage_,
+            std::chrono::duration_cast<std::chrono::nanoseconds>(
+                begin_.time_since_epoch()).count(),
+            std::chrono::duration_cast<std::chrono::nanoseconds>(
+                end - begin_).count() );
+    }
+
+    PipelineStage stage_;
+    std::chrono::steady_clock::time_point begin_;
+};
+
+}
+
+/// Instrumentation points, compiled out unless BUILD_PIPELINE_STATS is set.
+/// CALIBU_PIPELINE_TIMER declares timer 'name', timing the rest of the
+/// enclosing scope, and CALIBU_PIPELINE_NEXT moves it on to another stage.
+#ifdef CALIBU_PIPELINE_STATS
+#  define CALIBU_PIPELINE_TIMER(name, stage) calibu::PipelineTimer name(stage)
+#  define CALIBU_PIPELINE_NEXT(name, stage) name.Next(stage)
+#  define CALIBU_PIPELINE_COUNT(counter, n) calibu::RecordPipelineCount(counter, n)
+#else
+#  define CALIBU_PIPELINE_TIMER(name, stage) ((void)0)
+#  define CALIBU_PIPELINE_NEXT(name, stage) ((void)0)
+#  define CALIBU_PIPELINE_COUNT(counter, n) ((void)0)
+#endif
@@ -21,6 +21,7 @@
 #pragma once
 
 #include <calibu/Platform.h>
+#include <calibu/pose/Ransac.h>
 
 #include <vector>
 #include <Eigen/Dense>
@@ -40,12 +41,44 @@ bool is_finite(const Eigen::MatrixBase<Derived>& x)
     return !is_nan( (x.array() - x.array()).matrix() );
 }
 
+// Homography H_ba with b = H_ba a, fit to n >= 4 point pairs by the
+// normalised DLT. Each point set is conditioned separately, so a and b
+// may be in different units, e.g. target and image coordinates.
+CALIBU_EXPORT
+Eigen::Matrix3d EstimateH_ba(
+        const Eigen::Vector2d* a, const Eigen::Vector2d* b, size_t n
+        );
+
 CALIBU_EXPORT
 Eigen::Matrix3d EstimateH_ba(
         const std::vector<Eigen::Vector2d, Eigen::aligned_allocator<Eigen::Vector2d> >& a,
         const std::vector<Eigen::Vector2d, Eigen::aligned_allocator<Eigen::Vector2d> >& b
         );
 
+// EstimateH_ba of each pair of point sets a[i], b[i], e.g. of every frame
+// of a sequence, on num_threads threads (0 for one per core).
+CALIBU_EXPORT
+std::vector<Eigen::Matrix3d> EstimateH_baBatch(
+        const std::vector<std::vector<Eigen::Vector2d, Eigen::aligned_allocator<Eigen::Vector2d> > >& a,
+        const std::vector<std::vector<Eigen::Vector2d, Eigen::aligned_allocator<Eigen::Vector2d> > >& b,
+        unsigned int num_threads = 1
+        );
+
+// EstimateH_ba robust to outliers, fit by RANSAC to the largest set of
+// pairs with a transfer error |b - H_ba a| below max_error. inliers
+// receives that set, and is empty (with H_ba zero) if it is smaller than
+// min_consensus_size.
+CALIBU_EXPORT
+Eigen::Matrix3d EstimateH_baRansac(
+        const std::vector<Eigen::Vector2d, Eigen::aligned_allocator<Eigen::Vector2d> >& a,
+        const std::vector<Eigen::Vector2d, Eigen::aligned_allocator<Eigen::Vector2d> >& b,
+        std::vector<int>& inliers,
+        double max_error,
+        int iterations = 500,
+        unsigned int min_consensus_size = 4,
+        const ParamsRansac& params = ParamsRansac()
+        );
+
 inline Eigen::Matrix3d SkewSym( const Eigen::Vector3d& A)
 {
     Eigen::Matrix3d R;
@@ -1,10 +1,56 @@
+#include <algorithm>
+#include <map>
+#include <vector>
+
 #include "mex.h"
 #include "class_handle.hpp"
 #include "calibu/cam/camera_crtp.h"
 #include "calibu/cam/camera_xml.h"
+#include "calibu/cam/rectify_crtp.h"
+#include "calibu/utils/Parallel.h"
 
 std::shared_ptr<calibu::Rig<double>> calibu_wrap;
 
+// Lookup tables used by "rectify", per camera, built on first use.
+std::map<const calibu::CameraInterface<double>*, calibu::LookupTable> lut_cache;
+
+// Batches are split across threads once each thread gets at least this many
+// points, below which starting threads costs more than it saves.
+const size_t kMinPointsPerThread = 16384;
+
+unsigned int BatchThreads(size_t num_points)
+{
+  return std::max<size_t>(1, std::min<size_t>(calibu::NumWorkerThreads(0),
+                                              num_points / kMinPointsPerThread));
+}
+
+// Rectify each channel of the column major h x w x c image 'in' into 'out'.
+// The table is row major, so each plane is transposed around Rectify.
+template <typename scalar>
+void RectifyImage(const calibu::LookupTable& lut, const mxArray* in,
+                  mxArray* out, size_t w, size_t h, size_t channels)
+{
+  const scalar* in_ptr = static_cast<const scalar*>(mxGetData(in));
+  scalar* out_ptr = static_cast<scalar*>(mxGetData(out));
+  std::vector<scalar> in_rows(w * h), out_rows(w * h);
+
+  for (size_t c = 0; c < channels; ++c) {
+    const scalar* in_plane = in_ptr + c * w * h;
+    scalar* out_plane = out_ptr + c * w * h;
+    for (size_t x = 0; x < w; ++x) {
+      for (size_t y = 0; y < h; ++y) {
+        in_rows[y * w + x] = in_plane[x * h + y];
+      }
+    }
+    calibu::Rectify(lut, in_rows.data(), out_rows.data(), w, h, 1, 0);
+    for (size_t x = 0; x < w; ++x) {
+      for (size_t y = 0; y < h; ++y) {
+        out_plane[x * h + y] = out_rows[y * w + x];
+      }
+    }
+  }
+}
+
 void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
 {
   // Command string.
@@ -46,7 +92,11 @@ void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
 
   /// Delete pointer.
   if (!strcmp("delete", cmd)) {
-    // Destroy the C++ object.
+    // Drop tables of its cameras before destroying the C++ object.
+    calibu::Rig<double>* rig = convertMat2Ptr<calibu::Rig<double>>(prhs[1]);
+    for (const std::shared_ptr<calibu::CameraInterface<double>>& cam : rig->cameras_) {
+      lut_cache.erase(cam.get());
+    }
     destroyObject<calibu::Rig<double>>(prhs[1]);
 
     // Warn if other commands were ignored.
@@ -178,6 +228,126 @@ void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
 
 
 
+  /// Project N x 3 points to N x 2 pixels, one point per row.
+  if (!strcmp("project_n", cmd)) {
+    unsigned int camera_id = static_cast<unsigned int>(*mxGetPr(prhs[2]));
+
+    if (camera_id == 0 || camera_id > calibu_cam_ptr->cameras_.size()) {
+      mexErrMsgTxt("Camera ID is out of bounds.");
+      return;
+    }
+    if (nrhs != 4 || !mxIsDouble(prhs[3]) || mxGetN(prhs[3]) != 3) {
+      mexErrMsgTxt("Project N: N x 3 double matrix of points expected.");
+      return;
+    }
+
+    // Column major, so the columns are already separate x, y, z arrays.
+    const size_t num_pts = mxGetM(prhs[3]);
+    const double* points_ptr = mxGetPr(prhs[3]);
+    plhs[0] = mxCreateDoubleMatrix(num_pts, 2, mxREAL);
+    double* pixels_ptr = mxGetPr(plhs[0]);
+
+    const calibu::CameraInterface<double>& cam =
+        *calibu_cam_ptr->cameras_[camera_id-1];
+    calibu::ParallelForBands(num_pts, BatchThreads(num_pts),
+                             [&](int begin, int end) {
+      cam.ProjectN(points_ptr + begin, points_ptr + num_pts + begin,
+                   points_ptr + 2*num_pts + begin,
+                   pixels_ptr + begin, pixels_ptr + num_pts + begin,
+                   end - begin);
+    });
+
+    return;
+  }
+
+
+  /// Unproject N x 2 pixels to N x 3 rays, one pixel per row.
+  if (!strcmp("unproject_n", cmd)) {
+    unsigned int camera_id = static_cast<unsigned int>(*mxGetPr(prhs[2]));
+
+    if (camera_id == 0 || camera_id > calibu_cam_ptr->cameras_.size()) {
+      mexErrMsgTxt("Camera ID is out of bounds.");
+      return;
+    }
+    if (nrhs != 4 || !mxIsDouble(prhs[3]) || mxGetN(prhs[3]) != 2) {
+      mexErrMsgTxt("Unproject N: N x 2 double matrix of pixels expected.");
+      return;
+    }
+
+    const size_t num_pixels = mxGetM(prhs[3]);
+    const double* pixels_ptr = mxGetPr(prhs[3]);
+    plhs[0] = mxCreateDoubleMatrix(num_pixels, 3, mxREAL);
+    double* rays_ptr = mxGetPr(plhs[0]);
+
+    const calibu::CameraInterface<double>& cam =
+        *calibu_cam_ptr->cameras_[camera_id-1];
+    calibu::ParallelForBands(num_pixels, BatchThreads(num_pixels),
+                             [&](int begin, int end) {
+      cam.UnprojectN(pixels_ptr + begin, pixels_ptr + num_pixels + begin,
+                     rays_ptr + begin, rays_ptr + num_pixels + begin,
+                     rays_ptr + 2*num_pixels + begin,
+                     end - begin);
+    });
+
+    return;
+  }
+
+
+  /// Rectify an h x w (x c) image to the linear camera of the same K.
+  if (!strcmp("rectify", cmd)) {
+    unsigned int camera_id = static_cast<unsigned int>(*mxGetPr(prhs[2]));
+
+    if (camera_id == 0 || camera_id > calibu_cam_ptr->cameras_.size()) {
+      mexErrMsgTxt("Camera ID is out of bounds.");
+      return;
+    }
+    if (nrhs != 4) {
+      mexErrMsgTxt("Rectify: Image expected as fourth argument.");
+      return;
+    }
+
+    const std::shared_ptr<calibu::CameraInterface<double>>& cam =
+        calibu_cam_ptr->cameras_[camera_id-1];
+    const mxArray* image = prhs[3];
+    const mwSize num_dims = mxGetNumberOfDimensions(image);
+    const mwSize* dims = mxGetDimensions(image);
+    const size_t h = dims[0];
+    const size_t w = dims[1];
+    const size_t channels = num_dims > 2 ? dims[2] : 1;
+    if (num_dims > 3 || (int)w != cam->Width() || (int)h != cam->Height()) {
+      mexErrMsgTxt("Rectify: Image must be height x width (x channels) of the camera.");
+      return;
+    }
+
+    // An empty table is sized to the camera.
+    calibu::LookupTable& lut = lut_cache[cam.get()];
+    if (lut.Height() == 0) {
+      calibu::CreateLookupTable(cam, lut, 0, 0, 0);
+    }
+
+    plhs[0] = mxCreateNumericArray(num_dims, dims, mxGetClassID(image), mxREAL);
+    switch (mxGetClassID(image)) {
+      case mxUINT8_CLASS:
+        RectifyImage<unsigned char>(lut, image, plhs[0], w, h, channels);
+        break;
+      case mxUINT16_CLASS:
+        RectifyImage<unsigned short>(lut, image, plhs[0], w, h, channels);
+        break;
+      case mxSINGLE_CLASS:
+        RectifyImage<float>(lut, image, plhs[0], w, h, channels);
+        break;
+      case mxDOUBLE_CLASS:
+        RectifyImage<double>(lut, image, plhs[0], w, h, channels);
+        break;
+      default:
+        mexErrMsgTxt("Rectify: Image must be uint8, uint16, single or double.");
+        break;
+    }
+
+    return;
+  }
+
+
   /// Transfer 3d.
   if (!strcmp("transfer_3d", cmd)) {
     unsigned int camera_id = static_cast<unsigned int>(*mxGetPr(prhs[2]));
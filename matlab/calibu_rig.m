@@ -45,6 +45,24 @@ classdef calibu_rig
                        camera_id, length(pixels), pixels);
         end
         
+        %%% Project N x 3 points, one per row, to N x 2 pixels.
+        function [pixels] = project_n(obj, camera_id, points)
+            pixels = calibu_mex('project_n', obj.cpp_calibu_rig_ptr_, ...
+                       camera_id, points);
+        end
+
+        %%% Unproject N x 2 pixels, one per row, to N x 3 rays.
+        function [rays] = unproject_n(obj, camera_id, pixels)
+            rays = calibu_mex('unproject_n', obj.cpp_calibu_rig_ptr_, ...
+                       camera_id, pixels);
+        end
+
+        %%% Rectify an image (height x width x channels) to a linear camera.
+        function [rectified] = rectify(obj, camera_id, image)
+            rectified = calibu_mex('rectify', obj.cpp_calibu_rig_ptr_, ...
+                       camera_id, image);
+        end
+        
         %%% Transfer3d.
         function [pixel_coordinate] = transfer_3d(obj, camera_id, Tab, ray, rho)
             pixel_coordinate = calibu_mex('transfer_3d', ...
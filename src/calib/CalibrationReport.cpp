@@ -0,0 +1,317 @@
+/*
+   This file is part of the Calibu Project.
+   https://github.com/arpg/Calibu
+
+   Copyright (C) 2013 George Washington University,
+                      Steven Lovegrove,
+                      Gabe Sibley
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+   http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+#include <calibu/calib/CalibrationReport.h>
+#include <calibu/utils/Parallel.h>
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <stdexcept>
+
+namespace calibu
+{
+
+namespace
+{
+
+// Observations moved into a camera's frame and projected at a time.
+const size_t kReportBatch = 256;
+
+// Residuals of one camera's observations, in the order they were given,
+// and the cell each was observed in, or -1 if it couldn't be projected.
+struct CameraResiduals
+{
+    std::vector<float> du;
+    std::vector<float> dv;
+    std::vector<int32_t> cell;
+};
+
+// Cell of the grid over a w x h image holding pixel p, or the nearest one
+// for pixels outside of the image.
+int32_t GridCell(const Eigen::Vector2d& p, int w, int h, int cols, int rows)
+{
+    const double col = std::min(std::max(p[0] * cols / w, 0.0), cols - 1.0);
+    const double row = std::min(std::max(p[1] * rows / h, 0.0), rows - 1.0);
+    return (int32_t)row * cols + (int32_t)col;
+}
+
+// Project the observations of 'obs' and write their residuals from 'first'.
+void ProjectObservations(
+        const CameraSnapshot<double>& camera,
+        const Sophus::SE3d& T_cw,
+        const ReportObservations& obs,
+        const ParamsCalibrationReport& params,
+        CameraResiduals& residuals,
+        size_t first)
+{
+    const CameraInterface<double>& cam = camera.Camera();
+    const int w = cam.Width();
+    const int h = cam.Height();
+    const Eigen::Matrix3d R = T_cw.rotationMatrix();
+    const Eigen::Vector3d t = T_cw.translation();
+
+    double x[kReportBatch], y[kReportBatch], z[kReportBatch];
+    double u[kReportBatch], v[kReportBatch];
+    for(size_t begin = 0; begin < obs.size; begin += kReportBatch) {
+        const size_t n = std::min(kReportBatch, obs.size - begin);
+        for(size_t i = 0; i < n; ++i) {
+            const Eigen::Vector3d P_c = R * obs.P_w[begin + i] + t;
+            x[i] = P_c[0];
+            y[i] = P_c[1];
+            z[i] = P_c[2];
+        }
+        camera.ProjectN(x, y, z, u, v, n);
+
+        for(size_t i = 0; i < n; ++i) {
+            const Eigen::Vector2d& p_c = obs.p_c[begin + i];
+            const size_t r = first + begin + i;
+            residuals.du[r] = u[i] - p_c[0];
+            residuals.dv[r] = v[i] - p_c[1];
+            const bool valid = z[i] > 0 && std::isfinite(u[i]) &&
+                    std::isfinite(v[i]) && p_c.allFinite();
+            residuals.cell[r] = valid ?
+                        GridCell(p_c, w, h, params.grid_cols, params.grid_rows) : -1;
+        }
+    }
+}
+
+// The q quantile of 'values', which are reordered.
+double Quantile(std::vector<float>& values, double q)
+{
+    if(values.empty()) {
+        return 0;
+    }
+    std::vector<float>::iterator nth =
+            values.begin() + (size_t)(q * (values.size() - 1));
+    std::nth_element(values.begin(), nth, values.end());
+    return *nth;
+}
+
+// Fill 'report' in from the residuals of its camera.
+void SummariseCamera(const CameraResiduals& residuals, CameraReport& report)
+{
+    const size_t num_cells = report.grid_cols * report.grid_rows;
+    std::vector<double> sum_sq(num_cells, 0.0);
+    std::vector<double> sum_u(num_cells, 0.0);
+    std::vector<double> sum_v(num_cells, 0.0);
+    report.cell_count.assign(num_cells, 0);
+
+    std::vector<float> norms;
+    norms.reserve(residuals.cell.size());
+    double total_sq = 0;
+    double total_norm = 0;
+    Eigen::Vector2d total_bias = Eigen::Vector2d::Zero();
+    for(size_t r = 0; r < residuals.cell.size(); ++r) {
+        const int32_t cell = residuals.cell[r];
+        if(cell < 0) {
+            ++report.num_failed;
+            continue;
+        }
+        const double du = residuals.du[r];
+        const double dv = residuals.dv[r];
+        const double sq = du * du + dv * dv;
+        const double norm = std::sqrt(sq);
+        ++report.cell_count[cell];
+        sum_sq[cell] += sq;
+        sum_u[cell] += du;
+        sum_v[cell] += dv;
+        total_sq += sq;
+        total_norm += norm;
+        total_bias += Eigen::Vector2d(du, dv);
+        report.max = std::max(report.max, norm);
+        norms.push_back((float)norm);
+    }
+
+    const size_t n = norms.size();
+    if(n > 0) {
+        report.rms = std::sqrt(total_sq / n);
+        report.mean = total_norm / n;
+        report.bias = total_bias / n;
+    }
+    report.median = Quantile(norms, 0.5);
+    report.p90 = Quantile(norms, 0.9);
+
+    report.cell_rms.assign(num_cells, 0.0f);
+    report.cell_bias_u.assign(num_cells, 0.0f);
+    report.cell_bias_v.assign(num_cells, 0.0f);
+    size_t covered = 0;
+    for(size_t c = 0; c < num_cells; ++c) {
+        const uint32_t count = report.cell_count[c];
+        if(count > 0) {
+            report.cell_rms[c] = (float)std::sqrt(sum_sq[c] / count);
+            report.cell_bias_u[c] = (float)(sum_u[c] / count);
+            report.cell_bias_v[c] = (float)(sum_v[c] / count);
+            ++covered;
+        }
+    }
+    report.coverage = num_cells ? (double)covered / num_cells : 0.0;
+}
+
+template<typename T>
+void WriteJsonArray(std::ostream& os, const std::vector<T>& values)
+{
+    os << "[";
+    for(size_t i = 0; i < values.size(); ++i) {
+        os << (i ? "," : "") << values[i];
+    }
+    os << "]";
+}
+
+// 'str' as a JSON string literal.
+std::string JsonString(const std::string& str)
+{
+    std::string quoted = "\"";
+    for(char c : str) {
+        if(c == '"' || c == '\\') {
+            quoted += '\\';
+        }
+        quoted += c;
+    }
+    return quoted + "\"";
+}
+
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void ComputeCalibrationReport(
+        const std::vector<std::shared_ptr<const CameraSnapshot<double> > >& cameras,
+        const std::vector<Sophus::SE3d, Eigen::aligned_allocator<Sophus::SE3d> >& T_ck,
+        const std::vector<Sophus::SE3d, Eigen::aligned_allocator<Sophus::SE3d> >& T_kw,
+        const std::vector<ReportObservations>& observations,
+        CalibrationReport& report,
+        const ParamsCalibrationReport& params
+        )
+{
+    if(T_ck.size() != cameras.size()) {
+        throw std::runtime_error("Bad camera extrinsics.");
+    }
+
+    // Place of each group of observations within its camera's residuals
+    std::vector<size_t> first(observations.size());
+    std::vector<size_t> num_observations(cameras.size(), 0);
+    for(size_t o = 0; o < observations.size(); ++o) {
+        const ReportObservations& obs = observations[o];
+        if(obs.camera >= cameras.size()) {
+            throw std::runtime_error("Bad camera index.");
+        }
+        if(obs.frame >= T_kw.size()) {
+            throw std::runtime_error("Bad frame index.");
+        }
+        first[o] = num_observations[obs.camera];
+        num_observations[obs.camera] += obs.size;
+    }
+
+    std::vector<CameraResiduals> residuals(cameras.size());
+    for(size_t c = 0; c < cameras.size(); ++c) {
+        residuals[c].du.resize(num_observations[c]);
+        residuals[c].dv.resize(num_observations[c]);
+        residuals[c].cell.resize(num_observations[c]);
+    }
+
+    ParallelForBands((int)observations.size(), params.num_threads,
+                     [&](int begin, int end) {
+        for(int o = begin; o < end; ++o) {
+            const ReportObservations& obs = observations[o];
+            ProjectObservations(*cameras[obs.camera],
+                                T_ck[obs.camera] * T_kw[obs.frame], obs,
+                                params, residuals[obs.camera], first[o]);
+        }
+    });
+
+    report = CalibrationReport();
+    report.cameras.resize(cameras.size());
+    ParallelForBands((int)cameras.size(), params.num_threads,
+                     [&](int begin, int end) {
+        for(int c = begin; c < end; ++c) {
+            const CameraInterface<double>& cam = cameras[c]->Camera();
+            CameraReport& camera_report = report.cameras[c];
+            camera_report.type = cam.Type();
+            camera_report.width = cam.Width();
+            camera_report.height = cam.Height();
+            camera_report.num_observations = num_observations[c];
+            camera_report.grid_cols = params.grid_cols;
+            camera_report.grid_rows = params.grid_rows;
+            SummariseCamera(residuals[c], camera_report);
+        }
+    });
+
+    double total_sq = 0;
+    for(const CameraReport& camera_report : report.cameras) {
+        const size_t valid = camera_report.num_observations - camera_report.num_failed;
+        total_sq += camera_report.rms * camera_report.rms * valid;
+        report.num_observations += camera_report.num_observations;
+        report.num_failed += camera_report.num_failed;
+    }
+    const size_t valid = report.num_observations - report.num_failed;
+    report.rms = valid ? std::sqrt(total_sq / valid) : 0.0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void CalibrationReport::WriteJson(std::ostream& os) const
+{
+    os << "{\n";
+    os << "  \"num_observations\": " << num_observations << ",\n";
+    os << "  \"num_failed\": " << num_failed << ",\n";
+    os << "  \"rms\": " << rms << ",\n";
+    os << "  \"cameras\": [";
+    for(size_t c = 0; c < cameras.size(); ++c) {
+        const CameraReport& cam = cameras[c];
+        os << (c ? "," : "") << "\n    {\n";
+        os << "      \"type\": " << JsonString(cam.type) << ",\n";
+        os << "      \"width\": " << cam.width << ",\n";
+        os << "      \"height\": " << cam.height << ",\n";
+        os << "      \"num_observations\": " << cam.num_observations << ",\n";
+        os << "      \"num_failed\": " << cam.num_failed << ",\n";
+        os << "      \"rms\": " << cam.rms << ",\n";
+        os << "      \"mean\": " << cam.mean << ",\n";
+        os << "      \"median\": " << cam.median << ",\n";
+        os << "      \"p90\": " << cam.p90 << ",\n";
+        os << "      \"max\": " << cam.max << ",\n";
+        os << "      \"bias\": [" << cam.bias[0] << "," << cam.bias[1] << "],\n";
+        os << "      \"coverage\": " << cam.coverage << ",\n";
+        os << "      \"grid\": {\n";
+        os << "        \"cols\": " << cam.grid_cols << ",\n";
+        os << "        \"rows\": " << cam.grid_rows << ",\n";
+        os << "        \"count\": ";
+        WriteJsonArray(os, cam.cell_count);
+        os << ",\n        \"rms\": ";
+        WriteJsonArray(os, cam.cell_rms);
+        os << ",\n        \"bias_u\": ";
+        WriteJsonArray(os, cam.cell_bias_u);
+        os << ",\n        \"bias_v\": ";
+        WriteJsonArray(os, cam.cell_bias_v);
+        os << "\n      }\n    }";
+    }
+    os << "\n  ]\n}\n";
+}
+
+///////////////////////////////////////////////////////////////////////////////
+bool CalibrationReport::SaveJson(const std::string& filename) const
+{
+    std::ofstream file(filename.c_str());
+    if(!file) {
+        return false;
+    }
+    WriteJson(file);
+    return (bool)file;
+}
+
+}
@@ -0,0 +1,297 @@
+/*
+   This file is part of the Calibu Project.
+   https://github.com/arpg/Calibu
+
+   Copyright (C) 2013 George Washington University,
+                      Steven Lovegrove,
+                      Gabe Sibley
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+   http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#include <calibu/cam/camera_binary.h>
+#include <calibu/cam/camera_models_crtp.h>
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <vector>
+
+#ifdef _WIN_
+#  include <process.h>
+#  define getpid _getpid
+#else
+#  include <fcntl.h>
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#  include <unistd.h>
+#endif
+
+namespace calibu
+{
+
+  static_assert( sizeof(RigFileHeader) == 64,
+                 "RigFileHeader must stay 64 bytes" );
+  static_assert( sizeof(RigFileCamera) == 512,
+                 "RigFileCamera must stay 512 bytes" );
+
+  static const char kRigFileMagic[8] = { 'C','A','L','I','B','U','R','G' };
+
+  namespace
+  {
+    // Copy 'str' into 'dst', failing if it doesn't fit with its nul.
+    template <size_t N>
+    bool CopyString( const std::string& str, char (&dst)[N] )
+    {
+      if( str.size() >= N ) {
+        return false;
+      }
+      memcpy( dst, str.c_str(), str.size() + 1 );
+      return true;
+    }
+
+    template <size_t N>
+    std::string ReadString( const char (&src)[N] )
+    {
+      return std::string( src, strnlen( src, N ) );
+    }
+
+    bool FillRecord( const CameraInterface<double>& cam, RigFileCamera& rec )
+    {
+      // Only write what ReadBinaryRig can read back
+      const std::shared_ptr<CameraInterface<double>> model =
+          CreateCameraModel( cam.Type() );
+      if( !model || model->NumParams() != cam.NumParams() ) {
+        return false;
+      }
+
+      memset( &rec, 0, sizeof(rec) );
+      if( !CopyString( cam.Type(), rec.type ) ||
+          !CopyString( cam.Name(), rec.name ) ||
+          cam.NumParams() > (uint32_t) kRigFileMaxParams ) {
+        return false;
+      }
+      rec.serial_no = cam.SerialNumber();
+      rec.version = cam.Version();
+      rec.index = cam.Index();
+      rec.width = cam.Width();
+      rec.height = cam.Height();
+      rec.num_params = cam.NumParams();
+      memcpy( rec.params, cam.GetParams().data(),
+              rec.num_params * sizeof(double) );
+
+      const Sophus::SE3d t_rc = cam.Pose();
+      const Eigen::Quaterniond& q = t_rc.unit_quaternion();
+      rec.t_rc[0] = q.x();
+      rec.t_rc[1] = q.y();
+      rec.t_rc[2] = q.z();
+      rec.t_rc[3] = q.w();
+      memcpy( rec.t_rc + 4, t_rc.translation().data(), 3 * sizeof(double) );
+
+      const Eigen::Matrix3d rdf = cam.RDF();
+      memcpy( rec.rdf, rdf.data(), sizeof(rec.rdf) );
+      return true;
+    }
+  }
+
+  ///////////////////////////////////////////////////////////////////////////////
+  bool WriteBinaryRig(
+      const std::string& filename,
+      const std::shared_ptr<Rig<double>>& rig
+      )
+  {
+    RigFileHeader header;
+    memset( &header, 0, sizeof(header) );
+    memcpy( header.magic, kRigFileMagic, sizeof(header.magic) );
+    header.version = kRigFileVersion;
+    header.camera_size = sizeof(RigFileCamera);
+    header.num_cameras = rig->NumCams();
+
+    std::vector<RigFileCamera> records( rig->NumCams() );
+    for( size_t c = 0; c < rig->NumCams(); ++c ) {
+      if( !FillRecord( *rig->cameras_[c], records[c] ) ) {
+        std::cerr << "Unable to store camera " << c << " of type '"
+                  << rig->cameras_[c]->Type() << "' in a rig file"
+                  << std::endl;
+        return false;
+      }
+    }
+
+    std::ostringstream tmp_name;
+    tmp_name << filename << ".tmp." << getpid();
+    const std::string tmp_filename = tmp_name.str();
+    {
+      std::ofstream file( tmp_filename, std::ios::binary | std::ios::trunc );
+      if( !file ) {
+        std::cerr << "Unable to write rig '" << tmp_filename << "'"
+                  << std::endl;
+        return false;
+      }
+      file.write( reinterpret_cast<const char*>( &header ), sizeof(header) );
+      file.write( reinterpret_cast<const char*>( records.data() ),
+                  records.size() * sizeof(RigFileCamera) );
+      if( !file ) {
+        file.close();
+        std::remove( tmp_filename.c_str() );
+        return false;
+      }
+    }
+
+    if( std::rename( tmp_filename.c_str(), filename.c_str() ) != 0 ) {
+      std::remove( tmp_filename.c_str() );
+      return false;
+    }
+    return true;
+  }
+
+  ///////////////////////////////////////////////////////////////////////////////
+  std::shared_ptr<Rig<double>> ReadBinaryRig( const std::string& filename )
+  {
+    MappedRig mapped;
+    if( !mapped.Open( filename ) ) {
+      return nullptr;
+    }
+    return mapped.ToRig();
+  }
+
+  ///////////////////////////////////////////////////////////////////////////////
+  MappedRig::MappedRig()
+    : header_(nullptr), cameras_(nullptr), mapping_(nullptr), mapping_size_(0)
+  {
+  }
+
+  ///////////////////////////////////////////////////////////////////////////////
+  MappedRig::~MappedRig()
+  {
+    Close();
+  }
+
+  ///////////////////////////////////////////////////////////////////////////////
+  bool MappedRig::Open( const std::string& filename )
+  {
+    Close();
+
+#ifdef _WIN_
+    // No shared mapping here: read the file into private memory instead.
+    std::ifstream file( filename, std::ios::binary | std::ios::ate );
+    if( !file ) {
+      return false;
+    }
+    const size_t size = file.tellg();
+    if( size < sizeof(RigFileHeader) ) {
+      return false;
+    }
+    char* data = new char[size];
+    file.seekg( 0 );
+    if( !file.read( data, size ) ) {
+      delete[] data;
+      return false;
+    }
+    mapping_ = data;
+    mapping_size_ = size;
+#else
+    const int fd = open( filename.c_str(), O_RDONLY );
+    if( fd < 0 ) {
+      return false;
+    }
+    struct stat st;
+    if( fstat( fd, &st ) != 0 ||
+        (size_t) st.st_size < sizeof(RigFileHeader) ) {
+      close( fd );
+      return false;
+    }
+    void* data = mmap( nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0 );
+    close( fd );
+    if( data == MAP_FAILED ) {
+      return false;
+    }
+    mapping_ = data;
+    mapping_size_ = st.st_size;
+#endif
+
+    const RigFileHeader* header = static_cast<const RigFileHeader*>( mapping_ );
+    const size_t expected_size = sizeof(RigFileHeader) +
+        (size_t) header->num_cameras * sizeof(RigFileCamera);
+
+    if( memcmp( header->magic, kRigFileMagic, sizeof(header->magic) ) ||
+        header->version != kRigFileVersion ||
+        header->camera_size != sizeof(RigFileCamera) ||
+        mapping_size_ != expected_size ) {
+      Close();
+      return false;
+    }
+
+    header_ = header;
+    cameras_ = reinterpret_cast<const RigFileCamera*>( header + 1 );
+    return true;
+  }
+
+  ///////////////////////////////////////////////////////////////////////////////
+  void MappedRig::Close()
+  {
+    if( mapping_ ) {
+#ifdef _WIN_
+      delete[] static_cast<char*>( mapping_ );
+#else
+      munmap( mapping_, mapping_size_ );
+#endif
+    }
+    header_ = nullptr;
+    cameras_ = nullptr;
+    mapping_ = nullptr;
+    mapping_size_ = 0;
+  }
+
+  ///////////////////////////////////////////////////////////////////////////////
+  std::shared_ptr<CameraInterface<double>> MappedRig::Camera(
+      unsigned int i ) const
+  {
+    const RigFileCamera& rec = cameras_[i];
+    const std::string type = ReadString( rec.type );
+    std::shared_ptr<CameraInterface<double>> cam = CreateCameraModel( type );
+    if( !cam || rec.num_params != cam->NumParams() ) {
+      return nullptr;
+    }
+
+    cam->SetParams( Eigen::Map<const Eigen::VectorXd>( rec.params,
+                                                       rec.num_params ) );
+    cam->SetImageDimensions( rec.width, rec.height );
+    cam->SetRDF( Eigen::Map<const Eigen::Matrix3d>( rec.rdf ) );
+    cam->SetPose( Sophus::SE3d(
+        Eigen::Quaterniond( rec.t_rc[3], rec.t_rc[0], rec.t_rc[1], rec.t_rc[2] ),
+        Eigen::Map<const Eigen::Vector3d>( rec.t_rc + 4 ) ) );
+    cam->SetVersion( rec.version );
+    cam->SetIndex( rec.index );
+    cam->SetSerialNumber( rec.serial_no );
+    cam->SetName( ReadString( rec.name ) );
+    cam->SetType( type );
+    return cam;
+  }
+
+  ///////////////////////////////////////////////////////////////////////////////
+  std::shared_ptr<Rig<double>> MappedRig::ToRig() const
+  {
+    std::shared_ptr<Rig<double>> rig( new Rig<double>() );
+    for( unsigned int i = 0; i < NumCams(); ++i ) {
+      std::shared_ptr<CameraInterface<double>> cam = Camera( i );
+      if( !cam ) {
+        return nullptr;
+      }
+      rig->AddCamera( cam );
+    }
+    return rig;
+  }
+
+}
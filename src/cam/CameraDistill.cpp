@@ -0,0 +1,287 @@
+/*
+   This file is part of the Calibu Project.
+   https://github.com/arpg/Calibu
+
+   Copyright (C) 2013 George Washington University,
+                      Steven Lovegrove,
+                      Gabe Sibley
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+   http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+#include <calibu/cam/camera_distill.h>
+#include <calibu/cam/camera_models_crtp.h>
+#include <calibu/utils/Parallel.h>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+namespace calibu
+{
+
+namespace
+{
+
+// Samples whose normal equations are summed together. Blocks are summed in
+// order, so the fit is the same for any number of threads.
+const int kDistillBlock = 1024;
+
+// Initial w of FOV fits. Its Factor is even in w, so the fit can't move
+// away from w = 0.
+const double kInitialFovW = 0.5;
+
+// Pixels of the sample grid and the rays of the source through them.
+struct DistillSamples
+{
+    std::vector<double> u, v;
+    std::vector<double> x, y, z;
+
+    int size() const { return (int)u.size(); }
+    int blocks() const { return (size() + kDistillBlock - 1) / kDistillBlock; }
+};
+
+// Coordinates 0, step, 2 step, ... up to and including size - 1.
+std::vector<double> SampleCoordinates(int size, int step)
+{
+    std::vector<double> coords;
+    for(int c = 0; c < size - 1; c += step) {
+        coords.push_back(c);
+    }
+    if(size > 0) {
+        coords.push_back(size - 1);
+    }
+    return coords;
+}
+
+// Unproject the sample grid through 'camera' and keep the pixels whose ray
+// is finite and in front of it.
+void SampleCamera(const CameraInterface<double>& camera,
+                  const ParamsCameraDistill& params,
+                  DistillSamples& samples,
+                  size_t& num_dropped)
+{
+    const int step = std::max(params.pixel_step, 1);
+    const std::vector<double> xs = SampleCoordinates(camera.Width(), step);
+    const std::vector<double> ys = SampleCoordinates(camera.Height(), step);
+    const int n = (int)(xs.size() * ys.size());
+
+    std::vector<double> u(n), v(n), x(n), y(n), z(n);
+    for(size_t j = 0; j < ys.size(); ++j) {
+        for(size_t i = 0; i < xs.size(); ++i) {
+            u[j * xs.size() + i] = xs[i];
+            v[j * xs.size() + i] = ys[j];
+        }
+    }
+    ParallelForBands(n, params.num_threads, [&](int begin, int end) {
+        camera.UnprojectN(&u[begin], &v[begin], &x[begin], &y[begin],
+                          &z[begin], end - begin);
+    });
+
+    samples = DistillSamples();
+    for(int i = 0; i < n; ++i) {
+        if(std::isfinite(x[i]) && std::isfinite(y[i]) &&
+           std::isfinite(z[i]) && z[i] > 0) {
+            samples.u.push_back(u[i]);
+            samples.v.push_back(v[i]);
+            samples.x.push_back(x[i]);
+            samples.y.push_back(y[i]);
+            samples.z.push_back(z[i]);
+        }
+    }
+    num_dropped = n - samples.size();
+}
+
+// Sum of squared reprojection errors of the samples through 'fit' and, if
+// jtj and jtr are given, the normal equations of its parameters. The cost
+// is infinite if a sample can't be projected.
+double Evaluate(const CameraInterface<double>& fit,
+                const DistillSamples& samples,
+                unsigned int num_threads,
+                Eigen::MatrixXd* jtj,
+                Eigen::VectorXd* jtr)
+{
+    const int num_params = fit.NumParams();
+    const int num_blocks = samples.blocks();
+    std::vector<double> costs(num_blocks, 0.0);
+    std::vector<Eigen::MatrixXd> block_jtj(jtj ? num_blocks : 0);
+    std::vector<Eigen::VectorXd> block_jtr(jtr ? num_blocks : 0);
+
+    ParallelForBands(num_blocks, num_threads, [&](int begin, int end) {
+        Eigen::Matrix<double, 2, Eigen::Dynamic> j(2, num_params);
+        for(int b = begin; b < end; ++b) {
+            if(jtj) {
+                block_jtj[b].setZero(num_params, num_params);
+                block_jtr[b].setZero(num_params);
+            }
+            const int last = std::min(samples.size(), (b + 1) * kDistillBlock);
+            for(int i = b * kDistillBlock; i < last; ++i) {
+                const Eigen::Vector3d ray(samples.x[i], samples.y[i], samples.z[i]);
+                Eigen::Vector2d pix;
+                fit.ProjectWithJacobians(ray, pix, nullptr,
+                                         jtj ? j.data() : nullptr);
+                const Eigen::Vector2d r = pix - Eigen::Vector2d(samples.u[i], samples.v[i]);
+                costs[b] += r.squaredNorm();
+                if(jtj) {
+                    block_jtj[b].selfadjointView<Eigen::Upper>().rankUpdate(j.transpose());
+                    block_jtr[b] += j.transpose() * r;
+                }
+            }
+        }
+    });
+
+    double cost = 0;
+    if(jtj) {
+        jtj->setZero(num_params, num_params);
+        jtr->setZero(num_params);
+    }
+    for(int b = 0; b < num_blocks; ++b) {
+        cost += costs[b];
+        if(jtj) {
+            *jtj += block_jtj[b];
+            *jtr += block_jtr[b];
+        }
+    }
+    if(jtj) {
+        *jtj = jtj->selfadjointView<Eigen::Upper>();
+    }
+    return std::isfinite(cost) ? cost : std::numeric_limits<double>::infinity();
+}
+
+// Largest distance between a pixel and where 'project' projects the ray
+// 'unproject' unprojects through it, over the pixels of 'samples'. Pixels
+// that don't come back count as infinitely far.
+double MaxRoundTripError(const CameraInterface<double>& unproject,
+                         const CameraInterface<double>& project,
+                         const DistillSamples& samples,
+                         unsigned int num_threads)
+{
+    const int n = samples.size();
+    std::vector<double> x(n), y(n), z(n), u(n), v(n);
+    ParallelForBands(n, num_threads, [&](int begin, int end) {
+        unproject.UnprojectN(&samples.u[begin], &samples.v[begin], &x[begin],
+                             &y[begin], &z[begin], end - begin);
+        project.ProjectN(&x[begin], &y[begin], &z[begin], &u[begin],
+                         &v[begin], end - begin);
+    });
+
+    double max_error = 0;
+    for(int i = 0; i < n; ++i) {
+        const double error = std::hypot(u[i] - samples.u[i], v[i] - samples.v[i]);
+        max_error = std::max(max_error, std::isfinite(error) ?
+                                 error : std::numeric_limits<double>::infinity());
+    }
+    return max_error;
+}
+
+}
+
+///////////////////////////////////////////////////////////////////////////////
+std::shared_ptr<CameraInterface<double> > DistillCamera(
+        const CameraInterface<double>& camera,
+        const std::string& type,
+        CameraDistillation& result,
+        const ParamsCameraDistill& params
+        )
+{
+    result = CameraDistillation();
+    std::shared_ptr<CameraInterface<double> > fit = CreateCameraModel(type);
+    if(!fit) {
+        return nullptr;
+    }
+
+    DistillSamples samples;
+    SampleCamera(camera, params, samples, result.num_dropped);
+    result.num_samples = samples.size();
+    if(samples.size() == 0) {
+        return nullptr;
+    }
+
+    fit->SetType(type);
+    fit->SetImageDimensions(camera.Width(), camera.Height());
+    fit->SetRDF(camera.RDF());
+    fit->SetPose(camera.Pose());
+    fit->SetVersion(camera.Version());
+    fit->SetIndex(camera.Index());
+    fit->SetSerialNumber(camera.SerialNumber());
+    fit->SetName(camera.Name());
+
+    // Start from the pinhole parameters of the source without distortion
+    const Eigen::Matrix3d K = camera.K();
+    Eigen::VectorXd x = Eigen::VectorXd::Zero(fit->NumParams());
+    x.head<4>() << K(0, 0), K(1, 1), K(0, 2), K(1, 2);
+    if(std::dynamic_pointer_cast<FovCamera<double> >(fit)) {
+        x[4] = kInitialFovW;
+    }
+    fit->SetParams(x);
+
+    Eigen::MatrixXd jtj;
+    Eigen::VectorXd jtr;
+    double cost = Evaluate(*fit, samples, params.num_threads, &jtj, &jtr);
+    double lambda = 1e-4;
+    for(result.iterations = 0; result.iterations < params.max_iterations &&
+        std::isfinite(cost); ++result.iterations) {
+        Eigen::MatrixXd A = jtj;
+        A.diagonal() += lambda * jtj.diagonal().cwiseMax(1e-9);
+        const Eigen::VectorXd step = A.ldlt().solve(-jtr);
+        fit->SetParams(x + step);
+        const double new_cost = Evaluate(*fit, samples, params.num_threads,
+                                         nullptr, nullptr);
+        if(new_cost < cost) {
+            const bool converged = cost - new_cost <= 1e-12 * cost;
+            x += step;
+            cost = Evaluate(*fit, samples, params.num_threads, &jtj, &jtr);
+            lambda = std::max(lambda / 10, 1e-12);
+            if(converged) {
+                ++result.iterations;
+                break;
+            }
+        } else {
+            fit->SetParams(x);
+            lambda *= 10;
+            if(lambda > 1e12) {
+                break;
+            }
+        }
+    }
+
+    // Reprojection error of each sample through the fit
+    const int num_blocks = samples.blocks();
+    std::vector<double> block_sq(num_blocks, 0.0), block_max(num_blocks, 0.0);
+    ParallelForBands(num_blocks, params.num_threads, [&](int begin, int end) {
+        for(int b = begin; b < end; ++b) {
+            const int last = std::min(samples.size(), (b + 1) * kDistillBlock);
+            for(int i = b * kDistillBlock; i < last; ++i) {
+                const Eigen::Vector2d pix = fit->Project(
+                            Eigen::Vector3d(samples.x[i], samples.y[i], samples.z[i]));
+                double error = std::hypot(pix[0] - samples.u[i], pix[1] - samples.v[i]);
+                if(!std::isfinite(error)) {
+                    error = std::numeric_limits<double>::infinity();
+                }
+                block_sq[b] += error * error;
+                block_max[b] = std::max(block_max[b], error);
+            }
+        }
+    });
+    double sum_sq = 0;
+    for(int b = 0; b < num_blocks; ++b) {
+        sum_sq += block_sq[b];
+        result.max_error = std::max(result.max_error, block_max[b]);
+    }
+    result.rms_error = std::sqrt(sum_sq / samples.size());
+    result.max_unproject_error =
+            MaxRoundTripError(*fit, camera, samples, params.num_threads);
+    return fit;
+}
+
+}
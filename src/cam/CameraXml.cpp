@@ -107,27 +107,8 @@ void WriteXmlCamera(const std::string& filename,
 std::shared_ptr<CameraInterfaced> ReadXmlCamera(tinyxml2::XMLElement* pEl)
 {    
   std::string sType = CameraType( pEl->Attribute("type"));
-  std::shared_ptr<CameraInterfaced> rCam;
-
-    if (sType == "calibu_fu_fv_u0_v0_w") {
-    rCam.reset(new calibu::FovCamera<double>());
-    rCam->SetParams(Eigen::VectorXd::Constant(FovCamera<double>::NumParams,1));
-  } else if (sType == "calibu_fu_fv_u0_v0") {
-    rCam.reset(new calibu::LinearCamera<double>());
-    rCam->SetParams(Eigen::VectorXd::Constant(LinearCamera<double>::NumParams,1));
-  } else if (sType == "calibu_fu_fv_u0_v0_k1_k2") {
-    rCam.reset(new calibu::Poly2Camera<double>());
-    rCam->SetParams(Eigen::VectorXd::Constant(Poly2Camera<double>::NumParams,1));
-  } else if (sType == "calibu_fu_fv_u0_v0_kb4") {
-    rCam.reset(new calibu::KannalaBrandtCamera<double>());
-    rCam->SetParams(Eigen::VectorXd::Constant(KannalaBrandtCamera<double>::NumParams,1));
-  } else if (sType == "calibu_fu_fv_u0_v0_k1_k2_k3") {
-    rCam.reset(new calibu::Poly3Camera<double>());
-    rCam->SetParams(Eigen::VectorXd::Constant(Poly3Camera<double>::NumParams,1));
-  } else if (sType == "calibu_fu_fv_u0_v0_rational6") {
-	rCam.reset(new calibu::Rational6Camera<double>());
-	rCam->SetParams(Eigen::VectorXd::Constant(Rational6Camera<double>::NumParams,1));
-  } else {
+  std::shared_ptr<CameraInterfaced> rCam = CreateCameraModel(sType);
+  if (!rCam) {
     std::cerr << "Unknown old camera type " << sType << " please implement this"
                  " camera before initializing it. " << std::endl;
     throw 0;
@@ -334,5 +315,165 @@ std::shared_ptr<Rigd> ReadXmlRigFromString(const std::string& modelXML)
   }
   return std::shared_ptr<Rigd>(NULL);
 }
-  
+
+///////////////////////////////////////////////////////////////////////////////
+
+XmlRigReader::XmlRigReader(std::istream& in)
+  : buf_(in ? in.rdbuf() : nullptr), in_rig_(false), capturing_(false)
+{
+}
+
+XmlRigReader::XmlRigReader(const std::string& filename)
+  : file_(new std::ifstream(filename)), buf_(nullptr), in_rig_(false),
+    capturing_(false)
+{
+  if(*file_) {
+    buf_ = file_->rdbuf();
+  }else{
+    std::cerr << "Unable to open rig file '" << filename << "'" << std::endl;
+  }
+}
+
+int XmlRigReader::Get()
+{
+  if(!buf_) {
+    return std::char_traits<char>::eof();
+  }
+  const int c = buf_->sbumpc();
+  if(capturing_ && c != std::char_traits<char>::eof()) {
+    capture_ += (char)c;
+  }
+  return c;
+}
+
+bool XmlRigReader::NextTag(std::string& name, bool& closing, bool& empty)
+{
+  const int eof = std::char_traits<char>::eof();
+  int c;
+  while((c = Get()) != eof) {
+    if(c != '<') {
+      continue;
+    }
+
+    // Read up to the closing '>', which may appear in quoted attribute
+    // values and, unless followed by "--", in comments.
+    tag_.clear();
+    char quote = 0;
+    while((c = Get()) != eof) {
+      const bool comment = tag_.compare(0, 3, "!--") == 0;
+      if(c == '>' && !quote && (!comment || (tag_.size() >= 5 &&
+          tag_.compare(tag_.size() - 2, 2, "--") == 0))) {
+        break;
+      }
+      if(quote) {
+        if(c == quote) {
+          quote = 0;
+        }
+      }else if(!comment && (c == '"' || c == '\'')) {
+        quote = c;
+      }
+      tag_ += (char)c;
+    }
+    if(c == eof) {
+      return false;
+    }
+
+    // Skip comments, declarations and processing instructions
+    if(tag_.empty() || tag_[0] == '!' || tag_[0] == '?') {
+      continue;
+    }
+
+    closing = tag_[0] == '/';
+    empty = tag_[tag_.size() - 1] == '/';
+    const size_t begin = closing ? 1 : 0;
+    const size_t end = tag_.find_first_of(" \t\r\n/", begin);
+    name = tag_.substr(begin, end == std::string::npos ? end : end - begin);
+    return true;
+  }
+  return false;
+}
+
+bool XmlRigReader::NextRig()
+{
+  std::string name;
+  bool closing, empty;
+
+  // Skip what is left of the current rig without decoding it
+  while(in_rig_ && NextTag(name, closing, empty)) {
+    if(closing && name == NODE_RIG) {
+      in_rig_ = false;
+    }
+  }
+  in_rig_ = false;
+
+  while(NextTag(name, closing, empty)) {
+    if(!closing && name == NODE_RIG) {
+      in_rig_ = !empty;
+      return true;
+    }
+  }
+  return false;
+}
+
+std::shared_ptr<CameraInterfaced> XmlRigReader::NextCamera()
+{
+  std::string name;
+  bool closing, empty;
+
+  while(in_rig_ && NextTag(name, closing, empty)) {
+    if(closing && name == NODE_RIG) {
+      in_rig_ = false;
+      break;
+    }
+    if(closing || empty || name != NODE_CAM_POSE) {
+      continue;
+    }
+
+    // Collect the text of this camera and parse only that
+    capture_ = "<" + tag_ + ">";
+    capturing_ = true;
+    int depth = 1;
+    while(depth > 0 && NextTag(name, closing, empty)) {
+      if(!empty && name == NODE_CAM_POSE) {
+        depth += closing ? -1 : 1;
+      }
+    }
+    capturing_ = false;
+    if(depth > 0) {
+      std::cerr << "Truncated " << NODE_CAM_POSE << " element in rig"
+                << std::endl;
+      in_rig_ = false;
+      break;
+    }
+
+    tinyxml2::XMLDocument doc;
+    if(tinyxml2::XML_SUCCESS != doc.Parse(capture_.c_str(), capture_.size())) {
+      std::cerr << doc.ErrorStr() << ": Error parsing camera '" << capture_
+                << "'" << std::endl;
+      continue;
+    }
+    tinyxml2::XMLNode* pNode = doc.FirstChildElement(NODE_CAM_POSE.c_str());
+    if(!pNode->FirstChildElement(NODE_CAM.c_str())) {
+      continue;
+    }
+    std::shared_ptr<CameraInterfaced> cap = ReadXmlCameraAndTransform(pNode);
+    if(cap->IsInitialized()) {
+      return cap;
+    }
+  }
+  return std::shared_ptr<CameraInterfaced>(NULL);
+}
+
+std::shared_ptr<Rigd> XmlRigReader::Next()
+{
+  if(!NextRig()) {
+    return std::shared_ptr<Rigd>(NULL);
+  }
+  std::shared_ptr<Rigd> rig(new Rigd());
+  while(std::shared_ptr<CameraInterfaced> cap = NextCamera()) {
+    rig->AddCamera(cap);
+  }
+  return rig;
+}
+
 }
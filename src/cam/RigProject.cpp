@@ -0,0 +1,184 @@
+
+/*
+   This file is part of the Calibu Project.
+   https://github.com/gwu-robotics/Calibu
+
+   Copyright (C) 2013 George Washington University,
+                      Steven Lovegrove,
+                      Gabe Sibley
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+   http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+#include <calibu/cam/rig_project.h>
+#include <calibu/utils/Parallel.h>
+
+#include <algorithm>
+#include <cmath>
+
+namespace calibu
+{
+
+namespace
+{
+
+// Points moved into a camera's frame and projected at a time.
+const size_t kProjectBatch = 256;
+
+// Pixels around the border of a w x h image every step pixels, in order
+// around it.
+Eigen::Matrix2Xd BorderPixels(int w, int h, int step)
+{
+    std::vector<Eigen::Vector2d, Eigen::aligned_allocator<Eigen::Vector2d> > pix;
+    const double r = w - 1;
+    const double b = h - 1;
+    for(int x = 0; x < w - 1; x += step) pix.push_back(Eigen::Vector2d(x, 0));
+    for(int y = 0; y < h - 1; y += step) pix.push_back(Eigen::Vector2d(r, y));
+    for(int x = w - 1; x > 0; x -= step) pix.push_back(Eigen::Vector2d(x, b));
+    for(int y = h - 1; y > 0; y -= step) pix.push_back(Eigen::Vector2d(0, y));
+
+    Eigen::Matrix2Xd border(2, pix.size());
+    for(size_t i = 0; i < pix.size(); ++i) {
+        border.col(i) = pix[i];
+    }
+    return border;
+}
+
+// Half angle of the cone around the optical axis holding every ray through
+// the border. Between two border samples the angle can exceed theirs by at
+// most half the angle between them, which is added as a margin.
+double BorderHalfFov(const CameraInterface<double>& cam, int step)
+{
+    const Eigen::Matrix2Xd border =
+            BorderPixels(cam.Width(), cam.Height(), std::max(step, 1));
+    Eigen::Matrix3Xd rays;
+    cam.UnprojectN(border, rays);
+
+    double half_fov = 0;
+    double margin = 0;
+    for(int i = 0; i < rays.cols(); ++i) {
+        const Eigen::Vector3d ray = rays.col(i).normalized();
+        const Eigen::Vector3d next = rays.col((i + 1) % rays.cols()).normalized();
+        if(!ray.allFinite() || !next.allFinite()) {
+            // The model can't unproject its whole image, so don't cull
+            return M_PI;
+        }
+        half_fov = std::max(half_fov, std::atan2(ray.head<2>().norm(), ray[2]));
+        margin = std::max(margin, std::acos(std::min(1.0, ray.dot(next))) / 2);
+    }
+    return std::min(half_fov + margin, M_PI);
+}
+
+}
+
+///////////////////////////////////////////////////////////////////////////////
+RigProjector::RigProjector()
+    : min_range_(0), max_range_(std::numeric_limits<double>::infinity())
+{
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void RigProjector::Init(
+        const std::shared_ptr<calibu::Rig<double>>& rig,
+        double min_range,
+        double max_range,
+        int border_step
+        )
+{
+    min_range_ = min_range;
+    max_range_ = max_range;
+    cams_.clear();
+    for(const std::shared_ptr<CameraInterface<double>>& cam : rig->cameras_) {
+        CameraView view;
+        view.camera = cam->Snapshot();
+        const Sophus::SE3d T_cr = cam->Pose().inverse();
+        view.R_cr = T_cr.rotationMatrix();
+        view.t_cr = T_cr.translation();
+        view.half_fov = BorderHalfFov(*cam, border_step);
+        view.cos_fov = std::cos(view.half_fov);
+        view.width = cam->Width();
+        view.height = cam->Height();
+        cams_.push_back(view);
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+double RigProjector::HalfFov( size_t cam ) const
+{
+    return cams_[cam].half_fov;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void RigProjector::Project(
+        const Eigen::Vector3d* P_r,
+        size_t count,
+        std::vector<std::vector<RigProjection> >& projections,
+        unsigned int num_threads
+        ) const
+{
+    projections.resize(cams_.size());
+    ParallelForBands(cams_.size(), num_threads, [&](int begin, int end) {
+        for(int c = begin; c < end; ++c) {
+            ProjectCamera(cams_[c], P_r, count, projections[c]);
+        }
+    });
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void RigProjector::ProjectCamera(
+        const CameraView& view,
+        const Eigen::Vector3d* P_r,
+        size_t count,
+        std::vector<RigProjection>& projections
+        ) const
+{
+    const double min_range2 = min_range_ * min_range_;
+    const double max_range2 = max_range_ * max_range_;
+    const bool cull_fov = view.half_fov < M_PI;
+
+    double x[kProjectBatch], y[kProjectBatch], z[kProjectBatch];
+    double u[kProjectBatch], v[kProjectBatch];
+    uint32_t index[kProjectBatch];
+
+    projections.clear();
+    for(size_t begin = 0; begin < count; begin += kProjectBatch) {
+        const size_t end = std::min(count, begin + kProjectBatch);
+
+        // Cull by range and field of view before projecting
+        size_t n = 0;
+        for(size_t i = begin; i < end; ++i) {
+            const Eigen::Vector3d P_c = view.R_cr * P_r[i] + view.t_cr;
+            const double range2 = P_c.squaredNorm();
+            if(!(range2 >= min_range2 && range2 <= max_range2)) {
+                continue;
+            }
+            if(cull_fov && P_c[2] < view.cos_fov * std::sqrt(range2)) {
+                continue;
+            }
+            x[n] = P_c[0];
+            y[n] = P_c[1];
+            z[n] = P_c[2];
+            index[n] = (uint32_t)i;
+            ++n;
+        }
+
+        view.camera->ProjectN(x, y, z, u, v, n);
+        for(size_t j = 0; j < n; ++j) {
+            if(u[j] >= 0 && v[j] >= 0 &&
+               u[j] <= view.width - 1 && v[j] <= view.height - 1) {
+                projections.push_back(RigProjection{index[j], u[j], v[j]});
+            }
+        }
+    }
+}
+
+}
@@ -0,0 +1,165 @@
+
+/*
+   This file is part of the Calibu Project.
+   https://github.com/gwu-robotics/Calibu
+
+   Copyright (C) 2013 George Washington University,
+                      Steven Lovegrove,
+                      Gabe Sibley
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+   http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+#include <calibu/cam/rig_rectify.h>
+#include <calibu/cam/camera_models_crtp.h>
+#include <calibu/exception.h>
+#include <calibu/utils/Parallel.h>
+
+namespace calibu
+{
+
+namespace
+{
+
+// Rotation from the rig frame to the common rectified frame, with rows the
+// new axes. x follows the line through the camera centers, oriented as the
+// first camera's x-axis, and z averages the cameras' hypothetical forward
+// vectors perpendicular to it.
+Eigen::Matrix3d CommonPlaneBasis(
+        const std::vector<std::shared_ptr<calibu::CameraInterface<double>>>& cams
+        )
+{
+    Eigen::Vector3d mean = Eigen::Vector3d::Zero();
+    for(const auto& cam : cams) {
+        mean += cam->Pose().translation();
+    }
+    mean /= cams.size();
+
+    Eigen::Matrix3d scatter = Eigen::Matrix3d::Zero();
+    for(const auto& cam : cams) {
+        const Eigen::Vector3d d = cam->Pose().translation() - mean;
+        scatter += d * d.transpose();
+    }
+
+    const Eigen::Matrix3d R_r0 = cams[0]->Pose().so3().matrix();
+    Eigen::Vector3d x_r = R_r0.col(0);
+    if(scatter.trace() > 1e-12) {
+        // Eigenvalues are sorted in increasing order
+        Eigen::SelfAdjointEigenSolver<Eigen::Matrix3d> eig(scatter);
+        x_r = eig.eigenvectors().col(2);
+        if(x_r.dot(R_r0.col(0)) < 0) {
+            x_r = -x_r;
+        }
+    }
+
+    Eigen::Vector3d fwd_r = Eigen::Vector3d::Zero();
+    for(const auto& cam : cams) {
+        const Eigen::Vector3d up_r = cam->Pose().so3() * Eigen::Vector3d(0,-1,0);
+        fwd_r += up_r.cross(x_r).normalized();
+    }
+
+    const Eigen::Vector3d z_r = fwd_r.normalized();
+    const Eigen::Vector3d y_r = z_r.cross(x_r).normalized();
+
+    Eigen::Matrix3d R_nr;
+    R_nr << x_r.transpose(), y_r.transpose(), z_r.transpose();
+    return R_nr;
+}
+
+void FillLookupTable(
+        const std::shared_ptr<calibu::CameraInterface<double>>& cam,
+        const Eigen::Matrix3d& R_onKinv,
+        LookupTable& lut,
+        LookupTableCache* cache,
+        unsigned int num_threads
+        )
+{
+    if(cache) {
+        cache->Fill(cam, R_onKinv, lut);
+    } else {
+        lut = LookupTable(cam->Width(), cam->Height());
+        CreateLookupTable(cam, R_onKinv, lut, 0, 0, num_threads);
+    }
+}
+
+}
+
+///////////////////////////////////////////////////////////////////////////////
+RigRectifier::RigRectifier()
+    : R_nr_(Eigen::Matrix3d::Identity())
+{
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void RigRectifier::Init(
+        const std::shared_ptr<calibu::Rig<double>>& rig,
+        LookupTableCache* cache,
+        unsigned int num_threads
+        )
+{
+    const std::vector<std::shared_ptr<calibu::CameraInterface<double>>>& cams =
+            rig->cameras_;
+    const int num_cams = cams.size();
+    CALIBU_ASSERT_DESC(num_cams > 0, "cannot rectify an empty rig");
+
+    R_nr_ = CommonPlaneBasis(cams);
+
+    // Keep the rectified images of every camera inside their source image
+    rays_.resize(num_cams);
+    std::vector<Eigen::Matrix3d> R_nc(num_cams);
+    Range range_width = Range::Open();
+    Range range_height = Range::Open();
+    for(int i = 0; i < num_cams; ++i) {
+        rays_[i].Update(*cams[i]);
+        R_nc[i] = R_nr_ * cams[i]->Pose().so3().matrix();
+        range_width = Intersection(range_width, rays_[i].RotatedColRange(R_nc[i]));
+        range_height = Intersection(range_height, rays_[i].RotatedRowRange(R_nc[i]));
+    }
+
+    // We want to map range width/height to image via K.
+    const int width = cams[0]->Width();
+    const int height = cams[0]->Height();
+    const double fu = (width-1) / range_width.Size();
+    const double fv = (height-1) / range_height.Size();
+    const double u0 = -fu * range_width.minr;
+    const double v0 = -fv * range_height.minr;
+
+    Eigen::Vector2i size_;
+    Eigen::Matrix<double,1, calibu::LinearCamera<double>::NumParams> params_;
+    size_ << width, height;
+    params_ << fu, fv, u0, v0;
+
+    rig_.reset(new calibu::Rig<double>());
+    for(int i = 0; i < num_cams; ++i) {
+        std::shared_ptr<calibu::CameraInterface<double>>
+            new_cam(new calibu::LinearCamera<double>(params_, size_));
+        new_cam->SetPose(Sophus::SE3d(R_nr_.transpose(), cams[i]->Pose().translation()));
+        new_cam->SetIndex(i);
+        new_cam->SetName(cams[i]->Name());
+        rig_->AddCamera(new_cam);
+    }
+
+    // Build one table per band of cameras, dividing the threads among them.
+    const Eigen::Matrix3d Kinv = rig_->cameras_[0]->K().inverse();
+    const unsigned int threads = NumWorkerThreads(num_threads);
+    const unsigned int cam_threads = std::max(1u, threads / num_cams);
+
+    luts_.resize(num_cams);
+    ParallelForBands( num_cams, threads, [&]( int begin, int end ) {
+        for(int i = begin; i < end; ++i) {
+            FillLookupTable(cams[i], R_nc[i].transpose() * Kinv, luts_[i], cache,
+                            cam_threads);
+        }
+    } );
+}
+
+}
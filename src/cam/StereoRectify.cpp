@@ -25,15 +25,20 @@
 #include <calibu/cam/camera_crtp.h>
 #include <calibu/utils/Range.h>
 
+#include <thread>
+
 namespace calibu
 {
 
-std::shared_ptr<calibu::Rig<double>> CreateScanlineRectifiedLookupAndCameras(const Sophus::SE3d& T_rl,
-        const std::shared_ptr<calibu::CameraInterface<double> > cam_left,
-        const std::shared_ptr<calibu::CameraInterface<double> > cam_right,
-        Sophus::SE3d& T_nr_nl,
-        LookupTable& left_lut,
-        LookupTable& right_lut
+namespace
+{
+
+// New orientation for both left and right cameras (expressed relative to
+// original left), and new extrinsics with the right camera on the x-axis.
+void ScanlineBasis(
+        const Sophus::SE3d& T_rl,
+        Eigen::Matrix3d& Rnl_l,
+        Sophus::SE3d& T_nr_nl
         )
 {
     const Sophus::SO3d R_rl = T_rl.so3();
@@ -57,34 +62,33 @@ std::shared_ptr<calibu::Rig<double>> CreateScanlineRectifiedLookupAndCameras(con
     const Eigen::Vector3d z_l = avgfwd_l.normalized();
     const Eigen::Vector3d y_l = z_l.cross(x_l).normalized();
 
-    // New orientation for both left and right cameras (expressed relative to original left)
-    Eigen::Matrix3d Rnl_l;
-    Rnl_l << x_l, y_l, z_l;
+    // Rows are the new axes, so that Rnl_l maps left rays into the new frame
+    Rnl_l << x_l.transpose(), y_l.transpose(), z_l.transpose();
 
     // By definition, the right camera now lies exactly on the x-axis with the same orientation
     // as the left camera.
     T_nr_nl = Sophus::SE3d(Eigen::Matrix3d::Identity(), Eigen::Vector3d(-r_l.norm(),0,0) );
+}
 
-    // Work out parameters of new linear camera
-    const Range range_width = //Intersection(
-                MinMaxRotatedCol(cam_left, Rnl_l);
-//                MinMaxRotatedCol(cam_right, Rnl_l)
-//                );
-    const Range range_height = //Intersection(
-                MinMaxRotatedRow(cam_left, Rnl_l);
-//                MinMaxRotatedRow(cam_right, Rnl_l)
-//                );
-
+// Linear camera pair mapping range_width x range_height onto the image.
+std::shared_ptr<calibu::Rig<double>> NewLinearRig(
+        const Range& range_width,
+        const Range& range_height,
+        int width,
+        int height,
+        const Sophus::SE3d& T_nr_nl
+        )
+{
     // We want to map range width/height to image via K.
-    const double fu = (cam_left->Width()-1) / range_width.Size();
-    const double fv = (cam_left->Height()-1) / range_height.Size();
+    const double fu = (width-1) / range_width.Size();
+    const double fv = (height-1) / range_height.Size();
     const double u0 = -fu * range_width.minr;
     const double v0 = -fv * range_height.minr;
 
     // Setup new camera
     Eigen::Vector2i size_;
     Eigen::Matrix<double,1, calibu::LinearCamera<double>::NumParams> params_;
-    size_ << cam_left->Width(), cam_left->Height();
+    size_ << width, height;
     params_ << fu, fv, u0, v0;
 
     std::shared_ptr<calibu::Rig<double>> new_rig(new calibu::Rig<double>());
@@ -94,18 +98,185 @@ std::shared_ptr<calibu::Rig<double>> CreateScanlineRectifiedLookupAndCameras(con
     new_cam_left->SetPose(Sophus::SE3d());
     std::shared_ptr<calibu::CameraInterface<double>>
         new_cam_right(new calibu::LinearCamera<double>(params_, size_));
-    new_cam_left->SetPose(T_nr_nl);
+    new_cam_right->SetPose(T_nr_nl);
 
     new_rig->AddCamera(new_cam_left);
     new_rig->AddCamera(new_cam_right);
+    return new_rig;
+}
+
+void FillLookupTable(
+        const std::shared_ptr<calibu::CameraInterface<double>>& cam,
+        const Eigen::Matrix3d& R_onKinv,
+        LookupTable& lut,
+        LookupTableCache* cache,
+        unsigned int num_threads
+        )
+{
+    if(cache) {
+        cache->Fill(cam, R_onKinv, lut);
+    } else {
+        lut = LookupTable(cam->Width(), cam->Height());
+        CreateLookupTable(cam, R_onKinv, lut, 0, 0, num_threads);
+    }
+}
+
+}
+
+std::shared_ptr<calibu::Rig<double>> CreateScanlineRectifiedLookupAndCameras(const Sophus::SE3d& T_rl,
+        const std::shared_ptr<calibu::CameraInterface<double> > cam_left,
+        const std::shared_ptr<calibu::CameraInterface<double> > cam_right,
+        Sophus::SE3d& T_nr_nl,
+        LookupTable& left_lut,
+        LookupTable& right_lut,
+        LookupTableCache* cache
+        )
+{
+    const Sophus::SO3d R_lr = T_rl.so3().inverse();
+
+    Eigen::Matrix3d Rnl_l;
+    ScanlineBasis(T_rl, Rnl_l, T_nr_nl);
+
+    // Work out parameters of new linear camera
+    const Range range_width = MinMaxRotatedCol(cam_left, Rnl_l);
+    const Range range_height = MinMaxRotatedRow(cam_left, Rnl_l);
+
+    std::shared_ptr<calibu::Rig<double>> new_rig = NewLinearRig(
+                range_width, range_height, cam_left->Width(), cam_left->Height(),
+                T_nr_nl);
+    const std::shared_ptr<calibu::CameraInterface<double>>& new_cam_left =
+            new_rig->cameras_[0];
 
     // Homographies which should be applied to left and right images to scan-line rectify them
     const Eigen::Matrix3d Rl_nlKlinv = Rnl_l.transpose() * new_cam_left->K().inverse();
     const Eigen::Matrix3d Rr_nrKlinv = R_lr.inverse().matrix() * Rnl_l.transpose() * new_cam_left->K().inverse();
 
-    CreateLookupTable(cam_left, Rl_nlKlinv, left_lut);
-    CreateLookupTable(cam_right, Rr_nrKlinv, right_lut);
+    if(cache) {
+        cache->Fill(cam_left, Rl_nlKlinv, left_lut);
+        cache->Fill(cam_right, Rr_nrKlinv, right_lut);
+    } else {
+        CreateLookupTable(cam_left, Rl_nlKlinv, left_lut);
+        CreateLookupTable(cam_right, Rr_nrKlinv, right_lut);
+    }
     return new_rig;
 }
 
+///////////////////////////////////////////////////////////////////////////////
+StereoRectifier::StereoRectifier()
+{
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void StereoRectifier::Init(
+        const Sophus::SE3d& T_rl,
+        const std::shared_ptr<calibu::CameraInterface<double>>& cam_left,
+        const std::shared_ptr<calibu::CameraInterface<double>>& cam_right,
+        LookupTableCache* cache,
+        unsigned int num_threads
+        )
+{
+    const Sophus::SO3d R_lr = T_rl.so3().inverse();
+
+    Eigen::Matrix3d Rnl_l;
+    ScanlineBasis(T_rl, Rnl_l, T_nr_nl_);
+
+    left_rays_.Update(*cam_left);
+    right_rays_.Update(*cam_right);
+
+    // Rectified right rays are rotated from the right frame through the left.
+    const Eigen::Matrix3d Rnl_r = Rnl_l * R_lr.matrix();
+    const Range range_width = Intersection(
+                left_rays_.RotatedColRange(Rnl_l),
+                right_rays_.RotatedColRange(Rnl_r)
+                );
+    const Range range_height = Intersection(
+                left_rays_.RotatedRowRange(Rnl_l),
+                right_rays_.RotatedRowRange(Rnl_r)
+                );
+
+    rig_ = NewLinearRig(range_width, range_height, cam_left->Width(),
+                        cam_left->Height(), T_nr_nl_);
+
+    const Eigen::Matrix3d Knew_inv = rig_->cameras_[0]->K().inverse();
+    const Eigen::Matrix3d Rl_nlKlinv = Rnl_l.transpose() * Knew_inv;
+    const Eigen::Matrix3d Rr_nrKlinv = Rnl_r.transpose() * Knew_inv;
+
+    // Build the right table on its own thread with half the threads.
+    const unsigned int threads = NumWorkerThreads(num_threads);
+    const unsigned int right_threads = std::max(1u, threads / 2);
+    const unsigned int left_threads = std::max(1u, threads - right_threads);
+
+    if(threads == 1) {
+        FillLookupTable(cam_left, Rl_nlKlinv, left_lut_, cache, 1);
+        FillLookupTable(cam_right, Rr_nrKlinv, right_lut_, cache, 1);
+    } else {
+        std::thread right_worker([&]() {
+            FillLookupTable(cam_right, Rr_nrKlinv, right_lut_, cache, right_threads);
+        });
+        FillLookupTable(cam_left, Rl_nlKlinv, left_lut_, cache, left_threads);
+        right_worker.join();
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void RectifyBorderRays::Update( const calibu::CameraInterface<double>& cam )
+{
+    const int w = cam.Width();
+    const int h = cam.Height();
+    if(type_ == cam.Type() && width_ == w && height_ == h &&
+       params_.size() == cam.GetParams().size() &&
+       params_ == cam.GetParams()) {
+        return;
+    }
+
+    Eigen::Matrix2Xd pix(2, h);
+    for(int row = 0; row < h; ++row) {
+        pix.col(row) << 0, row;
+    }
+    cam.UnprojectN(pix, left_);
+    pix.row(0).setConstant(w-1);
+    cam.UnprojectN(pix, right_);
+
+    pix.resize(2, w);
+    for(int col = 0; col < w; ++col) {
+        pix.col(col) << col, 0;
+    }
+    cam.UnprojectN(pix, top_);
+    pix.row(1).setConstant(h-1);
+    cam.UnprojectN(pix, bottom_);
+
+    type_ = cam.Type();
+    params_ = cam.GetParams();
+    width_ = w;
+    height_ = h;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+Range RectifyBorderRays::RotatedColRange( const Eigen::Matrix3d& R_nc ) const
+{
+    const Eigen::Matrix3Xd lrays = R_nc * left_;
+    const Eigen::Matrix3Xd rrays = R_nc * right_;
+
+    Range range = Range::Open();
+    for(int i = 0; i < lrays.cols(); ++i) {
+        range.ExcludeLessThan(lrays(0,i) / lrays(2,i));
+        range.ExcludeGreaterThan(rrays(0,i) / rrays(2,i));
+    }
+    return range;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+Range RectifyBorderRays::RotatedRowRange( const Eigen::Matrix3d& R_nc ) const
+{
+    const Eigen::Matrix3Xd trays = R_nc * top_;
+    const Eigen::Matrix3Xd brays = R_nc * bottom_;
+
+    Range range = Range::Open();
+    for(int i = 0; i < trays.cols(); ++i) {
+        range.ExcludeLessThan(trays(1,i) / trays(2,i));
+        range.ExcludeGreaterThan(brays(1,i) / brays(2,i));
+    }
+    return range;
+}
+
 }
@@ -0,0 +1,315 @@
+/*
+   This file is part of the Calibu Project.
+   https://github.com/arpg/Calibu
+
+   Copyright (C) 2013 George Washington University,
+                      Steven Lovegrove,
+                      Gabe Sibley
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+   http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#include <calibu/cam/lookup_table_cache.h>
+#include <calibu/utils/Hash.h>
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <vector>
+
+#ifdef _WIN_
+#  include <process.h>
+#  define getpid _getpid
+#else
+#  include <fcntl.h>
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#  include <unistd.h>
+#endif
+
+namespace calibu
+{
+
+  static_assert( sizeof(LookupTableFileHeader) == 128,
+                 "LookupTableFileHeader must stay 128 bytes" );
+
+  static const char kLookupTableMagic[8] = { 'C','A','L','I','B','U','L','T' };
+
+  namespace
+  {
+    void ResolveSize(
+        const std::shared_ptr<calibu::CameraInterface<double>>& cam_from,
+        int& lookup_width, int& lookup_height )
+    {
+      if( lookup_width < 1 || lookup_height < 1 ) {
+        lookup_width = cam_from->Width();
+        lookup_height = cam_from->Height();
+      }
+    }
+  }
+
+  ///////////////////////////////////////////////////////////////////////////////
+  uint64_t LookupTableHash(
+      const std::shared_ptr<calibu::CameraInterface<double>>& cam_from,
+      const Eigen::Matrix3d& R_onKinv,
+      int lookup_width,
+      int lookup_height
+      )
+  {
+    ResolveSize( cam_from, lookup_width, lookup_height );
+
+    Fnv1aHash hasher;
+    hasher.Add( kLookupTableFileVersion );
+    const std::string type = cam_from->Type();
+    hasher.Add( type.data(), type.size() );
+    hasher.Add( cam_from->Width() );
+    hasher.Add( cam_from->Height() );
+    const Eigen::VectorXd& params = cam_from->GetParams();
+    hasher.Add( params.data(), params.size() * sizeof(double) );
+    hasher.Add( R_onKinv.data(), 9 * sizeof(double) );
+    hasher.Add( lookup_width );
+    hasher.Add( lookup_height );
+    return hasher.Hash();
+  }
+
+  ///////////////////////////////////////////////////////////////////////////////
+  bool SaveLookupTable(
+      const std::string& filename,
+      const LookupTable& lut,
+      uint64_t params_hash,
+      const Eigen::Matrix3d& R_onKinv
+      )
+  {
+    LookupTableFileHeader header;
+    memset( &header, 0, sizeof(header) );
+    memcpy( header.magic, kLookupTableMagic, sizeof(header.magic) );
+    header.version = kLookupTableFileVersion;
+    header.point_size = sizeof(BilinearLutPoint);
+    header.width = lut.Width();
+    header.height = lut.Height();
+    header.params_hash = params_hash;
+    memcpy( header.R_onKinv, R_onKinv.data(), sizeof(header.R_onKinv) );
+
+    std::ostringstream tmp_name;
+    tmp_name << filename << ".tmp." << getpid();
+    const std::string tmp_filename = tmp_name.str();
+    {
+      std::ofstream file( tmp_filename, std::ios::binary | std::ios::trunc );
+      if( !file ) {
+        std::cerr << "Unable to write lookup table '" << tmp_filename << "'"
+                  << std::endl;
+        return false;
+      }
+      file.write( reinterpret_cast<const char*>( &header ), sizeof(header) );
+      file.write( reinterpret_cast<const char*>( lut.m_vLutPixels.data() ),
+                  lut.m_vLutPixels.size() * sizeof(BilinearLutPoint) );
+      if( !file ) {
+        file.close();
+        std::remove( tmp_filename.c_str() );
+        return false;
+      }
+    }
+
+    if( std::rename( tmp_filename.c_str(), filename.c_str() ) != 0 ) {
+      std::remove( tmp_filename.c_str() );
+      return false;
+    }
+    return true;
+  }
+
+  ///////////////////////////////////////////////////////////////////////////////
+  MappedLookupTable::MappedLookupTable()
+    : header_(nullptr), points_(nullptr), mapping_(nullptr), mapping_size_(0)
+  {
+  }
+
+  ///////////////////////////////////////////////////////////////////////////////
+  MappedLookupTable::~MappedLookupTable()
+  {
+    Close();
+  }
+
+  ///////////////////////////////////////////////////////////////////////////////
+  bool MappedLookupTable::Open( const std::string& filename )
+  {
+    Close();
+
+#ifdef _WIN_
+    // No shared mapping here: read the file into private memory instead.
+    std::ifstream file( filename, std::ios::binary | std::ios::ate );
+    if( !file ) {
+      return false;
+    }
+    const size_t size = file.tellg();
+    if( size < sizeof(LookupTableFileHeader) ) {
+      return false;
+    }
+    char* data = new char[size];
+    file.seekg( 0 );
+    if( !file.read( data, size ) ) {
+      delete[] data;
+      return false;
+    }
+    mapping_ = data;
+    mapping_size_ = size;
+#else
+    const int fd = open( filename.c_str(), O_RDONLY );
+    if( fd < 0 ) {
+      return false;
+    }
+    struct stat st;
+    if( fstat( fd, &st ) != 0 ||
+        (size_t) st.st_size < sizeof(LookupTableFileHeader) ) {
+      close( fd );
+      return false;
+    }
+    void* data = mmap( nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0 );
+    close( fd );
+    if( data == MAP_FAILED ) {
+      return false;
+    }
+    mapping_ = data;
+    mapping_size_ = st.st_size;
+#endif
+
+    const LookupTableFileHeader* header =
+        static_cast<const LookupTableFileHeader*>( mapping_ );
+    const size_t expected_size = sizeof(LookupTableFileHeader) +
+        (size_t) header->width * header->height * sizeof(BilinearLutPoint);
+
+    if( memcmp( header->magic, kLookupTableMagic, sizeof(header->magic) ) ||
+        header->version != kLookupTableFileVersion ||
+        header->point_size != sizeof(BilinearLutPoint) ||
+        mapping_size_ != expected_size ) {
+      Close();
+      return false;
+    }
+
+    header_ = header;
+    points_ = reinterpret_cast<const BilinearLutPoint*>( header + 1 );
+    return true;
+  }
+
+  ///////////////////////////////////////////////////////////////////////////////
+  void MappedLookupTable::Close()
+  {
+    if( mapping_ ) {
+#ifdef _WIN_
+      delete[] static_cast<char*>( mapping_ );
+#else
+      munmap( mapping_, mapping_size_ );
+#endif
+    }
+    header_ = nullptr;
+    points_ = nullptr;
+    mapping_ = nullptr;
+    mapping_size_ = 0;
+  }
+
+  ///////////////////////////////////////////////////////////////////////////////
+  Eigen::Matrix3d MappedLookupTable::R_onKinv() const
+  {
+    Eigen::Matrix3d R_onKinv = Eigen::Matrix3d::Zero();
+    if( header_ ) {
+      memcpy( R_onKinv.data(), header_->R_onKinv, sizeof(header_->R_onKinv) );
+    }
+    return R_onKinv;
+  }
+
+  ///////////////////////////////////////////////////////////////////////////////
+  void MappedLookupTable::CopyTo( LookupTable& lut ) const
+  {
+    lut.m_nWidth = Width();
+    lut.m_vLutPixels.assign( points_, points_ + Width() * Height() );
+  }
+
+  ///////////////////////////////////////////////////////////////////////////////
+  LookupTableCache::LookupTableCache( const std::string& directory,
+                                      unsigned int num_threads )
+    : directory_(directory), num_threads_(num_threads)
+  {
+  }
+
+  ///////////////////////////////////////////////////////////////////////////////
+  std::string LookupTableCache::Filename( uint64_t params_hash ) const
+  {
+    char name[32];
+    snprintf( name, sizeof(name), "%016llx.lut",
+              (unsigned long long) params_hash );
+    if( directory_.empty() ) {
+      return name;
+    }
+    return directory_ + "/" + name;
+  }
+
+  ///////////////////////////////////////////////////////////////////////////////
+  std::shared_ptr<const MappedLookupTable> LookupTableCache::Get(
+      const std::shared_ptr<calibu::CameraInterface<double>>& cam_from,
+      const Eigen::Matrix3d& R_onKinv,
+      int lookup_width,
+      int lookup_height
+      )
+  {
+    ResolveSize( cam_from, lookup_width, lookup_height );
+    const uint64_t hash =
+        LookupTableHash( cam_from, R_onKinv, lookup_width, lookup_height );
+
+    std::lock_guard<std::mutex> lock( mutex_ );
+    std::shared_ptr<const MappedLookupTable> mapped = mapped_[hash].lock();
+    if( mapped ) {
+      return mapped;
+    }
+
+    const std::string filename = Filename( hash );
+    std::shared_ptr<MappedLookupTable> table =
+        std::make_shared<MappedLookupTable>();
+
+    if( !table->Open( filename ) || table->ParamsHash() != hash ) {
+      LookupTable lut( lookup_width, lookup_height );
+      CreateLookupTable( cam_from, R_onKinv, lut, lookup_width, lookup_height,
+                         num_threads_ );
+      if( !SaveLookupTable( filename, lut, hash, R_onKinv ) ||
+          !table->Open( filename ) ) {
+        return nullptr;
+      }
+    }
+
+    mapped_[hash] = table;
+    return table;
+  }
+
+  ///////////////////////////////////////////////////////////////////////////////
+  void LookupTableCache::Fill(
+      const std::shared_ptr<calibu::CameraInterface<double>>& cam_from,
+      const Eigen::Matrix3d& R_onKinv,
+      LookupTable& lut,
+      int lookup_width,
+      int lookup_height
+      )
+  {
+    std::shared_ptr<const MappedLookupTable> mapped =
+        Get( cam_from, R_onKinv, lookup_width, lookup_height );
+    if( mapped ) {
+      mapped->CopyTo( lut );
+    } else {
+      // The cache directory is not writable; fall back to computing.
+      ResolveSize( cam_from, lookup_width, lookup_height );
+      lut = LookupTable( lookup_width, lookup_height );
+      CreateLookupTable( cam_from, R_onKinv, lut, lookup_width, lookup_height,
+                         num_threads_ );
+    }
+  }
+
+}
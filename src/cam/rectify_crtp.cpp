@@ -25,10 +25,51 @@
 namespace calibu
 {
 
+  ///////////////////////////////////////////////////////////////////////////////
+  /// Bilinear LUT entry for the distorted location 'pix' in the source image.
+  static inline BilinearLutPoint LutPoint(
+      const Eigen::Vector2d& pix, int cam_width, int cam_height )
+  {
+    Eigen::Vector2d p_warped = pix;
+
+    // Clamp to valid image coords. This will cause out of image
+    // data to be stretched from nearest valid coords with
+    // no branching in rectify function.
+    p_warped[0] = std::min(std::max(0.0, p_warped[0]), cam_width - 1.0 );
+    p_warped[1] = std::min(std::max(0.0, p_warped[1]), cam_height - 1.0 );
+
+    // Truncates the values for the left image
+    int u  = (int) p_warped[0];
+    int v  = (int) p_warped[1];
+    float su = p_warped[0] - (double)u;
+    float sv = p_warped[1] - (double)v;
+
+    // Fix pixel access for last row/column to ensure all accesses are in bounds
+    if(u == (cam_width-1)) {
+      u -= 1;
+      su = 1.0;
+    }
+    if(v == (cam_height-1)) {
+      v -= 1;
+      sv = 1.0;
+    }
+
+    // Pre-compute the bilinear interpolation weights
+    BilinearLutPoint p;
+    p.idx0 = u + v*cam_width;
+    p.idx1 = u + v*cam_width + cam_width;
+    p.w00  = (1-su)*(1-sv);
+    p.w01  =    su *(1-sv);
+    p.w10  = (1-su)*sv;
+    p.w11  =     su*sv;
+    return p;
+  }
+
   ///////////////////////////////////////////////////////////////////////////////
   void CreateLookupTable(
       const std::shared_ptr<calibu::CameraInterface<double> >& cam_from,
-      LookupTable& lut, int lookup_width, int lookup_height )
+      LookupTable& lut, int lookup_width, int lookup_height,
+      unsigned int num_threads )
   {
     /*
        TODO figure out what K should be for the "new" camera based on
@@ -67,7 +108,8 @@ namespace calibu
                      0,   1.0/fv,   -v0 / fv,
                      0,        0,           1;
 
-    CreateLookupTable( cam_from, R_onKinv, lut, lookup_width, lookup_height );
+    CreateLookupTable( cam_from, R_onKinv, lut, lookup_width, lookup_height,
+                       num_threads );
   }
 
 
@@ -78,7 +120,8 @@ namespace calibu
       const Eigen::Matrix3d& R_onKinv,
       LookupTable& lut,
 	  int lookup_width,
-	  int lookup_height
+	  int lookup_height,
+      unsigned int num_threads
       )
   {
     const int cam_width = cam_from->Width();
@@ -100,46 +143,25 @@ namespace calibu
     double x_offset = (lookup_width - cam_width) / 2.0;
     double y_offset = (lookup_height - cam_height) / 2.0;
 
-    for( int r = 0; r < lookup_height; ++r) {
-      for( int c = 0; c < lookup_width; ++c) {
-        // Remap
-        const Eigen::Vector3d p_o = R_onKinv * Eigen::Vector3d(c - x_offset,r - y_offset,1);
-        Eigen::Vector2d p_warped = cam_from->Project(p_o);
-
-        // Clamp to valid image coords. This will cause out of image
-        // data to be stretched from nearest valid coords with
-        // no branching in rectify function.
-        p_warped[0] = std::min(std::max(0.0, p_warped[0]), cam_width - 1.0 );
-        p_warped[1] = std::min(std::max(0.0, p_warped[1]), cam_height - 1.0 );
-
-        // Truncates the values for the left image
-        int u  = (int) p_warped[0];
-        int v  = (int) p_warped[1];
-        float su = p_warped[0] - (double)u;
-        float sv = p_warped[1] - (double)v;
-
-        // Fix pixel access for last row/column to ensure all accesses are in bounds
-        if(u == (cam_width-1)) {
-          u -= 1;
-          su = 1.0;
+    ParallelForBands( lookup_height, num_threads,
+                      [&]( int row_begin, int row_end ) {
+      // Project a full row at a time through the batch interface to avoid a
+      // virtual call per pixel.
+      Eigen::Matrix3Xd rays(3, lookup_width);
+      Eigen::Matrix2Xd pix(2, lookup_width);
+
+      for( int r = row_begin; r < row_end; ++r) {
+        for( int c = 0; c < lookup_width; ++c) {
+          // Remap
+          rays.col(c) = R_onKinv * Eigen::Vector3d(c - x_offset,r - y_offset,1);
         }
-        if(v == (cam_height-1)) {
-          v -= 1;
-          sv = 1.0;
-        }
-
-        // Pre-compute the bilinear interpolation weights
-        BilinearLutPoint p;
-        p.idx0 = u + v*cam_width;
-        p.idx1 = u + v*cam_width + cam_width;
-        p.w00  = (1-su)*(1-sv);
-        p.w01  =    su *(1-sv);
-        p.w10  = (1-su)*sv;
-        p.w11  =     su*sv;
+        cam_from->ProjectN( rays, pix );
 
-        lut.SetPoint( r, c, p );
+        for( int c = 0; c < lookup_width; ++c) {
+          lut.SetPoint( r, c, LutPoint( pix.col(c), cam_width, cam_height ) );
+        }
       }
-    }
+    } );
   }
 
   void CreateLookupTable(
@@ -172,25 +194,7 @@ namespace calibu
       int h
       )
   {
-    // Make the most of the continuous block of memory!
-    const BilinearLutPoint* ptr   = &lut.m_vLutPixels[0];
-
-    const int nHeight = lut.Height();
-    const int nWidth  = lut.Width();
-
-    // Make sure we have been given a correct lookup table.
-    assert(w== nWidth && h == nHeight);
-
-    for( int nRow = 0; nRow < nHeight; nRow++ ) {
-      for( int nCol = 0; nCol < nWidth; nCol++ ) {
-        *pOutputRectImageData++ =
-          (char) ( ptr->w00 * pInputImageData[ ptr->idx0 ] +
-              ptr->w01 * pInputImageData[ ptr->idx0 + 1 ] +
-              ptr->w10 * pInputImageData[ ptr->idx1 ] +
-              ptr->w11 * pInputImageData[ ptr->idx1 + 1 ] );
-        ptr++;
-      }
-    }
+    Rectify<unsigned char>( lut, pInputImageData, pOutputRectImageData, w, h );
   }
 
 
@@ -0,0 +1,310 @@
+/*
+  This file is part of the Calibu Project.
+  https://github.com/gwu-robotics/Calibu
+
+  Copyright (C) 2013 George Washington University,
+  Steven Lovegrove,
+  Gabe Sibley
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+  http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+#include <calibu/cam/rectify_cuda.h>
+#include <calibu/cam/camera_models_crtp.h>
+#include <calibu/exception.h>
+
+#include <cuda_runtime.h>
+#include <string>
+
+namespace calibu
+{
+  namespace
+  {
+    // Largest parameter count of the camera models
+    const int kMaxModelParams = 16;
+
+    const dim3 kBlock( 32, 8 );
+
+    inline void CudaCheck( cudaError_t err )
+    {
+      CALIBU_ASSERT_DESC( err == cudaSuccess,
+                          std::string("CUDA error: ") + cudaGetErrorString(err) );
+    }
+
+    inline dim3 Grid( int width, int height )
+    {
+      return dim3( (width + kBlock.x - 1) / kBlock.x,
+                   (height + kBlock.y - 1) / kBlock.y );
+    }
+
+    /// Device version of RectifyPixel
+    template <typename scalar>
+    __device__ inline scalar ToPixel( float value )
+    {
+      return (scalar) value;
+    }
+
+    template <>
+    __device__ inline unsigned char ToPixel<unsigned char>( float value )
+    {
+      return (unsigned char) ( fminf( fmaxf( value, 0.0f ), 255.0f ) + 0.5f );
+    }
+
+    template <typename scalar>
+    __device__ inline void Interpolate(
+        const BilinearLutPoint& p, const scalar* in, scalar* out, int channels )
+    {
+      const scalar* p00 = in + p.idx0 * channels;
+      const scalar* p10 = in + p.idx1 * channels;
+      for( int n_channel = 0; n_channel < channels; ++n_channel ) {
+        out[n_channel] = ToPixel<scalar>(
+            p.w00 * p00[n_channel] + p.w01 * p00[channels + n_channel] +
+            p.w10 * p10[n_channel] + p.w11 * p10[channels + n_channel] );
+      }
+    }
+
+    template <typename scalar>
+    __global__ void RectifyLutKernel(
+        const BilinearLutPoint* lut, int width, int height, int channels,
+        const scalar* in, scalar* out )
+    {
+      const int c = blockIdx.x * blockDim.x + threadIdx.x;
+      const int r = blockIdx.y * blockDim.y + threadIdx.y;
+      if( c >= width || r >= height ) {
+        return;
+      }
+      const int i = r * width + c;
+      Interpolate( lut[i], in, out + i * channels, channels );
+    }
+
+    /// Everything the model kernel needs, passed by value
+    struct ModelRectify
+    {
+      float params[kMaxModelParams];
+      float R_onKinv[9]; // row major
+      float x_offset;
+      float y_offset;
+      int cam_width;
+      int cam_height;
+    };
+
+    /// Same as LutPoint in rectify_crtp.cpp
+    __device__ inline BilinearLutPoint DeviceLutPoint(
+        float x, float y, int cam_width, int cam_height )
+    {
+      x = fminf( fmaxf( 0.0f, x ), cam_width - 1.0f );
+      y = fminf( fmaxf( 0.0f, y ), cam_height - 1.0f );
+      int u = (int) x;
+      int v = (int) y;
+      float su = x - u;
+      float sv = y - v;
+      if( u == cam_width - 1 ) {
+        u -= 1;
+        su = 1.0f;
+      }
+      if( v == cam_height - 1 ) {
+        v -= 1;
+        sv = 1.0f;
+      }
+
+      BilinearLutPoint p;
+      p.idx0 = u + v * cam_width;
+      p.idx1 = p.idx0 + cam_width;
+      p.w00 = (1 - su) * (1 - sv);
+      p.w01 = su * (1 - sv);
+      p.w10 = (1 - su) * sv;
+      p.w11 = su * sv;
+      return p;
+    }
+
+    template <typename Model, typename scalar>
+    __global__ void RectifyModelKernel(
+        const ModelRectify m, int width, int height, int channels,
+        const scalar* in, scalar* out )
+    {
+      const int c = blockIdx.x * blockDim.x + threadIdx.x;
+      const int r = blockIdx.y * blockDim.y + threadIdx.y;
+      if( c >= width || r >= height ) {
+        return;
+      }
+
+      const float x = c - m.x_offset;
+      const float y = r - m.y_offset;
+      float ray[3];
+      for( int k = 0; k < 3; ++k ) {
+        ray[k] = m.R_onKinv[3*k] * x + m.R_onKinv[3*k+1] * y + m.R_onKinv[3*k+2];
+      }
+      float pix[2];
+      Model::Project( ray, m.params, pix );
+
+      const int i = r * width + c;
+      Interpolate( DeviceLutPoint( pix[0], pix[1], m.cam_width, m.cam_height ),
+                   in, out + i * channels, channels );
+    }
+
+    /// Launch the model kernel if cam_from is a Model<double>.
+    template <template <typename> class Model, typename scalar>
+    bool LaunchModel(
+        const std::shared_ptr<CameraInterface<double>>& cam_from,
+        const ModelRectify& m, int width, int height, int channels,
+        const scalar* in, scalar* out, cudaStream_t stream )
+    {
+      if( !std::dynamic_pointer_cast<Model<double>>(cam_from) ) {
+        return false;
+      }
+      RectifyModelKernel<Model<float>, scalar>
+          <<<Grid( width, height ), kBlock, 0, stream>>>(
+              m, width, height, channels, in, out );
+      CudaCheck( cudaGetLastError() );
+      return true;
+    }
+
+    template <typename scalar>
+    void RectifyLut(
+        const CudaLookupTable& lut, const scalar* in, scalar* out,
+        int channels, cudaStream_t stream )
+    {
+      if( lut.Width() == 0 || lut.Height() == 0 ) {
+        return;
+      }
+      RectifyLutKernel<scalar>
+          <<<Grid( lut.Width(), lut.Height() ), kBlock, 0, stream>>>(
+              lut.DevicePoints(), lut.Width(), lut.Height(), channels, in, out );
+      CudaCheck( cudaGetLastError() );
+    }
+
+    template <typename scalar>
+    void RectifyModel(
+        const std::shared_ptr<CameraInterface<double>>& cam_from,
+        const Eigen::Matrix3d& R_onKinv,
+        const scalar* in, scalar* out,
+        int width, int height, int channels, cudaStream_t stream )
+    {
+      const Eigen::VectorXd& params = cam_from->GetParams();
+      CALIBU_ASSERT( params.size() <= kMaxModelParams );
+      if( width < 1 || height < 1 ) {
+        return;
+      }
+
+      ModelRectify m;
+      for( int k = 0; k < params.size(); ++k ) {
+        m.params[k] = (float) params[k];
+      }
+      for( int k = 0; k < 9; ++k ) {
+        m.R_onKinv[k] = (float) R_onKinv( k / 3, k % 3 );
+      }
+      m.cam_width = cam_from->Width();
+      m.cam_height = cam_from->Height();
+      m.x_offset = (width - m.cam_width) / 2.0f;
+      m.y_offset = (height - m.cam_height) / 2.0f;
+
+      const bool launched =
+          LaunchModel<FovCamera>( cam_from, m, width, height, channels, in, out, stream ) ||
+          LaunchModel<LinearCamera>( cam_from, m, width, height, channels, in, out, stream ) ||
+          LaunchModel<Poly2Camera>( cam_from, m, width, height, channels, in, out, stream ) ||
+          LaunchModel<Poly3Camera>( cam_from, m, width, height, channels, in, out, stream ) ||
+          LaunchModel<KannalaBrandtCamera>( cam_from, m, width, height, channels, in, out, stream ) ||
+          LaunchModel<Rational6Camera>( cam_from, m, width, height, channels, in, out, stream );
+      CALIBU_ASSERT_DESC( launched, "CudaRectify: unsupported camera model" );
+    }
+  }
+
+  ///////////////////////////////////////////////////////////////////////////////
+  CudaLookupTable::CudaLookupTable()
+    : m_pPoints(nullptr), m_nCapacity(0), m_nWidth(0), m_nHeight(0)
+  {
+  }
+
+  CudaLookupTable::CudaLookupTable( const LookupTable& lut )
+    : CudaLookupTable()
+  {
+    Set( lut );
+  }
+
+  CudaLookupTable::~CudaLookupTable()
+  {
+    // Never throw from the destructor
+    cudaFree( m_pPoints );
+  }
+
+  void CudaLookupTable::Set( const LookupTable& lut )
+  {
+    const size_t size = lut.m_vLutPixels.size();
+    if( size > m_nCapacity ) {
+      CudaCheck( cudaFree( m_pPoints ) );
+      m_pPoints = nullptr;
+      m_nCapacity = 0;
+      CudaCheck( cudaMalloc( (void**)&m_pPoints,
+                             size * sizeof(BilinearLutPoint) ) );
+      m_nCapacity = size;
+    }
+    if( size > 0 ) {
+      CudaCheck( cudaMemcpy( m_pPoints, lut.m_vLutPixels.data(),
+                             size * sizeof(BilinearLutPoint),
+                             cudaMemcpyHostToDevice ) );
+    }
+    m_nWidth = lut.Width();
+    m_nHeight = lut.Height();
+  }
+
+  ///////////////////////////////////////////////////////////////////////////////
+  void CudaRectify(
+      const CudaLookupTable& lut,
+      const unsigned char* pInputImageData,
+      unsigned char* pOutputRectImageData,
+      int channels,
+      cudaStream_t stream
+      )
+  {
+    RectifyLut( lut, pInputImageData, pOutputRectImageData, channels, stream );
+  }
+
+  void CudaRectify(
+      const CudaLookupTable& lut,
+      const float* pInputImageData,
+      float* pOutputRectImageData,
+      int channels,
+      cudaStream_t stream
+      )
+  {
+    RectifyLut( lut, pInputImageData, pOutputRectImageData, channels, stream );
+  }
+
+  void CudaRectify(
+      const std::shared_ptr<CameraInterface<double>>& cam_from,
+      const Eigen::Matrix3d& R_onKinv,
+      const unsigned char* pInputImageData,
+      unsigned char* pOutputRectImageData,
+      int out_width, int out_height,
+      int channels,
+      cudaStream_t stream
+      )
+  {
+    RectifyModel( cam_from, R_onKinv, pInputImageData, pOutputRectImageData,
+                  out_width, out_height, channels, stream );
+  }
+
+  void CudaRectify(
+      const std::shared_ptr<CameraInterface<double>>& cam_from,
+      const Eigen::Matrix3d& R_onKinv,
+      const float* pInputImageData,
+      float* pOutputRectImageData,
+      int out_width, int out_height,
+      int channels,
+      cudaStream_t stream
+      )
+  {
+    RectifyModel( cam_from, R_onKinv, pInputImageData, pOutputRectImageData,
+                  out_width, out_height, channels, stream );
+  }
+}
@@ -0,0 +1,350 @@
+/*
+  This file is part of the Calibu Project.
+  https://github.com/gwu-robotics/Calibu
+
+  Copyright (C) 2013 George Washington University,
+  Steven Lovegrove,
+  Gabe Sibley
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+  http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+ */
+
+#include <cmath>
+#include <cstring>
+
+#include <calibu/CpuFeatures.h>
+#include <calibu/cam/rectify_crtp.h>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64)
+#  define CALIBU_RECTIFY_X86
+#  include <emmintrin.h>
+#  if defined(__GNUC__)
+#    define CALIBU_RECTIFY_AVX2
+#    include <immintrin.h>
+#  endif
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#  define CALIBU_RECTIFY_NEON
+#  include <arm_neon.h>
+#endif
+
+namespace calibu
+{
+
+  namespace
+  {
+    // Sub-pixel resolution of the weights: with 7 bits per axis the four
+    // products of (1-su|su) * (1-sv|sv) sum to exactly 1 << kLutWeightBits.
+    const int kLutAxisBits = kLutWeightBits / 2;
+    const int kLutAxisOne = 1 << kLutAxisBits;
+    const uint32_t kLutRound = 1 << (kLutWeightBits - 1);
+
+    inline unsigned char RectifyPoint(
+        const FixedPointLutPoint& p,
+        const unsigned char* in )
+    {
+      const uint32_t top = (p.w0 & 0xFFFF) * in[p.idx0] +
+                           (p.w0 >> 16) * in[p.idx0 + 1];
+      const uint32_t bottom = (p.w1 & 0xFFFF) * in[p.idx1] +
+                              (p.w1 >> 16) * in[p.idx1 + 1];
+      return (unsigned char) ((top + bottom + kLutRound) >> kLutWeightBits);
+    }
+
+    void RectifyScalar(
+        const FixedPointLutPoint* lut,
+        const unsigned char* in,
+        unsigned char* out,
+        size_t count )
+    {
+      for( size_t i = 0; i < count; ++i ) {
+        out[i] = RectifyPoint( lut[i], in );
+      }
+    }
+
+#ifdef CALIBU_RECTIFY_X86
+    // Four pixels per iteration. SSE2 has no gather, so the source pixels
+    // are loaded with scalar reads and combined with one multiply-add per
+    // row pair.
+    void RectifySse2(
+        const FixedPointLutPoint* lut,
+        const unsigned char* in,
+        unsigned char* out,
+        size_t count )
+    {
+      const __m128i round = _mm_set1_epi32( kLutRound );
+      size_t i = 0;
+      for( ; i + 4 <= count; i += 4 ) {
+        const FixedPointLutPoint* p = lut + i;
+        const __m128i top = _mm_setr_epi32(
+            in[p[0].idx0] | (in[p[0].idx0 + 1] << 16),
+            in[p[1].idx0] | (in[p[1].idx0 + 1] << 16),
+            in[p[2].idx0] | (in[p[2].idx0 + 1] << 16),
+            in[p[3].idx0] | (in[p[3].idx0 + 1] << 16) );
+        const __m128i bottom = _mm_setr_epi32(
+            in[p[0].idx1] | (in[p[0].idx1 + 1] << 16),
+            in[p[1].idx1] | (in[p[1].idx1 + 1] << 16),
+            in[p[2].idx1] | (in[p[2].idx1 + 1] << 16),
+            in[p[3].idx1] | (in[p[3].idx1 + 1] << 16) );
+        const __m128i w0 = _mm_setr_epi32( p[0].w0, p[1].w0, p[2].w0, p[3].w0 );
+        const __m128i w1 = _mm_setr_epi32( p[0].w1, p[1].w1, p[2].w1, p[3].w1 );
+
+        __m128i sum = _mm_add_epi32( _mm_madd_epi16( top, w0 ),
+                                     _mm_madd_epi16( bottom, w1 ) );
+        sum = _mm_srli_epi32( _mm_add_epi32( sum, round ), kLutWeightBits );
+        sum = _mm_packs_epi32( sum, sum );
+        sum = _mm_packus_epi16( sum, sum );
+
+        const int packed = _mm_cvtsi128_si32( sum );
+        memcpy( out + i, &packed, 4 );
+      }
+      RectifyScalar( lut + i, in, out + i, count - i );
+    }
+#endif // CALIBU_RECTIFY_X86
+
+#ifdef CALIBU_RECTIFY_AVX2
+    // Eight pixels per iteration using hardware gathers. The bottom row pair
+    // is gathered two bytes early so that no read goes past idx1 + 1, which
+    // may be the last byte of the source image.
+    __attribute__((target("avx2")))
+    void RectifyAvx2(
+        const FixedPointLutPoint* lut,
+        const unsigned char* in,
+        unsigned char* out,
+        size_t count )
+    {
+      const __m256i round = _mm256_set1_epi32( kLutRound );
+      const __m256i two = _mm256_set1_epi32( 2 );
+      const __m256i top_mask = _mm256_setr_epi8(
+          0, -1, 1, -1, 4, -1, 5, -1, 8, -1, 9, -1, 12, -1, 13, -1,
+          0, -1, 1, -1, 4, -1, 5, -1, 8, -1, 9, -1, 12, -1, 13, -1 );
+      const __m256i bottom_mask = _mm256_setr_epi8(
+          2, -1, 3, -1, 6, -1, 7, -1, 10, -1, 11, -1, 14, -1, 15, -1,
+          2, -1, 3, -1, 6, -1, 7, -1, 10, -1, 11, -1, 14, -1, 15, -1 );
+      // The in-lane transpose below leaves points ordered 0 2 4 6 | 1 3 5 7.
+      const __m256i order = _mm256_setr_epi32( 0, 4, 1, 5, 2, 6, 3, 7 );
+      const int* pixels = reinterpret_cast<const int*>( in );
+
+      size_t i = 0;
+      for( ; i + 8 <= count; i += 8 ) {
+        const __m256i* p = reinterpret_cast<const __m256i*>( lut + i );
+        const __m256i a0 = _mm256_loadu_si256( p + 0 );
+        const __m256i a1 = _mm256_loadu_si256( p + 1 );
+        const __m256i a2 = _mm256_loadu_si256( p + 2 );
+        const __m256i a3 = _mm256_loadu_si256( p + 3 );
+
+        const __m256i t0 = _mm256_unpacklo_epi32( a0, a1 );
+        const __m256i t1 = _mm256_unpacklo_epi32( a2, a3 );
+        const __m256i t2 = _mm256_unpackhi_epi32( a0, a1 );
+        const __m256i t3 = _mm256_unpackhi_epi32( a2, a3 );
+        const __m256i idx0 = _mm256_unpacklo_epi64( t0, t1 );
+        const __m256i idx1 = _mm256_unpackhi_epi64( t0, t1 );
+        const __m256i w0 = _mm256_unpacklo_epi64( t2, t3 );
+        const __m256i w1 = _mm256_unpackhi_epi64( t2, t3 );
+
+        __m256i top = _mm256_i32gather_epi32( pixels, idx0, 1 );
+        __m256i bottom = _mm256_i32gather_epi32(
+            pixels, _mm256_sub_epi32( idx1, two ), 1 );
+        top = _mm256_shuffle_epi8( top, top_mask );
+        bottom = _mm256_shuffle_epi8( bottom, bottom_mask );
+
+        __m256i sum = _mm256_add_epi32( _mm256_madd_epi16( top, w0 ),
+                                        _mm256_madd_epi16( bottom, w1 ) );
+        sum = _mm256_srli_epi32( _mm256_add_epi32( sum, round ),
+                                 kLutWeightBits );
+        sum = _mm256_permutevar8x32_epi32( sum, order );
+        sum = _mm256_packus_epi32( sum, sum );
+        sum = _mm256_packus_epi16( sum, sum );
+
+        const int lo = _mm_cvtsi128_si32( _mm256_castsi256_si128( sum ) );
+        const int hi = _mm_cvtsi128_si32( _mm256_extracti128_si256( sum, 1 ) );
+        memcpy( out + i, &lo, 4 );
+        memcpy( out + i + 4, &hi, 4 );
+      }
+      RectifyScalar( lut + i, in, out + i, count - i );
+    }
+#endif // CALIBU_RECTIFY_AVX2
+
+#ifdef CALIBU_RECTIFY_NEON
+    // Eight pixels per iteration. vld4q deinterleaves the LUT fields; the
+    // source pixels are loaded with scalar reads.
+    void RectifyNeon(
+        const FixedPointLutPoint* lut,
+        const unsigned char* in,
+        unsigned char* out,
+        size_t count )
+    {
+      const uint32x4_t round = vdupq_n_u32( kLutRound );
+      const uint32x4_t low_mask = vdupq_n_u32( 0xFFFF );
+      uint16_t p00[8], p01[8], p10[8], p11[8];
+
+      size_t i = 0;
+      for( ; i + 8 <= count; i += 8 ) {
+        const FixedPointLutPoint* p = lut + i;
+        for( int k = 0; k < 8; ++k ) {
+          p00[k] = in[p[k].idx0];
+          p01[k] = in[p[k].idx0 + 1];
+          p10[k] = in[p[k].idx1];
+          p11[k] = in[p[k].idx1 + 1];
+        }
+
+        uint16x4_t result[2];
+        for( int half = 0; half < 2; ++half ) {
+          const uint32x4x4_t f =
+              vld4q_u32( reinterpret_cast<const uint32_t*>( p + 4 * half ) );
+          const uint16x4_t w00 = vmovn_u32( vandq_u32( f.val[2], low_mask ) );
+          const uint16x4_t w01 = vshrn_n_u32( f.val[2], 16 );
+          const uint16x4_t w10 = vmovn_u32( vandq_u32( f.val[3], low_mask ) );
+          const uint16x4_t w11 = vshrn_n_u32( f.val[3], 16 );
+
+          uint32x4_t sum = vmull_u16( vld1_u16( p00 + 4 * half ), w00 );
+          sum = vmlal_u16( sum, vld1_u16( p01 + 4 * half ), w01 );
+          sum = vmlal_u16( sum, vld1_u16( p10 + 4 * half ), w10 );
+          sum = vmlal_u16( sum, vld1_u16( p11 + 4 * half ), w11 );
+          result[half] = vshrn_n_u32( vaddq_u32( sum, round ), kLutWeightBits );
+        }
+        vst1_u8( out + i, vmovn_u16( vcombine_u16( result[0], result[1] ) ) );
+      }
+      RectifyScalar( lut + i, in, out + i, count - i );
+    }
+#endif // CALIBU_RECTIFY_NEON
+
+    typedef void (*RectifyRowFunction)( const FixedPointLutPoint*,
+                                        const unsigned char*,
+                                        unsigned char*,
+                                        size_t );
+
+    bool KernelSupported( RectifyKernel kernel )
+    {
+      switch( kernel ) {
+        case RECTIFY_KERNEL_SCALAR:
+          return true;
+#ifdef CALIBU_RECTIFY_X86
+        case RECTIFY_KERNEL_SSE2:
+          return CpuSupports( CPU_FEATURE_SSE2 );
+#endif
+#ifdef CALIBU_RECTIFY_AVX2
+        case RECTIFY_KERNEL_AVX2:
+          return CpuSupports( CPU_FEATURE_AVX2 );
+#endif
+#ifdef CALIBU_RECTIFY_NEON
+        case RECTIFY_KERNEL_NEON:
+          return true;
+#endif
+        default:
+          return false;
+      }
+    }
+
+    RectifyRowFunction KernelFunction( RectifyKernel kernel )
+    {
+      switch( kernel ) {
+#ifdef CALIBU_RECTIFY_X86
+        case RECTIFY_KERNEL_SSE2:
+          return RectifySse2;
+#endif
+#ifdef CALIBU_RECTIFY_AVX2
+        case RECTIFY_KERNEL_AVX2:
+          return RectifyAvx2;
+#endif
+#ifdef CALIBU_RECTIFY_NEON
+        case RECTIFY_KERNEL_NEON:
+          return RectifyNeon;
+#endif
+        default:
+          return RectifyScalar;
+      }
+    }
+  }
+
+  ///////////////////////////////////////////////////////////////////////////////
+  FixedPointLookupTable::FixedPointLookupTable( const LookupTable& lut )
+    : m_nWidth(0)
+  {
+    Set( lut );
+  }
+
+  ///////////////////////////////////////////////////////////////////////////////
+  void FixedPointLookupTable::Set( const LookupTable& lut )
+  {
+    m_nWidth = lut.m_nWidth;
+    m_vLutPixels.resize( lut.m_vLutPixels.size() );
+
+    for( size_t i = 0; i < lut.m_vLutPixels.size(); ++i ) {
+      const BilinearLutPoint& p = lut.m_vLutPixels[i];
+
+      // Recover the sub-pixel offsets and rebuild the weights from their
+      // quantized values so that they sum to exactly one.
+      const int su = (int) std::lround( (p.w01 + p.w11) * kLutAxisOne );
+      const int sv = (int) std::lround( (p.w10 + p.w11) * kLutAxisOne );
+      const uint32_t w00 = (kLutAxisOne - su) * (kLutAxisOne - sv);
+      const uint32_t w01 = su * (kLutAxisOne - sv);
+      const uint32_t w10 = (kLutAxisOne - su) * sv;
+      const uint32_t w11 = su * sv;
+
+      FixedPointLutPoint& q = m_vLutPixels[i];
+      q.idx0 = p.idx0;
+      q.idx1 = p.idx1;
+      q.w0 = w00 | (w01 << 16);
+      q.w1 = w10 | (w11 << 16);
+    }
+  }
+
+  ///////////////////////////////////////////////////////////////////////////////
+  RectifyKernel BestRectifyKernel()
+  {
+    static const RectifyKernel best = [](){
+      const RectifyKernel preferred[] = { RECTIFY_KERNEL_AVX2,
+                                          RECTIFY_KERNEL_NEON,
+                                          RECTIFY_KERNEL_SSE2 };
+      for( RectifyKernel kernel : preferred ) {
+        if( KernelSupported( kernel ) ) {
+          return kernel;
+        }
+      }
+      return RECTIFY_KERNEL_SCALAR;
+    }();
+    return best;
+  }
+
+  ///////////////////////////////////////////////////////////////////////////////
+  void Rectify(
+      const FixedPointLookupTable& lut,
+      const unsigned char* pInputImageData,
+      unsigned char* pOutputRectImageData,
+      int w,
+      int h,
+      RectifyKernel kernel,
+      unsigned int num_threads
+      )
+  {
+    // Make sure we have been given a correct lookup table.
+    assert(w == (int)lut.Width() && h == (int)lut.Height());
+
+    if( kernel == RECTIFY_KERNEL_AUTO ) {
+      kernel = BestRectifyKernel();
+    } else if( !KernelSupported( kernel ) ) {
+      kernel = RECTIFY_KERNEL_SCALAR;
+    }
+
+    const RectifyRowFunction function = KernelFunction( kernel );
+    const int width = lut.Width();
+    ParallelForBands( lut.Height(), num_threads,
+                      [&]( int row_begin, int row_end ) {
+      function( lut.m_vLutPixels.data() + row_begin * width, pInputImageData,
+                pOutputRectImageData + row_begin * width,
+                (size_t) (row_end - row_begin) * width );
+    } );
+  }
+
+} // end namespace
@@ -0,0 +1,177 @@
+/*
+   This file is part of the Calibu Project.
+   https://github.com/arpg/Calibu
+
+   Copyright (C) 2013 George Washington University,
+                      Steven Lovegrove,
+                      Gabe Sibley
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+   http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#include <calibu/cam/rectify_sparse.h>
+
+#include <cmath>
+#include <mutex>
+
+namespace calibu
+{
+
+  ///////////////////////////////////////////////////////////////////////////////
+  Eigen::Vector2f SparseLookupTable::Interpolate( int col, int row ) const
+  {
+    const int gr = std::min( row / m_nStep, m_nGridHeight - 2 );
+    const int gc = std::min( col / m_nStep, m_nGridWidth - 2 );
+    const float fr = (row - gr * m_nStep) / (float) m_nStep;
+    const float fc = (col - gc * m_nStep) / (float) m_nStep;
+    const Eigen::Vector2f top = (1 - fr) * GridPoint( gr, gc ) +
+                                     fr  * GridPoint( gr + 1, gc );
+    const Eigen::Vector2f bottom = (1 - fr) * GridPoint( gr, gc + 1 ) +
+                                        fr  * GridPoint( gr + 1, gc + 1 );
+    return (1 - fc) * top + fc * bottom;
+  }
+
+  ///////////////////////////////////////////////////////////////////////////////
+  void CreateSparseLookupTable(
+      const std::shared_ptr<calibu::CameraInterface<double>>& cam_from,
+      const Eigen::Matrix3d& R_onKinv,
+      int step,
+      SparseLookupTable& lut,
+      int lookup_width,
+      int lookup_height,
+      unsigned int num_threads
+      )
+  {
+    const int cam_width = cam_from->Width();
+    const int cam_height = cam_from->Height();
+
+    if( lookup_width < 1 || lookup_height < 1 ) {
+      lookup_width = cam_width;
+      lookup_height = cam_height;
+    }
+    step = std::max( 1, step );
+
+    // Same convention as CreateLookupTable for lookup tables larger or
+    // smaller than the camera image.
+    const double x_offset = (lookup_width - cam_width) / 2.0;
+    const double y_offset = (lookup_height - cam_height) / 2.0;
+
+    lut.m_nWidth = lookup_width;
+    lut.m_nHeight = lookup_height;
+    lut.m_nStep = step;
+    lut.m_nSrcWidth = cam_width;
+    lut.m_nSrcHeight = cam_height;
+    // At least two control points per axis so every pixel has a cell.
+    lut.m_nGridWidth = std::max( 2, (lookup_width - 1 + step - 1) / step + 1 );
+    lut.m_nGridHeight = std::max( 2, (lookup_height - 1 + step - 1) / step + 1 );
+    lut.m_vGrid.resize( lut.m_nGridWidth * lut.m_nGridHeight );
+
+    ParallelForBands( lut.m_nGridHeight, num_threads,
+                      [&]( int row_begin, int row_end ) {
+      Eigen::Matrix3Xd rays( 3, lut.m_nGridWidth );
+      Eigen::Matrix2Xd pix( 2, lut.m_nGridWidth );
+
+      for( int gr = row_begin; gr < row_end; ++gr ) {
+        for( int gc = 0; gc < lut.m_nGridWidth; ++gc ) {
+          rays.col(gc) = R_onKinv * Eigen::Vector3d( gc * step - x_offset,
+                                                     gr * step - y_offset, 1 );
+        }
+        cam_from->ProjectN( rays, pix );
+
+        for( int gc = 0; gc < lut.m_nGridWidth; ++gc ) {
+          lut.m_vGrid[gr * lut.m_nGridWidth + gc] = pix.col(gc).cast<float>();
+        }
+      }
+    } );
+  }
+
+  ///////////////////////////////////////////////////////////////////////////////
+  SparseLookupTableError ComputeSparseLookupTableError(
+      const std::shared_ptr<calibu::CameraInterface<double>>& cam_from,
+      const Eigen::Matrix3d& R_onKinv,
+      const SparseLookupTable& lut,
+      unsigned int num_threads
+      )
+  {
+    const double x_offset = (lut.m_nWidth - lut.m_nSrcWidth) / 2.0;
+    const double y_offset = (lut.m_nHeight - lut.m_nSrcHeight) / 2.0;
+    const Eigen::Vector2d max_pix( lut.m_nSrcWidth - 1, lut.m_nSrcHeight - 1 );
+
+    std::mutex mutex;
+    double max_error = 0;
+    double sum_squared_error = 0;
+
+    ParallelForBands( lut.m_nHeight, num_threads,
+                      [&]( int row_begin, int row_end ) {
+      Eigen::Matrix3Xd rays( 3, lut.m_nWidth );
+      Eigen::Matrix2Xd pix( 2, lut.m_nWidth );
+      double band_max = 0;
+      double band_sum = 0;
+
+      for( int r = row_begin; r < row_end; ++r ) {
+        for( int c = 0; c < lut.m_nWidth; ++c ) {
+          rays.col(c) = R_onKinv * Eigen::Vector3d( c - x_offset,
+                                                    r - y_offset, 1 );
+        }
+        cam_from->ProjectN( rays, pix );
+
+        for( int c = 0; c < lut.m_nWidth; ++c ) {
+          const Eigen::Vector2d exact =
+              pix.col(c).cwiseMax( 0.0 ).cwiseMin( max_pix );
+          const Eigen::Vector2d approx = lut.Interpolate( c, r )
+              .cast<double>().cwiseMax( 0.0 ).cwiseMin( max_pix );
+          const double error = (exact - approx).norm();
+          band_max = std::max( band_max, error );
+          band_sum += error * error;
+        }
+      }
+
+      std::lock_guard<std::mutex> lock( mutex );
+      max_error = std::max( max_error, band_max );
+      sum_squared_error += band_sum;
+    } );
+
+    SparseLookupTableError result;
+    result.max_error = max_error;
+    const double count = (double) lut.m_nWidth * lut.m_nHeight;
+    result.rms_error = count > 0 ? std::sqrt( sum_squared_error / count ) : 0;
+    return result;
+  }
+
+  ///////////////////////////////////////////////////////////////////////////////
+  int ChooseSparseLookupTableStep(
+      const std::shared_ptr<calibu::CameraInterface<double>>& cam_from,
+      const Eigen::Matrix3d& R_onKinv,
+      double max_error,
+      int max_step,
+      int lookup_width,
+      int lookup_height,
+      unsigned int num_threads
+      )
+  {
+    int best = 1;
+    for( int step = 2; step <= max_step; step *= 2 ) {
+      SparseLookupTable lut;
+      CreateSparseLookupTable( cam_from, R_onKinv, step, lut,
+                               lookup_width, lookup_height, num_threads );
+      const SparseLookupTableError error =
+          ComputeSparseLookupTableError( cam_from, R_onKinv, lut, num_threads );
+      if( error.max_error > max_error ) {
+        break;
+      }
+      best = step;
+    }
+    return best;
+  }
+
+}
@@ -20,6 +20,8 @@
  */
 
 #include <calibu/conics/Conic.h>
+#include <calibu/conics/ConicSet.h>
+#include <calibu/utils/Parallel.h>
 #include <calibu/utils/Utils.h>
 #include <Eigen/Dense>
 #include <calibu/cam/camera_crtp.h>
@@ -144,22 +146,48 @@ pair<Vector3d,Matrix3d > PlaneFromConics( const vector<Conic,
     return best;
 }
 
-Conic UnmapConic(const Conic& c, const std::shared_ptr<CameraInterface<double> > cam )
+namespace {
+
+// Homography H_ba with b = H_ba a of five point pairs, as EstimateH_ba but
+// on fixed size matrices and with both sets conditioned by the same
+// similarity, since they are close to each other.
+Matrix3d EstimateH_ba5( const Vector2d* a, const Vector2d* b )
 {
-    std::vector<Eigen::Vector2d , Eigen::aligned_allocator<Eigen::Vector2d> > d;
-    std::vector<Eigen::Vector2d , Eigen::aligned_allocator<Eigen::Vector2d> > u;
+    double extent = 0;
+    for( int i=1; i < 5; ++i ) {
+        extent = std::max(extent, (a[i] - a[0]).cwiseAbs().maxCoeff());
+    }
+    const double s = extent > 0 ? 1.0 / extent : 1.0;
+    Matrix3d T;
+    T << s, 0, -s * a[0][0],
+         0, s, -s * a[0][1],
+         0, 0, 1;
 
-    d.push_back(c.center);
-    d.push_back(Eigen::Vector2d(c.bbox.x1,c.bbox.y1));
-    d.push_back(Eigen::Vector2d(c.bbox.x1,c.bbox.y2));
-    d.push_back(Eigen::Vector2d(c.bbox.x2,c.bbox.y1));
-    d.push_back(Eigen::Vector2d(c.bbox.x2,c.bbox.y2));
+    Matrix<double,10,9> M;
+    for( int i=0; i < 5; ++i ) {
+        const double u1 = s * (a[i][0] - a[0][0]);
+        const double v1 = s * (a[i][1] - a[0][1]);
+        const double u2 = s * (b[i][0] - a[0][0]);
+        const double v2 = s * (b[i][1] - a[0][1]);
+        M.block<2,9>(i*2,0) <<
+                               u1, v1, 1, 0, 0, 0, -u1 * u2, -v1 * u2, -u2,
+                0, 0, 0, u1, v1, 1, -u1 * v2, -v1 * v2, -v2;
+    }
 
-    for( int i=0; i<5; ++i )
-        u.push_back( cam->Project(cam->Unproject(d[i])) );
+    const Matrix<double,9,1> h =
+            Eigen::JacobiSVD<Matrix<double,10,9> >(M, ComputeFullV).matrixV().col(8);
+    Matrix3d Hn;
+    Hn << h[0], h[1], h[2],
+          h[3], h[4], h[5],
+          h[6], h[7], h[8];
+    return T.inverse() * Hn * T;
+}
 
+// Conic c seen through the local distortion mapping d to u
+Conic UnmapConic( const Conic& c, const Vector2d* d, const Vector2d* u )
+{
     // Distortion locally estimated by homography
-    const Matrix3d H_du = EstimateH_ba(u,d);
+    const Matrix3d H_du = EstimateH_ba5(u,d);
 
     Conic ret;
     //  ret.bbox = c.bbox;
@@ -169,4 +197,100 @@ Conic UnmapConic(const Conic& c, const std::shared_ptr<CameraInterface<double> >
     return ret;
 }
 
+// Centre and bounding box corners of a conic
+void ConicSamples( const Vector2d& center, const IRectangle& bbox, Vector2d* d )
+{
+    d[0] = center;
+    d[1] = Eigen::Vector2d(bbox.x1,bbox.y1);
+    d[2] = Eigen::Vector2d(bbox.x1,bbox.y2);
+    d[3] = Eigen::Vector2d(bbox.x2,bbox.y1);
+    d[4] = Eigen::Vector2d(bbox.x2,bbox.y2);
+}
+
+void ConicSamples( const Conic& c, Vector2d* d )
+{
+    ConicSamples(c.center, c.bbox, d);
+}
+
+}
+
+Conic UnmapConic(const Conic& c, const std::shared_ptr<CameraInterface<double> > cam )
+{
+    Vector2d d[5];
+    Vector2d u[5];
+    ConicSamples(c, d);
+    for( int i=0; i<5; ++i )
+        u[i] = cam->Project(cam->Unproject(d[i]));
+    return UnmapConic(c, d, u);
+}
+
+void UnmapConics(
+        const std::vector<Conic, Eigen::aligned_allocator<Conic> >& conics,
+        const std::shared_ptr<CameraInterface<double> > cam,
+        std::vector<Conic, Eigen::aligned_allocator<Conic> >& unmapped,
+        unsigned int num_threads )
+{
+    unmapped.resize(conics.size());
+    ParallelForBands( conics.size(), num_threads, [&](int begin, int end) {
+        // Samples of all conics in the band through the batch camera API
+        const int n = end - begin;
+        Matrix2Xd pix(2, 5*n);
+        Vector2d d[5];
+        for( int i=0; i < n; ++i ) {
+            ConicSamples(conics[begin + i], d);
+            for( int k=0; k < 5; ++k ) pix.col(5*i + k) = d[k];
+        }
+        Matrix3Xd rays;
+        cam->UnprojectN(pix, rays);
+        Matrix2Xd pix_u;
+        cam->ProjectN(rays, pix_u);
+
+        Vector2d u[5];
+        for( int i=0; i < n; ++i ) {
+            for( int k=0; k < 5; ++k ) {
+                d[k] = pix.col(5*i + k);
+                u[k] = pix_u.col(5*i + k);
+            }
+            unmapped[begin + i] = UnmapConic(conics[begin + i], d, u);
+        }
+    });
+}
+
+void UnmapConics(
+        const ConicSet& conics,
+        const std::shared_ptr<CameraInterface<double> > cam,
+        ConicSet& unmapped,
+        unsigned int num_threads )
+{
+    unmapped.resize(conics.size());
+    ParallelForBands( conics.size(), num_threads, [&](int begin, int end) {
+        const int n = end - begin;
+        Matrix2Xd pix(2, 5*n);
+        Vector2d d[5];
+        for( int i=0; i < n; ++i ) {
+            ConicSamples(conics.Center(begin + i), conics.BBox(begin + i), d);
+            for( int k=0; k < 5; ++k ) pix.col(5*i + k) = d[k];
+        }
+        Matrix3Xd rays;
+        cam->UnprojectN(pix, rays);
+        Matrix2Xd pix_u;
+        cam->ProjectN(rays, pix_u);
+
+        Vector2d u[5];
+        for( int i=0; i < n; ++i ) {
+            const size_t j = begin + i;
+            for( int k=0; k < 5; ++k ) {
+                d[k] = pix.col(5*i + k);
+                u[k] = pix_u.col(5*i + k);
+            }
+            const Matrix3d H_du = EstimateH_ba5(u,d);
+            unmapped.SetC(j, H_du.transpose() * conics.C(j) * H_du);
+            unmapped.Center(j) = u[0];
+            unmapped.CenterUndistorted(j) = conics.CenterUndistorted(j);
+            unmapped.Radius(j) = conics.Radius(j);
+            unmapped.BBox(j) = conics.BBox(j);
+        }
+    });
+}
+
 }
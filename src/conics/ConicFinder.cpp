@@ -22,7 +22,9 @@
 
 #include <calibu/conics/ConicFinder.h>
 #include <calibu/conics/FindConics.h>
+#include <calibu/image/Gradient.h>
 #include <calibu/image/ImageProcessing.h>
+#include <calibu/utils/PipelineStats.h>
 
 #include <opencv2/features2d/features2d.hpp>
 
@@ -30,68 +32,243 @@
 
 namespace calibu {
 
+namespace {
+
+cv::SimpleBlobDetector::Params ToBlobParams(const ParamsConicFinder& p)
+{
+    cv::SimpleBlobDetector::Params params;
+    params.filterByConvexity = p.blob_filter_by_convexity;
+    params.filterByInertia = p.blob_filter_by_inertia;
+    params.minArea = p.blob_min_area;
+    params.minConvexity = p.blob_min_convexity;
+    params.maxThreshold = p.blob_max_threshold;
+    params.minDistBetweenBlobs = p.blob_min_dist_between_blobs;
+    params.minThreshold = p.blob_min_threshold;
+    params.thresholdStep = p.blob_threshold_step;
+    return params;
+}
+
+bool SameBlobParams(const ParamsConicFinder& a, const ParamsConicFinder& b)
+{
+    return a.blob_min_threshold == b.blob_min_threshold &&
+           a.blob_max_threshold == b.blob_max_threshold &&
+           a.blob_threshold_step == b.blob_threshold_step &&
+           a.blob_min_dist_between_blobs == b.blob_min_dist_between_blobs &&
+           a.blob_min_area == b.blob_min_area &&
+           a.blob_filter_by_convexity == b.blob_filter_by_convexity &&
+           a.blob_min_convexity == b.blob_min_convexity &&
+           a.blob_filter_by_inertia == b.blob_filter_by_inertia;
+}
+
+// Map conic found at a pyramid level of the given scale to the input image,
+// x_level = S x_image
+void ConicToInput(int scale, Conic& conic)
+{
+    const double s = 1.0 / scale;
+    Eigen::Matrix3d S = Eigen::Matrix3d::Identity();
+    S(0,0) = S(1,1) = s;
+    S(0,2) = S(1,2) = 0.5 * s - 0.5;
+    const Eigen::Matrix3d Sinv = S.inverse();
+
+    conic.C = S.transpose() * conic.C * S;
+    conic.Dual = Sinv * conic.Dual * Sinv.transpose();
+    conic.Dual /= conic.Dual(2,2);
+    conic.center = Eigen::Vector2d(conic.Dual(0,2), conic.Dual(1,2));
+    conic.radius *= scale;
+    conic.bbox.x1 *= scale;
+    conic.bbox.y1 *= scale;
+    conic.bbox.x2 = conic.bbox.x2 * scale + scale - 1;
+    conic.bbox.y2 = conic.bbox.y2 * scale + scale - 1;
+}
+
+}
+
+struct ConicFinder::BlobDetector {
+    ParamsConicFinder params;
+    cv::Ptr<cv::SimpleBlobDetector> detector;
+};
+
 ConicFinder::ConicFinder()
 {
 }
 
+ConicFinder::~ConicFinder()
+{
+}
+
 void ConicFinder::Find(const ImageProcessing& imgs, const std::shared_ptr<calibu::CameraInterface<double>> camera)
 {
+    CALIBU_PIPELINE_TIMER(timer, STAGE_CONICS);
     candidates.clear();
     conics.clear();
 
-    // Find candidate regions for conics
-    /*FindCandidateConicsFromLabels(
-                imgs.Width(), imgs.Height(), imgs.Labels(), candidates,
-                params.conic_min_area, params.conic_max_area,
-                params.conic_min_density,
-                params.conic_min_aspect
-                );*/
-
-    // Find conic parameters
-    //FindConics(imgs.Width(), imgs.Height(), candidates, imgs.ImgDeriv(), conics );
-
-    cv::SimpleBlobDetector::Params params;
+    if (imgs.HasMoments()) {
+        FindFromMoments(imgs);
+    } else if (params.method == CONIC_FINDER_LABELS) {
+        FindFromLabels(imgs);
+    } else {
+        FindBlobs(imgs);
+    }
+    CALIBU_PIPELINE_COUNT(COUNTER_CONICS, conics.size());
 
-    params.filterByConvexity = true;
-    params.filterByInertia = false;
-    params.minArea = 3.7;
-    params.minConvexity = 0.89375;
-    params.maxThreshold = 90;
-    params.minDistBetweenBlobs = 2.5;
-    params.minThreshold = 0;
-    params.thresholdStep = 45;
+    if (camera != nullptr && !conics.empty())
+    {
+        // Unproject all centres in one batch
+        const Eigen::Map<const Eigen::Matrix2Xd> centers(
+                    conics.CentersData()[0].data(), 2, conics.size());
+        Eigen::Matrix3Xd rays;
+        camera->UnprojectN(centers, rays);
+        for (size_t i = 0; i < conics.size(); ++i) {
+            conics.CenterUndistorted(i) = rays.col(i);
+        }
+    }
+}
 
-    auto detector = cv::SimpleBlobDetector::create(params);
+void ConicFinder::FindBlobs(const ImageProcessing& imgs)
+{
+    if (!blob_detector || !SameBlobParams(blob_detector->params, params)) {
+        blob_detector.reset(new BlobDetector);
+        blob_detector->params = params;
+        blob_detector->detector =
+                cv::SimpleBlobDetector::create(ToBlobParams(params));
+    }
 
     const cv::Mat im(imgs.Height(), imgs.Width(), cv::DataType<unsigned char>::type, const_cast<unsigned char *>(imgs.ImgThresh()));
 
+    // Only search the region the images were processed in
+    const IRectangle& roi = imgs.Roi();
     std::vector<cv::KeyPoint> keypoints;
-    detector->detect(im, keypoints);
+    blob_detector->detector->detect(
+                im(cv::Rect(roi.x1, roi.y1, roi.Width(), roi.Height())),
+                keypoints);
 
+    const int scale = imgs.Scale();
     for (auto & keypoint : keypoints)
     {
+        keypoint.pt += cv::Point2f(roi.x1, roi.y1);
 
-        unsigned char intensity = im.at<unsigned char>(keypoint.pt);
-
-        //LOG(INFO) << "intensity: " << intensity;
+        // Blobs found at a pyramid level are mapped to the input image
+        const cv::Point2f pt = (keypoint.pt + cv::Point2f(0.5f, 0.5f)) * scale -
+                               cv::Point2f(0.5f, 0.5f);
+        const float size = keypoint.size * scale;
 
         Conic conic;
-        conic.center = Eigen::Vector2d(keypoint.pt.x, keypoint.pt.y);
-        conic.radius = keypoint.size/2;
-        conic.bbox.x1 = keypoint.pt.x - keypoint.size/2;
-        conic.bbox.y1 = keypoint.pt.y - keypoint.size/2;
-        conic.bbox.x2 = keypoint.pt.x + keypoint.size/2 + 1;
-        conic.bbox.y2 = keypoint.pt.y + keypoint.size/2 + 1;
+        conic.center = Eigen::Vector2d(pt.x, pt.y);
+        conic.radius = size/2;
+        conic.bbox.x1 = pt.x - size/2;
+        conic.bbox.y1 = pt.y - size/2;
+        conic.bbox.x2 = pt.x + size/2 + 1;
+        conic.bbox.y2 = pt.y + size/2 + 1;
+        conic.C << 1, 0, -pt.x,
+                   0, 1, -pt.y,
+                   -pt.x, -pt.y, pt.x*pt.x + pt.y*pt.y - conic.radius*conic.radius;
+        conic.center_undistorted = conic.center.homogeneous();
+        if (scale > 1) {
+            RefineConic(imgs, conic);
+        }
         conics.push_back(conic);
     }
+}
+
+void ConicFinder::FindFromLabels(const ImageProcessing& imgs)
+{
+    // Find candidate regions for conics
+    FindCandidateConicsFromLabels(
+                imgs.Width(), imgs.Height(), imgs.Labels(), candidates,
+                params.conic_min_area, params.conic_max_area,
+                params.conic_min_density,
+                params.conic_min_aspect
+                );
+
+    // Find conic parameters
+    FindConics(imgs.Width(), imgs.Height(), candidates, imgs.ImgDerivX(), imgs.ImgDerivY(), fitted,
+               params.num_threads );
 
+    const int scale = imgs.Scale();
+    conics.reserve(fitted.size());
+    for (auto & conic : fitted)
+    {
+        conic.center_undistorted = conic.center.homogeneous();
+        conic.radius = (conic.bbox.Width() + conic.bbox.Height()) / 4.0;
+        if (scale > 1) {
+            ConicToInput(scale, conic);
+            RefineConic(imgs, conic);
+        }
+        conics.push_back(conic);
+    }
+}
 
-    if (camera != nullptr)
+void ConicFinder::FindFromMoments(const ImageProcessing& imgs)
+{
+    // The conic of a component's moments is only as good as its
+    // thresholding, so each is refined on the input image's gradient
+    const std::vector<PixelClass>& labels = imgs.Labels();
+    const std::vector<BlobMoments>& moments = imgs.Moments();
+    const int scale = imgs.Scale();
+    for (size_t i = 0; i < labels.size(); ++i)
     {
-        for (auto & cone : conics) {
-            cone.center_undistorted = camera->Unproject(cone.center);
+        Conic conic;
+        if (!IsCandidateConic(imgs.Width(), imgs.Height(), labels[i],
+                              params.conic_min_area, params.conic_max_area,
+                              params.conic_min_aspect) ||
+            !ConicFromMoments(moments[i], labels[i].bbox, conic)) {
+            continue;
         }
+        candidates.push_back(labels[i]);
+        if (scale > 1) {
+            ConicToInput(scale, conic);
+        }
+        RefineConic(imgs, conic);
+        conic.center_undistorted = conic.center.homogeneous();
+        conics.push_back(conic);
+    }
+}
+
+bool ConicFinder::RefineConic(const ImageProcessing& imgs, Conic& conic)
+{
+    // Fit ellipse to the full resolution gradient of a window around the
+    // coarse estimate
+    const int margin = imgs.Scale() + params.refine_margin;
+    const IRectangle window = conic.bbox.Grow(margin).Clamp(
+                0, 0, imgs.InputWidth() - 1, imgs.InputHeight() - 1);
+    const int ww = window.Width();
+    const int wh = window.Height();
+    if (ww < 5 || wh < 5) {
+        return false;
+    }
+
+    window_dx.resize(ww * wh);
+    window_dy.resize(ww * wh);
+    GradientPlanar(ww, wh, imgs.InputPitch(),
+                   imgs.Input() + window.y1 * imgs.InputPitch() + window.x1,
+                   &window_dx[0], &window_dy[0]);
+
+    double residual = 0;
+    const Eigen::Matrix3d C = FindEllipse(ww, wh, &window_dx[0], &window_dy[0],
+                                          IRectangle(1, 1, ww - 2, wh - 2),
+                                          residual);
+    Eigen::Matrix3d Dual = C.inverse();
+    Dual /= Dual(2,2);
+
+    // Reject fits that moved further than the coarse radius
+    const Eigen::Vector2d offset(window.x1, window.y1);
+    const Eigen::Vector2d center = Eigen::Vector2d(Dual(0,2), Dual(1,2)) + offset;
+    if (!Dual.allFinite() ||
+        (center - conic.center).norm() > std::max(1.0, conic.radius)) {
+        return false;
     }
+
+    // Move conic from window to image coordinates, x_window = H x_image
+    Eigen::Matrix3d H = Eigen::Matrix3d::Identity();
+    H.topRightCorner<2,1>() = -offset;
+    Eigen::Matrix3d Hinv = Eigen::Matrix3d::Identity();
+    Hinv.topRightCorner<2,1>() = offset;
+
+    conic.C = H.transpose() * C * H;
+    conic.Dual = Hinv * Dual * Hinv.transpose();
+    conic.Dual /= conic.Dual(2,2);
+    conic.center = center;
+    return true;
 }
 
 }
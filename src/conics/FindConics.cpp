@@ -19,73 +19,239 @@
  */
 
 #include <calibu/conics/FindConics.h>
+#include <calibu/utils/Parallel.h>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#  define CALIBU_CONICS_SSE2
+#  include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#  define CALIBU_CONICS_NEON
+#  include <arm_neon.h>
+#endif
 
 namespace calibu
 {
 
 ////////////////////////////////////////////////////////////////////////////
 
+namespace {
+
+// Gradient accessor for an interleaved image of gradient vectors.
 template<typename TdI>
-Eigen::Matrix3d FindEllipse(
-        const int w, const int /*h*/,
-        const TdI* dI,
-        const IRectangle& r,
-        double& /*residual*/
+struct InterleavedGradient {
+    Eigen::Vector2d operator()(int u, int v) const {
+        const TdI& d = dI[v*w + u];
+        return Eigen::Vector2d(d[0], d[1]);
+    }
+    int w;
+    const TdI* dI;
+};
+
+// Gradient accessor for planar dx / dy images, as written by GradientPlanar.
+struct PlanarGradient {
+    Eigen::Vector2d operator()(int u, int v) const {
+        return Eigen::Vector2d(dx[v*w + u], dy[v*w + u]);
+    }
+    int w;
+    const int16_t* dx;
+    const int16_t* dy;
+};
+
+// Candidates below which an extra FindConics thread isn't worth starting
+const size_t kMinCandidatesPerThread = 16;
+
+// LDLT solutions of the normal equations are used above this reciprocal
+// condition number, and SVD otherwise.
+const double kMinRcond = 1E-10;
+
+// Number of unique entries of the symmetric 5x5 normal matrix
+const int kNormalEntries = 15;
+
+// Gradient of one row of a region, gathered into contiguous floats.
+struct RowGradient {
+    std::vector<float> dx;
+    std::vector<float> dy;
+};
+
+// Add the normal equations of pixel (x, y) with gradient (dx, dy) to A
+// (upper triangle, row major) and b:
+// li = (a,b,c)' = (dx, dy, -dI' x_i)', Ki = (a^2, ab, b^2, ac, bc)',
+// A += Ki Ki', b -= Ki c^2.
+inline void AccumulatePixel(
+        float dx, float dy, float x, float y, float* A, float* b
         ) {
-    //Precise ellipse estimation without contour point extraction
-    //Jean-Nicolas Ouellet, Patrick Hebert
+    const float c = -(dx * x + dy * y);
+    const float k[5] = { dx*dx, dx*dy, dy*dy, dx*c, dy*c };
+    const float cc = c * c;
+    int n = 0;
+    for( int i=0; i<5; ++i ) {
+        for( int j=i; j<5; ++j ) {
+            A[n++] += k[i] * k[j];
+        }
+        b[i] -= k[i] * cc;
+    }
+}
 
-    // This normalisation is in the wrong space.
-    // We'd be better off normalising image values to [0,1] range.
+// Add the normal equations of pixels (x0 + i, y), i in [0, n). The sums of
+// a row are formed in single precision, several pixels at a time, and then
+// added to the double precision sums of the region.
+void AccumulateRow(
+        const float* dx, const float* dy, int n, float x0, float y,
+        double* A, double* b
+        ) {
+    float As[kNormalEntries] = { 0 };
+    float bs[5] = { 0 };
+
+    int i = 0;
+#if defined(CALIBU_CONICS_SSE2)
+    __m128 vA[kNormalEntries];
+    __m128 vb[5];
+    for( int k=0; k<kNormalEntries; ++k ) vA[k] = _mm_setzero_ps();
+    for( int k=0; k<5; ++k ) vb[k] = _mm_setzero_ps();
+
+    const __m128 vy = _mm_set1_ps(y);
+    __m128 vx = _mm_setr_ps(x0, x0 + 1, x0 + 2, x0 + 3);
+    const __m128 four = _mm_set1_ps(4.0f);
+    for( ; i + 4 <= n; i += 4, vx = _mm_add_ps(vx, four) ) {
+        const __m128 a = _mm_loadu_ps(dx + i);
+        const __m128 bb = _mm_loadu_ps(dy + i);
+        const __m128 c = _mm_sub_ps(_mm_setzero_ps(),
+                _mm_add_ps(_mm_mul_ps(a, vx), _mm_mul_ps(bb, vy)));
+        const __m128 k[5] = {
+            _mm_mul_ps(a, a), _mm_mul_ps(a, bb), _mm_mul_ps(bb, bb),
+            _mm_mul_ps(a, c), _mm_mul_ps(bb, c)
+        };
+        const __m128 cc = _mm_mul_ps(c, c);
+        int e = 0;
+        for( int p=0; p<5; ++p ) {
+            for( int q=p; q<5; ++q, ++e ) {
+                vA[e] = _mm_add_ps(vA[e], _mm_mul_ps(k[p], k[q]));
+            }
+            vb[p] = _mm_sub_ps(vb[p], _mm_mul_ps(k[p], cc));
+        }
+    }
 
-//    const Eigen::Vector2d c = Eigen::Vector2d(
-//                r.x1 + (r.x2-r.x1) / 2.0,
-//                r.y1 + (r.y2-r.y1) / 2.0
-//                );
+    float lanes[4];
+    for( int k=0; k<kNormalEntries; ++k ) {
+        _mm_storeu_ps(lanes, vA[k]);
+        As[k] = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+    }
+    for( int k=0; k<5; ++k ) {
+        _mm_storeu_ps(lanes, vb[k]);
+        bs[k] = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+    }
+#elif defined(CALIBU_CONICS_NEON)
+    float32x4_t vA[kNormalEntries];
+    float32x4_t vb[5];
+    for( int k=0; k<kNormalEntries; ++k ) vA[k] = vdupq_n_f32(0.0f);
+    for( int k=0; k<5; ++k ) vb[k] = vdupq_n_f32(0.0f);
+
+    const float32x4_t vy = vdupq_n_f32(y);
+    const float offsets[4] = { 0, 1, 2, 3 };
+    float32x4_t vx = vaddq_f32(vdupq_n_f32(x0), vld1q_f32(offsets));
+    const float32x4_t four = vdupq_n_f32(4.0f);
+    for( ; i + 4 <= n; i += 4, vx = vaddq_f32(vx, four) ) {
+        const float32x4_t a = vld1q_f32(dx + i);
+        const float32x4_t bb = vld1q_f32(dy + i);
+        const float32x4_t c = vnegq_f32(
+                vaddq_f32(vmulq_f32(a, vx), vmulq_f32(bb, vy)));
+        const float32x4_t k[5] = {
+            vmulq_f32(a, a), vmulq_f32(a, bb), vmulq_f32(bb, bb),
+            vmulq_f32(a, c), vmulq_f32(bb, c)
+        };
+        const float32x4_t cc = vmulq_f32(c, c);
+        int e = 0;
+        for( int p=0; p<5; ++p ) {
+            for( int q=p; q<5; ++q, ++e ) {
+                vA[e] = vaddq_f32(vA[e], vmulq_f32(k[p], k[q]));
+            }
+            vb[p] = vsubq_f32(vb[p], vmulq_f32(k[p], cc));
+        }
+    }
 
-//    const Eigen::Vector2d f = Eigen::Vector2d(
-//                2.0 / r.Width(), 2.0 / r.Height()
-//                );
+    float lanes[4];
+    for( int k=0; k<kNormalEntries; ++k ) {
+        vst1q_f32(lanes, vA[k]);
+        As[k] = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+    }
+    for( int k=0; k<5; ++k ) {
+        vst1q_f32(lanes, vb[k]);
+        bs[k] = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+    }
+#endif
 
-//    // Transform to approximately unit circle at origin
-//    Eigen::Matrix3d H;
-//    H <<
-//         f(0), 0, c(0),
-//            0, f(1), c(1),
-//            0, 0, 1;
+    for( ; i<n; ++i ) {
+        AccumulatePixel(dx[i], dy[i], x0 + i, y, As, bs);
+    }
 
-//    Eigen::Matrix3d Hinv;
-//    Hinv <<
-//            1/f(0), 0, -c(0)/f(0),
-//            0, 1/f(1), -c(1)/f(1),
-//            0, 0, 1;
+    for( int k=0; k<kNormalEntries; ++k ) A[k] += As[k];
+    for( int k=0; k<5; ++k ) b[k] += bs[k];
+}
 
+// Solve the symmetric positive semi-definite system A x = b with LDLT on
+// the Jacobi scaled system, falling back to SVD if it is ill-conditioned.
+Eigen::Matrix<double,5,1> SolveNormalEquations(
+        const Eigen::Matrix<double,5,5>& A,
+        const Eigen::Matrix<double,5,1>& b
+        ) {
+    const Eigen::Matrix<double,5,1> d = A.diagonal();
+    if( (d.array() > 0.0).all() ) {
+        const Eigen::Matrix<double,5,1> s = d.cwiseSqrt().cwiseInverse();
+        const Eigen::Matrix<double,5,5> As =
+                s.asDiagonal() * A * s.asDiagonal();
+        const Eigen::LDLT<Eigen::Matrix<double,5,5> > ldlt(As);
+        if( ldlt.info() == Eigen::Success && ldlt.isPositive() &&
+            ldlt.rcond() > kMinRcond ) {
+            return s.asDiagonal() * ldlt.solve(s.cwiseProduct(b));
+        }
+    }
+    return A.jacobiSvd(Eigen::ComputeFullU | Eigen::ComputeFullV).solve(b);
+}
+
+template<typename Gradient>
+Eigen::Matrix3d FitEllipse(
+        const Gradient& grad,
+        const IRectangle& r,
+        RowGradient& row
+        ) {
+    //Precise ellipse estimation without contour point extraction
+    //Jean-Nicolas Ouellet, Patrick Hebert
+
+    // Pixel coordinates are taken relative to the centre of the region,
+    // which keeps the single precision row sums well conditioned. The fit
+    // is invariant to this translation.
+    const Eigen::Vector2d c = r.Center();
 
     // Form system Ax = b to solve
-    Eigen::Matrix<double,5,5> A = Eigen::Matrix<double,5,5>::Zero();
-    Eigen::Matrix<double,5,1> b = Eigen::Matrix<double,5,1>::Zero();
+    double As[kNormalEntries] = { 0 };
+    double bs[5] = { 0 };
 
-//    float elementCount = 0;
+    const int n = r.x2 - r.x1 + 1;
+    row.dx.resize(std::max(n, 0));
+    row.dy.resize(std::max(n, 0));
     for( int v=r.y1; v<=r.y2; ++v )
     {
-        const TdI* dIv = dI + v*w;
         for( int u=r.x1; u<=r.x2; ++u )
         {
-            // li = (ai,bi,ci)' = (I_ui,I_vi, -dI' x_i)'
-            const Eigen::Vector3d d =
-                    Eigen::Vector3d(dIv[u][0],dIv[u][1],-(dIv[u][0] * u + dIv[u][1] * v) );
-//            const Eigen::Vector3d li = //H.T() * d;
-//                    Eigen::Vector3d( d[0]*H(0,0), d[1]*H(1,1), d[0]*H(0,2) + d[1] * H(1,2) + d[2] );
-            const Eigen::Vector3d li = d;
-            Eigen::Matrix<double,5,1> Ki;
-            Ki << li[0]*li[0], li[0]*li[1], li[1]*li[1], li[0]*li[2], li[1]*li[2];
-            A += Ki*Ki.transpose();
-            b += -Ki*li[2]*li[2];
-//            elementCount++;
+            const Eigen::Vector2d dIuv = grad(u,v);
+            row.dx[u - r.x1] = (float)dIuv[0];
+            row.dy[u - r.x1] = (float)dIuv[1];
         }
+        AccumulateRow(row.dx.data(), row.dy.data(), n,
+                      (float)(r.x1 - c[0]), (float)(v - c[1]), As, bs);
     }
 
-    const Eigen::Matrix<double,5,1> x = A.jacobiSvd(Eigen::ComputeFullU | Eigen::ComputeFullV).solve(b);
+    Eigen::Matrix<double,5,5> A;
+    Eigen::Matrix<double,5,1> b;
+    int e = 0;
+    for( int i=0; i<5; ++i ) {
+        for( int j=i; j<5; ++j, ++e ) {
+            A(i,j) = A(j,i) = As[e];
+        }
+        b[i] = bs[i];
+    }
+
+    const Eigen::Matrix<double,5,1> x = SolveNormalEquations(A, b);
 
     //  //compute the risidual on the system to see if the algebraic error is too large.
     //  //note: maybe there is a better error metric.
@@ -96,86 +262,187 @@ Eigen::Matrix3d FindEllipse(
     Eigen::Matrix3d C_star_norm;
     C_star_norm << x[0],x[1]/2.0,x[3]/2.0,  x[1]/2.0,x[2],x[4]/2.0,  x[3]/2.0,x[4]/2.0,1.0;
 
-//    const Eigen::Matrix3d C = Hinv.transpose() * C_star_norm.inverse() * Hinv;
-    const Eigen::Matrix3d C = C_star_norm.inverse();
+    // Move dual conic from region to image coordinates, x_region = H x
+    Eigen::Matrix3d Hinv = Eigen::Matrix3d::Identity();
+    Hinv.topRightCorner<2,1>() = c;
+    const Eigen::Matrix3d C_star = Hinv * C_star_norm * Hinv.transpose();
+
+    const Eigen::Matrix3d C = C_star.inverse();
     //  const Matrix3d C_star = LU<3>(C).get_inverse();
     //  return C_star/C_star[2][2];
 
     return C; //C/C(2,2);
 }
 
+template<typename Gradient>
+void FitConics(
+        const Gradient& grad,
+        const std::vector<PixelClass>& candidates,
+        unsigned int num_threads,
+        std::vector<Conic, Eigen::aligned_allocator<Conic> >& conics
+        ) {
+    typedef std::vector<Conic, Eigen::aligned_allocator<Conic> > Conics;
+
+    // Each band of candidates is fit into its own vector, and the bands are
+    // appended in order so that the result doesn't depend on num_threads.
+    const int bands = (int)std::max<size_t>(1, std::min<size_t>(
+                NumWorkerThreads(num_threads),
+                candidates.size() / kMinCandidatesPerThread));
+    std::vector<Conics> band_conics(bands);
+
+    ParallelForBands(bands, bands, [&](int band_begin, int band_end) {
+        RowGradient row;
+        for( int band=band_begin; band<band_end; ++band )
+        {
+            const size_t begin = candidates.size() * band / bands;
+            const size_t end = candidates.size() * (band + 1) / bands;
+            for( size_t i=begin; i<end; ++i )
+            {
+                const IRectangle region = candidates[i].bbox;
+
+                Conic conic;
+                conic.C = FitEllipse(grad, region, row);
+
+                conic.bbox = region;
+                conic.Dual = conic.C.inverse();
+                conic.Dual /= conic.Dual(2,2);
+                conic.center = Eigen::Vector2d(conic.Dual(0,2),conic.Dual(1,2));
+
+                const double max_dist = (region.Width() + region.Height()) / 8.0;
+                if( (conic.center - region.Center()).norm() < max_dist)
+                    band_conics[band].push_back( conic );
+            }
+        }
+    });
+
+    for( const Conics& band : band_conics ) {
+        conics.insert(conics.end(), band.begin(), band.end());
+    }
+}
+
+}
+
+////////////////////////////////////////////////////////////////////////////
+
+template<typename TdI>
+Eigen::Matrix3d FindEllipse(
+        const int w, const int /*h*/,
+        const TdI* dI,
+        const IRectangle& r,
+        double& /*residual*/
+        ) {
+    RowGradient row;
+    return FitEllipse(InterleavedGradient<TdI>{w, dI}, r, row);
+}
+
+Eigen::Matrix3d FindEllipse(
+        const int w, const int /*h*/,
+        const int16_t* dx, const int16_t* dy,
+        const IRectangle& r,
+        double& /*residual*/
+        ) {
+    RowGradient row;
+    return FitEllipse(PlanarGradient{w, dx, dy}, r, row);
+}
+
 ////////////////////////////////////////////////////////////////////////////
 
 template<typename TdI>
 void FindConics(
-        const int w, const int h,
+        const int w, const int /*h*/,
         const std::vector<PixelClass>& candidates,
         const TdI* dI,
-        std::vector<Conic, Eigen::aligned_allocator<Conic> >& conics
+        std::vector<Conic, Eigen::aligned_allocator<Conic> >& conics,
+        unsigned int num_threads
         ) {
-    for( unsigned int i=0; i<candidates.size(); ++i )
-    {
-        const IRectangle region = candidates[i].bbox;
+    FitConics(InterleavedGradient<TdI>{w, dI}, candidates, num_threads, conics);
+}
 
-        Conic conic;
-        double residual = 0;
-        conic.C = FindEllipse(w,h,dI,region, residual);
+void FindConics(
+        const int w, const int /*h*/,
+        const std::vector<PixelClass>& candidates,
+        const int16_t* dx, const int16_t* dy,
+        std::vector<Conic, Eigen::aligned_allocator<Conic> >& conics,
+        unsigned int num_threads
+        ) {
+    FitConics(PlanarGradient{w, dx, dy}, candidates, num_threads, conics);
+}
 
-        conic.bbox = region;
-        conic.Dual = conic.C.inverse();
-        conic.Dual /= conic.Dual(2,2);
-        conic.center = Eigen::Vector2d(conic.Dual(0,2),conic.Dual(1,2));
+////////////////////////////////////////////////////////////////////////////
 
-        const double max_dist = (region.Width() + region.Height()) / 8.0;
-        if( (conic.center - region.Center()).norm() < max_dist)
-            conics.push_back( conic );
+bool IsCandidateConic(
+        unsigned w, unsigned h,
+        const PixelClass& label,
+        float min_area,    float max_area,
+        float min_aspect
+        ) {
+    const int border = 3;
+    const IRectangle& r = label.bbox;
+    // reject rectangles clipped by camera view
+    if( r.x1 >= border && r.y1 >= border && r.x2 < (int)w-border && r.y2 < (int)h-border)
+    {
+        const float area = r.Area();
+        if( min_area <= area && area <= max_area )
+        {
+            const float aspect = (float)r.Width() / (float)r.Height();
+            return min_aspect < aspect && aspect < 1.0 / min_aspect;
+        }
     }
+    return false;
 }
 
-////////////////////////////////////////////////////////////////////////////
-
 void FindCandidateConicsFromLabels(
         unsigned w, unsigned h,
         const std::vector<PixelClass>& labels,
         std::vector<PixelClass>& candidates,
         float min_area,    float max_area,
-        float min_density, float min_aspect
+        float /*min_density*/, float min_aspect
         ) {
     const int border = 3;
 
     for( unsigned int i=0; i<labels.size(); ++i )
     {
-        if( labels[i].equiv == -1 )
+        if( labels[i].equiv == -1 &&
+            IsCandidateConic(w, h, labels[i], min_area, max_area, min_aspect) )
         {
-            const IRectangle& r = labels[i].bbox;
-            // reject rectangles clipped by camera view
-            if( r.x1 >= border && r.y1 >= border && r.x2 < (int)w-border && r.y2 < (int)h-border)
-            {
-                const float area = r.Area();
-                if( min_area <= area && area <= max_area )
-                {
-                    const float aspect = (float)r.Width() / (float)r.Height();
-                    if( min_aspect < aspect && aspect < 1.0 / min_aspect )
-                    {
-                        const double density = (double)labels[i].size / (double)area;
-                        //if( min_density <=  density )
-                        {
-                            PixelClass candidate = labels[i];
-                            candidate.bbox = r.Grow(2).Clamp(border,border,w-(1+border),h-(1+border));
-                            candidates.push_back(candidate);
-                        }
-                    }
-
-                }
-            }
+            PixelClass candidate = labels[i];
+            candidate.bbox = labels[i].bbox.Grow(2).Clamp(border,border,w-(1+border),h-(1+border));
+            candidates.push_back(candidate);
         }
     }
 }
 
+bool ConicFromMoments(
+        const BlobMoments& moments,
+        const IRectangle& bbox,
+        Conic& conic
+        ) {
+    Eigen::Matrix2d S;
+    S << moments.cxx, moments.cxy,
+         moments.cxy, moments.cyy;
+    const Eigen::Matrix2d A = (4 * S).inverse();
+    const Eigen::Vector2d c(moments.cx, moments.cy);
+    if( !(S.determinant() > 0) || !A.allFinite() ) {
+        return false;
+    }
+
+    conic.C.topLeftCorner<2,2>() = A;
+    conic.C.topRightCorner<2,1>() = -A * c;
+    conic.C.bottomLeftCorner<1,2>() = -(A * c).transpose();
+    conic.C(2,2) = c.dot(A * c) - 1;
+    conic.Dual = conic.C.inverse();
+    conic.Dual /= conic.Dual(2,2);
+    conic.center = c;
+    conic.center_undistorted = c.homogeneous();
+    conic.bbox = bbox;
+    conic.radius = (bbox.Width() + bbox.Height()) / 4.0;
+    return true;
+}
+
 ////////////////////////////////////////////////////////////////////////////
 #include <Eigen/Eigen>
 
 template Eigen::Matrix3d FindEllipse( const int, const int, const Eigen::Vector2f*, const IRectangle&, double& );
-template void FindConics( const int, const int, const std::vector<PixelClass>& candidates, const Eigen::Vector2f* dI, std::vector<Conic, Eigen::aligned_allocator<Conic>>& conics );
+template void FindConics( const int, const int, const std::vector<PixelClass>& candidates, const Eigen::Vector2f* dI, std::vector<Conic, Eigen::aligned_allocator<Conic>>& conics, unsigned int num_threads );
 
 }
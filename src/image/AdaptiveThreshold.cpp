@@ -0,0 +1,179 @@
+/*
+  This file is part of the Calibu Project.
+  https://github.com/gwu-robotics/Calibu
+
+  Copyright (C) 2013 George Washington University,
+  Steven Lovegrove
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+  http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+#include <calibu/image/AdaptiveThreshold.h>
+
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#  define CALIBU_THRESHOLD_SSE2
+#  include <emmintrin.h>
+#endif
+
+// vdivq_f32 is only available on AArch64
+#if defined(__aarch64__) && (defined(__ARM_NEON) || defined(__ARM_NEON__))
+#  define CALIBU_THRESHOLD_NEON
+#  include <arm_neon.h>
+#endif
+
+namespace calibu {
+
+namespace {
+
+// Box sum rows of the integral image for one output row. A pixel whose box
+// spans columns x1..x2 sums (row2[x2] - row1[x2]) - (row2[x1-1] - row1[x1-1]).
+struct BoxRows {
+  const uint32_t* row2;
+  const uint32_t* row1;
+};
+
+inline unsigned char ThresholdPixel(
+    unsigned char value, uint32_t sum, int count, float threshold,
+    int min_diff, unsigned char pass, unsigned char fail) {
+  const float avg = (float)sum / count;
+  return (value < threshold*(avg-min_diff)) ? pass : fail;
+}
+
+// Pixels [begin, end) of a row, clamping their boxes to the image.
+void ThresholdClipped(
+    const BoxRows& box, int w, int count_y, int rad, int begin, int end,
+    const unsigned char* I, unsigned char* out, float threshold,
+    int min_diff, unsigned char pass, unsigned char fail) {
+  for (int i = begin; i < end; ++i) {
+    const int x1 = std::max(1, i-rad);
+    const int x2 = std::min(w-1, i+rad);
+    const uint32_t sum = (box.row2[x2] - box.row1[x2]) -
+                         (box.row2[x1-1] - box.row1[x1-1]);
+    out[i] = ThresholdPixel(I[i], sum, (x2-x1)*count_y, threshold, min_diff,
+                            pass, fail);
+  }
+}
+
+// Pixels [begin, end) of a row whose boxes lie within the image, so that
+// the box of pixel i spans columns i-rad..i+rad and all share one count.
+void ThresholdInterior(
+    const BoxRows& box, int count, int rad, int begin, int end,
+    const unsigned char* I, unsigned char* out, float threshold,
+    int min_diff, unsigned char pass, unsigned char fail) {
+  const uint32_t* r2 = box.row2 + rad;
+  const uint32_t* r1 = box.row1 + rad;
+  const uint32_t* l2 = box.row2 - rad - 1;
+  const uint32_t* l1 = box.row1 - rad - 1;
+
+  int i = begin;
+#if defined(CALIBU_THRESHOLD_SSE2)
+  // Four pixels per iteration. SSE2 has no unsigned conversion, so sums are
+  // converted as two 16 bit halves, which rounds exactly as a scalar cast.
+  const __m128 vcount = _mm_set1_ps((float)count);
+  const __m128 vthreshold = _mm_set1_ps(threshold);
+  const __m128 vmin_diff = _mm_set1_ps((float)min_diff);
+  const __m128 v65536 = _mm_set1_ps(65536.0f);
+  const __m128i low_mask = _mm_set1_epi32(0xFFFF);
+  const __m128i vpass = _mm_set1_epi8((char)pass);
+  const __m128i vfail = _mm_set1_epi8((char)fail);
+  const __m128i zero = _mm_setzero_si128();
+  for (; i + 4 <= end; i += 4) {
+    const __m128i right = _mm_sub_epi32(
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(r2 + i)),
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(r1 + i)));
+    const __m128i left = _mm_sub_epi32(
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(l2 + i)),
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(l1 + i)));
+    const __m128i sum = _mm_sub_epi32(right, left);
+    const __m128 fsum = _mm_add_ps(
+        _mm_mul_ps(_mm_cvtepi32_ps(_mm_srli_epi32(sum, 16)), v65536),
+        _mm_cvtepi32_ps(_mm_and_si128(sum, low_mask)));
+    const __m128 avg = _mm_div_ps(fsum, vcount);
+    const __m128 t = _mm_mul_ps(vthreshold, _mm_sub_ps(avg, vmin_diff));
+
+    int packed;
+    memcpy(&packed, I + i, 4);
+    const __m128i value = _mm_unpacklo_epi16(
+        _mm_unpacklo_epi8(_mm_cvtsi32_si128(packed), zero), zero);
+    __m128i mask = _mm_castps_si128(_mm_cmplt_ps(_mm_cvtepi32_ps(value), t));
+    mask = _mm_packs_epi32(mask, mask);
+    mask = _mm_packs_epi16(mask, mask);
+
+    const __m128i result = _mm_or_si128(_mm_and_si128(mask, vpass),
+                                         _mm_andnot_si128(mask, vfail));
+    packed = _mm_cvtsi128_si32(result);
+    memcpy(out + i, &packed, 4);
+  }
+#elif defined(CALIBU_THRESHOLD_NEON)
+  // Eight pixels per iteration
+  const float32x4_t vcount = vdupq_n_f32((float)count);
+  const float32x4_t vthreshold = vdupq_n_f32(threshold);
+  const float32x4_t vmin_diff = vdupq_n_f32((float)min_diff);
+  const uint8x8_t vpass = vdup_n_u8(pass);
+  const uint8x8_t vfail = vdup_n_u8(fail);
+  for (; i + 8 <= end; i += 8) {
+    const uint16x8_t value16 = vmovl_u8(vld1_u8(I + i));
+    uint16x4_t mask16[2];
+    for (int half = 0; half < 2; ++half) {
+      const int k = i + 4 * half;
+      const uint32x4_t sum = vsubq_u32(
+          vsubq_u32(vld1q_u32(r2 + k), vld1q_u32(r1 + k)),
+          vsubq_u32(vld1q_u32(l2 + k), vld1q_u32(l1 + k)));
+      const float32x4_t avg = vdivq_f32(vcvtq_f32_u32(sum), vcount);
+      const float32x4_t t = vmulq_f32(vthreshold, vsubq_f32(avg, vmin_diff));
+      const uint16x4_t value = half ? vget_high_u16(value16)
+                                    : vget_low_u16(value16);
+      mask16[half] = vmovn_u32(vcltq_f32(vcvtq_f32_u32(vmovl_u16(value)), t));
+    }
+    const uint8x8_t mask = vmovn_u16(vcombine_u16(mask16[0], mask16[1]));
+    vst1_u8(out + i, vbsl_u8(mask, vpass, vfail));
+  }
+#endif
+
+  for (; i < end; ++i) {
+    const uint32_t sum = (r2[i] - r1[i]) - (l2[i] - l1[i]);
+    out[i] = ThresholdPixel(I[i], sum, count, threshold, min_diff, pass,
+                            fail);
+  }
+}
+
+}  // namespace
+
+void AdaptiveThreshold(
+    int w, int h, size_t pitch, const unsigned char* I, const uint32_t* intI,
+    unsigned char* out, float threshold, int rad, int min_diff,
+    unsigned char pass, unsigned char fail) {
+  // Columns whose box is not clipped by the left or right border
+  const int interior_begin = std::min(w, rad+1);
+  const int interior_end = std::max(interior_begin, w-rad);
+
+  for (int j = 0; j < h; ++j) {
+    const int y1 = std::max(1, j-rad);
+    const int y2 = std::min(h-1, j+rad);
+    const int count_y = y2-y1;
+    const BoxRows box = { intI + y2*w, intI + (y1-1)*w };
+    const unsigned char* row = I + j*pitch;
+    unsigned char* out_row = out + j*w;
+
+    ThresholdClipped(box, w, count_y, rad, 0, interior_begin, row, out_row,
+                     threshold, min_diff, pass, fail);
+    ThresholdInterior(box, 2*rad*count_y, rad, interior_begin, interior_end,
+                      row, out_row, threshold, min_diff, pass, fail);
+    ThresholdClipped(box, w, count_y, rad, interior_end, w, row, out_row,
+                     threshold, min_diff, pass, fail);
+  }
+}
+
+}
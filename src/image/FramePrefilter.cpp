@@ -0,0 +1,133 @@
+/*
+  This file is part of the Calibu Project.
+  https://github.com/gwu-robotics/Calibu
+
+  Copyright (C) 2013 George Washington University,
+  Steven Lovegrove
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+  http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+#include <calibu/image/FramePrefilter.h>
+
+#include <algorithm>
+#include <limits>
+
+namespace calibu {
+
+FramePrefilter::FramePrefilter()
+    : num_accepted_(0), num_blurred_(0), num_duplicates_(0) {
+}
+
+bool FramePrefilter::Accept(const PrefilterImage* images, size_t count) {
+  sharpness_.assign(count, 0);
+  difference_.assign(count, 0);
+
+  // Blur is checked first, as it's the cheaper to measure
+  bool sharp = true;
+  for (size_t i = 0; i < count; ++i) {
+    if (params_.min_sharpness > 0) {
+      sharpness_[i] = Sharpness(images[i]);
+      sharp = sharp && sharpness_[i] >= params_.min_sharpness;
+    }
+  }
+  if (!sharp) {
+    ++num_blurred_;
+    return false;
+  }
+
+  if (params_.min_difference > 0) {
+    bool novel = false;
+    candidate_.resize(count);
+    for (size_t i = 0; i < count; ++i) {
+      MakeThumbnail(images[i], candidate_[i]);
+      difference_[i] = last_.size() == count ?
+          Difference(candidate_[i], last_[i]) :
+          std::numeric_limits<double>::infinity();
+      novel = novel || difference_[i] >= params_.min_difference;
+    }
+    if (!novel) {
+      ++num_duplicates_;
+      return false;
+    }
+    last_.swap(candidate_);
+  }
+
+  ++num_accepted_;
+  return true;
+}
+
+double FramePrefilter::Sharpness(const PrefilterImage& image) {
+  // Sums of 2x2 blocks, which averages out pixel noise
+  const size_t w = image.w / 2;
+  const size_t h = image.h / 2;
+  if (w < 3 || h < 3) {
+    return 0;
+  }
+  half_.resize(w * h);
+  for (size_t y = 0; y < h; ++y) {
+    const unsigned char* r0 = image.data + 2 * y * image.pitch;
+    const unsigned char* r1 = r0 + image.pitch;
+    uint16_t* out = &half_[y * w];
+    for (size_t x = 0; x < w; ++x) {
+      out[x] = r0[2 * x] + r0[2 * x + 1] + r1[2 * x] + r1[2 * x + 1];
+    }
+  }
+
+  int64_t sum = 0;
+  int64_t sum_sq = 0;
+  for (size_t y = 1; y + 1 < h; ++y) {
+    const uint16_t* up = &half_[(y - 1) * w];
+    const uint16_t* row = up + w;
+    const uint16_t* down = row + w;
+    for (size_t x = 1; x + 1 < w; ++x) {
+      const int64_t lap = 4 * row[x] - row[x - 1] - row[x + 1] - up[x] - down[x];
+      sum += lap;
+      sum_sq += lap * lap;
+    }
+  }
+
+  // Blocks sum 4 pixels, so are 16 times the variance of their means
+  const double n = (double)(w - 2) * (h - 2);
+  const double mean = sum / n;
+  return (sum_sq / n - mean * mean) / 16.0;
+}
+
+void FramePrefilter::MakeThumbnail(const PrefilterImage& image,
+                                   Thumbnail& thumbnail) const {
+  const size_t s = std::max(params_.thumbnail_scale, 1);
+  thumbnail.scale = s;
+  thumbnail.w = image.w / s;
+  thumbnail.h = image.h / s;
+  thumbnail.sums.assign(thumbnail.w * thumbnail.h, 0);
+  for (size_t y = 0; y < thumbnail.h * s; ++y) {
+    const unsigned char* row = image.data + y * image.pitch;
+    uint32_t* out = &thumbnail.sums[(y / s) * thumbnail.w];
+    for (size_t x = 0; x < thumbnail.w * s; ++x) {
+      out[x / s] += row[x];
+    }
+  }
+}
+
+double FramePrefilter::Difference(const Thumbnail& a, const Thumbnail& b) {
+  if (a.w != b.w || a.h != b.h || a.scale != b.scale || a.sums.empty()) {
+    return std::numeric_limits<double>::infinity();
+  }
+  uint64_t total = 0;
+  for (size_t i = 0; i < a.sums.size(); ++i) {
+    total += a.sums[i] > b.sums[i] ? a.sums[i] - b.sums[i] : b.sums[i] - a.sums[i];
+  }
+  return (double)total / (a.sums.size() * a.scale * a.scale);
+}
+
+}  // namespace calibu
@@ -23,13 +23,42 @@
 #include <calibu/image/AdaptiveThreshold.h>
 #include <calibu/image/IntegralImage.h>
 #include <calibu/image/Label.h>
+#include <calibu/utils/PipelineStats.h>
+
+#ifdef HAVE_CUDA
+#include <calibu/image/ImageProcessingCuda.h>
+#endif
+
+#include <algorithm>
 
 #include <opencv2/imgproc/imgproc.hpp>
 
 namespace calibu {
 
+// Intermediate images reused across frames, so that processing a stream of
+// equally sized images doesn't allocate.
+struct ImageProcessing::Workspace {
+  LabelWorkspace label;
+  cv::Mat region_threshold;
+  cv::Mat level;
+#ifdef HAVE_CUDA
+  std::unique_ptr<CudaImageProcessing> cuda;
+#endif
+};
+
+namespace {
+
+cv::Rect ToRect(const IRectangle& r) {
+  return cv::Rect(r.x1, r.y1, r.Width(), r.Height());
+}
+
+}
+
 ImageProcessing::ImageProcessing(int maxWidth, int maxHeight)
-    : width(maxWidth), height(maxHeight) {
+    : width(maxWidth), height(maxHeight), roi(0, 0, maxWidth-1, maxHeight-1),
+      img(nullptr), img_pitch(maxWidth), input_img(nullptr),
+      input_pitch(maxWidth), input_width(maxWidth), input_height(maxHeight),
+      has_moments(false), workspace(new Workspace) {
   AllocateImageData(maxWidth*maxHeight);
 }
 
@@ -38,10 +67,9 @@ ImageProcessing::~ImageProcessing() {
 }
 
 void ImageProcessing::AllocateImageData(int maxPixels) {
-  I.resize(maxPixels);
-  intI.resize(maxPixels);
-  dI.resize(maxPixels);
-  lI.resize(maxPixels);
+  // The input copy is only made on request, see Process
+  dx.resize(maxPixels);
+  dy.resize(maxPixels);
   tI.resize(maxPixels);
 }
 
@@ -49,110 +77,158 @@ void ImageProcessing::DeallocateImageData() {}
 
 void ImageProcessing::Process(const unsigned char* greyscale_image,
                               size_t w, size_t h, size_t pitch) {
-  width = w;
-  height = h;
+  Process(greyscale_image, w, h, pitch, IRectangle(0, 0, (int)w - 1, (int)h - 1));
+}
 
-  size_t img_size = width * height * sizeof(unsigned char);
-  if (img_size > I.size()) {
-    AllocateImageData(img_size);
+void ImageProcessing::Process(const unsigned char* greyscale_image,
+                              size_t w, size_t h, size_t pitch,
+                              const IRectangle& region) {
+  // Region of the input image to read
+  IRectangle input_region = region.Clamp(0, 0, (int)w - 1, (int)h - 1);
+  if (input_region.Area() == 0) {
+    input_region = IRectangle(0, 0, (int)w - 1, (int)h - 1);
   }
 
-  // Copy input image
-  if(pitch > width*sizeof(unsigned char) ) {
-    // Copy line by line
-    for(int y=0; y < height; ++y) {
-      memcpy(&I[y*width], greyscale_image+y*pitch, width * sizeof(unsigned char));
+  CALIBU_PIPELINE_TIMER(timer, STAGE_COPY);
+
+  input_width = w;
+  input_height = h;
+  if(params.copy_input) {
+    const size_t input_size = w * h * sizeof(unsigned char);
+    if (input_size > I.size()) {
+      I.resize(input_size);
+    }
+
+    // Copy input image
+    const int rw = input_region.Width();
+    if(rw < (int)w || pitch > w*sizeof(unsigned char) ) {
+      // Copy line by line
+      for(int y=input_region.y1; y <= input_region.y2; ++y) {
+        memcpy(&I[y*w + input_region.x1], greyscale_image+y*pitch + input_region.x1, rw * sizeof(unsigned char));
+      }
+    }else{
+      memcpy(&I[input_region.y1*w], greyscale_image + input_region.y1*pitch, input_region.Height() * w * sizeof(unsigned char));
     }
+    input_img = &I[0];
+    input_pitch = w * sizeof(unsigned char);
   }else{
-    memcpy(&I[0], greyscale_image, img_size);
+    // Work on the caller's image directly
+    input_img = greyscale_image;
+    input_pitch = pitch;
   }
 
+  // Size of the pyramid level processed
+  const int scale = Scale();
+  const bool resized = (int)w / scale != width || (int)h / scale != height;
+  width = w / scale;
+  height = h / scale;
 
-  cv::Mat dst(h, w, cv::DataType<unsigned char>::type, &tI[0]);
-
-  cv::Mat input_test(h, w, cv::DataType<unsigned char>::type, &I[0]);
-
-  // Process image
-  gradient<>(width, height, &I[0],  &dI[0]);
-  /*integral_image(width, height, &I[0], &intI[0] );
-
-  // Threshold image
-  AdaptiveThreshold(
-      width, height, &I[0], &intI[0], &tI[0], params.at_threshold,
-      width / params.at_window_ratio, 20,
-      (unsigned char)0, (unsigned char)255
-                    );
-
-  cv::Mat dst2;
-
-  cv::Mat dst3(h, w, cv::DataType<unsigned char>::type);
-
-  auto clahe = cv::createCLAHE();
-  clahe->setClipLimit(8);
-  clahe->setTilesGridSize(cv::Size(2, 2));
-
-  clahe->apply(input_test, input_test);
-
-  cv::Mat dst_intI(h, w, cv::DataType<float>::type);
-
-  cv::Mat dst_intI_test(h, w, cv::DataType<float>::type, &intI[0]);
-
-  integral_image(width, height, &I[0], &intI[0]);
-
-  AdaptiveThreshold(
-      width, height, &I[0], &intI[0], dst3.data, params.at_threshold,
-      width / params.at_window_ratio, 20,
-      (unsigned char)0, (unsigned char)255
-  );*/
-
-  cv::adaptiveThreshold(input_test, dst, 255, cv::ADAPTIVE_THRESH_GAUSSIAN_C, cv::THRESH_BINARY, 127, 4);
-
-  //gradient<>(width, height, dst.data, &dI[0]);
-
-  cv::Mat bw2 = dst < 128;
-  cv::Mat labelImage2(bw2.size(), CV_16U);
-
-
-  cv::Mat output2;
-  cv::Mat centroids2;
-  cv::Mat stats2;
-  cv::connectedComponentsWithStats(bw2, labelImage2, stats2, centroids2, 8, CV_16U);
-
+  size_t img_size = width * height * sizeof(unsigned char);
+  if (img_size > tI.size()) {
+    AllocateImageData(img_size);
+  }
 
-  // Label image (connected components)
-  labels.clear();
-  //Label(width, height, &tI[0], &lI[0], labels,
-  //    params.black_on_white ? 0 : 255);
+  const IRectangle full(0, 0, width - 1, height - 1);
+  IRectangle r(input_region.x1 / scale, input_region.y1 / scale,
+               input_region.x2 / scale, input_region.y2 / scale);
+  r = r.Clamp(0, 0, width - 1, height - 1);
+  if (r.Area() == 0) {
+    r = full;
+  }
+  const int rw = r.Width();
+  const int rh = r.Height();
+
+  Workspace& ws = *workspace;
+  if (scale > 1) {
+    // Box filter the region down to the pyramid level
+    ws.level.create(height, width, cv::DataType<unsigned char>::type);
+    const cv::Mat input(input_height, input_width,
+                        cv::DataType<unsigned char>::type,
+                        const_cast<unsigned char*>(input_img), input_pitch);
+    cv::Mat level = ws.level(ToRect(r));
+    cv::resize(input(cv::Rect(r.x1 * scale, r.y1 * scale, rw * scale, rh * scale)),
+               level, level.size(), 0, 0, cv::INTER_AREA);
+    img = ws.level.data;
+    img_pitch = ws.level.step;
+  }else{
+    img = input_img;
+    img_pitch = input_pitch;
+  }
 
+  const cv::Rect previous_rect = resized ? ToRect(full) : ToRect(roi);
+  const cv::Rect rect = ToRect(r);
+  roi = r;
 
+  cv::Mat thresholded_image(height, width, cv::DataType<unsigned char>::type, &tI[0]);
+  cv::Mat dx_image(height, width, cv::DataType<int16_t>::type, &dx[0]);
+  cv::Mat dy_image(height, width, cv::DataType<int16_t>::type, &dy[0]);
 
-  /*cv::Mat input(h, w, cv::DataType<unsigned char>::type, &tI[0]);
-  cv::Mat bw = input < 128;
-  cv::Mat labelImage(bw.size(), CV_16U);
+  // Clear output of the previous frame left outside of this region
+  if ((previous_rect & rect) != previous_rect) {
+    thresholded_image(previous_rect).setTo(255);
+    dx_image(previous_rect).setTo(0);
+    dy_image(previous_rect).setTo(0);
+  }
 
+#ifdef HAVE_CUDA
+  if (params.use_cuda) {
+    // Threshold and label the region on the device, which also finds the
+    // moments of the labels, leaving the derivatives as they were
+    CALIBU_PIPELINE_NEXT(timer, STAGE_LABEL);
+    if (!ws.cuda) {
+      ws.cuda.reset(new CudaImageProcessing);
+    }
+    ws.cuda->Process(img, width, height, img_pitch, r, params, &tI[0],
+                     labels, moments);
+    has_moments = true;
+    return;
+  }
+#endif
+  moments.clear();
+  has_moments = false;
 
-  cv::Mat output;
-  cv::Mat centroids;
-  cv::Mat stats;
+  const unsigned char* roi_img = img + r.y1*img_pitch + r.x1;
+  const cv::Mat input(rh, rw, cv::DataType<unsigned char>::type,
+                      const_cast<unsigned char*>(roi_img), img_pitch);
+  cv::Mat thresholded = thresholded_image(rect);
 
-  cv::connectedComponentsWithStats(bw, labelImage, stats, centroids, 8, CV_16U);*/
-  //std::vector<PixelClass> labels2;
-  for (int i = 1; i < stats2.size().height; i++)
-  {
-      //populate labels from stats
-      PixelClass current;
+  // Process image
+  CALIBU_PIPELINE_NEXT(timer, STAGE_GRADIENT);
+  GradientPlanar(rw, rh, img_pitch, roi_img, &dx[r.y1*width + r.x1],
+                 &dy[r.y1*width + r.x1], width);
 
-      current.bbox.x1 = stats2.at<int>(i, cv::CC_STAT_LEFT);
-      current.bbox.y1 = stats2.at<int>(i, cv::CC_STAT_TOP);
-      current.bbox.x2 = current.bbox.x1 + stats2.at<int>(i, cv::CC_STAT_WIDTH) - 1;
-      current.bbox.y2 = current.bbox.y1 + stats2.at<int>(i, cv::CC_STAT_HEIGHT) - 1;
-      current.equiv = -1;
-      current.size = stats2.at<int32_t>(i, cv::CC_STAT_AREA);
-      labels.push_back(current);
+  // Threshold image
+  CALIBU_PIPELINE_NEXT(timer, STAGE_THRESHOLD);
+  if (params.threshold_method == THRESHOLD_INTEGRAL) {
+    if (img_size > intI.size()) {
+      intI.resize(img_size);
+    }
+    // AdaptiveThreshold writes contiguous rows, so a region is thresholded
+    // into the workspace first. The window size follows the whole image.
+    unsigned char* out = &tI[r.y1*width];
+    if (rw < width) {
+      ws.region_threshold.create(rh, rw, cv::DataType<unsigned char>::type);
+      out = ws.region_threshold.data;
+    }
+    IntegralImage(rw, rh, img_pitch, roi_img, &intI[0]);
+    AdaptiveThreshold(rw, rh, img_pitch, roi_img, &intI[0], out,
+                      params.at_threshold,
+                      width / std::max(1, params.at_window_ratio),
+                      params.at_min_diff, 0, 255);
+    if (rw < width) {
+      ws.region_threshold.copyTo(thresholded);
+    }
+  } else {
+    // Keep the window size constant at full resolution
+    const int block_size = std::max(3, (127 / scale) | 1);
+    cv::adaptiveThreshold(input, thresholded, 255, cv::ADAPTIVE_THRESH_GAUSSIAN_C, cv::THRESH_BINARY, block_size, 4);
   }
 
-
-
+  // Label image (connected components) of the dark pixels of the region.
+  // The workspace keeps its storage while the image size is unchanged.
+  CALIBU_PIPELINE_NEXT(timer, STAGE_LABEL);
+  Label(width, height, width, &tI[0], r, 0, labels, ws.label,
+        params.label_threads);
 }
 
 }
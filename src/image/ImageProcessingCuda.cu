@@ -0,0 +1,348 @@
+/*
+  This file is part of the Calibu Project.
+  https://github.com/gwu-robotics/Calibu
+
+  Copyright (C) 2013 George Washington University,
+  Steven Lovegrove
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+  http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+#include <calibu/image/ImageProcessingCuda.h>
+#include <calibu/exception.h>
+
+#include <cuda_runtime.h>
+
+#include <algorithm>
+#include <climits>
+#include <string>
+
+namespace calibu {
+
+namespace {
+
+typedef CudaImageProcessing::DeviceBlob DeviceBlob;
+
+const dim3 kBlock(32, 8);
+const int kThreads = 256;
+
+inline void CudaCheck(cudaError_t err) {
+  CALIBU_ASSERT_DESC(err == cudaSuccess,
+                     std::string("CUDA error: ") + cudaGetErrorString(err));
+}
+
+inline dim3 Grid(int width, int height) {
+  return dim3((width + kBlock.x - 1) / kBlock.x,
+              (height + kBlock.y - 1) / kBlock.y);
+}
+
+inline int Blocks(size_t count, int threads) {
+  return (int)((count + threads - 1) / threads);
+}
+
+// Inclusive prefix sums along each row, one warp per row, scanning 32
+// pixels at a time with shuffles.
+__global__ void RowSumsKernel(const unsigned char* img, int w, int h,
+                              uint32_t* sums) {
+  const int lane = threadIdx.x & 31;
+  const int row = (blockIdx.x * blockDim.x + threadIdx.x) / 32;
+  if (row >= h) {
+    return;
+  }
+  uint32_t carry = 0;
+  for (int x0 = 0; x0 < w; x0 += 32) {
+    const int x = x0 + lane;
+    uint32_t v = x < w ? img[row * w + x] : 0;
+    for (int d = 1; d < 32; d <<= 1) {
+      const uint32_t n = __shfl_up_sync(0xffffffff, v, d);
+      if (lane >= d) v += n;
+    }
+    if (x < w) sums[row * w + x] = carry + v;
+    carry += __shfl_sync(0xffffffff, v, 31);
+  }
+}
+
+// Prefix sums of the row sums down each column, making the integral image.
+__global__ void ColumnSumsKernel(int w, int h, uint32_t* sums) {
+  const int x = blockIdx.x * blockDim.x + threadIdx.x;
+  if (x >= w) {
+    return;
+  }
+  uint32_t sum = 0;
+  for (int y = 0; y < h; ++y) {
+    sum += sums[y * w + x];
+    sums[y * w + x] = sum;
+  }
+}
+
+// AdaptiveThreshold with min_diff, pixel for pixel, marking dark pixels 0
+// and the rest 255, and starting each dark pixel as its own component.
+__global__ void ThresholdKernel(const unsigned char* img,
+                                const uint32_t* integral, int w, int h,
+                                float threshold, int rad, int min_diff,
+                                unsigned char* out, int32_t* parent) {
+  const int i = blockIdx.x * blockDim.x + threadIdx.x;
+  const int j = blockIdx.y * blockDim.y + threadIdx.y;
+  if (i >= w || j >= h) {
+    return;
+  }
+  const int y1 = max(1, j - rad);
+  const int y2 = min(h - 1, j + rad);
+  const int x1 = max(1, i - rad);
+  const int x2 = min(w - 1, i + rad);
+  const uint32_t* row2 = integral + y2 * w;
+  const uint32_t* row1 = integral + (y1 - 1) * w;
+  const uint32_t sum = (row2[x2] - row1[x2]) - (row2[x1 - 1] - row1[x1 - 1]);
+  const float avg = (float)sum / ((x2 - x1) * (y2 - y1));
+
+  const int id = j * w + i;
+  const bool dark = img[id] < threshold * (avg - min_diff);
+  out[id] = dark ? 0 : 255;
+  parent[id] = dark ? id : -1;
+}
+
+__device__ int32_t FindRoot(const int32_t* parent, int32_t i) {
+  int32_t p = parent[i];
+  while (p != i) {
+    i = p;
+    p = parent[i];
+  }
+  return i;
+}
+
+// Join the components of a and b, keeping the lower root. Roots only ever
+// decrease, so a failed atomicMin retries from the root it found instead.
+__device__ void Union(int32_t* parent, int32_t a, int32_t b) {
+  bool done = false;
+  while (!done) {
+    a = FindRoot(parent, a);
+    b = FindRoot(parent, b);
+    if (a < b) {
+      const int32_t old = atomicMin(&parent[b], a);
+      done = (old == b);
+      b = old;
+    } else if (b < a) {
+      const int32_t old = atomicMin(&parent[a], b);
+      done = (old == a);
+      a = old;
+    } else {
+      done = true;
+    }
+  }
+}
+
+// Join each dark pixel with its dark neighbours before it in raster order.
+__global__ void MergeKernel(int w, int h, int32_t* parent) {
+  const int x = blockIdx.x * blockDim.x + threadIdx.x;
+  const int y = blockIdx.y * blockDim.y + threadIdx.y;
+  if (x >= w || y >= h) {
+    return;
+  }
+  const int id = y * w + x;
+  if (parent[id] < 0) {
+    return;
+  }
+  if (x > 0 && parent[id - 1] >= 0) Union(parent, id, id - 1);
+  if (y > 0) {
+    const int up = id - w;
+    if (x > 0 && parent[up - 1] >= 0) Union(parent, id, up - 1);
+    if (parent[up] >= 0) Union(parent, id, up);
+    if (x + 1 < w && parent[up + 1] >= 0) Union(parent, id, up + 1);
+  }
+}
+
+// Point every dark pixel straight at its root, and give each root a slot
+// in the component list.
+__global__ void RootsKernel(int n, int32_t* parent, int32_t* slot,
+                            DeviceBlob* blobs, unsigned int* num_blobs) {
+  const int id = blockIdx.x * blockDim.x + threadIdx.x;
+  if (id >= n || parent[id] < 0) {
+    return;
+  }
+  const int32_t root = FindRoot(parent, id);
+  parent[id] = root;
+  if (root == id) {
+    const unsigned int b = atomicAdd(num_blobs, 1u);
+    DeviceBlob blob;
+    blob.root = id;
+    blob.size = 0;
+    blob.x1 = blob.y1 = INT_MAX;
+    blob.x2 = blob.y2 = -1;
+    blob.sx = blob.sy = blob.sxx = blob.sxy = blob.syy = 0;
+    blobs[b] = blob;
+    slot[id] = b;
+  }
+}
+
+// Add every dark pixel to its component.
+__global__ void AccumulateKernel(int w, int h, const int32_t* parent,
+                                 const int32_t* slot, DeviceBlob* blobs) {
+  const int x = blockIdx.x * blockDim.x + threadIdx.x;
+  const int y = blockIdx.y * blockDim.y + threadIdx.y;
+  if (x >= w || y >= h) {
+    return;
+  }
+  const int32_t root = parent[y * w + x];
+  if (root < 0) {
+    return;
+  }
+  DeviceBlob& blob = blobs[slot[root]];
+  const unsigned long long ux = x;
+  const unsigned long long uy = y;
+  atomicAdd(&blob.size, 1u);
+  atomicMin(&blob.x1, x);
+  atomicMin(&blob.y1, y);
+  atomicMax(&blob.x2, x);
+  atomicMax(&blob.y2, y);
+  atomicAdd(&blob.sx, ux);
+  atomicAdd(&blob.sy, uy);
+  atomicAdd(&blob.sxx, ux * ux);
+  atomicAdd(&blob.sxy, ux * uy);
+  atomicAdd(&blob.syy, uy * uy);
+}
+
+}
+
+CudaImageProcessing::CudaImageProcessing()
+    : stream(0), capacity(0), d_img(nullptr), d_integral(nullptr),
+      d_thresh(nullptr), d_parent(nullptr), d_slot(nullptr), d_blobs(nullptr),
+      d_num_blobs(nullptr) {
+  CudaCheck(cudaStreamCreateWithFlags(&stream, cudaStreamNonBlocking));
+}
+
+CudaImageProcessing::~CudaImageProcessing() {
+  // Not checked, destructors mustn't throw
+  cudaFree(d_img);
+  cudaFree(d_integral);
+  cudaFree(d_thresh);
+  cudaFree(d_parent);
+  cudaFree(d_slot);
+  cudaFree(d_blobs);
+  cudaFree(d_num_blobs);
+  cudaStreamDestroy(stream);
+}
+
+void CudaImageProcessing::Free() {
+  CudaCheck(cudaFree(d_img));
+  CudaCheck(cudaFree(d_integral));
+  CudaCheck(cudaFree(d_thresh));
+  CudaCheck(cudaFree(d_parent));
+  CudaCheck(cudaFree(d_slot));
+  CudaCheck(cudaFree(d_blobs));
+  CudaCheck(cudaFree(d_num_blobs));
+  d_img = d_thresh = nullptr;
+  d_integral = nullptr;
+  d_parent = d_slot = nullptr;
+  d_blobs = nullptr;
+  d_num_blobs = nullptr;
+  capacity = 0;
+}
+
+void CudaImageProcessing::Allocate(size_t pixels) {
+  Free();
+  // 8-connected components are at least a pixel apart in each direction,
+  // so there are fewer than pixels / 2 + 1 of them
+  const size_t max_blobs = pixels / 2 + 1;
+  CudaCheck(cudaMalloc((void**)&d_img, pixels));
+  CudaCheck(cudaMalloc((void**)&d_integral, pixels * sizeof(uint32_t)));
+  CudaCheck(cudaMalloc((void**)&d_thresh, pixels));
+  CudaCheck(cudaMalloc((void**)&d_parent, pixels * sizeof(int32_t)));
+  CudaCheck(cudaMalloc((void**)&d_slot, pixels * sizeof(int32_t)));
+  CudaCheck(cudaMalloc((void**)&d_blobs, max_blobs * sizeof(DeviceBlob)));
+  CudaCheck(cudaMalloc((void**)&d_num_blobs, sizeof(unsigned int)));
+  capacity = pixels;
+}
+
+void CudaImageProcessing::Process(
+    const unsigned char* img, int w, int h, size_t pitch,
+    const IRectangle& region, const ParamsImageProcessing& params,
+    unsigned char* thresholded, std::vector<PixelClass>& labels,
+    std::vector<BlobMoments>& moments) {
+  labels.clear();
+  moments.clear();
+  const IRectangle r = region.Clamp(0, 0, w - 1, h - 1);
+  const int rw = r.Width();
+  const int rh = r.Height();
+  const size_t n = (size_t)rw * rh;
+  if (n == 0) {
+    return;
+  }
+  if (n > capacity) {
+    Allocate(n);
+  }
+
+  CudaCheck(cudaMemcpy2DAsync(d_img, rw, img + r.y1 * pitch + r.x1, pitch,
+                              rw, rh, cudaMemcpyHostToDevice, stream));
+  CudaCheck(cudaMemsetAsync(d_num_blobs, 0, sizeof(unsigned int), stream));
+
+  // The window size follows the whole image, as on the CPU
+  const int rad = w / std::max(1, params.at_window_ratio);
+  RowSumsKernel<<<Blocks((size_t)rh * 32, kThreads), kThreads, 0, stream>>>(
+      d_img, rw, rh, d_integral);
+  ColumnSumsKernel<<<Blocks(rw, kThreads), kThreads, 0, stream>>>(
+      rw, rh, d_integral);
+  ThresholdKernel<<<Grid(rw, rh), kBlock, 0, stream>>>(
+      d_img, d_integral, rw, rh, params.at_threshold, rad, params.at_min_diff,
+      d_thresh, d_parent);
+  MergeKernel<<<Grid(rw, rh), kBlock, 0, stream>>>(rw, rh, d_parent);
+  RootsKernel<<<Blocks(n, kThreads), kThreads, 0, stream>>>(
+      (int)n, d_parent, d_slot, d_blobs, d_num_blobs);
+  AccumulateKernel<<<Grid(rw, rh), kBlock, 0, stream>>>(
+      rw, rh, d_parent, d_slot, d_blobs);
+  CudaCheck(cudaGetLastError());
+
+  // Copy back the thresholded region, which the target finder reads, and
+  // the components
+  CudaCheck(cudaMemcpy2DAsync(thresholded + r.y1 * w + r.x1, w, d_thresh, rw,
+                              rw, rh, cudaMemcpyDeviceToHost, stream));
+  unsigned int num_blobs = 0;
+  CudaCheck(cudaMemcpyAsync(&num_blobs, d_num_blobs, sizeof(unsigned int),
+                            cudaMemcpyDeviceToHost, stream));
+  CudaCheck(cudaStreamSynchronize(stream));
+  blobs.resize(num_blobs);
+  if (num_blobs > 0) {
+    CudaCheck(cudaMemcpyAsync(blobs.data(), d_blobs,
+                              num_blobs * sizeof(DeviceBlob),
+                              cudaMemcpyDeviceToHost, stream));
+    CudaCheck(cudaStreamSynchronize(stream));
+  }
+
+  // Slots are handed out in any order, roots are first pixels
+  std::sort(blobs.begin(), blobs.end(),
+            [](const DeviceBlob& a, const DeviceBlob& b) {
+              return a.root < b.root;
+            });
+  labels.reserve(num_blobs);
+  moments.reserve(num_blobs);
+  for (const DeviceBlob& blob : blobs) {
+    PixelClass label;
+    label.equiv = -1;
+    label.bbox = IRectangle(blob.x1 + r.x1, blob.y1 + r.y1,
+                            blob.x2 + r.x1, blob.y2 + r.y1);
+    label.size = blob.size;
+    labels.push_back(label);
+
+    const double count = blob.size;
+    const double mx = blob.sx / count;
+    const double my = blob.sy / count;
+    BlobMoments m;
+    m.cx = mx + r.x1;
+    m.cy = my + r.y1;
+    m.cxx = blob.sxx / count - mx * mx;
+    m.cxy = blob.sxy / count - mx * my;
+    m.cyy = blob.syy / count - my * my;
+    moments.push_back(m);
+  }
+}
+
+}
@@ -19,81 +19,231 @@
  */
 
 #include <calibu/image/Label.h>
+#include <calibu/utils/Parallel.h>
 
+#include <algorithm>
+#include <numeric>
+#include <unordered_map>
 #include <vector>
 
 using namespace std;
-using namespace Eigen;
 
 namespace calibu {
 
-inline short RootLabel(vector<PixelClass>& labels, short label )
+namespace {
+
+// Parents always have lower indices than their children, so the root of a
+// component is its first pixel in raster order.
+
+// Root of pixel x, halving the path to it as it goes.
+inline int32_t FindRoot(int32_t* parent, int32_t x)
+{
+    while( parent[x] != x ) {
+        parent[x] = parent[parent[x]];
+        x = parent[x];
+    }
+    return x;
+}
+
+// Root of pixel x, without modifying the forest.
+inline int32_t RootOf(const int32_t* parent, int32_t x)
+{
+    while( parent[x] != x ) {
+        x = parent[x];
+    }
+    return x;
+}
+
+inline void Union(int32_t* parent, int32_t a, int32_t b)
 {
-    if( label >= 0 )
-    {
-        while( labels[label].equiv >= 0)
-            label = labels[label].equiv;
+    a = FindRoot(parent, a);
+    b = FindRoot(parent, b);
+    if( a < b ) {
+        parent[b] = a;
+    }else if( b < a ) {
+        parent[a] = b;
     }
-    return label;
 }
 
-inline void AssignLabel( const int w, const int h, const unsigned char* I, short* label, vector<PixelClass>& labels, int r, int c, unsigned char passval )
+// Build the forest for rows [y0, y1) of the rw pixel wide region, joining
+// pixels only to those of the same rows.
+void LabelBand(int rw, int y0, int y1, size_t pitch, const unsigned char* I,
+               unsigned char passval, int32_t* parent)
 {
-    if( I[r*w+c] == passval )
-    {
-        short* labelr = label + r*w;
-        short* labelrm1 = labelr - w;
-        
-        const short lup = r>0? RootLabel(labels,labelrm1[c]) : -1;
-        const short lleft = c>0? RootLabel(labels,labelr[c-1]) : -1;
-        
-        if( lup >= 0 && lleft >= 0 && lup != lleft )
-        {
-            // merge
-            labelr[c] = lup;
-            labels[lup].size += labels[lleft].size + 1;
-            labels[lleft].equiv = lup;
-            labels[lup].bbox.Insert(labels[lleft].bbox);
-        }else if( lup >= 0 )
-        {
-            // assign to lup
-            labelr[c] = lup;
-            ++labels[lup].size;
-            labels[lup].bbox.Insert(c,r);
-        }else if( lleft >= 0 )
-        {
-            // assign to lleft
-            labelr[c] = lleft;
-            ++labels[lleft].size;
-            labels[lleft].bbox.Insert(c,r);
-        }else{
-            // new 
-            PixelClass pc = { -1, IRectangle(c, r, c, r), 1 };
-            labels.push_back( pc );
-            labelr[c] = labels.size()-1;
+    for( int y = y0; y < y1; ++y ) {
+        const unsigned char* row = I + y * pitch;
+        int32_t* p = parent + y * rw;
+        const bool has_up = y > y0;
+
+        for( int x = 0; x < rw; ++x ) {
+            const int32_t i = y * rw + x;
+            if( row[x] != passval ) {
+                p[x] = -1;
+                continue;
+            }
+
+            // The pixel above is adjacent to all others of the
+            // neighbourhood, so it alone decides the component.
+            if( has_up && p[x - rw] >= 0 ) {
+                p[x] = p[x - rw];
+                continue;
+            }
+
+            // Left and up-left neighbour each other
+            int32_t a = -1;
+            if( x > 0 && p[x - 1] >= 0 ) {
+                a = p[x - 1];
+            }else if( has_up && x > 0 && p[x - rw - 1] >= 0 ) {
+                a = p[x - rw - 1];
+            }
+            const int32_t b = (has_up && x + 1 < rw && p[x - rw + 1] >= 0) ?
+                        i - rw + 1 : -1;
+
+            if( a >= 0 ) {
+                p[x] = a;
+                if( b >= 0 ) {
+                    Union(parent, a, b);
+                }
+            }else if( b >= 0 ) {
+                p[x] = b;
+            }else{
+                p[x] = i;
+            }
         }
     }
 }
 
-void Label( int w, int h, const unsigned char* I, short* label, vector<PixelClass>& labels, unsigned char passval )
+// Join the components of row y to those of row y - 1.
+void JoinRows(int rw, int y, int32_t* parent)
 {
-    std::fill(label,label+w*h, -1);
-    
-    for( int d=0; d < max(w,h); ++d )
-    {
-        if( d<w )
-        {
-            for( int r=0; r< std::min(d,h-1); ++r )
-                AssignLabel(w,h,I,label,labels,r,d, passval);
+    const int32_t* up = parent + (y - 1) * rw;
+    const int32_t* row = parent + y * rw;
+    for( int x = 0; x < rw; ++x ) {
+        if( row[x] < 0 ) {
+            continue;
+        }
+        for( int ux = std::max(0, x - 1); ux <= std::min(rw - 1, x + 1); ++ux ) {
+            if( up[ux] >= 0 ) {
+                Union(parent, y * rw + x, (y - 1) * rw + ux);
+            }
         }
-        
-        if( d<h )
-        {
-            for( int c=0; c<= std::min(d,w-1); ++c )
-                AssignLabel(w,h,I,label,labels,d,c, passval);
+    }
+}
+
+// Bounding boxes and sizes of the components of rows [y0, y1), with the
+// root of each. Boxes are offset by (offset_x, offset_y) into the image.
+void CollectBand(int rw, int y0, int y1, int offset_x, int offset_y,
+                 const int32_t* parent, vector<PixelClass>& labels,
+                 vector<int32_t>& roots)
+{
+    labels.clear();
+    roots.clear();
+    unordered_map<int32_t, size_t> index;
+
+    for( int y = y0; y < y1; ++y ) {
+        const int32_t* p = parent + y * rw;
+        size_t label = 0;
+        bool in_run = false;
+        for( int x = 0; x < rw; ++x ) {
+            if( p[x] < 0 ) {
+                in_run = false;
+                continue;
+            }
+            // Runs of pixels along a row belong to one component
+            if( !in_run ) {
+                const int32_t root = RootOf(parent, y * rw + x);
+                const auto it = index.emplace(root, labels.size());
+                if( it.second ) {
+                    PixelClass pc = { -1, IRectangle(offset_x + x, offset_y + y,
+                                                     offset_x + x, offset_y + y), 0 };
+                    labels.push_back(pc);
+                    roots.push_back(root);
+                }
+                label = it.first->second;
+                in_run = true;
+            }
+            labels[label].bbox.Insert(offset_x + x, offset_y + y);
+            ++labels[label].size;
         }
     }
-    
+}
+
+}
+
+void Label( int w, int h, size_t pitch, const unsigned char* I,
+            const IRectangle& region, unsigned char passval,
+            vector<PixelClass>& labels, LabelWorkspace& workspace,
+            unsigned int num_threads )
+{
+    labels.clear();
+    const IRectangle r = region.Clamp(0, 0, w - 1, h - 1);
+    const int rw = r.Width();
+    const int rh = r.Height();
+    if( rw <= 0 || rh <= 0 ) {
+        return;
+    }
+
+    workspace.parent.resize((size_t)rw * rh);
+    int32_t* parent = workspace.parent.data();
+    const unsigned char* roi = I + r.y1 * pitch + r.x1;
+
+    const int bands = std::min<int>(NumWorkerThreads(num_threads), rh);
+    workspace.band_labels.resize(bands);
+    workspace.band_roots.resize(bands);
+    const auto band_begin = [bands, rh](int b) {
+        return (int)((long long)rh * b / bands);
+    };
+
+    ParallelForBands(bands, bands, [&](int b0, int b1) {
+        for( int b = b0; b < b1; ++b ) {
+            LabelBand(rw, band_begin(b), band_begin(b + 1), pitch, roi,
+                      passval, parent);
+        }
+    });
+
+    for( int b = 1; b < bands; ++b ) {
+        JoinRows(rw, band_begin(b), parent);
+    }
+
+    ParallelForBands(bands, bands, [&](int b0, int b1) {
+        for( int b = b0; b < b1; ++b ) {
+            CollectBand(rw, band_begin(b), band_begin(b + 1), r.x1, r.y1,
+                        parent, workspace.band_labels[b],
+                        workspace.band_roots[b]);
+        }
+    });
+
+    // Components spanning bands are found by each of them
+    unordered_map<int32_t, size_t> index;
+    vector<int32_t> roots;
+    for( int b = 0; b < bands; ++b ) {
+        const vector<PixelClass>& band_labels = workspace.band_labels[b];
+        const vector<int32_t>& band_roots = workspace.band_roots[b];
+        for( size_t l = 0; l < band_labels.size(); ++l ) {
+            const auto it = index.emplace(band_roots[l], labels.size());
+            if( it.second ) {
+                labels.push_back(band_labels[l]);
+                roots.push_back(band_roots[l]);
+            }else{
+                PixelClass& pc = labels[it.first->second];
+                pc.bbox.Insert(band_labels[l].bbox);
+                pc.size += band_labels[l].size;
+            }
+        }
+    }
+
+    // Raster order of first pixels is the order of roots
+    vector<size_t> order(labels.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), [&roots](size_t a, size_t b) {
+        return roots[a] < roots[b];
+    });
+    vector<PixelClass> sorted;
+    sorted.reserve(labels.size());
+    for( size_t i : order ) {
+        sorted.push_back(labels[i]);
+    }
+    labels.swap(sorted);
 }
 
 }
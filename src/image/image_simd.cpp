@@ -0,0 +1,430 @@
+/*
+  This file is part of the Calibu Project.
+  https://github.com/gwu-robotics/Calibu
+
+  Copyright (C) 2013 George Washington University,
+  Steven Lovegrove
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+  http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+ */
+
+#include <cstring>
+
+#include <calibu/CpuFeatures.h>
+#include <calibu/image/Gradient.h>
+#include <calibu/image/IntegralImage.h>
+
+#include "image_simd_avx2.h"
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64)
+#  define CALIBU_IMAGE_X86
+#  include <emmintrin.h>
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#  define CALIBU_IMAGE_NEON
+#  include <arm_neon.h>
+#endif
+
+namespace calibu
+{
+
+  namespace
+  {
+    // Gradient of one row for columns [begin, end), given the row and its
+    // neighbours above and below.
+    void GradientRowScalar(
+        const unsigned char* up,
+        const unsigned char* row,
+        const unsigned char* down,
+        int begin,
+        int end,
+        int16_t* dx,
+        int16_t* dy )
+    {
+      for( int x = begin; x < end; ++x ) {
+        dx[x] = (int16_t) (row[x + 1] - row[x - 1]);
+        dy[x] = (int16_t) (down[x] - up[x]);
+      }
+    }
+
+    // Integral image of one row for columns [begin, end), where sum is the
+    // sum of the row's pixels before begin. above is the previous row of the
+    // integral image, or null for the first row.
+    void IntegralRowScalar(
+        const unsigned char* in,
+        const uint32_t* above,
+        int begin,
+        int end,
+        uint32_t sum,
+        uint32_t* out )
+    {
+      for( int x = begin; x < end; ++x ) {
+        sum += in[x];
+        out[x] = above ? sum + above[x] : sum;
+      }
+    }
+
+    void GradientScalar(
+        const unsigned char* up,
+        const unsigned char* row,
+        const unsigned char* down,
+        int w,
+        int16_t* dx,
+        int16_t* dy )
+    {
+      GradientRowScalar( up, row, down, 1, w - 1, dx, dy );
+    }
+
+    void IntegralScalar(
+        const unsigned char* in,
+        const uint32_t* above,
+        int w,
+        uint32_t* out )
+    {
+      IntegralRowScalar( in, above, 0, w, 0, out );
+    }
+
+#ifdef CALIBU_IMAGE_X86
+    // Sixteen pixels per iteration, widened to 16 bits before subtracting.
+    void GradientSse2(
+        const unsigned char* up,
+        const unsigned char* row,
+        const unsigned char* down,
+        int w,
+        int16_t* dx,
+        int16_t* dy )
+    {
+      const __m128i zero = _mm_setzero_si128();
+      int x = 1;
+      for( ; x + 16 <= w - 1; x += 16 ) {
+        const __m128i l = _mm_loadu_si128( (const __m128i*) (row + x - 1) );
+        const __m128i r = _mm_loadu_si128( (const __m128i*) (row + x + 1) );
+        const __m128i u = _mm_loadu_si128( (const __m128i*) (up + x) );
+        const __m128i d = _mm_loadu_si128( (const __m128i*) (down + x) );
+
+        _mm_storeu_si128( (__m128i*) (dx + x), _mm_sub_epi16(
+            _mm_unpacklo_epi8( r, zero ), _mm_unpacklo_epi8( l, zero ) ) );
+        _mm_storeu_si128( (__m128i*) (dx + x + 8), _mm_sub_epi16(
+            _mm_unpackhi_epi8( r, zero ), _mm_unpackhi_epi8( l, zero ) ) );
+        _mm_storeu_si128( (__m128i*) (dy + x), _mm_sub_epi16(
+            _mm_unpacklo_epi8( d, zero ), _mm_unpacklo_epi8( u, zero ) ) );
+        _mm_storeu_si128( (__m128i*) (dy + x + 8), _mm_sub_epi16(
+            _mm_unpackhi_epi8( d, zero ), _mm_unpackhi_epi8( u, zero ) ) );
+      }
+      GradientRowScalar( up, row, down, x, w - 1, dx, dy );
+    }
+
+    // Inclusive prefix sum of four 32 bit lanes.
+    inline __m128i PrefixSum4( __m128i v )
+    {
+      v = _mm_add_epi32( v, _mm_slli_si128( v, 4 ) );
+      return _mm_add_epi32( v, _mm_slli_si128( v, 8 ) );
+    }
+
+    // Eight pixels per iteration. carry holds the running row sum in every
+    // lane.
+    void IntegralSse2(
+        const unsigned char* in,
+        const uint32_t* above,
+        int w,
+        uint32_t* out )
+    {
+      if( !above ) {
+        IntegralScalar( in, above, w, out );
+        return;
+      }
+
+      const __m128i zero = _mm_setzero_si128();
+      __m128i carry = zero;
+      int x = 0;
+      for( ; x + 8 <= w; x += 8 ) {
+        const __m128i words = _mm_unpacklo_epi8(
+            _mm_loadl_epi64( (const __m128i*) (in + x) ), zero );
+        __m128i lo = _mm_add_epi32(
+            PrefixSum4( _mm_unpacklo_epi16( words, zero ) ), carry );
+        carry = _mm_shuffle_epi32( lo, 0xFF );
+        __m128i hi = _mm_add_epi32(
+            PrefixSum4( _mm_unpackhi_epi16( words, zero ) ), carry );
+        carry = _mm_shuffle_epi32( hi, 0xFF );
+
+        lo = _mm_add_epi32( lo, _mm_loadu_si128( (const __m128i*) (above + x) ) );
+        hi = _mm_add_epi32( hi, _mm_loadu_si128( (const __m128i*) (above + x + 4) ) );
+        _mm_storeu_si128( (__m128i*) (out + x), lo );
+        _mm_storeu_si128( (__m128i*) (out + x + 4), hi );
+      }
+      IntegralRowScalar( in, above, x, w,
+                         (uint32_t) _mm_cvtsi128_si32( carry ), out );
+    }
+#endif // CALIBU_IMAGE_X86
+
+#ifdef CALIBU_ISA_AVX2
+    // The AVX2 loops are built in their own translation unit, see
+    // image_simd_avx2.cpp, and finish their rows here.
+    void GradientAvx2(
+        const unsigned char* up,
+        const unsigned char* row,
+        const unsigned char* down,
+        int w,
+        int16_t* dx,
+        int16_t* dy )
+    {
+      const int x = internal::GradientRowAvx2( up, row, down, w, dx, dy );
+      GradientRowScalar( up, row, down, x, w - 1, dx, dy );
+    }
+
+    void IntegralAvx2(
+        const unsigned char* in,
+        const uint32_t* above,
+        int w,
+        uint32_t* out )
+    {
+      if( !above ) {
+        IntegralScalar( in, above, w, out );
+        return;
+      }
+      uint32_t sum;
+      const int x = internal::IntegralRowAvx2( in, above, w, out, &sum );
+      IntegralRowScalar( in, above, x, w, sum, out );
+    }
+#endif // CALIBU_ISA_AVX2
+
+#ifdef CALIBU_IMAGE_NEON
+    // Sixteen pixels per iteration. vsubl wraps to 16 bits, which read as
+    // signed is the exact difference.
+    void GradientNeon(
+        const unsigned char* up,
+        const unsigned char* row,
+        const unsigned char* down,
+        int w,
+        int16_t* dx,
+        int16_t* dy )
+    {
+      int x = 1;
+      for( ; x + 16 <= w - 1; x += 16 ) {
+        const uint8x16_t l = vld1q_u8( row + x - 1 );
+        const uint8x16_t r = vld1q_u8( row + x + 1 );
+        const uint8x16_t u = vld1q_u8( up + x );
+        const uint8x16_t d = vld1q_u8( down + x );
+        vst1q_s16( dx + x, vreinterpretq_s16_u16(
+            vsubl_u8( vget_low_u8( r ), vget_low_u8( l ) ) ) );
+        vst1q_s16( dx + x + 8, vreinterpretq_s16_u16(
+            vsubl_u8( vget_high_u8( r ), vget_high_u8( l ) ) ) );
+        vst1q_s16( dy + x, vreinterpretq_s16_u16(
+            vsubl_u8( vget_low_u8( d ), vget_low_u8( u ) ) ) );
+        vst1q_s16( dy + x + 8, vreinterpretq_s16_u16(
+            vsubl_u8( vget_high_u8( d ), vget_high_u8( u ) ) ) );
+      }
+      GradientRowScalar( up, row, down, x, w - 1, dx, dy );
+    }
+
+    // Eight pixels per iteration, see IntegralSse2.
+    void IntegralNeon(
+        const unsigned char* in,
+        const uint32_t* above,
+        int w,
+        uint32_t* out )
+    {
+      if( !above ) {
+        IntegralScalar( in, above, w, out );
+        return;
+      }
+
+      const uint32x4_t zero = vdupq_n_u32( 0 );
+      uint32x4_t carry = zero;
+      int x = 0;
+      for( ; x + 8 <= w; x += 8 ) {
+        const uint16x8_t words = vmovl_u8( vld1_u8( in + x ) );
+        for( int half = 0; half < 2; ++half ) {
+          uint32x4_t v = vmovl_u16( half ? vget_high_u16( words )
+                                         : vget_low_u16( words ) );
+          v = vaddq_u32( v, vextq_u32( zero, v, 3 ) );
+          v = vaddq_u32( v, vextq_u32( zero, v, 2 ) );
+          v = vaddq_u32( v, carry );
+          carry = vdupq_n_u32( vgetq_lane_u32( v, 3 ) );
+
+          const int k = x + 4 * half;
+          vst1q_u32( out + k, vaddq_u32( v, vld1q_u32( above + k ) ) );
+        }
+      }
+      IntegralRowScalar( in, above, x, w, vgetq_lane_u32( carry, 0 ), out );
+    }
+#endif // CALIBU_IMAGE_NEON
+
+    typedef void (*GradientRowFunction)( const unsigned char*,
+                                         const unsigned char*,
+                                         const unsigned char*,
+                                         int,
+                                         int16_t*,
+                                         int16_t* );
+
+    typedef void (*IntegralRowFunction)( const unsigned char*,
+                                         const uint32_t*,
+                                         int,
+                                         uint32_t* );
+
+    ImageKernel ResolveKernel( ImageKernel kernel )
+    {
+      if( kernel == IMAGE_KERNEL_AUTO ) {
+        return BestImageKernel();
+      }
+      return ImageKernelSupported( kernel ) ? kernel : IMAGE_KERNEL_SCALAR;
+    }
+
+    GradientRowFunction GradientFunction( ImageKernel kernel )
+    {
+      switch( kernel ) {
+#ifdef CALIBU_IMAGE_X86
+        case IMAGE_KERNEL_SSE2:
+          return GradientSse2;
+#endif
+#ifdef CALIBU_ISA_AVX2
+        case IMAGE_KERNEL_AVX2:
+          return GradientAvx2;
+#endif
+#ifdef CALIBU_IMAGE_NEON
+        case IMAGE_KERNEL_NEON:
+          return GradientNeon;
+#endif
+        default:
+          return GradientScalar;
+      }
+    }
+
+    IntegralRowFunction IntegralFunction( ImageKernel kernel )
+    {
+      switch( kernel ) {
+#ifdef CALIBU_IMAGE_X86
+        case IMAGE_KERNEL_SSE2:
+          return IntegralSse2;
+#endif
+#ifdef CALIBU_ISA_AVX2
+        case IMAGE_KERNEL_AVX2:
+          return IntegralAvx2;
+#endif
+#ifdef CALIBU_IMAGE_NEON
+        case IMAGE_KERNEL_NEON:
+          return IntegralNeon;
+#endif
+        default:
+          return IntegralScalar;
+      }
+    }
+  }
+
+  ///////////////////////////////////////////////////////////////////////////////
+  bool ImageKernelSupported( ImageKernel kernel )
+  {
+    switch( kernel ) {
+      case IMAGE_KERNEL_SCALAR:
+        return true;
+#ifdef CALIBU_IMAGE_X86
+      case IMAGE_KERNEL_SSE2:
+        return CpuSupports( CPU_FEATURE_SSE2 );
+#endif
+#ifdef CALIBU_ISA_AVX2
+      case IMAGE_KERNEL_AVX2:
+        return CpuSupports( CPU_FEATURE_AVX2 );
+#endif
+#ifdef CALIBU_IMAGE_NEON
+      case IMAGE_KERNEL_NEON:
+        return true;
+#endif
+      default:
+        return false;
+    }
+  }
+
+  ///////////////////////////////////////////////////////////////////////////////
+  ImageKernel BestImageKernel()
+  {
+    static const ImageKernel best = [](){
+      const ImageKernel preferred[] = { IMAGE_KERNEL_AVX2,
+                                        IMAGE_KERNEL_NEON,
+                                        IMAGE_KERNEL_SSE2 };
+      for( ImageKernel kernel : preferred ) {
+        if( ImageKernelSupported( kernel ) ) {
+          return kernel;
+        }
+      }
+      return IMAGE_KERNEL_SCALAR;
+    }();
+    return best;
+  }
+
+  ///////////////////////////////////////////////////////////////////////////////
+  void GradientPlanar(
+      int w,
+      int h,
+      size_t pitch,
+      const unsigned char* I,
+      int16_t* dx,
+      int16_t* dy,
+      ImageKernel kernel
+      )
+  {
+    GradientPlanar( w, h, pitch, I, dx, dy, (size_t) w, kernel );
+  }
+
+  ///////////////////////////////////////////////////////////////////////////////
+  void GradientPlanar(
+      int w,
+      int h,
+      size_t pitch,
+      const unsigned char* I,
+      int16_t* dx,
+      int16_t* dy,
+      size_t stride,
+      ImageKernel kernel
+      )
+  {
+    if( w <= 0 || h <= 0 ) {
+      return;
+    }
+
+    const GradientRowFunction function = GradientFunction( ResolveKernel( kernel ) );
+
+    // First and last rows have no vertical neighbour on one side
+    memset( dx, 0, w * sizeof(int16_t) );
+    memset( dy, 0, w * sizeof(int16_t) );
+    memset( dx + (h - 1) * stride, 0, w * sizeof(int16_t) );
+    memset( dy + (h - 1) * stride, 0, w * sizeof(int16_t) );
+
+    for( int y = 1; y < h - 1; ++y ) {
+      const unsigned char* row = I + y * pitch;
+      int16_t* row_dx = dx + y * stride;
+      int16_t* row_dy = dy + y * stride;
+      function( row - pitch, row, row + pitch, w, row_dx, row_dy );
+      row_dx[0] = row_dy[0] = 0;
+      row_dx[w - 1] = row_dy[w - 1] = 0;
+    }
+  }
+
+  ///////////////////////////////////////////////////////////////////////////////
+  void IntegralImage(
+      int w,
+      int h,
+      size_t pitch,
+      const unsigned char* in,
+      uint32_t* out,
+      ImageKernel kernel
+      )
+  {
+    const IntegralRowFunction function = IntegralFunction( ResolveKernel( kernel ) );
+    for( int y = 0; y < h; ++y ) {
+      uint32_t* row_out = out + (size_t) y * w;
+      function( in + y * pitch, y > 0 ? row_out - w : nullptr, w, row_out );
+    }
+  }
+
+} // end namespace
@@ -0,0 +1,88 @@
+/*
+  This file is part of the Calibu Project.
+  https://github.com/gwu-robotics/Calibu
+
+  Copyright (C) 2013 George Washington University,
+  Steven Lovegrove
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+  http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+ */
+
+
+// Built with AVX2 enabled when CALIBU_ISA_AVX2 is set, and only called
+// once CpuSupports( CPU_FEATURE_AVX2 ).
+
+#include <immintrin.h>
+
+#include "image_simd_avx2.h"
+
+namespace calibu
+{
+  namespace internal
+  {
+    // Sixteen pixels per iteration, widened with vpmovzxbw.
+    int GradientRowAvx2(
+        const unsigned char* up,
+        const unsigned char* row,
+        const unsigned char* down,
+        int w,
+        int16_t* dx,
+        int16_t* dy )
+    {
+      int x = 1;
+      for( ; x + 16 <= w - 1; x += 16 ) {
+        const __m256i l = _mm256_cvtepu8_epi16(
+            _mm_loadu_si128( (const __m128i*) (row + x - 1) ) );
+        const __m256i r = _mm256_cvtepu8_epi16(
+            _mm_loadu_si128( (const __m128i*) (row + x + 1) ) );
+        const __m256i u = _mm256_cvtepu8_epi16(
+            _mm_loadu_si128( (const __m128i*) (up + x) ) );
+        const __m256i d = _mm256_cvtepu8_epi16(
+            _mm_loadu_si128( (const __m128i*) (down + x) ) );
+        _mm256_storeu_si256( (__m256i*) (dx + x), _mm256_sub_epi16( r, l ) );
+        _mm256_storeu_si256( (__m256i*) (dy + x), _mm256_sub_epi16( d, u ) );
+      }
+      return x;
+    }
+
+    // Eight pixels per iteration. The prefix sum runs within each 128 bit
+    // lane, then the low lane's total is carried into the high lane.
+    int IntegralRowAvx2(
+        const unsigned char* in,
+        const uint32_t* above,
+        int w,
+        uint32_t* out,
+        uint32_t* sum )
+    {
+      const __m256i last = _mm256_set1_epi32( 7 );
+      __m256i carry = _mm256_setzero_si256();
+      int x = 0;
+      for( ; x + 8 <= w; x += 8 ) {
+        __m256i v = _mm256_cvtepu8_epi32(
+            _mm_loadl_epi64( (const __m128i*) (in + x) ) );
+        v = _mm256_add_epi32( v, _mm256_slli_si256( v, 4 ) );
+        v = _mm256_add_epi32( v, _mm256_slli_si256( v, 8 ) );
+        v = _mm256_add_epi32( v, _mm256_shuffle_epi32(
+            _mm256_permute2x128_si256( v, v, 0x08 ), 0xFF ) );
+        v = _mm256_add_epi32( v, carry );
+        carry = _mm256_permutevar8x32_epi32( v, last );
+
+        v = _mm256_add_epi32(
+            v, _mm256_loadu_si256( (const __m256i*) (above + x) ) );
+        _mm256_storeu_si256( (__m256i*) (out + x), v );
+      }
+      *sum = (uint32_t) _mm_cvtsi128_si32( _mm256_castsi256_si128( carry ) );
+      return x;
+    }
+  }
+}
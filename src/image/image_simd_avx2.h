@@ -0,0 +1,50 @@
+/*
+  This file is part of the Calibu Project.
+  https://github.com/gwu-robotics/Calibu
+
+  Copyright (C) 2013 George Washington University,
+  Steven Lovegrove
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+  http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+ */
+
+
+#pragma once
+
+#include <cstdint>
+
+namespace calibu
+{
+  namespace internal
+  {
+    /// Vectorized part of a gradient row, see GradientPlanar. Returns the
+    /// column from which the rest of the row is still to be computed.
+    int GradientRowAvx2(
+        const unsigned char* up,
+        const unsigned char* row,
+        const unsigned char* down,
+        int w,
+        int16_t* dx,
+        int16_t* dy );
+
+    /// Vectorized part of an integral image row below the row above.
+    /// Returns the column from which the rest of the row is still to be
+    /// computed, and in sum the row's sum of the pixels before it.
+    int IntegralRowAvx2(
+        const unsigned char* in,
+        const uint32_t* above,
+        int w,
+        uint32_t* out,
+        uint32_t* sum );
+  }
+}
@@ -1,5 +1,14 @@
+#include <calibu/CpuFeatures.h>
 #include <calibu/pcalib/base64.h>
 #include <Eigen/Eigen>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64)
+#  if defined(__GNUC__)
+#    define CALIBU_BASE64_AVX2
+#    include <immintrin.h>
+#  endif
+#endif
 
 namespace calibu
 {
@@ -34,45 +43,380 @@ const uint8_t Base64::decoding_map[] =
 
 ////////////////////////////////////////////////////////////////////////////////
 
-Base64Encoder::Base64Encoder()
+void DoubleEncoder::Encode(const double* data, size_t count, uint8_t* bytes)
 {
-}
+  const bool native = std::numeric_limits<double>::is_iec559 &&
+      sizeof(double) == sizeof(uint64_t);
 
-template <>
-Base64Encoder& Base64Encoder::operator<<(const Eigen::MatrixXd& value)
-{
-  // allocate encoding buffer
+  for (size_t i = 0; i < count; ++i)
+  {
+    uint64_t result;
+    uint64_t bits = 0;
+    if (native) std::memcpy(&bits, &data[i], sizeof(bits));
+    const uint64_t exp = (bits >> 52) & max_exp;
 
-  std::vector<uint8_t> buffer(sizeof(uint64_t) * value.size());
-  uint64_t* pointer = reinterpret_cast<uint64_t*>(buffer.data());
+    // For normal values the encoding follows from the native bits: the
+    // frexp exponent is one above the IEEE-754 one, and scaling the
+    // significand by max_sig rather than 2^52 takes one off it unless zero
+
+    if (native && exp != 0 && exp != max_exp)
+    {
+      const uint64_t sig = bits & max_sig;
+      result = (bits & ~(max_exp << 52 | max_sig)) | (exp + 1) << 52 |
+          (sig ? sig - 1 : 0);
+
+      Format(result);
+    }
+    else
+    {
+      result = Encode(data[i]);
+    }
+
+    std::memcpy(bytes + sizeof(uint64_t) * i, &result, sizeof(result));
+  }
+}
 
-  // encode each cell of matrix
+void DoubleEncoder::Decode(const uint8_t* bytes, size_t count, double* data)
+{
+  const bool native = std::numeric_limits<double>::is_iec559 &&
+      sizeof(double) == sizeof(uint64_t);
 
-  for (int col = 0; col < value.cols(); ++col)
+  for (size_t i = 0; i < count; ++i)
   {
-    for (int row = 0; row < value.rows(); ++row)
+    uint64_t value;
+    std::memcpy(&value, bytes + sizeof(uint64_t) * i, sizeof(value));
+
+    if (native)
     {
-      *pointer = DoubleEncoder::Encode(value(row, col));
-      ++pointer;
+      uint64_t code = value;
+      Format(code);
+
+      if (code != zero && code != qnan && code != pinf && code != ninf)
+      {
+        // Same significand as DecodeNormal, with ldexp replaced by adding
+        // to the exponent bits while the result stays normal
+
+        const double sig = double(code & max_sig) / (2 * max_sig) + 0.5;
+        uint64_t bits;
+        std::memcpy(&bits, &sig, sizeof(bits));
+
+        const int64_t exp = int64_t((bits >> 52) & max_exp) +
+            int64_t((code >> 52) & max_exp) - exp_bias;
+
+        if (exp > 0 && exp < int64_t(max_exp))
+        {
+          bits = (code & ~(max_exp << 52 | max_sig)) | uint64_t(exp) << 52 |
+              (bits & max_sig);
+
+          std::memcpy(&data[i], &bits, sizeof(bits));
+          continue;
+        }
+      }
     }
+
+    data[i] = Decode(value);
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+namespace
+{
+
+void EncodeScalar(const uint8_t* encoding_map, const uint8_t* data,
+    size_t count, char* result)
+{
+  const size_t size = Base64::GetEncodingSize(count);
+
+  // encode all complete 3-byte tuples
+
+  for (size_t i = 0; i < count / 3; ++i)
+  {
+    const uint8_t v0 = data[3 * i + 0];
+    const uint8_t v1 = data[3 * i + 1];
+    const uint8_t v2 = data[3 * i + 2];
+    result[4 * i + 0] = encoding_map[v0 >> 2];
+    result[4 * i + 1] = encoding_map[(v0 << 4 | v1 >> 4) & 0x3F];
+    result[4 * i + 2] = encoding_map[(v1 << 2 | v2 >> 6) & 0x3F];
+    result[4 * i + 3] = encoding_map[v2 & 0x3F];
+  }
+
+  // encode any partial 3-byte tuples
+
+  if (count % 3 == 1)
+  {
+    const uint8_t v0 = data[count - 1];
+    result[size - 2] = encoding_map[v0 >> 2];
+    result[size - 1] = encoding_map[(v0 << 4) & 0x3F];
+  }
+  else if (count % 3 == 2)
+  {
+    const uint8_t v0 = data[count - 2];
+    const uint8_t v1 = data[count - 1];
+    result[size - 3] = encoding_map[v0 >> 2];
+    result[size - 2] = encoding_map[(v0 << 4 | v1 >> 4) & 0x3F];
+    result[size - 1] = encoding_map[(v1 << 2) & 0x3F];
+  }
+}
+
+void DecodeScalar(const uint8_t* decoding_map, const char* data,
+    size_t count, uint8_t* result)
+{
+  const size_t size = Base64::GetDecodingSize(count);
+
+  // decode all complete 4-char tuples
+
+  for (size_t i = 0; i < count / 4; ++i)
+  {
+    const uint8_t v0 = decoding_map[uint8_t(data[4 * i + 0])];
+    const uint8_t v1 = decoding_map[uint8_t(data[4 * i + 1])];
+    const uint8_t v2 = decoding_map[uint8_t(data[4 * i + 2])];
+    const uint8_t v3 = decoding_map[uint8_t(data[4 * i + 3])];
+    result[3 * i + 0] = v0 << 2 | v1 >> 4;
+    result[3 * i + 1] = v1 << 4 | v2 >> 2;
+    result[3 * i + 2] = v2 << 6 | v3 >> 0;
+  }
+
+  // decode any partial 4-char tuples
+
+  if (count % 4 == 1)
+  {
+    const uint8_t v0 = decoding_map[uint8_t(data[count - 1])];
+    result[size - 1] = v0 << 2;
+  }
+  else if (count % 4 == 2)
+  {
+    const uint8_t v0 = decoding_map[uint8_t(data[count - 2])];
+    const uint8_t v1 = decoding_map[uint8_t(data[count - 1])];
+    result[size - 2] = v0 << 2 | v1 >> 4;
+    result[size - 1] = v1 << 4;
+  }
+  else if (count % 4 == 3)
+  {
+    const uint8_t v0 = decoding_map[uint8_t(data[count - 3])];
+    const uint8_t v1 = decoding_map[uint8_t(data[count - 2])];
+    const uint8_t v2 = decoding_map[uint8_t(data[count - 1])];
+    result[size - 3] = v0 << 2 | v1 >> 4;
+    result[size - 2] = v1 << 4 | v2 >> 2;
+    result[size - 1] = v2 << 6;
+  }
+}
+
+#ifdef CALIBU_BASE64_AVX2
+
+/**
+ * Encodes 24 bytes into 32 characters per iteration (W. Mula, "Base64
+ * encoding with SIMD instructions"), returning the number of bytes encoded
+ */
+__attribute__((target("avx2")))
+size_t EncodeAvx2(const uint8_t* data, size_t count, char* result)
+{
+  // repeat the middle byte of each 3-byte tuple: [b1, b0, b2, b1]
+
+  const __m256i shuffle = _mm256_setr_epi8(
+      1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10,
+      1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10);
+
+  // offset from 6-bit value to character, indexed by the value range
+
+  const __m256i offsets = _mm256_setr_epi8(
+      'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+      '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62,
+      '/' - 63, 'A', 0, 0,
+      'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+      '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62,
+      '/' - 63, 'A', 0, 0);
+
+  size_t i = 0;
+
+  // each lane reads 16 bytes for its 12, so stop short of the end
+
+  for (; i + 28 <= count; i += 24)
+  {
+    const __m128i lo = _mm_loadu_si128((const __m128i*)(data + i));
+    const __m128i hi = _mm_loadu_si128((const __m128i*)(data + i + 12));
+    __m256i in = _mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1);
+    in = _mm256_shuffle_epi8(in, shuffle);
+
+    // move each 6-bit value into its own byte
+
+    const __m256i ac = _mm256_mulhi_epu16(
+        _mm256_and_si256(in, _mm256_set1_epi32(0x0FC0FC00)),
+        _mm256_set1_epi32(0x04000040));
+
+    const __m256i bd = _mm256_mullo_epi16(
+        _mm256_and_si256(in, _mm256_set1_epi32(0x003F03F0)),
+        _mm256_set1_epi32(0x01000010));
+
+    const __m256i values = _mm256_or_si256(ac, bd);
+
+    // map 0-25 to 13, 26-51 to 0 and 52-63 to 1-12, then add the offset
+
+    __m256i range = _mm256_subs_epu8(values, _mm256_set1_epi8(51));
+    const __m256i upper = _mm256_cmpgt_epi8(_mm256_set1_epi8(26), values);
+    range = _mm256_or_si256(range, _mm256_and_si256(upper,
+        _mm256_set1_epi8(13)));
+
+    const __m256i chars = _mm256_add_epi8(values,
+        _mm256_shuffle_epi8(offsets, range));
+
+    _mm256_storeu_si256((__m256i*)(result + i / 3 * 4), chars);
+  }
+
+  return i;
+}
+
+/**
+ * Decodes 32 characters into 24 bytes per iteration (W. Mula, D. Lemire,
+ * "Faster Base64 Encoding and Decoding using AVX2 Instructions"), returning
+ * the number of characters decoded. Stops at the first block holding a
+ * character outside the alphabet, which is left to the scalar decoder.
+ */
+__attribute__((target("avx2")))
+size_t DecodeAvx2(const char* data, size_t count, uint8_t* result)
+{
+  // bit sets of the valid high nibbles, indexed by low and high nibble
+
+  const __m256i valid_lo = _mm256_setr_epi8(
+      0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+      0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A,
+      0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+      0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A);
+
+  const __m256i valid_hi = _mm256_setr_epi8(
+      0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+      0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+      0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+      0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+
+  // offset from character to 6-bit value, by high nibble ('/' is index 1)
+
+  const __m256i offsets = _mm256_setr_epi8(
+      0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0,
+      0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+
+  const __m256i slash = _mm256_set1_epi8(0x2F);
+
+  // pack each 3 bytes of a 32-bit word to the front of its lane
+
+  const __m256i pack = _mm256_setr_epi8(
+      2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1,
+      2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+
+  const __m256i order = _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 3, 7);
+
+  alignas(32) uint8_t buffer[32];
+  size_t i = 0;
+
+  for (; i + 32 <= count; i += 32)
+  {
+    __m256i in = _mm256_loadu_si256((const __m256i*)(data + i));
+
+    // validate characters, masking nibbles with 0x2F as pshufb only
+    // looks at the low four bits and bit seven
+
+    const __m256i hi_nibbles =
+        _mm256_and_si256(_mm256_srli_epi32(in, 4), slash);
+    const __m256i lo_nibbles = _mm256_and_si256(in, slash);
+    const __m256i lo = _mm256_shuffle_epi8(valid_lo, lo_nibbles);
+    const __m256i hi = _mm256_shuffle_epi8(valid_hi, hi_nibbles);
+    if (!_mm256_testz_si256(lo, hi)) break;
+
+    // map characters to 6-bit values
+
+    const __m256i is_slash = _mm256_cmpeq_epi8(in, slash);
+    in = _mm256_add_epi8(in, _mm256_shuffle_epi8(offsets,
+        _mm256_add_epi8(is_slash, hi_nibbles)));
+
+    // merge four 6-bit values into three bytes per 32-bit word
+
+    in = _mm256_maddubs_epi16(in, _mm256_set1_epi32(0x01400140));
+    in = _mm256_madd_epi16(in, _mm256_set1_epi32(0x00011000));
+    in = _mm256_shuffle_epi8(in, pack);
+    in = _mm256_permutevar8x32_epi32(in, order);
+
+    _mm256_store_si256((__m256i*)buffer, in);
+    std::memcpy(result + i / 4 * 3, buffer, 24);
   }
 
-  // write encoding to stream
+  return i;
+}
+
+#endif // CALIBU_BASE64_AVX2
 
-  stream_ << Base64::Encode(buffer);
+typedef size_t (*EncodeFunction)(const uint8_t*, size_t, char*);
+typedef size_t (*DecodeFunction)(const char*, size_t, uint8_t*);
+
+// Leave all of the data to the scalar code
+size_t EncodeNone(const uint8_t*, size_t, char*)
+{
+  return 0;
+}
+
+size_t DecodeNone(const char*, size_t, uint8_t*)
+{
+  return 0;
+}
+
+} // namespace
+
+void Base64::Encode(const uint8_t* data, size_t count, char* chars)
+{
+  static const EncodeFunction encode = SelectKernel<EncodeFunction>({
+#ifdef CALIBU_BASE64_AVX2
+      {CPU_FEATURE_AVX2, EncodeAvx2},
+#endif
+      {0, EncodeNone}});
+
+  const size_t done = encode(data, count, chars);
+  EncodeScalar(encoding_map, data + done, count - done, chars + done / 3 * 4);
+}
+
+void Base64::Decode(const char* data, size_t count, uint8_t* bytes)
+{
+  static const DecodeFunction decode = SelectKernel<DecodeFunction>({
+#ifdef CALIBU_BASE64_AVX2
+      {CPU_FEATURE_AVX2, DecodeAvx2},
+#endif
+      {0, DecodeNone}});
+
+  const size_t done = decode(data, count, bytes);
+  DecodeScalar(decoding_map, data + done, count - done, bytes + done / 4 * 3);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+Base64Encoder::Base64Encoder()
+{
+}
+
+template <>
+Base64Encoder& Base64Encoder::operator<<(const Eigen::MatrixXd& value)
+{
+  // encode all cells of the column-major matrix at once
+
+  std::vector<uint8_t> buffer(sizeof(uint64_t) * value.size());
+  DoubleEncoder::Encode(value.data(), value.size(), buffer.data());
+
+  // append encoding to data
+
+  const size_t offset = data_.size();
+  data_.resize(offset + Base64::GetEncodingSize(buffer.size()));
+  Base64::Encode(buffer.data(), buffer.size(), &data_[offset]);
 
   return *this;
 }
 
 std::string Base64Encoder::str() const
 {
-  return stream_.str();
+  return data_;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 
-Base64Decoder::Base64Decoder(const std::string data) :
-  stream_(data)
+Base64Decoder::Base64Decoder(std::string data) :
+  data_(std::move(data)),
+  offset_(0)
 {
 }
 
@@ -80,24 +424,16 @@ template <>
 Base64Decoder& Base64Decoder::operator>>(Eigen::MatrixXd& value)
 {
   const size_t bytes = sizeof(uint64_t) * value.size();
-  const size_t chars = Base64::GetEncodingSize(bytes);
-
-  std::vector<char> encoding(chars);
-  stream_.read(encoding.data(), chars);
+  const size_t chars = std::min(Base64::GetEncodingSize(bytes),
+      data_.size() - offset_);
 
-  const std::vector<uint8_t> data = Base64::Decode(encoding);
-  const uint64_t* pointer = reinterpret_cast<const uint64_t*>(data.data());
+  std::vector<uint8_t> data(std::max(bytes, Base64::GetDecodingSize(chars)));
+  Base64::Decode(data_.data() + offset_, chars, data.data());
+  offset_ += chars;
 
-  // decode each cell of matrix
+  // decode all cells of the column-major matrix at once
 
-  for (int col = 0; col < value.cols(); ++col)
-  {
-    for (int row = 0; row < value.rows(); ++row)
-    {
-      value(row, col) = DoubleEncoder::Decode(*pointer);
-      ++pointer;
-    }
-  }
+  DoubleEncoder::Decode(data.data(), value.size(), value.data());
 
   return *this;
 }
@@ -0,0 +1,347 @@
+#include <calibu/pcalib/pcalib_sidecar.h>
+#include <cstring>
+#include <fstream>
+#include <vector>
+#include <calibu/exception.h>
+
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+namespace calibu
+{
+
+namespace
+{
+
+/** Identifies sidecar files */
+const char sidecar_magic[8] = { 'C', 'A', 'L', 'I', 'B', 'U', 'V', 'S' };
+
+/** Current sidecar file version */
+const uint32_t sidecar_version = 1;
+
+/** Size of the sidecar header in bytes */
+const size_t sidecar_header_size = 32;
+
+/** Number of values converted at once */
+const size_t sidecar_chunk = 1 << 16;
+
+/** Compression of the values following the header */
+enum SidecarCompression
+{
+  SIDECAR_RAW = 0,
+  SIDECAR_DEFLATE = 1,
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+inline void PutUint32(uint32_t value, uint8_t* bytes)
+{
+  for (int i = 0; i < 4; ++i) bytes[i] = uint8_t(value >> (8 * i));
+}
+
+inline uint32_t GetUint32(const uint8_t* bytes)
+{
+  uint32_t value = 0;
+  for (int i = 0; i < 4; ++i) value |= uint32_t(bytes[i]) << (8 * i);
+  return value;
+}
+
+/**
+ * Converts a float to half precision, rounding to nearest even
+ * (F. Giesen, "float->half variants")
+ */
+inline uint16_t FloatToHalf(float value)
+{
+  uint32_t bits;
+  std::memcpy(&bits, &value, sizeof(bits));
+  const uint32_t sign = bits & 0x80000000u;
+  bits ^= sign;
+
+  uint32_t result;
+
+  if (bits >= 0x47800000u)
+  {
+    // too large, infinite or nan
+    result = (bits > 0x7F800000u) ? 0x7E00 : 0x7C00;
+  }
+  else if (bits < 0x38800000u)
+  {
+    // subnormal or zero: let float addition round the mantissa
+    float sum;
+    const uint32_t magic = 126u << 23;
+    std::memcpy(&sum, &bits, sizeof(sum));
+    float offset;
+    std::memcpy(&offset, &magic, sizeof(offset));
+    sum += offset;
+    std::memcpy(&result, &sum, sizeof(result));
+    result -= magic;
+  }
+  else
+  {
+    // normal: rebias the exponent and round the dropped mantissa bits
+    const uint32_t odd = (bits >> 13) & 1;
+    bits += ((15u - 127u) << 23) + 0xFFF + odd;
+    result = bits >> 13;
+  }
+
+  return uint16_t((sign >> 16) | result);
+}
+
+/**
+ * Converts a half precision value to float
+ */
+inline float HalfToFloat(uint16_t value)
+{
+  const uint32_t exp_mask = 0x7C00u << 13;
+  uint32_t bits = uint32_t(value & 0x7FFF) << 13;
+  const uint32_t exp = bits & exp_mask;
+  bits += (127u - 15u) << 23;
+
+  if (exp == exp_mask)
+  {
+    // infinite or nan
+    bits += (128u - 16u) << 23;
+  }
+  else if (exp == 0)
+  {
+    // zero or subnormal: renormalize with float subtraction
+    const uint32_t magic = 113u << 23;
+    bits += 1u << 23;
+    float result, offset;
+    std::memcpy(&result, &bits, sizeof(result));
+    std::memcpy(&offset, &magic, sizeof(offset));
+    result -= offset;
+    std::memcpy(&bits, &result, sizeof(bits));
+  }
+
+  bits |= uint32_t(value & 0x8000) << 16;
+  float result;
+  std::memcpy(&result, &bits, sizeof(result));
+  return result;
+}
+
+inline size_t GetValueSize(SidecarFormat format)
+{
+  return (format == SIDECAR_FLOAT16) ? 2 : 4;
+}
+
+void EncodeValues(const double* values, size_t count, SidecarFormat format,
+    uint8_t* bytes)
+{
+  for (size_t i = 0; i < count; ++i)
+  {
+    if (format == SIDECAR_FLOAT16)
+    {
+      const uint16_t half = FloatToHalf(float(values[i]));
+      bytes[2 * i + 0] = uint8_t(half);
+      bytes[2 * i + 1] = uint8_t(half >> 8);
+    }
+    else
+    {
+      const float value = float(values[i]);
+      uint32_t bits;
+      std::memcpy(&bits, &value, sizeof(bits));
+      PutUint32(bits, bytes + 4 * i);
+    }
+  }
+}
+
+void DecodeValues(const uint8_t* bytes, size_t count, SidecarFormat format,
+    double* values)
+{
+  for (size_t i = 0; i < count; ++i)
+  {
+    if (format == SIDECAR_FLOAT16)
+    {
+      const uint16_t half = bytes[2 * i + 0] | uint16_t(bytes[2 * i + 1]) << 8;
+      values[i] = HalfToFloat(half);
+    }
+    else
+    {
+      const uint32_t bits = GetUint32(bytes + 4 * i);
+      float value;
+      std::memcpy(&value, &bits, sizeof(value));
+      values[i] = value;
+    }
+  }
+}
+
+} // namespace
+
+////////////////////////////////////////////////////////////////////////////////
+
+void WriteSidecar(const std::string& filename, const Eigen::VectorXd& params,
+    SidecarFormat format)
+{
+  CALIBU_ASSERT_DESC(format == SIDECAR_FLOAT32 || format == SIDECAR_FLOAT16,
+      "invalid sidecar format");
+
+#ifdef HAVE_ZLIB
+  const SidecarCompression compression = SIDECAR_DEFLATE;
+#else
+  const SidecarCompression compression = SIDECAR_RAW;
+#endif
+
+  std::ofstream file(filename, std::ios::binary | std::ios::trunc);
+  CALIBU_ASSERT_DESC(file, "unable to write sidecar file: " + filename);
+
+  // write header
+
+  const uint64_t count = params.size();
+  uint8_t header[sidecar_header_size] = {};
+  std::memcpy(header, sidecar_magic, sizeof(sidecar_magic));
+  PutUint32(sidecar_version, header + 8);
+  PutUint32(format, header + 12);
+  PutUint32(compression, header + 16);
+  PutUint32(uint32_t(count), header + 24);
+  PutUint32(uint32_t(count >> 32), header + 28);
+  file.write(reinterpret_cast<const char*>(header), sizeof(header));
+
+  // write values one chunk at a time
+
+  const size_t value_size = GetValueSize(format);
+  std::vector<uint8_t> buffer(value_size * sidecar_chunk);
+
+#ifdef HAVE_ZLIB
+  std::vector<uint8_t> output(buffer.size());
+  z_stream stream = {};
+  CALIBU_ASSERT_DESC(deflateInit(&stream, Z_DEFAULT_COMPRESSION) == Z_OK,
+      "unable to initialize compression");
+#endif
+
+  size_t offset = 0;
+
+  do
+  {
+    const size_t values = std::min<size_t>(sidecar_chunk, count - offset);
+    EncodeValues(params.data() + offset, values, format, buffer.data());
+    offset += values;
+
+#ifdef HAVE_ZLIB
+    const int flush = (offset == count) ? Z_FINISH : Z_NO_FLUSH;
+    stream.next_in = buffer.data();
+    stream.avail_in = uInt(value_size * values);
+
+    do
+    {
+      stream.next_out = output.data();
+      stream.avail_out = uInt(output.size());
+      deflate(&stream, flush);
+      file.write(reinterpret_cast<const char*>(output.data()),
+          output.size() - stream.avail_out);
+    }
+    while (stream.avail_out == 0);
+#else
+    file.write(reinterpret_cast<const char*>(buffer.data()),
+        value_size * values);
+#endif
+  }
+  while (offset < count);
+
+#ifdef HAVE_ZLIB
+  deflateEnd(&stream);
+#endif
+
+  CALIBU_ASSERT_DESC(file, "unable to write sidecar file: " + filename);
+}
+
+void ReadSidecar(const std::string& filename, Eigen::VectorXd& params)
+{
+  std::ifstream file(filename, std::ios::binary);
+  CALIBU_ASSERT_DESC(file, "unable to read sidecar file: " + filename);
+
+  // read and validate header
+
+  uint8_t header[sidecar_header_size];
+  file.read(reinterpret_cast<char*>(header), sizeof(header));
+
+  CALIBU_ASSERT_DESC(file && !std::memcmp(header, sidecar_magic,
+      sizeof(sidecar_magic)), "invalid sidecar file: " + filename);
+
+  CALIBU_ASSERT_DESC(GetUint32(header + 8) == sidecar_version,
+      "unsupported sidecar version: " + filename);
+
+  const SidecarFormat format = SidecarFormat(GetUint32(header + 12));
+  const uint32_t compression = GetUint32(header + 16);
+  const uint64_t count = GetUint32(header + 24) |
+      uint64_t(GetUint32(header + 28)) << 32;
+
+  CALIBU_ASSERT_DESC(format == SIDECAR_FLOAT32 || format == SIDECAR_FLOAT16,
+      "invalid sidecar format: " + filename);
+
+  CALIBU_ASSERT_DESC(count == uint64_t(params.size()),
+      "invalid sidecar param count: " + filename);
+
+#ifdef HAVE_ZLIB
+  CALIBU_ASSERT_DESC(compression == SIDECAR_RAW ||
+      compression == SIDECAR_DEFLATE, "invalid sidecar file: " + filename);
+#else
+  CALIBU_ASSERT_DESC(compression == SIDECAR_RAW,
+      "compressed sidecar requires zlib: " + filename);
+#endif
+
+  // decode values one chunk at a time
+
+  const size_t value_size = GetValueSize(format);
+  std::vector<uint8_t> buffer(value_size * sidecar_chunk);
+
+#ifdef HAVE_ZLIB
+  std::vector<uint8_t> input(buffer.size());
+  z_stream stream = {};
+  CALIBU_ASSERT_DESC(inflateInit(&stream) == Z_OK,
+      "unable to initialize decompression");
+#endif
+
+  size_t offset = 0;
+  bool valid = true;
+
+  while (valid && offset < count)
+  {
+    const size_t values = std::min<size_t>(sidecar_chunk, count - offset);
+    const size_t bytes = value_size * values;
+
+    if (compression == SIDECAR_RAW)
+    {
+      valid = bool(file.read(reinterpret_cast<char*>(buffer.data()), bytes));
+    }
+#ifdef HAVE_ZLIB
+    else
+    {
+      // inflate until the chunk is full, reading input as needed
+
+      stream.next_out = buffer.data();
+      stream.avail_out = uInt(bytes);
+
+      while (valid && stream.avail_out > 0)
+      {
+        if (stream.avail_in == 0)
+        {
+          file.read(reinterpret_cast<char*>(input.data()), input.size());
+          stream.next_in = input.data();
+          stream.avail_in = uInt(file.gcount());
+        }
+
+        // fails on corrupt data, or input ending before the values do
+        const int status = inflate(&stream, Z_NO_FLUSH);
+        valid = status == Z_OK ||
+            (status == Z_STREAM_END && stream.avail_out == 0);
+      }
+    }
+#endif
+
+    if (valid)
+    {
+      DecodeValues(buffer.data(), values, format, params.data() + offset);
+      offset += values;
+    }
+  }
+
+#ifdef HAVE_ZLIB
+  inflateEnd(&stream);
+#endif
+
+  CALIBU_ASSERT_DESC(valid, "truncated sidecar file: " + filename);
+}
+
+} // namespace calibu
@@ -6,6 +6,7 @@
 #include <calibu/pcalib/response_linear.h>
 #include <calibu/pcalib/response_poly.h>
 #include <calibu/pcalib/vignetting_dense.h>
+#include <calibu/pcalib/vignetting_grid.h>
 #include <calibu/pcalib/vignetting_poly.h>
 #include <calibu/pcalib/vignetting_uniform.h>
 
@@ -14,6 +15,22 @@
 namespace calibu
 {
 
+namespace
+{
+
+/**
+ * Returns the directory of the given file path, including its separator
+ * @param filename file path
+ * @return directory of file path, or empty if there is none
+ */
+std::string GetDirectory(const std::string& filename)
+{
+  const size_t slash = filename.find_last_of("/\\");
+  return (slash == std::string::npos) ? "" : filename.substr(0, slash + 1);
+}
+
+} // namespace
+
 ////////////////////////////////////////////////////////////////////////////////
 
 PhotoRigReader::PhotoRigReader(const std::string& filename) :
@@ -149,15 +166,46 @@ std::shared_ptr<Vignetting<double>> PhotoRigReader::ReadVignetting(
 
   // read type
   const std::string type(element->Attribute("type"));
-  vignetting = CreateVignetting(type, w, h);
+  const XMLElement* grid_elem = element->FirstChildElement("grid");
+
+  if (grid_elem && type.compare(GridVignetting<double>::type) == 0)
+  {
+    // read grid size and interpolation
+    Eigen::MatrixXd grid = Eigen::Vector2d(0, 0);
+    GetMatrix(grid_elem->GetText(), grid);
+
+    const char* interp = element->Attribute("interpolation");
+    const GridInterpolation interpolation =
+        (interp && std::string(interp) == "bilinear") ?
+        GRID_BILINEAR : GRID_BICUBIC;
+
+    vignetting = std::make_shared<GridVignetting<double>>(w, h,
+        grid(0, 0), grid(1, 0), interpolation);
+  }
+  else
+  {
+    vignetting = CreateVignetting(type, w, h);
+  }
 
   // read params
   Eigen::MatrixXd params;
   params = vignetting->GetParams();
 
   const XMLElement* params_elem = element->FirstChildElement("params");
-  if (params_elem) GetMatrix(params_elem->GetText(), params);
-  vignetting->SetParams(params);
+  const char* sidecar = params_elem ? params_elem->Attribute("file") : nullptr;
+
+  if (sidecar)
+  {
+    // read params from sidecar file next to the XML file
+    Eigen::VectorXd values(params.size());
+    ReadSidecar(GetDirectory(filename_) + sidecar, values);
+    vignetting->SetParams(values);
+  }
+  else
+  {
+    if (params_elem) GetMatrix(params_elem->GetText(), params);
+    vignetting->SetParams(params);
+  }
 
   return vignetting;
 }
@@ -198,6 +246,10 @@ std::shared_ptr<Vignetting<double>> PhotoRigReader::CreateVignetting(
   {
     return std::make_shared<EvenPoly6Vignetting<double>>(width, height);
   }
+  else if (type.compare(GridVignetting<double>::type) == 0)
+  {
+    return std::make_shared<GridVignetting<double>>(width, height);
+  }
   else if (type.compare(UniformVignetting<double>::type) == 0)
   {
     return std::make_shared<UniformVignetting<double>>(width, height);
@@ -269,7 +321,9 @@ void PhotoRigReader::GetLongMatrix(const char* text, Eigen::MatrixXd& matrix)
 ////////////////////////////////////////////////////////////////////////////////
 
 PhotoRigWriter::PhotoRigWriter(const std::string& filename) :
-  filename_(filename)
+  filename_(filename),
+  sidecar_format_(SIDECAR_NONE),
+  sidecar_count_(0)
 {
 }
 
@@ -280,8 +334,14 @@ void PhotoRigWriter::Write(const PhotoRigd& rig)
   FinishWrite();
 }
 
+void PhotoRigWriter::SetSidecarFormat(SidecarFormat format)
+{
+  sidecar_format_ = format;
+}
+
 void PhotoRigWriter::PrepareWrite()
 {
+  sidecar_count_ = 0;
   document_.Clear();
   tinyxml2::XMLElement* root = document_.NewElement("pcalib");
   document_.InsertEndChild(root);
@@ -362,7 +422,35 @@ void PhotoRigWriter::WriteVignetting(tinyxml2::XMLElement* parent,
   size->SetText(GetText(dims).c_str());
   element->InsertEndChild(size);
 
-  if (vignetting.GetParams().size() > 0)
+  const GridVignetting<double>* grid_vignetting =
+      dynamic_cast<const GridVignetting<double>*>(&vignetting);
+
+  if (grid_vignetting)
+  {
+    // set vignetting grid size and interpolation
+    Eigen::Vector2d grid_dims;
+    grid_dims[0] = grid_vignetting->GridWidth();
+    grid_dims[1] = grid_vignetting->GridHeight();
+    tinyxml2::XMLElement* grid = document_.NewElement("grid");
+    grid->SetText(GetText(grid_dims).c_str());
+    element->InsertEndChild(grid);
+
+    const bool bilinear = grid_vignetting->Interpolation() == GRID_BILINEAR;
+    element->SetAttribute("interpolation", bilinear ? "bilinear" : "bicubic");
+  }
+
+  if (sidecar_format_ != SIDECAR_NONE &&
+      vignetting.GetParams().size() > NUM_SHORT_PARAMS)
+  {
+    // write vignetting params to sidecar file
+    const std::string name = GetSidecarName();
+    WriteSidecar(GetDirectory(filename_) + name, vignetting.GetParams(),
+        sidecar_format_);
+    tinyxml2::XMLElement* params = document_.NewElement("params");
+    params->SetAttribute("file", name.c_str());
+    element->InsertEndChild(params);
+  }
+  else if (vignetting.GetParams().size() > 0)
   {
     // set vignetting params
     tinyxml2::XMLElement* params = document_.NewElement("params");
@@ -411,6 +499,19 @@ std::string PhotoRigWriter::GetLongText(const Eigen::MatrixXd& matrix)
   return encoder.str();
 }
 
+std::string PhotoRigWriter::GetSidecarName()
+{
+  // name sidecar after the XML file, without its directory and extension
+  std::string name = filename_.substr(GetDirectory(filename_).size());
+
+  const size_t dot = name.find_last_of('.');
+  if (dot != std::string::npos && dot > 0) name.erase(dot);
+
+  std::stringstream stream;
+  stream << name << ".vignetting" << sidecar_count_++ << ".bin";
+  return stream.str();
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 
 std::shared_ptr<PhotoRigd> ReadXmlPhotoRig(const std::string& filename)
@@ -424,9 +525,11 @@ std::shared_ptr<PhotoRigd> ReadXmlPhotoRig(const std::string& filename)
 
 ////////////////////////////////////////////////////////////////////////////////
 
-void WriteXmlPhotoRig(const std::string& filename, const PhotoRigd& rig)
+void WriteXmlPhotoRig(const std::string& filename, const PhotoRigd& rig,
+    SidecarFormat format)
 {
   PhotoRigWriter writer(filename);
+  writer.SetSidecarFormat(format);
   writer.Write(rig);
 }
 
@@ -0,0 +1,166 @@
+/*
+   This file is part of the Calibu Project.
+   https://github.com/gwu-robotics/Calibu
+
+   Copyright (C) 2013 George Washington University,
+                      Steven Lovegrove
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+   http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#include <calibu/pose/P3p.h>
+
+#include <Eigen/Eigenvalues>
+#include <Eigen/SVD>
+
+using namespace Eigen;
+
+namespace calibu {
+
+namespace {
+
+// Real roots of a[4] x^4 + ... + a[0], polished by Newton's method
+int RealQuarticRoots( const double a[5], double roots[4] )
+{
+    if( std::abs(a[4]) < 1E-12 * (std::abs(a[3]) + std::abs(a[2]) +
+                                  std::abs(a[1]) + std::abs(a[0])) ) {
+        return 0;
+    }
+
+    Matrix4d companion = Matrix4d::Zero();
+    companion.block<3,3>(1,0).setIdentity();
+    for( int i=0; i < 4; ++i ) {
+        companion(i,3) = -a[i] / a[4];
+    }
+    const EigenSolver<Matrix4d> eig(companion, false);
+
+    int n = 0;
+    for( int i=0; i < 4; ++i ) {
+        const std::complex<double> r = eig.eigenvalues()[i];
+        if( std::abs(r.imag()) > 1E-6 * std::max(1.0, std::abs(r.real())) ) {
+            continue;
+        }
+        double x = r.real();
+        for( int k=0; k < 5; ++k ) {
+            const double f = (((a[4]*x + a[3])*x + a[2])*x + a[1])*x + a[0];
+            const double df = ((4*a[4]*x + 3*a[3])*x + 2*a[2])*x + a[1];
+            if( df == 0 ) break;
+            x -= f / df;
+        }
+        roots[n++] = x;
+    }
+    return n;
+}
+
+// Rigid T with Q[i] = T * P[i] (Kabsch)
+Sophus::SE3d AlignPoints( const Vector3d P[3], const Vector3d Q[3] )
+{
+    const Vector3d cP = (P[0] + P[1] + P[2]) / 3.0;
+    const Vector3d cQ = (Q[0] + Q[1] + Q[2]) / 3.0;
+    Matrix3d H = Matrix3d::Zero();
+    for( int i=0; i < 3; ++i ) {
+        H += (Q[i] - cQ) * (P[i] - cP).transpose();
+    }
+    const JacobiSVD<Matrix3d> svd(H, ComputeFullU | ComputeFullV);
+    Matrix3d D = Matrix3d::Identity();
+    if( (svd.matrixU() * svd.matrixV().transpose()).determinant() < 0 ) {
+        D(2,2) = -1;
+    }
+    const Matrix3d R = svd.matrixU() * D * svd.matrixV().transpose();
+    return Sophus::SE3d(R, cQ - R * cP);
+}
+
+}
+
+int P3p( const Vector3d f[3], const Vector3d P[3], Sophus::SE3d T_cw[4] )
+{
+    // Haralick et al., "Review and analysis of solutions of the three point
+    // perspective pose estimation problem", IJCV 1994. Sides opposite to
+    // each bearing and the cosines of the angles between bearings.
+    const double a2 = (P[1] - P[2]).squaredNorm();
+    const double b2 = (P[0] - P[2]).squaredNorm();
+    const double c2 = (P[0] - P[1]).squaredNorm();
+    if( b2 < 1E-20 ) return 0;
+    const double ca = f[1].dot(f[2]);
+    const double cb = f[0].dot(f[2]);
+    const double cg = f[0].dot(f[1]);
+
+    const double amc = (a2 - c2) / b2;
+    const double apc = (a2 + c2) / b2;
+    const double q[5] = {
+        (1 + amc)*(1 + amc) - 4*a2/b2 * cg*cg,
+        4*( -amc*(1 + amc)*cb + 2*a2/b2 * cg*cg*cb - (1 - apc)*ca*cg ),
+        2*( amc*amc - 1 + 2*amc*amc*cb*cb + 2*(b2 - c2)/b2 * ca*ca
+            - 4*apc*ca*cb*cg + 2*(b2 - a2)/b2 * cg*cg ),
+        4*( amc*(1 - amc)*cb - (1 - apc)*ca*cg + 2*c2/b2 * ca*ca*cb ),
+        (amc - 1)*(amc - 1) - 4*c2/b2 * ca*ca
+    };
+
+    double vs[4];
+    const int nv = RealQuarticRoots(q, vs);
+
+    int n = 0;
+    for( int i=0; i < nv; ++i ) {
+        // Distances along bearings s2 = u s1, s3 = v s1
+        const double v = vs[i];
+        const double den = 2*(cg - v*ca);
+        if( std::abs(den) < 1E-12 ) continue;
+        const double u = ((-1 + amc)*v*v - 2*amc*cb*v + 1 + amc) / den;
+        const double s12 = b2 / (1 + v*v - 2*v*cb);
+        if( !(s12 > 0) || u <= 0 || v <= 0 ) continue;
+        const double s1 = std::sqrt(s12);
+
+        const Vector3d Q[3] = { s1 * f[0], u * s1 * f[1], v * s1 * f[2] };
+        T_cw[n++] = AlignPoints(P, Q);
+    }
+    return n;
+}
+
+void RefineBearingPose(
+        const Matrix3Xd& f, const Matrix3Xd& P,
+        const std::vector<int>& idx, int iterations, Sophus::SE3d& T_cw )
+{
+    for( int it=0; it < iterations; ++it ) {
+        // Error in the tangent plane of each bearing, left update
+        // T_cw <- exp(x) T_cw
+        Matrix<double,6,6> JTJ = Matrix<double,6,6>::Zero();
+        Matrix<double,6,1> JTe = Matrix<double,6,1>::Zero();
+        for( int i : idx ) {
+            const Vector3d fi = f.col(i);
+            const Vector3d P_c = T_cw * Vector3d(P.col(i));
+            const double d = P_c.norm();
+            if( d <= 0 ) continue;
+            const Vector3d n = P_c / d;
+
+            Matrix<double,3,2> B;
+            B.col(0) = fi.unitOrthogonal();
+            B.col(1) = fi.cross(B.col(0));
+            const Vector2d e = B.transpose() * n;
+
+            Matrix<double,3,6> dP;
+            dP.leftCols<3>().setIdentity();
+            dP.rightCols<3>() = -Sophus::SO3d::hat(P_c);
+            const Matrix<double,2,6> J = B.transpose() *
+                ((Matrix3d::Identity() - n * n.transpose()) / d) * dP;
+            JTJ += J.transpose() * J;
+            JTe += J.transpose() * e;
+        }
+
+        const Matrix<double,6,1> x = -JTJ.ldlt().solve(JTe);
+        if( !x.allFinite() ) break;
+        T_cw = Sophus::SE3d::exp(x) * T_cw;
+        if( x.squaredNorm() < 1E-20 ) break;
+    }
+}
+
+}
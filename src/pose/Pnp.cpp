@@ -20,11 +20,15 @@
  */
 
 #include <calibu/pose/Pnp.h>
+#include <calibu/pose/P3p.h>
+#include <calibu/utils/PipelineStats.h>
 
 #include <opencv2/calib3d.hpp>
 #include <opencv2/core/core.hpp>
 #include <opencv2/core/eigen.hpp>
 
+#include <algorithm>
+
 using namespace std;
 using namespace Eigen;
 
@@ -39,6 +43,7 @@ vector<int> PosePnPRansac(
     float robust_3pt_tol,
     Sophus::SE3d * T,
     bool calibrate) {
+    CALIBU_PIPELINE_TIMER(timer, STAGE_PNP);
     vector<int> inlier_map(candidate_map.size(), -1);
 
     cv::Mat cv_coeff_start(4, 1, CV_64F);
@@ -163,6 +168,7 @@ vector<int> PosePnPRansac(
         return cv_inliers;
 
     if(robust_3pt_its > 0) {
+        CALIBU_PIPELINE_COUNT(COUNTER_RANSAC_ITERATIONS, robust_3pt_its);
         cv::solvePnPRansac(cv_obj, cv_img, cv_K, cv_coeff, cv_rot, cv_trans,
                            false, robust_3pt_its/2, robust_3pt_tol / cam->K()(0,0), 0.99, cv_inliers);
         cv::solvePnPRansac(cv_obj, cv_img3, cv_K, cv_coeff, cv_rot3, cv_trans3,
@@ -240,6 +246,169 @@ vector<int> PosePnPRansac(
     return inlier_map;
 }
 
+int PnpSolver::Solve(
+    const std::shared_ptr<CameraInterface<double>> cam,
+    const std::vector<Eigen::Vector2d, Eigen::aligned_allocator<Eigen::Vector2d> >& img_pts,
+    const std::vector<Eigen::Vector3d, Eigen::aligned_allocator<Eigen::Vector3d> >& ideal_pts,
+    const vector<int> & candidate_map,
+    Sophus::SE3d& T_cw,
+    vector<int> & inlier_map)
+{
+    CALIBU_PIPELINE_TIMER(timer, STAGE_PNP);
+    inlier_map.assign(candidate_map.size(), -1);
+
+    idx_.clear();
+    for (size_t i = 0; i<img_pts.size(); ++i)
+    {
+        if (candidate_map[i] >= 0)
+            idx_.push_back(i);
+    }
+    const int n = idx_.size();
+    if (n < std::max(4, params_.min_inliers))
+        return 0;
+
+    // Unit bearing vectors of all candidates in one batch
+    pix_.resize(2, n);
+    obj_.resize(3, n);
+    for (int k = 0; k < n; ++k)
+    {
+        pix_.col(k) = img_pts[idx_[k]];
+        obj_.col(k) = ideal_pts[candidate_map[idx_[k]]];
+    }
+    cam->UnprojectN(pix_, rays_);
+    rays_.colwise().normalize();
+
+    // Angular tolerance equivalent to robust_3pt_tol pixels at the center
+    const double tol = params_.robust_3pt_tol / cam->K()(0,0);
+    std::uniform_int_distribution<int> sample(0, n - 1);
+    best_inliers_.clear();
+    Sophus::SE3d T;
+    const int its = std::max(1, params_.robust_3pt_its);
+    CALIBU_PIPELINE_COUNT(COUNTER_RANSAC_ITERATIONS, its);
+    for (int it = 0; it < its; ++it)
+    {
+        int s[3];
+        s[0] = sample(rng_);
+        do { s[1] = sample(rng_); } while (s[1] == s[0]);
+        do { s[2] = sample(rng_); } while (s[2] == s[0] || s[2] == s[1]);
+
+        const Vector3d f[3] = { rays_.col(s[0]), rays_.col(s[1]), rays_.col(s[2]) };
+        const Vector3d P[3] = { obj_.col(s[0]), obj_.col(s[1]), obj_.col(s[2]) };
+        Sophus::SE3d hypotheses[4];
+        const int nh = P3p(f, P, hypotheses);
+        for (int h = 0; h < nh; ++h)
+        {
+            inliers_.clear();
+            for (int k = 0; k < n; ++k)
+            {
+                if (BearingError(rays_.col(k), hypotheses[h] * Vector3d(obj_.col(k))) < tol)
+                    inliers_.push_back(k);
+            }
+            if (inliers_.size() > best_inliers_.size())
+            {
+                best_inliers_.swap(inliers_);
+                T = hypotheses[h];
+            }
+        }
+    }
+
+    if ((int)best_inliers_.size() < std::max(3, params_.min_inliers))
+        return 0;
+
+    // Refine on the bearing inliers, then on every candidate consistent
+    // with the refined pose
+    RefineBearingPose(rays_, obj_, best_inliers_, params_.refine_its, T);
+    const int inliers = GaussNewton(cam, img_pts, ideal_pts, candidate_map,
+                                    T, inlier_map);
+    if (inliers < params_.min_inliers) {
+        inlier_map.assign(candidate_map.size(), -1);
+        return 0;
+    }
+    T_cw = T;
+    return inliers;
+}
+
+int PnpSolver::Refine(
+    const std::shared_ptr<CameraInterface<double>> cam,
+    const std::vector<Eigen::Vector2d, Eigen::aligned_allocator<Eigen::Vector2d> >& img_pts,
+    const std::vector<Eigen::Vector3d, Eigen::aligned_allocator<Eigen::Vector3d> >& ideal_pts,
+    const vector<int> & candidate_map,
+    Sophus::SE3d& T_cw,
+    vector<int> & inlier_map)
+{
+    CALIBU_PIPELINE_TIMER(timer, STAGE_PNP);
+    Sophus::SE3d T = T_cw;
+    const int inliers = GaussNewton(cam, img_pts, ideal_pts, candidate_map,
+                                    T, inlier_map);
+    if (inliers < params_.min_inliers) {
+        inlier_map.assign(candidate_map.size(), -1);
+        return 0;
+    }
+    T_cw = T;
+    return inliers;
+}
+
+int PnpSolver::GaussNewton(
+    const std::shared_ptr<CameraInterface<double>> cam,
+    const std::vector<Eigen::Vector2d, Eigen::aligned_allocator<Eigen::Vector2d> >& img_pts,
+    const std::vector<Eigen::Vector3d, Eigen::aligned_allocator<Eigen::Vector3d> >& ideal_pts,
+    const vector<int> & candidate_map,
+    Sophus::SE3d& T_cw,
+    vector<int> & inlier_map)
+{
+    const double tol2 = params_.robust_3pt_tol * params_.robust_3pt_tol;
+
+    for (int it = 0; it < params_.refine_its; ++it)
+    {
+        // Normal equations for left update T_cw <- exp(x) T_cw
+        Matrix<double,6,6> JTJ = Matrix<double,6,6>::Zero();
+        Matrix<double,6,1> JTe = Matrix<double,6,1>::Zero();
+        int n = 0;
+        for (size_t i = 0; i < img_pts.size(); ++i)
+        {
+            const int ti = candidate_map[i];
+            if (ti < 0) continue;
+            const Vector3d P_c = T_cw * ideal_pts[ti];
+            if (P_c[2] <= 0) continue;
+            Vector2d p;
+            Matrix<double,2,3> dp_dP;
+            cam->ProjectWithJacobians(P_c, p, &dp_dP);
+            const Vector2d e = p - img_pts[i];
+            if (!(e.squaredNorm() <= tol2)) continue;
+
+            Matrix<double,3,6> dP;
+            dP.leftCols<3>().setIdentity();
+            dP.rightCols<3>() = -Sophus::SO3d::hat(P_c);
+            const Matrix<double,2,6> J = dp_dP * dP;
+            JTJ += J.transpose() * J;
+            JTe += J.transpose() * e;
+            ++n;
+        }
+        if (n < 3) break;
+
+        const Matrix<double,6,1> x = -JTJ.ldlt().solve(JTe);
+        if (!x.allFinite()) break;
+        T_cw = Sophus::SE3d::exp(x) * T_cw;
+        if (x.squaredNorm() < 1E-16) break;
+    }
+
+    inlier_map.assign(candidate_map.size(), -1);
+    int inliers = 0;
+    for (size_t i = 0; i < img_pts.size(); ++i)
+    {
+        const int ti = candidate_map[i];
+        if (ti < 0) continue;
+        const Vector3d P_c = T_cw * ideal_pts[ti];
+        if (P_c[2] <= 0) continue;
+        const Vector2d e = cam->Project(P_c) - img_pts[i];
+        if (e.squaredNorm() <= tol2) {
+            inlier_map[i] = ti;
+            ++inliers;
+        }
+    }
+    return inliers;
+}
+
 int CountInliers(const vector<int> & conics_target_map)
 {
     int inliers =0;
@@ -0,0 +1,221 @@
+/*
+   This file is part of the Calibu Project.
+   https://github.com/gwu-robotics/Calibu
+
+   Copyright (C) 2013 George Washington University,
+                      Steven Lovegrove
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+   http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#include <calibu/pose/RigTracker.h>
+#include <calibu/cam/camera_crtp_impl.h>
+#include <calibu/cam/camera_models_crtp.h>
+#include <calibu/image/ImageProcessing.h>
+#include <calibu/utils/Parallel.h>
+
+#include <algorithm>
+
+using namespace std;
+using namespace Eigen;
+
+namespace calibu {
+
+RigTracker::RigTracker(TargetInterface& target, std::shared_ptr<Rig<double>> rig)
+    : target(target), cams(rig->cameras_), pose_valid(false), tracked_frames(0)
+{
+    const size_t n = cams.size();
+    imgs.resize(n);
+    finders.resize(n);
+    for( size_t c=0; c < n; ++c ) {
+        imgs[c].reset(new ImageProcessing(cams[c]->Width(), cams[c]->Height()));
+        finders[c].reset(new ConicFinder());
+    }
+    conics_camframe.resize(n);
+    conics_target_map.resize(n);
+    candidate_map.resize(n);
+}
+
+bool RigTracker::ProcessFrames(
+    const std::vector<const unsigned char*>& images,
+    const std::vector<size_t>& pitches)
+{
+    if( images.size() != cams.size() || pitches.size() != cams.size() ) {
+        return false;
+    }
+
+    // Conics of every camera, independently
+    ParallelForBands( cams.size(), params.num_threads, [&](int begin, int end) {
+        for( int c = begin; c < end; ++c ) {
+            const std::shared_ptr<CameraInterface<double>>& cam = cams[c];
+            imgs[c]->Process(images[c], cam->Width(), cam->Height(), pitches[c]);
+            finders[c]->Find(*imgs[c]);
+
+            UnmapConics(finders[c]->Conics(), cam, conics_camframe[c]);
+        }
+    });
+
+    pnp.Params().robust_3pt_its = params.tracker.robust_3pt_its;
+    pnp.Params().robust_3pt_tol = params.tracker.robust_3pt_inlier_tol;
+
+    if( params.tracker.target_tracking && pose_valid &&
+            tracked_frames < params.tracker.revalidate_frames ) {
+        if( FindRigPose(true) ) {
+            ++tracked_frames;
+            return true;
+        }
+    }
+
+    pose_valid = FindRigPose(false);
+    tracked_frames = 0;
+    return pose_valid;
+}
+
+bool RigTracker::FindRigPose( bool pose_known )
+{
+    // Correspondences of each camera, and the pose of the camera that
+    // sees most of the target to start from
+    Sophus::SE3d T = T_rw;
+    int best_inliers = 0;
+    for( size_t c=0; c < cams.size(); ++c ) {
+        const Sophus::SE3d T_rc = cams[c]->Pose();
+        Sophus::SE3d T_cw = T_rc.inverse() * T_rw;
+        const int inliers = FindCamera(c, pose_known, T_cw);
+        if( !pose_known && inliers > best_inliers ) {
+            best_inliers = inliers;
+            T = T_rc * T_cw;
+        }
+    }
+    if( !pose_known && best_inliers == 0 ) {
+        return false;
+    }
+
+    RefineRigPose(T);
+
+    int inliers = 0;
+    const double rms = UpdateInliers(T, inliers);
+    if( isfinite(rms) && rms < params.tracker.max_rms &&
+            inliers >= params.tracker.inlier_num_required ) {
+        T_rw = T;
+        return true;
+    }
+    return false;
+}
+
+int RigTracker::FindCamera( size_t c, bool pose_known, Sophus::SE3d& T_cw )
+{
+    const std::shared_ptr<CameraInterface<double>>& cam = cams[c];
+    const ConicSet& conics = finders[c]->Conics();
+    std::vector<int>& map = conics_target_map[c];
+    map.assign(conics.size(), -1);
+    candidate_map[c].assign(conics.size(), -1);
+
+    if( !pose_known ) {
+        // Find target given (approximately) undistorted conics
+        std::shared_ptr<CameraInterface<double>> idcam(new LinearCamera<double>());
+        target.FindTarget( idcam, *imgs[c], conics_camframe[c], map );
+        candidate_map[c] = map;
+        if( pnp.Solve( cam, conics.CentersData(), target.Circles3D(), candidate_map[c],
+                       T_cw, map ) == 0 ) {
+            // Keep the unverified IDs out of the joint rig pose
+            candidate_map[c].assign(conics.size(), -1);
+            return 0;
+        }
+    }
+
+    target.FindTarget( T_cw, cam, *imgs[c], conics, map );
+    candidate_map[c] = map;
+    if( pose_known ) {
+        return CountInliers(candidate_map[c]);
+    }
+    return pnp.Refine( cam, conics.CentersData(), target.Circles3D(), candidate_map[c],
+                       T_cw, map );
+}
+
+void RigTracker::RefineRigPose( Sophus::SE3d& T )
+{
+    const std::vector<Vector3d, aligned_allocator<Vector3d> >& circles =
+        target.Circles3D();
+    const double tol2 = params.tracker.robust_3pt_inlier_tol *
+                        params.tracker.robust_3pt_inlier_tol;
+
+    for( int it=0; it < params.refine_its; ++it ) {
+        // Normal equations for left update T <- exp(x) T
+        Matrix<double,6,6> JTJ = Matrix<double,6,6>::Zero();
+        Matrix<double,6,1> JTe = Matrix<double,6,1>::Zero();
+        int n = 0;
+        for( size_t c=0; c < cams.size(); ++c ) {
+            const std::shared_ptr<CameraInterface<double>>& cam = cams[c];
+            const Sophus::SE3d T_cr = cam->Pose().inverse();
+            const Matrix3d R_cr = T_cr.so3().matrix();
+            for( size_t i=0; i < candidate_map[c].size(); ++i ) {
+                const int ti = candidate_map[c][i];
+                if( ti < 0 ) continue;
+                const Vector3d P_r = T * circles[ti];
+                const Vector3d P_c = T_cr * P_r;
+                if( P_c[2] <= 0 ) continue;
+                Vector2d p;
+                Matrix<double,2,3> dp_dP;
+                cam->ProjectWithJacobians(P_c, p, &dp_dP);
+                const Vector2d e = p - finders[c]->Conics().Center(i);
+                if( !(e.squaredNorm() <= tol2) ) continue;
+
+                Matrix<double,3,6> dP;
+                dP.leftCols<3>().setIdentity();
+                dP.rightCols<3>() = -Sophus::SO3d::hat(P_r);
+                const Matrix<double,2,6> J = dp_dP * R_cr * dP;
+                JTJ += J.transpose() * J;
+                JTe += J.transpose() * e;
+                ++n;
+            }
+        }
+        if( n < 3 ) break;
+
+        const Matrix<double,6,1> x = -JTJ.ldlt().solve(JTe);
+        if( !x.allFinite() ) break;
+        T = Sophus::SE3d::exp(x) * T;
+        if( x.squaredNorm() < 1E-16 ) break;
+    }
+}
+
+double RigTracker::UpdateInliers( const Sophus::SE3d& T, int& inliers )
+{
+    const std::vector<Vector3d, aligned_allocator<Vector3d> >& circles =
+        target.Circles3D();
+    const double tol2 = params.tracker.robust_3pt_inlier_tol *
+                        params.tracker.robust_3pt_inlier_tol;
+
+    inliers = 0;
+    double sse = 0;
+    for( size_t c=0; c < cams.size(); ++c ) {
+        const std::shared_ptr<CameraInterface<double>>& cam = cams[c];
+        const Sophus::SE3d T_cw = cam->Pose().inverse() * T;
+        std::vector<int>& map = conics_target_map[c];
+        map.assign(candidate_map[c].size(), -1);
+        for( size_t i=0; i < candidate_map[c].size(); ++i ) {
+            const int ti = candidate_map[c][i];
+            if( ti < 0 ) continue;
+            const Vector3d P_c = T_cw * circles[ti];
+            if( P_c[2] <= 0 ) continue;
+            const double e2 = (cam->Project(P_c) - finders[c]->Conics().Center(i)).squaredNorm();
+            if( e2 <= tol2 ) {
+                map[i] = ti;
+                sse += e2;
+                ++inliers;
+            }
+        }
+    }
+    return inliers ? sqrt(sse / inliers) : std::numeric_limits<double>::infinity();
+}
+
+}
@@ -23,6 +23,7 @@
 #include <calibu/pose/Pnp.h>
 #include <calibu/image/ImageProcessing.h>
 
+#include <algorithm>
 #include <iostream>
 
 using namespace std;
@@ -31,37 +32,215 @@ using namespace Eigen;
 namespace calibu {
 
 Tracker::Tracker(TargetInterface& target, int w, int h)
-    : target(target), imgs(w,h),
-      last_good(0), good_frames(0)
+    : target(target), front(new Buffer(w,h)), back(new Buffer(w,h)),
+      last_good(0), good_frames(0), pose_valid(false), tracked_frames(0),
+      vel_valid(false), prior_valid(false), roi_valid(false),
+      pending_w(0), pending_h(0), pending_frame(0), pending_valid(false),
+      busy(false), stop(false), next_frame(0)
 {
 
 }
 
+Tracker::~Tracker()
+{
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex);
+        stop = true;
+    }
+    queue_cond.notify_all();
+    if( worker.joinable() ) {
+        worker.join();
+    }
+    if( pending_valid ) {
+        TrackerResult dropped;
+        dropped.frame = pending_frame;
+        pending_promise.set_value(dropped);
+    }
+}
+
 bool Tracker::ProcessFrame(
     std::shared_ptr<CameraInterface<double>> cam,
     const unsigned char* I, size_t w, size_t h, size_t pitch)
 {
-    double rms = 0;
+    const bool good = ProcessBack(cam, I, w, h, pitch);
+    back->T_gw = T_gw;
+    {
+        std::lock_guard<std::mutex> lock(result_mutex);
+        std::swap(front, back);
+    }
+    return good;
+}
+
+std::future<TrackerResult> Tracker::Submit(
+    std::shared_ptr<CameraInterface<double>> cam,
+    const unsigned char* I, size_t w, size_t h, size_t pitch)
+{
+    std::unique_lock<std::mutex> lock(queue_mutex);
+    if( pending_valid ) {
+        // The worker hasn't reached the waiting frame, drop it
+        TrackerResult dropped;
+        dropped.frame = pending_frame;
+        pending_promise.set_value(dropped);
+    }
+
+    pending_image.resize(w * h);
+    for( size_t y=0; y < h; ++y ) {
+        std::copy(I + y*pitch, I + y*pitch + w, &pending_image[y*w]);
+    }
+    pending_cam = cam;
+    pending_w = w;
+    pending_h = h;
+    pending_frame = next_frame++;
+    pending_promise = std::promise<TrackerResult>();
+    pending_valid = true;
+    std::future<TrackerResult> result = pending_promise.get_future();
+
+    if( !worker.joinable() ) {
+        worker = std::thread(&Tracker::Work, this);
+    }
+    lock.unlock();
+    queue_cond.notify_all();
+    return result;
+}
+
+void Tracker::Wait()
+{
+    std::unique_lock<std::mutex> lock(queue_mutex);
+    queue_cond.wait(lock, [this]() { return !pending_valid && !busy; });
+}
+
+void Tracker::Work()
+{
+    std::unique_lock<std::mutex> lock(queue_mutex);
+    while( true ) {
+        queue_cond.wait(lock, [this]() { return stop || pending_valid; });
+        if( stop ) {
+            return;
+        }
+
+        // Take the newest frame, leaving its buffer for the next one
+        std::shared_ptr<CameraInterface<double>> cam = pending_cam;
+        const size_t w = pending_w;
+        const size_t h = pending_h;
+        TrackerResult result;
+        result.frame = pending_frame;
+        std::promise<TrackerResult> promise = std::move(pending_promise);
+        work_image.swap(pending_image);
+        pending_valid = false;
+        busy = true;
+        lock.unlock();
+
+        result.processed = true;
+        result.good = ProcessFrame(cam, work_image.data(), w, h, w);
+        result.T_gw = T_gw;
+        promise.set_value(result);
+
+        lock.lock();
+        if( result_callback ) {
+            const Callback callback = result_callback;
+            lock.unlock();
+            callback(result);
+            lock.lock();
+        }
+        busy = false;
+        queue_cond.notify_all();
+    }
+}
+
+bool Tracker::ProcessBack(
+    std::shared_ptr<CameraInterface<double>> cam,
+    const unsigned char* I, size_t w, size_t h, size_t pitch)
+{
+    ImageProcessing& imgs = back->imgs;
+    if( params.roi_tracking && roi_valid ) {
+        imgs.Process(I, w, h, pitch, roi );
+        if( FindPose(cam) ) {
+            UpdateRoi(cam);
+            return true;
+        }
+        // Lost track of the target, search the whole image
+    }
 
     imgs.Process(I, w, h, pitch );
+    const bool good = FindPose(cam);
+    roi_valid = false;
+    if( good && params.roi_tracking ) {
+        UpdateRoi(cam);
+    }
+    return good;
+}
+
+void Tracker::UpdateRoi( std::shared_ptr<CameraInterface<double>> cam )
+{
+    const std::vector<Vector3d, aligned_allocator<Vector3d> >& circles =
+        target.Circles3D();
+
+    roi_valid = false;
+    bool empty = true;
+    for( const Vector3d& P_w : circles ) {
+        const Vector3d P_c = T_hw * P_w;
+        if( P_c[2] <= 0 ) {
+            // Target not entirely in front of camera
+            return;
+        }
+        const Vector2d p = cam->Project(P_c);
+        if( !isfinite(p[0]) || !isfinite(p[1]) ) {
+            return;
+        }
+        const int x = (int)p[0];
+        const int y = (int)p[1];
+        if( empty ) {
+            roi = IRectangle(x, y, x, y);
+            empty = false;
+        }else{
+            roi.Insert(x, y);
+        }
+    }
+    if( empty ) {
+        return;
+    }
+
+    const int margin = std::max( params.roi_min_margin,
+        (int)(params.roi_margin * std::max(roi.Width(), roi.Height())) );
+    roi = roi.Grow(margin).Clamp(0, 0, back->imgs.InputWidth() - 1,
+                                 back->imgs.InputHeight() - 1);
+    roi_valid = roi.Area() > 0;
+}
+
+bool Tracker::FindPose( std::shared_ptr<CameraInterface<double>> cam )
+{
+    pnp.Params().robust_3pt_its = params.robust_3pt_its;
+    pnp.Params().robust_3pt_tol = params.robust_3pt_inlier_tol;
+
+    ImageProcessing& imgs = back->imgs;
+    ConicFinder& conic_finder = back->conic_finder;
+    std::vector<int>& conics_target_map = back->conics_target_map;
     conic_finder.Find(imgs);
 
-    const std::vector<Conic, Eigen::aligned_allocator<Conic> >& conics =
-        conic_finder.Conics();
+    const ConicSet& conics = conic_finder.Conics();
 
     // Generate map and point structures
     conics_target_map.clear();
     conics_target_map.resize(conics.size(),-1);
-    vector<Vector2d, aligned_allocator<Vector2d> > ellipses;
-    for( size_t i=0; i < conics.size(); ++i ) {
-        ellipses.push_back(Vector2d(conics[i].center.x(),conics[i].center.y()));
+    const vector<Vector2d, aligned_allocator<Vector2d> >& ellipses =
+        conics.CentersData();
+
+    Sophus::SE3d T_pw;
+    if( PredictPose(T_pw) ) {
+        // Associate conics with the target seen from the predicted pose
+        target.FindTarget( T_pw, cam, imgs, conics, conics_target_map );
+        T_hw = T_pw;
+        if( EstimatePose(cam, ellipses) ) {
+            UpdateMotion(true);
+            return true;
+        }
+        conics_target_map.assign(conics.size(), -1);
     }
+    pose_valid = false;
+    vel_valid = false;
 
     // Undistort Conics
-    vector<Conic, Eigen::aligned_allocator<Conic> > conics_camframe;
-    for( unsigned int i=0; i<conics.size(); ++i ) {
-        conics_camframe.push_back(UnmapConic(conics[i],cam));
-    }
+    UnmapConics(conics, cam, conics_camframe);
 
     // Find target given (approximately) undistorted conics
     std::shared_ptr<CameraInterface<double>> idcam(new LinearCamera<double>());
@@ -74,35 +253,77 @@ bool Tracker::ProcessFrame(
       return false;
     }
 
-    conics_target_map = PosePnPRansac( cam, ellipses, target.Circles3D(),
-            conics_candidate_map_first_pass, params.robust_3pt_its,
-            params.robust_3pt_inlier_tol, &T_hw );
+    if( pnp.Solve( cam, ellipses, target.Circles3D(),
+                   conics_candidate_map_first_pass, T_hw,
+                   conics_target_map ) < params.inlier_num_required ) {
+        return false;
+    }
 
-    rms = ReprojectionErrorRMS(cam, T_hw, target.Circles3D(), ellipses,
-                               conics_target_map);
     target.FindTarget( T_hw, cam, imgs, conics, conics_target_map);
 
+    if( EstimatePose(cam, ellipses) ) {
+        UpdateMotion(false);
+        return true;
+    }
+    return false;
+}
+
+bool Tracker::PredictPose( Sophus::SE3d& T_pw )
+{
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex);
+        if( prior_valid ) {
+            prior_valid = false;
+            T_pw = T_prior;
+            return true;
+        }
+    }
+
+    if( !params.target_tracking || !pose_valid ||
+            tracked_frames >= params.revalidate_frames ) {
+        return false;
+    }
+
+    T_pw = (params.motion_model && vel_valid) ? T_vel * T_gw : T_gw;
+    return true;
+}
+
+void Tracker::UpdateMotion( bool tracked )
+{
+    // Velocity is only known across consecutive good frames
+    vel_valid = pose_valid;
+    if( vel_valid ) {
+        T_vel = T_hw * T_gw.inverse();
+    }
+    T_gw = T_hw;
+    pose_valid = true;
+    tracked_frames = tracked ? tracked_frames + 1 : 0;
+}
+
+bool Tracker::EstimatePose( std::shared_ptr<CameraInterface<double>> cam,
+    const vector<Vector2d, aligned_allocator<Vector2d> >& ellipses )
+{
+    std::vector<int>& conics_target_map = back->conics_target_map;
     conics_candidate_map_second_pass = conics_target_map;
 
-    inliers = CountInliers(conics_candidate_map_second_pass);
+    int inliers = CountInliers(conics_candidate_map_second_pass);
 
     if (inliers<params.inlier_num_required){
       printf("2) inliers<params.inlier_num_required\n");
         return false;
     }
 
-    conics_target_map = PosePnPRansac( cam, ellipses, target.Circles3D(),
-            conics_candidate_map_second_pass, params.robust_3pt_its,
-            params.robust_3pt_inlier_tol, &T_hw );
+    // T_hw is already close, so only refine it
+    pnp.Refine( cam, ellipses, target.Circles3D(),
+                conics_candidate_map_second_pass, T_hw, conics_target_map );
 
-    rms = ReprojectionErrorRMS(cam, T_hw, target.Circles3D(), ellipses,
-                               conics_target_map);
+    const double rms = ReprojectionErrorRMS(cam, T_hw, target.Circles3D(),
+                                            ellipses, conics_target_map);
 
     inliers = CountInliers(conics_target_map);
 
     if( isfinite((double)rms) && rms < params.max_rms
             &&  inliers>=params.inlier_num_required) {
-        T_gw = T_hw;
         return true;
     }
     printf("Failed:     if( isfinite((double)rms) && rms < params.max_rms &&  inliers>=params.inlier_num_required) {\n");
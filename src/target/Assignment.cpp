@@ -0,0 +1,222 @@
+/*
+   This file is part of the Calibu Project.
+   https://github.com/gwu-robotics/Calibu
+
+   Copyright (C) 2013 George Washington University,
+                      Steven Lovegrove
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+   http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#include <calibu/target/Assignment.h>
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+
+namespace calibu
+{
+
+double LinearAssignment::Solve(
+        int rows, int cols,
+        const std::vector<AssignmentEdge>& edges,
+        double unassigned_cost,
+        std::vector<int>& row_to_col,
+        bool warm_start
+        )
+{
+    const double inf = std::numeric_limits<double>::infinity();
+    const int num_cols = cols + rows;
+
+    // Compressed rows, ending each row with its unassigned column
+    row_begin_.assign(rows + 1, 0);
+    for(const AssignmentEdge& e : edges) {
+        if(std::isfinite(e.cost)) {
+            ++row_begin_[e.row + 1];
+        }
+    }
+    for(int r=0; r < rows; ++r) {
+        row_begin_[r+1] += row_begin_[r] + 1;
+    }
+    edge_col_.resize(row_begin_[rows]);
+    edge_cost_.resize(row_begin_[rows]);
+    std::vector<int>& fill = pred_;
+    fill.assign(row_begin_.begin(), row_begin_.end() - 1);
+    for(const AssignmentEdge& e : edges) {
+        if(std::isfinite(e.cost)) {
+            edge_col_[fill[e.row]] = e.col;
+            edge_cost_[fill[e.row]] = e.cost;
+            ++fill[e.row];
+        }
+    }
+    for(int r=0; r < rows; ++r) {
+        edge_col_[fill[r]] = cols + r;
+        edge_cost_[fill[r]] = unassigned_cost;
+    }
+
+    // Keep the last column prices if asked to and they fit
+    if(!warm_start || rows != rows_ || cols != cols_ ||
+            (int)v_.size() != num_cols) {
+        v_.assign(num_cols, 0.0);
+    }
+    rows_ = rows;
+    cols_ = cols;
+    u_.resize(rows);
+    col_to_row_.assign(num_cols, -1);
+    row_col_.assign(rows, -1);
+    dist_.assign(num_cols, inf);
+    pred_.assign(num_cols, -1);
+    done_.assign(num_cols, 0);
+
+    // Row prices from the cheapest column, taken straight away if free.
+    // Every reduced cost is then non-negative and assigned edges are tight.
+    for(int r=0; r < rows; ++r) {
+        double best = inf;
+        int best_col = -1;
+        for(int e = row_begin_[r]; e < row_begin_[r+1]; ++e) {
+            const double c = edge_cost_[e] - v_[edge_col_[e]];
+            if(c < best) {
+                best = c;
+                best_col = edge_col_[e];
+            }
+        }
+        u_[r] = best;
+        if(col_to_row_[best_col] < 0) {
+            col_to_row_[best_col] = r;
+            row_col_[r] = best_col;
+        }
+    }
+
+    // Shortest augmenting path from each remaining row over reduced costs
+    const std::greater<std::pair<double,int> > heap_order;
+    for(int s=0; s < rows; ++s) {
+        if(row_col_[s] >= 0) continue;
+
+        heap_.clear();
+        scanned_.clear();
+        touched_.clear();
+
+        auto relax = [&](int i, double d) {
+            for(int e = row_begin_[i]; e < row_begin_[i+1]; ++e) {
+                const int j = edge_col_[e];
+                const double nd = d + edge_cost_[e] - u_[i] - v_[j];
+                if(!done_[j] && nd < dist_[j]) {
+                    if(dist_[j] == inf) touched_.push_back(j);
+                    dist_[j] = nd;
+                    pred_[j] = i;
+                    heap_.push_back(std::make_pair(nd, j));
+                    std::push_heap(heap_.begin(), heap_.end(), heap_order);
+                }
+            }
+        };
+
+        relax(s, 0.0);
+        int sink = -1;
+        double dsink = 0.0;
+        while(!heap_.empty()) {
+            std::pop_heap(heap_.begin(), heap_.end(), heap_order);
+            const std::pair<double,int> top = heap_.back();
+            heap_.pop_back();
+            const int j = top.second;
+            if(done_[j] || top.first > dist_[j]) continue;
+            done_[j] = 1;
+            if(col_to_row_[j] < 0) {
+                sink = j;
+                dsink = top.first;
+                break;
+            }
+            scanned_.push_back(j);
+            relax(col_to_row_[j], top.first);
+        }
+
+        // The unassigned column of s is free, so a path always exists
+        // Move prices so that the path and all assigned edges stay tight
+        u_[s] += dsink;
+        for(int j : scanned_) {
+            const double delta = dsink - dist_[j];
+            v_[j] -= delta;
+            u_[col_to_row_[j]] += delta;
+        }
+
+        // Flip assignment along the path
+        for(int j = sink;;) {
+            const int i = pred_[j];
+            const int prev = row_col_[i];
+            col_to_row_[j] = i;
+            row_col_[i] = j;
+            if(i == s) break;
+            j = prev;
+        }
+
+        for(int j : touched_) {
+            dist_[j] = inf;
+            done_[j] = 0;
+        }
+    }
+
+    row_to_col.resize(rows);
+    double total = 0.0;
+    for(int r=0; r < rows; ++r) {
+        const int j = row_col_[r];
+        row_to_col[r] = j < cols ? j : -1;
+        for(int e = row_begin_[r]; e < row_begin_[r+1]; ++e) {
+            if(edge_col_[e] == j) {
+                total += edge_cost_[e];
+                break;
+            }
+        }
+    }
+    return total;
+}
+
+double LinearAssignment::Solve(
+        const Eigen::MatrixXd& cost,
+        std::vector<int>& row_to_col,
+        double gate,
+        bool warm_start
+        )
+{
+    dense_edges_.clear();
+    double max_cost = 0.0;
+    for(int r=0; r < cost.rows(); ++r) {
+        double row_max = 0.0;
+        for(int c=0; c < cost.cols(); ++c) {
+            const double x = cost(r,c);
+            if(std::isfinite(x) && x <= gate) {
+                dense_edges_.push_back(AssignmentEdge(r, c, x));
+                row_max = std::max(row_max, std::abs(x));
+            }
+        }
+        max_cost += row_max;
+    }
+
+    // Without a gate, leaving a row unassigned must cost more than any
+    // change to the other assignments can save
+    const bool gated = std::isfinite(gate);
+    const double unassigned_cost = gated ? gate : 2.0 * max_cost + 1.0;
+
+    Solve(cost.rows(), cost.cols(), dense_edges_, unassigned_cost,
+          row_to_col, warm_start);
+
+    double total = 0.0;
+    for(int r=0; r < cost.rows(); ++r) {
+        if(row_to_col[r] >= 0) {
+            total += cost(r, row_to_col[r]);
+        }else if(gated) {
+            total += gate;
+        }
+    }
+    return total;
+}
+
+}
@@ -0,0 +1,228 @@
+/*
+   This file is part of the Calibu Project.
+   https://github.com/arpg/Calibu
+
+   Copyright (C) 2013 George Washington University,
+                      Steven Lovegrove,
+                      Gabe Sibley
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+   http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#include <calibu/target/DetectionCache.h>
+#include <calibu/utils/Hash.h>
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+#ifdef _WIN_
+#  include <process.h>
+#  define getpid _getpid
+#else
+#  include <unistd.h>
+#endif
+
+namespace calibu {
+
+static const char kDetectionCacheMagic[8] = { 'C','A','L','I','B','U','D','C' };
+
+namespace {
+
+template<typename T>
+void Write(std::ostream& os, const T& value)
+{
+    os.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template<typename T>
+bool Read(std::istream& is, T& value)
+{
+    return (bool)is.read(reinterpret_cast<char*>(&value), sizeof(T));
+}
+
+}
+
+bool DetectionCache::Save(const std::string& filename) const
+{
+    std::ostringstream tmp_name;
+    tmp_name << filename << ".tmp." << getpid();
+    const std::string tmp_filename = tmp_name.str();
+    {
+        std::ofstream file(tmp_filename, std::ios::binary | std::ios::trunc);
+        if(!file) {
+            return false;
+        }
+
+        file.write(kDetectionCacheMagic, sizeof(kDetectionCacheMagic));
+        Write(file, kDetectionCacheVersion);
+        Write(file, (uint32_t)image_sizes.size());
+        Write(file, (uint64_t)frames.size());
+        Write(file, key);
+        for(const Eigen::Vector2i& size : image_sizes) {
+            Write(file, (int32_t)size[0]);
+            Write(file, (int32_t)size[1]);
+        }
+
+        for(const CachedFrameDetection& frame : frames) {
+            if(frame.size() != image_sizes.size()) {
+                file.close();
+                std::remove(tmp_filename.c_str());
+                return false;
+            }
+            for(const CachedCameraDetection& cam : frame) {
+                if(cam.target_map.size() != cam.centers.size() ||
+                   cam.grid.size() != cam.centers.size()) {
+                    file.close();
+                    std::remove(tmp_filename.c_str());
+                    return false;
+                }
+                Write(file, (uint8_t)cam.tracking_good);
+                Write(file, (uint32_t)cam.centers.size());
+                for(size_t i = 0; i < cam.centers.size(); ++i) {
+                    Write(file, cam.centers[i][0]);
+                    Write(file, cam.centers[i][1]);
+                    Write(file, (int32_t)cam.target_map[i]);
+                    Write(file, (int32_t)cam.grid[i][0]);
+                    Write(file, (int32_t)cam.grid[i][1]);
+                }
+            }
+        }
+
+        if(!file) {
+            file.close();
+            std::remove(tmp_filename.c_str());
+            return false;
+        }
+    }
+
+    if(std::rename(tmp_filename.c_str(), filename.c_str()) != 0) {
+        std::remove(tmp_filename.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool DetectionCache::Load(const std::string& filename, uint64_t expected_key)
+{
+    image_sizes.clear();
+    frames.clear();
+
+    std::ifstream file(filename, std::ios::binary);
+    char magic[8];
+    uint32_t version, num_cameras;
+    uint64_t num_frames;
+    if(!file.read(magic, sizeof(magic)) ||
+       memcmp(magic, kDetectionCacheMagic, sizeof(magic)) ||
+       !Read(file, version) || version != kDetectionCacheVersion ||
+       !Read(file, num_cameras) || !Read(file, num_frames) ||
+       !Read(file, key) || key != expected_key) {
+        return false;
+    }
+
+    image_sizes.resize(num_cameras);
+    for(Eigen::Vector2i& size : image_sizes) {
+        int32_t w, h;
+        if(!Read(file, w) || !Read(file, h)) {
+            return false;
+        }
+        size << w, h;
+    }
+
+    // Grow frame by frame, so a corrupt count fails on reading rather than
+    // allocating.
+    for(uint64_t f = 0; f < num_frames; ++f) {
+        frames.push_back(CachedFrameDetection(num_cameras));
+        for(CachedCameraDetection& cam : frames.back()) {
+            uint8_t tracking_good;
+            uint32_t n;
+            if(!Read(file, tracking_good) || !Read(file, n)) {
+                frames.clear();
+                return false;
+            }
+            cam.tracking_good = tracking_good != 0;
+            for(uint32_t i = 0; i < n; ++i) {
+                double x, y;
+                int32_t map, gx, gy;
+                if(!Read(file, x) || !Read(file, y) || !Read(file, map) ||
+                   !Read(file, gx) || !Read(file, gy)) {
+                    frames.clear();
+                    return false;
+                }
+                cam.centers.push_back(Eigen::Vector2d(x, y));
+                cam.target_map.push_back(map);
+                cam.grid.push_back(Eigen::Vector2i(gx, gy));
+            }
+        }
+    }
+
+    // Nothing may follow the last frame
+    return file.peek() == std::char_traits<char>::eof();
+}
+
+uint64_t DetectionCacheHash(
+        const std::string& source,
+        const ParamsImageProcessing& image_params,
+        const ParamsConicFinder& conic_params,
+        const ParamsGridDot& target_params,
+        double grid_spacing,
+        const Eigen::Vector2i& grid_size,
+        uint32_t grid_seed
+        )
+{
+    Fnv1aHash hasher;
+    hasher.Add(kDetectionCacheVersion);
+    hasher.Add(source.data(), source.size());
+
+    hasher.Add(image_params.at_threshold);
+    hasher.Add(image_params.at_window_ratio);
+    hasher.Add(image_params.at_min_diff);
+    hasher.Add(image_params.black_on_white);
+    hasher.Add((int)image_params.threshold_method);
+    hasher.Add(image_params.pyramid_levels);
+    if(image_params.use_cuda) {
+        // Only hashed when set, keeping the keys of existing caches
+        hasher.Add(image_params.use_cuda);
+    }
+
+    hasher.Add((int)conic_params.method);
+    hasher.Add(conic_params.conic_min_area);
+    hasher.Add(conic_params.conic_max_area);
+    hasher.Add(conic_params.conic_min_density);
+    hasher.Add(conic_params.conic_min_aspect);
+    hasher.Add(conic_params.blob_min_threshold);
+    hasher.Add(conic_params.blob_max_threshold);
+    hasher.Add(conic_params.blob_threshold_step);
+    hasher.Add(conic_params.blob_min_dist_between_blobs);
+    hasher.Add(conic_params.blob_min_area);
+    hasher.Add(conic_params.blob_filter_by_convexity);
+    hasher.Add(conic_params.blob_min_convexity);
+    hasher.Add(conic_params.blob_filter_by_inertia);
+    hasher.Add(conic_params.refine_margin);
+
+    hasher.Add(target_params.max_line_dist_ratio);
+    hasher.Add(target_params.max_norm_triple_area);
+    hasher.Add(target_params.min_cross_area);
+    hasher.Add(target_params.max_cross_area);
+    hasher.Add(target_params.cross_radius_ratio);
+    hasher.Add(target_params.cross_line_ratio);
+
+    hasher.Add(grid_spacing);
+    hasher.Add(grid_size[0]);
+    hasher.Add(grid_size[1]);
+    hasher.Add(grid_seed);
+    return hasher.Hash();
+}
+
+}
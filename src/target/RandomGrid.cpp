@@ -20,11 +20,268 @@
  */
 
 #include <calibu/target/RandomGrid.h>
+#include <calibu/utils/Parallel.h>
 #include <calibu/utils/StreamOperatorsEigen.h>
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+
+#if defined(_MSC_VER)
+#  include <intrin.h>
+#endif
+
 namespace calibu
 {
 
+namespace {
+
+inline int PopCount(uint64_t x)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_popcountll(x);
+#elif defined(_MSC_VER) && defined(_M_X64)
+    return (int)__popcnt64(x);
+#else
+    int n = 0;
+    for(; x; x &= x - 1) ++n;
+    return n;
+#endif
+}
+
+// 64 bits of row starting at column b, which may be negative. Columns
+// outside of the row's words read as zero.
+inline uint64_t RowBits(const uint64_t* row, int words, int b)
+{
+    const int w = (b >= 0) ? b / 64 : -((-b + 63) / 64);
+    const int s = b - 64 * w;
+    const uint64_t lo = (0 <= w && w < words) ? row[w] : 0;
+    if(s == 0) {
+        return lo;
+    }
+    const uint64_t hi = (0 <= w + 1 && w + 1 < words) ? row[w + 1] : 0;
+    return (lo >> s) | (hi << (64 - s));
+}
+
+// HammingDistance, giving up once the distance reaches bound.
+int HammingDistance(const PackedPattern& M, const PackedPattern& m, int r, int c, int bound)
+{
+    int diff = 0;
+    for(int mr=0; mr<m.rows && diff < bound; ++mr) {
+        const uint64_t* mk = &m.known[mr * m.words];
+        const uint64_t* mo = &m.ones[mr * m.words];
+        const int Mr = mr + r;
+        if(Mr < 0 || Mr >= M.rows) {
+            // Every known cell lies outside of M
+            for(int w=0; w<m.words; ++w) {
+                diff += PopCount(mk[w]);
+            }
+            continue;
+        }
+
+        const uint64_t* Mk = &M.known[Mr * M.words];
+        const uint64_t* Mo = &M.ones[Mr * M.words];
+        for(int w=0; w<m.words; ++w) {
+            const uint64_t pk = RowBits(Mk, M.words, c + 64 * w);
+            const uint64_t po = RowBits(Mo, M.words, c + 64 * w);
+            // Known cells of m that are unknown in M or differ
+            diff += PopCount(mk[w] & ~(pk & ~(po ^ mo[w])));
+        }
+    }
+    return diff;
+}
+
+// Cells of the nr x nc window of binary pattern P at (r,c), packed row by
+// row into words_per_row words each, with unused high bits cleared.
+void WindowKey(const PackedPattern& P, int r, int c, int nr, int nc,
+               int words_per_row, uint64_t* key)
+{
+    for(int i=0; i<nr; ++i) {
+        const uint64_t* row = &P.ones[(r + i) * P.words];
+        for(int w=0; w<words_per_row; ++w) {
+            uint64_t bits = RowBits(row, P.words, c + 64 * w);
+            const int n = nc - 64 * w;
+            if(n < 64) {
+                bits &= (uint64_t(1) << n) - 1;
+            }
+            key[i * words_per_row + w] = bits;
+        }
+    }
+}
+
+// Cells of column c of binary pattern P, rows r to r+nr-1, packed into
+// (nr+63)/64 words.
+void ColumnKey(const PackedPattern& P, int r, int c, int nr, uint64_t* key)
+{
+    const int words = (nr + 63) / 64;
+    std::fill(key, key + words, 0);
+    for(int i=0; i<nr; ++i) {
+        const uint64_t bit = (P.ones[(r + i) * P.words + c / 64] >> (c % 64)) & 1;
+        key[i / 64] |= bit << (i % 64);
+    }
+}
+
+// Top left cell of a window placed in pattern g of a group.
+struct Placement
+{
+    int g;
+    int r;
+    int c;
+};
+
+// Placements holding identical windows.
+typedef std::vector<Placement> Collisions;
+
+// Split members into runs of equal keys, each key_size words, appending runs
+// that hold a query window and some other placement to groups. Adds the
+// number of other placements each query window matches to num_bad.
+template<typename IsQuery>
+void GroupByKey(const std::vector<Placement>& members,
+                const std::vector<uint64_t>& keys, int key_size,
+                const IsQuery& is_query, std::vector<Collisions>& groups,
+                int& num_bad)
+{
+    const auto key_less = [&](int a, int b) {
+        return std::lexicographical_compare(
+            &keys[a * key_size], &keys[(a + 1) * key_size],
+            &keys[b * key_size], &keys[(b + 1) * key_size]);
+    };
+
+    std::vector<int> order(members.size());
+    for(size_t i=0; i<order.size(); ++i) {
+        order[i] = i;
+    }
+    std::sort(order.begin(), order.end(), key_less);
+
+    for(size_t begin=0, end; begin < order.size(); begin = end) {
+        int num_queries = is_query(members[order[begin]]);
+        for(end = begin + 1; end < order.size() &&
+            !key_less(order[begin], order[end]); ++end) {
+            num_queries += is_query(members[order[end]]);
+        }
+        const int n = end - begin;
+        if(num_queries > 0 && n > 1) {
+            groups.emplace_back();
+            for(size_t i=begin; i<end; ++i) {
+                groups.back().push_back(members[order[i]]);
+            }
+            num_bad += num_queries * (n - 1);
+        }
+    }
+}
+
+// Find the windows of PG[0] that exactly match more than one placement in
+// PG, for every window size from minr x 2 up, calling f(nr, nc, num_bad)
+// for each size, where num_bad is the number of matches other than the
+// window itself, summed over windows, as counted by AutoCorrelation.
+// Scanning stops if f returns false.
+//
+// Windows and placements follow AutoCorrelation and NumExactMatches:
+// windows start at offsets below R-nr-1, C-nc-1 of PG[0], only placements
+// entirely within a pattern can match exactly, and NumExactMatches misses
+// the last row and column of placements when the window is 2 cells thin.
+//
+// For each number of rows, windows grow a column at a time. A window can
+// only match where its narrower prefix matched, so only the placements
+// that collided at the previous width are compared, by their new column.
+// Windows grow unique quickly, and once none collide no wider one will.
+template<typename F>
+void ScanWindowCollisions(const PackedPatternGroup& PG, int minr, F f)
+{
+    const int R = PG[0].rows;
+    const int C = PG[0].cols;
+
+    for(int nr = std::max(minr, 2); nr < R; ++nr) {
+        std::vector<Collisions> groups;
+        const int column_words = (nr + 63) / 64;
+
+        for(int nc = 2; nc < C; ++nc) {
+            const int extra = (std::min(std::min(nr,nc)-2, 2) > 0) ? 1 : 0;
+            const auto is_query = [&](const Placement& p) {
+                return p.g == 0 && p.r < R - nr - 1 && p.c < C - nc - 1;
+            };
+
+            std::vector<Collisions> next;
+            int num_bad = 0;
+            std::vector<Placement> members;
+            std::vector<uint64_t> keys;
+
+            if(nc <= 3) {
+                // Placements change with the border, so start over from the
+                // whole windows of every placement
+                const int words_per_row = (nc + 63) / 64;
+                const int key_size = nr * words_per_row;
+                for(int g=0; g<4; ++g) {
+                    const PackedPattern& P = PG[g];
+                    for(int r=0; r < P.rows - nr + extra; ++r) {
+                        for(int c=0; c < P.cols - nc + extra; ++c) {
+                            members.push_back(Placement{g, r, c});
+                            keys.resize(keys.size() + key_size);
+                            WindowKey(P, r, c, nr, nc, words_per_row,
+                                      &keys[keys.size() - key_size]);
+                        }
+                    }
+                }
+                GroupByKey(members, keys, key_size, is_query, next, num_bad);
+            }else{
+                for(const Collisions& group : groups) {
+                    members.clear();
+                    keys.clear();
+                    for(const Placement& p : group) {
+                        if(p.c < PG[p.g].cols - nc + extra) {
+                            members.push_back(p);
+                            keys.resize(keys.size() + column_words);
+                            ColumnKey(PG[p.g], p.r, p.c + nc - 1, nr,
+                                      &keys[keys.size() - column_words]);
+                        }
+                    }
+                    GroupByKey(members, keys, column_words, is_query, next, num_bad);
+                }
+            }
+            groups.swap(next);
+
+            if(!f(nr, nc, num_bad)) {
+                return;
+            }
+            if(groups.empty() && (nc >= 3 || nr == 2)) {
+                // Wider windows of these rows are unique too
+                break;
+            }
+        }
+    }
+}
+
+}
+
+PackedPattern::PackedPattern(const Eigen::MatrixXi& M)
+    : rows(M.rows()), cols(M.cols()), words((M.cols() + 63) / 64),
+      known(rows * words, 0), ones(rows * words, 0)
+{
+    for(int r=0; r<rows; ++r) {
+        for(int c=0; c<cols; ++c) {
+            const int v = M(r,c);
+            const uint64_t bit = uint64_t(1) << (c % 64);
+            if(v == 0 || v == 1) {
+                known[r * words + c / 64] |= bit;
+            }
+            if(v == 1) {
+                ones[r * words + c / 64] |= bit;
+            }
+        }
+    }
+}
+
+PackedPatternGroup PackGroup(const std::array<Eigen::MatrixXi, 4>& PG)
+{
+    PackedPatternGroup packed;
+    for(int g=0; g<4; ++g) {
+        packed[g] = PackedPattern(PG[g]);
+    }
+    return packed;
+}
+
 void SaveEPS(
     std::string filename, const Eigen::MatrixXi& M,
     const Eigen::Vector2d& offset, double grid_spacing,
@@ -134,15 +391,26 @@ int HammingDistance(const Eigen::MatrixXi& M, const Eigen::MatrixXi& m, int r, i
 }
 
 
+int HammingDistance(const PackedPattern& M, const PackedPattern& m, int r, int c)
+{
+    return HammingDistance(M, m, r, c, std::numeric_limits<int>::max());
+}
+
 int NumExactMatches(const Eigen::MatrixXi& M, const Eigen::MatrixXi& m, int& best_score, int& best_r, int& best_c)
 {
-    const int border = std::min((int)std::min(m.rows(),m.cols())-2, 2);
+    return NumExactMatches(PackedPattern(M), PackedPattern(m), best_score, best_r, best_c);
+}
+
+int NumExactMatches(const PackedPattern& M, const PackedPattern& m, int& best_score, int& best_r, int& best_c)
+{
+    const int border = std::min(std::min(m.rows,m.cols)-2, 2);
     best_score = std::numeric_limits<int>::max();
-    const Eigen::Vector2i rcmax( 2*border + M.rows() - m.rows(), 2*border + M.cols() - m.cols());
+    const Eigen::Vector2i rcmax( 2*border + M.rows - m.rows, 2*border + M.cols - m.cols);
     int num_zeros = 0;
     for(int r=-border; r < rcmax(0); ++r ) {
         for(int c=-border; c < rcmax(1); ++c) {
-            const int hd = HammingDistance(M, m, r,c );
+            // Only distances below the best so far, or exact matches, count
+            const int hd = HammingDistance(M, m, r, c, std::max(best_score, 1));
             if(hd < best_score) {
                 best_score = hd;
                 best_r = r;
@@ -158,6 +426,11 @@ int NumExactMatches(const Eigen::MatrixXi& M, const Eigen::MatrixXi& m, int& bes
 }
 
 int NumExactMatches(const std::array<Eigen::MatrixXi,4>& PG, const Eigen::MatrixXi& m, int& best_score, int& best_g, int& best_r, int& best_c)
+{
+    return NumExactMatches(PackGroup(PG), PackedPattern(m), best_score, best_g, best_r, best_c);
+}
+
+int NumExactMatches(const PackedPatternGroup& PG, const PackedPattern& m, int& best_score, int& best_g, int& best_r, int& best_c)
 {
     best_score = std::numeric_limits<int>::max();
     int num_exact = 0;
@@ -178,57 +451,25 @@ int NumExactMatches(const std::array<Eigen::MatrixXi,4>& PG, const Eigen::Matrix
 
 int AutoCorrelation(const std::array<Eigen::MatrixXi,4>& PG, int minr, int minc )
 {
-    const Eigen::MatrixXi& M = PG[0];
-    const int R = PG[0].rows();
-    const int C = PG[0].cols();
-
     int num_bad_matches = 0;
-
-    // For all sizes
-    for(int nr = minr; nr < R; ++nr ) {
-        for(int nc = minc; nc < C; ++nc ) {
-            const int MR = R - nr-1;
-            const int MC = C - nc-1;
-            // For all offsets
-            for(int r=0; r < MR; ++r) {
-                for(int c=0; c < MC; ++c ) {
-                    const Eigen::MatrixXi m = M.block(r,c,nr,nc);
-                    // Don't count the known good match (-1)
-                    int bs,bg,br,bc;
-                    num_bad_matches += NumExactMatches(PG, m, bs,bg,br,bc) - 1;
-                }
-            }
+    ScanWindowCollisions(PackGroup(PG), minr, [&](int /*nr*/, int nc, int num_bad) {
+        if(nc >= minc) {
+            num_bad_matches += num_bad;
         }
-    }
+        return true;
+    });
     return num_bad_matches;
 }
 
-int AutoCorrelationMinArea(const std::array<Eigen::MatrixXi,4>& PG )
+int AutoCorrelationMinArea(const std::array<Eigen::MatrixXi,4>& PG, int bound )
 {
-    const Eigen::MatrixXi& M = PG[0];
-    const int R = PG[0].rows();
-    const int C = PG[0].cols();
-
     int min_area = 0;
-
-    // For all sizes
-    for(int nr = 2; nr < R; ++nr ) {
-        for(int nc = 2; nc < C; ++nc ) {
-            const int MR = R - nr-1;
-            const int MC = C - nc-1;
-            // For all offsets
-            for(int r=0; r < MR; ++r) {
-                for(int c=0; c < MC; ++c ) {
-                    const Eigen::MatrixXi m = M.block(r,c,nr,nc);
-                    // Don't count the known good match (-1)
-                    int bs,bg,br,bc;
-                    if(NumExactMatches(PG, m, bs,bg,br,bc) > 1) {
-                        min_area = std::max(min_area, nr*nc+1 );
-                    }
-                }
-            }
+    ScanWindowCollisions(PackGroup(PG), 2, [&](int nr, int nc, int num_bad) {
+        if(num_bad > 0) {
+            min_area = std::max(min_area, nr*nc+1);
         }
-    }
+        return min_area < bound;
+    });
     return min_area;
 }
 
@@ -239,19 +480,58 @@ int SeedScore(uint32_t seed, int r, int c)
 }
 
 uint32_t FindBestSeed(int r, int c, bool& should_run) {
+    return FindBestSeed(r, c, should_run, SeedSearchOptions());
+}
 
+uint32_t FindBestSeed(int r, int c, bool& should_run, const SeedSearchOptions& options)
+{
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    std::mutex best_mutex;
     uint32_t best_seed = 0;
-    int best_score = std::numeric_limits<int>::max();
-
-    for(uint32_t seed=0; should_run; ++seed) {
-        const int score = SeedScore(seed,r,c);
-        if(score < best_score) {
-            best_seed = seed;
-            best_score = score;
-            std::cout << "*Seed " << seed << ": score:" << score << std::endl;
-        }else{
-            std::cout << " Seed " << seed << std::endl;
-        }
+    std::atomic<int> best_score(std::numeric_limits<int>::max());
+    std::atomic<uint64_t> next_seed(0);
+    std::atomic<bool> running(true);
+
+    const unsigned int num_threads = NumWorkerThreads(options.num_threads);
+    std::vector<std::thread> threads;
+    for(unsigned int t=0; t<num_threads; ++t) {
+        threads.emplace_back([&]() {
+            while(running && should_run) {
+                const uint64_t next = next_seed++;
+                if(next > std::numeric_limits<uint32_t>::max() ||
+                   (options.max_seeds > 0 && next >= options.max_seeds) ||
+                   (options.max_seconds > 0 && std::chrono::duration<double>(
+                        std::chrono::steady_clock::now() - start).count() >= options.max_seconds)) {
+                    running = false;
+                    break;
+                }
+                const uint32_t seed = (uint32_t)next;
+
+                // Seeds are scored out of order, so a lower seed may still
+                // tie the best, as the first seed of a serial search would.
+                int bound;
+                {
+                    std::lock_guard<std::mutex> lock(best_mutex);
+                    bound = best_score;
+                    if(bound < std::numeric_limits<int>::max() && seed < best_seed) {
+                        ++bound;
+                    }
+                }
+                const int score = AutoCorrelationMinArea(
+                    MakePatternGroup(r,c,seed), bound);
+
+                std::lock_guard<std::mutex> lock(best_mutex);
+                if(score < best_score || (score == best_score && seed < best_seed)) {
+                    best_seed = seed;
+                    best_score = score;
+                    std::cout << "*Seed " << seed << ": score:" << score << std::endl;
+                }
+            }
+        });
+    }
+    for(std::thread& thread : threads) {
+        thread.join();
     }
     return best_seed;
 }
@@ -23,6 +23,8 @@
 #include <calibu/target/GridDefinitions.h>
 #include <calibu/target/RandomGrid.h>
 #include <calibu/cam/camera_crtp.h>
+#include <calibu/utils/Parallel.h>
+#include <calibu/utils/PipelineStats.h>
 
 #define _USE_MATH_DEFINES
 
@@ -34,7 +36,6 @@
 #include <iostream>
 #include <iomanip>
 #include <iterator>
-#include <deque>
 #include <limits>
 #include <sstream>
 #include <numeric>
@@ -42,7 +43,6 @@
 #include <glog/logging.h>
 
 #include <opencv2/imgproc/imgproc.hpp>
-#include <opencv2/flann/flann.hpp>
 
 
 #define SCALE_FACTOR 6
@@ -102,6 +102,12 @@ void TargetGridDot::Init()
     }
   }
 
+  // Bit packed pattern for Match
+  PG_packed_ = PackGroup(PG_);
+
+  // Grid positions are relative to the central vertex until matched
+  map_grid_ellipse_.Reserve(grid_size_);
+
   // create binary pattern coords
   codepts3d.resize( 8 );
   double r = grid_spacing_*(grid_size_(1)+2.5);
@@ -112,34 +118,33 @@ void TargetGridDot::Init()
   }
 }
 
-std::vector<std::vector<Dist> > ClosestPoints(
-    std::vector<Vertex, Eigen::aligned_allocator<Vertex> >& pts)
+// The k closest points to each point, including itself, sorted by
+// increasing distance with the point itself first.
+void ClosestPoints(
+    std::vector<Vertex, Eigen::aligned_allocator<Vertex> >& pts, size_t k,
+    KdTree<3>& tree, std::vector<std::vector<Dist> >& ret)
 {
-    std::vector<std::vector<Dist> > ret;
-
-    // Set size of arrays
     ret.resize(pts.size());
-    for(size_t p1=0; p1 < pts.size(); ++p1)  ret[p1].resize(pts.size());
 
-    // Compute distances between all points
+    tree.Build(pts.size(), [&pts](size_t i) { return pts[i].pc_u; });
+
+    std::vector<KdTree<3>::Neighbour> neighbours;
     for(size_t p1=0; p1 < pts.size(); ++p1)
     {
-        ret[p1][p1] = Dist{ &pts[p1],0};
-        // Distance relation is symmetric
-        for(size_t p2=p1+1; p2 < pts.size(); ++p2 )
-        {
-            const double dist = DistanceUndistorted(pts[p1], pts[p2]);
-            ret[p1][p2] = Dist{ &pts[p2], dist};
-            ret[p2][p1] = Dist{ &pts[p1], dist};
+        tree.Knn(pts[p1].pc_u, k, neighbours);
+
+        // Coincident points may be ordered before p1 itself
+        auto self = std::find_if(neighbours.begin(), neighbours.end(),
+            [p1](const KdTree<3>::Neighbour& n) { return n.second == p1; });
+        if(self != neighbours.end()) {
+            std::rotate(neighbours.begin(), self, self + 1);
         }
-    }
 
-    // sort distances
-    for(size_t p1=0; p1 < pts.size(); ++p1) {
-        std::sort(ret[p1].begin(), ret[p1].end() );
+        ret[p1].clear();
+        for(const KdTree<3>::Neighbour& n : neighbours) {
+            ret[p1].push_back(Dist{ &pts[n.second], n.first });
+        }
     }
-
-    return ret;
 }
 
 std::vector<Dist> MostCentral( const std::vector<std::vector<Dist> >& distances, std::vector<size_t> & indices_out)
@@ -170,7 +175,7 @@ std::vector<Triple*> PrincipleDirections( Vertex& v)
     // Find principle directions by observing that neighbours from princple
     // directions are central within triple that is also formed from these
     // neighbours.
-    std::set<Triple*> pd;
+    std::vector<Triple*> ret;
     for(size_t i=0; i<v.triples.size(); ++i) {
         Triple& t = v.triples[i];
         for(size_t j=0; j<2; ++j) {
@@ -180,17 +185,15 @@ std::vector<Triple*> PrincipleDirections( Vertex& v)
                 if(a.In(v.neighbours))  {
                     // a is parallel to principle direction
                     // t is a parallel direction.
-                    pd.insert(&t);
+                    if(std::find(ret.begin(), ret.end(), &t) == ret.end()) {
+                        ret.push_back(&t);
+                    }
                     break;
                 }
             }
         }
     }
 
-    // convert to vector
-    std::vector<Triple*> ret;
-    ret.insert(ret.begin(), pd.begin(), pd.end());
-
     // find most x-ily and y-ily
     if(ret.size() == 2) {
         Eigen::Vector2d d[2] = { ret[0]->Dir(), ret[1]->Dir() };
@@ -220,515 +223,396 @@ double NormArea(const Eigen::Vector2d& p1, const Eigen::Vector2d& p2, const Eige
     return std::abs(area) / (len*len);
 }
 
-double Area(const Conic& c)
+// Area of a dot of the given radius. The area of the fitted ellipse,
+// pi*a*b with a and b the semi axes of C, was found to be less robust.
+double Area(double radius)
 {
-    // http://en.wikipedia.org/wiki/Matrix_representation_of_conic_sections
-    const Eigen::Matrix2d A33 = c.C.block<2,2>(0,0);
-    Eigen::SelfAdjointEigenSolver<Eigen::Matrix2d> eigensolver(A33);
-    /*if (eigensolver.info() == Eigen::Success) {
-        const double detA = c.C.determinant();
-        const double detA33 = A33.determinant();
-        const double fac = -detA / (detA33);
-        const Eigen::Vector2d l = eigensolver.eigenvalues();
-
-        const double a = sqrt(fac/l[0]);
-        const double b = sqrt(fac/l[1]);*/
-
-    return M_PI * c.radius * c.radius;//* a * b;
-    /*}else{
-        return 0.0;
-    }*/
+    return M_PI * radius * radius;
 }
 
-std::set<Vertex*> Neighbours(std::map<Eigen::Vector2i const, Vertex*,
-                             std::less<Eigen::Vector2i>,
-                             Eigen::aligned_allocator<
-                             std::pair<Eigen::Vector2i const, Vertex*> > >& map, const Vertex& v)
+void Neighbours(const VertexGrid& map, const Vertex& v, VertexNeighbours& neighbours)
 {
-    std::set<Vertex*> neighbours;
+    neighbours.clear();
     for(int r=-1; r <=1; ++r) {
         for(int c=-1; c<=1; ++c) {
             Eigen::Vector2i pg(v.pg[0]+c, v.pg[1]+r);
-            auto i = map.find(pg);
-            if(i!= map.end()) {
-                neighbours.insert(i->second);
+            Vertex* n = map.Find(pg);
+            if(n) {
+                neighbours.insert_unique(n);
             }
         }
     }
-    return neighbours;
 }
 
-void FindTriples( Vertex& v, std::vector<Dist>& closest, double thresh_dist, double thresh_area, const ImageProcessing& images, cv::Mat & debug_image)
+// Pseudo angle of direction (x,y), increasing with atan2(y,x) over
+// (-pi,pi] and mapping it to (-2,2], without trigonometry.
+inline double PseudoAngle(double x, double y)
 {
-    // Consider 9 closests points (including itself)
-    const size_t NEIGHBOURS = 14;
-    const size_t max_neigh = std::min(closest.size(), NEIGHBOURS);
-
-    // We need at least 3 points for a single collinear triple.
-    if(max_neigh < 3) return;
-
-    float color = 42.5;
-
-    for (size_t n1 = 0; n1 < max_neigh; n1++) {
-        Vertex& c1 = *closest[n1].v;
-        auto pt1 = cv::Point2d(c1.pc.x(), c1.pc.y());
-        OPENCV_DEBUG(cv::circle(debug_image, SCALE_FACTOR*pt1, 1, color * 5);)
+    if(x == 0 && y == 0) return 0;
+    double p;
+    if(y >= 0) {
+        p = x >= 0 ? y / (x + y) : 1 - x / (y - x);
+    }else{
+        p = x < 0 ? 2 - y / (-x - y) : 3 + x / (x - y);
     }
+    return p > 2 ? p - 4 : p;
+}
 
-    // Ignore points too much furthar than closest.
-    // We are interested in 8-connected region
-    const double max_dist = 5 * closest[1].dist;
-
-    std::array<bool,NEIGHBOURS> used;
-    used.fill(false);
-
-    std::array<bool, 4> direction_bins;
-    direction_bins.fill(false);
+// True if the thresholded image along the line from a to b, with its end
+// points taken as dark, reads dark, light, dark: a single light gap
+// separates the two dots.
+bool SingleGap(const cv::Mat& thresh, const cv::Point2d& a, const cv::Point2d& b)
+{
+    static const unsigned char expected[3] = { 0, 255, 0 };
+    cv::LineIterator it(thresh, a, b);
+    int runs = 0;
+    int last = -1;
+    for(int i = 0; i < it.count; ++i, ++it) {
+        const int val = (i == 0 || i == it.count - 1) ? 0 : **it;
+        if(val != last) {
+            if(runs == 3 || val != expected[runs]) return false;
+            ++runs;
+            last = val;
+        }
+    }
+    return runs == 3;
+}
 
-    std::array<double, 4> direction_bins_scores;
-    direction_bins_scores.fill(std::numeric_limits<double>::max());
+// Pairs of the closest points of v on opposite sides of it, each closest
+// point in at most one pair. Only reads vertex positions, so that the
+// vertices can be processed concurrently.
+void FindTriplePairs(
+        const Vertex& v, const std::vector<Dist>& closest,
+        double thresh_dist, double thresh_area,
+        const cv::Mat& thresh, double level_scale,
+        TriplePairs& pairs)
+{
+    pairs.clear();
 
-    std::set<double> angles;
+    // Consider the 13 closest points (excluding itself)
+    const int NEIGHBOURS = 14;
+    const int max_neigh = std::min<int>(closest.size(), NEIGHBOURS);
 
-    std::vector<double> angles_diffs;
+    // We need at least 3 points for a single collinear triple.
+    if(max_neigh < 3) return;
 
+    // Ignore points too much further than closest.
+    // We are interested in 8-connected region
+    const double max_dist = 5 * closest[1].dist;
 
-    //compute the angle for possible pairs
-    std::vector<std::pair<double, size_t> > angles_and_indices;
-    for (size_t n1 = 1; n1 < max_neigh; ++n1) {
-        //Eigen::Vector2d diff = Eigen::CwiseBinaryOp<Eigen::internal::scalar_difference_op<double>, Eigen::Vector2d, Eigen::Vector2d>(closest[n1].v->pc,v.pc);
-        auto diff = closest[n1].v->pc - v.pc;
-        angles_and_indices.push_back(std::pair<double, size_t>(std::atan2(diff.y(), diff.x()), n1));
+    // Unit direction to each neighbour, and all their pairwise cosines
+    Eigen::Matrix<double, 2, Eigen::Dynamic, 0, 2, NEIGHBOURS> dirs(2, max_neigh);
+    std::array<double, NEIGHBOURS> pseudo;
+    dirs.col(0).setZero();
+    for(int n = 1; n < max_neigh; ++n) {
+        const Eigen::Vector2d d = closest[n].v->pc - v.pc;
+        const double len = d.norm();
+        dirs.col(n) = len > 0 ? Eigen::Vector2d(d / len) : Eigen::Vector2d::Zero();
+        pseudo[n] = PseudoAngle(d[0], d[1]);
     }
-
-    std::sort(angles_and_indices.begin(), angles_and_indices.end(), [](std::pair<double, size_t> &a, std::pair<double, size_t> &b) { return a.first < b.first; });
-
-    bool erase_front = false;
-    std::vector<std::pair<Eigen::Vector2i, Eigen::Vector2d> > pairs;
-    for (auto front = angles_and_indices.begin(); front != angles_and_indices.end(); /*front++*/) {
-        for (auto rear = angles_and_indices.rbegin(); rear != std::make_reverse_iterator(front+1); /*rear++*/)
-        {
-            auto n1 = front->second;
-            auto n2 = rear->second;
-            Vertex& c1 = *closest[n1].v;
-            Vertex& c2 = *closest[n2].v;
-
-            auto pt1 = cv::Point2d(c1.pc.x(), c1.pc.y());
-            auto pt2 = cv::Point2d(v.pc.x(), v.pc.y());
-            auto pt3 = cv::Point2d(c2.pc.x(), c2.pc.y());
-
-            for (size_t n1 = 0; n1 < max_neigh; n1++) {
-                Vertex& c1 = *closest[n1].v;
-                auto pt1 = cv::Point2d(c1.pc.x(), c1.pc.y());
-                OPENCV_DEBUG(cv::circle(debug_image, SCALE_FACTOR*pt1, 1, color * 5);)
-            }
-
-            OPENCV_DEBUG(cv::circle(debug_image, SCALE_FACTOR*pt1, 1, color);)
-            OPENCV_DEBUG(cv::circle(debug_image, SCALE_FACTOR*pt2, 1, color * 2);)
-            OPENCV_DEBUG(cv::circle(debug_image, SCALE_FACTOR*pt3, 1, color * 3);)
-
-            if (std::abs(front->first - rear->first + M_PI) < 0.1)
-            {
+    const Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic, 0, NEIGHBOURS, NEIGHBOURS>
+            cosines = dirs.transpose() * dirs;
+
+    // Directions more than pi - 0.1 apart are on opposite sides
+    const double max_cos = -std::cos(0.1);
+
+    // Neighbours by direction, still to be paired
+    std::array<int, NEIGHBOURS> order;
+    int m = 0;
+    for(int n = 1; n < max_neigh; ++n) order[m++] = n;
+    std::sort(order.begin(), order.begin() + m, [&pseudo](int a, int b) {
+        return pseudo[a] < pseudo[b];
+    });
+    auto erase = [&order, &m](int i) {
+        std::move(order.begin() + i + 1, order.begin() + m, order.begin() + i);
+        --m;
+    };
+
+    // Pair each direction with the furthest round opposite one. Of two
+    // opposite neighbours at dissimilar distances, the further is dropped.
+    int f = 0;
+    while(f < m) {
+        bool erase_front = false;
+        int r = m - 1;
+        while(r > f) {
+            const int n1 = order[f];
+            const int n2 = order[r];
+            if(cosines(n1, n2) < max_cos) {
                 const double d1 = closest[n1].dist;
                 const double d2 = closest[n2].dist;
-                if (2.0 * fabs(d2 - d1) / (fabs(d1) + fabs(d2)) < thresh_dist)
-                {
-
-                    auto candidate = std::pair<Eigen::Vector2i, Eigen::Vector2d>(Eigen::Vector2i(front->second, rear->second), Eigen::Vector2d(front->first, rear->first));
-
+                if(2.0 * std::abs(d2 - d1) / (std::abs(d1) + std::abs(d2)) < thresh_dist) {
+                    TriplePair candidate;
+                    candidate.n1 = n1;
+                    candidate.n2 = n2;
+                    const Eigen::Vector2d diff1 = closest[n1].v->pc - v.pc;
+                    const Eigen::Vector2d diff2 = closest[n2].v->pc - v.pc;
+                    candidate.angle1 = std::atan2(diff1.y(), diff1.x());
+                    candidate.angle2 = std::atan2(diff2.y(), diff2.x());
+                    candidate.valid = false;
+
+                    // Of pairs in nearly the same directions, keep the closer
                     bool good_candidate = true;
-                    if (!pairs.empty()) {
-                        auto angle_distance = (pairs.back().second - candidate.second).squaredNorm();
-
-                        //LOG(INFO) << angle_distance;
-
-                        if (angle_distance < 0.05) {
-                            //collision
-                            //keep the closer pair
-                            if (closest[pairs.back().first.x()].dist > closest[candidate.first.x()].dist || closest[pairs.back().first.y()].dist > closest[candidate.first.y()].dist) {
-                                pairs.pop_back();
-                            }
-                            else {
+                    if(!pairs.empty()) {
+                        const TriplePair& last = pairs.back();
+                        const double da1 = last.angle1 - candidate.angle1;
+                        const double da2 = last.angle2 - candidate.angle2;
+                        if(da1*da1 + da2*da2 < 0.05) {
+                            if(closest[last.n1].dist > d1 || closest[last.n2].dist > d2) {
+                                pairs.erase(pairs.end() - 1);
+                            }else{
                                 good_candidate = false;
                             }
                         }
                     }
-
-                    if(good_candidate)
+                    if(good_candidate) {
                         pairs.push_back(candidate);
+                    }
 
-                    //erase both case
-
+                    erase(r);
                     erase_front = true;
-                    //erase rear
-                    //no need to clean up the loop is broken out of
-                    angles_and_indices.erase((rear+1).base());
-                    //front = angles_and_indices.erase(front);
-                    //front--;
                     break;
+                }else if(d1 > d2) {
+                    erase(f);
+                    r = m - 1;
+                }else{
+                    erase(r);
+                    f = 0;
+                    r = m - 1;
                 }
-                else
-                {
-                    if (d1 > d2)
-                    {
-                        //erase front case
-                        front = angles_and_indices.erase(front);
-                        //reset rear because iterators are invalidated after erase
-                        rear = angles_and_indices.rbegin();
-                        //rear--;
-                    }
-                    else
-                    {
-                        //erase rear case
-                        angles_and_indices.erase((rear+1).base());
-                        //reset front and rear because iterators are invalidated after erase
-                        front = angles_and_indices.begin();
-                        rear = angles_and_indices.rbegin();
-                    }
-                }
+            }else{
+                --r;
             }
-            else {
-                rear++;
-            }
-        }
-
-        if (erase_front)
-        {
-            erase_front = false;
-            front = angles_and_indices.erase(front);
         }
-        else {
-            ++front;
+        if(erase_front) {
+            erase(f);
+        }else{
+            ++f;
         }
     }
 
-    if (pairs.size() > 4)
-    {
-        //check for neighbor and choose consistant 4
-        //LOG(INFO) << "4";
-
-        //check if one of the pair has contains a neighbor with triples
-        auto max_triples = 0;
-        auto max_triples_index = 0;
-        for (auto & pair : pairs)
-        {
-            //search for the neighbor with the most triples
-            if (closest[pair.first.x()].v->triples.size() > max_triples) {
-                max_triples = closest[pair.first.x()].v->triples.size();
-                max_triples_index = pair.first.x();
-            }
+    // Check each pair forms a line of three distinct dots of similar spacing
+    for(TriplePair& pair : pairs) {
+        const Vertex& c1 = *closest[pair.n1].v;
+        const Vertex& c2 = *closest[pair.n2].v;
+        const double d1 = closest[pair.n1].dist;
+        const double d2 = closest[pair.n2].dist;
+        pair.valid =
+                d1 < max_dist && d2 < max_dist &&
+                2.0 * std::abs(d2 - d1) / (std::abs(d1) + std::abs(d2)) < thresh_dist &&
+                NormArea(c1.pc, v.pc, c2.pc) < thresh_area &&
+                SingleGap(thresh, level_scale * cv::Point2d(c1.pc.x(), c1.pc.y()),
+                          level_scale * cv::Point2d(v.pc.x(), v.pc.y())) &&
+                SingleGap(thresh, level_scale * cv::Point2d(v.pc.x(), v.pc.y()),
+                          level_scale * cv::Point2d(c2.pc.x(), c2.pc.y()));
+    }
+}
 
-            if (closest[pair.first.y()].v->triples.size() > max_triples) {
-                max_triples = closest[pair.first.y()].v->triples.size();
-                max_triples_index = pair.first.y();
+// Add the triples of v from its candidate pairs. Where there are more than
+// 4 pairs, those matching the directions of the triples of the neighbour
+// with most triples are preferred, so vertices must be visited in order.
+void FindTriples(Vertex& v, const std::vector<Dist>& closest, TriplePairs& pairs, cv::Mat& debug_image)
+{
+    if(pairs.size() > 4) {
+        // Neighbour with the most triples
+        size_t max_triples = 0;
+        int max_triples_index = 0;
+        for(const TriplePair& pair : pairs) {
+            for(int n : { pair.n1, pair.n2 }) {
+                if(closest[n].v->triples.size() > max_triples) {
+                    max_triples = closest[n].v->triples.size();
+                    max_triples_index = n;
+                }
             }
         }
 
-        if (max_triples > 0) {
-            auto neighboring_triples = closest[max_triples_index].v->triples;
-
-            std::vector<std::pair<double, std::vector<std::pair<Eigen::Vector2i, Eigen::Vector2d> >::iterator > > distances(neighboring_triples.size());
-            std::vector<bool> used2(neighboring_triples.size(), false);
-            for (auto iter = pairs.begin(); iter != pairs.end(); iter++) {
-
-                Eigen::VectorXd current_distances(neighboring_triples.size());
-                for (int j = 0; j < neighboring_triples.size(); j++)
-                {
-                    current_distances[j] = (neighboring_triples[j].m_angles - iter->second).squaredNorm();
-                }
+        if(max_triples > 0) {
+            // Each of its triples keeps the nearest pair by direction
+            const auto& neighbouring_triples = closest[max_triples_index].v->triples;
+            std::array<int, VERTEX_MAX_TRIPLES> claim;
+            std::array<double, VERTEX_MAX_TRIPLES> claim_dist;
+            std::array<bool, VERTEX_MAX_TRIPLES> keep;
+            claim.fill(-1);
+            keep.fill(true);
+            for(size_t i = 0; i < pairs.size(); ++i) {
+                const Eigen::Vector2d angles(pairs[i].angle1, pairs[i].angle2);
                 int index = 0;
-                auto current_distance = current_distances.minCoeff(&index);
-
-                if (!used2[index]) {
-                    used2[index] = true;
-                    distances[index] = std::pair<double, std::vector<std::pair<Eigen::Vector2i, Eigen::Vector2d> >::iterator>(current_distance, iter);
-                }
-                else {
-                    //collision
-                    //compare distances
-                    if (distances[index].first < current_distance)
-                    {
-                        iter = pairs.erase(iter);
-                        iter--;
-                    }
-                    else
-                    {
-                        auto dist = std::distance(pairs.begin(), iter);
-                        dist -= 1;
-                        pairs.erase(distances[index].second);
-                        iter = pairs.begin() + dist;
-                        distances[index] = std::pair<double, std::vector<std::pair<Eigen::Vector2i, Eigen::Vector2d> >::iterator>(current_distance, iter);
+                double current_distance = std::numeric_limits<double>::max();
+                for(size_t j = 0; j < neighbouring_triples.size(); ++j) {
+                    const double d = (neighbouring_triples[j].m_angles - angles).squaredNorm();
+                    if(d < current_distance) {
+                        current_distance = d;
+                        index = j;
                     }
                 }
+                if(claim[index] < 0) {
+                    claim[index] = i;
+                    claim_dist[index] = current_distance;
+                }else if(claim_dist[index] < current_distance) {
+                    keep[i] = false;
+                }else{
+                    keep[claim[index]] = false;
+                    claim[index] = i;
+                    claim_dist[index] = current_distance;
+                }
             }
+            size_t kept = 0;
+            for(size_t i = 0; i < pairs.size(); ++i) {
+                if(keep[i]) pairs[kept++] = pairs[i];
+            }
+            while(pairs.size() > kept) pairs.erase(pairs.end() - 1);
         }
     }
 
-    if (pairs.size() > 4)
-    {
+    if(pairs.size() > 4) {
         LOG(INFO) << "double check";
     }
 
-    // Filter possible pairs
-    //for(size_t n1 = 1; n1 < max_neigh; ++n1 ) {
-    for(auto &pair : pairs){
-        auto n1 = pair.first.x();
-        auto n2 = pair.first.y();
-        const double d1 = closest[n1].dist;
-
-        if (used[n1])
+    std::array<bool, 14> used;
+    used.fill(false);
+    for(const TriplePair& pair : pairs) {
+        if(used[pair.n1] || used[pair.n2] || !pair.valid) {
             continue;
-
-        //for(size_t n2 = n1+1; n2 < max_neigh; ++n2 ) {
-            const double d2 = closest[n2].dist;
-
-            if (used[n2])
-                continue;
-
-            Vertex& c1 = *closest[n1].v;
-            Vertex& c2 = *closest[n2].v;
-
-            auto pt1 = cv::Point2d(c1.pc.x(), c1.pc.y());
-            auto pt2 = cv::Point2d(v.pc.x(), v.pc.y());
-            auto pt3 = cv::Point2d(c2.pc.x(), c2.pc.y());
-
-            for (size_t n1 = 0; n1 < max_neigh; n1++) {
-                Vertex& c1 = *closest[n1].v;
-                auto pt1 = cv::Point2d(c1.pc.x(), c1.pc.y());
-                OPENCV_DEBUG(cv::circle(debug_image, SCALE_FACTOR*pt1, 1, color * 5);)
-            }
-
-            OPENCV_DEBUG(cv::circle(debug_image, SCALE_FACTOR*pt1, 1, color);)
-            OPENCV_DEBUG(cv::circle(debug_image, SCALE_FACTOR*pt2, 1, color * 2);)
-            OPENCV_DEBUG(cv::circle(debug_image, SCALE_FACTOR*pt3, 1, color * 3);)
-
-            // Check distances aren't much further than closest
-            if( d1 < max_dist && d2 < max_dist )
-            {
-                // Check distances are similar
-                if( 2.0 * fabs(d2-d1) / (fabs(d1)+fabs(d2)) < thresh_dist )
-                {
-                    // Check points are colinear with center
-
-
-                    if( NormArea(c1.pc,v.pc,c2.pc) < thresh_area )
-                    {
-
-
-
-                        // Check no aliasing exists between matched
-                        if(used[n1] || used[n2]) {
-                            v.triples.clear();
-                            v.neighbours.clear();
-                            OPENCV_DEBUG(cv::line(debug_image, SCALE_FACTOR*pt1, SCALE_FACTOR*pt2, 255);)
-                            OPENCV_DEBUG(cv::line(debug_image, SCALE_FACTOR*pt2, SCALE_FACTOR*pt3, 255);)
-                            for (size_t n1 = 0; n1 < max_neigh; ++n1) {
-                                Vertex& c1 = *closest[n1].v;
-                                auto pt1 = cv::Point2d(c1.pc.x(), c1.pc.y());
-                                OPENCV_DEBUG(cv::circle(debug_image, SCALE_FACTOR*pt1, 1, 0);)
-                            }
-                            return;
-                        }else{
-                            //check line iterator
-                            const cv::Mat input(images.Height(), images.Width(), cv::DataType<unsigned char>::type, const_cast<unsigned char *>(images.ImgThresh()));
-                            /*auto pt1 = cv::Point(c1.pc.x(), c1.pc.y());
-                            auto pt2 = cv::Point(c2.pc.x(), c2.pc.y());
-                            cv::LineIterator it(input, pt1, pt2);
-                            std::vector<unsigned char> buf(it.count);
-                            std::vector<cv::Point> buf_positions(it.count);
-                            for (int i = 0; i < it.count; i++, ++it)
-                            {
-                                buf[i] = *(*it);
-                                buf_positions[i] = it.pos();
-                            }
-                            buf[0] = 0;
-                            buf[it.count - 1] = 0;
-                            std::vector<unsigned char> buf2 = buf;
-
-                            auto last = std::unique(buf.begin(), buf.end());
-
-                            buf.erase(last, buf.end());
-
-                            std::vector<unsigned char> check = { 0, 255, 0, 255, 0 };
-
-                            if (buf == check){*/
-
-
-
-                            cv::LineIterator it(input, pt1, pt2);
-                            std::vector<unsigned char> buf(it.count);
-                            std::vector<cv::Point> buf_positions(it.count);
-                            for (int i = 0; i < it.count; i++, ++it)
-                            {
-                                buf[i] = *(*it);
-                                buf_positions[i] = it.pos();
-                            }
-                            buf[0] = 0;
-                            buf[it.count - 1] = 0;
-                            std::vector<unsigned char> buf2 = buf;
-
-                            auto last = std::unique(buf.begin(), buf.end());
-
-                            buf.erase(last, buf.end());
-
-
-
-
-                            cv::LineIterator it2(input, pt2, pt3);
-                            std::vector<unsigned char> buf3(it2.count);
-                            std::vector<cv::Point> buf_positions3(it2.count);
-                            for (int i = 0; i < it2.count; i++, ++it2)
-                            {
-                                buf3[i] = *(*it2);
-                                buf_positions3[i] = it2.pos();
-                            }
-                            buf3[0] = 0;
-                            buf3[it2.count - 1] = 0;
-                            std::vector<unsigned char> buf4 = buf3;
-
-                            auto last2 = std::unique(buf3.begin(), buf3.end());
-
-                            buf3.erase(last2, buf3.end());
-
-
-                            std::vector<unsigned char> check = { 0, 255, 0 };
-
-                            cv::Point2d diff = pt3 - pt1;
-
-                            auto angle = atan2(diff.y, diff.x);
-
-                            if (angle < 0)
-                                angle += M_PI;
-
-                            //LOG(INFO) << "angle: " << angle;
-
-                            angles_diffs.clear();
-
-                            if (angles.size() >= 2) {
-                                std::set<double>::iterator end = angles.end();
-                                end--;
-                                for (std::set<double>::iterator it = angles.begin(); it != end; it++)
-                                {
-                                    std::set<double>::iterator it2 = it;
-                                    it2++;
-                                    angles_diffs.push_back(*it2 - *it);
-                                }
-                                angles_diffs.push_back((*(angles.begin()) + M_PI) - *(end));
-                            }
-                            else {
-                                angles_diffs.push_back( M_PI );
-                            }
-
-                            Eigen::Map<Eigen::ArrayXd> angles_diffs2(angles_diffs.data(), angles_diffs.size());
-
-                            int angles_diffs2_index = -1;
-                            angles_diffs2.maxCoeff(&angles_diffs2_index);
-
-
-                            auto ret = angles.insert(angle);
-
-                            auto dist = std::distance(angles.begin(), ret.first);
-
-                            //LOG(INFO) << "distance: " << dist;
-
-                            //if (dist == 0 || dist == (angles.count() - 1))
-
-                            /*if (dist != 0 && dist != (angles.size() - 1))
-                            {
-                                std::set<double>::iterator before = ret.first;
-                                before--;
-                                std::set<double>::iterator after = ret.first;
-                                after++;
-                                if ( (*(ret.first) - *before)  < (M_PI / 5) &&  (*after - *(ret.first)) < (M_PI / 5))
-                                {
-                                    angles.erase(ret.first);
-                                    break;
-                                }
-
-                                if (dist-1 != angles_diffs2_index)
-                                {
-                                    break;
-                                }
-
-                            }*/
-
-                            Eigen::VectorXd bins(9);
-                            Eigen::VectorXi indices(9);
-                            bins << 0.0, M_PI, M_PI/4, M_PI/2, (M_PI/4 + M_PI/2), -M_PI, -M_PI/4, -M_PI/2, -(M_PI/4 + M_PI/2);
-                            indices << 0, 0, 1, 2, 3, 0, 3, 2, 1;
-
-                            int index = -1;
-                            auto absdiff = (bins.array() - angle).abs();
-                            auto score = absdiff.minCoeff(&index);
-
-                            if (buf == check && buf3 == check /*&& direction_bins_scores[indices[index]] > score*/) {
-                                used[n1] = true;
-                                used[n2] = true;
-                                direction_bins[indices[index]] = true;
-                                direction_bins_scores[indices[index]] = score;
-                                v.neighbours.insert(&c1);
-                                v.neighbours.insert(&c2);
-                                v.triples.push_back(Triple(c1, v, c2, pair.second));
-                                OPENCV_DEBUG(cv::line(debug_image, SCALE_FACTOR*pt1, SCALE_FACTOR*pt2, color *4);)
-                                OPENCV_DEBUG(cv::line(debug_image, SCALE_FACTOR*pt2, SCALE_FACTOR*pt3, color * 4);)
-
-                                if (false)//(v.triples.size() == 4)
-                                {
-                                    for (size_t n1 = 0; n1 < max_neigh; ++n1) {
-                                        Vertex& c1 = *closest[n1].v;
-                                        auto pt1 = cv::Point2d(c1.pc.x(), c1.pc.y());
-                                        OPENCV_DEBUG(cv::circle(debug_image, SCALE_FACTOR*pt1, 1, 0);)
-                                    }
-                                    return;
-                                }
-
-                                //break;
-                            } else {
-                                check[0] = 0;
-                            }
-                        }
-
-
-
-
-
-                    }
-
-                }
-            }
-
-            /*cv::circle(debug_image, pt1, 1, 0);
-            cv::circle(debug_image, pt2, 1, 0);
-            cv::circle(debug_image, pt3, 1, 0);*/
         }
-    //}
-
-    //LOG(INFO) << "here: ";
-
-    for (size_t n1 = 0; n1 < max_neigh; ++n1) {
-        Vertex& c1 = *closest[n1].v;
-        auto pt1 = cv::Point2d(c1.pc.x(), c1.pc.y());
-        OPENCV_DEBUG(cv::circle(debug_image, SCALE_FACTOR*pt1, 1, 0);)
+        Vertex& c1 = *closest[pair.n1].v;
+        Vertex& c2 = *closest[pair.n2].v;
+        used[pair.n1] = true;
+        used[pair.n2] = true;
+        v.neighbours.insert_unique(&c1);
+        v.neighbours.insert_unique(&c2);
+        v.triples.push_back(Triple(c1, v, c2, Eigen::Vector2d(pair.angle1, pair.angle2)));
+        OPENCV_DEBUG(cv::line(debug_image, SCALE_FACTOR*cv::Point2d(c1.pc.x(), c1.pc.y()), SCALE_FACTOR*cv::Point2d(v.pc.x(), v.pc.y()), 170);)
+        OPENCV_DEBUG(cv::line(debug_image, SCALE_FACTOR*cv::Point2d(v.pc.x(), v.pc.y()), SCALE_FACTOR*cv::Point2d(c2.pc.x(), c2.pc.y()), 170);)
     }
-
 }
 
 bool TargetGridDot::FindTarget(
         const Sophus::SE3d& T_cw,
         const std::shared_ptr<CameraInterface<double>> cam,
         const ImageProcessing& images,
-        const std::vector<Conic, Eigen::aligned_allocator<Conic> >& conics,
+        const ConicSet& conics,
         std::vector<int>& ellipse_target_map
         )
 {
-    // This target doesn't use position or camera information
+    // The pose predicts where the dots are, falling back to a full search
+    if(TrackTarget(T_cw, cam, conics, ellipse_target_map)) {
+        return true;
+    }
     return FindTarget(images,conics,ellipse_target_map);
 }
 
+bool TargetGridDot::TrackTarget(
+        const Sophus::SE3d& T_cw,
+        const std::shared_ptr<CameraInterface<double>> cam,
+        const ConicSet& conics,
+        std::vector<int>& ellipse_target_map
+        )
+{
+    Clear();
+    ellipse_target_map.assign(conics.size(), -1);
+    if(!cam || conics.empty()) {
+        return false;
+    }
+
+    // Predict dot positions. Dots behind the camera or outside of the image
+    // are not expected to be seen.
+    const int cols = grid_size_(0);
+    const int rows = grid_size_(1);
+    const double w = cam->Width();
+    const double h = cam->Height();
+    std::vector<Eigen::Vector2d, Eigen::aligned_allocator<Eigen::Vector2d> >& predicted = track_predicted_;
+    std::vector<double>& gate = track_gate_;
+    predicted.resize(tpts3d.size());
+    gate.assign(tpts3d.size(), -1.0);
+    for(size_t i=0; i < tpts3d.size(); ++i) {
+        const Eigen::Vector3d P_c = T_cw * tpts3d[i];
+        if(P_c[2] > 0) {
+            predicted[i] = cam->Project(P_c);
+            if(predicted[i].allFinite() && 0 <= predicted[i][0] && predicted[i][0] < w &&
+               0 <= predicted[i][1] && predicted[i][1] < h) {
+                gate[i] = std::numeric_limits<double>::max();
+            }
+        }
+    }
+
+    // Gate each visible dot by its distance to the neighbouring dots
+    int num_visible = 0;
+    for(int r=0; r < rows; ++r) {
+        for(int c=0; c < cols; ++c) {
+            const int i = r*cols + c;
+            if(gate[i] < 0) continue;
+            double spacing = std::numeric_limits<double>::max();
+            if(c+1 < cols && gate[i+1] >= 0) {
+                spacing = std::min(spacing, (predicted[i+1] - predicted[i]).norm());
+            }
+            if(c > 0 && gate[i-1] >= 0) {
+                spacing = std::min(spacing, (predicted[i-1] - predicted[i]).norm());
+            }
+            if(r+1 < rows && gate[i+cols] >= 0) {
+                spacing = std::min(spacing, (predicted[i+cols] - predicted[i]).norm());
+            }
+            if(r > 0 && gate[i-cols] >= 0) {
+                spacing = std::min(spacing, (predicted[i-cols] - predicted[i]).norm());
+            }
+            if(spacing == std::numeric_limits<double>::max()) {
+                // Isolated dot, position not reliable enough to gate
+                gate[i] = -1.0;
+                continue;
+            }
+            gate[i] = params_.track_gate_ratio * spacing;
+            ++num_visible;
+        }
+    }
+    if(num_visible == 0) {
+        return false;
+    }
+
+    // Nearest conic to each dot, keeping the closest dot for each conic
+    track_tree_.Build(conics.size(), [&conics](size_t i) { return conics.Center(i); });
+    std::vector<int>& conic_dot = track_dot_;
+    std::vector<double>& conic_dist = track_dist_;
+    conic_dot.assign(conics.size(), -1);
+    conic_dist.assign(conics.size(), std::numeric_limits<double>::max());
+    std::vector<KdTree<2>::Neighbour> nearest;
+    for(size_t i=0; i < tpts3d.size(); ++i) {
+        if(gate[i] < 0) continue;
+        track_tree_.Knn(predicted[i], 1, nearest);
+        const size_t j = nearest[0].second;
+        const double d = nearest[0].first;
+        if(d <= gate[i] * gate[i] && d < conic_dist[j]) {
+            conic_dot[j] = i;
+            conic_dist[j] = d;
+        }
+    }
+
+    int num_associated = 0;
+    for(size_t j=0; j < conics.size(); ++j) {
+        if(conic_dot[j] >= 0) {
+            ellipse_target_map[j] = conic_dot[j];
+            ++num_associated;
+        }
+    }
+
+    if(num_associated < params_.track_min_inlier_ratio * num_visible) {
+        ellipse_target_map.assign(conics.size(), -1);
+        return false;
+    }
+
+    // Keep Map() consistent with the association
+    for(size_t j=0; j < conics.size(); ++j) {
+        Vertex v(j, conics);
+        const int t = ellipse_target_map[j];
+        if(t >= 0) {
+            v.pg = Eigen::Vector2i(t % cols, t / cols);
+        }
+        vs_.push_back(v);
+    }
+    return true;
+}
+
 bool TargetGridDot::FindTarget(
         const std::shared_ptr<CameraInterface<double>> cam,
         const ImageProcessing& images,
-        const std::vector<Conic, Eigen::aligned_allocator<Conic> >& conics,
+        const ConicSet& conics,
         std::vector<int>& ellipse_target_map
         )
 {
@@ -740,26 +624,25 @@ void TargetGridDot::Clear()
 {
     vs_.clear();
     line_groups_.clear();
-    map_grid_ellipse_.clear();
+    map_grid_ellipse_.Clear();
 }
 
 void TargetGridDot::SetGrid(Vertex& v, const Eigen::Vector2i& g)
 {
     if (g(0) == GRID_INVALID)
     {
-        auto current_item = map_grid_ellipse_.find(v.pg);
-        if (current_item != map_grid_ellipse_.end())
+        if (v.HasGridPosition())
         {
-            map_grid_ellipse_.erase(current_item);
+            map_grid_ellipse_.Set(v.pg, nullptr);
         }
         v.pg = g;
         return;
     }
 
-    if (map_grid_ellipse_.find(g) == map_grid_ellipse_.end())
+    if (!map_grid_ellipse_.Find(g))
     {
         v.pg = g;
-        map_grid_ellipse_[g] = &v;
+        map_grid_ellipse_.Set(g, &v);
     }
     else
     {
@@ -767,21 +650,18 @@ void TargetGridDot::SetGrid(Vertex& v, const Eigen::Vector2i& g)
     }
 }
 
-bool TargetGridDot::Match(std::map<Eigen::Vector2i const, Vertex*,
-                          std::less<Eigen::Vector2i>,
-                          Eigen::aligned_allocator< std::pair<Eigen::Vector2i const, Vertex*> > >& obs,
-                          const std::array<Eigen::MatrixXi,4>& PG)
+bool TargetGridDot::Match(VertexGrid& obs, const PackedPatternGroup& PG, const Eigen::Vector2i& grid_size)
 {
     Eigen::Vector2i omin(std::numeric_limits<int>::max(),std::numeric_limits<int>::max());
     Eigen::Vector2i omax(std::numeric_limits<int>::min(),std::numeric_limits<int>::min());
 
     // find max and min
-    for(auto i = obs.begin(); i != obs.end(); ++i) {
-        omin[0] = std::min(omin[0], i->first[0]);
-        omin[1] = std::min(omin[1], i->first[1]);
-        omax[0] = std::max(omax[0], i->first[0]);
-        omax[1] = std::max(omax[1], i->first[1]);
-    }
+    obs.ForEach([&](const Eigen::Vector2i& g, Vertex*) {
+        omin[0] = std::min(omin[0], g[0]);
+        omin[1] = std::min(omin[1], g[1]);
+        omax[0] = std::max(omax[0], g[0]);
+        omax[1] = std::max(omax[1], g[1]);
+    });
 
     // Create sample matrix
     Eigen::Vector2i osize = (omax + Eigen::Vector2i(1,1)) - omin;
@@ -790,35 +670,35 @@ bool TargetGridDot::Match(std::map<Eigen::Vector2i const, Vertex*,
         Eigen::MatrixXi m = Eigen::MatrixXi::Constant( osize(1), osize(0), -1);
         int num_valid = 0;
 
-        for(auto i = obs.begin(); i != obs.end(); ++i) {
-            const Eigen::Vector2i pg = i->first - omin;
-            i->second->pg = pg;
-            const int val = i->second->value;
+        obs.ForEach([&](const Eigen::Vector2i& g, Vertex* v) {
+            const Eigen::Vector2i pg = g - omin;
+            v->pg = pg;
+            const int val = v->value;
             m(pg(1),pg(0)) = val;
             if(val >= 0) ++num_valid;
-        }
+        });
 
         // TODO: Check best score is uniquely best.
         int bs,bg,br,bc;
-        const int num_matches = NumExactMatches(PG_,m,bs,bg,br,bc);
+        const int num_matches = NumExactMatches(PG,PackedPattern(m),bs,bg,br,bc);
         if( num_matches <= 1 && bs < num_valid / 8 )
 //        if( num_matches == 1 )
         {
             // Found unique match
             Sophus::SE2Group<int> T_0x[4] = {
                 Sophus::SE2Group<int>(Sophus::SO2Group<int>(1,0), Eigen::Vector2i(0,0) ),
-                Sophus::SE2Group<int>(Sophus::SO2Group<int>(0,1), Eigen::Vector2i(grid_size_[0]-1,0) ),
-                Sophus::SE2Group<int>(Sophus::SO2Group<int>(-1,0), Eigen::Vector2i(grid_size_[0]-1,grid_size_[1]-1) ),
-                Sophus::SE2Group<int>(Sophus::SO2Group<int>(0,-1), Eigen::Vector2i(0,grid_size_[1]-1) )
+                Sophus::SE2Group<int>(Sophus::SO2Group<int>(0,1), Eigen::Vector2i(grid_size[0]-1,0) ),
+                Sophus::SE2Group<int>(Sophus::SO2Group<int>(-1,0), Eigen::Vector2i(grid_size[0]-1,grid_size[1]-1) ),
+                Sophus::SE2Group<int>(Sophus::SO2Group<int>(0,-1), Eigen::Vector2i(0,grid_size[1]-1) )
             };
 
             Sophus::SE2Group<int> T_xm(Sophus::SO2Group<int>(), Eigen::Vector2i(bc,br));
 
             Sophus::SE2Group<int> T_0m = T_0x[bg] * T_xm;
 
-            for(auto i = obs.begin(); i != obs.end(); ++i) {
-                i->second->pg = T_0m * i->second->pg;
-            }
+            obs.ForEach([&T_0m](const Eigen::Vector2i&, Vertex* v) {
+                v->pg = T_0m * v->pg;
+            });
             return true;
         }else{
             PrintPattern(m);
@@ -830,63 +710,45 @@ bool TargetGridDot::Match(std::map<Eigen::Vector2i const, Vertex*,
     return false;
 }
 
-bool TargetGridDot::FindTarget(
+void TargetGridDot::BuildGraph(
         const ImageProcessing& images,
-        const std::vector<Conic, Eigen::aligned_allocator<Conic> >& conics,
-        std::vector<int>& ellipse_target_map
+        const ConicSet& conics
         )
 {
-
     // Clear cached data structures
     Clear();
-    ellipse_target_map.clear();
 
     Eigen::Vector3d centroid(0,0,1); //start detecting neighbors from the center of the image outwards
-    cv::Mat points_mat(conics.size(), 3, cv::DataType<double>::type);
-    // Generate vertex and point structures
-    // Create OpenCV structure and compute centroid
+    // Generate vertex structures
     for( size_t i=0; i < conics.size(); ++i ) {
-      Vertex v(i, conics[i]);
+      Vertex v(i, conics);
       vs_.push_back(v);
       //centroid += (v.pc_u - centroid) / (i + 1);
-      points_mat.at<double>(i, 0) = v.pc_u[0];
-      points_mat.at<double>(i, 1) = v.pc_u[1];
-      points_mat.at<double>(i, 2) = v.pc_u[2];
     }
 
     // Compute closest points for each ellipse
-    // Replace with kdtree
-    cvflann::Matrix<double> points(points_mat.ptr<double>(),vs_.size(), 3 );
-    auto kdtree = cvflann::KDTreeSingleIndex<cvflann::L2_Simple<double> >(points,cvflann::KDTreeSingleIndexParams());
-    kdtree.buildIndex();
-
-    std::vector<std::vector<Dist> > vs_distance(conics.size());
     const size_t number_of_neighbors = 14;
-    std::vector<int> indices(number_of_neighbors);
-    std::vector<double> distances(number_of_neighbors);
-    for (size_t i = 0; i < conics.size(); i++) {
-        vs_distance[i].resize(number_of_neighbors);
-        cvflann::Matrix<double> point(vs_[i].pc_u.data(), 1, 3);
-        cvflann::Matrix<int> indices_mat(indices.data(), number_of_neighbors, 1);
-        cvflann::Matrix<double> distances_mat(distances.data(), number_of_neighbors, 1);
-        kdtree.knnSearch(point, indices_mat, distances_mat, number_of_neighbors, cvflann::SearchParams());
-        for (size_t j = 0; j < number_of_neighbors; j++) {
-            vs_distance[i][j] = Dist{ &vs_[indices[j]], distances[j] };
-        }
+    std::vector<std::vector<Dist> >& vs_distance = vs_distance_;
+    ClosestPoints(vs_, number_of_neighbors, kdtree_, vs_distance);
+
+    // Order vertices by distance from the centroid
+    std::vector<double>& central_dist = vs_central_dist_;
+    std::vector<size_t>& indices = vs_central_order_;
+    central_dist.resize(vs_.size());
+    indices.resize(vs_.size());
+    for (size_t i = 0; i < vs_.size(); i++) {
+        central_dist[i] = (vs_[i].pc_u - centroid).squaredNorm();
+        indices[i] = i;
     }
-
-    std::vector<Dist> vs_central;
-
-    const size_t number_of_neighbors2 = vs_.size();
-    vs_central.resize(number_of_neighbors2);
-    indices.resize(number_of_neighbors2);
-    distances.resize(number_of_neighbors2);
-    cvflann::Matrix<double> point(centroid.data(), 1, 3);
-    cvflann::Matrix<int> indices_mat(indices.data(), number_of_neighbors2, 1);
-    cvflann::Matrix<double> distances_mat(distances.data(), number_of_neighbors2, 1);
-    kdtree.knnSearch(point, indices_mat, distances_mat, number_of_neighbors2, cvflann::SearchParams());
-    for (size_t j = 0; j < number_of_neighbors2; j++) {
-        vs_central[j] = Dist{ &vs_[indices[j]], distances[j] };
+    std::sort(indices.begin(), indices.end(), [&central_dist](size_t a, size_t b) {
+        return central_dist[a] < central_dist[b] ||
+               (central_dist[a] == central_dist[b] && a < b);
+    });
+
+    std::vector<Dist>& vs_central = vs_central_;
+    vs_central.resize(vs_.size());
+    for (size_t j = 0; j < vs_.size(); j++) {
+        vs_central[j] = Dist{ &vs_[indices[j]], central_dist[indices[j]] };
     }
 
     cv::Mat debug_image;
@@ -896,20 +758,39 @@ bool TargetGridDot::FindTarget(
     //dst.copyTo(debug_image);
     OPENCV_DEBUG(cv::resize(dst, debug_image, debug_image.size(), 0, 0, cv::INTER_NEAREST);)
 
+    // Candidate colinear neighbours of each ellipse, independently
+    std::vector<TriplePairs>& vs_pairs = vs_pairs_;
+    vs_pairs.resize(vs_.size());
+    const double level_scale = 1.0 / images.Scale();
+    ParallelForBands(vs_.size(), params_.num_threads, [&](int begin, int end) {
+        for(int i = begin; i < end; ++i) {
+            FindTriplePairs(vs_[i], vs_distance[i], params_.max_line_dist_ratio,
+                            params_.max_norm_triple_area, dst, level_scale,
+                            vs_pairs[i]);
+        }
+    });
 
-
-    // Find colinear neighbours for each ellipse
+    // Find colinear neighbours for each ellipse, from the centre outwards
     for(size_t i=0; i < vs_.size(); ++i) {
-        FindTriples(vs_[indices[i]], vs_distance[indices[i]], params_.max_line_dist_ratio, params_.max_norm_triple_area, images, debug_image);
+        FindTriples(vs_[indices[i]], vs_distance[indices[i]], vs_pairs[indices[i]], debug_image);
         for(Triple& t : vs_[indices[i]].triples) line_groups_.push_back( LineGroup(t)  );
     }
+    CALIBU_PIPELINE_COUNT(COUNTER_TRIPLES, line_groups_.size());
+}
+
+bool TargetGridDot::GrowGrid(
+        const std::vector<Dist>& central_order,
+        const std::vector<Vertex*>& vertices
+        )
+{
+    map_grid_ellipse_.Clear();
 
     // Find central, well connected vertex
     Vertex* central = nullptr;
     std::vector<Triple*> principle;
 
-    for(size_t i=0; i < vs_central.size(); ++i) {
-        Vertex* v = vs_central[i].v;
+    for(size_t i=0; i < central_order.size(); ++i) {
+        Vertex* v = central_order[i].v;
         if(v->triples.size() >= 2) {
             principle = PrincipleDirections(*v);
             if(principle.size() == 2) {
@@ -928,18 +809,15 @@ bool TargetGridDot::FindTarget(
         line_groups_.push_back( LineGroup(*t) );
     }
 
-    // Search structures
-    std::deque<Vertex*> fringe;
-    std::deque<Vertex*> available;
-    for(size_t i=0; i< vs_.size(); ++i) {
-        available.push_back(&vs_[i]);
-    }
+    // Search structures. The fringe is consumed from fringe_head onwards.
+    std::vector<Vertex*>& fringe = fringe_;
+    std::vector<Vertex*>& available = available_;
+    size_t fringe_head = 0;
+    fringe.clear();
+    available.assign(vertices.begin(), vertices.end());
 
     // Setup central as center of grid
     SetGrid(*central, Eigen::Vector2i(0,0));
-    auto pt1 = cv::Point2d(central->pc.x(), central->pc.y());
-    OPENCV_DEBUG(cv::circle(debug_image, SCALE_FACTOR*pt1, SCALE_FACTOR*5, 100);)
-    OPENCV_DEBUG(cv::putText(debug_image, "0, 0", SCALE_FACTOR*pt1, cv::FONT_HERSHEY_PLAIN, 0.75, 100);)
     available.erase(std::find(available.begin(), available.end(), central));
 
     // add neighbours of central to form basis
@@ -952,11 +830,6 @@ bool TargetGridDot::FindTarget(
             Vertex& n = t.Neighbour(j);
             g[i] = 2*j-1;
             SetGrid(n, g);
-            auto pt1 = cv::Point2d(n.pc.x(), n.pc.y());
-            OPENCV_DEBUG(cv::circle(debug_image, SCALE_FACTOR*pt1, 1, 100);)
-            std::stringstream output;
-            output << g[0] << ", " << g[1];
-            OPENCV_DEBUG(cv::putText(debug_image, output.str(), SCALE_FACTOR*pt1, cv::FONT_HERSHEY_PLAIN, 0.75, 100);)
             available.erase(std::find(available.begin(), available.end(), &n));
             fringe.push_back(&n);
         }
@@ -964,8 +837,8 @@ bool TargetGridDot::FindTarget(
     }
 
     // depth first search extending 'fringe' set by adding colinear vertices
-    while(fringe.size() > 0) {
-        Vertex& f = *fringe.front();
+    while(fringe_head < fringe.size()) {
+        Vertex& f = *fringe[fringe_head];
         //for(size_t i=0; i<f.triples.size(); ++i) {
         //    Triple& t = f.triples[i];
         bool remove_current_iter = false;
@@ -1001,13 +874,6 @@ bool TargetGridDot::FindTarget(
                         // add
                         SetGrid(no, go);
                         fringe.push_back(&no);
-
-                        auto pt1 = cv::Point2d(no.pc.x(), no.pc.y());
-                        OPENCV_DEBUG(cv::circle(debug_image, SCALE_FACTOR*pt1, 1, 100);)
-                        std::stringstream output;
-                        output << go[0] << ", " << go[1];
-                        OPENCV_DEBUG(cv::putText(debug_image, output.str(), SCALE_FACTOR*pt1, cv::FONT_HERSHEY_PLAIN, 0.75, 100);)
-
 //                        line_groups.push_back( LineGroup(t)  );
                     }
 
@@ -1026,12 +892,12 @@ bool TargetGridDot::FindTarget(
         }
 
         // Remove from fringe
-        fringe.pop_front();
+        ++fringe_head;
     }
 
     // Try to add any that we've missed by 'filling in'
-    while(available.size() > 0) {
-        Vertex& f = *available.front();
+    for(Vertex* a : available) {
+        Vertex& f = *a;
         for(size_t i=0; i<f.triples.size(); ++i) {
             Triple& t = f.triples[i];
             Vertex& n = t.Neighbour(0);
@@ -1051,43 +917,32 @@ bool TargetGridDot::FindTarget(
                     }else{
                         // add
                         SetGrid(f, g);
-                        auto pt1 = cv::Point2d(f.pc.x(), f.pc.y());
-                        OPENCV_DEBUG(cv::circle(debug_image, SCALE_FACTOR*pt1, 1, 100);)
-
-                        std::stringstream output;
-                        output << g[0] << ", " << g[1];
-                        OPENCV_DEBUG(cv::putText(debug_image, output.str(), SCALE_FACTOR*pt1, cv::FONT_HERSHEY_PLAIN, 0.75, 100);)
 //                        line_groups.push_back( LineGroup(t)  );
                     }
                 }
             }
         }
-        available.pop_front();
     }
 
     // Compute area and grid neighbours for all ellipses in grid
-    for(auto i = map_grid_ellipse_.begin(); i != map_grid_ellipse_.end(); ++i) {
-        Vertex& v = *i->second;
-        v.area = Area(v.conic);
-        v.neighbours = Neighbours(map_grid_ellipse_,v);
-    }
+    map_grid_ellipse_.ForEach([this](const Eigen::Vector2i&, Vertex* i) {
+        Vertex& v = *i;
+        v.area = Area(v.radius);
+        Neighbours(map_grid_ellipse_, v, v.neighbours);
+    });
 
     // Determine binary value from neighbours area
-    for(auto i = map_grid_ellipse_.begin(); i != map_grid_ellipse_.end(); ++i) {
-        Vertex& v = *i->second;
+    map_grid_ellipse_.ForEach([](const Eigen::Vector2i&, Vertex* i) {
+        Vertex& v = *i;
 
         if(v.neighbours.size() > 2) {
-            // TODO: just take min/max - no need to sort
-            // Sort neightbours by circle area
-            std::vector<Dist> vecrad;
-            vecrad.push_back( Dist{ &v, v.area });
+            // Smallest and largest circle area of neighbours
+            double _area0 = v.area;
+            double _area1 = v.area;
             for(Vertex* n : v.neighbours)  {
-                vecrad.push_back( Dist{n, n->area } );
+                _area0 = std::min(_area0, n->area);
+                _area1 = std::max(_area1, n->area);
             }
-            std::sort(vecrad.begin(), vecrad.end());
-
-            const double _area0 = vecrad.front().dist;
-            const double _area1 = vecrad.back().dist;
 
             // TODO: determine these values from pattern
             const double area0 = 2*2;
@@ -1107,10 +962,34 @@ bool TargetGridDot::FindTarget(
         }else{
             v.value = -1;
         }
+    });
+
+    return true;
+}
+
+bool TargetGridDot::FindTarget(
+        const ImageProcessing& images,
+        const ConicSet& conics,
+        std::vector<int>& ellipse_target_map
+        )
+{
+    CALIBU_PIPELINE_TIMER(timer, STAGE_FIND_TARGET);
+
+    ellipse_target_map.clear();
+    BuildGraph(images, conics);
+
+    // Grid of all vertices, from the most central one
+    std::vector<Vertex*>& vertices = component_;
+    vertices.clear();
+    for(size_t i=0; i < vs_.size(); ++i) {
+        vertices.push_back(&vs_[i]);
+    }
+    if(!GrowGrid(vs_central_, vertices)) {
+        return false;
     }
 
     // Correlation of what we have with binary pattern
-    const bool found = Match(map_grid_ellipse_, PG_);
+    const bool found = Match(map_grid_ellipse_, PG_packed_, grid_size_);
 
     if(!found) {
         LOG(INFO) << "Pattern not found" << std::endl;
@@ -1130,6 +1009,97 @@ bool TargetGridDot::FindTarget(
     return true;
 }
 
+
+int TargetGridDot::FindTargets(
+        const ImageProcessing& images,
+        const ConicSet& conics,
+        const std::vector<const TargetGridDot*>& targets,
+        std::vector<std::vector<int> >& maps
+        )
+{
+    CALIBU_PIPELINE_TIMER(timer, STAGE_FIND_TARGET);
+
+    maps.assign(targets.size(), std::vector<int>(conics.size(), -1));
+    BuildGraph(images, conics);
+
+    // Connected components of the graph of triples
+    std::vector<int>& parent = component_parent_;
+    parent.resize(vs_.size());
+    std::iota(parent.begin(), parent.end(), 0);
+    auto find = [&parent](int i) {
+        while(parent[i] != i) {
+            parent[i] = parent[parent[i]];
+            i = parent[i];
+        }
+        return i;
+    };
+    for(size_t i=0; i < vs_.size(); ++i) {
+        for(const Triple& t : vs_[i].triples) {
+            for(size_t j=0; j < 2; ++j) {
+                const int a = find(i);
+                const int b = find(&t.Neighbour(j) - &vs_[0]);
+                if(a != b) parent[std::max(a,b)] = std::min(a,b);
+            }
+        }
+    }
+    std::vector<int>& component_size = component_size_;
+    component_size.assign(vs_.size(), 0);
+    for(size_t i=0; i < vs_.size(); ++i) {
+        ++component_size[find(i)];
+    }
+
+    // Largest components first. A target needs at least 3x3 dots.
+    std::vector<int> roots;
+    for(size_t i=0; i < vs_.size(); ++i) {
+        if(find(i) == (int)i && component_size[i] >= 9) {
+            roots.push_back(i);
+        }
+    }
+    std::sort(roots.begin(), roots.end(), [&component_size](int a, int b) {
+        return component_size[a] > component_size[b] ||
+               (component_size[a] == component_size[b] && a < b);
+    });
+
+    int num_found = 0;
+    std::vector<bool> found(targets.size(), false);
+    std::vector<Dist>& central_order = component_central_;
+    std::vector<Vertex*>& vertices = component_;
+    for(int root : roots) {
+        if(num_found == (int)targets.size()) break;
+
+        central_order.clear();
+        for(const Dist& d : vs_central_) {
+            if(find(d.v - &vs_[0]) == root) central_order.push_back(d);
+        }
+        vertices.clear();
+        for(size_t i=0; i < vs_.size(); ++i) {
+            if(find(i) == root) vertices.push_back(&vs_[i]);
+        }
+        if(!GrowGrid(central_order, vertices)) {
+            continue;
+        }
+
+        // Decode the component against each target not found yet
+        for(size_t t=0; t < targets.size(); ++t) {
+            if(found[t]) continue;
+            const TargetGridDot& target = *targets[t];
+            if(!Match(map_grid_ellipse_, target.PG_packed_, target.grid_size_)) {
+                continue;
+            }
+            const Eigen::Vector2i& size = target.grid_size_;
+            for(Vertex* v : vertices) {
+                if( 0<= v->pg(0) && v->pg(0) < size(0) &&  0<= v->pg(1) && v->pg(1) < size(1) ) {
+                    maps[t][v->id] = v->pg(1)*size(0) + v->pg(0);
+                }
+            }
+            found[t] = true;
+            ++num_found;
+            break;
+        }
+    }
+    return num_found;
+}
+
 void PlotCrossHair(
     double x,
     double y,
@@ -0,0 +1,198 @@
+/*
+   This file is part of the Calibu Project.
+   https://github.com/gwu-robotics/Calibu
+
+   Copyright (C) 2013 George Washington University,
+                      Steven Lovegrove,
+                      Nima Keivan
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+   http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#include <calibu/target/TargetRenderer.h>
+#include <calibu/utils/Parallel.h>
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+namespace calibu {
+
+TargetRenderer::TargetRenderer( const TargetGridDot& target )
+    : grid_spacing_(target.GridSpacing()),
+      grid_size_(target.GridSize()),
+      centers_(target.Circles3D())
+{
+    radii_.resize(centers_.size());
+    for(size_t i = 0; i < radii_.size(); ++i) {
+        radii_[i] = target.CircleRadius(i);
+    }
+}
+
+TargetRenderer::TargetRenderer( const std::string& preset )
+    : TargetRenderer(TargetGridDot(preset))
+{
+}
+
+bool TargetRenderer::InsideDot( const Eigen::Vector2d& p ) const
+{
+    // Dots are much smaller than the grid spacing, so only the nearest can
+    // contain p.
+    const int c = (int)std::floor(p[0] / grid_spacing_ + 0.5);
+    const int r = (int)std::floor(p[1] / grid_spacing_ + 0.5);
+    if(c < 0 || r < 0 || c >= grid_size_[0] || r >= grid_size_[1]) {
+        return false;
+    }
+
+    const int i = r * grid_size_[0] + c;
+    return (p - centers_[i].head<2>()).squaredNorm() < radii_[i] * radii_[i];
+}
+
+void TargetRenderer::RenderCoverage(
+        const std::shared_ptr<CameraInterface<double> >& cam,
+        const Sophus::SE3d& T_cw,
+        std::vector<float>& coverage
+        ) const
+{
+    const int w = cam->Width();
+    const int h = cam->Height();
+    const int s = std::max(1, params_.supersampling);
+    const Sophus::SE3d T_wc = T_cw.inverse();
+    const Eigen::Matrix3d R_wc = T_wc.so3().matrix();
+    const Eigen::Vector3d o = T_wc.translation();
+
+    coverage.assign((size_t)w * h, 0.0f);
+
+    ParallelForBands( h, params_.num_threads, [&]( int row_begin, int row_end ) {
+        // Unproject all samples of a row through the batch interface
+        Eigen::Matrix2Xd pix(2, w * s * s);
+        Eigen::Matrix3Xd rays;
+
+        for(int y = row_begin; y < row_end; ++y) {
+            for(int x = 0; x < w; ++x) {
+                for(int j = 0; j < s; ++j) {
+                    for(int i = 0; i < s; ++i) {
+                        pix.col((x * s + j) * s + i) <<
+                            x - 0.5 + (i + 0.5) / s, y - 0.5 + (j + 0.5) / s;
+                    }
+                }
+            }
+            cam->UnprojectN(pix, rays);
+
+            float* row = &coverage[(size_t)y * w];
+            for(int x = 0; x < w; ++x) {
+                int inside = 0;
+                for(int k = 0; k < s * s; ++k) {
+                    // Intersect the ray with the z = 0 target plane
+                    const Eigen::Vector3d d = R_wc * rays.col(x * s * s + k);
+                    const double t = -o[2] / d[2];
+                    if(t > 0 && InsideDot((o + t * d).head<2>())) {
+                        ++inside;
+                    }
+                }
+                row[x] = (float)inside / (s * s);
+            }
+        }
+    } );
+}
+
+void TargetRenderer::Render(
+        const std::shared_ptr<CameraInterface<double> >& cam,
+        const Sophus::SE3d& T_cw,
+        std::vector<unsigned char>& image,
+        std::vector<RenderedDot>& dots
+        ) const
+{
+    const int w = cam->Width();
+    const int h = cam->Height();
+
+    std::vector<float> intensity;
+    RenderCoverage(cam, T_cw, intensity);
+    for(float& v : intensity) {
+        v = params_.background + v * (params_.foreground - params_.background);
+    }
+
+    if(params_.vignetting) {
+        std::vector<double> attenuation(w);
+        for(int y = 0; y < h; ++y) {
+            params_.vignetting->EvaluateRow(y + 0.5, 0.5, w, attenuation.data());
+            for(int x = 0; x < w; ++x) {
+                intensity[(size_t)y * w + x] *= attenuation[x];
+            }
+        }
+    }
+
+    if(params_.blur_sigma > 0) {
+        // Separable gaussian, repeating border pixels
+        const int radius = (int)std::ceil(3 * params_.blur_sigma);
+        std::vector<float> kernel(2 * radius + 1);
+        float sum = 0;
+        for(int k = -radius; k <= radius; ++k) {
+            kernel[k + radius] = std::exp(-0.5 * k * k /
+                                          (params_.blur_sigma * params_.blur_sigma));
+            sum += kernel[k + radius];
+        }
+        for(float& k : kernel) {
+            k /= sum;
+        }
+
+        std::vector<float> tmp(intensity.size());
+        for(int y = 0; y < h; ++y) {
+            for(int x = 0; x < w; ++x) {
+                float v = 0;
+                for(int k = -radius; k <= radius; ++k) {
+                    const int xk = std::min(w - 1, std::max(0, x + k));
+                    v += kernel[k + radius] * intensity[(size_t)y * w + xk];
+                }
+                tmp[(size_t)y * w + x] = v;
+            }
+        }
+        for(int y = 0; y < h; ++y) {
+            for(int x = 0; x < w; ++x) {
+                float v = 0;
+                for(int k = -radius; k <= radius; ++k) {
+                    const int yk = std::min(h - 1, std::max(0, y + k));
+                    v += kernel[k + radius] * tmp[(size_t)yk * w + x];
+                }
+                intensity[(size_t)y * w + x] = v;
+            }
+        }
+    }
+
+    std::mt19937 rng(params_.seed);
+    std::normal_distribution<float> noise(0, params_.noise_sigma);
+    image.resize(intensity.size());
+    for(size_t i = 0; i < intensity.size(); ++i) {
+        float v = intensity[i];
+        if(params_.noise_sigma > 0) {
+            v += noise(rng);
+        }
+        image[i] = (unsigned char)std::min(255.0f, std::max(0.0f, v + 0.5f));
+    }
+
+    dots.resize(centers_.size());
+    for(size_t i = 0; i < centers_.size(); ++i) {
+        const Eigen::Vector3d p_c = T_cw * centers_[i];
+        RenderedDot& dot = dots[i];
+        dot.index = i;
+        dot.visible = p_c[2] > 0;
+        dot.center.setConstant(-1);
+        if(dot.visible) {
+            dot.center = cam->Project(p_c);
+            dot.visible = dot.center[0] >= 0 && dot.center[1] >= 0 &&
+                          dot.center[0] <= w - 1 && dot.center[1] <= h - 1;
+        }
+    }
+}
+
+}
@@ -0,0 +1,125 @@
+/*
+   This file is part of the Calibu Project.
+   https://github.com/gwu-robotics/Calibu
+
+   Copyright (C) 2014 George Washington University,
+                      Steven Lovegrove
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+   http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#include <calibu/CpuFeatures.h>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#  define CALIBU_CPU_X86
+#  ifdef _MSC_VER
+#    include <intrin.h>
+#  else
+#    include <cpuid.h>
+#  endif
+#endif
+
+#if defined(__arm__) && defined(__linux__)
+#  include <sys/auxv.h>
+#  include <asm/hwcap.h>
+#endif
+
+namespace calibu
+{
+
+namespace
+{
+
+#ifdef CALIBU_CPU_X86
+// Registers eax, ebx, ecx, edx of CPUID leaf, subleaf.
+void Cpuid( unsigned int leaf, unsigned int subleaf, unsigned int r[4] )
+{
+#ifdef _MSC_VER
+    int regs[4];
+    __cpuidex( regs, (int) leaf, (int) subleaf );
+    for( int i = 0; i < 4; ++i ) {
+        r[i] = (unsigned int) regs[i];
+    }
+#else
+    r[0] = r[1] = r[2] = r[3] = 0;
+    __cpuid_count( leaf, subleaf, r[0], r[1], r[2], r[3] );
+#endif
+}
+
+// Register state the operating system saves, XCR0.
+unsigned long long Xgetbv()
+{
+#ifdef _MSC_VER
+    return _xgetbv( 0 );
+#else
+    unsigned int eax, edx;
+    __asm__ volatile( "xgetbv" : "=a"(eax), "=d"(edx) : "c"(0) );
+    return ((unsigned long long) edx << 32) | eax;
+#endif
+}
+
+unsigned int DetectCpuFeatures()
+{
+    unsigned int r[4];
+    Cpuid( 0, 0, r );
+    const unsigned int max_leaf = r[0];
+
+    unsigned int features = 0;
+    Cpuid( 1, 0, r );
+    if( r[3] & (1u << 26) ) features |= CPU_FEATURE_SSE2;
+    if( r[2] & (1u << 19) ) features |= CPU_FEATURE_SSE4_1;
+
+    // AVX registers are only usable if the OS saves them on context switches
+    const bool osxsave = (r[2] & (1u << 27)) != 0;
+    const unsigned long long xcr0 = osxsave ? Xgetbv() : 0;
+    const bool avx_state = (xcr0 & 0x6) == 0x6;
+    const bool avx512_state = (xcr0 & 0xE6) == 0xE6;
+    if( avx_state && (r[2] & (1u << 28)) ) features |= CPU_FEATURE_AVX;
+    if( avx_state && (r[2] & (1u << 12)) ) features |= CPU_FEATURE_FMA;
+
+    if( max_leaf >= 7 ) {
+        Cpuid( 7, 0, r );
+        if( avx_state && (r[1] & (1u << 5)) ) features |= CPU_FEATURE_AVX2;
+        if( avx512_state && (r[1] & (1u << 16)) ) features |= CPU_FEATURE_AVX512F;
+        if( avx512_state && (r[1] & (1u << 30)) ) features |= CPU_FEATURE_AVX512BW;
+    }
+    return features;
+}
+#elif defined(__aarch64__)
+unsigned int DetectCpuFeatures()
+{
+    // Advanced SIMD is part of every AArch64 CPU
+    return CPU_FEATURE_NEON;
+}
+#elif defined(__arm__) && defined(__linux__)
+unsigned int DetectCpuFeatures()
+{
+    return (getauxval( AT_HWCAP ) & HWCAP_NEON) ? CPU_FEATURE_NEON : 0;
+}
+#else
+unsigned int DetectCpuFeatures()
+{
+    return 0;
+}
+#endif
+
+}
+
+///////////////////////////////////////////////////////////////////////////////
+unsigned int CpuFeatures()
+{
+    static const unsigned int features = DetectCpuFeatures();
+    return features;
+}
+
+}
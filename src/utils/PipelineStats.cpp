@@ -0,0 +1,236 @@
+/*
+   This file is part of the Calibu Project.
+   https://github.com/gwu-robotics/Calibu
+
+   Copyright (C) 2013 George Washington University,
+                      Steven Lovegrove
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+   http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#include <calibu/utils/PipelineStats.h>
+
+#include <algorithm>
+#include <atomic>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <ostream>
+
+namespace calibu
+{
+
+namespace
+{
+
+// Statistics written by one thread. Fields are atomic so that other
+// threads can read them while it records.
+struct ThreadPipelineStats
+{
+    ThreadPipelineStats()
+    {
+        Reset();
+    }
+
+    void Reset()
+    {
+        for( int s = 0; s < NUM_PIPELINE_STAGES; ++s ) {
+            count[s].store( 0, std::memory_order_relaxed );
+            total_ns[s].store( 0, std::memory_order_relaxed );
+            max_ns[s].store( 0, std::memory_order_relaxed );
+        }
+        for( int c = 0; c < NUM_PIPELINE_COUNTERS; ++c ) {
+            counters[c].store( 0, std::memory_order_relaxed );
+        }
+        next.store( 0, std::memory_order_release );
+    }
+
+    std::atomic<uint64_t> count[NUM_PIPELINE_STAGES];
+    std::atomic<uint64_t> total_ns[NUM_PIPELINE_STAGES];
+    std::atomic<uint64_t> max_ns[NUM_PIPELINE_STAGES];
+    std::atomic<uint64_t> counters[NUM_PIPELINE_COUNTERS];
+
+    // Ring buffer of the last kPipelineRingSize samples, next is the number
+    // of samples ever written
+    std::atomic<int> ring_stage[kPipelineRingSize];
+    std::atomic<uint64_t> ring_begin[kPipelineRingSize];
+    std::atomic<uint64_t> ring_duration[kPipelineRingSize];
+    std::atomic<uint64_t> next;
+};
+
+// Statistics of every thread that recorded any, kept after they exit
+struct PipelineRegistry
+{
+    std::mutex mutex;
+    std::vector<std::shared_ptr<ThreadPipelineStats>> threads;
+};
+
+PipelineRegistry& Registry()
+{
+    static PipelineRegistry registry;
+    return registry;
+}
+
+ThreadPipelineStats& ThisThread()
+{
+    thread_local std::shared_ptr<ThreadPipelineStats> stats;
+    if( !stats ) {
+        stats = std::make_shared<ThreadPipelineStats>();
+        PipelineRegistry& registry = Registry();
+        std::lock_guard<std::mutex> lock( registry.mutex );
+        registry.threads.push_back( stats );
+    }
+    return *stats;
+}
+
+}
+
+///////////////////////////////////////////////////////////////////////////////
+const char* PipelineStageName( PipelineStage stage )
+{
+    static const char* names[NUM_PIPELINE_STAGES] = {
+        "copy", "gradient", "threshold", "label", "conics", "find_target",
+        "pnp", "add_observation"
+    };
+    return names[stage];
+}
+
+///////////////////////////////////////////////////////////////////////////////
+const char* PipelineCounterName( PipelineCounter counter )
+{
+    static const char* names[NUM_PIPELINE_COUNTERS] = {
+        "conics", "triples", "ransac_iterations"
+    };
+    return names[counter];
+}
+
+///////////////////////////////////////////////////////////////////////////////
+PipelineStats::PipelineStats()
+{
+    for( Stage& stage : stages ) {
+        stage.count = 0;
+        stage.total_ns = 0;
+        stage.max_ns = 0;
+    }
+    std::fill( counters, counters + NUM_PIPELINE_COUNTERS, 0 );
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void PipelineStats::Print( std::ostream& os ) const
+{
+    const std::ios::fmtflags flags = os.flags();
+    os << std::fixed << std::setprecision(3);
+    os << std::left << std::setw(18) << "stage" << std::right
+       << std::setw(10) << "runs" << std::setw(12) << "mean ms"
+       << std::setw(12) << "max ms" << std::setw(12) << "total ms" << "\n";
+    for( int s = 0; s < NUM_PIPELINE_STAGES; ++s ) {
+        const Stage& stage = stages[s];
+        if( stage.count == 0 ) {
+            continue;
+        }
+        os << std::left << std::setw(18) << PipelineStageName( (PipelineStage)s )
+           << std::right << std::setw(10) << stage.count
+           << std::setw(12) << stage.MeanMs()
+           << std::setw(12) << 1e-6 * stage.max_ns
+           << std::setw(12) << 1e-6 * stage.total_ns << "\n";
+    }
+    for( int c = 0; c < NUM_PIPELINE_COUNTERS; ++c ) {
+        if( counters[c] ) {
+            os << std::left << std::setw(18)
+               << PipelineCounterName( (PipelineCounter)c ) << std::right
+               << std::setw(10) << counters[c] << "\n";
+        }
+    }
+    os.flags( flags );
+}
+
+///////////////////////////////////////////////////////////////////////////////
+PipelineStats GetPipelineStats()
+{
+    PipelineStats stats;
+    PipelineRegistry& registry = Registry();
+    std::lock_guard<std::mutex> lock( registry.mutex );
+
+    for( const std::shared_ptr<ThreadPipelineStats>& thread : registry.threads ) {
+        for( int s = 0; s < NUM_PIPELINE_STAGES; ++s ) {
+            PipelineStats::Stage& stage = stats.stages[s];
+            stage.count += thread->count[s].load( std::memory_order_relaxed );
+            stage.total_ns += thread->total_ns[s].load( std::memory_order_relaxed );
+            stage.max_ns = std::max<uint64_t>(
+                stage.max_ns, thread->max_ns[s].load( std::memory_order_relaxed ) );
+        }
+        for( int c = 0; c < NUM_PIPELINE_COUNTERS; ++c ) {
+            stats.counters[c] += thread->counters[c].load( std::memory_order_relaxed );
+        }
+
+        const uint64_t next = thread->next.load( std::memory_order_acquire );
+        const uint64_t first = next > (uint64_t)kPipelineRingSize ?
+                    next - kPipelineRingSize : 0;
+        for( uint64_t i = first; i < next; ++i ) {
+            const int slot = i % kPipelineRingSize;
+            PipelineSample sample;
+            sample.stage = (PipelineStage)thread->ring_stage[slot].load(
+                        std::memory_order_relaxed );
+            sample.begin_ns = thread->ring_begin[slot].load( std::memory_order_relaxed );
+            sample.duration_ns = thread->ring_duration[slot].load(
+                        std::memory_order_relaxed );
+            stats.recent.push_back( sample );
+        }
+    }
+    return stats;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void ResetPipelineStats()
+{
+    PipelineRegistry& registry = Registry();
+    std::lock_guard<std::mutex> lock( registry.mutex );
+    for( const std::shared_ptr<ThreadPipelineStats>& thread : registry.threads ) {
+        thread->Reset();
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void RecordPipelineStage( PipelineStage stage, uint64_t begin_ns,
+                          uint64_t duration_ns )
+{
+    // Only this thread writes its statistics, so plain read-modify-writes
+    // of the atomics are enough.
+    ThreadPipelineStats& stats = ThisThread();
+    stats.count[stage].store( stats.count[stage].load( std::memory_order_relaxed ) + 1,
+                              std::memory_order_relaxed );
+    stats.total_ns[stage].store(
+                stats.total_ns[stage].load( std::memory_order_relaxed ) + duration_ns,
+                std::memory_order_relaxed );
+    if( duration_ns > stats.max_ns[stage].load( std::memory_order_relaxed ) ) {
+        stats.max_ns[stage].store( duration_ns, std::memory_order_relaxed );
+    }
+
+    const uint64_t next = stats.next.load( std::memory_order_relaxed );
+    const int slot = next % kPipelineRingSize;
+    stats.ring_stage[slot].store( stage, std::memory_order_relaxed );
+    stats.ring_begin[slot].store( begin_ns, std::memory_order_relaxed );
+    stats.ring_duration[slot].store( duration_ns, std::memory_order_relaxed );
+    stats.next.store( next + 1, std::memory_order_release );
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void RecordPipelineCount( PipelineCounter counter, uint64_t n )
+{
+    ThreadPipelineStats& stats = ThisThread();
+    stats.counters[counter].store(
+                stats.counters[counter].load( std::memory_order_relaxed ) + n,
+                std::memory_order_relaxed );
+}
+
+}
@@ -20,51 +20,158 @@
  */
 
 #include <calibu/utils/Utils.h>
+#include <calibu/utils/Parallel.h>
 
 #include "assert.h"
+#include <cmath>
 #include <Eigen/Dense>
 
 using namespace Eigen;
 
 namespace calibu {
 
-Eigen::Matrix3d EstimateH_ba(
-        const std::vector<Eigen::Vector2d, Eigen::aligned_allocator<Eigen::Vector2d> >& a,
-        const std::vector<Eigen::Vector2d, Eigen::aligned_allocator<Eigen::Vector2d> >& b
-        )
+namespace {
+
+// Similarity taking points p to their centroid at the origin, at a mean
+// distance of sqrt(2) from it (Hartley's normalisation)
+Matrix3d NormalizingTransform( const Vector2d* p, size_t n )
 {
-    assert(a.size() == b.size());
+    Vector2d centroid = Vector2d::Zero();
+    for( size_t i=0; i < n; ++i ) {
+        centroid += p[i];
+    }
+    centroid /= n;
 
-    // based on estimatehomography.m
-    // George Vogiatzis and Carlos Hernández
-    // http://george-vogiatzis.org/calib/
+    double mean_dist = 0;
+    for( size_t i=0; i < n; ++i ) {
+        mean_dist += (p[i] - centroid).norm();
+    }
+    mean_dist /= n;
+
+    const double s = mean_dist > 0 ? std::sqrt(2.0) / mean_dist : 1.0;
+    Matrix3d T;
+    T << s, 0, -s * centroid[0],
+         0, s, -s * centroid[1],
+         0, 0, 1;
+    return T;
+}
 
-    MatrixXd M(a.size()*2,9);
+struct HomographyData
+{
+    const Vector2d* a;
+    const Vector2d* b;
+};
 
-    for( unsigned int i=0; i< a.size(); ++i )
+Matrix3d HomographyModel( const std::vector<int>& indices, const HomographyData* data )
+{
+    std::vector<Vector2d, aligned_allocator<Vector2d> > a(indices.size());
+    std::vector<Vector2d, aligned_allocator<Vector2d> > b(indices.size());
+    for( size_t i=0; i < indices.size(); ++i ) {
+        a[i] = data->a[indices[i]];
+        b[i] = data->b[indices[i]];
+    }
+    return EstimateH_ba(a.data(), b.data(), indices.size());
+}
+
+// Transfer error |b - H_ba a| of a point pair, in the units of b
+double HomographyError( const Matrix3d& H_ba, int i, const HomographyData* data )
+{
+    const Vector3d b = H_ba * data->a[i].homogeneous();
+    return (b.hnormalized() - data->b[i]).norm();
+}
+
+}
+
+Eigen::Matrix3d EstimateH_ba(
+        const Eigen::Vector2d* a, const Eigen::Vector2d* b, size_t n
+        )
+{
+    assert(n >= 4);
+
+    // Normalised DLT, as in Hartley and Zisserman, Multiple View Geometry,
+    // Algorithm 4.2. The 9x9 normal matrix M^T M is accumulated directly
+    // rather than forming M, and its null vector is the eigenvector of the
+    // smallest eigenvalue.
+    const Matrix3d Ta = NormalizingTransform(a, n);
+    const Matrix3d Tb = NormalizingTransform(b, n);
+
+    Matrix<double,9,9> MtM = Matrix<double,9,9>::Zero();
+    Matrix<double,9,1> r1, r2;
+    for( size_t i=0; i < n; ++i )
     {
-        const double u1 = a[i][0];
-        const double v1 = a[i][1];
-        const double u2 = b[i][0];
-        const double v2 = b[i][1];
-
-        M.block<2,9>(i*2,0) <<
-                               u1, v1, 1, 0, 0, 0, -u1 * u2, -v1 * u2, -u2,
-                0, 0, 0, u1, v1, 1, -u1 * v2, -v1 * v2, -v2;
+        const double u1 = Ta(0,0) * a[i][0] + Ta(0,2);
+        const double v1 = Ta(1,1) * a[i][1] + Ta(1,2);
+        const double u2 = Tb(0,0) * b[i][0] + Tb(0,2);
+        const double v2 = Tb(1,1) * b[i][1] + Tb(1,2);
+
+        r1 << u1, v1, 1, 0, 0, 0, -u1 * u2, -v1 * u2, -u2;
+        r2 << 0, 0, 0, u1, v1, 1, -u1 * v2, -v1 * v2, -v2;
+        MtM.selfadjointView<Lower>().rankUpdate(r1);
+        MtM.selfadjointView<Lower>().rankUpdate(r2);
     }
 
-    const Matrix<double,9,9> Vt =
-            Eigen::JacobiSVD<MatrixXd>(M, ComputeFullV).matrixV().transpose();
+    const SelfAdjointEigenSolver<Matrix<double,9,9> > eig(MtM);
+    const Matrix<double,9,1> h = eig.eigenvectors().col(0);
+
+    Matrix3d Hn;
+    Hn << h[0], h[1], h[2],
+          h[3], h[4], h[5],
+          h[6], h[7], h[8];
 
-    // return last row of svd.get_VT(), reshaped in to 3x3
-    Matrix3d H;
-    H.block<1,3>(0,0) = Vt.block<1,3>(8,0);
-    H.block<1,3>(1,0) = Vt.block<1,3>(8,3);
-    H.block<1,3>(2,0) = Vt.block<1,3>(8,6);
+    // Undo normalisation, H = Tb^-1 Hn Ta
+    Matrix3d Tb_inv;
+    Tb_inv << 1.0 / Tb(0,0), 0, -Tb(0,2) / Tb(0,0),
+              0, 1.0 / Tb(1,1), -Tb(1,2) / Tb(1,1),
+              0, 0, 1;
+    Matrix3d H = Tb_inv * Hn * Ta;
 
     H /= H(2,2);
 
     return H;
 }
 
+Eigen::Matrix3d EstimateH_ba(
+        const std::vector<Eigen::Vector2d, Eigen::aligned_allocator<Eigen::Vector2d> >& a,
+        const std::vector<Eigen::Vector2d, Eigen::aligned_allocator<Eigen::Vector2d> >& b
+        )
+{
+    assert(a.size() == b.size());
+    return EstimateH_ba(a.data(), b.data(), a.size());
+}
+
+std::vector<Eigen::Matrix3d> EstimateH_baBatch(
+        const std::vector<std::vector<Eigen::Vector2d, Eigen::aligned_allocator<Eigen::Vector2d> > >& a,
+        const std::vector<std::vector<Eigen::Vector2d, Eigen::aligned_allocator<Eigen::Vector2d> > >& b,
+        unsigned int num_threads
+        )
+{
+    assert(a.size() == b.size());
+    std::vector<Matrix3d> H_ba(a.size());
+    ParallelForBands((int)a.size(), num_threads, [&](int begin, int end) {
+        for( int i=begin; i < end; ++i ) {
+            H_ba[i] = EstimateH_ba(a[i], b[i]);
+        }
+    });
+    return H_ba;
+}
+
+Eigen::Matrix3d EstimateH_baRansac(
+        const std::vector<Eigen::Vector2d, Eigen::aligned_allocator<Eigen::Vector2d> >& a,
+        const std::vector<Eigen::Vector2d, Eigen::aligned_allocator<Eigen::Vector2d> >& b,
+        std::vector<int>& inliers,
+        double max_error,
+        int iterations,
+        unsigned int min_consensus_size,
+        const ParamsRansac& params
+        )
+{
+    assert(a.size() == b.size());
+    const HomographyData data = { a.data(), b.data() };
+    Ransac<Matrix3d, 4, const HomographyData*> ransac(
+                HomographyModel, HomographyError, &data, params);
+    const Matrix3d H_ba = ransac.Compute(a.size(), inliers, iterations, max_error,
+                                         std::max(4u, min_consensus_size));
+    return inliers.empty() ? Matrix3d::Zero() : H_ba;
+}
+
 }
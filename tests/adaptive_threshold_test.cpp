@@ -0,0 +1,89 @@
+#include <gtest/gtest.h>
+#include <calibu/image/AdaptiveThreshold.h>
+#include <calibu/image/IntegralImage.h>
+
+#include <random>
+#include <vector>
+
+namespace calibu
+{
+namespace testing
+{
+
+TEST(AdaptiveThreshold, PitchedIntegralImage)
+{
+  const int w = 37;
+  const int h = 23;
+  const int pitch = 41;
+
+  std::mt19937 rng(7);
+  std::vector<unsigned char> image(pitch * h);
+  std::vector<unsigned char> packed(w * h);
+  for (int y = 0; y < h; ++y)
+  {
+    for (int x = 0; x < pitch; ++x)
+    {
+      image[y * pitch + x] = rng() % 256;
+      if (x < w) packed[y * w + x] = image[y * pitch + x];
+    }
+  }
+
+  std::vector<float> expected(w * h);
+  integral_image(w, h, packed.data(), expected.data());
+
+  std::vector<uint32_t> found(w * h);
+  integral_image(w, h, (size_t)pitch, image.data(), found.data());
+
+  for (int i = 0; i < w * h; ++i)
+  {
+    ASSERT_EQ((uint32_t)expected[i], found[i]);
+  }
+}
+
+TEST(AdaptiveThreshold, MatchesIntegralTemplate)
+{
+  const int w = 64;
+  const int h = 48;
+  const int pitch = 72;
+
+  // Smooth gradient with noise, so that pixels lie on both sides of the
+  // threshold
+  std::mt19937 rng(3);
+  std::vector<unsigned char> image(pitch * h);
+  std::vector<unsigned char> packed(w * h);
+  for (int y = 0; y < h; ++y)
+  {
+    for (int x = 0; x < w; ++x)
+    {
+      const int value = 2 * x + y + (int)(rng() % 64);
+      image[y * pitch + x] = (unsigned char)std::min(value, 255);
+      packed[y * w + x] = image[y * pitch + x];
+    }
+  }
+
+  std::vector<float> intI_float(w * h);
+  integral_image(w, h, packed.data(), intI_float.data());
+  std::vector<uint32_t> intI(w * h);
+  integral_image(w, h, (size_t)pitch, image.data(), intI.data());
+
+  const int rads[] = { 1, 2, 5, 31, 40, 100 };
+  for (int rad : rads)
+  {
+    std::vector<unsigned char> expected(w * h);
+    AdaptiveThreshold(w, h, packed.data(), intI_float.data(), expected.data(),
+                      0.9f, rad, 10, (unsigned char)0, (unsigned char)255);
+
+    std::vector<unsigned char> found(w * h);
+    AdaptiveThreshold(w, h, (size_t)pitch, image.data(), intI.data(),
+                      found.data(), 0.9f, rad, 10, 0, 255);
+
+    for (int i = 0; i < w * h; ++i)
+    {
+      ASSERT_EQ(expected[i], found[i]) << "rad " << rad << " pixel " << i;
+    }
+  }
+}
+
+} // namespace testing
+
+} // namespace calibu
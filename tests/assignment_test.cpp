@@ -0,0 +1,136 @@
+#include <gtest/gtest.h>
+#include <calibu/target/Assignment.h>
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+namespace calibu
+{
+namespace testing
+{
+
+// Cheapest assignment by trying every choice of column (or none) per row
+double BruteForce(const Eigen::MatrixXd& cost, double gate, int row,
+                  std::vector<bool>& used)
+{
+  if (row == cost.rows()) return 0;
+  double best = gate + BruteForce(cost, gate, row + 1, used);
+  for (int c = 0; c < cost.cols(); ++c)
+  {
+    if (!used[c] && cost(row, c) <= gate)
+    {
+      used[c] = true;
+      best = std::min(best, cost(row, c) + BruteForce(cost, gate, row + 1, used));
+      used[c] = false;
+    }
+  }
+  return best;
+}
+
+double Cost(const Eigen::MatrixXd& cost, double gate,
+            const std::vector<int>& row_to_col)
+{
+  std::vector<bool> used(cost.cols(), false);
+  double total = 0;
+  for (int r = 0; r < cost.rows(); ++r)
+  {
+    const int c = row_to_col[r];
+    if (c < 0)
+    {
+      total += gate;
+      continue;
+    }
+    EXPECT_FALSE(used[c]);
+    EXPECT_LE(cost(r, c), gate);
+    used[c] = true;
+    total += cost(r, c);
+  }
+  return total;
+}
+
+TEST(Assignment, MatchesBruteForce)
+{
+  std::mt19937 rng(3);
+  std::uniform_real_distribution<double> uniform(0, 10);
+  LinearAssignment solver;
+  for (int trial = 0; trial < 200; ++trial)
+  {
+    const int rows = 1 + trial % 6;
+    const int cols = 1 + (trial / 6) % 6;
+    Eigen::MatrixXd cost(rows, cols);
+    for (int r = 0; r < rows; ++r)
+      for (int c = 0; c < cols; ++c) cost(r, c) = uniform(rng);
+
+    for (double gate : { 3.0, 7.0, 100.0 })
+    {
+      std::vector<int> row_to_col;
+      const double total = solver.Solve(cost, row_to_col, gate);
+      std::vector<bool> used(cols, false);
+      const double expected = BruteForce(cost, gate, 0, used);
+      ASSERT_NEAR(expected, total, 1E-9);
+      ASSERT_NEAR(expected, Cost(cost, gate, row_to_col), 1E-9);
+    }
+  }
+}
+
+TEST(Assignment, CompleteWithoutGate)
+{
+  // Row 1 can only take column 0, so row 0 must take the dearer column 1
+  Eigen::MatrixXd cost(2, 2);
+  cost << 1, 5,
+          2, std::numeric_limits<double>::infinity();
+  LinearAssignment solver;
+  std::vector<int> row_to_col;
+  ASSERT_DOUBLE_EQ(7, solver.Solve(cost, row_to_col));
+  ASSERT_EQ(1, row_to_col[0]);
+  ASSERT_EQ(0, row_to_col[1]);
+}
+
+TEST(Assignment, WarmStart)
+{
+  // Perturbed copies of one problem give the same cost warm as cold
+  std::mt19937 rng(7);
+  std::uniform_real_distribution<double> uniform(0, 10);
+  std::normal_distribution<double> noise(0, 0.1);
+  const int n = 30;
+  Eigen::MatrixXd base(n, n);
+  for (int r = 0; r < n; ++r)
+    for (int c = 0; c < n; ++c) base(r, c) = uniform(rng);
+
+  LinearAssignment warm;
+  for (int frame = 0; frame < 10; ++frame)
+  {
+    Eigen::MatrixXd cost = base;
+    for (int r = 0; r < n; ++r)
+      for (int c = 0; c < n; ++c) cost(r, c) += noise(rng);
+
+    LinearAssignment cold;
+    std::vector<int> warm_map, cold_map;
+    const double gate = 5.0;
+    const double warm_total = warm.Solve(cost, warm_map, gate, true);
+    const double cold_total = cold.Solve(cost, cold_map, gate);
+    ASSERT_NEAR(cold_total, warm_total, 1E-9);
+    ASSERT_NEAR(cold_total, Cost(cost, gate, warm_map), 1E-9);
+  }
+}
+
+TEST(Assignment, Sparse)
+{
+  // Rows competing for column 0, with leaving a row unassigned costing 4
+  std::vector<AssignmentEdge> edges;
+  edges.push_back(AssignmentEdge(0, 0, 1));
+  edges.push_back(AssignmentEdge(1, 0, 2));
+  edges.push_back(AssignmentEdge(1, 2, 3));
+  edges.push_back(AssignmentEdge(2, 0, 0.5));
+  LinearAssignment solver;
+  std::vector<int> row_to_col;
+  ASSERT_DOUBLE_EQ(7.5, solver.Solve(3, 3, edges, 4, row_to_col));
+  ASSERT_EQ(-1, row_to_col[0]);
+  ASSERT_EQ(2, row_to_col[1]);
+  ASSERT_EQ(0, row_to_col[2]);
+}
+
+} // namespace testing
+
+} // namespace calibu
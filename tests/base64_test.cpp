@@ -1,5 +1,7 @@
 #include <gtest/gtest.h>
 #include <calibu/pcalib/base64.h>
+#include <cstring>
+#include <numeric>
 
 namespace calibu
 {
@@ -129,6 +131,105 @@ TEST(Base64, Mapping)
   }
 }
 
+TEST(DoubleEncoder, Bulk)
+{
+  std::vector<double> values;
+  values.push_back(+0.0);
+  values.push_back(-0.0);
+  values.push_back(+1.0);
+  values.push_back(-0.5);
+  values.push_back(std::numeric_limits<double>::max());
+  values.push_back(std::numeric_limits<double>::lowest());
+  values.push_back(std::numeric_limits<double>::min());
+  values.push_back(std::numeric_limits<double>::denorm_min());
+  values.push_back(std::numeric_limits<double>::min() / 3);
+  values.push_back(+std::numeric_limits<double>::infinity());
+  values.push_back(-std::numeric_limits<double>::infinity());
+  values.push_back(std::numeric_limits<double>::quiet_NaN());
+
+  for (int i = 0; i < 2000; ++i)
+  {
+    const double value = Eigen::internal::random<double>(-1, 1);
+    values.push_back(std::ldexp(value, (i % 200 - 100) * 10));
+  }
+
+  std::vector<uint8_t> bytes(sizeof(uint64_t) * values.size());
+  DoubleEncoder::Encode(values.data(), values.size(), bytes.data());
+
+  std::vector<double> found(values.size());
+  DoubleEncoder::Decode(bytes.data(), values.size(), found.data());
+
+  for (size_t i = 0; i < values.size(); ++i)
+  {
+    uint64_t encoding;
+    std::memcpy(&encoding, &bytes[sizeof(uint64_t) * i], sizeof(encoding));
+    ASSERT_EQ(DoubleEncoder::Encode(values[i]), encoding);
+
+    const double expected = DoubleEncoder::Decode(encoding);
+    if (std::isnan(expected)) ASSERT_TRUE(std::isnan(found[i]));
+    else ASSERT_EQ(expected, found[i]);
+  }
+}
+
+TEST(Base64, Long)
+{
+  const std::string alphabet =
+      "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+  for (size_t count = 0; count < 300; count += 7)
+  {
+    std::vector<uint8_t> data(count);
+    for (uint8_t& value : data) value = std::rand() % 256;
+
+    // compare with encoding one 6-bit value at a time
+
+    std::string expected;
+    for (size_t bit = 0; bit < 8 * count; bit += 6)
+    {
+      int value = 0;
+      for (size_t b = bit; b < bit + 6; ++b)
+      {
+        const bool set = b < 8 * count && (data[b / 8] >> (7 - b % 8)) & 1;
+        value = value << 1 | set;
+      }
+      expected += alphabet[value];
+    }
+
+    const std::string encoding = Base64::Encode(data);
+    ASSERT_EQ(expected, encoding);
+
+    const std::vector<uint8_t> found = Base64::Decode(encoding);
+    ASSERT_LE(data.size(), found.size());
+    for (size_t i = 0; i < data.size(); ++i) ASSERT_EQ(data[i], found[i]);
+  }
+}
+
+TEST(Base64, Invalid)
+{
+  // characters outside the alphabet decode as zero
+
+  std::string encoding(256, 'A');
+  for (int i = 0; i < 256; ++i)
+  {
+    encoding[i] = char(i);
+  }
+
+  std::string expected = encoding;
+  const std::string alphabet =
+      "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+  for (char& c : expected)
+  {
+    if (alphabet.find(c) == std::string::npos) c = 'A';
+  }
+
+  ASSERT_EQ(Base64::Decode(expected), Base64::Decode(encoding));
+
+  const std::string valid = Base64::Encode(Base64::Decode(
+      alphabet + alphabet + alphabet));
+  ASSERT_EQ(alphabet + alphabet + alphabet, valid);
+}
+
 TEST(Base64Encode, Mapping)
 {
   Eigen::MatrixXd matrix(640, 480);
@@ -0,0 +1,144 @@
+#include <gtest/gtest.h>
+#include <calibu/calib/CalibrationReport.h>
+#include <calibu/cam/camera_models_crtp.h>
+
+#include <sstream>
+
+namespace calibu
+{
+namespace testing
+{
+
+typedef std::vector<Eigen::Vector3d, Eigen::aligned_allocator<Eigen::Vector3d>> Points3d;
+typedef std::vector<Eigen::Vector2d, Eigen::aligned_allocator<Eigen::Vector2d>> Points2d;
+typedef std::vector<Sophus::SE3d, Eigen::aligned_allocator<Sophus::SE3d>> Poses;
+
+// Target points seen by a camera 2m in front of them over its whole image,
+// observed with residual 'offset' and one point behind the camera.
+struct ReportFixture
+{
+  ReportFixture(const Eigen::Vector2d& offset)
+  {
+    Eigen::VectorXd params(4);
+    params << 300, 300, 160, 120;
+    Eigen::Vector2i size(320, 240);
+    camera = std::make_shared<LinearCamera<double>>(params, size);
+    T_ck.push_back(Sophus::SE3d());
+    T_kw.push_back(Sophus::SE3d(Eigen::Quaterniond::Identity(),
+                                Eigen::Vector3d(0, 0, 2)));
+
+    for (int y = 0; y < 240; y += 4)
+    {
+      for (int x = 0; x < 320; x += 4)
+      {
+        const Eigen::Vector2d p(x + 0.5, y + 0.5);
+        P_w.push_back(camera->Unproject(p) * 2 - Eigen::Vector3d(0, 0, 2));
+        p_c.push_back(p - offset);
+      }
+    }
+    P_w.push_back(Eigen::Vector3d(0, 0, -3));
+    p_c.push_back(Eigen::Vector2d(160, 120));
+  }
+
+  void Compute(CalibrationReport& report, const ParamsCalibrationReport& params,
+               size_t group_size)
+  {
+    std::vector<ReportObservations> observations;
+    for (size_t begin = 0; begin < P_w.size(); begin += group_size)
+    {
+      ReportObservations obs;
+      obs.frame = 0;
+      obs.camera = 0;
+      obs.P_w = P_w.data() + begin;
+      obs.p_c = p_c.data() + begin;
+      obs.size = std::min(group_size, P_w.size() - begin);
+      observations.push_back(obs);
+    }
+    ComputeCalibrationReport({camera->Snapshot()}, T_ck, T_kw, observations,
+                             report, params);
+  }
+
+  std::shared_ptr<CameraInterface<double>> camera;
+  Poses T_ck;
+  Poses T_kw;
+  Points3d P_w;
+  Points2d p_c;
+};
+
+TEST(CalibrationReport, ResidualStatistics)
+{
+  ReportFixture fixture(Eigen::Vector2d(0.3, -0.4));
+  ParamsCalibrationReport params;
+  params.num_threads = 3;
+  CalibrationReport report;
+  fixture.Compute(report, params, 100);
+
+  ASSERT_EQ(1u, report.cameras.size());
+  const CameraReport& cam = report.cameras[0];
+  EXPECT_EQ(fixture.P_w.size(), cam.num_observations);
+  EXPECT_EQ(1u, cam.num_failed);
+  EXPECT_NEAR(0.5, cam.rms, 1e-6);
+  EXPECT_NEAR(0.5, cam.median, 1e-6);
+  EXPECT_NEAR(0.5, cam.max, 1e-6);
+  EXPECT_NEAR(0.3, cam.bias[0], 1e-6);
+  EXPECT_NEAR(-0.4, cam.bias[1], 1e-6);
+  EXPECT_NEAR(report.rms, cam.rms, 1e-9);
+
+  ASSERT_EQ(16u * 12u, cam.cell_count.size());
+  EXPECT_DOUBLE_EQ(1.0, cam.coverage);
+  for (size_t c = 0; c < cam.cell_count.size(); ++c)
+  {
+    EXPECT_EQ(25u, cam.cell_count[c]);
+    EXPECT_NEAR(0.5, cam.cell_rms[c], 1e-5);
+  }
+}
+
+TEST(CalibrationReport, IndependentOfThreadsAndGrouping)
+{
+  ReportFixture fixture(Eigen::Vector2d(0.1, 0.2));
+  // Observations concentrated in one corner
+  for (size_t i = 0; i < fixture.P_w.size(); i += 7)
+  {
+    fixture.p_c[i] += Eigen::Vector2d(1, 0);
+  }
+
+  ParamsCalibrationReport params;
+  params.grid_cols = 4;
+  params.grid_rows = 3;
+  params.num_threads = 1;
+  CalibrationReport serial;
+  fixture.Compute(serial, params, fixture.P_w.size());
+
+  params.num_threads = 4;
+  CalibrationReport parallel;
+  fixture.Compute(parallel, params, 37);
+
+  const CameraReport& a = serial.cameras[0];
+  const CameraReport& b = parallel.cameras[0];
+  EXPECT_NEAR(a.rms, b.rms, 1e-9);
+  EXPECT_NEAR(a.p90, b.p90, 1e-9);
+  EXPECT_EQ(a.cell_count, b.cell_count);
+  EXPECT_EQ(a.cell_rms, b.cell_rms);
+}
+
+TEST(CalibrationReport, WritesJson)
+{
+  ReportFixture fixture(Eigen::Vector2d(1, 0));
+  ParamsCalibrationReport params;
+  params.grid_cols = 2;
+  params.grid_rows = 2;
+  CalibrationReport report;
+  fixture.Compute(report, params, 500);
+
+  std::ostringstream json;
+  report.WriteJson(json);
+  EXPECT_NE(std::string::npos, json.str().find("\"num_observations\": 4801"));
+  EXPECT_NE(std::string::npos, json.str().find("\"num_failed\": 1"));
+  EXPECT_NE(std::string::npos, json.str().find("\"coverage\": 1"));
+  EXPECT_NE(std::string::npos, json.str().find("\"rms\": [1,1,1,1]"));
+  EXPECT_NE(std::string::npos, json.str().find("\"bias_u\": [1,1,1,1]"));
+}
+
+} // namespace testing
+
+} // namespace calibu
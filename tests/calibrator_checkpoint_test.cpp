@@ -0,0 +1,143 @@
+#include <gtest/gtest.h>
+#include <calibu/calib/CalibratorCheckpoint.h>
+
+#include <cstdio>
+#include <fstream>
+
+namespace calibu
+{
+namespace testing
+{
+
+CalibratorCheckpoint CreateCheckpoint()
+{
+  CalibratorCheckpoint checkpoint;
+  checkpoint.mse = 0.125;
+  checkpoint.num_residuals = 42;
+  checkpoint.num_outliers = 3;
+
+  for (int c = 0; c < 2; ++c)
+  {
+    CalibratorCheckpoint::Camera cam;
+    cam.type = c ? "calibu_fu_fv_u0_v0_kb4" : "calibu_fu_fv_u0_v0_w";
+    cam.params = Eigen::VectorXd::LinSpaced(5 + 3 * c, 0.5, 320.0);
+    cam.T_ck = Sophus::SE3d(Eigen::Quaterniond(0.5, 0.5, -0.5, 0.5),
+                            Eigen::Vector3d(0.1 * c, 0, -0.02));
+    cam.loss_scale = c ? 0.0 : 0.5;
+    checkpoint.cameras.push_back(cam);
+  }
+
+  for (int f = 0; f < 3; ++f)
+  {
+    const Eigen::Quaterniond q(Eigen::AngleAxisd(0.1 * f, Eigen::Vector3d::UnitY()));
+    checkpoint.T_kw.push_back(Sophus::SE3d(q, Eigen::Vector3d(f, -f, 1.0)));
+
+    for (int c = 0; c < 2; ++c)
+    {
+      CalibratorCheckpoint::Observations obs;
+      obs.frame = f;
+      obs.camera = c;
+      obs.single = f == 2;
+      for (int i = 0; i < (obs.single ? 1 : 4 + f); ++i)
+      {
+        obs.P_w.push_back(Eigen::Vector3d(0.01 * i, 0.02 * f, 0));
+        obs.p_c.push_back(Eigen::Vector2d(10.25 * i, 3.5 * f - c));
+      }
+      checkpoint.observations.push_back(obs);
+    }
+  }
+  return checkpoint;
+}
+
+void ExpectPoseEq(const Sophus::SE3d& a, const Sophus::SE3d& b)
+{
+  ASSERT_TRUE(a.unit_quaternion().coeffs() == b.unit_quaternion().coeffs());
+  ASSERT_TRUE(a.translation() == b.translation());
+}
+
+TEST(CalibratorCheckpoint, RoundTrip)
+{
+  const std::string filename = ::testing::TempDir() + "calibu_checkpoint.bin";
+  const CalibratorCheckpoint checkpoint = CreateCheckpoint();
+  ASSERT_TRUE(checkpoint.Save(filename));
+
+  CalibratorCheckpoint read;
+  ASSERT_TRUE(read.Load(filename));
+  ASSERT_EQ(checkpoint.mse, read.mse);
+  ASSERT_EQ(checkpoint.num_residuals, read.num_residuals);
+  ASSERT_EQ(checkpoint.num_outliers, read.num_outliers);
+
+  ASSERT_EQ(checkpoint.cameras.size(), read.cameras.size());
+  for (size_t c = 0; c < checkpoint.cameras.size(); ++c)
+  {
+    const CalibratorCheckpoint::Camera& a = checkpoint.cameras[c];
+    const CalibratorCheckpoint::Camera& b = read.cameras[c];
+    ASSERT_EQ(a.type, b.type);
+    ASSERT_TRUE(a.params == b.params);
+    ExpectPoseEq(a.T_ck, b.T_ck);
+    ASSERT_EQ(a.loss_scale, b.loss_scale);
+  }
+
+  ASSERT_EQ(checkpoint.T_kw.size(), read.T_kw.size());
+  for (size_t f = 0; f < checkpoint.T_kw.size(); ++f)
+  {
+    ExpectPoseEq(checkpoint.T_kw[f], read.T_kw[f]);
+  }
+
+  ASSERT_EQ(checkpoint.observations.size(), read.observations.size());
+  for (size_t o = 0; o < checkpoint.observations.size(); ++o)
+  {
+    const CalibratorCheckpoint::Observations& a = checkpoint.observations[o];
+    const CalibratorCheckpoint::Observations& b = read.observations[o];
+    ASSERT_EQ(a.frame, b.frame);
+    ASSERT_EQ(a.camera, b.camera);
+    ASSERT_EQ(a.single, b.single);
+    ASSERT_TRUE(a.P_w == b.P_w);
+    ASSERT_TRUE(a.p_c == b.p_c);
+  }
+  std::remove(filename.c_str());
+}
+
+TEST(CalibratorCheckpoint, Rejects)
+{
+  const std::string filename = ::testing::TempDir() + "calibu_checkpoint_bad.bin";
+  CalibratorCheckpoint checkpoint = CreateCheckpoint();
+
+  // Every observation needs a 3D point
+  checkpoint.observations[1].P_w.pop_back();
+  ASSERT_FALSE(checkpoint.Save(filename));
+
+  checkpoint = CreateCheckpoint();
+  ASSERT_TRUE(checkpoint.Save(filename));
+  std::string data;
+  {
+    std::ifstream in(filename, std::ios::binary);
+    data.assign((std::istreambuf_iterator<char>(in)),
+                std::istreambuf_iterator<char>());
+  }
+
+  // Truncate the last observation
+  {
+    std::ofstream out(filename, std::ios::binary | std::ios::trunc);
+    out.write(data.data(), data.size() - 1);
+  }
+  CalibratorCheckpoint read;
+  ASSERT_FALSE(read.Load(filename));
+  ASSERT_TRUE(read.cameras.empty());
+  ASSERT_TRUE(read.observations.empty());
+
+  // Trailing data is corruption too
+  {
+    std::ofstream out(filename, std::ios::binary | std::ios::trunc);
+    out.write(data.data(), data.size());
+    out.put(0);
+  }
+  ASSERT_FALSE(read.Load(filename));
+  std::remove(filename.c_str());
+
+  ASSERT_FALSE(read.Load(filename));
+}
+
+} // namespace testing
+
+} // namespace calibu
@@ -0,0 +1,144 @@
+#include <gtest/gtest.h>
+#include <calibu/cam/camera_models_crtp.h>
+#include "test_util.h"
+
+namespace calibu
+{
+namespace testing
+{
+
+TEST(CameraBatch, ProjectN)
+{
+  std::shared_ptr<CameraInterface<double>> camera = CreateFovCamera();
+  Eigen::Matrix3Xd rays = Eigen::Matrix3Xd::Random(3, 16);
+  rays.row(2).array() += 3.0;
+
+  Eigen::Matrix2Xd pixels;
+  camera->ProjectN(rays, pixels);
+  ASSERT_EQ(rays.cols(), pixels.cols());
+
+  for (int i = 0; i < rays.cols(); ++i)
+  {
+    const Eigen::Vector2d expected = camera->Project(rays.col(i));
+    ASSERT_DOUBLE_EQ(expected[0], pixels(0, i));
+    ASSERT_DOUBLE_EQ(expected[1], pixels(1, i));
+  }
+}
+
+TEST(CameraBatch, UnprojectN)
+{
+  std::shared_ptr<CameraInterface<double>> camera = CreateFovCamera();
+  Eigen::Matrix2Xd pixels = Eigen::Matrix2Xd::Random(2, 16);
+  pixels.row(0) = 320.0 * (pixels.row(0).array() + 1.0);
+  pixels.row(1) = 240.0 * (pixels.row(1).array() + 1.0);
+
+  Eigen::Matrix3Xd rays;
+  camera->UnprojectN(pixels, rays);
+  ASSERT_EQ(pixels.cols(), rays.cols());
+
+  for (int i = 0; i < pixels.cols(); ++i)
+  {
+    const Eigen::Vector3d expected = camera->Unproject(pixels.col(i));
+    ASSERT_DOUBLE_EQ(expected[0], rays(0, i));
+    ASSERT_DOUBLE_EQ(expected[1], rays(1, i));
+    ASSERT_DOUBLE_EQ(expected[2], rays(2, i));
+  }
+}
+
+TEST(CameraBatch, StructOfArrays)
+{
+  std::shared_ptr<CameraInterface<double>> camera = CreateFovCamera();
+  const size_t count = 8;
+  std::vector<double> x(count), y(count), z(count), u(count), v(count);
+
+  for (size_t i = 0; i < count; ++i)
+  {
+    x[i] = 0.1 * i - 0.4;
+    y[i] = 0.05 * i - 0.2;
+    z[i] = 1.0 + 0.1 * i;
+  }
+
+  camera->ProjectN(x.data(), y.data(), z.data(), u.data(), v.data(), count);
+
+  for (size_t i = 0; i < count; ++i)
+  {
+    const Eigen::Vector2d expected =
+        camera->Project(Eigen::Vector3d(x[i], y[i], z[i]));
+
+    ASSERT_DOUBLE_EQ(expected[0], u[i]);
+    ASSERT_DOUBLE_EQ(expected[1], v[i]);
+  }
+
+  camera->UnprojectN(u.data(), v.data(), x.data(), y.data(), z.data(), count);
+
+  for (size_t i = 0; i < count; ++i)
+  {
+    const Eigen::Vector3d expected =
+        camera->Unproject(Eigen::Vector2d(u[i], v[i]));
+
+    ASSERT_DOUBLE_EQ(expected[0], x[i]);
+    ASSERT_DOUBLE_EQ(expected[1], y[i]);
+    ASSERT_DOUBLE_EQ(expected[2], z[i]);
+  }
+}
+
+TEST(CameraBatch, FovFastMath)
+{
+  std::shared_ptr<CameraInterface<double>> camera = CreateFovCamera();
+  std::shared_ptr<FovCamera<double>> fast =
+      std::make_shared<FovCamera<double>>(*std::dynamic_pointer_cast<
+          FovCamera<double>>(camera));
+  fast->SetFastMath(true);
+
+  Eigen::Matrix3Xd rays = Eigen::Matrix3Xd::Random(3, 64);
+  rays.row(2).array() += 1.5;
+  Eigen::Matrix2Xd pixels, fast_pixels;
+  camera->ProjectN(rays, pixels);
+  fast->ProjectN(rays, fast_pixels);
+
+  Eigen::Matrix3Xd back;
+  fast->UnprojectN(pixels, back);
+  for (int i = 0; i < rays.cols(); ++i)
+  {
+    // Same as the static kernel the cost functions use
+    Eigen::Vector2d expected;
+    FovCamera<double>::Project(rays.col(i).data(), camera->GetParams().data(),
+                               expected.data());
+    ASSERT_DOUBLE_EQ(expected[0], pixels(0, i));
+    ASSERT_DOUBLE_EQ(expected[1], pixels(1, i));
+
+    ASSERT_NEAR(0, (pixels.col(i) - fast_pixels.col(i)).norm(), 1E-2);
+    const Eigen::Vector3d ray = rays.col(i) / rays(2, i);
+    ASSERT_NEAR(0, (back.col(i) - ray).norm(), 1E-4);
+  }
+}
+
+TEST(CameraBatch, Transfer3dN)
+{
+  std::shared_ptr<CameraInterface<double>> camera = CreateFovCamera();
+  Eigen::Matrix2Xd pixels = Eigen::Matrix2Xd::Random(2, 16);
+  pixels.row(0) = 320.0 * (pixels.row(0).array() + 1.0);
+  pixels.row(1) = 240.0 * (pixels.row(1).array() + 1.0);
+  const std::vector<double> rho = {0.0, 0.1, 0.5, 2.0};
+  const Sophus::SE3d t_ba(Sophus::SO3d::exp(Eigen::Vector3d(0.05, -0.1, 0.02)),
+                          Eigen::Vector3d(0.2, 0.01, -0.05));
+
+  const size_t count = pixels.cols();
+  std::vector<double> u(rho.size() * count), v(rho.size() * count);
+  camera->Transfer3dN(t_ba, pixels, rho, u.data(), v.data());
+
+  for (size_t d = 0; d < rho.size(); ++d)
+  {
+    for (size_t i = 0; i < count; ++i)
+    {
+      const Eigen::Vector2d expected = camera->Transfer3d(
+          t_ba, camera->Unproject(pixels.col(i)), rho[d]);
+      ASSERT_NEAR(expected[0], u[d * count + i], 1E-9);
+      ASSERT_NEAR(expected[1], v[d * count + i], 1E-9);
+    }
+  }
+}
+
+} // namespace testing
+
+} // namespace calibu
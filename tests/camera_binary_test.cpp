@@ -0,0 +1,114 @@
+#include <gtest/gtest.h>
+#include <calibu/cam/camera_binary.h>
+#include <calibu/cam/camera_models_crtp.h>
+
+#include <cstdio>
+#include <fstream>
+
+namespace calibu
+{
+namespace testing
+{
+
+std::shared_ptr<Rig<double>> CreateBinaryRig()
+{
+  std::shared_ptr<Rig<double>> rig(new Rig<double>());
+
+  std::shared_ptr<CameraInterface<double>> fov =
+      CreateCameraModel("calibu_fu_fv_u0_v0_w");
+  Eigen::VectorXd fov_params(5);
+  fov_params << 300, 301, 320.5, 240.25, 0.9;
+  fov->SetParams(fov_params);
+  fov->SetImageDimensions(640, 480);
+  fov->SetName("left");
+  fov->SetSerialNumber(1234567890123ULL);
+  fov->SetIndex(0);
+  fov->SetType("calibu_fu_fv_u0_v0_w");
+  rig->AddCamera(fov);
+
+  std::shared_ptr<CameraInterface<double>> kb4 =
+      CreateCameraModel("calibu_fu_fv_u0_v0_kb4");
+  Eigen::VectorXd kb4_params(8);
+  kb4_params << 280, 280, 330, 250, 0.01, -0.005, 0.001, -0.0005;
+  kb4->SetParams(kb4_params);
+  kb4->SetImageDimensions(752, 480);
+  kb4->SetName("right");
+  kb4->SetIndex(1);
+  kb4->SetVersion(7);
+  kb4->SetType("calibu_fu_fv_u0_v0_kb4");
+  kb4->SetRDF((Eigen::Matrix3d() << 0, 0, 1, 1, 0, 0, 0, 1, 0).finished());
+  kb4->SetPose(Sophus::SE3d(
+      Eigen::Quaterniond(Eigen::AngleAxisd(0.3, Eigen::Vector3d(1, 2, 3).normalized())),
+      Eigen::Vector3d(0.12, -0.01, 0.003)));
+  rig->AddCamera(kb4);
+  return rig;
+}
+
+TEST(CameraBinary, RoundTrip)
+{
+  const std::string filename = ::testing::TempDir() + "calibu_rig_test.bin";
+  std::shared_ptr<Rig<double>> rig = CreateBinaryRig();
+  ASSERT_TRUE(WriteBinaryRig(filename, rig));
+
+  std::shared_ptr<Rig<double>> read = ReadBinaryRig(filename);
+  ASSERT_TRUE(read != nullptr);
+  ASSERT_EQ(rig->NumCams(), read->NumCams());
+  for (size_t c = 0; c < rig->NumCams(); ++c)
+  {
+    const CameraInterface<double>& a = *rig->cameras_[c];
+    const CameraInterface<double>& b = *read->cameras_[c];
+    ASSERT_EQ(a.Type(), b.Type());
+    ASSERT_EQ(a.Name(), b.Name());
+    ASSERT_EQ(a.SerialNumber(), b.SerialNumber());
+    ASSERT_EQ(a.Index(), b.Index());
+    ASSERT_EQ(a.Version(), b.Version());
+    ASSERT_EQ(a.Width(), b.Width());
+    ASSERT_EQ(a.Height(), b.Height());
+    ASSERT_TRUE(a.GetParams() == b.GetParams());
+    ASSERT_TRUE(a.RDF() == b.RDF());
+    ASSERT_TRUE(a.Pose().matrix() == b.Pose().matrix());
+
+    const Eigen::Vector3d ray(0.1, -0.2, 1);
+    ASSERT_TRUE(a.Project(ray) == b.Project(ray));
+  }
+
+  MappedRig mapped;
+  ASSERT_TRUE(mapped.Open(filename));
+  ASSERT_EQ(2u, mapped.NumCams());
+  ASSERT_STREQ("right", mapped.CameraRecord(1).name);
+  ASSERT_EQ(8u, mapped.CameraRecord(1).num_params);
+  ASSERT_EQ("left", mapped.Camera(0)->Name());
+  std::remove(filename.c_str());
+}
+
+TEST(CameraBinary, Rejects)
+{
+  const std::string filename = ::testing::TempDir() + "calibu_rig_bad.bin";
+  std::shared_ptr<Rig<double>> rig = CreateBinaryRig();
+
+  // A camera without a model type can't be read back
+  rig->cameras_[1]->SetType("");
+  ASSERT_FALSE(WriteBinaryRig(filename, rig));
+
+  rig->cameras_[1]->SetType("calibu_fu_fv_u0_v0_kb4");
+  ASSERT_TRUE(WriteBinaryRig(filename, rig));
+  {
+    // Truncate the last record
+    std::ifstream in(filename, std::ios::binary);
+    std::string data((std::istreambuf_iterator<char>(in)),
+                     std::istreambuf_iterator<char>());
+    in.close();
+    std::ofstream out(filename, std::ios::binary | std::ios::trunc);
+    out.write(data.data(), data.size() - 1);
+  }
+  MappedRig mapped;
+  ASSERT_FALSE(mapped.Open(filename));
+  ASSERT_TRUE(ReadBinaryRig(filename) == nullptr);
+  std::remove(filename.c_str());
+
+  ASSERT_TRUE(ReadBinaryRig(filename) == nullptr);
+}
+
+} // namespace testing
+
+} // namespace calibu
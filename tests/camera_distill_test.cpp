@@ -0,0 +1,90 @@
+#include <gtest/gtest.h>
+#include <calibu/cam/camera_distill.h>
+#include <calibu/cam/camera_models_crtp.h>
+
+namespace calibu
+{
+namespace testing
+{
+
+std::shared_ptr<CameraInterface<double>> MakeKb4Camera()
+{
+  Eigen::VectorXd params(8);
+  params << 500, 505, 322, 238, 0.02, -0.01, 0.005, -0.001;
+  Eigen::Vector2i size(640, 480);
+  return std::make_shared<KannalaBrandtCamera<double>>(params, size);
+}
+
+TEST(CameraDistill, RecoversSameModel)
+{
+  Eigen::VectorXd params(4);
+  params << 400, 410, 330, 250;
+  Eigen::Vector2i size(640, 480);
+  LinearCamera<double> camera(params, size);
+  camera.SetName("left");
+
+  CameraDistillation result;
+  std::shared_ptr<CameraInterface<double>> fit =
+      DistillCamera(camera, "calibu_fu_fv_u0_v0", result);
+  ASSERT_TRUE(fit != nullptr);
+  EXPECT_EQ("calibu_fu_fv_u0_v0", fit->Type());
+  EXPECT_EQ("left", fit->Name());
+  EXPECT_EQ(640, fit->Width());
+  EXPECT_EQ(480, fit->Height());
+  EXPECT_EQ(161u * 121u, result.num_samples);
+  EXPECT_EQ(0u, result.num_dropped);
+  EXPECT_LT(result.max_error, 1e-6);
+  EXPECT_LT(result.max_unproject_error, 1e-6);
+  EXPECT_TRUE(fit->GetParams().isApprox(params, 1e-9));
+}
+
+TEST(CameraDistill, FitsCheaperModel)
+{
+  std::shared_ptr<CameraInterface<double>> camera = MakeKb4Camera();
+  ParamsCameraDistill params;
+  params.pixel_step = 8;
+
+  CameraDistillation poly3;
+  std::shared_ptr<CameraInterface<double>> fit =
+      DistillCamera(*camera, "calibu_fu_fv_u0_v0_k1_k2_k3", poly3, params);
+  ASSERT_TRUE(fit != nullptr);
+  EXPECT_GT(poly3.iterations, 0);
+  EXPECT_LE(poly3.rms_error, poly3.max_error);
+  EXPECT_LT(poly3.max_error, 0.5);
+  EXPECT_LT(poly3.max_unproject_error, 0.5);
+
+  // Only the pinhole part of the source is matched by a linear fit
+  CameraDistillation linear;
+  ASSERT_TRUE(DistillCamera(*camera, "calibu_fu_fv_u0_v0", linear, params));
+  EXPECT_GT(linear.max_error, 10 * poly3.max_error);
+}
+
+TEST(CameraDistill, IndependentOfThreads)
+{
+  std::shared_ptr<CameraInterface<double>> camera = MakeKb4Camera();
+  ParamsCameraDistill params;
+  params.num_threads = 1;
+  CameraDistillation serial_result;
+  std::shared_ptr<CameraInterface<double>> serial =
+      DistillCamera(*camera, "calibu_fu_fv_u0_v0_w", serial_result, params);
+
+  params.num_threads = 4;
+  CameraDistillation parallel_result;
+  std::shared_ptr<CameraInterface<double>> parallel =
+      DistillCamera(*camera, "calibu_fu_fv_u0_v0_w", parallel_result, params);
+
+  ASSERT_TRUE(serial && parallel);
+  EXPECT_EQ(serial->GetParams(), parallel->GetParams());
+  EXPECT_EQ(serial_result.iterations, parallel_result.iterations);
+  EXPECT_EQ(serial_result.max_error, parallel_result.max_error);
+}
+
+TEST(CameraDistill, UnknownModel)
+{
+  CameraDistillation result;
+  EXPECT_TRUE(DistillCamera(*MakeKb4Camera(), "calibu_lut", result) == nullptr);
+}
+
+} // namespace testing
+
+} // namespace calibu
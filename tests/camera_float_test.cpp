@@ -0,0 +1,117 @@
+#include <gtest/gtest.h>
+#include <calibu/cam/camera_cast.h>
+
+namespace calibu
+{
+namespace testing
+{
+
+std::vector<std::shared_ptr<CameraInterface<double>>> CreateCameras()
+{
+  Eigen::Vector2i size(640, 480);
+  std::vector<std::shared_ptr<CameraInterface<double>>> cameras;
+
+  Eigen::VectorXd fov(5);
+  fov << 300, 300, 320, 240, 0.9;
+  cameras.push_back(std::make_shared<FovCamera<double>>(fov, size));
+
+  Eigen::VectorXd kb4(8);
+  kb4 << 300, 300, 320, 240, 0.01, -0.005, 0.001, -0.0005;
+  cameras.push_back(std::make_shared<KannalaBrandtCamera<double>>(kb4, size));
+
+  Eigen::VectorXd poly3(7);
+  poly3 << 300, 300, 320, 240, -0.05, 0.01, -0.001;
+  cameras.push_back(std::make_shared<Poly3Camera<double>>(poly3, size));
+  return cameras;
+}
+
+TEST(CameraFloat, MatchesDouble)
+{
+  for (const std::shared_ptr<CameraInterface<double>>& camera : CreateCameras())
+  {
+    std::shared_ptr<CameraInterface<float>> camera_f =
+        CameraCast<float>(camera);
+    ASSERT_TRUE(camera_f != nullptr);
+    ASSERT_EQ(camera->Width(), camera_f->Width());
+    ASSERT_EQ(camera->GetParams(), camera_f->GetParams());
+
+    for (double y = 10; y < 480; y += 50)
+    {
+      for (double x = 10; x < 640; x += 50)
+      {
+        const Eigen::Vector2d pix(x, y);
+        const Eigen::Vector3d ray = camera->Unproject(pix);
+        const Eigen::Vector3f ray_f = camera_f->Unproject(pix.cast<float>());
+        ASSERT_NEAR(0, (ray - ray_f.cast<double>()).norm(), 1E-5);
+
+        const Eigen::Vector2f pix_f = camera_f->Project(ray.cast<float>());
+        ASSERT_NEAR(0, (pix - pix_f.cast<double>()).norm(), 1E-3);
+
+        const Eigen::Matrix<double, 2, 3> J = camera->dProject_dray(ray);
+        const Eigen::Matrix<float, 2, 3> J_f =
+            camera_f->dProject_dray(ray.cast<float>());
+        ASSERT_NEAR(0, (J - J_f.cast<double>()).norm(), 1E-3 * J.norm());
+      }
+    }
+  }
+}
+
+TEST(CameraFloat, FovNearCentre)
+{
+  // The limits near the centre stay continuous with the full expressions
+  std::shared_ptr<CameraInterface<float>> camera =
+      CameraCast<float>(CreateCameras()[0]);
+  for (float r : { 1E-4f, 5E-3f, 1E-2f, 2E-2f })
+  {
+    const Eigen::Vector3f ray(r, 0, 1);
+    const Eigen::Vector2f pix = camera->Project(ray);
+    const Eigen::Vector3f back = camera->Unproject(pix);
+    ASSERT_NEAR(ray[0], back[0] / back[2], 1E-6);
+  }
+}
+
+TEST(CameraFloat, ProjectN)
+{
+  std::shared_ptr<CameraInterface<float>> camera =
+      CameraCast<float>(CreateCameras()[1]);
+  Eigen::Matrix3Xf rays = Eigen::Matrix3Xf::Random(3, 16);
+  rays.row(2).array() += 3.0f;
+
+  Eigen::Matrix2Xf pixels;
+  camera->ProjectN(rays, pixels);
+  Eigen::Matrix3Xf back;
+  camera->UnprojectN(pixels, back);
+  for (int i = 0; i < rays.cols(); ++i)
+  {
+    const Eigen::Vector2f expected = camera->Project(rays.col(i));
+    ASSERT_FLOAT_EQ(expected[0], pixels(0, i));
+    ASSERT_FLOAT_EQ(expected[1], pixels(1, i));
+    ASSERT_NEAR(0, (back.col(i) - rays.col(i).normalized()).norm(), 1E-5);
+  }
+}
+
+TEST(CameraFloat, RigCast)
+{
+  std::shared_ptr<Rig<double>> rig(new Rig<double>());
+  for (const std::shared_ptr<CameraInterface<double>>& camera : CreateCameras())
+  {
+    rig->AddCamera(camera);
+  }
+  rig->cameras_[1]->SetPose(
+      Sophus::SE3d(Sophus::SO3d(), Eigen::Vector3d(0.1, 0, 0)));
+
+  std::shared_ptr<Rig<float>> rig_f = RigCast<float>(rig);
+  ASSERT_TRUE(rig_f != nullptr);
+  ASSERT_EQ(rig->NumCams(), rig_f->NumCams());
+  ASSERT_FLOAT_EQ(0.1f, rig_f->cameras_[1]->Pose().translation()[0]);
+
+  std::shared_ptr<Rig<double>> back = RigCast<double>(rig_f);
+  for (size_t c = 0; c < rig->NumCams(); ++c)
+  {
+    ASSERT_EQ(rig->cameras_[c]->GetParams(), back->cameras_[c]->GetParams());
+  }
+}
+
+} // namespace testing
+
+} // namespace calibu
@@ -0,0 +1,144 @@
+#include <gtest/gtest.h>
+#include <calibu/cam/camera_models_crtp.h>
+
+namespace calibu
+{
+namespace testing
+{
+
+template <typename Camera>
+void TestProjectJacobians(const Eigen::VectorXd& params)
+{
+  const double eps = 1E-6;
+  Eigen::Vector2i size(640, 480);
+  std::shared_ptr<CameraInterface<double>> camera =
+      std::make_shared<Camera>(params, size);
+
+  const Eigen::Vector3d rays[] =
+  {
+    Eigen::Vector3d( 0.20, -0.10, 1.0),
+    Eigen::Vector3d(-0.35,  0.25, 1.5),
+    Eigen::Vector3d( 0.05,  0.40, 0.8),
+  };
+
+  for (const Eigen::Vector3d& ray : rays)
+  {
+    const Eigen::Matrix<double, 2, Eigen::Dynamic> dparams =
+        camera->dProject_dparams(ray);
+
+    ASSERT_EQ(params.size(), dparams.cols());
+
+    for (int i = 0; i < params.size(); ++i)
+    {
+      Eigen::VectorXd params_p = params;
+      Eigen::VectorXd params_m = params;
+      params_p[i] += eps;
+      params_m[i] -= eps;
+      camera->SetParams(params_p);
+      const Eigen::Vector2d project_p = camera->Project(ray);
+      camera->SetParams(params_m);
+      const Eigen::Vector2d project_m = camera->Project(ray);
+      camera->SetParams(params);
+
+      const Eigen::Vector2d expected = (project_p - project_m) / (2 * eps);
+
+      const double tolerance = 1E-5 * std::max(1.0, expected.norm());
+      ASSERT_NEAR(expected[0], dparams(0, i), tolerance);
+      ASSERT_NEAR(expected[1], dparams(1, i), tolerance);
+    }
+
+    const Eigen::Matrix<double, 2, 3> dray = camera->dProject_dray(ray);
+
+    for (int i = 0; i < 3; ++i)
+    {
+      Eigen::Vector3d ray_p = ray;
+      Eigen::Vector3d ray_m = ray;
+      ray_p[i] += eps;
+      ray_m[i] -= eps;
+
+      const Eigen::Vector2d expected = (camera->Project(ray_p) -
+          camera->Project(ray_m)) / (2 * eps);
+
+      const double tolerance = 1E-5 * std::max(1.0, expected.norm());
+      ASSERT_NEAR(expected[0], dray(0, i), tolerance);
+      ASSERT_NEAR(expected[1], dray(1, i), tolerance);
+    }
+
+    // The fused kernel agrees with the separate ones
+    Eigen::Vector2d pix;
+    Eigen::Matrix<double, 2, 3> fused_dray;
+    Eigen::Matrix<double, 2, Eigen::Dynamic> fused_dparams;
+    camera->ProjectWithJacobians(ray, pix, &fused_dray, &fused_dparams);
+    ASSERT_EQ(params.size(), fused_dparams.cols());
+    EXPECT_LT((pix - camera->Project(ray)).norm(), 1E-9);
+    EXPECT_LT((fused_dray - dray).norm(), 1E-9 * std::max(1.0, dray.norm()));
+    EXPECT_LT((fused_dparams - dparams).norm(),
+              1E-9 * std::max(1.0, dparams.norm()));
+
+    Eigen::Vector2d pix_only;
+    camera->ProjectWithJacobians(ray, pix_only, nullptr);
+    EXPECT_EQ(pix, pix_only);
+
+    // Caller provided storage
+    double j[2 * 16];
+    camera->dProject_dparams(ray, j);
+    EXPECT_EQ(dparams, (Eigen::Map<const Eigen::MatrixXd>(j, 2, params.size())));
+
+    // Parameters held inline
+    const FixedParamsCamera<Camera> fixed(*camera);
+    Eigen::Vector2d fixed_pix;
+    Eigen::Matrix<double, 2, 3> fixed_dray;
+    Eigen::Matrix<double, 2, Camera::kParamSize> fixed_dparams;
+    fixed.ProjectWithJacobians(ray, fixed_pix, &fixed_dray, &fixed_dparams);
+    EXPECT_EQ(pix, fixed_pix);
+    EXPECT_EQ(fused_dray, fixed_dray);
+    EXPECT_EQ(fused_dparams, fixed_dparams);
+    EXPECT_EQ(dparams, fixed.dProject_dparams(ray));
+  }
+}
+
+TEST(CameraJacobian, Linear)
+{
+  Eigen::VectorXd params(4);
+  params << 300, 310, 320, 240;
+  TestProjectJacobians<LinearCamera<double>>(params);
+}
+
+TEST(CameraJacobian, Fov)
+{
+  Eigen::VectorXd params(5);
+  params << 300, 310, 320, 240, 0.9;
+  TestProjectJacobians<FovCamera<double>>(params);
+}
+
+TEST(CameraJacobian, Poly2)
+{
+  Eigen::VectorXd params(6);
+  params << 300, 310, 320, 240, 0.1, -0.05;
+  TestProjectJacobians<Poly2Camera<double>>(params);
+}
+
+TEST(CameraJacobian, Poly3)
+{
+  Eigen::VectorXd params(7);
+  params << 300, 310, 320, 240, 0.1, -0.05, 0.01;
+  TestProjectJacobians<Poly3Camera<double>>(params);
+}
+
+TEST(CameraJacobian, KannalaBrandt)
+{
+  Eigen::VectorXd params(8);
+  params << 300, 310, 320, 240, 0.01, -0.02, 0.003, -0.001;
+  TestProjectJacobians<KannalaBrandtCamera<double>>(params);
+}
+
+TEST(CameraJacobian, Rational6)
+{
+  Eigen::VectorXd params(10);
+  params << 300, 310, 320, 240, 0.1, -0.05, 0.01, 0.05, 0.02, -0.01;
+  TestProjectJacobians<Rational6Camera<double>>(params);
+}
+
+} // namespace testing
+
+} // namespace calibu
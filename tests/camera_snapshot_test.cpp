@@ -0,0 +1,103 @@
+#include <thread>
+
+#include <gtest/gtest.h>
+#include <calibu/cam/camera_models_crtp.h>
+#include "test_util.h"
+
+namespace calibu
+{
+namespace testing
+{
+
+TEST(CameraSnapshot, MatchesCamera)
+{
+  std::shared_ptr<CameraInterface<double>> camera = CreateFovCamera();
+  camera->SetType("calibu_fu_fv_u0_v0_w");
+  camera->SetName("left");
+  std::shared_ptr<const CameraSnapshot<double>> snapshot = camera->Snapshot();
+
+  ASSERT_EQ(camera->Type(), snapshot->Camera().Type());
+  ASSERT_EQ(camera->Name(), snapshot->Camera().Name());
+  ASSERT_EQ(camera->Width(), snapshot->Camera().Width());
+  ASSERT_EQ(camera->Height(), snapshot->Camera().Height());
+
+  Eigen::Matrix3Xd rays = Eigen::Matrix3Xd::Random(3, 16);
+  rays.row(2).array() += 3.0;
+  for (int i = 0; i < rays.cols(); ++i)
+  {
+    const Eigen::Vector2d pix = camera->Project(rays.col(i));
+    ASSERT_DOUBLE_EQ(pix[0], snapshot->Project(rays.col(i))[0]);
+    ASSERT_DOUBLE_EQ(pix[1], snapshot->Project(rays.col(i))[1]);
+    ASSERT_NEAR(0, (camera->Unproject(pix) - snapshot->Unproject(pix)).norm(),
+                1E-12);
+    ASSERT_NEAR(0, (camera->dProject_dray(rays.col(i)) -
+                    snapshot->dProject_dray(rays.col(i))).norm(), 1E-12);
+  }
+}
+
+TEST(CameraSnapshot, Immutable)
+{
+  std::shared_ptr<CameraInterface<double>> camera = CreateFovCamera();
+  std::shared_ptr<const CameraSnapshot<double>> snapshot = camera->Snapshot();
+  const Eigen::Vector3d ray(0.3, -0.2, 1.0);
+  const Eigen::Vector2d before = camera->Project(ray);
+
+  camera->GetParams()[4] = 0.5;
+  camera->Scale(0.5);
+  ASSERT_GT((camera->Project(ray) - before).norm(), 1.0);
+  ASSERT_DOUBLE_EQ(before[0], snapshot->Project(ray)[0]);
+  ASSERT_DOUBLE_EQ(before[1], snapshot->Project(ray)[1]);
+  ASSERT_EQ(640u, snapshot->Camera().Width());
+}
+
+TEST(CameraSnapshot, ConcurrentReaders)
+{
+  std::shared_ptr<CameraInterface<double>> camera = CreateFovCamera();
+  std::shared_ptr<const CameraSnapshot<double>> published = camera->Snapshot();
+  const size_t count = 256;
+  std::vector<double> x(count), y(count), z(count, 2.0);
+  for (size_t i = 0; i < count; ++i)
+  {
+    x[i] = 0.01 * i - 1.0;
+    y[i] = 0.5 - 0.002 * i;
+  }
+
+  std::vector<std::thread> readers;
+  std::vector<int> consistent(4, 0);
+  for (size_t t = 0; t < consistent.size(); ++t)
+  {
+    readers.emplace_back([&, t]() {
+      std::vector<double> u(count), v(count);
+      for (int k = 0; k < 100; ++k)
+      {
+        std::shared_ptr<const CameraSnapshot<double>> snapshot =
+            std::atomic_load(&published);
+        snapshot->ProjectN(x.data(), y.data(), z.data(), u.data(), v.data(),
+                           count);
+        const Eigen::Vector2d pix =
+            snapshot->Project(Eigen::Vector3d(x[7], y[7], z[7]));
+        consistent[t] += (pix[0] == u[7] && pix[1] == v[7]);
+      }
+    });
+  }
+
+  // Writer updates the camera and republishes while the readers run
+  for (int k = 0; k < 100; ++k)
+  {
+    camera->GetParams()[4] = 0.9 + 1E-3 * k;
+    std::atomic_store(&published, camera->Snapshot());
+  }
+
+  for (std::thread& reader : readers)
+  {
+    reader.join();
+  }
+  for (int n : consistent)
+  {
+    ASSERT_EQ(100, n);
+  }
+}
+
+} // namespace testing
+
+} // namespace calibu
@@ -0,0 +1,110 @@
+#include <gtest/gtest.h>
+#include <calibu/cam/camera_xml.h>
+#include <calibu/cam/camera_models_crtp.h>
+
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
+namespace calibu
+{
+namespace testing
+{
+
+std::shared_ptr<Rigd> CreateXmlRig(int num_cams, double f)
+{
+  std::shared_ptr<Rigd> rig(new Rigd());
+  for (int i = 0; i < num_cams; ++i)
+  {
+    std::shared_ptr<CameraInterfaced> cam =
+        CreateCameraModel("calibu_fu_fv_u0_v0_w");
+    Eigen::VectorXd params(5);
+    params << f + i, f + i, 320, 240, 0.9;
+    cam->SetParams(params);
+    cam->SetImageDimensions(640, 480);
+    cam->SetName("cam" + ValToStr(i));
+    cam->SetIndex(i);
+    cam->SetType("calibu_fu_fv_u0_v0_w");
+    cam->SetPose(Sophus::SE3d(Eigen::Quaterniond::Identity(),
+                              Eigen::Vector3d(0.1 * i, 0, 0)));
+    rig->AddCamera(cam);
+  }
+  return rig;
+}
+
+std::string WriteXmlRigs(const std::vector<std::shared_ptr<Rigd>>& rigs)
+{
+  std::ostringstream out;
+  out << "<?xml version=\"1.0\"?>\n<!-- <rig> in a comment -->\n<rigs>\n";
+  for (const std::shared_ptr<Rigd>& rig : rigs)
+  {
+    WriteXmlRig(out, rig, 4);
+  }
+  out << "</rigs>\n";
+  return out.str();
+}
+
+TEST(XmlRigReader, Stream)
+{
+  std::vector<std::shared_ptr<Rigd>> rigs;
+  rigs.push_back(CreateXmlRig(2, 300));
+  rigs.push_back(CreateXmlRig(1, 400));
+  rigs.push_back(CreateXmlRig(3, 500));
+
+  std::istringstream in(WriteXmlRigs(rigs));
+  XmlRigReader reader(in);
+  ASSERT_TRUE(reader.IsOpen());
+  for (const std::shared_ptr<Rigd>& expected : rigs)
+  {
+    std::shared_ptr<Rigd> rig = reader.Next();
+    ASSERT_TRUE(rig != nullptr);
+    ASSERT_EQ(expected->NumCams(), rig->NumCams());
+    for (size_t c = 0; c < rig->NumCams(); ++c)
+    {
+      ASSERT_EQ(expected->cameras_[c]->Name(), rig->cameras_[c]->Name());
+      ASSERT_EQ(expected->cameras_[c]->Width(), rig->cameras_[c]->Width());
+      ASSERT_TRUE(expected->cameras_[c]->GetParams().isApprox(
+                      rig->cameras_[c]->GetParams()));
+      ASSERT_TRUE(expected->cameras_[c]->Pose().translation().isApprox(
+                      rig->cameras_[c]->Pose().translation()));
+    }
+  }
+  ASSERT_TRUE(reader.Next() == nullptr);
+}
+
+TEST(XmlRigReader, Lazy)
+{
+  std::vector<std::shared_ptr<Rigd>> rigs;
+  rigs.push_back(CreateXmlRig(3, 300));
+  rigs.push_back(CreateXmlRig(2, 400));
+
+  const std::string filename = ::testing::TempDir() + "calibu_rigs_test.xml";
+  {
+    std::ofstream out(filename);
+    out << WriteXmlRigs(rigs);
+  }
+
+  XmlRigReader reader(filename);
+  ASSERT_TRUE(reader.IsOpen());
+
+  // Only decode the first camera of the first rig
+  ASSERT_TRUE(reader.NextRig());
+  std::shared_ptr<CameraInterfaced> cam = reader.NextCamera();
+  ASSERT_TRUE(cam != nullptr);
+  ASSERT_EQ("cam0", cam->Name());
+
+  ASSERT_TRUE(reader.NextRig());
+  ASSERT_DOUBLE_EQ(400, reader.NextCamera()->GetParams()[0]);
+  ASSERT_EQ("cam1", reader.NextCamera()->Name());
+  ASSERT_TRUE(reader.NextCamera() == nullptr);
+  ASSERT_FALSE(reader.NextRig());
+  std::remove(filename.c_str());
+
+  XmlRigReader missing(filename);
+  ASSERT_FALSE(missing.IsOpen());
+  ASSERT_TRUE(missing.Next() == nullptr);
+}
+
+} // namespace testing
+
+} // namespace calibu
@@ -0,0 +1,94 @@
+#include <gtest/gtest.h>
+#include <calibu/conics/ConicSet.h>
+#include <calibu/cam/camera_crtp_impl.h>
+#include <calibu/cam/camera_models_crtp.h>
+
+namespace calibu
+{
+namespace testing
+{
+
+// Axis aligned ellipse with semi axes rx, ry about center
+Conic SetEllipse(const Eigen::Vector2d& center, double rx, double ry)
+{
+  Conic c;
+  c.center = center;
+  c.center_undistorted = center.homogeneous();
+  c.radius = (rx + ry) / 2;
+  c.bbox = IRectangle(center[0] - rx, center[1] - ry,
+                      center[0] + rx, center[1] + ry);
+  const Eigen::Matrix3d S =
+      Eigen::Vector3d(1 / (rx * rx), 1 / (ry * ry), -1).asDiagonal();
+  Eigen::Matrix3d T = Eigen::Matrix3d::Identity();
+  T.topRightCorner<2, 1>() = -center;
+  c.C = T.transpose() * S * T;
+  c.Dual = c.C.inverse();
+  return c;
+}
+
+TEST(ConicSet, StoresConics)
+{
+  std::vector<Conic, Eigen::aligned_allocator<Conic>> conics;
+  for (int i = 0; i < 20; ++i)
+  {
+    conics.push_back(SetEllipse(Eigen::Vector2d(10 + 7.5 * i, 20 + 3.25 * i),
+                                3 + i % 4, 4 + i % 3));
+  }
+
+  const ConicSet set(conics);
+  ASSERT_EQ(conics.size(), set.size());
+  for (size_t i = 0; i < conics.size(); ++i)
+  {
+    const Conic c = set[i];
+    EXPECT_EQ(conics[i].center, set.Center(i));
+    EXPECT_EQ(conics[i].center, set.CentersData()[i]);
+    EXPECT_EQ(conics[i].center_undistorted, c.center_undistorted);
+    EXPECT_EQ(conics[i].radius, set.Radius(i));
+    EXPECT_EQ(conics[i].bbox.x1, set.BBox(i).x1);
+    EXPECT_EQ(conics[i].bbox.y2, set.BBox(i).y2);
+    EXPECT_LT((conics[i].C - c.C).norm(), 1E-12 * c.C.norm());
+
+    // The dual is normalised, its last column is the centre
+    const Eigen::Matrix3d D = conics[i].Dual / conics[i].Dual(2, 2);
+    EXPECT_LT((D - c.Dual).norm(), 1E-9 * D.norm());
+    EXPECT_LT((c.Dual.block<2, 1>(0, 2) - c.center).norm(), 1E-9);
+  }
+}
+
+TEST(ConicSet, UnmapConicsMatchesVector)
+{
+  Eigen::VectorXd params(8);
+  params << 300, 300, 320, 240, 0.1, 0.01, 0.001, 0.0001;
+  Eigen::Vector2i size(640, 480);
+  std::shared_ptr<CameraInterface<double>> cam =
+      std::make_shared<KannalaBrandtCamera<double>>(params, size);
+
+  std::vector<Conic, Eigen::aligned_allocator<Conic>> conics;
+  for (int i = 0; i < 40; ++i)
+  {
+    conics.push_back(SetEllipse(Eigen::Vector2d(20 + 14.5 * i, 30 + 10.5 * i),
+                                4 + i % 5, 5 + i % 3));
+  }
+  std::vector<Conic, Eigen::aligned_allocator<Conic>> expected;
+  UnmapConics(conics, cam, expected);
+
+  const ConicSet set(conics);
+  for (unsigned int threads : { 1u, 3u })
+  {
+    ConicSet unmapped;
+    UnmapConics(set, cam, unmapped, threads);
+    ASSERT_EQ(conics.size(), unmapped.size());
+    for (size_t i = 0; i < conics.size(); ++i)
+    {
+      ASSERT_LT((expected[i].center - unmapped.Center(i)).norm(), 1E-12);
+      const Eigen::Matrix3d C0 = expected[i].C / expected[i].C(2, 2);
+      const Eigen::Matrix3d C1 = unmapped.C(i) / unmapped.C(i)(2, 2);
+      ASSERT_LT((C0 - C1).norm(), 1E-9 * C0.norm());
+      ASSERT_EQ(conics[i].radius, unmapped.Radius(i));
+    }
+  }
+}
+
+} // namespace testing
+
+} // namespace calibu
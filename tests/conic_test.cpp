@@ -0,0 +1,60 @@
+#include <gtest/gtest.h>
+#include <calibu/conics/Conic.h>
+#include <calibu/cam/camera_crtp_impl.h>
+#include <calibu/cam/camera_models_crtp.h>
+
+namespace calibu
+{
+namespace testing
+{
+
+// Axis aligned ellipse with semi axes rx, ry about center
+Conic Ellipse(const Eigen::Vector2d& center, double rx, double ry)
+{
+  Conic c;
+  c.center = center;
+  c.bbox = IRectangle(center[0] - rx, center[1] - ry,
+                      center[0] + rx, center[1] + ry);
+  const Eigen::Matrix3d S =
+      Eigen::Vector3d(1 / (rx * rx), 1 / (ry * ry), -1).asDiagonal();
+  Eigen::Matrix3d T = Eigen::Matrix3d::Identity();
+  T.topRightCorner<2, 1>() = -center;
+  c.C = T.transpose() * S * T;
+  c.Dual = c.C.inverse();
+  return c;
+}
+
+TEST(Conic, UnmapConicsMatchesUnmapConic)
+{
+  Eigen::VectorXd params(8);
+  params << 300, 300, 320, 240, 0.1, 0.01, 0.001, 0.0001;
+  Eigen::Vector2i size(640, 480);
+  std::shared_ptr<CameraInterface<double>> cam =
+      std::make_shared<KannalaBrandtCamera<double>>(params, size);
+
+  std::vector<Conic, Eigen::aligned_allocator<Conic>> conics;
+  for (int i = 0; i < 40; ++i)
+  {
+    conics.push_back(Ellipse(Eigen::Vector2d(20 + 14.5 * i, 30 + 10.5 * i),
+                             4 + i % 5, 5 + i % 3));
+  }
+
+  for (unsigned int threads : { 1u, 3u })
+  {
+    std::vector<Conic, Eigen::aligned_allocator<Conic>> unmapped;
+    UnmapConics(conics, cam, unmapped, threads);
+    ASSERT_EQ(conics.size(), unmapped.size());
+    for (size_t i = 0; i < conics.size(); ++i)
+    {
+      const Conic expected = UnmapConic(conics[i], cam);
+      ASSERT_LT((expected.center - unmapped[i].center).norm(), 1E-12);
+      const Eigen::Matrix3d C0 = expected.C / expected.C(2, 2);
+      const Eigen::Matrix3d C1 = unmapped[i].C / unmapped[i].C(2, 2);
+      ASSERT_LT((C0 - C1).norm(), 1E-9 * C0.norm());
+    }
+  }
+}
+
+} // namespace testing
+
+} // namespace calibu
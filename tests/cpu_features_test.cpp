@@ -0,0 +1,49 @@
+#include <gtest/gtest.h>
+#include <calibu/CpuFeatures.h>
+
+namespace calibu
+{
+namespace testing
+{
+
+int Fallback() { return 0; }
+int Unsupported() { return 1; }
+int Supported() { return 2; }
+
+TEST(CpuFeatures, Detected)
+{
+  ASSERT_EQ(CpuFeatures(), CpuFeatures());
+  ASSERT_TRUE(CpuSupports(0));
+#if defined(__x86_64__) || defined(_M_X64)
+  ASSERT_TRUE(CpuSupports(CPU_FEATURE_SSE2));
+#endif
+#if defined(__aarch64__)
+  ASSERT_TRUE(CpuSupports(CPU_FEATURE_NEON));
+#endif
+  // Wider vectors imply the narrower ones
+  if (CpuSupports(CPU_FEATURE_AVX512F))
+  {
+    ASSERT_TRUE(CpuSupports(CPU_FEATURE_AVX2));
+  }
+  if (CpuSupports(CPU_FEATURE_AVX2))
+  {
+    ASSERT_TRUE(CpuSupports(CPU_FEATURE_AVX));
+  }
+}
+
+TEST(CpuFeatures, SelectKernel)
+{
+  typedef int (*Function)();
+  const unsigned int missing = ~CpuFeatures();
+
+  ASSERT_EQ(0, SelectKernel<Function>({{0, Fallback}})());
+  ASSERT_EQ(0, SelectKernel<Function>({{missing, Unsupported},
+                                       {0, Fallback}})());
+  ASSERT_EQ(2, SelectKernel<Function>({{missing, Unsupported},
+                                       {CpuFeatures(), Supported},
+                                       {0, Fallback}})());
+}
+
+} // namespace testing
+
+} // namespace calibu
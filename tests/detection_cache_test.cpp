@@ -0,0 +1,121 @@
+#include <gtest/gtest.h>
+#include <calibu/target/DetectionCache.h>
+
+#include <cstdio>
+#include <fstream>
+
+namespace calibu
+{
+namespace testing
+{
+
+DetectionCache CreateDetectionCache()
+{
+  DetectionCache cache;
+  cache.key = 0x1234567890abcdefULL;
+  cache.image_sizes.push_back(Eigen::Vector2i(640, 480));
+  cache.image_sizes.push_back(Eigen::Vector2i(752, 480));
+
+  for (int f = 0; f < 3; ++f)
+  {
+    CachedFrameDetection frame(2);
+    for (int c = 0; c < 2; ++c)
+    {
+      CachedCameraDetection& cam = frame[c];
+      cam.tracking_good = (f + c) % 2 == 0;
+      for (int i = 0; i < 5 * f + c; ++i)
+      {
+        cam.centers.push_back(Eigen::Vector2d(10.25 * i, 3.5 * f - c));
+        cam.target_map.push_back(i % 3 ? i : -1);
+        cam.grid.push_back(Eigen::Vector2i(i % 4, -i));
+      }
+    }
+    cache.frames.push_back(frame);
+  }
+  return cache;
+}
+
+TEST(DetectionCache, RoundTrip)
+{
+  const std::string filename = ::testing::TempDir() + "calibu_detections.bin";
+  const DetectionCache cache = CreateDetectionCache();
+  ASSERT_TRUE(cache.Save(filename));
+
+  DetectionCache read;
+  ASSERT_TRUE(read.Load(filename, cache.key));
+  ASSERT_EQ(cache.image_sizes, read.image_sizes);
+  ASSERT_EQ(cache.frames.size(), read.frames.size());
+  for (size_t f = 0; f < cache.frames.size(); ++f)
+  {
+    for (size_t c = 0; c < 2; ++c)
+    {
+      const CachedCameraDetection& a = cache.frames[f][c];
+      const CachedCameraDetection& b = read.frames[f][c];
+      ASSERT_EQ(a.tracking_good, b.tracking_good);
+      ASSERT_TRUE(a.centers == b.centers);
+      ASSERT_EQ(a.target_map, b.target_map);
+      ASSERT_EQ(a.grid, b.grid);
+    }
+  }
+
+  // Detections for other parameters are ignored
+  ASSERT_FALSE(read.Load(filename, cache.key + 1));
+  ASSERT_TRUE(read.frames.empty());
+  std::remove(filename.c_str());
+}
+
+TEST(DetectionCache, Rejects)
+{
+  const std::string filename = ::testing::TempDir() + "calibu_detections_bad.bin";
+  DetectionCache cache = CreateDetectionCache();
+
+  // Each frame must hold a detection for every camera
+  cache.frames[1].pop_back();
+  ASSERT_FALSE(cache.Save(filename));
+
+  cache = CreateDetectionCache();
+  ASSERT_TRUE(cache.Save(filename));
+  {
+    // Truncate the last detection
+    std::ifstream in(filename, std::ios::binary);
+    std::string data((std::istreambuf_iterator<char>(in)),
+                     std::istreambuf_iterator<char>());
+    in.close();
+    std::ofstream out(filename, std::ios::binary | std::ios::trunc);
+    out.write(data.data(), data.size() - 1);
+  }
+  DetectionCache read;
+  ASSERT_FALSE(read.Load(filename, cache.key));
+  std::remove(filename.c_str());
+
+  ASSERT_FALSE(read.Load(filename, cache.key));
+}
+
+TEST(DetectionCache, Hash)
+{
+  const ParamsImageProcessing image_params;
+  ParamsConicFinder conic_params;
+  const ParamsGridDot target_params;
+  const Eigen::Vector2i grid_size(19, 10);
+
+  const uint64_t key = DetectionCacheHash("video", image_params, conic_params,
+                                          target_params, 0.01, grid_size, 71);
+  ASSERT_EQ(key, DetectionCacheHash("video", image_params, conic_params,
+                                    target_params, 0.01, grid_size, 71));
+  ASSERT_NE(key, DetectionCacheHash("video2", image_params, conic_params,
+                                    target_params, 0.01, grid_size, 71));
+  ASSERT_NE(key, DetectionCacheHash("video", image_params, conic_params,
+                                    target_params, 0.01, grid_size, 72));
+
+  // Threads used don't change the detections
+  conic_params.num_threads = 4;
+  ASSERT_EQ(key, DetectionCacheHash("video", image_params, conic_params,
+                                    target_params, 0.01, grid_size, 71));
+  conic_params.method = CONIC_FINDER_LABELS;
+  ASSERT_NE(key, DetectionCacheHash("video", image_params, conic_params,
+                                    target_params, 0.01, grid_size, 71));
+}
+
+} // namespace testing
+
+} // namespace calibu
@@ -0,0 +1,128 @@
+#include <gtest/gtest.h>
+#include <calibu/conics/FindConics.h>
+#include <calibu/image/Gradient.h>
+
+#include <vector>
+
+namespace calibu
+{
+namespace testing
+{
+
+TEST(FindConics, ThreadsMatchSerial)
+{
+  // Grid of dark discs of radius 5, offset from the pixel grid
+  const int cols = 12;
+  const int rows = 8;
+  const int spacing = 20;
+  const int w = cols * spacing;
+  const int h = rows * spacing;
+
+  std::vector<Eigen::Vector2d> centers;
+  std::vector<PixelClass> candidates;
+  std::vector<unsigned char> image(w * h, 255);
+  for (int j = 0; j < rows; ++j)
+  {
+    for (int i = 0; i < cols; ++i)
+    {
+      const Eigen::Vector2d center(spacing * (i + 0.5) + 0.1 * (i % 5),
+                                   spacing * (j + 0.5) - 0.07 * (j % 3));
+      for (int y = spacing * j; y < spacing * (j + 1); ++y)
+      {
+        for (int x = spacing * i; x < spacing * (i + 1); ++x)
+        {
+          const double r = (Eigen::Vector2d(x, y) - center).norm();
+          image[y * w + x] = (unsigned char)(255 * std::min(1.0, std::max(0.0, r - 4.5)));
+        }
+      }
+
+      PixelClass candidate;
+      candidate.bbox = IRectangle(spacing * i + 2, spacing * j + 2,
+                                  spacing * (i + 1) - 3, spacing * (j + 1) - 3);
+      candidate.equiv = -1;
+      candidate.size = 0;
+      candidates.push_back(candidate);
+      centers.push_back(center);
+    }
+  }
+
+  std::vector<int16_t> dx(w * h);
+  std::vector<int16_t> dy(w * h);
+  GradientPlanar(w, h, w, image.data(), dx.data(), dy.data());
+
+  std::vector<Conic, Eigen::aligned_allocator<Conic> > serial;
+  FindConics(w, h, candidates, dx.data(), dy.data(), serial);
+  ASSERT_EQ(candidates.size(), serial.size());
+  for (size_t i = 0; i < serial.size(); ++i)
+  {
+    ASSERT_NEAR(centers[i][0], serial[i].center[0], 0.05);
+    ASSERT_NEAR(centers[i][1], serial[i].center[1], 0.05);
+  }
+
+  const unsigned int threads[] = { 0, 2, 5 };
+  for (unsigned int num_threads : threads)
+  {
+    std::vector<Conic, Eigen::aligned_allocator<Conic> > parallel;
+    FindConics(w, h, candidates, dx.data(), dy.data(), parallel, num_threads);
+    ASSERT_EQ(serial.size(), parallel.size());
+    for (size_t i = 0; i < serial.size(); ++i)
+    {
+      ASSERT_EQ(serial[i].C, parallel[i].C) << "threads " << num_threads;
+    }
+  }
+}
+
+TEST(FindConics, ConicFromMoments)
+{
+  // Moments of the pixels of a filled, rotated ellipse
+  const Eigen::Vector2d center(40.3, 31.7);
+  const double a = 12, b = 7, angle = 0.4;
+  Eigen::Matrix2d R;
+  R << std::cos(angle), -std::sin(angle), std::sin(angle), std::cos(angle);
+  const Eigen::Matrix2d A = R * Eigen::Vector2d(1 / (a * a), 1 / (b * b)).asDiagonal() * R.transpose();
+
+  double n = 0, sx = 0, sy = 0, sxx = 0, sxy = 0, syy = 0;
+  IRectangle bbox(80, 80, 0, 0);
+  for (int y = 0; y < 80; ++y)
+  {
+    for (int x = 0; x < 80; ++x)
+    {
+      const Eigen::Vector2d d = Eigen::Vector2d(x, y) - center;
+      if (d.dot(A * d) <= 1)
+      {
+        n += 1; sx += x; sy += y; sxx += x * x; sxy += x * y; syy += y * y;
+        bbox.x1 = std::min(bbox.x1, x); bbox.y1 = std::min(bbox.y1, y);
+        bbox.x2 = std::max(bbox.x2, x); bbox.y2 = std::max(bbox.y2, y);
+      }
+    }
+  }
+  BlobMoments moments;
+  moments.cx = sx / n;
+  moments.cy = sy / n;
+  moments.cxx = sxx / n - moments.cx * moments.cx;
+  moments.cxy = sxy / n - moments.cx * moments.cy;
+  moments.cyy = syy / n - moments.cy * moments.cy;
+
+  Conic conic;
+  ASSERT_TRUE(ConicFromMoments(moments, bbox, conic));
+  EXPECT_NEAR(center[0], conic.center[0], 0.05);
+  EXPECT_NEAR(center[1], conic.center[1], 0.05);
+  EXPECT_NEAR(center[0], conic.Dual(0, 2), 0.05);
+
+  // Points on the ellipse are within a few percent of the conic's radius
+  const Eigen::Matrix2d A_fit = conic.C.topLeftCorner<2, 2>();
+  for (int i = 0; i < 16; ++i)
+  {
+    const double t = 2 * M_PI * i / 16;
+    const Eigen::Vector2d d = center + R * Eigen::Vector2d(a * std::cos(t), b * std::sin(t)) - conic.center;
+    EXPECT_NEAR(1.0, std::sqrt(d.dot(A_fit * d)), 0.05);
+  }
+
+  // A line of pixels has no ellipse
+  moments.cyy = moments.cxy = 0;
+  EXPECT_FALSE(ConicFromMoments(moments, bbox, conic));
+}
+
+} // namespace testing
+
+} // namespace calibu
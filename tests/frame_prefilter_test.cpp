@@ -0,0 +1,124 @@
+#include <gtest/gtest.h>
+#include <calibu/image/FramePrefilter.h>
+
+#include <random>
+#include <vector>
+
+namespace calibu
+{
+namespace testing
+{
+
+// Checkerboard of square pixel squares, shifted right by offset pixels
+std::vector<unsigned char> Checkerboard(int w, int h, int square, int offset)
+{
+  std::vector<unsigned char> image(w * h);
+  for (int y = 0; y < h; ++y)
+  {
+    for (int x = 0; x < w; ++x)
+    {
+      image[y * w + x] = (((x + offset) / square + y / square) % 2) ? 220 : 30;
+    }
+  }
+  return image;
+}
+
+// Horizontal box blur of the given radius, as from motion
+std::vector<unsigned char> MotionBlur(const std::vector<unsigned char>& image,
+                                      int w, int h, int radius)
+{
+  std::vector<unsigned char> blurred(image.size());
+  for (int y = 0; y < h; ++y)
+  {
+    for (int x = 0; x < w; ++x)
+    {
+      int sum = 0;
+      for (int dx = -radius; dx <= radius; ++dx)
+      {
+        sum += image[y * w + std::min(w - 1, std::max(0, x + dx))];
+      }
+      blurred[y * w + x] = sum / (2 * radius + 1);
+    }
+  }
+  return blurred;
+}
+
+TEST(FramePrefilter, SharpnessDropsWithBlur)
+{
+  const int w = 160, h = 120;
+  const std::vector<unsigned char> sharp = Checkerboard(w, h, 10, 0);
+  FramePrefilter prefilter;
+  const PrefilterImage view = {sharp.data(), (size_t)w, (size_t)h, (size_t)w};
+  const double sharpness = prefilter.Sharpness(view);
+
+  double last = sharpness;
+  for (int radius : {2, 4, 8})
+  {
+    const std::vector<unsigned char> blurred = MotionBlur(sharp, w, h, radius);
+    const PrefilterImage blurred_view = {blurred.data(), (size_t)w, (size_t)h,
+                                         (size_t)w};
+    const double blurred_sharpness = prefilter.Sharpness(blurred_view);
+    ASSERT_LT(blurred_sharpness, 0.7 * last);
+    last = blurred_sharpness;
+  }
+
+  const std::vector<unsigned char> flat(w * h, 128);
+  const PrefilterImage flat_view = {flat.data(), (size_t)w, (size_t)h,
+                                    (size_t)w};
+  ASSERT_DOUBLE_EQ(0, prefilter.Sharpness(flat_view));
+}
+
+TEST(FramePrefilter, SkipsBlurredAndDuplicateFrames)
+{
+  const int w = 160, h = 120;
+  FramePrefilter prefilter;
+  prefilter.Params().min_difference = 15;
+
+  const std::vector<unsigned char> first = Checkerboard(w, h, 20, 0);
+  prefilter.Params().min_sharpness =
+      0.5 * prefilter.Sharpness({first.data(), (size_t)w, (size_t)h, (size_t)w});
+
+  ASSERT_TRUE(prefilter.Accept(first.data(), w, h, w));
+
+  // Moved by a pixel: nearly the same
+  const std::vector<unsigned char> nudged = Checkerboard(w, h, 20, 1);
+  ASSERT_FALSE(prefilter.Accept(nudged.data(), w, h, w));
+  ASSERT_LT(prefilter.LastDifference(0), 15);
+
+  // Moved by half a square, but blurred
+  const std::vector<unsigned char> moved = Checkerboard(w, h, 20, 10);
+  const std::vector<unsigned char> blurred = MotionBlur(moved, w, h, 6);
+  ASSERT_FALSE(prefilter.Accept(blurred.data(), w, h, w));
+
+  ASSERT_TRUE(prefilter.Accept(moved.data(), w, h, w));
+  ASSERT_GE(prefilter.LastDifference(0), 15);
+
+  // Compared against the last frame kept
+  ASSERT_FALSE(prefilter.Accept(moved.data(), w, h, w));
+
+  ASSERT_EQ(2u, prefilter.NumAccepted());
+  ASSERT_EQ(1u, prefilter.NumBlurred());
+  ASSERT_EQ(2u, prefilter.NumDuplicates());
+}
+
+TEST(FramePrefilter, RigFrameKeptIfAnyImageChanges)
+{
+  const int w = 64, h = 48;
+  FramePrefilter prefilter;
+  prefilter.Params().min_difference = 5;
+
+  const std::vector<unsigned char> a = Checkerboard(w, h, 8, 0);
+  const std::vector<unsigned char> b = Checkerboard(w, h, 8, 4);
+  const PrefilterImage same[2] = {{a.data(), (size_t)w, (size_t)h, (size_t)w},
+                                  {a.data(), (size_t)w, (size_t)h, (size_t)w}};
+  const PrefilterImage changed[2] = {{a.data(), (size_t)w, (size_t)h, (size_t)w},
+                                     {b.data(), (size_t)w, (size_t)h, (size_t)w}};
+
+  ASSERT_TRUE(prefilter.Accept(same, 2));
+  ASSERT_FALSE(prefilter.Accept(same, 2));
+  ASSERT_TRUE(prefilter.Accept(changed, 2));
+}
+
+} // namespace testing
+
+} // namespace calibu
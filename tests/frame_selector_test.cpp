@@ -0,0 +1,115 @@
+#include <gtest/gtest.h>
+#include <calibu/calib/FrameSelector.h>
+
+namespace calibu
+{
+namespace testing
+{
+
+Sophus::SE3d Pose(double angle, double x)
+{
+  const Sophus::SO3d R = Sophus::SO3d::exp(Eigen::Vector3d(0, angle, 0));
+  return Sophus::SE3d(R, Eigen::Vector3d(x, 0, 0));
+}
+
+TEST(FrameSelector, Motion)
+{
+  MotionFrameSelector selector(0.1, 0.05);
+  const std::vector<FramePoints> p_c(1);
+
+  ASSERT_TRUE(selector.IsInformative(Pose(0, 0), p_c));
+  selector.Add(Pose(0, 0), p_c);
+
+  ASSERT_FALSE(selector.IsInformative(Pose(0.05, 0.01), p_c));
+  ASSERT_TRUE(selector.IsInformative(Pose(0.2, 0.0), p_c));
+  ASSERT_TRUE(selector.IsInformative(Pose(0.0, 0.1), p_c));
+
+  selector.Add(Pose(0.2, 0.0), p_c);
+  ASSERT_FALSE(selector.IsInformative(Pose(0.25, 0.0), p_c));
+
+  selector.Clear();
+  ASSERT_TRUE(selector.IsInformative(Pose(0.05, 0.01), p_c));
+}
+
+TEST(FrameSelector, Coverage)
+{
+  const std::vector<Eigen::Vector2i> sizes(2, Eigen::Vector2i(640, 480));
+  CoverageFrameSelector selector(sizes, 4, 4, 2);
+
+  std::vector<FramePoints> p_c(2);
+  p_c[0].push_back(Eigen::Vector2d(10, 10));
+  p_c[0].push_back(Eigen::Vector2d(20, 20));
+  ASSERT_FALSE(selector.IsInformative(Sophus::SE3d(), p_c));
+
+  p_c[1].push_back(Eigen::Vector2d(630, 470));
+  ASSERT_TRUE(selector.IsInformative(Sophus::SE3d(), p_c));
+  selector.Add(Sophus::SE3d(), p_c);
+  ASSERT_FALSE(selector.IsInformative(Sophus::SE3d(), p_c));
+
+  // points outside the image are ignored
+  p_c[0].push_back(Eigen::Vector2d(-5, 100));
+  p_c[0].push_back(Eigen::Vector2d(300, 500));
+  p_c[0].push_back(Eigen::Vector2d(300, 300));
+  ASSERT_FALSE(selector.IsInformative(Sophus::SE3d(), p_c));
+  p_c[1].push_back(Eigen::Vector2d(10, 10));
+  ASSERT_TRUE(selector.IsInformative(Sophus::SE3d(), p_c));
+}
+
+TEST(FrameSelector, CoverageSaturates)
+{
+  const std::vector<Eigen::Vector2i> sizes(1, Eigen::Vector2i(640, 480));
+  CoverageFrameSelector strict(sizes, 2, 2, 2);
+  CoverageFrameSelector lenient(sizes, 2, 2, 2, true);
+
+  std::vector<FramePoints> p_c(1);
+  p_c[0].push_back(Eigen::Vector2d(10, 10));
+  p_c[0].push_back(Eigen::Vector2d(600, 10));
+  strict.Add(Sophus::SE3d(), p_c);
+  lenient.Add(Sophus::SE3d(), p_c);
+  ASSERT_FALSE(strict.IsCovered());
+  ASSERT_FALSE(lenient.IsInformative(Sophus::SE3d(), p_c));
+
+  // one uncovered cell can never supply two new ones
+  p_c[0][0] = Eigen::Vector2d(10, 400);
+  strict.Add(Sophus::SE3d(), p_c);
+  lenient.Add(Sophus::SE3d(), p_c);
+  ASSERT_TRUE(strict.IsCovered());
+
+  p_c[0][0] = Eigen::Vector2d(600, 400);
+  ASSERT_FALSE(strict.IsInformative(Sophus::SE3d(), p_c));
+  ASSERT_TRUE(lenient.IsInformative(Sophus::SE3d(), p_c));
+
+  lenient.Clear();
+  ASSERT_FALSE(lenient.IsCovered());
+  ASSERT_FALSE(lenient.IsInformative(Sophus::SE3d(),
+                                     std::vector<FramePoints>(1)));
+}
+
+TEST(FrameSelector, Any)
+{
+  std::shared_ptr<FrameSelector> motion =
+      std::make_shared<MotionFrameSelector>(0.1, 0.05);
+  const std::vector<Eigen::Vector2i> sizes(1, Eigen::Vector2i(640, 480));
+  std::shared_ptr<FrameSelector> coverage =
+      std::make_shared<CoverageFrameSelector>(sizes, 2, 2, 1);
+
+  AnyFrameSelector selector({ motion, coverage });
+
+  std::vector<FramePoints> p_c(1);
+  p_c[0].push_back(Eigen::Vector2d(10, 10));
+  selector.Add(Pose(0, 0), p_c);
+  ASSERT_FALSE(motion->IsInformative(Pose(0, 0), p_c));
+  ASSERT_FALSE(coverage->IsInformative(Pose(0, 0), p_c));
+  ASSERT_FALSE(selector.IsInformative(Pose(0, 0), p_c));
+
+  ASSERT_TRUE(selector.IsInformative(Pose(0.5, 0), p_c));
+  p_c[0][0] = Eigen::Vector2d(600, 400);
+  ASSERT_TRUE(selector.IsInformative(Pose(0, 0), p_c));
+
+  selector.Clear();
+  ASSERT_TRUE(motion->IsInformative(Pose(0, 0), p_c));
+}
+
+} // namespace testing
+
+} // namespace calibu
@@ -0,0 +1,135 @@
+#include <gtest/gtest.h>
+#include <calibu/utils/Utils.h>
+
+#include <random>
+
+namespace calibu
+{
+namespace testing
+{
+
+typedef std::vector<Eigen::Vector2d, Eigen::aligned_allocator<Eigen::Vector2d>>
+    Points;
+
+Eigen::Matrix3d TestHomography()
+{
+  Eigen::Matrix3d H;
+  H << 410.0, -35.0, 320.0,
+       20.0, 395.0, 240.0,
+       0.05, -0.08, 1.0;
+  return H;
+}
+
+// Target points in metres a, and their images b under H_ba in pixels
+void CreatePoints(const Eigen::Matrix3d& H_ba, int n, double noise,
+                  Points& a, Points& b, std::mt19937& rng)
+{
+  std::uniform_real_distribution<double> uniform(-0.5, 0.5);
+  std::normal_distribution<double> gaussian(0.0, noise > 0 ? noise : 1.0);
+  a.clear();
+  b.clear();
+  for (int i = 0; i < n; ++i)
+  {
+    const Eigen::Vector2d p(uniform(rng), uniform(rng));
+    Eigen::Vector2d q = (H_ba * p.homogeneous()).hnormalized();
+    if (noise > 0)
+    {
+      q += Eigen::Vector2d(gaussian(rng), gaussian(rng));
+    }
+    a.push_back(p);
+    b.push_back(q);
+  }
+}
+
+double MaxTransferError(const Eigen::Matrix3d& H_ba, const Points& a,
+                        const Points& b)
+{
+  double max_error = 0;
+  for (size_t i = 0; i < a.size(); ++i)
+  {
+    const Eigen::Vector2d q = (H_ba * a[i].homogeneous()).hnormalized();
+    max_error = std::max(max_error, (q - b[i]).norm());
+  }
+  return max_error;
+}
+
+TEST(Homography, Exact)
+{
+  std::mt19937 rng(1);
+  Points a, b;
+  const Eigen::Matrix3d H = TestHomography();
+
+  for (int n : { 4, 5, 50 })
+  {
+    CreatePoints(H, n, 0, a, b, rng);
+    const Eigen::Matrix3d H_ba = EstimateH_ba(a, b);
+    ASSERT_LT((H_ba - H).norm() / H.norm(), 1E-9);
+    ASSERT_TRUE(H_ba == EstimateH_ba(a.data(), b.data(), a.size()));
+  }
+}
+
+TEST(Homography, Noise)
+{
+  // Far from the origin and at a different scale than the target points,
+  // which the unnormalised DLT handles poorly
+  std::mt19937 rng(2);
+  Eigen::Matrix3d H = TestHomography();
+  H.row(0) += 5000 * H.row(2);
+  H.row(1) += 3000 * H.row(2);
+
+  Points a, b;
+  CreatePoints(H, 100, 0.2, a, b, rng);
+  const Eigen::Matrix3d H_ba = EstimateH_ba(a, b);
+  ASSERT_LT(MaxTransferError(H_ba, a, b), 1.5);
+}
+
+TEST(Homography, Batch)
+{
+  std::mt19937 rng(3);
+  std::vector<Points> a(7), b(7);
+  for (size_t f = 0; f < a.size(); ++f)
+  {
+    Eigen::Matrix3d H = TestHomography();
+    H(0, 2) += 10.0 * f;
+    CreatePoints(H, 20 + f, 0.1, a[f], b[f], rng);
+  }
+
+  for (unsigned int threads : { 1u, 3u })
+  {
+    const std::vector<Eigen::Matrix3d> H_ba = EstimateH_baBatch(a, b, threads);
+    ASSERT_EQ(a.size(), H_ba.size());
+    for (size_t f = 0; f < a.size(); ++f)
+    {
+      ASSERT_TRUE(H_ba[f] == EstimateH_ba(a[f], b[f]));
+    }
+  }
+}
+
+TEST(Homography, Ransac)
+{
+  std::mt19937 rng(4);
+  std::uniform_real_distribution<double> uniform(0, 640);
+  const Eigen::Matrix3d H = TestHomography();
+
+  // Every fourth image point is replaced by an outlier
+  Points a, b;
+  CreatePoints(H, 200, 0, a, b, rng);
+  for (size_t i = 0; i < b.size(); i += 4)
+  {
+    b[i] = Eigen::Vector2d(uniform(rng), uniform(rng));
+  }
+
+  std::vector<int> inliers;
+  const Eigen::Matrix3d H_ba = EstimateH_baRansac(a, b, inliers, 1.0, 500, 20);
+  ASSERT_LT((H_ba - H).norm() / H.norm(), 1E-6);
+  ASSERT_EQ(150u, inliers.size());
+  for (int i : inliers) ASSERT_NE(0, i % 4);
+
+  // Too few inliers
+  ASSERT_TRUE(EstimateH_baRansac(a, b, inliers, 1.0, 500, 180).isZero());
+  ASSERT_TRUE(inliers.empty());
+}
+
+} // namespace testing
+
+} // namespace calibu
@@ -0,0 +1,164 @@
+#include <gtest/gtest.h>
+#include <calibu/conics/FindConics.h>
+#include <calibu/image/Gradient.h>
+#include <calibu/image/IntegralImage.h>
+
+#include <random>
+#include <vector>
+
+namespace calibu
+{
+namespace testing
+{
+
+const ImageKernel kernels[] =
+{
+  IMAGE_KERNEL_AUTO,
+  IMAGE_KERNEL_SCALAR,
+  IMAGE_KERNEL_SSE2,
+  IMAGE_KERNEL_AVX2,
+  IMAGE_KERNEL_NEON,
+};
+
+// Random image with row padding, so that kernels must respect the pitch
+std::vector<unsigned char> RandomImage(int pitch, int h, unsigned int seed)
+{
+  std::mt19937 rng(seed);
+  std::vector<unsigned char> image(pitch * h);
+  for (unsigned char& value : image) value = rng() % 256;
+  return image;
+}
+
+TEST(ImageKernel, GradientPlanar)
+{
+  const int sizes[][2] = { { 3, 3 }, { 17, 5 }, { 53, 21 }, { 64, 12 } };
+  for (const auto& size : sizes)
+  {
+    const int w = size[0];
+    const int h = size[1];
+    const int pitch = w + 5;
+    const std::vector<unsigned char> image = RandomImage(pitch, h, w);
+
+    std::vector<Eigen::Vector2f> expected(w * h, Eigen::Vector2f::Zero());
+    gradient(w, h, (size_t)pitch, image.data(), expected.data());
+
+    for (ImageKernel kernel : kernels)
+    {
+      std::vector<int16_t> dx(w * h, 99);
+      std::vector<int16_t> dy(w * h, 99);
+      GradientPlanar(w, h, pitch, image.data(), dx.data(), dy.data(), kernel);
+
+      for (int i = 0; i < w * h; ++i)
+      {
+        ASSERT_EQ(expected[i][0], dx[i]) << "kernel " << kernel;
+        ASSERT_EQ(expected[i][1], dy[i]) << "kernel " << kernel;
+      }
+    }
+  }
+}
+
+TEST(ImageKernel, GradientPlanarStride)
+{
+  // Gradient of a region, written into the same region of a larger image
+  const int w = 50;
+  const int h = 20;
+  const std::vector<unsigned char> image = RandomImage(w, h, 5);
+
+  std::vector<int16_t> dx(w * h);
+  std::vector<int16_t> dy(w * h);
+  GradientPlanar(w, h, w, image.data(), dx.data(), dy.data());
+
+  const int x1 = 7, y1 = 4, rw = 30, rh = 10;
+  std::vector<int16_t> region_dx(w * h, 99);
+  std::vector<int16_t> region_dy(w * h, 99);
+  GradientPlanar(rw, rh, w, image.data() + y1 * w + x1,
+                 region_dx.data() + y1 * w + x1,
+                 region_dy.data() + y1 * w + x1, w);
+
+  for (int y = 0; y < h; ++y)
+  {
+    for (int x = 0; x < w; ++x)
+    {
+      const int i = y * w + x;
+      if (x <= x1 || x >= x1 + rw - 1 || y <= y1 || y >= y1 + rh - 1)
+      {
+        // Untouched outside the region, zero on its border
+        const bool outside = x < x1 || x >= x1 + rw || y < y1 || y >= y1 + rh;
+        ASSERT_EQ(outside ? 99 : 0, region_dx[i]);
+        ASSERT_EQ(outside ? 99 : 0, region_dy[i]);
+      }
+      else
+      {
+        ASSERT_EQ(dx[i], region_dx[i]);
+        ASSERT_EQ(dy[i], region_dy[i]);
+      }
+    }
+  }
+}
+
+TEST(ImageKernel, IntegralImage)
+{
+  const int sizes[][2] = { { 1, 1 }, { 7, 3 }, { 53, 21 }, { 64, 12 } };
+  for (const auto& size : sizes)
+  {
+    const int w = size[0];
+    const int h = size[1];
+    const int pitch = w + 3;
+    const std::vector<unsigned char> image = RandomImage(pitch, h, h);
+
+    std::vector<uint32_t> expected(w * h);
+    integral_image(w, h, (size_t)pitch, image.data(), expected.data());
+
+    for (ImageKernel kernel : kernels)
+    {
+      std::vector<uint32_t> found(w * h);
+      IntegralImage(w, h, pitch, image.data(), found.data(), kernel);
+      ASSERT_EQ(expected, found) << "kernel " << kernel;
+    }
+  }
+}
+
+TEST(ImageKernel, FindEllipsePlanar)
+{
+  // Dark disc of radius 6 at (20.3, 15.6)
+  const int w = 40;
+  const int h = 32;
+  const Eigen::Vector2d center(20.3, 15.6);
+  std::vector<unsigned char> image(w * h);
+  for (int y = 0; y < h; ++y)
+  {
+    for (int x = 0; x < w; ++x)
+    {
+      const double r = (Eigen::Vector2d(x, y) - center).norm();
+      image[y * w + x] = (unsigned char)(255 * std::min(1.0, std::max(0.0, r - 5.5)));
+    }
+  }
+
+  std::vector<int16_t> dx(w * h);
+  std::vector<int16_t> dy(w * h);
+  GradientPlanar(w, h, w, image.data(), dx.data(), dy.data());
+
+  std::vector<Eigen::Vector2f> dI(w * h);
+  for (int i = 0; i < w * h; ++i) dI[i] = Eigen::Vector2f(dx[i], dy[i]);
+
+  IRectangle region;
+  region.x1 = 10;
+  region.y1 = 5;
+  region.x2 = 30;
+  region.y2 = 26;
+
+  double residual = 0;
+  const Eigen::Matrix3d expected = FindEllipse(w, h, dI.data(), region, residual);
+  const Eigen::Matrix3d found =
+      FindEllipse(w, h, dx.data(), dy.data(), region, residual);
+  ASSERT_LT((expected - found).norm(), 1E-9 * expected.norm());
+
+  Eigen::Matrix3d dual = found.inverse();
+  dual /= dual(2, 2);
+  ASSERT_NEAR(center[0], dual(0, 2), 0.05);
+  ASSERT_NEAR(center[1], dual(1, 2), 0.05);
+}
+
+} // namespace testing
+
+} // namespace calibu
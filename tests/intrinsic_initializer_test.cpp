@@ -0,0 +1,154 @@
+#include <gtest/gtest.h>
+#include <calibu/calib/IntrinsicInitializer.h>
+
+#include <memory>
+#include <type_traits>
+
+namespace calibu
+{
+namespace testing
+{
+
+typedef std::vector<Eigen::Vector3d, Eigen::aligned_allocator<Eigen::Vector3d>>
+    Points3d;
+typedef std::vector<Eigen::Vector2d, Eigen::aligned_allocator<Eigen::Vector2d>>
+    Points2d;
+
+// A 10 x 8 grid target seen by 'camera' from several tilted poses
+void CreateViews(const CameraInterface<double>& camera,
+                 std::vector<Points3d>& P_w, std::vector<Points2d>& p_c)
+{
+  const double angles[][2] = {
+    {0.0, 0.0}, {0.4, 0.0}, {-0.4, 0.1}, {0.1, 0.45}, {-0.2, -0.4}, {0.3, 0.3}
+  };
+  P_w.clear();
+  p_c.clear();
+  for (const double* angle : angles)
+  {
+    const Eigen::Matrix3d R =
+        (Eigen::AngleAxisd(angle[0], Eigen::Vector3d::UnitY()) *
+         Eigen::AngleAxisd(angle[1], Eigen::Vector3d::UnitX())).toRotationMatrix();
+    const Eigen::Vector3d t(-0.12, -0.09, 0.3);
+    P_w.push_back(Points3d());
+    p_c.push_back(Points2d());
+    for (int y = 0; y < 8; ++y)
+    {
+      for (int x = 0; x < 10; ++x)
+      {
+        const Eigen::Vector3d P(0.025 * x, 0.025 * y, 0);
+        P_w.back().push_back(P);
+        p_c.back().push_back(camera.Project(R * (P + t)));
+      }
+    }
+  }
+}
+
+Eigen::Matrix<double, 4, 1> TestIntrinsics()
+{
+  Eigen::Matrix<double, 4, 1> k;
+  k << 420, 410, 330, 235;
+  return k;
+}
+
+TEST(IntrinsicInitializer, Homographies)
+{
+  Eigen::VectorXd params(LinearCamera<double>::NumParams);
+  params << TestIntrinsics();
+  Eigen::Vector2i size(640, 480);
+  const std::shared_ptr<CameraInterface<double>> camera =
+      std::make_shared<LinearCamera<double>>(params, size);
+
+  std::vector<Points3d> P_w;
+  std::vector<Points2d> p_c;
+  CreateViews(*camera, P_w, p_c);
+
+  std::vector<Points2d> a(P_w.size());
+  for (size_t f = 0; f < P_w.size(); ++f)
+  {
+    for (const Eigen::Vector3d& P : P_w[f])
+    {
+      a[f].push_back(P.head<2>());
+    }
+  }
+
+  Eigen::Matrix3d K;
+  ASSERT_TRUE(EstimateKFromHomographies(EstimateH_baBatch(a, p_c), 640, 480, K));
+  ASSERT_LT((K - camera->K()).norm(), 1e-6);
+
+  // Two views fix the principal point at the centre
+  const std::vector<Eigen::Matrix3d> H =
+      EstimateH_baBatch(std::vector<Points2d>(a.begin(), a.begin() + 2),
+                        std::vector<Points2d>(p_c.begin(), p_c.begin() + 2));
+  ASSERT_TRUE(EstimateKFromHomographies(H, 640, 480, K));
+  ASSERT_EQ(320, K(0,2));
+  ASSERT_EQ(240, K(1,2));
+  ASSERT_LT(std::abs(K(0,0) - 420) / 420, 0.1);
+
+  ASSERT_FALSE(EstimateKFromHomographies(std::vector<Eigen::Matrix3d>(), 640, 480, K));
+}
+
+template<typename Camera>
+void ExpectInitialized(const Eigen::VectorXd& truth, double max_pixel_error)
+{
+  Eigen::Vector2i size(640, 480);
+  const std::shared_ptr<CameraInterface<double>> camera =
+      std::make_shared<Camera>(truth, size);
+
+  std::vector<Points3d> P_w;
+  std::vector<Points2d> p_c;
+  CreateViews(*camera, P_w, p_c);
+
+  Eigen::VectorXd start = Eigen::VectorXd::Zero(truth.size());
+  start.head<4>() << 300, 300, 320, 240;
+  if (std::is_same<Camera, FovCamera<double>>::value)
+  {
+    start[4] = 0.2;
+  }
+  const std::shared_ptr<CameraInterface<double>> init =
+      std::make_shared<Camera>(start, size);
+
+  IntrinsicInitializerOptions options;
+  options.num_threads = 3;
+  ASSERT_TRUE(InitializeIntrinsics(*init, P_w, p_c, options));
+
+  // Close enough to the truth that reprojection is all but right
+  const Eigen::VectorXd k = init->GetParams().head<4>() - truth.head<4>();
+  ASSERT_LT(k.norm(), 0.05 * 420);
+  for (const Eigen::Vector2d& p : p_c[1])
+  {
+    const Eigen::Vector2d q = init->Project(camera->Unproject(p));
+    ASSERT_LT((q - p).norm(), max_pixel_error);
+  }
+}
+
+TEST(IntrinsicInitializer, Models)
+{
+  Eigen::VectorXd poly3(Poly3Camera<double>::NumParams);
+  poly3 << TestIntrinsics(), -0.2, 0.05, -0.005;
+  ExpectInitialized<Poly3Camera<double>>(poly3, 2.0);
+
+  Eigen::VectorXd kb4(KannalaBrandtCamera<double>::NumParams);
+  kb4 << TestIntrinsics(), 0.02, -0.01, 0.005, -0.001;
+  ExpectInitialized<KannalaBrandtCamera<double>>(kb4, 2.0);
+
+  Eigen::VectorXd fov(FovCamera<double>::NumParams);
+  fov << TestIntrinsics(), 0.8;
+  ExpectInitialized<FovCamera<double>>(fov, 2.0);
+}
+
+TEST(IntrinsicInitializer, TooFewPoints)
+{
+  Eigen::VectorXd params(FovCamera<double>::NumParams);
+  params << 300, 300, 320, 240, 0.2;
+  Eigen::Vector2i size(640, 480);
+  FovCamera<double> camera(params, size);
+
+  std::vector<Points3d> P_w(3, Points3d(5, Eigen::Vector3d::Zero()));
+  std::vector<Points2d> p_c(3, Points2d(5, Eigen::Vector2d::Zero()));
+  ASSERT_FALSE(InitializeIntrinsics(camera, P_w, p_c));
+  ASSERT_TRUE(camera.GetParams() == params);
+}
+
+} // namespace testing
+
+} // namespace calibu
@@ -0,0 +1,63 @@
+#include <gtest/gtest.h>
+#include <calibu/utils/KdTree.h>
+
+#include <random>
+
+namespace calibu
+{
+namespace testing
+{
+
+TEST(KdTree, MatchesBruteForce)
+{
+  std::mt19937 rng(11);
+  std::uniform_real_distribution<double> uniform(-1.0, 1.0);
+
+  // Points on a plane, as unprojected conic centres, some coincident
+  std::vector<Eigen::Vector3d, Eigen::aligned_allocator<Eigen::Vector3d> > pts;
+  for (int i = 0; i < 500; ++i)
+  {
+    pts.push_back(Eigen::Vector3d(uniform(rng), uniform(rng), 1.0));
+  }
+  for (int i = 0; i < 20; ++i)
+  {
+    pts.push_back(pts[i * 7]);
+  }
+
+  KdTree<3> tree;
+  tree.Build(pts.size(), [&pts](size_t i) { return pts[i]; });
+  ASSERT_EQ(pts.size(), tree.Size());
+
+  const size_t ks[] = { 1, 2, 14, 600 };
+  std::vector<KdTree<3>::Neighbour> found;
+  for (size_t k : ks)
+  {
+    for (size_t q = 0; q < pts.size(); q += 3)
+    {
+      std::vector<KdTree<3>::Neighbour> expected;
+      for (size_t i = 0; i < pts.size(); ++i)
+      {
+        expected.push_back(KdTree<3>::Neighbour((pts[q] - pts[i]).squaredNorm(), i));
+      }
+      std::sort(expected.begin(), expected.end());
+      expected.resize(std::min(k, pts.size()));
+
+      tree.Knn(pts[q], k, found);
+      ASSERT_EQ(expected, found) << "k " << k << " query " << q;
+    }
+  }
+}
+
+TEST(KdTree, Empty)
+{
+  KdTree<2> tree;
+  tree.Build(0, [](size_t) { return Eigen::Vector2d::Zero(); });
+
+  std::vector<KdTree<2>::Neighbour> found(3);
+  tree.Knn(Eigen::Vector2d::Zero(), 5, found);
+  ASSERT_TRUE(found.empty());
+}
+
+} // namespace testing
+
+} // namespace calibu
@@ -0,0 +1,156 @@
+#include <gtest/gtest.h>
+#include <calibu/image/Label.h>
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+namespace calibu
+{
+namespace testing
+{
+
+// Components of pixels equal to passval within region, by flood fill, in
+// raster order of their first pixel.
+std::vector<PixelClass> FloodFillLabels(int w, int h,
+                                        const std::vector<unsigned char>& image,
+                                        const IRectangle& region,
+                                        unsigned char passval)
+{
+  std::vector<PixelClass> labels;
+  std::vector<bool> visited(w * h, false);
+  std::vector<int> stack;
+  for (int y = region.y1; y <= region.y2; ++y)
+  {
+    for (int x = region.x1; x <= region.x2; ++x)
+    {
+      if (visited[y * w + x] || image[y * w + x] != passval)
+      {
+        continue;
+      }
+      PixelClass pc = { -1, IRectangle(x, y, x, y), 0 };
+      visited[y * w + x] = true;
+      stack.push_back(y * w + x);
+      while (!stack.empty())
+      {
+        const int i = stack.back();
+        stack.pop_back();
+        const int px = i % w;
+        const int py = i / w;
+        pc.bbox.Insert(px, py);
+        ++pc.size;
+        for (int ny = std::max(region.y1, py - 1); ny <= std::min(region.y2, py + 1); ++ny)
+        {
+          for (int nx = std::max(region.x1, px - 1); nx <= std::min(region.x2, px + 1); ++nx)
+          {
+            const int n = ny * w + nx;
+            if (!visited[n] && image[n] == passval)
+            {
+              visited[n] = true;
+              stack.push_back(n);
+            }
+          }
+        }
+      }
+      labels.push_back(pc);
+    }
+  }
+  return labels;
+}
+
+void ExpectSameLabels(const std::vector<PixelClass>& expected,
+                      const std::vector<PixelClass>& labels)
+{
+  ASSERT_EQ(expected.size(), labels.size());
+  for (size_t i = 0; i < labels.size(); ++i)
+  {
+    ASSERT_EQ(-1, labels[i].equiv);
+    ASSERT_EQ(expected[i].size, labels[i].size);
+    ASSERT_EQ(expected[i].bbox.x1, labels[i].bbox.x1);
+    ASSERT_EQ(expected[i].bbox.y1, labels[i].bbox.y1);
+    ASSERT_EQ(expected[i].bbox.x2, labels[i].bbox.x2);
+    ASSERT_EQ(expected[i].bbox.y2, labels[i].bbox.y2);
+  }
+}
+
+TEST(Label, MatchesFloodFill)
+{
+  const int w = 173;
+  const int h = 131;
+  std::mt19937 rng(7);
+  std::bernoulli_distribution dark(0.45);
+  std::vector<unsigned char> image(w * h);
+  for (unsigned char& pixel : image)
+  {
+    pixel = dark(rng) ? 0 : 255;
+  }
+
+  const IRectangle full(0, 0, w - 1, h - 1);
+  const IRectangle region(11, 7, 150, 120);
+  LabelWorkspace workspace;
+  std::vector<PixelClass> labels;
+  for (const IRectangle& r : { full, region })
+  {
+    const std::vector<PixelClass> expected = FloodFillLabels(w, h, image, r, 0);
+    for (unsigned int threads : { 1u, 2u, 5u, 16u })
+    {
+      Label(w, h, w, image.data(), r, 0, labels, workspace, threads);
+      ExpectSameLabels(expected, labels);
+    }
+  }
+}
+
+TEST(Label, SpiralAcrossBands)
+{
+  // One component winding through every band of rows
+  const int w = 64;
+  const int h = 64;
+  std::vector<unsigned char> image(w * h, 255);
+  for (int y = 0; y < h; y += 4)
+  {
+    for (int x = 1; x < w - 1; ++x)
+    {
+      image[y * w + x] = 0;
+    }
+    for (int y2 = y; y2 < std::min(h, y + 4); ++y2)
+    {
+      image[y2 * w + ((y / 4) % 2 ? 1 : w - 2)] = 0;
+    }
+  }
+
+  LabelWorkspace workspace;
+  std::vector<PixelClass> labels;
+  Label(w, h, w, image.data(), IRectangle(0, 0, w - 1, h - 1), 0, labels,
+        workspace, 8);
+  ExpectSameLabels(
+      FloodFillLabels(w, h, image, IRectangle(0, 0, w - 1, h - 1), 0), labels);
+  ASSERT_EQ(1u, labels.size());
+}
+
+TEST(Label, ManyComponents)
+{
+  // Isolated pixels, more than a 16 bit label could count
+  const int w = 512;
+  const int h = 400;
+  std::vector<unsigned char> image(w * h, 255);
+  for (int y = 0; y < h; y += 2)
+  {
+    for (int x = 0; x < w; x += 2)
+    {
+      image[y * w + x] = 0;
+    }
+  }
+
+  LabelWorkspace workspace;
+  std::vector<PixelClass> labels;
+  Label(w, h, w, image.data(), IRectangle(0, 0, w - 1, h - 1), 0, labels,
+        workspace, 4);
+  ASSERT_EQ((size_t)(w / 2) * (h / 2), labels.size());
+  ASSERT_EQ(w - 2, labels.back().bbox.x1);
+  ASSERT_EQ(h - 2, labels.back().bbox.y1);
+  ASSERT_EQ(1, labels.back().size);
+}
+
+} // namespace testing
+
+} // namespace calibu
@@ -0,0 +1,54 @@
+#include <gtest/gtest.h>
+#include <calibu/calib/ModelSelection.h>
+
+namespace calibu
+{
+namespace testing
+{
+
+CameraModelFit Fit(const std::string& model, double mse, int num_params,
+                   bool converged = true)
+{
+  CameraModelFit fit;
+  fit.model = model;
+  fit.mse = mse;
+  fit.num_residuals = 10000;
+  fit.num_params = num_params;
+  fit.converged = converged;
+  ComputeInformationCriteria(fit);
+  return fit;
+}
+
+TEST(ModelSelection, InformationCriteria)
+{
+  const CameraModelFit fit = Fit("fov", 0.125, 5);
+  EXPECT_NEAR(10000 * std::log(0.25) + 10, fit.aic, 1e-9);
+  EXPECT_NEAR(10000 * std::log(0.25) + 5 * std::log(10000.0), fit.bic, 1e-9);
+
+  CameraModelFit empty;
+  ComputeInformationCriteria(empty);
+  EXPECT_TRUE(std::isinf(empty.bic));
+}
+
+TEST(ModelSelection, Select)
+{
+  std::vector<CameraModelFit> fits;
+  EXPECT_EQ(-1, SelectCameraModel(fits));
+
+  // a slightly lower error doesn't justify many more parameters
+  fits.push_back(Fit("fov", 0.1, 5));
+  fits.push_back(Fit("rational6", 0.09999, 12));
+  EXPECT_EQ(0, SelectCameraModel(fits));
+
+  // a clearly lower error does
+  fits.push_back(Fit("kb4", 0.05, 8));
+  EXPECT_EQ(2, SelectCameraModel(fits));
+
+  // converged fits are preferred
+  fits.push_back(Fit("poly3", 0.01, 7, false));
+  EXPECT_EQ(2, SelectCameraModel(fits));
+}
+
+} // namespace testing
+
+} // namespace calibu
@@ -0,0 +1,84 @@
+#include <gtest/gtest.h>
+#include <calibu/calib/ObservationSelector.h>
+
+namespace calibu
+{
+namespace testing
+{
+
+TEST(ObservationSelector, CellCap)
+{
+  const std::vector<Eigen::Vector2i> sizes(1, Eigen::Vector2i(640, 480));
+  BinnedObservationSelector selector(sizes, 2, 2, 2);
+
+  // three points in the top left cell, one in the bottom right
+  FramePoints p_c;
+  p_c.push_back(Eigen::Vector2d(10, 10));
+  p_c.push_back(Eigen::Vector2d(20, 20));
+  p_c.push_back(Eigen::Vector2d(30, 30));
+  p_c.push_back(Eigen::Vector2d(630, 470));
+
+  std::vector<size_t> selected;
+  selector.Select(0, p_c, selected);
+  ASSERT_EQ(3u, selected.size());
+  ASSERT_EQ(0u, selected[0]);
+  ASSERT_EQ(1u, selected[1]);
+  ASSERT_EQ(3u, selected[2]);
+  ASSERT_EQ(2, selector.CellCounts(0)[0]);
+  ASSERT_EQ(1, selector.CellCounts(0)[3]);
+
+  // the cap holds across frames
+  selector.Select(0, p_c, selected);
+  ASSERT_EQ(1u, selected.size());
+  ASSERT_EQ(3u, selected[0]);
+  selector.Select(0, p_c, selected);
+  ASSERT_TRUE(selected.empty());
+
+  // points outside the image are dropped
+  FramePoints outside(1, Eigen::Vector2d(-5, 100));
+  selector.Clear();
+  selector.Select(0, outside, selected);
+  ASSERT_TRUE(selected.empty());
+  selector.Select(0, p_c, selected);
+  ASSERT_EQ(3u, selected.size());
+}
+
+TEST(ObservationSelector, PreferSparseCells)
+{
+  const std::vector<Eigen::Vector2i> sizes(2, Eigen::Vector2i(640, 480));
+  BinnedObservationSelector selector(sizes, 10, 2, 1, 2);
+
+  FramePoints left;
+  left.push_back(Eigen::Vector2d(10, 10));
+  left.push_back(Eigen::Vector2d(20, 20));
+
+  std::vector<size_t> selected;
+  selector.Select(0, left, selected);
+  ASSERT_EQ(2u, selected.size());
+
+  // with a budget of two, both are taken from the empty right cell
+  FramePoints both = left;
+  both.push_back(Eigen::Vector2d(400, 10));
+  both.push_back(Eigen::Vector2d(410, 20));
+  both.push_back(Eigen::Vector2d(420, 30));
+  selector.Select(0, both, selected);
+  ASSERT_EQ(2u, selected.size());
+  ASSERT_EQ(2u, selected[0]);
+  ASSERT_EQ(3u, selected[1]);
+
+  // then cells are taken in turn as their counts even out
+  selector.Select(0, both, selected);
+  ASSERT_EQ(2u, selected.size());
+  ASSERT_EQ(0u, selected[0]);
+  ASSERT_EQ(2u, selected[1]);
+
+  // cameras are counted separately
+  selector.Select(1, both, selected);
+  ASSERT_EQ(2u, selected.size());
+  ASSERT_EQ(0u, selected[0]);
+  ASSERT_EQ(2u, selected[1]);
+}
+
+} // namespace testing
+
+} // namespace calibu
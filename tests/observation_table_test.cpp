@@ -0,0 +1,84 @@
+#include <gtest/gtest.h>
+#include <calibu/calib/ObservationTable.h>
+
+namespace calibu
+{
+namespace testing
+{
+
+typedef std::vector<Eigen::Vector3d,
+                    Eigen::aligned_allocator<Eigen::Vector3d> > Points3d;
+typedef std::vector<Eigen::Vector2d,
+                    Eigen::aligned_allocator<Eigen::Vector2d> > Points2d;
+
+void MakePoints(size_t n, double offset, Points3d& P_w, Points2d& p_c)
+{
+  P_w.clear();
+  p_c.clear();
+  for(size_t i = 0; i < n; ++i) {
+    P_w.push_back(Eigen::Vector3d(offset + i, 0, 1));
+    p_c.push_back(Eigen::Vector2d(offset + i, 0));
+  }
+}
+
+TEST(ObservationTable, AddKeepsRowsInPlace)
+{
+  ObservationTable table(4);
+  Points3d P_w;
+  Points2d p_c;
+
+  MakePoints(3, 0, P_w, p_c);
+  const ObservationTable::Range a = table.Add(2, 1, P_w.data(), p_c.data(), 3);
+  const Eigen::Vector3d* a_P_w = table.P_w(a);
+
+  // Doesn't fit in the rest of the first block
+  MakePoints(2, 10, P_w, p_c);
+  const ObservationTable::Range b = table.Add(3, 0, P_w.data(), p_c.data(), 2);
+  EXPECT_NE(a.block, b.block);
+
+  // Larger than a block
+  MakePoints(9, 20, P_w, p_c);
+  const ObservationTable::Range c = table.Add(4, 0, P_w.data(), p_c.data(), 9);
+  EXPECT_EQ(9u, c.size);
+
+  EXPECT_EQ(a_P_w, table.P_w(a));
+  EXPECT_EQ(14u, table.NumActive());
+  EXPECT_EQ(2u, table.Frame(a));
+  EXPECT_EQ(1u, table.Camera(a));
+  EXPECT_EQ(3u, table.Frame(b));
+  EXPECT_EQ(4u, table.Frame(c));
+  for(size_t i = 0; i < c.size; ++i) {
+    EXPECT_EQ(20.0 + i, table.P_w(c)[i].x());
+    EXPECT_EQ(20.0 + i, table.p_c(c)[i].x());
+    EXPECT_TRUE(table.Active(c, i));
+  }
+
+  table.Clear();
+  EXPECT_EQ(0u, table.NumActive());
+}
+
+TEST(ObservationTable, Retain)
+{
+  ObservationTable table;
+  Points3d P_w;
+  Points2d p_c;
+  MakePoints(5, 0, P_w, p_c);
+  const ObservationTable::Range rows = table.Add(0, 0, P_w.data(), p_c.data(), 5);
+
+  const std::vector<size_t> keep = {1, 3, 4};
+  const ObservationTable::Range kept = table.Retain(rows, keep);
+  ASSERT_EQ(3u, kept.size);
+  EXPECT_EQ(table.P_w(rows), table.P_w(kept));
+  EXPECT_EQ(3u, table.NumActive());
+  for(size_t j = 0; j < keep.size(); ++j) {
+    EXPECT_EQ(double(keep[j]), table.P_w(kept)[j].x());
+    EXPECT_EQ(double(keep[j]), table.p_c(kept)[j].x());
+    EXPECT_TRUE(table.Active(rows, j));
+  }
+  EXPECT_FALSE(table.Active(rows, 3));
+  EXPECT_FALSE(table.Active(rows, 4));
+}
+
+} // namespace testing
+
+} // namespace calibu
@@ -0,0 +1,197 @@
+#include <gtest/gtest.h>
+#include <calibu/calib/OnlineCalibrator.h>
+#include "test_util.h"
+
+namespace calibu
+{
+namespace testing
+{
+
+namespace
+{
+
+typedef std::vector<Eigen::Vector3d,
+                    Eigen::aligned_allocator<Eigen::Vector3d> > Points3d;
+typedef std::vector<Eigen::Vector2d,
+                    Eigen::aligned_allocator<Eigen::Vector2d> > Points2d;
+
+// Exposes the prior and window of OnlineCalibrator
+class OnlineCalibratorProbe : public OnlineCalibrator
+{
+public:
+  using OnlineCalibrator::OnlineCalibrator;
+
+  const Eigen::VectorXd& PriorEta() const
+  {
+    return m_prior_eta;
+  }
+
+  const Sophus::SE3d& FramePose(size_t i) const
+  {
+    return m_frames[i]->T_cw;
+  }
+};
+
+// Planar 7x5 grid of target points, 5cm apart
+Points3d MakeTarget()
+{
+  Points3d P_w;
+  for (int y = 0; y < 5; ++y)
+  {
+    for (int x = 0; x < 7; ++x)
+    {
+      P_w.push_back(Eigen::Vector3d(0.05 * x, 0.05 * y, 0));
+    }
+  }
+  return P_w;
+}
+
+// Pose of the i'th frame, looking at the target from varying directions
+Sophus::SE3d MakePose(int i)
+{
+  const Eigen::Vector3d w(0.3 * std::sin(1.3 * i), 0.3 * std::cos(0.9 * i),
+                          0.1 * std::sin(0.7 * i));
+  const Sophus::SO3d R = Sophus::SO3d::exp(w);
+  const Eigen::Vector3d center(0.15, 0.1, 0);
+  const Eigen::Vector3d t(0.02 * std::cos(i), 0.02 * std::sin(i),
+                          0.5 + 0.05 * (i % 3));
+  return Sophus::SE3d(R, t - (R * center));
+}
+
+Points2d Project(const CameraInterface<double>& camera,
+                 const Sophus::SE3d& T_cw, const Points3d& P_w)
+{
+  Points2d p_c;
+  for (const Eigen::Vector3d& P : P_w)
+  {
+    p_c.push_back(camera.Project(T_cw * P));
+  }
+  return p_c;
+}
+
+} // namespace
+
+TEST(OnlineCalibrator, MarginalizedPriorIsSchurComplement)
+{
+  std::shared_ptr<CameraInterface<double>> camera = CreateFovCamera();
+  const Eigen::VectorXd truth = camera->GetParams();
+  const Points3d P_w = MakeTarget();
+  const Points2d p_a = Project(*camera, MakePose(0), P_w);
+  const Points2d p_b = Project(*camera, MakePose(1), P_w);
+
+  Eigen::VectorXd start = truth;
+  start[0] *= 1.02;
+  start[4] = 0.85;
+  camera->SetParams(start);
+
+  OnlineCalibratorOptions options;
+  options.window_size = 1;
+  options.max_num_iterations = 2;
+  OnlineCalibratorProbe calibrator(camera, options);
+
+  ASSERT_TRUE(calibrator.AddFrame(MakePose(0), P_w, p_a));
+  EXPECT_EQ(0u, calibrator.NumMarginalized());
+
+  // State at which the first frame will be marginalised
+  const Eigen::VectorXd x0 = calibrator.Params();
+  const Sophus::SE3d T_a = calibrator.FramePose(0);
+
+  ASSERT_TRUE(calibrator.AddFrame(MakePose(1), P_w, p_b));
+  EXPECT_EQ(1u, calibrator.NumFrames());
+  EXPECT_EQ(1u, calibrator.NumMarginalized());
+
+  // Linearise the first frame's cost over its pose tangent space and the
+  // intrinsics by central differences
+  ReprojectionCostFactoryT<FovCamera<double>> factory;
+  std::unique_ptr<ceres::CostFunction> cost(factory.NewCosts(
+      P_w, p_a, options.loss_scale, COST_JACOBIANS_ANALYTIC));
+  const int m = cost->num_residuals();
+  const int n = x0.size();
+  const Sophus::SE3d T_ck;
+
+  auto residuals = [&](const Sophus::SE3d& T_cw, const Eigen::VectorXd& x) {
+    Eigen::VectorXd r(m);
+    const double* parameters[3] = { T_cw.data(), T_ck.data(), x.data() };
+    EXPECT_TRUE(cost->Evaluate(parameters, r.data(), nullptr));
+    return r;
+  };
+
+  const double h = 1e-6;
+  const Eigen::VectorXd r = residuals(T_a, x0);
+  Eigen::MatrixXd J(m, 6 + n);
+  for (int i = 0; i < 6; ++i)
+  {
+    Eigen::Matrix<double, 6, 1> delta = Eigen::Matrix<double, 6, 1>::Zero();
+    Sophus::SE3d plus, minus;
+    delta[i] = h;
+    Se3Plus(T_a.data(), delta.data(), plus.data());
+    delta[i] = -h;
+    Se3Plus(T_a.data(), delta.data(), minus.data());
+    J.col(i) = (residuals(plus, x0) - residuals(minus, x0)) / (2 * h);
+  }
+  for (int i = 0; i < n; ++i)
+  {
+    Eigen::VectorXd plus = x0, minus = x0;
+    plus[i] += h;
+    minus[i] -= h;
+    J.col(6 + i) = (residuals(T_a, plus) - residuals(T_a, minus)) / (2 * h);
+  }
+
+  // The first frame's pose only appears in its own cost, so eliminating it
+  // from the full problem leaves the Schur complement of its pose block
+  const Eigen::MatrixXd H_full = J.transpose() * J;
+  const Eigen::VectorXd g_full = J.transpose() * r;
+  const Eigen::MatrixXd H_pp = H_full.topLeftCorner(6, 6);
+  const Eigen::MatrixXd H_px = H_full.topRightCorner(6, n);
+  const Eigen::MatrixXd H = H_full.bottomRightCorner(n, n) -
+                            H_px.transpose() * H_pp.ldlt().solve(H_px);
+  const Eigen::VectorXd b = g_full.tail(n) -
+                            H_px.transpose() * H_pp.ldlt().solve(g_full.head(6));
+
+  const Eigen::MatrixXd& prior = calibrator.PriorInformation();
+  EXPECT_LT((prior - H).norm(), 1e-5 * H.norm());
+  const Eigen::VectorXd eta = H * x0 - b;
+  EXPECT_LT((calibrator.PriorEta() - eta).norm(), 1e-5 * eta.norm());
+}
+
+TEST(OnlineCalibrator, WindowedEstimateConverges)
+{
+  std::shared_ptr<CameraInterface<double>> camera = CreateFovCamera();
+  const Eigen::VectorXd truth = camera->GetParams();
+  const Points3d P_w = MakeTarget();
+
+  Eigen::VectorXd start = truth;
+  start[0] *= 1.03;
+  start[1] *= 0.98;
+  start[2] += 5;
+  start[3] -= 4;
+  start[4] = 0.85;
+  camera->SetParams(start);
+
+  OnlineCalibratorOptions options;
+  options.window_size = 3;
+  options.max_num_iterations = 10;
+  options.loss_scale = 0; // observations are exact
+  OnlineCalibratorProbe calibrator(camera, options);
+
+  const int num_frames = 12;
+  for (int i = 0; i < num_frames; ++i)
+  {
+    const Sophus::SE3d T_cw = MakePose(i);
+    const Points2d p_c = Project(*CreateFovCamera(), T_cw, P_w);
+    const Sophus::SE3d guess =
+        T_cw * Sophus::SE3d::exp((Eigen::Matrix<double, 6, 1>() <<
+                                  0.01, -0.01, 0.02, 0.01, 0.02, -0.01).finished());
+    ASSERT_TRUE(calibrator.AddFrame(guess, P_w, p_c));
+  }
+
+  EXPECT_EQ(options.window_size, calibrator.NumFrames());
+  EXPECT_EQ(num_frames - options.window_size, calibrator.NumMarginalized());
+  EXPECT_LT(calibrator.MeanSquareError(), 1e-10);
+  EXPECT_TRUE(calibrator.Params().isApprox(truth, 1e-5))
+      << calibrator.Params().transpose();
+}
+
+} // namespace testing
+
+} // namespace calibu
@@ -0,0 +1,80 @@
+#include <gtest/gtest.h>
+#include <calibu/pose/P3p.h>
+
+#include <random>
+
+namespace calibu
+{
+namespace testing
+{
+
+Sophus::SE3d RandomPose(std::mt19937& rng)
+{
+  std::uniform_real_distribution<double> uniform(-0.3, 0.3);
+  Eigen::Matrix<double, 6, 1> x;
+  for (int i = 0; i < 6; ++i) x[i] = uniform(rng);
+  x[2] += 2.0;
+  return Sophus::SE3d::exp(x);
+}
+
+Eigen::Vector3d RandomPoint(std::mt19937& rng)
+{
+  std::uniform_real_distribution<double> uniform(-0.5, 0.5);
+  return Eigen::Vector3d(uniform(rng), uniform(rng), 0.2 * uniform(rng));
+}
+
+TEST(P3p, RecoversPose)
+{
+  std::mt19937 rng(1);
+  for (int trial = 0; trial < 100; ++trial)
+  {
+    const Sophus::SE3d T = RandomPose(rng);
+    Eigen::Vector3d P[3], f[3];
+    for (int i = 0; i < 3; ++i)
+    {
+      P[i] = RandomPoint(rng);
+      f[i] = (T * P[i]).normalized();
+    }
+
+    Sophus::SE3d solutions[4];
+    const int n = P3p(f, P, solutions);
+    ASSERT_LE(n, 4);
+    double best = std::numeric_limits<double>::max();
+    for (int i = 0; i < n; ++i)
+    {
+      // Every solution explains the bearings, to the precision lost near
+      // double roots
+      for (int j = 0; j < 3; ++j)
+      {
+        ASSERT_LT(BearingError(f[j], solutions[i] * P[j]), 1E-4);
+      }
+      best = std::min(best, (solutions[i].matrix() - T.matrix()).norm());
+    }
+    ASSERT_LT(best, 1E-4) << "trial " << trial;
+  }
+}
+
+TEST(P3p, RefineBearingPose)
+{
+  std::mt19937 rng(2);
+  const Sophus::SE3d T = RandomPose(rng);
+  const int n = 20;
+  Eigen::Matrix3Xd P(3, n), f(3, n);
+  std::vector<int> idx;
+  for (int i = 0; i < n; ++i)
+  {
+    P.col(i) = RandomPoint(rng);
+    f.col(i) = (T * Eigen::Vector3d(P.col(i))).normalized();
+    idx.push_back(i);
+  }
+
+  Eigen::Matrix<double, 6, 1> dx;
+  dx << 0.01, -0.02, 0.03, 0.02, 0.01, -0.01;
+  Sophus::SE3d T_est = Sophus::SE3d::exp(dx) * T;
+  RefineBearingPose(f, P, idx, 10, T_est);
+  ASSERT_LT((T_est.matrix() - T.matrix()).norm(), 1E-8);
+}
+
+} // namespace testing
+
+} // namespace calibu
@@ -0,0 +1,94 @@
+#include <gtest/gtest.h>
+#include <calibu/pcalib/pcalib_sidecar.h>
+#include <calibu/exception.h>
+
+#include <cstdio>
+#include <fstream>
+
+namespace calibu
+{
+namespace testing
+{
+
+TEST(Sidecar, Float32)
+{
+  const std::string filename = ::testing::TempDir() + "calibu_sidecar32.bin";
+
+  Eigen::VectorXd expected(100003);
+  for (int i = 0; i < expected.size(); ++i)
+  {
+    expected[i] = 0.5 + 0.5 * std::sin(0.001 * i);
+  }
+
+  WriteSidecar(filename, expected, SIDECAR_FLOAT32);
+
+  Eigen::VectorXd found(expected.size());
+  ReadSidecar(filename, found);
+
+  for (int i = 0; i < expected.size(); ++i)
+  {
+    ASSERT_EQ(float(expected[i]), found[i]);
+  }
+
+  std::remove(filename.c_str());
+}
+
+TEST(Sidecar, Float16)
+{
+  const std::string filename = ::testing::TempDir() + "calibu_sidecar16.bin";
+
+  Eigen::VectorXd expected(12);
+  expected << 0.0, -0.0, 1.0, -2.5, 0.333333, 65504, 1E-6, 6E-8,
+      1E6, std::numeric_limits<double>::infinity(), 0.99951171875, 1.0004;
+
+  WriteSidecar(filename, expected, SIDECAR_FLOAT16);
+
+  Eigen::VectorXd found(expected.size());
+  ReadSidecar(filename, found);
+
+  ASSERT_EQ(0.0, found[0]);
+  ASSERT_TRUE(std::signbit(found[1]));
+  ASSERT_EQ(1.0, found[2]);
+  ASSERT_EQ(-2.5, found[3]);
+  ASSERT_NEAR(0.333333, found[4], 0.333333 / 2048);
+  ASSERT_EQ(65504, found[5]);
+  ASSERT_NEAR(1E-6, found[6], std::ldexp(1.0, -25));
+  ASSERT_NEAR(6E-8, found[7], std::ldexp(1.0, -25));
+  ASSERT_TRUE(std::isinf(found[8]));
+  ASSERT_TRUE(std::isinf(found[9]));
+  ASSERT_EQ(0.99951171875, found[10]);
+  ASSERT_EQ(1.0, found[11]);
+
+  std::remove(filename.c_str());
+}
+
+TEST(Sidecar, Invalid)
+{
+  const std::string filename = ::testing::TempDir() + "calibu_sidecar_bad.bin";
+
+  Eigen::VectorXd params = Eigen::VectorXd::Random(5000);
+  WriteSidecar(filename, params, SIDECAR_FLOAT32);
+
+  Eigen::VectorXd found(4000);
+  ASSERT_THROW(ReadSidecar(filename, found), Exception);
+
+  {
+    // truncate the values
+    std::ifstream in(filename, std::ios::binary);
+    std::string data((std::istreambuf_iterator<char>(in)),
+                     std::istreambuf_iterator<char>());
+    in.close();
+    std::ofstream out(filename, std::ios::binary | std::ios::trunc);
+    out.write(data.data(), data.size() / 2);
+  }
+
+  found.resize(params.size());
+  ASSERT_THROW(ReadSidecar(filename, found), Exception);
+
+  std::remove(filename.c_str());
+  ASSERT_THROW(ReadSidecar(filename, found), Exception);
+}
+
+} // namespace testing
+
+} // namespace calibu
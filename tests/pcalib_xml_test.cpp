@@ -1,8 +1,11 @@
 #include <gtest/gtest.h>
+#include <cstdio>
+#include <fstream>
 #include <calibu/pcalib/pcalib_xml.h>
 #include <calibu/pcalib/response_poly.h>
 #include <calibu/pcalib/response_linear.h>
 #include <calibu/pcalib/vignetting_dense.h>
+#include <calibu/pcalib/vignetting_grid.h>
 #include <calibu/pcalib/vignetting_poly.h>
 #include <calibu/pcalib/vignetting_uniform.h>
 
@@ -71,6 +74,14 @@ TEST(PhotoRigXml, ReadWrite)
       vignetting->SetParams(params);
       camera->vignettings.push_back(vignetting);
     }
+
+    {
+      std::shared_ptr<GridVignetting<double>> vignetting;
+      vignetting = std::make_shared<GridVignetting<double>>(640, 480, 9, 7,
+          GRID_BILINEAR);
+      vignetting->SetParams(Eigen::VectorXd::Random(9 * 7));
+      camera->vignettings.push_back(vignetting);
+    }
   }
 
   const std::string filename = "test_pcalib.xml";
@@ -121,6 +132,7 @@ TEST(PhotoRigXml, ReadWrite)
       ASSERT_EQ(e->Type(), f->Type());
       ASSERT_EQ(e->Width(), f->Width());
       ASSERT_EQ(e->Height(), f->Height());
+      ASSERT_DOUBLE_EQ((*e)(100.5, 200.5), (*f)(100.5, 200.5));
 
       const Eigen::VectorXd& eparams = e->GetParams();
       const Eigen::VectorXd& fparams = f->GetParams();
@@ -135,6 +147,72 @@ TEST(PhotoRigXml, ReadWrite)
   }
 }
 
+TEST(PhotoRigXml, Sidecar)
+{
+  PhotoRigd expected;
+  std::shared_ptr<PhotoCamerad> camera = std::make_shared<PhotoCamerad>();
+  expected.cameras.push_back(camera);
+
+  {
+    std::shared_ptr<EvenPoly6Vignetting<double>> vignetting;
+    vignetting = std::make_shared<EvenPoly6Vignetting<double>>(640, 480);
+    vignetting->SetParams(Eigen::Vector3d(+0.1, -0.2, +0.3));
+    camera->vignettings.push_back(vignetting);
+  }
+
+  for (int k = 0; k < 2; ++k)
+  {
+    Eigen::VectorXd params(640 * 480);
+
+    for (int i = 0; i < params.size(); ++i)
+    {
+      params[i] = 1.0 - 1E-6 * (k + 1) * i;
+    }
+
+    std::shared_ptr<DenseVignetting<double>> vignetting;
+    vignetting = std::make_shared<DenseVignetting<double>>(640, 480);
+    vignetting->SetParams(params);
+    camera->vignettings.push_back(vignetting);
+  }
+
+  const std::string filename = ::testing::TempDir() + "test_sidecar.xml";
+  WriteXmlPhotoRig(filename, expected, SIDECAR_FLOAT16);
+
+  std::shared_ptr<PhotoRigd> found = ReadXmlPhotoRig(filename);
+  std::remove(filename.c_str());
+
+  ASSERT_EQ(1u, found->cameras.size());
+  ASSERT_EQ(3u, found->cameras[0]->vignettings.size());
+
+  for (size_t i = 0; i < camera->vignettings.size(); ++i)
+  {
+    std::shared_ptr<const Vignetting<double>> e = camera->vignettings[i];
+    std::shared_ptr<const Vignetting<double>> f =
+        found->cameras[0]->vignettings[i];
+
+    ASSERT_EQ(e->Type(), f->Type());
+    ASSERT_EQ(e->NumParams(), f->NumParams());
+
+    for (int j = 0; j < e->NumParams(); ++j)
+    {
+      // half precision keeps 11 significant bits
+      ASSERT_NEAR(e->GetParams()[j], f->GetParams()[j], 1.0 / 2048);
+    }
+  }
+
+  // dense models were stored next to the XML file
+  for (int k = 0; k < 2; ++k)
+  {
+    const std::string sidecar = ::testing::TempDir() +
+        "test_sidecar.vignetting" + std::to_string(k) + ".bin";
+
+    std::ifstream file(sidecar);
+    ASSERT_TRUE(file.good());
+    file.close();
+    std::remove(sidecar.c_str());
+  }
+}
+
 } // namespace testing
 
 } // namespace calibu
\ No newline at end of file
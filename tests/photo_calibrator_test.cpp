@@ -0,0 +1,138 @@
+#include <gtest/gtest.h>
+#include <calibu/calib/PhotoCalibrator.h>
+
+namespace calibu
+{
+namespace testing
+{
+
+namespace
+{
+
+const int kWidth = 64;
+const int kHeight = 48;
+
+// Intensity whose inverse-response under 'params' is 'irradiance'
+float ApplyResponse(const Eigen::Vector3d& params, double irradiance)
+{
+  double lo = 0, hi = 1;
+  for (int i = 0; i < 60; ++i)
+  {
+    const double mid = 0.5 * (lo + hi);
+    if (Poly3Response<double>::GetResponse(params.data(), mid) < irradiance)
+    {
+      lo = mid;
+    }
+    else
+    {
+      hi = mid;
+    }
+  }
+  return 0.5 * (lo + hi);
+}
+
+// Flat field image of irradiance B taken with exposure t
+std::vector<float> RenderFlatField(const Eigen::Vector3d& response,
+                                   const EvenPoly6Vignetting<double>& vignetting,
+                                   double t, double B)
+{
+  std::vector<float> image(kWidth * kHeight);
+  for (int y = 0; y < kHeight; ++y)
+  {
+    for (int x = 0; x < kWidth; ++x)
+    {
+      image[y * kWidth + x] =
+          ApplyResponse(response, t * vignetting(x + 0.5, y + 0.5) * B);
+    }
+  }
+  return image;
+}
+
+} // namespace
+
+TEST(PhotoCalibrator, RecoversSyntheticModels)
+{
+  const Eigen::Vector3d true_response(0.6, 0.3, 0.1);
+  EvenPoly6Vignetting<double> true_vignetting(kWidth, kHeight);
+  true_vignetting.SetParams(Eigen::Vector3d(-0.3, 0.05, -0.02));
+  const std::vector<double> true_exposures = { 0.5, 0.8, 1.2, 1.8, 2.6 };
+
+  std::shared_ptr<PhotoCamerad> camera = std::make_shared<PhotoCamerad>();
+  camera->responses.push_back(std::make_shared<Poly3Response<double>>());
+  camera->vignettings.push_back(
+      std::make_shared<EvenPoly6Vignetting<double>>(kWidth, kHeight));
+
+  PhotoCalibratorOptions options;
+  options.num_threads = 1;
+  options.max_num_iterations = 100;
+  options.max_gradient = 0.05;
+  options.max_samples = 500;
+  options.fix_exposures = false;
+  PhotoCalibrator calibrator(options);
+  const int id = calibrator.AddCamera(camera);
+
+  // Only the first exposure of each batch is known exactly
+  std::vector<double> guesses;
+  for (size_t k = 0; k < true_exposures.size(); ++k)
+  {
+    guesses.push_back(k == 0 ? true_exposures[k] : 1.1 * true_exposures[k]);
+  }
+
+  for (double B : { 0.2, 0.28, 0.36 })
+  {
+    std::vector<std::vector<float>> images;
+    std::vector<const float*> pointers;
+    for (double t : true_exposures)
+    {
+      images.push_back(RenderFlatField(true_response, true_vignetting, t, B));
+    }
+    for (const std::vector<float>& image : images)
+    {
+      pointers.push_back(image.data());
+    }
+    calibrator.AddImages(id, pointers, guesses, true);
+  }
+
+  // An over-exposed batch leaves a scene point and its exposures unobserved
+  const std::vector<float> saturated(kWidth * kHeight, 1.0f);
+  const std::vector<const float*> saturated_images(3, saturated.data());
+  calibrator.AddImages(id, saturated_images, { 1.0, 2.0, 3.0 }, true);
+
+  ceres::Solver::Summary summary;
+  ASSERT_TRUE(calibrator.Solve(&summary));
+  EXPECT_TRUE(calibrator.ReachedTolerance());
+  EXPECT_EQ(ceres::CONVERGENCE, summary.termination_type);
+  EXPECT_LT(calibrator.MeanSquareError(), 1e-12);
+
+  EXPECT_TRUE(camera->responses[0]->GetParams().isApprox(true_response, 1e-4))
+      << camera->responses[0]->GetParams().transpose();
+
+  const Eigen::VectorXd& vignetting = camera->vignettings[0]->GetParams();
+  EXPECT_TRUE(vignetting.isApprox(true_vignetting.GetParams(), 1e-4))
+      << vignetting.transpose();
+
+  for (size_t b = 0; b < 3; ++b)
+  {
+    for (size_t k = 0; k < true_exposures.size(); ++k)
+    {
+      EXPECT_NEAR(true_exposures[k],
+                  calibrator.GetExposure(b * true_exposures.size() + k), 1e-4);
+    }
+  }
+}
+
+TEST(PhotoCalibrator, SolveWithoutImages)
+{
+  std::shared_ptr<PhotoCamerad> camera = std::make_shared<PhotoCamerad>();
+  camera->responses.push_back(std::make_shared<LinearResponse<double>>());
+  camera->vignettings.push_back(
+      std::make_shared<UniformVignetting<double>>(kWidth, kHeight));
+
+  PhotoCalibrator calibrator;
+  calibrator.AddCamera(camera);
+  EXPECT_FALSE(calibrator.Solve());
+}
+
+} // namespace testing
+
+} // namespace calibu
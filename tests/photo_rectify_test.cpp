@@ -0,0 +1,102 @@
+#include <gtest/gtest.h>
+#include <calibu/cam/camera_models_crtp.h>
+#include <calibu/pcalib/photo_rectify.h>
+#include <calibu/pcalib/response_linear.h>
+#include <calibu/pcalib/response_poly.h>
+#include <calibu/pcalib/vignetting_dense.h>
+#include <calibu/pcalib/vignetting_poly.h>
+
+namespace calibu
+{
+namespace testing
+{
+
+LookupTable CreatePhotoLookupTable(int w, int h)
+{
+  Eigen::VectorXd params(5);
+  params << 300, 310, 0.5 * w, 0.5 * h, 0.9;
+  Eigen::Vector2i size(w, h);
+  std::shared_ptr<CameraInterface<double>> camera =
+      std::make_shared<FovCamera<double>>(params, size);
+
+  LookupTable lut;
+  CreateLookupTable(camera, lut);
+  return lut;
+}
+
+TEST(PhotoRectifier, Identity)
+{
+  const int w = 160;
+  const int h = 120;
+  const LookupTable lut = CreatePhotoLookupTable(w, h);
+
+  std::vector<uint8_t> input(w * h);
+
+  for (size_t i = 0; i < input.size(); ++i)
+  {
+    input[i] = (i * 13) % 256;
+  }
+
+  std::vector<float> raw(w * h);
+  std::vector<float> expected(w * h);
+  std::copy(input.begin(), input.end(), raw.begin());
+  Rectify(lut, raw.data(), expected.data(), w, h);
+
+  PhotoCamera<double> camera;
+  camera.responses.push_back(std::make_shared<LinearResponse<double>>());
+  camera.responses[0]->SetRange(0, 255);
+  PhotoRectifier<double> rectifier(lut, camera, w, h);
+  ASSERT_EQ(w, rectifier.Width());
+  ASSERT_EQ(h, rectifier.Height());
+
+  std::vector<float> actual(w * h);
+  rectifier.Rectify(input.data(), actual.data(), 3);
+
+  for (size_t i = 0; i < actual.size(); ++i)
+  {
+    ASSERT_NEAR(expected[i], actual[i], 1E-3);
+  }
+}
+
+TEST(PhotoRectifier, Correction)
+{
+  const int w = 160;
+  const int h = 120;
+  const int channels = 3;
+  const LookupTable lut = CreatePhotoLookupTable(w, h);
+
+  std::shared_ptr<Poly3Response<double>> response =
+      std::make_shared<Poly3Response<double>>();
+  response->SetParams(Eigen::Vector3d(0.5, 0.001, 0));
+  response->SetRange(0, 65535);
+
+  std::shared_ptr<DenseVignetting<double>> vignetting =
+      std::make_shared<DenseVignetting<double>>(w / 2, h / 2);
+  vignetting->SetParams(Eigen::VectorXd::Constant(w * h / 4, 0.5));
+
+  PhotoCamera<double> camera;
+  camera.responses.push_back(response);
+  camera.vignettings.push_back(vignetting);
+
+  std::vector<uint16_t> input(w * h * channels, 1000);
+  PhotoRectifier<double> rectifier(lut, camera, w, h, 16, channels);
+  ASSERT_EQ(channels, rectifier.Channels());
+
+  std::vector<float> actual(w * h * channels);
+  rectifier.Rectify(input.data(), actual.data());
+  const double expected = (*response)(1000) / 0.5;
+
+  for (size_t i = 0; i < actual.size(); ++i)
+  {
+    ASSERT_NEAR(expected, actual[i], 1E-3);
+  }
+
+#ifndef NDEBUG
+  std::vector<uint8_t> input8(w * h * channels);
+  ASSERT_THROW(rectifier.Rectify(input8.data(), actual.data()), Exception);
+#endif
+}
+
+} // namespace testing
+
+} // namespace calibu
@@ -0,0 +1,186 @@
+#include <gtest/gtest.h>
+#include <calibu/calib/PhotometricCost.h>
+
+namespace calibu
+{
+namespace testing
+{
+
+namespace
+{
+
+// Compare the Jacobians of 'cost' at 'params' with central differences
+void ExpectJacobiansMatch(const ceres::CostFunction& cost,
+                          std::vector<std::vector<double>> params)
+{
+  const std::vector<int>& sizes = cost.parameter_block_sizes();
+  ASSERT_EQ(sizes.size(), params.size());
+  const int m = cost.num_residuals();
+
+  std::vector<const double*> blocks;
+  std::vector<std::vector<double>> jacobians(params.size());
+  std::vector<double*> jacobian_ptrs;
+  for (size_t b = 0; b < params.size(); ++b)
+  {
+    ASSERT_EQ(sizes[b], int(params[b].size()));
+    blocks.push_back(params[b].data());
+    jacobians[b].resize(m * sizes[b]);
+    jacobian_ptrs.push_back(jacobians[b].data());
+  }
+
+  std::vector<double> residuals(m);
+  ASSERT_TRUE(cost.Evaluate(blocks.data(), residuals.data(),
+                            jacobian_ptrs.data()));
+
+  const double h = 1e-6;
+  std::vector<double> plus(m), minus(m);
+  for (size_t b = 0; b < params.size(); ++b)
+  {
+    for (int j = 0; j < sizes[b]; ++j)
+    {
+      const double x = params[b][j];
+      params[b][j] = x + h;
+      ASSERT_TRUE(cost.Evaluate(blocks.data(), plus.data(), nullptr));
+      params[b][j] = x - h;
+      ASSERT_TRUE(cost.Evaluate(blocks.data(), minus.data(), nullptr));
+      params[b][j] = x;
+
+      for (int i = 0; i < m; ++i)
+      {
+        EXPECT_NEAR((plus[i] - minus[i]) / (2 * h),
+                    jacobians[b][i * sizes[b] + j], 1e-6)
+            << "block " << b << ", parameter " << j;
+      }
+    }
+  }
+}
+
+// Compare a linear form of a vignetting model at (u, v) with the model
+// evaluated at params and at central differences about them
+void ExpectVignettingFormMatches(Vignetting<double>& model,
+                                 const PhotoVignettingLinearizer& linearizer,
+                                 const Eigen::VectorXd& params,
+                                 double u, double v)
+{
+  PhotoLinearForm form;
+  linearizer.Linearize(params.data(), u, v, form);
+  model.SetParams(params);
+  EXPECT_NEAR(model(u, v), form.Evaluate(params.data()), 1e-9);
+
+  const double h = 1e-6;
+  size_t k = 0;
+  for (int i = 0; i < params.size(); ++i)
+  {
+    Eigen::VectorXd p = params;
+    p[i] = params[i] + h;
+    model.SetParams(p);
+    const double plus = model(u, v);
+    p[i] = params[i] - h;
+    model.SetParams(p);
+    const double derivative = (plus - model(u, v)) / (2 * h);
+
+    if (k < form.indices.size() && form.indices[k] == i)
+    {
+      EXPECT_NEAR(derivative, form.weights[k], 1e-6) << "parameter " << i;
+      ++k;
+    }
+    else
+    {
+      EXPECT_NEAR(0, derivative, 1e-9) << "parameter " << i;
+    }
+  }
+  EXPECT_EQ(form.indices.size(), k);
+}
+
+} // namespace
+
+TEST(PhotometricCost, LinearizeResponse)
+{
+  const double params[] = { 0.6, 0.3, 0.1 };
+  const double value = 0.7;
+
+  PhotoLinearForm form;
+  PhotoResponseLinearizerT<Poly3Response<double>> linearizer;
+  linearizer.Linearize(params, 3, value, form);
+  EXPECT_NEAR(Poly3Response<double>::GetResponse(params, value),
+              form.Evaluate(params), 1e-12);
+
+  ASSERT_EQ(3u, form.indices.size());
+  const double h = 1e-6;
+  for (int i = 0; i < 3; ++i)
+  {
+    double p[3] = { params[0], params[1], params[2] };
+    p[i] = params[i] + h;
+    const double plus = Poly3Response<double>::GetResponse(p, value);
+    p[i] = params[i] - h;
+    const double minus = Poly3Response<double>::GetResponse(p, value);
+    EXPECT_EQ(i, form.indices[i]);
+    EXPECT_NEAR((plus - minus) / (2 * h), form.weights[i], 1e-6);
+  }
+}
+
+TEST(PhotometricCost, LinearizeVignetting)
+{
+  EvenPoly6Vignetting<double> poly(64, 48);
+  PhotoVignettingLinearizerT<EvenPoly6Vignetting<double>> poly_linearizer(poly);
+  ExpectVignettingFormMatches(poly, poly_linearizer,
+                              Eigen::Vector3d(-0.3, 0.05, -0.02), 7.5, 40.5);
+
+  // Grid models span more parameters than a jet perturbs at once, and only
+  // depend upon a few of them at any point
+  for (GridInterpolation interpolation : { GRID_BILINEAR, GRID_BICUBIC })
+  {
+    GridVignetting<double> grid(64, 48, 5, 4, interpolation);
+    PhotoVignettingLinearizerT<GridVignetting<double>> grid_linearizer(grid);
+    Eigen::VectorXd params(20);
+    for (int i = 0; i < params.size(); ++i)
+    {
+      params[i] = 1.0 - 0.01 * ((i * 7) % 11);
+    }
+    ExpectVignettingFormMatches(grid, grid_linearizer, params, 20.5, 13.5);
+    ExpectVignettingFormMatches(grid, grid_linearizer, params, 60.5, 45.5);
+  }
+}
+
+TEST(PhotometricCost, PhotometricJacobians)
+{
+  PhotoLinearForm response;
+  response.constant = 0.05;
+  response.indices = { 0, 2 };
+  response.weights = { 0.7, 0.343 };
+
+  PhotoLinearForm attenuation;
+  attenuation.constant = 1.0;
+  attenuation.indices = { 1, 4 };
+  attenuation.weights = { 0.25, 0.0625 };
+
+  PhotometricCostFunction cost(3, response, attenuation);
+  ASSERT_EQ(5u, cost.parameter_block_sizes().size());
+  ExpectJacobiansMatch(cost, { { 0.6, 0.3, 0.1 }, { 1.5 }, { 0.4 },
+                               { -0.2 }, { 0.03 } });
+
+  // Without response parameters the inverse-response is a constant
+  PhotometricCostFunction fixed(0, response, attenuation);
+  ASSERT_EQ(4u, fixed.parameter_block_sizes().size());
+  ExpectJacobiansMatch(fixed, { { 1.5 }, { 0.4 }, { -0.2 }, { 0.03 } });
+}
+
+TEST(PhotometricCost, PriorJacobians)
+{
+  PhotoLinearForm form;
+  form.constant = 0.1;
+  form.indices = { 1, 2 };
+  form.weights = { 0.5, -2.0 };
+
+  PhotoPriorCostFunction block(3, form, 1.0, 4.0);
+  ASSERT_EQ(1u, block.parameter_block_sizes().size());
+  ExpectJacobiansMatch(block, { { 0.6, 0.3, 0.1 } });
+
+  PhotoPriorCostFunction scalars(0, form, 1.0, 4.0);
+  ASSERT_EQ(2u, scalars.parameter_block_sizes().size());
+  ExpectJacobiansMatch(scalars, { { 0.3 }, { 0.1 } });
+}
+
+} // namespace testing
+
+} // namespace calibu
@@ -0,0 +1,75 @@
+#include <gtest/gtest.h>
+#include <calibu/utils/PipelineStats.h>
+
+#include <sstream>
+#include <thread>
+
+namespace calibu
+{
+namespace testing
+{
+
+TEST(PipelineStats, Threads)
+{
+  ResetPipelineStats();
+
+  auto record = [](uint64_t duration_ns)
+  {
+    for (int i = 0; i < 300; ++i)
+    {
+      RecordPipelineStage(STAGE_CONICS, i, duration_ns);
+    }
+    RecordPipelineCount(COUNTER_CONICS, 5);
+  };
+
+  std::thread a(record, 1000);
+  std::thread b(record, 3000);
+  a.join();
+  b.join();
+
+  const PipelineStats stats = GetPipelineStats();
+  ASSERT_EQ(600u, stats.stages[STAGE_CONICS].count);
+  ASSERT_EQ(300u * 4000u, stats.stages[STAGE_CONICS].total_ns);
+  ASSERT_EQ(3000u, stats.stages[STAGE_CONICS].max_ns);
+  ASSERT_DOUBLE_EQ(0.002, stats.stages[STAGE_CONICS].MeanMs());
+  ASSERT_EQ(0u, stats.stages[STAGE_PNP].count);
+  ASSERT_EQ(10u, stats.counters[COUNTER_CONICS]);
+
+  // Each thread keeps only its most recent samples
+  ASSERT_EQ(2u * kPipelineRingSize, stats.recent.size());
+  ASSERT_EQ(uint64_t(300 - kPipelineRingSize), stats.recent[0].begin_ns);
+  ASSERT_EQ(299u, stats.recent[kPipelineRingSize - 1].begin_ns);
+
+  std::ostringstream os;
+  stats.Print(os);
+  ASSERT_NE(std::string::npos, os.str().find("conics"));
+  ASSERT_EQ(std::string::npos, os.str().find("pnp"));
+
+  ResetPipelineStats();
+  ASSERT_EQ(0u, GetPipelineStats().stages[STAGE_CONICS].count);
+  ASSERT_TRUE(GetPipelineStats().recent.empty());
+}
+
+TEST(PipelineStats, Timer)
+{
+  ResetPipelineStats();
+  {
+    PipelineTimer timer(STAGE_GRADIENT);
+    std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    timer.Next(STAGE_THRESHOLD);
+  }
+
+  const PipelineStats stats = GetPipelineStats();
+  ASSERT_EQ(1u, stats.stages[STAGE_GRADIENT].count);
+  ASSERT_EQ(1u, stats.stages[STAGE_THRESHOLD].count);
+  ASSERT_GE(stats.stages[STAGE_GRADIENT].total_ns, 2000000u);
+  ASSERT_EQ(2u, stats.recent.size());
+  ASSERT_EQ(STAGE_GRADIENT, stats.recent[0].stage);
+  ASSERT_EQ(stats.recent[0].begin_ns + stats.recent[0].duration_ns,
+            stats.recent[1].begin_ns);
+  ResetPipelineStats();
+}
+
+} // namespace testing
+
+} // namespace calibu
@@ -0,0 +1,141 @@
+#include <gtest/gtest.h>
+#include <calibu/pose/Pnp.h>
+#include "test_util.h"
+
+namespace calibu
+{
+namespace testing
+{
+
+namespace
+{
+
+typedef std::vector<Eigen::Vector3d,
+                    Eigen::aligned_allocator<Eigen::Vector3d> > Points3d;
+typedef std::vector<Eigen::Vector2d,
+                    Eigen::aligned_allocator<Eigen::Vector2d> > Points2d;
+
+// Planar 8x6 grid of target points, 4cm apart
+Points3d MakeTarget()
+{
+  Points3d P_w;
+  for (int y = 0; y < 6; ++y)
+  {
+    for (int x = 0; x < 8; ++x)
+    {
+      P_w.push_back(Eigen::Vector3d(0.04 * x, 0.04 * y, 0));
+    }
+  }
+  return P_w;
+}
+
+// Oblique view of the middle of the target from about 50cm
+Sophus::SE3d MakePose()
+{
+  const Sophus::SO3d R = Sophus::SO3d::exp(Eigen::Vector3d(0.3, -0.2, 0.1));
+  const Eigen::Vector3d middle(0.14, 0.1, 0);
+  return Sophus::SE3d(R, Eigen::Vector3d(0.01, -0.02, 0.5) - R * middle);
+}
+
+// Every fourth candidate matched to the wrong target point
+std::vector<int> MakeCandidates(size_t n, int& num_good)
+{
+  std::vector<int> candidate_map(n);
+  num_good = 0;
+  for (size_t i = 0; i < n; ++i)
+  {
+    if (i % 4 == 1)
+    {
+      candidate_map[i] = (i + 9) % n;
+    }
+    else
+    {
+      candidate_map[i] = i;
+      ++num_good;
+    }
+  }
+  return candidate_map;
+}
+
+} // namespace
+
+TEST(PnpSolver, SolveWithOutliers)
+{
+  const std::shared_ptr<CameraInterface<double>> cam = CreateFovCamera();
+  const Points3d P_w = MakeTarget();
+  const Sophus::SE3d T_true = MakePose();
+  Points2d p_c;
+  for (const Eigen::Vector3d& P : P_w)
+  {
+    p_c.push_back(cam->Project(T_true * P));
+  }
+
+  int num_good;
+  std::vector<int> candidate_map = MakeCandidates(P_w.size(), num_good);
+  candidate_map[0] = -1; // unmatched conic
+  --num_good;
+
+  PnpSolver pnp;
+  Sophus::SE3d T_cw;
+  std::vector<int> inlier_map;
+  ASSERT_EQ(num_good, pnp.Solve(cam, p_c, P_w, candidate_map, T_cw, inlier_map));
+  ASSERT_LT((T_cw.matrix() - T_true.matrix()).norm(), 1E-8);
+
+  ASSERT_EQ(candidate_map.size(), inlier_map.size());
+  for (size_t i = 0; i < candidate_map.size(); ++i)
+  {
+    const bool good = candidate_map[i] == (int)i;
+    ASSERT_EQ(good ? (int)i : -1, inlier_map[i]) << "candidate " << i;
+  }
+
+  // Too few candidates leaves the pose unchanged
+  std::vector<int> few(candidate_map.size(), -1);
+  few[2] = 2;
+  few[3] = 3;
+  few[4] = 4;
+  Sophus::SE3d T_prior;
+  ASSERT_EQ(0, pnp.Solve(cam, p_c, P_w, few, T_prior, inlier_map));
+  ASSERT_EQ(Sophus::SE3d().matrix(), T_prior.matrix());
+}
+
+TEST(PnpSolver, RefineFromPrior)
+{
+  const std::shared_ptr<CameraInterface<double>> cam = CreateFovCamera();
+  const Points3d P_w = MakeTarget();
+  const Sophus::SE3d T_true = MakePose();
+  Points2d p_c;
+  for (const Eigen::Vector3d& P : P_w)
+  {
+    p_c.push_back(cam->Project(T_true * P));
+  }
+
+  int num_good;
+  const std::vector<int> candidate_map = MakeCandidates(P_w.size(), num_good);
+
+  // A prior reprojecting within robust_3pt_tol of the observations
+  Eigen::Matrix<double, 6, 1> dx;
+  dx << 5E-4, -5E-4, 1E-3, 1E-3, -5E-4, 5E-4;
+  const Sophus::SE3d T_prior = Sophus::SE3d::exp(dx) * T_true;
+
+  PnpSolver pnp;
+  std::vector<int> inlier_map;
+  Sophus::SE3d T_cw = T_prior;
+  ASSERT_EQ(num_good, pnp.Refine(cam, p_c, P_w, candidate_map, T_cw, inlier_map));
+  ASSERT_LT((T_cw.matrix() - T_true.matrix()).norm(), 1E-8);
+  for (size_t i = 0; i < candidate_map.size(); ++i)
+  {
+    const bool good = candidate_map[i] == (int)i;
+    ASSERT_EQ(good ? (int)i : -1, inlier_map[i]) << "candidate " << i;
+  }
+
+  // Failing min_inliers leaves the pose unchanged and reports no inliers
+  pnp.Params().min_inliers = num_good + 1;
+  T_cw = T_prior;
+  ASSERT_EQ(0, pnp.Refine(cam, p_c, P_w, candidate_map, T_cw, inlier_map));
+  ASSERT_EQ(T_prior.matrix(), T_cw.matrix());
+  for (int i : inlier_map) ASSERT_EQ(-1, i);
+}
+
+} // namespace testing
+
+} // namespace calibu
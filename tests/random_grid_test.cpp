@@ -0,0 +1,183 @@
+#include <gtest/gtest.h>
+#include <calibu/target/RandomGrid.h>
+
+#include <random>
+
+namespace calibu
+{
+namespace testing
+{
+
+// Observation of a block of M, with unobserved (-1) and flipped cells
+Eigen::MatrixXi Observe(const Eigen::MatrixXi& M, int r, int c, int rows,
+                        int cols, std::mt19937& rng)
+{
+  Eigen::MatrixXi m(rows, cols);
+  for (int i = 0; i < rows; ++i)
+  {
+    for (int j = 0; j < cols; ++j)
+    {
+      const bool inside = 0 <= r + i && r + i < M.rows() &&
+                          0 <= c + j && c + j < M.cols();
+      const int v = inside ? M(r + i, c + j) : (int)(rng() % 2);
+      const unsigned int roll = rng() % 10;
+      m(i, j) = roll == 0 ? -1 : (roll == 1 ? 1 - v : v);
+    }
+  }
+  return m;
+}
+
+TEST(RandomGrid, PackedHammingDistance)
+{
+  std::mt19937 rng(5);
+  const int sizes[][2] = { { 5, 5 }, { 10, 19 }, { 36, 25 }, { 7, 70 }, { 4, 130 } };
+  for (const auto& size : sizes)
+  {
+    const Eigen::MatrixXi M = MakePattern(size[0], size[1], 3);
+    const PackedPattern packed_M(M);
+    for (int trial = 0; trial < 20; ++trial)
+    {
+      const int rows = 1 + rng() % (size[0] + 2);
+      const int cols = 1 + rng() % (size[1] + 70);
+      const Eigen::MatrixXi m = Observe(M, 0, 0, rows, cols, rng);
+      const PackedPattern packed_m(m);
+      for (int r = -rows - 1; r <= size[0] + 1; ++r)
+      {
+        for (int c = -cols - 66; c <= size[1] + 66; c += 1 + rng() % 5)
+        {
+          ASSERT_EQ(HammingDistance(M, m, r, c),
+                    HammingDistance(packed_M, packed_m, r, c))
+              << "r " << r << " c " << c;
+        }
+      }
+    }
+  }
+}
+
+TEST(RandomGrid, PackedNumExactMatches)
+{
+  std::mt19937 rng(9);
+  const std::array<Eigen::MatrixXi, 4> PG = MakePatternGroup(10, 19, 71);
+  const PackedPatternGroup packed = PackGroup(PG);
+  for (int trial = 0; trial < 50; ++trial)
+  {
+    const int rows = 3 + rng() % 6;
+    const int cols = 3 + rng() % 8;
+    const Eigen::MatrixXi m = Observe(PG[rng() % 4], rng() % 6 - 2,
+                                      rng() % 12 - 2, rows, cols, rng);
+
+    // Reference scan over the unpacked patterns
+    int expected_score = std::numeric_limits<int>::max();
+    int expected_g = -1, expected_r = 0, expected_c = 0, expected_num = 0;
+    const int border = std::min(std::min(rows, cols) - 2, 2);
+    for (int g = 0; g < 4; ++g)
+    {
+      const Eigen::MatrixXi& M = PG[g];
+      for (int r = -border; r < 2 * border + M.rows() - rows; ++r)
+      {
+        for (int c = -border; c < 2 * border + M.cols() - cols; ++c)
+        {
+          const int hd = HammingDistance(M, m, r, c);
+          if (hd < expected_score)
+          {
+            expected_score = hd;
+            expected_g = g;
+            expected_r = r;
+            expected_c = c;
+          }
+          if (hd == 0) ++expected_num;
+        }
+      }
+    }
+
+    int bs, bg, br, bc;
+    ASSERT_EQ(expected_num, NumExactMatches(packed, PackedPattern(m), bs, bg, br, bc));
+    ASSERT_EQ(expected_score, bs);
+    ASSERT_EQ(expected_g, bg);
+    ASSERT_EQ(expected_r, br);
+    ASSERT_EQ(expected_c, bc);
+  }
+}
+
+// Reference AutoCorrelation and AutoCorrelationMinArea, matching every
+// window with NumExactMatches
+int AutoCorrelationReference(const std::array<Eigen::MatrixXi, 4>& PG,
+                             int minr, int minc, int& min_area)
+{
+  const Eigen::MatrixXi& M = PG[0];
+  const int R = M.rows();
+  const int C = M.cols();
+  int num_bad_matches = 0;
+  min_area = 0;
+  for (int nr = minr; nr < R; ++nr)
+  {
+    for (int nc = minc; nc < C; ++nc)
+    {
+      for (int r = 0; r < R - nr - 1; ++r)
+      {
+        for (int c = 0; c < C - nc - 1; ++c)
+        {
+          int bs, bg, br, bc;
+          const int num = NumExactMatches(PG, M.block(r, c, nr, nc), bs, bg, br, bc);
+          if (num > 1)
+          {
+            min_area = std::max(min_area, nr * nc + 1);
+          }
+          num_bad_matches += num - 1;
+        }
+      }
+    }
+  }
+  return num_bad_matches;
+}
+
+TEST(RandomGrid, AutoCorrelationMinArea)
+{
+  const int sizes[][2] = { { 5, 5 }, { 6, 9 }, { 10, 19 }, { 4, 70 } };
+  for (const auto& size : sizes)
+  {
+    for (uint32_t seed = 0; seed < 4; ++seed)
+    {
+      const std::array<Eigen::MatrixXi, 4> PG =
+          MakePatternGroup(size[0], size[1], seed);
+      int expected;
+      const int expected_bad = AutoCorrelationReference(PG, 2, 2, expected);
+      ASSERT_EQ(expected, AutoCorrelationMinArea(PG))
+          << size[0] << "x" << size[1] << " seed " << seed;
+      ASSERT_EQ(expected_bad, AutoCorrelation(PG));
+
+      int unused;
+      ASSERT_EQ(AutoCorrelationReference(PG, 3, 4, unused),
+                AutoCorrelation(PG, 3, 4));
+
+      // Bounded searches stop early, at or above the bound
+      ASSERT_EQ(expected, AutoCorrelationMinArea(PG, expected + 1));
+      ASSERT_LE(expected, AutoCorrelationMinArea(PG, expected));
+    }
+  }
+}
+
+TEST(RandomGrid, FindBestSeed)
+{
+  int best_score = std::numeric_limits<int>::max();
+  uint32_t expected = 0;
+  for (uint32_t seed = 0; seed < 40; ++seed)
+  {
+    const int score = SeedScore(seed, 6, 9);
+    if (score < best_score)
+    {
+      best_score = score;
+      expected = seed;
+    }
+  }
+
+  bool should_run = true;
+  SeedSearchOptions options;
+  options.num_threads = 4;
+  options.max_seeds = 40;
+  ASSERT_EQ(expected, FindBestSeed(6, 9, should_run, options));
+}
+
+} // namespace testing
+
+} // namespace calibu
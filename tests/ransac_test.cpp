@@ -0,0 +1,139 @@
+#include <gtest/gtest.h>
+#include <calibu/pose/Ransac.h>
+
+#include <Eigen/Dense>
+#include <random>
+
+namespace calibu
+{
+namespace testing
+{
+
+typedef std::vector<Eigen::Vector2d, Eigen::aligned_allocator<Eigen::Vector2d>>
+    Points;
+
+// Least squares line y = a x + b through the given points
+Eigen::Vector2d FitLine(const std::vector<int>& indices, const Points* points)
+{
+  Eigen::MatrixXd A(indices.size(), 2);
+  Eigen::VectorXd y(indices.size());
+  for (size_t i = 0; i < indices.size(); ++i)
+  {
+    const Eigen::Vector2d& p = (*points)[indices[i]];
+    A.row(i) << p.x(), 1;
+    y[i] = p.y();
+  }
+  return A.colPivHouseholderQr().solve(y);
+}
+
+double LineError(const Eigen::Vector2d& line, int index, const Points* points)
+{
+  const Eigen::Vector2d& p = (*points)[index];
+  return std::abs(line[0] * p.x() + line[1] - p.y());
+}
+
+// Points on y = 2 x - 1, with every third replaced by an outlier
+Points LinePoints(int n)
+{
+  std::mt19937 rng(4);
+  std::uniform_real_distribution<double> uniform(-10, 10);
+  Points points;
+  for (int i = 0; i < n; ++i)
+  {
+    const double x = uniform(rng);
+    points.push_back(Eigen::Vector2d(x, i % 3 ? 2 * x - 1 : uniform(rng)));
+  }
+  return points;
+}
+
+TEST(Ransac, FitsLine)
+{
+  const Points points = LinePoints(300);
+  for (unsigned int threads : { 1u, 4u })
+  {
+    ParamsRansac params;
+    params.num_threads = threads;
+    Ransac<Eigen::Vector2d, 2, const Points*> ransac(FitLine, LineError,
+                                                     &points, params);
+    std::vector<int> inliers;
+    const Eigen::Vector2d line = ransac.Compute(points.size(), inliers, 1000,
+                                                1E-6, 10);
+    ASSERT_NEAR(2.0, line[0], 1E-9);
+    ASSERT_NEAR(-1.0, line[1], 1E-9);
+    ASSERT_EQ(200u, inliers.size());
+    for (int i : inliers) ASSERT_NE(0, i % 3);
+  }
+}
+
+TEST(Ransac, TooFewInliers)
+{
+  const Points points = LinePoints(30);
+  Ransac<Eigen::Vector2d, 2, const Points*> ransac(FitLine, LineError,
+                                                   &points);
+  std::vector<int> inliers;
+  ransac.Compute(points.size(), inliers, 100, 1E-6, 25);
+  ASSERT_TRUE(inliers.empty());
+}
+
+TEST(Ransac, Repeatable)
+{
+  // Noisy points, so the refit and the hypotheses differ
+  Points points = LinePoints(200);
+  for (size_t i = 0; i < points.size(); ++i)
+  {
+    points[i].y() += 0.01 * std::sin(3.0 * i);
+  }
+
+  std::vector<int> first_inliers;
+  Eigen::Vector2d first_line;
+  for (unsigned int threads : { 1u, 3u, 4u, 1u })
+  {
+    ParamsRansac params;
+    params.num_threads = threads;
+    params.seed = 7;
+    Ransac<Eigen::Vector2d, 2, const Points*> ransac(FitLine, LineError,
+                                                     &points, params);
+    std::vector<int> inliers;
+    const Eigen::Vector2d line = ransac.Compute(points.size(), inliers, 200,
+                                                0.015, 10);
+    ASSERT_FALSE(inliers.empty());
+    for (int i : inliers) ASSERT_LT(LineError(line, i, &points), 0.015);
+
+    if (first_inliers.empty())
+    {
+      first_inliers = inliers;
+      first_line = line;
+    }
+    ASSERT_EQ(first_inliers, inliers);
+    ASSERT_EQ(first_line, line);
+  }
+}
+
+TEST(Ransac, RandomStreams)
+{
+  RansacRandom a = RansacRandom::Stream(1, 0);
+  RansacRandom b = RansacRandom::Stream(1, 0);
+  RansacRandom c = RansacRandom::Stream(1, 1);
+  RansacRandom d = RansacRandom::Stream(2, 0);
+  const uint64_t x = a();
+  ASSERT_EQ(x, b());
+  ASSERT_NE(x, c());
+  ASSERT_NE(x, d());
+}
+
+TEST(Ransac, RandomInRange)
+{
+  RansacRandom rng(5);
+  std::vector<int> counts(7, 0);
+  for (int i = 0; i < 7000; ++i)
+  {
+    const unsigned int x = rng.Uniform(7);
+    ASSERT_LT(x, 7u);
+    ++counts[x];
+  }
+  for (int count : counts) ASSERT_GT(count, 800);
+}
+
+} // namespace testing
+
+} // namespace calibu
@@ -0,0 +1,302 @@
+#include <gtest/gtest.h>
+#include <calibu/cam/camera_models_crtp.h>
+#include <calibu/cam/lookup_table_cache.h>
+#include <calibu/cam/rectify_crtp.h>
+#include <calibu/cam/rectify_sparse.h>
+#include <cstdio>
+
+namespace calibu
+{
+namespace testing
+{
+
+std::shared_ptr<CameraInterface<double>> CreateRectifyCamera()
+{
+  Eigen::VectorXd params(5);
+  params << 300, 310, 160, 120, 0.9;
+  Eigen::Vector2i size(320, 240);
+  return std::make_shared<FovCamera<double>>(params, size);
+}
+
+std::vector<unsigned char> CreateRectifyImage(int width, int height)
+{
+  std::vector<unsigned char> image(width * height);
+
+  for (int y = 0; y < height; ++y)
+  {
+    for (int x = 0; x < width; ++x)
+    {
+      image[y * width + x] =
+          (unsigned char)(127.5 + 100 * sin(0.1 * x) * cos(0.07 * y));
+    }
+  }
+
+  return image;
+}
+
+TEST(Rectify, FixedPointWeights)
+{
+  LookupTable lut(320, 240);
+  CreateLookupTable(CreateRectifyCamera(), lut);
+  FixedPointLookupTable fixed(lut);
+
+  ASSERT_EQ(lut.Width(), fixed.Width());
+  ASSERT_EQ(lut.Height(), fixed.Height());
+
+  for (size_t i = 0; i < fixed.m_vLutPixels.size(); ++i)
+  {
+    const FixedPointLutPoint& p = fixed.m_vLutPixels[i];
+    const uint32_t sum = (p.w0 & 0xFFFF) + (p.w0 >> 16) +
+                         (p.w1 & 0xFFFF) + (p.w1 >> 16);
+
+    ASSERT_EQ(1u << kLutWeightBits, sum);
+    ASSERT_EQ(lut.m_vLutPixels[i].idx0, p.idx0);
+    ASSERT_EQ(lut.m_vLutPixels[i].idx1, p.idx1);
+  }
+}
+
+TEST(Rectify, FixedPointKernels)
+{
+  const int width = 320;
+  const int height = 240;
+  LookupTable lut(width, height);
+  CreateLookupTable(CreateRectifyCamera(), lut);
+  FixedPointLookupTable fixed(lut);
+  const std::vector<unsigned char> input = CreateRectifyImage(width, height);
+
+  std::vector<unsigned char> expected(width * height);
+  Rectify(fixed, input.data(), expected.data(), width, height,
+      RECTIFY_KERNEL_SCALAR);
+
+  std::vector<unsigned char> reference(width * height);
+  Rectify(lut, input.data(), reference.data(), width, height);
+
+  for (size_t i = 0; i < expected.size(); ++i)
+  {
+    ASSERT_NEAR(reference[i], expected[i], 1.0);
+  }
+
+  const RectifyKernel kernels[] = { RECTIFY_KERNEL_AUTO, RECTIFY_KERNEL_SSE2,
+      RECTIFY_KERNEL_AVX2, RECTIFY_KERNEL_NEON };
+
+  for (RectifyKernel kernel : kernels)
+  {
+    std::vector<unsigned char> output(width * height);
+    Rectify(fixed, input.data(), output.data(), width, height, kernel);
+    ASSERT_EQ(expected, output);
+  }
+}
+
+TEST(Rectify, Threads)
+{
+  const int width = 320;
+  const int height = 240;
+  std::shared_ptr<CameraInterface<double>> camera = CreateRectifyCamera();
+  const std::vector<unsigned char> input = CreateRectifyImage(width, height);
+
+  LookupTable serial_lut;
+  CreateLookupTable(camera, serial_lut);
+  std::vector<unsigned char> serial(width * height);
+  Rectify(serial_lut, input.data(), serial.data(), width, height);
+
+  for (unsigned int threads : { 0u, 2u, 7u })
+  {
+    LookupTable lut;
+    CreateLookupTable(camera, lut, 0, 0, threads);
+    ASSERT_EQ(serial_lut.Width(), lut.Width());
+    ASSERT_EQ(serial_lut.Height(), lut.Height());
+
+    for (size_t i = 0; i < lut.m_vLutPixels.size(); ++i)
+    {
+      ASSERT_EQ(serial_lut.m_vLutPixels[i].idx0, lut.m_vLutPixels[i].idx0);
+      ASSERT_EQ(serial_lut.m_vLutPixels[i].idx1, lut.m_vLutPixels[i].idx1);
+      ASSERT_EQ(serial_lut.m_vLutPixels[i].w00, lut.m_vLutPixels[i].w00);
+      ASSERT_EQ(serial_lut.m_vLutPixels[i].w11, lut.m_vLutPixels[i].w11);
+    }
+
+    std::vector<unsigned char> output(width * height);
+    Rectify(lut, input.data(), output.data(), width, height, 1, threads);
+    ASSERT_EQ(serial, output);
+
+    FixedPointLookupTable fixed(lut);
+    std::vector<unsigned char> fixed_serial(width * height);
+    std::vector<unsigned char> fixed_output(width * height);
+    Rectify(fixed, input.data(), fixed_serial.data(), width, height);
+    Rectify(fixed, input.data(), fixed_output.data(), width, height,
+        RECTIFY_KERNEL_AUTO, threads);
+    ASSERT_EQ(fixed_serial, fixed_output);
+  }
+}
+
+TEST(Rectify, Cache)
+{
+  const int width = 320;
+  const int height = 240;
+  std::shared_ptr<CameraInterface<double>> camera = CreateRectifyCamera();
+  const Eigen::Matrix3d R_onKinv = camera->K().inverse();
+
+  LookupTable expected;
+  CreateLookupTable(camera, R_onKinv, expected);
+
+  LookupTableCache cache(::testing::TempDir());
+  const uint64_t hash = LookupTableHash(camera, R_onKinv, 0, 0);
+  std::remove(cache.Filename(hash).c_str());
+
+  std::shared_ptr<const MappedLookupTable> created = cache.Get(camera, R_onKinv);
+  ASSERT_TRUE(created != nullptr);
+  ASSERT_EQ(hash, created->ParamsHash());
+  ASSERT_EQ(created, cache.Get(camera, R_onKinv));
+
+  MappedLookupTable mapped;
+  ASSERT_TRUE(mapped.Open(cache.Filename(hash)));
+  ASSERT_EQ(expected.Width(), mapped.Width());
+  ASSERT_EQ(expected.Height(), mapped.Height());
+  ASSERT_TRUE(R_onKinv == mapped.R_onKinv());
+
+  const std::vector<unsigned char> input = CreateRectifyImage(width, height);
+  std::vector<unsigned char> reference(width * height);
+  std::vector<unsigned char> output(width * height);
+  Rectify(expected, input.data(), reference.data(), width, height);
+  Rectify(mapped, input.data(), output.data(), width, height);
+  ASSERT_EQ(reference, output);
+
+  LookupTable filled;
+  cache.Fill(camera, R_onKinv, filled);
+  Rectify(filled, input.data(), output.data(), width, height);
+  ASSERT_EQ(reference, output);
+
+  Eigen::VectorXd params = camera->GetParams();
+  params[4] = 0.8;
+  camera->SetParams(params);
+  ASSERT_NE(hash, LookupTableHash(camera, R_onKinv, 0, 0));
+  std::remove(cache.Filename(hash).c_str());
+}
+
+TEST(Rectify, Sparse)
+{
+  const int width = 320;
+  const int height = 240;
+  std::shared_ptr<CameraInterface<double>> camera = CreateRectifyCamera();
+  const Eigen::Matrix3d R_onKinv = camera->K().inverse();
+
+  SparseLookupTable exact;
+  CreateSparseLookupTable(camera, R_onKinv, 1, exact);
+  ASSERT_EQ(width, exact.m_nGridWidth);
+  ASSERT_EQ(height, exact.m_nGridHeight);
+  ASSERT_NEAR(0, ComputeSparseLookupTableError(camera, R_onKinv, exact)
+      .max_error, 1E-4);
+
+  SparseLookupTable coarse;
+  CreateSparseLookupTable(camera, R_onKinv, 16, coarse, 0, 0, 3);
+  ASSERT_EQ(width, (int)coarse.Width());
+  ASSERT_EQ(height, (int)coarse.Height());
+  ASSERT_EQ(21, coarse.m_nGridWidth);
+  ASSERT_EQ(16, coarse.m_nGridHeight);
+
+  const SparseLookupTableError error =
+      ComputeSparseLookupTableError(camera, R_onKinv, coarse);
+  ASSERT_LT(error.rms_error, error.max_error + 1E-9);
+  ASSERT_LT(error.max_error, 1.0);
+
+  const std::vector<unsigned char> input = CreateRectifyImage(width, height);
+  LookupTable dense;
+  CreateLookupTable(camera, R_onKinv, dense);
+  std::vector<unsigned char> reference(width * height);
+  std::vector<unsigned char> output(width * height);
+  Rectify(dense, input.data(), reference.data(), width, height);
+  Rectify(coarse, input.data(), output.data(), width, height);
+
+  for (size_t i = 0; i < output.size(); ++i)
+  {
+    ASSERT_NEAR(reference[i], output[i], 1.0 + 20 * error.max_error);
+  }
+
+  const int step = ChooseSparseLookupTableStep(camera, R_onKinv,
+      error.max_error);
+  ASSERT_GE(step, 16);
+}
+
+TEST(Rectify, Channels)
+{
+  const int width = 320;
+  const int height = 240;
+  LookupTable lut;
+  CreateLookupTable(CreateRectifyCamera(), lut);
+  const std::vector<unsigned char> plane = CreateRectifyImage(width, height);
+
+  std::vector<unsigned char> expected(width * height);
+  Rectify(lut, plane.data(), expected.data(), width, height);
+
+  for (int channels : { 2, 3, 4, 5 })
+  {
+    std::vector<unsigned char> input(width * height * channels);
+    for (size_t i = 0; i < input.size(); ++i)
+    {
+      input[i] = i % channels == 1 ? 255 - plane[i / channels]
+                                   : plane[i / channels];
+    }
+
+    std::vector<unsigned char> output(width * height * channels);
+    Rectify(lut, input.data(), output.data(), width, height, channels);
+
+    for (size_t i = 0; i < expected.size(); ++i)
+    {
+      ASSERT_EQ(expected[i], output[i * channels]);
+      ASSERT_NEAR(255 - expected[i], output[i * channels + 1], 1);
+      if (channels > 2)
+      {
+        ASSERT_EQ(expected[i], output[(i + 1) * channels - 1]);
+      }
+    }
+  }
+}
+
+TEST(Rectify, Rounding)
+{
+  const int width = 320;
+  const int height = 240;
+  LookupTable lut;
+  CreateLookupTable(CreateRectifyCamera(), lut);
+
+  std::vector<unsigned short> saturated(width * height, 65535);
+  std::vector<unsigned short> output(width * height);
+  Rectify(lut, saturated.data(), output.data(), width, height);
+  ASSERT_EQ(saturated, output);
+
+  std::vector<float> ramp(width * height);
+  std::vector<unsigned short> ramp16(width * height);
+  for (size_t i = 0; i < ramp.size(); ++i)
+  {
+    ramp16[i] = (unsigned short)(i % width * 200);
+    ramp[i] = ramp16[i];
+  }
+
+  std::vector<float> exact(width * height);
+  Rectify(lut, ramp.data(), exact.data(), width, height);
+  Rectify(lut, ramp16.data(), output.data(), width, height);
+
+  for (size_t i = 0; i < exact.size(); ++i)
+  {
+    ASSERT_NEAR(exact[i], output[i], 0.5 + 1E-2);
+  }
+
+  ASSERT_EQ(0, RectifyPixel<unsigned char>::Convert(-3.0f));
+  ASSERT_EQ(255, RectifyPixel<unsigned char>::Convert(300.0f));
+  ASSERT_EQ(3, RectifyPixel<unsigned char>::Convert(2.5f));
+  ASSERT_EQ(2, RectifyPixel<unsigned char>::Convert(2.49f));
+  ASSERT_EQ(-3, RectifyPixel<short>::Convert(-2.5f));
+  ASSERT_EQ(std::numeric_limits<int>::max(),
+            RectifyPixel<int>::Convert(3e9f));
+  ASSERT_EQ(std::numeric_limits<int>::min(),
+            RectifyPixel<int>::Convert(-3e9f));
+  ASSERT_EQ(std::numeric_limits<unsigned int>::max(),
+            RectifyPixel<unsigned int>::Convert(5e9f));
+  ASSERT_EQ(std::numeric_limits<int64_t>::max(),
+            RectifyPixel<int64_t>::Convert(1e19f));
+  ASSERT_EQ(-3, RectifyPixel<int>::Convert(-2.5f));
+  ASSERT_FLOAT_EQ(2.49f, RectifyPixel<float>::Convert(2.49f));
+}
+
+} // namespace testing
+
+} // namespace calibu
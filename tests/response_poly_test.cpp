@@ -112,6 +112,37 @@ TEST(Poly3Response, Response)
 #endif
 }
 
+TEST(Poly3Response, Evaluate)
+{
+  Poly3Response<double> response;
+  response.SetParams(Eigen::Vector3d(0.5, -0.1, 2.1));
+  const Response<double>& base = response;
+
+  std::vector<double> values(300);
+  for (size_t i = 0; i < values.size(); ++i) values[i] = i / 299.0;
+
+  std::vector<double> out(values.size());
+  base.Evaluate(values.data(), out.data(), values.size());
+
+  for (size_t i = 0; i < values.size(); ++i)
+  {
+    ASSERT_DOUBLE_EQ(response(values[i]), out[i]);
+  }
+
+  // evaluation in place
+  base.Evaluate(values.data(), values.data(), values.size());
+  ASSERT_TRUE(values == out);
+
+  std::vector<float> in(values.size()), applied(values.size());
+  for (size_t i = 0; i < in.size(); ++i) in[i] = i / 299.0f;
+  response.Apply(in.data(), applied.data(), in.size());
+
+  for (size_t i = 0; i < in.size(); ++i)
+  {
+    ASSERT_FLOAT_EQ(response(in[i]), applied[i]);
+  }
+}
+
 TEST(Poly3Response, Reset)
 {
   Poly3Response<double> response;
@@ -138,6 +169,66 @@ TEST(Poly3Response, Reset)
   ASSERT_DOUBLE_EQ(0, params[2]);
 }
 
+TEST(Poly3Response, BakeLUT)
+{
+  Poly3Response<double> response;
+  response.SetRange(0, 1023);
+  response.SetParams(Eigen::Vector3d(0.5, 1E-3, 2E-6));
+  ASSERT_EQ(0, response.LUTBits());
+  ASSERT_TRUE(response.GetLUT().empty());
+
+  response.BakeLUT(10);
+  ASSERT_EQ(10, response.LUTBits());
+  ASSERT_EQ(1024, response.GetLUT().size());
+
+  std::vector<uint16_t> in(2048);
+  std::vector<float> out(in.size());
+
+  for (size_t i = 0; i < in.size(); ++i)
+  {
+    in[i] = i;
+  }
+
+  response.Apply(in.data(), out.data(), in.size());
+
+  for (size_t i = 0; i < in.size(); ++i)
+  {
+    const double expected = response(std::min<double>(i, 1023));
+    ASSERT_NEAR(expected, out[i], 1E-6 * expected);
+  }
+
+  // table follows parameter, range and reset changes
+  response.SetParams(Eigen::Vector3d(0.25, 0, 0));
+  ASSERT_FLOAT_EQ(0.25 * 100, response.GetLUT()[100]);
+  response.SetRange(0, 50);
+  ASSERT_FLOAT_EQ(0.25 * 50, response.GetLUT()[100]);
+  response.Reset();
+  ASSERT_FLOAT_EQ(50, response.GetLUT()[100]);
+
+  std::vector<float> values = { 0.5f, 10.25f };
+  response.Apply(values.data(), out.data(), values.size());
+  ASSERT_FLOAT_EQ(0.5f, out[0]);
+  ASSERT_FLOAT_EQ(10.25f, out[1]);
+
+  // negative signed intensities map to the first entry
+  std::vector<int16_t> signed_in = { -1, -32768, 0, 20, 2000 };
+  response.Apply(signed_in.data(), out.data(), signed_in.size());
+  ASSERT_FLOAT_EQ(response.GetLUT()[0], out[0]);
+  ASSERT_FLOAT_EQ(response.GetLUT()[0], out[1]);
+  ASSERT_FLOAT_EQ(response.GetLUT()[0], out[2]);
+  ASSERT_FLOAT_EQ(response.GetLUT()[20], out[3]);
+  ASSERT_FLOAT_EQ(response.GetLUT().back(), out[4]);
+
+  response.ClearLUT();
+  ASSERT_EQ(0, response.LUTBits());
+  ASSERT_TRUE(response.GetLUT().empty());
+
+#ifndef NDEBUG
+  ASSERT_THROW(response.BakeLUT(0), Exception);
+  ASSERT_THROW(response.BakeLUT(17), Exception);
+#endif
+}
+
 TEST(Poly4Response, Constructor)
 {
   Poly4Response<double> response;
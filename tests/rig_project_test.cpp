@@ -0,0 +1,115 @@
+#include <gtest/gtest.h>
+#include <calibu/cam/camera_models_crtp.h>
+#include <calibu/cam/rig_project.h>
+
+#include <random>
+
+namespace calibu
+{
+namespace testing
+{
+
+// A pinhole-like and a fisheye camera, the second looking sideways
+std::shared_ptr<Rig<double>> CreateMixedRig()
+{
+  std::shared_ptr<Rig<double>> rig(new Rig<double>());
+  Eigen::Vector2i size(320, 240);
+
+  Eigen::VectorXd linear(4);
+  linear << 300, 300, 160, 120;
+  std::shared_ptr<CameraInterface<double>> front =
+      std::make_shared<LinearCamera<double>>(linear, size);
+  rig->AddCamera(front);
+
+  Eigen::VectorXd kb4(8);
+  kb4 << 80, 80, 160, 120, 0, 0, 0, 0;
+  std::shared_ptr<CameraInterface<double>> side =
+      std::make_shared<KannalaBrandtCamera<double>>(kb4, size);
+  const Eigen::Quaterniond q(Eigen::AngleAxisd(M_PI / 2, Eigen::Vector3d::UnitY()));
+  side->SetPose(Sophus::SE3d(q, Eigen::Vector3d(0.1, 0, 0)));
+  rig->AddCamera(side);
+
+  return rig;
+}
+
+std::vector<Eigen::Vector3d, Eigen::aligned_allocator<Eigen::Vector3d>>
+RandomPoints(size_t count)
+{
+  std::mt19937 rng(7);
+  std::uniform_real_distribution<double> coord(-10, 10);
+  std::vector<Eigen::Vector3d, Eigen::aligned_allocator<Eigen::Vector3d>> P_r;
+  for (size_t i = 0; i < count; ++i)
+  {
+    P_r.push_back(Eigen::Vector3d(coord(rng), coord(rng), coord(rng)));
+  }
+  return P_r;
+}
+
+TEST(RigProjector, MatchesPerPointProjection)
+{
+  std::shared_ptr<Rig<double>> rig = CreateMixedRig();
+  const auto P_r = RandomPoints(5000);
+
+  RigProjector projector;
+  projector.Init(rig, 0.5, 12.0);
+  ASSERT_EQ(2u, projector.NumCams());
+  ASSERT_LT(projector.HalfFov(0), M_PI / 2);
+  ASSERT_GT(projector.HalfFov(1), M_PI / 2);
+
+  std::vector<std::vector<RigProjection>> projections;
+  projector.Project(P_r, projections, 2);
+  ASSERT_EQ(2u, projections.size());
+
+  for (size_t c = 0; c < rig->NumCams(); ++c)
+  {
+    const CameraInterface<double>& cam = *rig->cameras_[c];
+    const Sophus::SE3d T_cr = cam.Pose().inverse();
+
+    // Points seen, found one at a time
+    std::vector<RigProjection> expected;
+    for (size_t i = 0; i < P_r.size(); ++i)
+    {
+      const Eigen::Vector3d P_c = T_cr * P_r[i];
+      const double range = P_c.norm();
+      if (range < 0.5 || range > 12.0)
+      {
+        continue;
+      }
+      // The linear camera only sees points in front of it
+      if (c == 0 && P_c[2] <= 0)
+      {
+        continue;
+      }
+      const Eigen::Vector2d pix = cam.Project(P_c);
+      if (pix[0] >= 0 && pix[1] >= 0 && pix[0] <= cam.Width() - 1 &&
+          pix[1] <= cam.Height() - 1)
+      {
+        expected.push_back(RigProjection{(uint32_t)i, pix[0], pix[1]});
+      }
+    }
+
+    ASSERT_GT(expected.size(), 100u);
+    ASSERT_EQ(expected.size(), projections[c].size());
+    for (size_t k = 0; k < expected.size(); ++k)
+    {
+      ASSERT_EQ(expected[k].index, projections[c][k].index);
+      ASSERT_NEAR(expected[k].u, projections[c][k].u, 1E-9);
+      ASSERT_NEAR(expected[k].v, projections[c][k].v, 1E-9);
+    }
+  }
+}
+
+TEST(RigProjector, Empty)
+{
+  RigProjector projector;
+  projector.Init(CreateMixedRig());
+  std::vector<std::vector<RigProjection>> projections(5);
+  projector.Project(nullptr, 0, projections);
+  ASSERT_EQ(2u, projections.size());
+  ASSERT_TRUE(projections[0].empty());
+  ASSERT_TRUE(projections[1].empty());
+}
+
+} // namespace testing
+
+} // namespace calibu
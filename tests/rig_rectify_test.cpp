@@ -0,0 +1,86 @@
+#include <gtest/gtest.h>
+#include <calibu/cam/camera_models_crtp.h>
+#include <calibu/cam/rig_rectify.h>
+
+namespace calibu
+{
+namespace testing
+{
+
+std::shared_ptr<Rig<double>> CreateTrinocularRig()
+{
+  std::shared_ptr<Rig<double>> rig(new Rig<double>());
+  const double u0[3] = { 160, 165, 158 };
+  const double angle[3] = { 0.0, 0.02, -0.015 };
+
+  Eigen::Vector2i size(320, 240);
+
+  for (int i = 0; i < 3; ++i)
+  {
+    Eigen::VectorXd params(5);
+    params << 300, 310, u0[i], 120, 0.9;
+    std::shared_ptr<CameraInterface<double>> cam =
+        std::make_shared<FovCamera<double>>(params, size);
+
+    const Eigen::Quaterniond q(
+        Eigen::AngleAxisd(angle[i], Eigen::Vector3d(1, 2, 3).normalized()));
+    cam->SetPose(Sophus::SE3d(q, Eigen::Vector3d(0.1 * i, 0.002 * i, 0)));
+    rig->AddCamera(cam);
+  }
+
+  return rig;
+}
+
+// Source image position sampled by a lookup table entry
+Eigen::Vector2d RigLutSource(const LookupTable& lut, int width, int row,
+                             int col)
+{
+  const BilinearLutPoint& p = lut.m_vLutPixels[row * lut.Width() + col];
+  return Eigen::Vector2d(p.idx0 % width + p.w01 + p.w11,
+                         p.idx0 / width + p.w10 + p.w11);
+}
+
+TEST(RigRectifier, Scanlines)
+{
+  const std::shared_ptr<Rig<double>> rig = CreateTrinocularRig();
+
+  RigRectifier rectifier;
+  rectifier.Init(rig, nullptr, 2);
+  ASSERT_EQ(3u, rectifier.NumCams());
+  ASSERT_EQ(320, rectifier.Width());
+  ASSERT_EQ(240, rectifier.Height());
+
+  const std::shared_ptr<Rig<double>>& rect = rectifier.RectifiedRig();
+  ASSERT_EQ(3u, rect->NumCams());
+  for (size_t i = 0; i < rect->NumCams(); ++i)
+  {
+    ASSERT_TRUE(rect->cameras_[i]->GetParams() == rect->cameras_[0]->GetParams());
+    ASSERT_TRUE(rect->cameras_[i]->Pose().translation() ==
+                rig->cameras_[i]->Pose().translation());
+  }
+
+  // Centers lie on a line, so rays through matching rows of any two
+  // rectified images must intersect
+  for (int j = 1; j < 3; ++j)
+  {
+    const Sophus::SE3d& T_r0 = rig->cameras_[0]->Pose();
+    const Sophus::SE3d& T_rj = rig->cameras_[j]->Pose();
+    const Eigen::Vector3d baseline = T_rj.translation() - T_r0.translation();
+
+    for (int row = 20; row < 240; row += 50)
+    {
+      for (int col = 60; col < 320; col += 60)
+      {
+        const Eigen::Vector3d a = T_r0.so3() * rig->cameras_[0]->Unproject(
+            RigLutSource(rectifier.GetLookupTable(0), 320, row, col));
+        const Eigen::Vector3d b = T_rj.so3() * rig->cameras_[j]->Unproject(
+            RigLutSource(rectifier.GetLookupTable(j), 320, row, col - 20));
+        ASSERT_NEAR(0, a.cross(b).normalized().dot(baseline), 1e-4);
+      }
+    }
+  }
+}
+
+} // namespace testing
+
+} // namespace calibu
@@ -0,0 +1,117 @@
+#include <gtest/gtest.h>
+#include <calibu/cam/camera_models_crtp.h>
+#include <calibu/pose/RigTracker.h>
+#include <calibu/target/TargetRenderer.h>
+
+namespace calibu
+{
+namespace testing
+{
+
+namespace
+{
+
+// Exposes the joint rig pose estimation of RigTracker
+class RigTrackerProbe : public RigTracker
+{
+public:
+  using RigTracker::RigTracker;
+  using RigTracker::RefineRigPose;
+  using RigTracker::UpdateInliers;
+};
+
+std::shared_ptr<CameraInterface<double>> CreateRigCamera(
+    const Sophus::SE3d& T_rc)
+{
+  Eigen::VectorXd params(5);
+  params << 400, 400, 320, 240, 0.9;
+  Eigen::Vector2i size(640, 480);
+  std::shared_ptr<CameraInterface<double>> cam =
+      std::make_shared<FovCamera<double>>(params, size);
+  cam->SetPose(T_rc);
+  return cam;
+}
+
+// Stereo pair 6cm apart, the second camera slightly rotated
+std::shared_ptr<Rig<double>> CreateRig()
+{
+  std::shared_ptr<Rig<double>> rig = std::make_shared<Rig<double>>();
+  rig->AddCamera(CreateRigCamera(Sophus::SE3d()));
+  rig->AddCamera(CreateRigCamera(Sophus::SE3d(
+      Sophus::SO3d::exp(Eigen::Vector3d(0.01, -0.05, 0.02)),
+      Eigen::Vector3d(0.06, 0, 0))));
+  return rig;
+}
+
+// Rig facing the middle of the target from 25cm
+Sophus::SE3d CreateRigPose(const TargetGridDot& target)
+{
+  const Eigen::Vector2i& size = target.GridSize();
+  const Eigen::Vector3d middle = 0.5 * target.GridSpacing() *
+      Eigen::Vector3d(size[0] - 1, size[1] - 1, 0);
+  const Sophus::SO3d R = Sophus::SO3d::exp(Eigen::Vector3d(0.1, 0.05, 0));
+  return Sophus::SE3d(R, Eigen::Vector3d(-0.03, 0, 0.25) - R * middle);
+}
+
+} // namespace
+
+TEST(RigTracker, RecoversRigPose)
+{
+  TargetGridDot target("small");
+  const std::shared_ptr<Rig<double>> rig = CreateRig();
+  const Sophus::SE3d T_rw = CreateRigPose(target);
+
+  TargetRenderer renderer(target);
+  std::vector<std::vector<unsigned char>> images(2);
+  std::vector<std::vector<RenderedDot>> dots(2);
+  std::vector<const unsigned char*> image_ptrs;
+  for (size_t c = 0; c < 2; ++c)
+  {
+    const Sophus::SE3d T_cw = rig->cameras_[c]->Pose().inverse() * T_rw;
+    renderer.Render(rig->cameras_[c], T_cw, images[c], dots[c]);
+    image_ptrs.push_back(images[c].data());
+  }
+
+  RigTrackerProbe tracker(target, rig);
+  ASSERT_TRUE(tracker.ProcessFrames(image_ptrs, { 640, 640 }));
+  ASSERT_LT((tracker.PoseT_rw().matrix() - T_rw.matrix()).norm(), 1E-3);
+
+  // Each camera's inliers are conics at the rendered dots they are mapped to
+  int expected_inliers = 0;
+  for (size_t c = 0; c < 2; ++c)
+  {
+    const std::vector<int>& map = tracker.ConicsTargetMap(c);
+    const ConicSet& conics = tracker.GetConicFinder(c).Conics();
+    int mapped = 0;
+    for (size_t i = 0; i < map.size(); ++i)
+    {
+      if (map[i] < 0) continue;
+      ASSERT_LT((conics.Center(i) - dots[c][map[i]].center).norm(), 0.5);
+      ++mapped;
+    }
+    ASSERT_GT(mapped, 20) << "camera " << c;
+    expected_inliers += mapped;
+  }
+
+  // The joint refinement converges back from a rig pose reprojecting within
+  // robust_3pt_inlier_tol, and counts the inliers of both cameras
+  Eigen::Matrix<double, 6, 1> dx;
+  dx << 2E-4, -2E-4, 1E-4, 5E-4, -3E-4, 3E-4;
+  Sophus::SE3d T = Sophus::SE3d::exp(dx) * tracker.PoseT_rw();
+  tracker.RefineRigPose(T);
+  ASSERT_LT((T.matrix() - tracker.PoseT_rw().matrix()).norm(), 1E-6);
+
+  int inliers = 0;
+  const double rms = tracker.UpdateInliers(T, inliers);
+  ASSERT_EQ(expected_inliers, inliers);
+  ASSERT_LT(rms, 0.2);
+
+  // No inliers far from the target's pose
+  const Sophus::SE3d T_far(Sophus::SO3d(), Eigen::Vector3d(5, 5, 1));
+  ASSERT_FALSE(std::isfinite(tracker.UpdateInliers(T_far, inliers)));
+  ASSERT_EQ(0, inliers);
+}
+
+} // namespace testing
+
+} // namespace calibu
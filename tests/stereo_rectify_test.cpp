@@ -0,0 +1,114 @@
+#include <gtest/gtest.h>
+#include <calibu/cam/camera_models_crtp.h>
+#include <calibu/cam/stereo_rectify.h>
+
+namespace calibu
+{
+namespace testing
+{
+
+std::shared_ptr<CameraInterface<double>> CreateStereoCamera(double u0)
+{
+  Eigen::VectorXd params(5);
+  params << 300, 310, u0, 120, 0.9;
+  Eigen::Vector2i size(320, 240);
+  return std::make_shared<FovCamera<double>>(params, size);
+}
+
+Sophus::SE3d CreateStereoExtrinsics()
+{
+  const Eigen::Quaterniond q(
+      Eigen::AngleAxisd(0.02, Eigen::Vector3d(1, 2, 3).normalized()));
+  return Sophus::SE3d(q, Eigen::Vector3d(-0.12, 0.004, 0.002));
+}
+
+// Source image position sampled by a lookup table entry
+Eigen::Vector2d LutSource(const LookupTable& lut, int width, int row, int col)
+{
+  const BilinearLutPoint& p = lut.m_vLutPixels[row * lut.Width() + col];
+  return Eigen::Vector2d(p.idx0 % width + p.w01 + p.w11,
+                         p.idx0 / width + p.w10 + p.w11);
+}
+
+TEST(StereoRectifier, Epipolar)
+{
+  const std::shared_ptr<CameraInterface<double>> left = CreateStereoCamera(160);
+  const std::shared_ptr<CameraInterface<double>> right = CreateStereoCamera(165);
+  const Sophus::SE3d T_rl = CreateStereoExtrinsics();
+
+  StereoRectifier rectifier;
+  rectifier.Init(T_rl, left, right, nullptr, 2);
+  ASSERT_EQ(320, rectifier.Width());
+  ASSERT_EQ(240, rectifier.Height());
+  ASSERT_EQ(2u, rectifier.RectifiedRig()->NumCams());
+
+  const Sophus::SE3d& T_nr_nl = rectifier.T_nr_nl();
+  ASSERT_NEAR(-T_rl.translation().norm(), T_nr_nl.translation()[0], 1e-12);
+  ASSERT_TRUE(rectifier.RectifiedRig()->cameras_[1]->Pose().translation() ==
+              T_nr_nl.translation());
+
+  // Rays through matching rows of both rectified images must intersect
+  const Sophus::SE3d T_lr = T_rl.inverse();
+  for (int row = 20; row < 240; row += 50)
+  {
+    for (int col = 40; col < 320; col += 60)
+    {
+      const Eigen::Vector3d a = left->Unproject(
+          LutSource(rectifier.LeftLookupTable(), 320, row, col));
+      const Eigen::Vector3d b = T_lr.so3() * right->Unproject(
+          LutSource(rectifier.RightLookupTable(), 320, row, col - 20));
+      const Eigen::Vector3d n = a.cross(b).normalized();
+      ASSERT_NEAR(0, n.dot(T_lr.translation()), 1e-4);
+    }
+  }
+}
+
+TEST(StereoRectifier, Layouts)
+{
+  const std::shared_ptr<CameraInterface<double>> left = CreateStereoCamera(160);
+  const std::shared_ptr<CameraInterface<double>> right = CreateStereoCamera(165);
+
+  StereoRectifier rectifier;
+  rectifier.Init(CreateStereoExtrinsics(), left, right, nullptr, 1);
+  const int w = rectifier.Width();
+  const int h = rectifier.Height();
+
+  std::vector<float> left_image(2 * w * h), right_image(2 * w * h);
+  for (size_t i = 0; i < left_image.size(); ++i)
+  {
+    left_image[i] = float(sin(0.01 * i));
+    right_image[i] = float(cos(0.02 * i));
+  }
+
+  std::vector<float> left_rect(2 * w * h), right_rect(2 * w * h);
+  Rectify(rectifier.LeftLookupTable(), left_image.data(), left_rect.data(),
+          w, h, 2);
+  Rectify(rectifier.RightLookupTable(), right_image.data(), right_rect.data(),
+          w, h, 2);
+
+  std::vector<float> sbs(4 * w * h), interleaved(4 * w * h);
+  rectifier.Rectify(left_image.data(), right_image.data(), sbs.data(),
+                    STEREO_SIDE_BY_SIDE, 2, 3);
+  rectifier.Rectify(left_image.data(), right_image.data(), interleaved.data(),
+                    STEREO_INTERLEAVED, 2, 3);
+
+  for (int y = 0; y < h; ++y)
+  {
+    for (int x = 0; x < w; ++x)
+    {
+      for (int c = 0; c < 2; ++c)
+      {
+        const float l = left_rect[2 * (y * w + x) + c];
+        const float r = right_rect[2 * (y * w + x) + c];
+        ASSERT_EQ(l, sbs[4 * y * w + 2 * x + c]);
+        ASSERT_EQ(r, sbs[4 * y * w + 2 * (w + x) + c]);
+        ASSERT_EQ(l, interleaved[4 * (y * w + x) + c]);
+        ASSERT_EQ(r, interleaved[4 * (y * w + x) + 2 + c]);
+      }
+    }
+  }
+}
+
+} // namespace testing
+
+} // namespace calibu
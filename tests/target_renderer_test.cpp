@@ -0,0 +1,118 @@
+#include <gtest/gtest.h>
+#include <calibu/cam/camera_models_crtp.h>
+#include <calibu/pcalib/vignetting_poly.h>
+#include <calibu/target/TargetRenderer.h>
+
+namespace calibu
+{
+namespace testing
+{
+
+std::shared_ptr<CameraInterface<double>> CreateRenderCamera()
+{
+  Eigen::VectorXd params(5);
+  params << 400, 400, 320, 240, 0.9;
+  Eigen::Vector2i size(640, 480);
+  return std::make_shared<FovCamera<double>>(params, size);
+}
+
+// Camera facing the middle of the target from 'distance' in front of it
+Sophus::SE3d CreateRenderPose(const TargetGridDot& target, double distance)
+{
+  const Eigen::Vector2i& size = target.GridSize();
+  const Eigen::Vector3d middle = 0.5 * target.GridSpacing() *
+      Eigen::Vector3d(size[0] - 1, size[1] - 1, 0);
+  return Sophus::SE3d(Eigen::Matrix3d::Identity(),
+                      -middle + Eigen::Vector3d(0, 0, distance));
+}
+
+TEST(TargetRenderer, GroundTruth)
+{
+  const TargetGridDot target("small");
+  const std::shared_ptr<CameraInterface<double>> cam = CreateRenderCamera();
+  const Sophus::SE3d T_cw = CreateRenderPose(target, 0.25);
+
+  TargetRenderer renderer(target);
+  std::vector<unsigned char> image;
+  std::vector<RenderedDot> dots;
+  renderer.Render(cam, T_cw, image, dots);
+  ASSERT_EQ(640u * 480u, image.size());
+  ASSERT_EQ(target.Circles3D().size(), dots.size());
+
+  for (const RenderedDot& dot : dots)
+  {
+    ASSERT_TRUE(dot.visible);
+    const Eigen::Vector2d expected =
+        cam->Project(T_cw * target.Circles3D()[dot.index]);
+    ASSERT_NEAR(0, (expected - dot.center).norm(), 1e-9);
+
+    // Dark at the center, fully for large dots, and bright half a grid
+    // cell away
+    const int x = (int)(dot.center[0] + 0.5);
+    const int y = (int)(dot.center[1] + 0.5);
+    if (target.CircleRadius(dot.index) > target.CircleRadius())
+    {
+      ASSERT_EQ(30, image[y * 640 + x]);
+    }
+    ASSERT_LT(image[y * 640 + x], 150);
+    const Eigen::Vector3d between = target.Circles3D()[dot.index] +
+        Eigen::Vector3d(0.5, 0.5, 0) * target.GridSpacing();
+    const Eigen::Vector2d b = cam->Project(T_cw * between);
+    ASSERT_EQ(230, image[(int)(b[1] + 0.5) * 640 + (int)(b[0] + 0.5)]);
+  }
+
+  // Edges are anti-aliased
+  std::vector<float> coverage;
+  renderer.RenderCoverage(cam, T_cw, coverage);
+  int partial = 0;
+  for (float c : coverage)
+  {
+    partial += (c > 0 && c < 1);
+  }
+  ASSERT_GT(partial, 100);
+}
+
+TEST(TargetRenderer, Degradations)
+{
+  const TargetGridDot target("small");
+  const std::shared_ptr<CameraInterface<double>> cam = CreateRenderCamera();
+  const Sophus::SE3d T_cw = CreateRenderPose(target, 0.25);
+
+  TargetRenderer renderer(target);
+  std::vector<unsigned char> clean, degraded;
+  std::vector<RenderedDot> dots;
+  renderer.Render(cam, T_cw, clean, dots);
+
+  renderer.Params().blur_sigma = 1.0;
+  renderer.Params().noise_sigma = 3.0;
+  renderer.Params().num_threads = 2;
+  std::shared_ptr<EvenPoly6Vignetting<double>> vignetting =
+      std::make_shared<EvenPoly6Vignetting<double>>(640, 480);
+  Eigen::Vector3d params(-0.3, 0, 0);
+  vignetting->SetParams(params);
+  renderer.Params().vignetting = vignetting;
+  renderer.Render(cam, T_cw, degraded, dots);
+
+  // Center is unchanged by vignetting, corners darker
+  double center = 0, corner = 0;
+  for (int y = 0; y < 8; ++y)
+  {
+    for (int x = 0; x < 8; ++x)
+    {
+      center += degraded[(236 + y) * 640 + 316 + x] -
+                clean[(236 + y) * 640 + 316 + x];
+      corner += degraded[y * 640 + x] - clean[y * 640 + x];
+    }
+  }
+  ASSERT_NEAR(0, center / 64, 8);
+  ASSERT_LT(corner / 64, -30);
+
+  // Same seed renders the same image
+  std::vector<unsigned char> again;
+  renderer.Render(cam, T_cw, again, dots);
+  ASSERT_EQ(degraded, again);
+}
+
+} // namespace testing
+
+} // namespace calibu
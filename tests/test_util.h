@@ -0,0 +1,23 @@
+#pragma once
+
+#include <memory>
+
+#include <calibu/cam/camera_models_crtp.h>
+
+namespace calibu
+{
+namespace testing
+{
+
+// FOV camera over a 640x480 image
+inline std::shared_ptr<CameraInterface<double>> CreateFovCamera()
+{
+  Eigen::VectorXd params(5);
+  params << 300, 300, 320, 240, 0.9;
+  Eigen::Vector2i size(640, 480);
+  return std::make_shared<FovCamera<double>>(params, size);
+}
+
+} // namespace testing
+
+} // namespace calibu
@@ -0,0 +1,94 @@
+#include <gtest/gtest.h>
+#include <calibu/cam/camera_models_crtp.h>
+
+#include <random>
+
+namespace calibu
+{
+namespace testing
+{
+
+std::shared_ptr<CameraInterface<double>> CreateKb4Camera()
+{
+  Eigen::VectorXd params(8);
+  params << 300, 300, 320, 240, 0.1, 0.01, 0.001, 0.0001;
+  Eigen::Vector2i size(640, 480);
+  return std::make_shared<KannalaBrandtCamera<double>>(params, size);
+}
+
+std::shared_ptr<CameraInterface<double>> CreatePoly3Camera()
+{
+  Eigen::VectorXd params(7);
+  params << 300, 300, 320, 240, -0.05, 0.01, -0.001;
+  Eigen::Vector2i size(640, 480);
+  return std::make_shared<Poly3Camera<double>>(params, size);
+}
+
+// Largest angle between cached and exact rays over random pixels. Rays of
+// the model have unit length if unit_rays, else unit z.
+double MaxCacheError(std::shared_ptr<CameraInterface<double>> camera,
+                     bool unit_rays)
+{
+  std::mt19937 rng(6);
+  std::uniform_real_distribution<double> u(0, camera->Width());
+  std::uniform_real_distribution<double> v(0, camera->Height());
+  Eigen::Matrix2Xd pixels(2, 500);
+  for (int i = 0; i < pixels.cols(); ++i) pixels.col(i) << u(rng), v(rng);
+
+  Eigen::Matrix3Xd exact;
+  camera->DisableUnprojectCache();
+  camera->UnprojectN(pixels, exact);
+  camera->EnableUnprojectCache(8, true);
+
+  Eigen::Matrix3Xd cached;
+  camera->UnprojectN(pixels, cached);
+  double max_error = 0;
+  for (int i = 0; i < pixels.cols(); ++i)
+  {
+    const Eigen::Vector3d ray = camera->Unproject(pixels.col(i));
+    EXPECT_EQ(ray, Eigen::Vector3d(cached.col(i)));
+    const Eigen::Vector3d a = exact.col(i);
+    const Eigen::Vector3d b = cached.col(i);
+    EXPECT_NEAR(1.0, unit_rays ? b.norm() : b[2], 1E-12);
+    max_error = std::max(max_error, std::atan2(a.cross(b).norm(), a.dot(b)));
+  }
+  return max_error;
+}
+
+TEST(UnprojectCache, Kb4)
+{
+  ASSERT_LT(MaxCacheError(CreateKb4Camera(), true), 1E-7);
+}
+
+TEST(UnprojectCache, Poly3)
+{
+  ASSERT_LT(MaxCacheError(CreatePoly3Camera(), false), 1E-7);
+}
+
+TEST(UnprojectCache, Invalidation)
+{
+  std::shared_ptr<CameraInterface<double>> camera = CreateKb4Camera();
+  camera->EnableUnprojectCache(16, false);
+  const Eigen::Vector2d pix(101.3, 57.8);
+
+  // Rebuilt for new parameters
+  Eigen::VectorXd params = camera->GetParams();
+  params[4] = 0.2;
+  camera->SetParams(params);
+  Eigen::Vector3d ray = camera->Unproject(pix);
+  ASSERT_NEAR(0, (camera->Project(ray) - pix).norm(), 0.1);
+
+  camera->Scale(0.5);
+  ray = camera->Unproject(pix);
+  ASSERT_NEAR(0, (camera->Project(ray) - pix).norm(), 0.1);
+
+  // Exact after changing parameters in place
+  camera->GetParams()[5] = 0.05;
+  ray = camera->Unproject(pix);
+  camera->DisableUnprojectCache();
+  ASSERT_EQ(camera->Unproject(pix), ray);
+}
+
+} // namespace testing
+
+} // namespace calibu
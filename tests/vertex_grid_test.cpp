@@ -0,0 +1,60 @@
+#include <gtest/gtest.h>
+#include <calibu/target/TargetGridDot.h>
+
+#include <map>
+
+namespace calibu
+{
+namespace testing
+{
+
+TEST(VertexGrid, MatchesMap)
+{
+  Conic conic;
+  conic.center.setZero();
+  conic.center_undistorted.setZero();
+  conic.radius = 1.0;
+  std::vector<Vertex, Eigen::aligned_allocator<Vertex> > vs;
+  for (size_t i = 0; i < 40; ++i) vs.push_back(Vertex(i, conic));
+
+  // Positions around the origin, including ones outside the reserved cells
+  VertexGrid grid;
+  grid.Reserve(Eigen::Vector2i(3, 2));
+  std::map<std::pair<int, int>, Vertex*> expected;
+  for (size_t i = 0; i < vs.size(); ++i)
+  {
+    const Eigen::Vector2i g((int)(i * 7 % 13) - 6, (int)(i * 5 % 11) - 8);
+    grid.Set(g, &vs[i]);
+    expected[std::make_pair(g[0], g[1])] = &vs[i];
+  }
+
+  // Remove some, and a position that was never set
+  for (size_t i = 0; i < vs.size(); i += 3)
+  {
+    const Eigen::Vector2i g((int)(i * 7 % 13) - 6, (int)(i * 5 % 11) - 8);
+    grid.Set(g, nullptr);
+    expected.erase(std::make_pair(g[0], g[1]));
+  }
+  grid.Set(Eigen::Vector2i(100, -100), nullptr);
+  ASSERT_EQ(nullptr, grid.Find(Eigen::Vector2i(GRID_INVALID, GRID_INVALID)));
+
+  std::map<std::pair<int, int>, Vertex*> found;
+  grid.ForEach([&found](const Eigen::Vector2i& g, Vertex* v) {
+    found[std::make_pair(g[0], g[1])] = v;
+  });
+  ASSERT_EQ(expected, found);
+  for (const auto& e : expected)
+  {
+    ASSERT_EQ(e.second, grid.Find(Eigen::Vector2i(e.first.first, e.first.second)));
+  }
+
+  grid.Clear();
+  size_t count = 0;
+  grid.ForEach([&count](const Eigen::Vector2i&, Vertex*) { ++count; });
+  ASSERT_EQ(0u, count);
+  ASSERT_EQ(nullptr, grid.Find(Eigen::Vector2i(0, 0)));
+}
+
+} // namespace testing
+
+} // namespace calibu
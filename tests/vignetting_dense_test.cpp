@@ -126,6 +126,41 @@ TEST(DenseVignetting, Reset)
   }
 }
 
+TEST(DenseVignetting, AttenuationImage)
+{
+  const int w = 32;
+  const int h = 24;
+  DenseVignetting<double> vignetting(w, h);
+  Eigen::VectorXd params(w * h);
+
+  for (int i = 0; i < params.size(); ++i)
+  {
+    params[i] = 0.5 + 0.5 * i / params.size();
+  }
+
+  vignetting.SetParams(params);
+  std::vector<float> image(w * h);
+  std::vector<float> inverse(w * h);
+  vignetting.RenderAttenuationImage(image.data());
+  vignetting.RenderInverseAttenuationImage(inverse.data());
+
+  for (int i = 0; i < params.size(); ++i)
+  {
+    ASSERT_FLOAT_EQ(params[i], image[i]);
+    ASSERT_FLOAT_EQ(1 / params[i], inverse[i]);
+  }
+
+  vignetting.Reset();
+  ASSERT_FLOAT_EQ(1.0f, (*vignetting.GetAttenuationImage())[w * h - 1]);
+
+  params.setZero();
+  vignetting.SetParams(params);
+  ASSERT_FLOAT_EQ(0.0f, (*vignetting.GetInverseAttenuationImage())[0]);
+
+  DenseVignetting<double> copy(vignetting);
+  ASSERT_FLOAT_EQ(0.0f, (*copy.GetAttenuationImage())[0]);
+}
+
 } // namespace testing
 
 }
\ No newline at end of file
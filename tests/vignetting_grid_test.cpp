@@ -0,0 +1,179 @@
+#include <gtest/gtest.h>
+#include <calibu/pcalib/vignetting_grid.h>
+
+namespace calibu
+{
+namespace testing
+{
+
+TEST(GridVignetting, Constructor)
+{
+  {
+    const int w = 640;
+    const int h = 480;
+    GridVignetting<double> vignetting(w, h);
+    ASSERT_EQ(w, vignetting.Width());
+    ASSERT_EQ(h, vignetting.Height());
+    ASSERT_EQ("grid", vignetting.Type());
+    ASSERT_EQ(21, vignetting.GridWidth());
+    ASSERT_EQ(16, vignetting.GridHeight());
+    ASSERT_EQ(GRID_BICUBIC, vignetting.Interpolation());
+    ASSERT_EQ(21 * 16, vignetting.NumParams());
+  }
+
+  {
+    GridVignetting<double> vignetting(320, 240, 5, 4, GRID_BILINEAR);
+    ASSERT_EQ(5, vignetting.GridWidth());
+    ASSERT_EQ(4, vignetting.GridHeight());
+    ASSERT_EQ(GRID_BILINEAR, vignetting.Interpolation());
+    ASSERT_EQ(20, vignetting.NumParams());
+  }
+
+  ASSERT_THROW(GridVignetting<double>(320, 240, 1, 4), Exception);
+}
+
+TEST(GridVignetting, Nodes)
+{
+  const int w = 320;
+  const int h = 240;
+  const int gw = 5;
+  const int gh = 4;
+
+  for (GridInterpolation interpolation : { GRID_BILINEAR, GRID_BICUBIC })
+  {
+    GridVignetting<double> vignetting(w, h, gw, gh, interpolation);
+    const Eigen::VectorXd params = Eigen::VectorXd::Random(gw * gh);
+    vignetting.SetParams(params);
+
+    // the model passes through every node
+
+    for (int y = 0; y < gh; ++y)
+    {
+      for (int x = 0; x < gw; ++x)
+      {
+        const double u = x * double(w) / (gw - 1);
+        const double v = y * double(h) / (gh - 1);
+        ASSERT_NEAR(params[y * gw + x], vignetting(u, v), 1E-12);
+      }
+    }
+  }
+}
+
+TEST(GridVignetting, Smooth)
+{
+  const int w = 320;
+  const int h = 240;
+  const int gw = 9;
+  const int gh = 7;
+
+  for (GridInterpolation interpolation : { GRID_BILINEAR, GRID_BICUBIC })
+  {
+    GridVignetting<double> vignetting(w, h, gw, gh, interpolation);
+    Eigen::VectorXd params(gw * gh);
+
+    // a linear ramp is reproduced away from the borders
+
+    for (int y = 0; y < gh; ++y)
+    {
+      for (int x = 0; x < gw; ++x)
+      {
+        params[y * gw + x] = 1.0 - 0.01 * x - 0.02 * y;
+      }
+    }
+
+    vignetting.SetParams(params);
+
+    for (double v = h / 6.0 + 0.5; v < 5 * h / 6.0; v += 7)
+    {
+      for (double u = w / 8.0 + 0.5; u < 7 * w / 8.0; u += 5)
+      {
+        const double x = u * (gw - 1) / w;
+        const double y = v * (gh - 1) / h;
+        ASSERT_NEAR(1.0 - 0.01 * x - 0.02 * y, vignetting(u, v), 1E-12);
+      }
+    }
+  }
+}
+
+TEST(GridVignetting, Reset)
+{
+  GridVignetting<double> vignetting(320, 240);
+  vignetting.SetParams(Eigen::VectorXd::Random(vignetting.NumParams()));
+  vignetting.Reset();
+
+  for (int y = 0; y < 240; y += 7)
+  {
+    for (int x = 0; x < 320; x += 5)
+    {
+      ASSERT_NEAR(1, vignetting(x + 0.5, y + 0.5), 1E-12);
+    }
+  }
+}
+
+TEST(GridVignetting, Evaluate)
+{
+  const int w = 64;
+  const int h = 48;
+
+  for (GridInterpolation interpolation : { GRID_BILINEAR, GRID_BICUBIC })
+  {
+    GridVignetting<double> vignetting(w, h, 6, 5, interpolation);
+    vignetting.SetParams(Eigen::VectorXd::Random(30));
+    const Vignetting<double>& base = vignetting;
+
+    std::vector<double> row(w + 4);
+    base.EvaluateRow(17.5, -1.5, row.size(), row.data());
+
+    std::vector<double> u(w), v(w), out(w);
+    for (int x = 0; x < w; ++x)
+    {
+      u[x] = 0.9 * x;
+      v[x] = 0.7 * x;
+    }
+    base.Evaluate(u.data(), v.data(), out.data(), w);
+
+    for (size_t x = 0; x < row.size(); ++x)
+    {
+      ASSERT_NEAR(vignetting(x - 1.5, 17.5), row[x], 1E-12);
+    }
+
+    for (int x = 0; x < w; ++x)
+    {
+      ASSERT_DOUBLE_EQ(vignetting(u[x], v[x]), out[x]);
+    }
+  }
+}
+
+TEST(GridVignetting, AttenuationImage)
+{
+  const int w = 64;
+  const int h = 48;
+
+  for (GridInterpolation interpolation : { GRID_BILINEAR, GRID_BICUBIC })
+  {
+    GridVignetting<double> vignetting(w, h, 6, 5, interpolation);
+    Eigen::VectorXd params = Eigen::VectorXd::Random(30);
+    params.array() = 0.75 + 0.25 * params.array();
+    vignetting.SetParams(params);
+
+    const std::shared_ptr<const std::vector<float>> image =
+        vignetting.GetAttenuationImage();
+    ASSERT_EQ(size_t(w * h), image->size());
+
+    for (int y = 0; y < h; ++y)
+    {
+      for (int x = 0; x < w; ++x)
+      {
+        const double expected = GridVignetting<double>::GetAttenuation(
+            params.data(), x + 0.5, y + 0.5, w, h, 6, 5, interpolation);
+
+        ASSERT_NEAR(expected, vignetting(x + 0.5, y + 0.5), 1E-12);
+        ASSERT_NEAR(expected, (*image)[y * w + x], 1E-6);
+      }
+    }
+  }
+}
+
+} // namespace testing
+
+} // namespace calibu
@@ -116,6 +116,72 @@ TEST(EvenPoly6Vignetting, Reset)
   ASSERT_DOUBLE_EQ(0, params[2]);
 }
 
+TEST(EvenPoly6Vignetting, Evaluate)
+{
+  const int w = 64;
+  const int h = 48;
+  EvenPoly6Vignetting<double> vignetting(w, h);
+  vignetting.SetParams(Eigen::Vector3d(-0.3, 0.1, -0.05));
+  const Vignetting<double>& base = vignetting;
+
+  std::vector<double> row(w);
+  base.EvaluateRow(10.5, 0.5, w, row.data());
+
+  std::vector<double> u(w), v(w, 20.25), out(w);
+  for (int x = 0; x < w; ++x) u[x] = 0.75 * x;
+  base.Evaluate(u.data(), v.data(), out.data(), w);
+
+  for (int x = 0; x < w; ++x)
+  {
+    ASSERT_DOUBLE_EQ(vignetting(x + 0.5, 10.5), row[x]);
+    ASSERT_DOUBLE_EQ(vignetting(u[x], v[x]), out[x]);
+  }
+}
+
+TEST(EvenPoly6Vignetting, AttenuationImage)
+{
+  const int w = 64;
+  const int h = 48;
+  EvenPoly6Vignetting<double> vignetting(w, h);
+  vignetting.SetParams(Eigen::Vector3d(-0.3, 0.1, -0.05));
+
+  const std::shared_ptr<const std::vector<float>> image =
+      vignetting.GetAttenuationImage();
+  const std::shared_ptr<const std::vector<float>> inverse =
+      vignetting.GetInverseAttenuationImage();
+  ASSERT_EQ(w * h, image->size());
+  ASSERT_EQ(w * h, inverse->size());
+
+  for (int y = 0; y < h; ++y)
+  {
+    for (int x = 0; x < w; ++x)
+    {
+      const double expected = vignetting(x + 0.5, y + 0.5);
+      ASSERT_NEAR(expected, (*image)[y * w + x], 1E-6);
+      ASSERT_NEAR(1 / expected, (*inverse)[y * w + x], 1E-5);
+    }
+  }
+
+  const int stride = w + 3;
+  std::vector<float> strided(stride * h, -1.0f);
+  vignetting.RenderAttenuationImage(strided.data(), stride);
+
+  for (int y = 0; y < h; ++y)
+  {
+    for (int x = 0; x < stride; ++x)
+    {
+      const float expected = (x < w) ? (*image)[y * w + x] : -1.0f;
+      ASSERT_FLOAT_EQ(expected, strided[y * stride + x]);
+    }
+  }
+
+  // Images already returned keep the parameters they were computed with
+  vignetting.SetParams(Eigen::Vector3d(0.0, 0.0, 0.0));
+  ASSERT_FLOAT_EQ(1.0f, (*vignetting.GetAttenuationImage())[0]);
+  ASSERT_NEAR(strided[0], (*image)[0], 1E-6);
+  ASSERT_LT((*image)[0], 1.0f);
+}
+
 } // namespace testing
 
 } // namespace calibu
\ No newline at end of file
@@ -74,6 +74,24 @@ TEST(UniformVignetting, Reset)
   }
 }
 
+TEST(UniformVignetting, AttenuationImage)
+{
+  const int w = 32;
+  const int h = 24;
+  UniformVignetting<double> vignetting(w, h);
+  const std::shared_ptr<const std::vector<float>> image =
+      vignetting.GetAttenuationImage();
+  const std::shared_ptr<const std::vector<float>> inverse =
+      vignetting.GetInverseAttenuationImage();
+  ASSERT_EQ(w * h, image->size());
+
+  for (int i = 0; i < w * h; ++i)
+  {
+    ASSERT_FLOAT_EQ(1.0f, (*image)[i]);
+    ASSERT_FLOAT_EQ(1.0f, (*inverse)[i]);
+  }
+}
+
 } // namespace testing
 
 } // namespace calibu
\ No newline at end of file